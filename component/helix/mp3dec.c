@@ -48,20 +48,24 @@
 /**************************************************************************************
  * Function:    MP3InitDecoder
  *
- * Description: allocate memory for platform-specific data
- *              clear all the user-accessible fields
+ * Description: lay out the decoder in the memory given, clear all the user-accessible fields
  *
- * Inputs:      none
+ * Inputs:      MP3_DECODER_STATE_SIZE bytes of state, 4-byte aligned
+ *              MP3_DECODER_SCRATCH_SIZE bytes of scratch, 4-byte aligned
  *
  * Outputs:     none
  *
- * Return:      handle to mp3 decoder instance, 0 if malloc fails
+ * Return:      handle to mp3 decoder instance, 0 if a pointer is null
+ *
+ * Notes:       calling it again on the same state starts the decoder from scratch
+ *              the state must stay untouched until the decoder is not used any more,
+ *                the scratch only during MP3Decode()
  **************************************************************************************/
-HMP3Decoder MP3InitDecoder(void)
+HMP3Decoder MP3InitDecoder(void *state, void *scratch)
 {
 	MP3DecInfo *mp3DecInfo;
 
-	mp3DecInfo = AllocateBuffers();
+	mp3DecInfo = AllocateBuffers(state, scratch);
 
 	return (HMP3Decoder)mp3DecInfo;
 }
@@ -166,6 +170,79 @@ static int MP3FindFreeSync(unsigned char *buf, unsigned char firstFH[4], int nBy
 	return -1;
 }
 
+/**************************************************************************************
+ * Function:    MP3OutputChannels
+ *
+ * Description: number of channels actually synthesized and written to the pcm buffer
+ *
+ * Inputs:      mp3DecInfo struct with frame header unpacked
+ *
+ * Outputs:     none
+ *
+ * Return:      1 if center-channel removal collapses a stereo frame, nChans otherwise
+ **************************************************************************************/
+static int MP3OutputChannels(MP3DecInfo *mp3DecInfo)
+{
+	return (mp3DecInfo->centerCancel && mp3DecInfo->nChans == 2) ? 1 : mp3DecInfo->nChans;
+}
+
+/**************************************************************************************
+ * Function:    MP3SetCenterCancel
+ *
+ * Description: enable/disable center-channel removal ("karaoke")
+ *
+ * Inputs:      valid MP3 decoder instance pointer (HMP3Decoder)
+ *              nonzero to enable
+ *
+ * Outputs:     none
+ *
+ * Return:      none
+ *
+ * Notes:       when enabled, stereo frames are decoded to mono (L-R)/2, computed on the 
+ *                dequantized spectra so only one channel goes through IMDCT and Subband
+ *                (both go through IMDCT on granules where their block types differ)
+ *              mono frames are not affected
+ *              channel 1 restarts from silence when the mode changes, see ClearChannelSynthesis()
+ **************************************************************************************/
+void MP3SetCenterCancel(HMP3Decoder hMP3Decoder, int enable)
+{
+	MP3DecInfo *mp3DecInfo = (MP3DecInfo *)hMP3Decoder;
+
+	if (!mp3DecInfo)
+		return;
+
+	enable = (enable != 0);
+	if (mp3DecInfo->centerCancel != enable)
+		ClearChannelSynthesis(mp3DecInfo, 1);
+
+	mp3DecInfo->centerCancel = enable;
+}
+
+/**************************************************************************************
+ * Function:    MP3ClearReservoir
+ *
+ * Description: drop the main data kept from previous frames (bit reservoir)
+ *
+ * Inputs:      valid MP3 decoder instance pointer (HMP3Decoder)
+ *
+ * Outputs:     none
+ *
+ * Return:      none
+ *
+ * Notes:       call it after seeking, the frames that reference data from before the seek
+ *                return ERR_MP3_MAINDATA_UNDERFLOW (silence) until the reservoir fills again
+ **************************************************************************************/
+void MP3ClearReservoir(HMP3Decoder hMP3Decoder)
+{
+	MP3DecInfo *mp3DecInfo = (MP3DecInfo *)hMP3Decoder;
+
+	if (!mp3DecInfo)
+		return;
+
+	mp3DecInfo->mainDataBytes = 0;
+	mp3DecInfo->freeBitrateFlag = 0;
+}
+
 /**************************************************************************************
  * Function:    MP3GetLastFrameInfo
  *
@@ -195,10 +272,10 @@ void MP3GetLastFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo *mp3FrameInfo)
 		mp3FrameInfo->version = 0;
 	} else {
 		mp3FrameInfo->bitrate = mp3DecInfo->bitrate;
-		mp3FrameInfo->nChans = mp3DecInfo->nChans;
+		mp3FrameInfo->nChans = MP3OutputChannels(mp3DecInfo);
 		mp3FrameInfo->samprate = mp3DecInfo->samprate;
 		mp3FrameInfo->bitsPerSample = 16;
-		mp3FrameInfo->outputSamps = mp3DecInfo->nChans * (int)samplesPerFrameTab[mp3DecInfo->version][mp3DecInfo->layer - 1];
+		mp3FrameInfo->outputSamps = MP3OutputChannels(mp3DecInfo) * (int)samplesPerFrameTab[mp3DecInfo->version][mp3DecInfo->layer - 1];
 		mp3FrameInfo->layer = mp3DecInfo->layer;
 		mp3FrameInfo->version = mp3DecInfo->version;
 	}
@@ -279,7 +356,7 @@ static void MP3ClearBadFrame(MP3DecInfo *mp3DecInfo, short *outbuf)
  **************************************************************************************/
 int MP3Decode(HMP3Decoder hMP3Decoder, unsigned char **inbuf, int *bytesLeft, short *outbuf, int useSize)
 {
-	int offset, bitOffset, mainBits, gr, ch, fhBytes, siBytes, freeFrameBytes;
+	int offset, bitOffset, mainBits, gr, ch, fhBytes, siBytes, freeFrameBytes, nChansOut;
 	int prevBitOffset, sfBlockBits, huffBlockBits;
 	unsigned char *mainPtr;
 	MP3DecInfo *mp3DecInfo = (MP3DecInfo *)hMP3Decoder;
@@ -402,15 +479,24 @@ int MP3Decode(HMP3Decoder hMP3Decoder, unsigned char **inbuf, int *bytesLeft, sh
 			return ERR_MP3_INVALID_DEQUANTIZE;			
 		}
 
-		/* alias reduction, inverse MDCT, overlap-add, frequency inversion */
-		for (ch = 0; ch < mp3DecInfo->nChans; ch++)
+		/* alias reduction, inverse MDCT, overlap-add, frequency inversion 
+		 *   (with center-channel removal only channel 0 carries signal)
+		 */
+		nChansOut = MP3OutputChannels(mp3DecInfo);
+		for (ch = 0; ch < nChansOut; ch++)
 			if (IMDCT(mp3DecInfo, gr, ch) < 0) {
 				MP3ClearBadFrame(mp3DecInfo, outbuf);
 				return ERR_MP3_INVALID_IMDCT;			
 			}
 
+		/* center-channel removal with different block types, channel 1 is transformed apart and subtracted */
+		if (nChansOut < mp3DecInfo->nChans && CenterCancelIMDCT(mp3DecInfo, gr) < 0) {
+			MP3ClearBadFrame(mp3DecInfo, outbuf);
+			return ERR_MP3_INVALID_IMDCT;			
+		}
+
 		/* subband transform - if stereo, interleaves pcm LRLRLR */
-		if (Subband(mp3DecInfo, outbuf + gr*mp3DecInfo->nGranSamps*mp3DecInfo->nChans) < 0) {
+		if (Subband(mp3DecInfo, outbuf + gr*mp3DecInfo->nGranSamps*nChansOut) < 0) {
 			MP3ClearBadFrame(mp3DecInfo, outbuf);
 			return ERR_MP3_INVALID_SUBBAND;			
 		}
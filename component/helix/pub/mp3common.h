@@ -90,6 +90,9 @@ typedef struct _MP3DecInfo {
 	int mainDataBegin;
 	int mainDataBytes;
 
+	int centerCancel;		/* nonzero: output mono (L-R)/2, see CenterCancelProc() */
+	int centerSplit;		/* this granule: block types differ, L/2 and R/2 go through IMDCT apart */
+
 	int part23Length[MAX_NGRAN][MAX_NCHAN];
 
 } MP3DecInfo;
@@ -100,7 +103,7 @@ typedef struct _SFBandTable {
 } SFBandTable;
 
 /* decoder functions which must be implemented for each platform */
-MP3DecInfo *AllocateBuffers(void);
+MP3DecInfo *AllocateBuffers(void *state, void *scratch);
 void FreeBuffers(MP3DecInfo *mp3DecInfo);
 int CheckPadBit(MP3DecInfo *mp3DecInfo);
 int UnpackFrameHeader(MP3DecInfo *mp3DecInfo, unsigned char *buf);
@@ -108,8 +111,10 @@ int UnpackSideInfo(MP3DecInfo *mp3DecInfo, unsigned char *buf);
 int DecodeHuffman(MP3DecInfo *mp3DecInfo, unsigned char *buf, int *bitOffset, int huffBlockBits, int gr, int ch);
 int Dequantize(MP3DecInfo *mp3DecInfo, int gr);
 int IMDCT(MP3DecInfo *mp3DecInfo, int gr, int ch);
+int CenterCancelIMDCT(MP3DecInfo *mp3DecInfo, int gr);
 int UnpackScaleFactors(MP3DecInfo *mp3DecInfo, unsigned char *buf, int *bitOffset, int bitsAvail, int gr, int ch);
 int Subband(MP3DecInfo *mp3DecInfo, short *pcmBuf);
+void ClearChannelSynthesis(MP3DecInfo *mp3DecInfo, int ch);
 
 /* mp3tabs.c - global ROM tables */
 extern const int samplerateTab[3][3];
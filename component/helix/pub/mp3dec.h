@@ -85,6 +85,13 @@ extern "C" {
 #define MAX_NCHAN		2		/* max channels */
 #define MAX_NSAMP		576		/* max samples per channel, per granule (576 default) */
 
+/* memory given to MP3InitDecoder(), checked against the structs in buffers.c
+ *   state:   kept between frames, one per decoder (MP3DecInfo, IMDCT overlap, subband history...)
+ *   scratch: only used within MP3Decode(), decoders that never decode at the same time can share it
+ */
+#define MP3_DECODER_STATE_SIZE		18432
+#define MP3_DECODER_SCRATCH_SIZE	5632
+
 /* map to 0,1,2 to make table indexing easier */
 typedef enum {
 	MPEG1 =  0,
@@ -123,13 +130,15 @@ typedef struct _MP3FrameInfo {
 } MP3FrameInfo;
 
 /* public API */
-HMP3Decoder MP3InitDecoder(void);
+HMP3Decoder MP3InitDecoder(void *state, void *scratch);
 void MP3FreeDecoder(HMP3Decoder hMP3Decoder);
 int MP3Decode(HMP3Decoder hMP3Decoder, unsigned char **inbuf, int *bytesLeft, short *outbuf, int useSize);
 
 void MP3GetLastFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo *mp3FrameInfo);
 int MP3GetNextFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo *mp3FrameInfo, unsigned char *buf);
 int MP3FindSyncWord(unsigned char *buf, int nBytes);
+void MP3SetCenterCancel(HMP3Decoder hMP3Decoder, int enable);
+void MP3ClearReservoir(HMP3Decoder hMP3Decoder);
 
 #ifdef __cplusplus
 }
@@ -48,6 +48,25 @@
 #include <stdlib.h>		/* for malloc, free */
 #include "coder.h"
 
+/* layout of the memory given to MP3InitDecoder(), kept between frames */
+typedef struct _MP3DecState {
+	MP3DecInfo mp3DecInfo;
+	FrameHeader fh;
+	SideInfo si;
+	ScaleFactorInfo sfi;
+	IMDCTInfo mi;
+	SubbandInfo sbi;
+} MP3DecState;
+
+/* only used within MP3Decode(), decoders that never decode at the same time can share it */
+typedef struct _MP3DecScratch {
+	HuffmanInfo hi;
+	DequantInfo di;
+} MP3DecScratch;
+
+typedef char MP3DecStateFits[(sizeof(MP3DecState) <= MP3_DECODER_STATE_SIZE) ? 1 : -1];
+typedef char MP3DecScratchFits[(sizeof(MP3DecScratch) <= MP3_DECODER_SCRATCH_SIZE) ? 1 : -1];
+
 /**************************************************************************************
  * Function:    ClearBuffer
  *
@@ -76,9 +95,10 @@ static void ClearBuffer(void *buf, int nBytes)
 /**************************************************************************************
  * Function:    AllocateBuffers
  *
- * Description: allocate all the memory needed for the MP3 decoder
+ * Description: lay out all the memory needed for the MP3 decoder
  *
- * Inputs:      none
+ * Inputs:      MP3_DECODER_STATE_SIZE bytes of state, 4-byte aligned, one per decoder
+ *              MP3_DECODER_SCRATCH_SIZE bytes of scratch, 4-byte aligned
  *
  * Outputs:     none
  *
@@ -86,79 +106,31 @@ static void ClearBuffer(void *buf, int nBytes)
  *                the internal buffers needed for decoding, all other members of 
  *                MP3DecInfo structure set to 0)
  *
- * Notes:       if one or more mallocs fail, function frees any buffers already
- *                allocated before returning
+ * Notes:       no malloc, the caller owns the memory and keeps the RAM usage 
+ *                known at compile time
+ *              returns 0 if either pointer is null
  **************************************************************************************/
-MP3DecInfo *AllocateBuffers(void)
+MP3DecInfo *AllocateBuffers(void *state, void *scratch)
 {
-	MP3DecInfo *mp3DecInfo;
-	FrameHeader *fh;
-	SideInfo *si;
-	ScaleFactorInfo *sfi;
-	HuffmanInfo *hi;
-	DequantInfo *di;
-	IMDCTInfo *mi;
-	SubbandInfo *sbi;
-
-	/*
-	 * Use static buffers to make the RAM usage
-	 * known at compile time.
-	 */
-	static MP3DecInfo s_mp3DecInfo;
-	static FrameHeader s_fh;
-	static SideInfo s_si;
-	static ScaleFactorInfo s_sfi;
-	static HuffmanInfo s_hi;
-	static DequantInfo s_di;
-	static IMDCTInfo s_mi;
-	static SubbandInfo s_sbi;
-	
-	mp3DecInfo = &s_mp3DecInfo;
-	fh = &s_fh;
-	si = &s_si;
-	sfi = &s_sfi;
-	hi = &s_hi;
-	di = &s_di;
-	mi = &s_mi;
-	sbi = &s_sbi;
+	MP3DecState *s = (MP3DecState *)state;
+	MP3DecScratch *t = (MP3DecScratch *)scratch;
 
-//	mp3DecInfo = (MP3DecInfo *)malloc(sizeof(MP3DecInfo));
-//	if (!mp3DecInfo) {
-//		return 0;
-//	}
-//	ClearBuffer(mp3DecInfo, sizeof(MP3DecInfo));
-//
-//	fh =  (FrameHeader *)     malloc(sizeof(FrameHeader));
-//	si =  (SideInfo *)        malloc(sizeof(SideInfo));
-//	sfi = (ScaleFactorInfo *) malloc(sizeof(ScaleFactorInfo));
-//	hi =  (HuffmanInfo *)     malloc(sizeof(HuffmanInfo));
-//	di =  (DequantInfo *)     malloc(sizeof(DequantInfo));
-//	mi =  (IMDCTInfo *)       malloc(sizeof(IMDCTInfo));
-//	sbi = (SubbandInfo *)     malloc(sizeof(SubbandInfo));
-
-	mp3DecInfo->FrameHeaderPS =     (void *)fh;
-	mp3DecInfo->SideInfoPS =        (void *)si;
-	mp3DecInfo->ScaleFactorInfoPS = (void *)sfi;
-	mp3DecInfo->HuffmanInfoPS =     (void *)hi;
-	mp3DecInfo->DequantInfoPS =     (void *)di;
-	mp3DecInfo->IMDCTInfoPS =       (void *)mi;
-	mp3DecInfo->SubbandInfoPS =     (void *)sbi;
-
-	if (!fh || !si || !sfi || !hi || !di || !mi || !sbi) {
-		FreeBuffers(mp3DecInfo);	/* safe to call - only frees memory that was successfully allocated */
+	if (!s || !t)
 		return 0;
-	}
 
 	/* important to do this - DSP primitives assume a bunch of state variables are 0 on first use */
-	ClearBuffer(fh,  sizeof(FrameHeader));
-	ClearBuffer(si,  sizeof(SideInfo));
-	ClearBuffer(sfi, sizeof(ScaleFactorInfo));
-	ClearBuffer(hi,  sizeof(HuffmanInfo));
-	ClearBuffer(di,  sizeof(DequantInfo));
-	ClearBuffer(mi,  sizeof(IMDCTInfo));
-	ClearBuffer(sbi, sizeof(SubbandInfo));
+	ClearBuffer(s, sizeof(MP3DecState));
+	ClearBuffer(t, sizeof(MP3DecScratch));
+
+	s->mp3DecInfo.FrameHeaderPS =     (void *)&s->fh;
+	s->mp3DecInfo.SideInfoPS =        (void *)&s->si;
+	s->mp3DecInfo.ScaleFactorInfoPS = (void *)&s->sfi;
+	s->mp3DecInfo.HuffmanInfoPS =     (void *)&t->hi;
+	s->mp3DecInfo.DequantInfoPS =     (void *)&t->di;
+	s->mp3DecInfo.IMDCTInfoPS =       (void *)&s->mi;
+	s->mp3DecInfo.SubbandInfoPS =     (void *)&s->sbi;
 
-	return mp3DecInfo;
+	return &s->mp3DecInfo;
 }
 
 #define SAFE_FREE(x)	{if (x)	free(x);	(x) = 0;}	/* helper macro */
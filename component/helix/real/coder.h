@@ -97,6 +97,7 @@
 #define	 MidSideProc			STATNAME(MidSideProc)
 #define	 IntensityProcMPEG1	STATNAME(IntensityProcMPEG1)
 #define	 IntensityProcMPEG2	STATNAME(IntensityProcMPEG2)
+#define	 CenterCancelProc	STATNAME(CenterCancelProc)
 #define PolyphaseMono		STATNAME(PolyphaseMono)
 #define PolyphaseStereo		STATNAME(PolyphaseStereo)
 #define FDCT32				STATNAME(FDCT32)
@@ -268,6 +269,7 @@ void IntensityProcMPEG1(int x[MAX_NCHAN][MAX_NSAMP], int nSamps, FrameHeader *fh
 						CriticalBandInfo *cbi, int midSideFlag, int mixFlag, int mOut[2]);
 void IntensityProcMPEG2(int x[MAX_NCHAN][MAX_NSAMP], int nSamps, FrameHeader *fh, ScaleFactorInfoSub *sfis, 
 						CriticalBandInfo *cbi, ScaleFactorJS *sfjs, int midSideFlag, int mixFlag, int mOut[2]);
+void CenterCancelProc(int x[MAX_NCHAN][MAX_NSAMP], int nSamps, int sideOnly, int blocksMatch, int mOut[2]);
 
 /* dct32.c */
 void FDCT32(int *x, int *d, int offset, int oddBlock, int gb);
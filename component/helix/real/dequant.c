@@ -73,6 +73,7 @@
 int Dequantize(MP3DecInfo *mp3DecInfo, int gr)
 {
 	int i, ch, nSamps, mOut[2];
+	int centerCancel, sideOnly, blocksMatch;
 	FrameHeader *fh;
 	SideInfo *si;
 	ScaleFactorInfo *sfi;
@@ -95,6 +96,12 @@ int Dequantize(MP3DecInfo *mp3DecInfo, int gr)
 	cbi = di->cbi;
 	mOut[0] = mOut[1] = 0;
 
+	/* center-channel removal only needs the side signal, which mid-side frames already carry */
+	centerCancel = (mp3DecInfo->centerCancel && mp3DecInfo->nChans == 2);
+	blocksMatch = (si->sis[gr][0].blockType == si->sis[gr][1].blockType && 
+				   si->sis[gr][0].mixedBlock == si->sis[gr][1].mixedBlock);
+	sideOnly = (centerCancel && fh->modeExt == 0x02 && blocksMatch);
+
 	/* dequantize all the samples in each channel */
 	for (ch = 0; ch < mp3DecInfo->nChans; ch++) {
 		hi->gb[ch] = DequantChannel(hi->huffDecBuf[ch], di->workBuf, &hi->nonZeroBound[ch], fh,
@@ -117,8 +124,8 @@ int Dequantize(MP3DecInfo *mp3DecInfo, int gr)
 		}
 	}
 
-	/* do mid-side stereo processing, if enabled */
-	if (fh->modeExt >> 1) {
+	/* do mid-side stereo processing, if enabled (not needed if we only keep the side signal) */
+	if ((fh->modeExt >> 1) && !sideOnly) {
 		if (fh->modeExt & 0x01) {
 			/* intensity stereo enabled - run mid-side up to start of right zero region */
 			if (cbi[1].cbType == 0)
@@ -153,6 +160,20 @@ int Dequantize(MP3DecInfo *mp3DecInfo, int gr)
 		hi->nonZeroBound[1] = nSamps;
 	}
 
+	/* center-channel removal - leaves (L-R)/2 in channel 0, the only one that gets synthesized
+	 *   (or L/2 and R/2 if the block types differ, subtracted after IMDCT - see CenterCancelIMDCT())
+	 */
+	if (centerCancel) {
+		nSamps = MAX(hi->nonZeroBound[0], hi->nonZeroBound[1]);
+		mOut[0] = mOut[1] = 0;
+		CenterCancelProc(hi->huffDecBuf, nSamps, sideOnly, blocksMatch, mOut);
+		hi->gb[0] = CLZ(mOut[0]) - 1;
+		hi->gb[1] = CLZ(mOut[1]) - 1;
+		hi->nonZeroBound[0] = nSamps;
+		hi->nonZeroBound[1] = nSamps;
+	}
+	mp3DecInfo->centerSplit = (centerCancel && !blocksMatch);
+
 	/* output format Q(DQ_FRACBITS_OUT) */
 	return 0;
 }
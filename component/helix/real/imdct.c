@@ -777,3 +777,69 @@ int IMDCT(MP3DecInfo *mp3DecInfo, int gr, int ch)
 	/* output has gained 2 int bits */
 	return 0;
 }
+
+/**************************************************************************************
+ * Function:    CenterCancelIMDCT
+ *
+ * Description: finish center-channel removal when the two channels use different block
+ *                types, after IMDCT() on channel 0
+ *
+ * Inputs:      MP3DecInfo structure filled by Dequantize() (for this granule)
+ *              index of current granule
+ *
+ * Outputs:     outBuf[0] = outBuf[0] - outBuf[1], with its guard bit count updated
+ *
+ * Return:      0 on success,  -1 if null input pointers
+ *
+ * Notes:       when centerSplit is set channel 0 holds L/2 and channel 1 R/2, each one goes
+ *                through IMDCT with its own windows and overlap
+ *              on the next granule with matching block types channel 0 holds (L-R)/2 again,
+ *                but the overlap left by R/2 is still in channel 1 - a silent granule
+ *                flushes it and then channel 1 is idle (numPrevIMDCT = 0) until the next split
+ *              the overlap-add is linear, so the output is the same as synthesizing L and R
+ *                and subtracting them
+ **************************************************************************************/
+int CenterCancelIMDCT(MP3DecInfo *mp3DecInfo, int gr)
+{
+	int i, b, y, mOut;
+	HuffmanInfo *hi;
+	IMDCTInfo *mi;
+
+	/* validate pointers */
+	if (!mp3DecInfo || !mp3DecInfo->HuffmanInfoPS || !mp3DecInfo->IMDCTInfoPS)
+		return -1;
+
+	hi = (HuffmanInfo*)(mp3DecInfo->HuffmanInfoPS);
+	mi = (IMDCTInfo *)(mp3DecInfo->IMDCTInfoPS);
+
+	if (!mp3DecInfo->centerSplit) {
+		/* nothing pending in channel 1 */
+		if (mi->numPrevIMDCT[1] == 0)
+			return 0;
+
+		/* only its overlap is left, transform a silent granule */
+		for (i = 0; i < MAX_NSAMP; i++)
+			hi->huffDecBuf[1][i] = 0;
+		hi->nonZeroBound[1] = 0;
+		hi->gb[1] = CLZ(0) - 1;
+	}
+
+	if (IMDCT(mp3DecInfo, gr, 1) < 0)
+		return -1;
+
+	/* both halves have the same scaling, and the /2 leaves room for the difference */
+	mOut = 0;
+	for (b = 0; b < BLOCK_SIZE; b++) {
+		for (i = 0; i < NBANDS; i++) {
+			y = mi->outBuf[0][b][i] - mi->outBuf[1][b][i];
+			mi->outBuf[0][b][i] = y;
+			mOut |= FASTABS(y);
+		}
+	}
+	mi->gb[0] = CLZ(mOut) - 1;
+
+	if (!mp3DecInfo->centerSplit)
+		mi->numPrevIMDCT[1] = 0;
+
+	return 0;
+}
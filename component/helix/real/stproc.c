@@ -81,6 +81,106 @@ void MidSideProc(int x[MAX_NCHAN][MAX_NSAMP], int nSamps, int mOut[2])
 	mOut[1] |= mOutR;
 }
 
+/**************************************************************************************
+ * Function:    CenterCancelProc
+ *
+ * Description: center-channel removal ("karaoke"), done on the dequantized spectra so
+ *                only one channel has to go through IMDCT and Subband
+ *
+ * Inputs:      vector x with dequantized samples from left and right channels
+ *              number of non-zero samples (MAX of left and right)
+ *              flag indicating x[1] already holds the side signal (mid-side frame
+ *                where MidSideProc() was skipped)
+ *              flag indicating both channels use the same block type in this granule
+ *
+ * Outputs:     x[0] = (L - R) / 2, x[1] untouched
+ *                or, if the block types differ, x[0] = L / 2 and x[1] = R / 2
+ *              updated mOut[2] (OR of abs(x[i]) for each channel, for the guard bit counts)
+ *
+ * Return:      none
+ *
+ * Notes:       with mid-side coding x[1] = S/sqrt(2) = (L - R)/2 (1/sqrt(2) is done in
+ *                DequantChannel()), so the side signal comes out for free
+ *              long and short block coefficients can not be mixed, so if the block types
+ *                differ both channels go through IMDCT with their own windows and are
+ *                subtracted afterwards, see CenterCancelIMDCT()
+ *              the /2 keeps the level of a single channel and needs no guard bits
+ **************************************************************************************/
+void CenterCancelProc(int x[MAX_NCHAN][MAX_NSAMP], int nSamps, int sideOnly, int blocksMatch, int mOut[2])
+{
+	int i, xl, xr, mOutL, mOutR;
+
+	mOutL = mOutR = 0;
+	if (!blocksMatch) {
+		for (i = 0; i < nSamps; i++) {
+			xl = x[0][i] >> 1;
+			xr = x[1][i] >> 1;
+			x[0][i] = xl;
+			x[1][i] = xr;
+			mOutL |= FASTABS(xl);
+			mOutR |= FASTABS(xr);
+		}
+	} else if (sideOnly) {
+		for (i = 0; i < nSamps; i++) {
+			xr = x[1][i];
+			x[0][i] = xr;
+			mOutL |= FASTABS(xr);
+		}
+	} else {
+		for (i = 0; i < nSamps; i++) {
+			xl = x[0][i] >> 1;
+			xr = x[1][i] >> 1;
+			x[0][i] = xl - xr;
+			mOutL |= FASTABS(xl - xr);
+		}
+	}
+
+	mOut[0] |= mOutL;
+	mOut[1] |= mOutR;
+}
+
+/**************************************************************************************
+ * Function:    ClearChannelSynthesis
+ *
+ * Description: drop the IMDCT overlap and the polyphase history of one channel
+ *
+ * Inputs:      MP3DecInfo structure filled by AllocateBuffers()
+ *              index of the channel
+ *
+ * Outputs:     overlap-add buffer, window state and vbuf entries of that channel set to 0
+ *
+ * Return:      none
+ *
+ * Notes:       channel 1 is not synthesized while center-channel removal is on, so what
+ *                it keeps is from before removal was turned on. Clearing it when the mode
+ *                changes makes the channel start from silence, as at the start of a file,
+ *                instead of overlap-adding a stale granule (a click)
+ *              each 64-int row of vbuf has channel 0 in the first 32 and channel 1 in the
+ *                last 32 (see FDCT32() and Subband())
+ **************************************************************************************/
+void ClearChannelSynthesis(MP3DecInfo *mp3DecInfo, int ch)
+{
+	int i, j;
+	IMDCTInfo *mi;
+	SubbandInfo *sbi;
+
+	if (!mp3DecInfo || !mp3DecInfo->IMDCTInfoPS || !mp3DecInfo->SubbandInfoPS)
+		return;
+
+	mi = (IMDCTInfo *)(mp3DecInfo->IMDCTInfoPS);
+	sbi = (SubbandInfo *)(mp3DecInfo->SubbandInfoPS);
+
+	for (i = 0; i < MAX_NSAMP / 2; i++)
+		mi->overBuf[ch][i] = 0;
+	mi->numPrevIMDCT[ch] = 0;
+	mi->prevType[ch] = 0;
+	mi->prevWinSwitch[ch] = 0;
+
+	for (i = ch * NBANDS; i < MAX_NCHAN * VBUF_LENGTH; i += 2 * NBANDS)
+		for (j = 0; j < NBANDS; j++)
+			sbi->vbuf[i + j] = 0;
+}
+
 /**************************************************************************************
  * Function:    IntensityProcMPEG1
  *
@@ -23,106 +23,448 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 
 #include "read_id3.h"
 
 #define min(a,b) ((a>b)?(b):(a))
 
-// now used like this: 
-//    read_ID3_info( TITLE, str, sizeof(str), &fp);
+#define ID3_HEADER_SIZE 10
+#define ID3_WINDOW_SIZE 1024	//one read covers the header and the text frames of most tags
+#define ID3_TEXT_SIZE 256
 
-unsigned char read_ID3_info(const unsigned char tag_name,char * output_str, unsigned int res_str_l, FIL *fp)
+//tag header flags
+#define ID3_FLAG_UNSYNC 0x80
+#define ID3_FLAG_EXTENDED 0x40
+#define ID3_FLAG_FOOTER 0x10
+
+//frame format flags (second flag byte)
+#define ID3V23_FRAME_SKIP 0xC0		//compressed or encrypted
+#define ID3V23_FRAME_GROUP 0x20
+#define ID3V24_FRAME_GROUP 0x40
+#define ID3V24_FRAME_SKIP 0x0C		//compressed or encrypted
+#define ID3V24_FRAME_UNSYNC 0x02
+#define ID3V24_FRAME_DATA_LEN 0x01
+
+//trailing tags
+#define ID3V1_SIZE 128
+#define ID3V1_FIELD 30
+#define APE_FOOTER_SIZE 32
+#define APE_FLAG_HEADER 0x80000000
+#define APE_ITEM_BINARY 0x06
+#define ID3_APE_KEY_SIZE 32		//keys are 2 to 255 chars, the ones we look for are short
+
+//text encodings
+#define ID3_ISO_8859_1 0
+#define ID3_UTF16_BOM 1
+#define ID3_UTF16_BE 2
+#define ID3_UTF8 3
+
+//here we've got macros to define the tagname for each data frame
+// add new ones if you want. every four characters is a new tag type
+//-----------------            ttl|alb|art|trk|yea|len|rgg|rgp|
+static const char id3v2_3[] = "TIT2TALBTPE1TRCKTYERTLENTXXXTXXX";  //id3, v2, spec 3 uses 4 byte ID
+static const char id3v2_4[] = "TIT2TALBTPE1TRCKTDRCTLENTXXXTXXX";  //id3, v2, spec 4 replaced TYER with TDRC
+static const char id3v2_2[] = "TT2 TAL TP1 TRK TYE TLE TXX TXX ";  //id3, v2, spec 2 uses 3 byte ID
+//-----------------          |title| |artist| |year|  |replaygain gain/peak|
+//-----------------              |album| |track|  |len|
+
+//the user text frames (TXXX) are told apart by their description
+static const char * const txxx_descriptions[ID3_NUM_FIELDS] = { NULL, NULL, NULL, NULL, NULL, NULL,
+																"REPLAYGAIN_TRACK_GAIN", "REPLAYGAIN_TRACK_PEAK" };
+
+//window over the file, frames are parsed from it and the big ones are skipped with a seek
+typedef struct {
+	FIL *fp;
+	unsigned int pos;		//file offset of the next byte
+	unsigned int end;		//file offset where the frames end
+	unsigned int win_pos;	//file offset of window[0]
+	unsigned int win_len;
+	bool unsync;			//whole tag unsynchronisation (v2.2 and v2.3)
+	unsigned char last;		//previous byte, to drop the 0x00 after every 0xFF
+} id3_reader;
+
+static unsigned char window[ID3_WINDOW_SIZE];
+
+static unsigned int syncsafe(const unsigned char *b)
 {
-	//here we've got macros to define the tagname for each data frame
-	// add new ones if you want. every four characters is a new tag type
-	//-----------------     ttl|alb|art|trk|yea|len|
-	const char id3v2_3[] = "TIT2TALBTPE1TRCKTYERTLEN";  //id3, v2, spec 3 uses 4 byte ID
-	const char id3v2_2[] = "TT2 TAL TP1 TRK TYE TLE ";  //id3, v2, spec 2 uses 3 byte ID
-	//-----------------   |title| |artist| |year|
-	//-----------------       |album| |track|  |len|
-
-	unsigned char common_header[10];
-	unsigned int bytesRead = 0;
-	file_seek_absolute(fp,0);
-	file_read(fp,common_header,sizeof(common_header),bytesRead);
+	return (b[0] << 21) | (b[1] << 14) | (b[2] << 7) | b[3];
+}
+
+static unsigned int id3_read_raw(id3_reader *r, unsigned char *dst, unsigned int len)
+{
+	unsigned int done = 0;
+	while (done < len && r->pos < r->end) {
+		if ((r->pos < r->win_pos) || (r->pos >= r->win_pos + r->win_len)) {
+			//outside of the window, move it here with one seek and one read
+			unsigned int bytesRead = 0;
+			file_seek_absolute(r->fp, r->pos);
+			file_read(r->fp, window, sizeof(window), bytesRead);
+			r->win_pos = r->pos;
+			r->win_len = bytesRead;
+			if (!bytesRead) break;
+		}
+		unsigned char c = window[r->pos++ - r->win_pos];
+		if (r->unsync && r->last == 0xFF && c == 0x00) {
+			r->last = c;
+			continue;
+		}
+		r->last = c;
+		if (dst) dst[done] = c;
+		done++;
+	}
+	return done;
+}
+
+static void id3_skip(id3_reader *r, unsigned int len)
+{
+	if (r->unsync) {
+		//the stored length is unknown until the bytes are seen
+		id3_read_raw(r, NULL, len);
+	}
+	else {
+		//no read at all, the window moves when the next frame header is needed
+		r->pos = min(r->pos + len, r->end);
+	}
+}
+
+static unsigned int remove_unsync(unsigned char *b, unsigned int len)
+{
+	unsigned int out = 0;
+	for (unsigned int ii = 0; ii < len; ii++) {
+		if (ii && b[ii - 1] == 0xFF && b[ii] == 0x00) continue;
+		b[out++] = b[ii];
+	}
+	return out;
+}
+
+static unsigned char to_ascii(unsigned int code_point)
+{
+	//the OLED font only has the ASCII characters
+	return ((code_point > '~') || (code_point < ' ')) ? '_' : (unsigned char)code_point;
+}
+
+static unsigned int read_le32(const unsigned char *b)
+{
+	return b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int)b[3] << 24);
+}
+
+static bool same_key(const char *key, const char *name)
+{
+	while (*key && tolower((unsigned char)*key) == tolower((unsigned char)*name)) {
+		key++;
+		name++;
+	}
+	return *key == *name;
+}
+
+static void latin1_field(const unsigned char *b, unsigned int len, char *output_str, unsigned int res_str_l)
+{
+	//ID3v1 fields are padded with spaces or zeros
+	while (len && (b[len - 1] == ' ' || b[len - 1] == 0)) len--;
+	unsigned int out = 0;
+	for (unsigned int ii = 0; ii < len && b[ii] && out < res_str_l - 1; ii++)
+		output_str[out++] = to_ascii(b[ii]);
+	output_str[out] = 0;
+}
+
+static void decode_text(const unsigned char *b, unsigned int len, char *output_str, unsigned int res_str_l)
+{
+	unsigned int out = 0;
+	if (!len) {
+		output_str[0] = 0;
+		return;
+	}
+	unsigned char encoding = b[0];
+	b++;
+	len--;
+
+	if ((encoding == ID3_UTF16_BOM) || (encoding == ID3_UTF16_BE)) {
+		bool big_endian = true;
+		if (encoding == ID3_UTF16_BOM && len >= 2) {
+			big_endian = (b[0] == 0xFE && b[1] == 0xFF);
+			b += 2;
+			len -= 2;
+		}
+		for (unsigned int ii = 0; ii + 1 < len && out < res_str_l - 1; ii += 2) {
+			unsigned int unit = big_endian ? ((b[ii] << 8) | b[ii + 1]) : ((b[ii + 1] << 8) | b[ii]);
+			if (!unit) break;
+			if (unit >= 0xDC00 && unit <= 0xDFFF) continue;	//second half of a surrogate pair
+			output_str[out++] = to_ascii(unit);
+		}
+	}
+	else {
+		for (unsigned int ii = 0; ii < len && out < res_str_l - 1; ii++) {
+			if (!b[ii]) break;
+			if (encoding == ID3_UTF8 && (b[ii] & 0xC0) == 0x80) continue;	//UTF-8 continuation byte
+			output_str[out++] = to_ascii(b[ii]);
+		}
+	}
+	output_str[out] = 0; //make sure there's a null terminator.
+}
+
+static unsigned int txxx_value(unsigned char *b, unsigned int len)
+{
+	//the value follows the 0 (two in UTF-16) at the end of the description. Its encoding byte is written
+	//right before it, where the 0 was, so decode_text can take it from there. 0 if there is no value
+	if ((b[0] == ID3_UTF16_BOM) || (b[0] == ID3_UTF16_BE)) {
+		for (unsigned int ii = 1; ii + 1 < len; ii += 2) {
+			if (!b[ii] && !b[ii + 1]) {
+				b[ii + 1] = b[0];
+				return ii + 1;
+			}
+		}
+	}
+	else {
+		for (unsigned int ii = 1; ii < len; ii++) {
+			if (!b[ii]) {
+				b[ii] = b[0];
+				return ii;
+			}
+		}
+	}
+	return 0;
+}
+
+// now used like this:
+//    char *fields[ID3_NUM_FIELDS] = {title, album, artist, track, year, NULL, NULL, NULL};
+//    read_ID3_tags(fields, sizeof(title), &tag_size, &fp);
+
+unsigned int read_ID3_tags(char *output_strs[ID3_NUM_FIELDS], unsigned int res_str_l, unsigned int *tag_size, FIL *fp)
+{
+	unsigned int found = 0;
+	unsigned int wanted = 0;
+	*tag_size = 0;
+
+	for (int ii = 0; ii < ID3_NUM_FIELDS; ii++) {
+		if (output_strs[ii]) wanted |= 1 << ii;
+	}
+
+	id3_reader r = { .fp = fp, .pos = 0, .end = ID3_HEADER_SIZE, .win_pos = 0, .win_len = 0, .unsync = false, .last = 0 };
+	unsigned char common_header[ID3_HEADER_SIZE];
+	if (id3_read_raw(&r, common_header, ID3_HEADER_SIZE) != ID3_HEADER_SIZE) return 0;
 	if ((common_header[0]!='I')||(common_header[1]!='D')||(common_header[2]!='3')) return 0;
-	
-	if (common_header[3] <= 0x04) {   //recognized id3 v2
-		unsigned int tag_size = (common_header[9]) | (common_header[8] << 7) | (common_header[7] << 14) | (common_header[6] << 28);
-		
-		const char * compare_tagname = ((common_header[3] == 0x03)||(common_header[3] == 0x04))? (id3v2_3+(tag_name*4)) : (id3v2_2+(tag_name*4));
-		int just_safe = 30;  //to avoid an infinite loop limit the number of iterations.
-		while (tag_size && just_safe--) {
-			unsigned char frame_header[10];
-			unsigned int fr_hdr_bytes = 0;
-			//the size of the data frames depends on the version varriant. 03=10 bytes, 02=6 bytes.
-			unsigned int frame_header_size = ((common_header[3] == 0x03)||(common_header[3] == 0x04))? 10 : ((common_header[3]==0x02)? 6:6);
-			file_read(fp,frame_header,frame_header_size,fr_hdr_bytes);
-			tag_size -= fr_hdr_bytes;
-			//check to make sure this TAG name is really a tag name.
-			unsigned int tagname_size = ((common_header[3] == 0x03)||(common_header[3] == 0x04))? 4 : ((common_header[3]==0x02)? 3:3);
-			for (int jj=0;jj<tagname_size;jj++) if ((frame_header[jj]>'Z')||(frame_header[jj]<'0')) return 0;
-			unsigned long frame_size;
-			if ((common_header[3] == 0x03)||(common_header[3] == 0x04))
-				frame_size = (frame_header[7]) | (frame_header[6] << 8) | (frame_header[5] << 16) | ((frame_header[4] << 16) << 16);
-			else //if (common_header[3] == 0x02)
-				frame_size = (frame_header[5]) | (frame_header[4] << 8) | (frame_header[3] << 16);
-			
-			//check to see if we've got the right tag as was asked for:
-			if (0==strncmp((char*)frame_header,compare_tagname,tagname_size)){
-				file_seek_relative(fp,1); //skip past empty byte.
-				
-				// UNICODE to ASCII conversion..
-				unsigned int l_to_read = min(frame_size,res_str_l); //TODO: might need to be frame_size-1
-				//printf("->[%s] of size %ld bytes, reading [%i]\n", frame_header,frame_size,l_to_read);
-				
-				if (l_to_read >= 2){
-					unsigned int convert_read = 0;
-					file_read(fp,output_str,2,convert_read);
-					char start_utf[3] = {0xFF,0xFE};
-					if (0 == strncmp( start_utf, output_str, 2)){  // unicode tags start with 01 FF FE
-						//Unicode decode string:
-						l_to_read = min((frame_size-3)/2,res_str_l-1);
-						//printf(" unicode!-> frame_size=%ld, (have%i) reading [%i]\n", frame_size, res_str_l, l_to_read);
-						for (unsigned int ii = 0; ii <= l_to_read; ii++) {
-							file_read(fp,output_str+ii,1,fr_hdr_bytes);
-							file_seek_relative(fp,1);
-							if ((output_str[ii]>'~')||(output_str[ii]<' ')) output_str[ii] = '_';
-						}
-						output_str[l_to_read] = 0; //make sure there's a null terminator.
-						return 1;
-					}
-					//not unicode, go back to the beginning.
-					file_read(fp,output_str+2,l_to_read-2,fr_hdr_bytes);	//TODO: (ALREADY DONE) l_to_read - 2 not l_to_read - 3 for obvious reasons (?
-					output_str[l_to_read-1] = 0; //make sure there's a null terminator.
-					//printf(" non unicode -> %s\n",output_str);
-					return 1;
+
+	unsigned char version = common_header[3];
+	unsigned char flags = common_header[5];
+	if (version < 0x02 || version > 0x04) return 0;
+
+	r.end = ID3_HEADER_SIZE + syncsafe(common_header + 6);
+	*tag_size = r.end + ((version == 0x04 && (flags & ID3_FLAG_FOOTER)) ? ID3_HEADER_SIZE : 0);
+	r.unsync = (version != 0x04) && (flags & ID3_FLAG_UNSYNC);
+
+	if (flags & ID3_FLAG_EXTENDED) {
+		if (version == 0x02) return 0;	//in v2.2 this flag means the whole tag is compressed
+		unsigned char ext[4];
+		if (id3_read_raw(&r, ext, 4) != 4) return 0;
+		if (version == 0x03)
+			id3_skip(&r, (ext[0] << 24) | (ext[1] << 16) | (ext[2] << 8) | ext[3]);	//size without itself
+		else
+			id3_skip(&r, syncsafe(ext) - 4);	//size with itself
+	}
+
+	//the size of the data frames depends on the version varriant. 03/04=10 bytes, 02=6 bytes.
+	const unsigned int frame_header_size = (version == 0x02) ? 6 : 10;
+	const unsigned int tagname_size = (version == 0x02) ? 3 : 4;
+	const char *tagnames = (version == 0x02) ? id3v2_2 : ((version == 0x03) ? id3v2_3 : id3v2_4);
+
+	while (found != wanted) {
+		unsigned char frame_header[10];
+		if (id3_read_raw(&r, frame_header, frame_header_size) != frame_header_size) break;
+
+		//check to make sure this TAG name is really a tag name, a 0 means the padding started.
+		bool valid = true;
+		for (unsigned int jj=0;jj<tagname_size;jj++) if ((frame_header[jj]>'Z')||(frame_header[jj]<'0')) valid = false;
+		if (!valid) break;
+
+		unsigned int frame_size;
+		unsigned char format_flags = 0;
+		if (version == 0x02) {
+			frame_size = (frame_header[3] << 16) | (frame_header[4] << 8) | frame_header[5];
+		}
+		else if (version == 0x03 || ((frame_header[4] | frame_header[5] | frame_header[6] | frame_header[7]) & 0x80)) {
+			//some encoders write v2.4 tags with plain v2.3 sizes, those are never syncsafe
+			frame_size = (frame_header[4] << 24) | (frame_header[5] << 16) | (frame_header[6] << 8) | frame_header[7];
+			format_flags = frame_header[9];
+		}
+		else {
+			frame_size = syncsafe(frame_header + 4);
+			format_flags = frame_header[9];
+		}
+
+		//check to see if it's one of the tags that were asked for:
+		int field = -1;
+		for (int ii = 0; ii < ID3_NUM_FIELDS; ii++) {
+			if ((wanted & ~found & (1 << ii)) && 0 == strncmp((char*)frame_header, tagnames + ii * 4, tagname_size)) field = ii;
+		}
+
+		bool skip = (version == 0x03 && (format_flags & ID3V23_FRAME_SKIP)) || (version == 0x04 && (format_flags & ID3V24_FRAME_SKIP));
+		if (field < 0 || skip || frame_size == 0) {
+			//APIC, PRIV and every other frame we don't want are jumped over without reading them
+			id3_skip(&r, frame_size);
+			continue;
+		}
+
+		//the text frames are small, but a long one is only read as far as the string needs
+		//(encoding byte + BOM + 2 bytes per char + room for the v2.4 prefix and unsync bytes)
+		unsigned char text[ID3_TEXT_SIZE];
+		unsigned int prefix = 0;
+		if (version == 0x03 && (format_flags & ID3V23_FRAME_GROUP)) prefix += 1;
+		if (version == 0x04 && (format_flags & ID3V24_FRAME_GROUP)) prefix += 1;
+		if (version == 0x04 && (format_flags & ID3V24_FRAME_DATA_LEN)) prefix += 4;
+
+		unsigned int l_to_read = min(frame_size, min((unsigned int)sizeof(text), prefix + 3 + 4 * res_str_l));
+		unsigned int len = id3_read_raw(&r, text, l_to_read);
+		id3_skip(&r, frame_size - len);
+
+		if (version == 0x04 && ((format_flags & ID3V24_FRAME_UNSYNC) || (flags & ID3_FLAG_UNSYNC)))
+			len = remove_unsync(text, len);
+		if (len <= prefix) continue;
+
+		if (txxx_descriptions[field]) {
+			//any of the user text fields, the description says which one
+			char description[ID3_APE_KEY_SIZE];
+			decode_text(text + prefix, len - prefix, description, sizeof(description));
+			field = -1;
+			for (int ii = 0; ii < ID3_NUM_FIELDS; ii++) {
+				if ((wanted & ~found & (1 << ii)) && txxx_descriptions[ii] && same_key(description, txxx_descriptions[ii])) field = ii;
+			}
+			unsigned int value = txxx_value(text + prefix, len - prefix);
+			if (field < 0 || !value) continue;
+			prefix += value;
+		}
+
+		decode_text(text + prefix, len - prefix, output_strs[field], res_str_l);
+		found |= 1 << field;
+	}
+
+	return found;
+}
+
+// now used like this (after read_ID3_tags):
+//    found = read_ID3_trailer(fields, sizeof(title), found, &trailer_size, &fp);
+
+unsigned int read_ID3_trailer(char *output_strs[ID3_NUM_FIELDS], unsigned int res_str_l, unsigned int found, unsigned int *trailer_size, FIL *fp)
+{
+	//APE keys for each tag type, compared ignoring case
+	static const char * const ape_keys[ID3_NUM_FIELDS] = { "Title", "Album", "Artist", "Track", "Year", NULL,
+															"REPLAYGAIN_TRACK_GAIN", "REPLAYGAIN_TRACK_PEAK" };
+	unsigned int fsize = file_size(fp);
+	unsigned int bytesRead = 0;
+	unsigned int ape_wanted = 0;
+	*trailer_size = 0;
+
+	for (int ii = 0; ii < ID3_NUM_FIELDS; ii++) {
+		if (output_strs[ii] && ape_keys[ii]) ape_wanted |= 1 << ii;
+	}
+
+	//the ID3v1 tag, the APE footer before it and most APE items are in the last bytes of the file
+	unsigned int tail_len = min(fsize, (unsigned int)sizeof(window));
+	unsigned int tail_pos = fsize - tail_len;
+	file_seek_absolute(fp, tail_pos);
+	file_read(fp, window, tail_len, bytesRead);
+	if (bytesRead != tail_len) return found;
+
+	unsigned int end = tail_len;	//end of the tag being parsed, relative to the window
+
+	//ID3v1 (v1.1 uses the last two bytes of the comment for the track number), kept for the end
+	//because reading the APE items may move the window
+	unsigned char v1_tag[ID3V1_SIZE];
+	const unsigned char *v1 = NULL;
+	if (end >= ID3V1_SIZE && 0 == strncmp((char*)window + end - ID3V1_SIZE, "TAG", 3)) {
+		memcpy(v1_tag, window + end - ID3V1_SIZE, ID3V1_SIZE);
+		v1 = v1_tag;
+		end -= ID3V1_SIZE;
+		*trailer_size += ID3V1_SIZE;
+	}
+
+	//APEv2, the footer is right before the ID3v1 tag or at the end of the file
+	if (end >= APE_FOOTER_SIZE && 0 == strncmp((char*)window + end - APE_FOOTER_SIZE, "APETAGEX", 8)) {
+		const unsigned char *footer = window + end - APE_FOOTER_SIZE;
+		unsigned int ape_size = read_le32(footer + 12);		//items + footer
+		unsigned int item_count = read_le32(footer + 16);
+		unsigned int ape_flags = read_le32(footer + 20);
+		unsigned int ape_total = ape_size + ((ape_flags & APE_FLAG_HEADER) ? APE_FOOTER_SIZE : 0);
+
+		if (ape_size >= APE_FOOTER_SIZE && tail_pos + end >= ape_total) {
+			*trailer_size += ape_total;
+
+			//the items are usually already in the window, if not the reader moves it (cover art goes last
+			//in most files, when it doesn't it's jumped over with a seek like in the ID3v2 tag)
+			id3_reader r = { .fp = fp, .pos = tail_pos + end - ape_size, .end = tail_pos + end - APE_FOOTER_SIZE,
+							 .win_pos = tail_pos, .win_len = tail_len, .unsync = false, .last = 0 };
+
+			while (item_count-- && (found | ~ape_wanted) != ~0U) {
+				unsigned char item_header[8];
+				char key[ID3_APE_KEY_SIZE];
+				unsigned int key_len = 0;
+				if (id3_read_raw(&r, item_header, sizeof(item_header)) != sizeof(item_header)) break;
+				unsigned int value_len = read_le32(item_header);
+				unsigned int item_flags = read_le32(item_header + 4);
+
+				//the key is ASCII with a 0 at the end
+				do {
+					if (id3_read_raw(&r, (unsigned char*)key + key_len, 1) != 1) key[key_len] = 0;
+				} while (key[key_len] && ++key_len < sizeof(key) - 1);
+				key[key_len] = 0;
+
+				int field = -1;
+				for (int ii = 0; ii < ID3_NUM_FIELDS; ii++) {
+					if ((ape_wanted & ~found & (1 << ii)) && same_key(key, ape_keys[ii])) field = ii;
 				}
-				// copy non-unicode string to the string.
-				file_read(fp,output_str,l_to_read,fr_hdr_bytes);
-				output_str[l_to_read-1] = 0; //make sure there's a null terminator.
-				//printf(" non unicode -> %s\n",output_str);
-				return 1;
+				if (field < 0 || (item_flags & APE_ITEM_BINARY)) {
+					id3_skip(&r, value_len);
+					continue;
+				}
+
+				//the value is UTF-8 without the encoding byte of ID3v2, decode_text skips byte 0
+				unsigned char text[ID3_TEXT_SIZE];
+				unsigned int len = id3_read_raw(&r, text + 1, min(value_len, (unsigned int)sizeof(text) - 1));
+				id3_skip(&r, value_len - len);
+				text[0] = ID3_UTF8;
+				decode_text(text, len + 1, output_strs[field], res_str_l);
+				found |= 1 << field;
 			}
-			else {
-				file_seek_relative(fp,frame_size);
-				tag_size -= frame_size;
+		}
+	}
+
+	if (v1) {
+		const unsigned int v1_offsets[ID3_NUM_FIELDS] = { 3, 63, 33, 0, 93, 0, 0, 0 };
+		const unsigned int v1_lengths[ID3_NUM_FIELDS] = { ID3V1_FIELD, ID3V1_FIELD, ID3V1_FIELD, 0, 4, 0, 0, 0 };
+		for (int ii = 0; ii < ID3_NUM_FIELDS; ii++) {
+			if (output_strs[ii] && !(found & (1 << ii)) && v1_lengths[ii]) {
+				latin1_field(v1 + v1_offsets[ii], v1_lengths[ii], output_strs[ii], res_str_l);
+				if (output_strs[ii][0]) found |= 1 << ii;
 			}
 		}
-		return 0;
+		if (output_strs[TRACK_NUM_ID3] && !(found & (1 << TRACK_NUM_ID3)) && v1[125] == 0 && v1[126] != 0 && res_str_l > 3) {
+			snprintf(output_strs[TRACK_NUM_ID3], res_str_l, "%u", v1[126]);
+			found |= 1 << TRACK_NUM_ID3;
+		}
 	}
-	else return 0;
+
+	return found;
+}
+
+unsigned char read_ID3_info(const unsigned char tag_name,char * output_str, unsigned int res_str_l, FIL *fp)
+{
+	char *output_strs[ID3_NUM_FIELDS] = { NULL };
+	unsigned int tag_size;
+
+	if (tag_name >= ID3_NUM_FIELDS) return 0;
+	output_strs[tag_name] = output_str;
+	return read_ID3_tags(output_strs, res_str_l, &tag_size, fp) ? 1 : 0;
 }
 
 bool has_ID3_tag(FIL* fp)
 {
 	bool ret = true;
-	unsigned char common_header[10];
+	unsigned char common_header[ID3_HEADER_SIZE];
 	unsigned int bytesRead = 0;
 	file_seek_absolute(fp, 0);
 	file_read(fp, common_header, sizeof(common_header), bytesRead);
-	if ((common_header[0] != 'I') || (common_header[1] != 'D') || (common_header[2] != '3'))
+	if ((bytesRead != sizeof(common_header)) || (common_header[0] != 'I') || (common_header[1] != 'D') || (common_header[2] != '3'))
 		ret = false;
 	return ret;
 }
@@ -130,19 +472,20 @@ bool has_ID3_tag(FIL* fp)
 unsigned int get_ID3_size(FIL* fp)
 {
 	unsigned int tag_size = 0;
-	unsigned char common_header[10];
+	unsigned char common_header[ID3_HEADER_SIZE];
 	unsigned int bytesRead = 0;
 	file_seek_absolute(fp, 0);
 	file_read(fp, common_header, sizeof(common_header), bytesRead);
-	if ((common_header[0] == 'I') || (common_header[1] == 'D') || (common_header[2] == '3'))
+	if ((bytesRead == sizeof(common_header)) && (common_header[0] == 'I') && (common_header[1] == 'D') && (common_header[2] == '3'))
 	{
 		if (common_header[3] <= 0x04)
 		{
-			tag_size = (common_header[9]) | (common_header[8] << 7) | (common_header[7] << 14) | (common_header[6] << 28);
+			//the size in the header excludes the header itself and the v2.4 footer
+			tag_size = ID3_HEADER_SIZE + syncsafe(common_header + 6);
+			if ((common_header[3] == 0x04) && (common_header[5] & ID3_FLAG_FOOTER))
+				tag_size += ID3_HEADER_SIZE;
 		}
-			
 	}
 
 	return tag_size;
-		
 }
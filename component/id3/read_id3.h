@@ -32,6 +32,7 @@
 #define file_seek_absolute(file,position) f_lseek(file, position)
 #define file_seek_relative(fi,pos) f_lseek(fi,fi->fptr+pos)
 #define file_read(f,str,l,rea) f_read(f,str,(l),&(rea))
+#define file_size(f) f_size(f)
 
 #else
 
@@ -41,6 +42,7 @@
 #define file_seek_absolute(file,position) fseek (file , position , SEEK_SET)
 #define file_seek_relative(fi,pos) fseek(fi,pos,SEEK_CUR)
 #define file_read(f,str,l,rea) rea=fread(str,1,l,f)
+#define file_size(f) (fseek(f, 0, SEEK_END), ftell(f))
 
 #endif
 
@@ -70,11 +72,55 @@
 #define TRACK_NUM_ID3 3
 #define YEAR_ID3 4
 #define LENGTH_ID3 5
+#define REPLAYGAIN_GAIN_ID3 6	//TXXX or APE REPLAYGAIN_TRACK_GAIN
+#define REPLAYGAIN_PEAK_ID3 7	//TXXX or APE REPLAYGAIN_TRACK_PEAK
+
+#define ID3_NUM_FIELDS 8
+
+/*
+ * read_ID3_tags - read every requested tag to its string in one pass over the ID3v2 tag.
+ *  The header and the text frames come from one buffered read, other frames (APIC, PRIV...)
+ *  are jumped over with a seek. Handles v2.2 to v2.4 (syncsafe sizes, unsynchronisation,
+ *  extended header) and ISO-8859-1/UTF-16/UTF-8 text, non ASCII chars are replaced with '_'.
+ *  example useage:
+ *    char title[40], artist[40];
+ *    char *fields[ID3_NUM_FIELDS] = { [TITLE_ID3] = title, [ARTIST_ID3] = artist };
+ *    unsigned int tag_size;
+ *    unsigned int found = read_ID3_tags(fields, 40, &tag_size, &file);
+ *
+ *  Input:
+ *   -array of strings indexed by the tag type macros, NULL for the tags that are not wanted
+ *   -the max length to read to each string
+ *   -pointer to variable where the whole tag size (header and footer included) will be stored
+ *   -the file pointer to read from
+ *  Output:
+ *   bitmask of the tags that were read, (1 << TITLE_ID3) | ...
+ */
+unsigned int read_ID3_tags(char *output_strs[ID3_NUM_FIELDS], unsigned int res_str_l, unsigned int *tag_size, FIL *fp);
+
+/*
+ * read_ID3_trailer - read the tags at the end of the file (APEv2 and ID3v1) to the strings that
+ *  are still empty. The last bytes of the file are read with one seek and one read.
+ *  The APE tag is preferred over ID3v1 (UTF-8 and no 30 chars limit).
+ *
+ *  Input:
+ *   -array of strings indexed by the tag type macros, NULL for the tags that are not wanted
+ *   -the max length to read to each string
+ *   -bitmask of the tags already read (from read_ID3_tags), those are not overwritten
+ *   -pointer to variable where the size of the trailing tags will be stored
+ *   -the file pointer to read from
+ *  Output:
+ *   bitmask with the tags that were read, the ones in found included.
+ */
+unsigned int read_ID3_trailer(char *output_strs[ID3_NUM_FIELDS], unsigned int res_str_l, unsigned int found, unsigned int *trailer_size, FIL *fp);
 
 bool has_ID3_tag(FIL *fp);
 
 unsigned char read_ID3_info(const unsigned char tag_name, char* output_str, unsigned int res_str_l, FIL* fp);
 
+/*
+ * get_ID3_size - size of the whole ID3v2 tag, the audio starts right after it. 0 if there is no tag.
+ */
 unsigned int get_ID3_size(FIL* fp);
 
 
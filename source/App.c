@@ -15,7 +15,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <vumeter/vumeter.h>
-#include "mp3_decoder.h"
+#include "audio_decoder.h"
 
 #include "fsl_common.h"
 #include "power_mode_switch.h"
@@ -33,6 +33,7 @@
 #include "AudioPlayer.h"
 
 #include "EventQueue/queue.h"
+#include "EventQueue/scheduler.h"
 
 #include "datetime.h"
 #include "memory_handler.h"
@@ -44,17 +45,61 @@
 
 #include "board.h"
 
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+// Fastest rate the DAC runs at, a buffer lasts the least at it
+#if AUDIO_PLAYER_FIXED_RATE
+#define AUDIO_MAX_RATE			AUDIO_PLAYER_FIXED_RATE
+#else
+#define AUDIO_MAX_RATE			48000
+#endif
+
+#define AUDIO_BUFFER_US			((AUDIO_PLAYER_BUFF_SIZE * 1000000UL) / AUDIO_MAX_RATE)
+
+// A refill is due when a buffer starts with fewer than the low watermark queued after it: all of them play meanwhile
+#define AUDIO_DEADLINE_US		(AUDIO_PLAYER_LOW_WATERMARK * AUDIO_BUFFER_US)
+
+#define INPUT_PERIOD_US			2000		// Buttons, encoder and SD card
+#define INPUT_DEADLINE_US		10000
+#define EVENT_DEADLINE_US		50000		// A key press shows on the screen within this
+#define VUMETER_DEADLINE_US		AUDIO_BUFFER_US	// Drawn before the next spectrum replaces it
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+// Ids of the tasks for Scheduler_GetStats, in the order they are added
+enum
+{
+	APP_TASK_AUDIO,
+	APP_TASK_INPUT,
+	APP_TASK_EVENTS,
+	APP_TASK_VUMETER,
+	APP_TASK_READ_AHEAD
+};
+
+
 /*******************************************************************************
  * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
  ******************************************************************************/
 
 
 /**
- * @brief captures events generated within the drivers and inside states and fills the eventqueue. Gets called continously.
+ * @brief captures events generated within the drivers and inside states and fills the eventqueue. Gets called every INPUT_PERIOD_US.
  * @return nothing.
  */
 void fill_queue(void);
 
+static void refillAudio(void);
+static bool refillPending(void);
+static bool vumeterPending(void);
+static void drawVumeter(void);
+static bool eventPending(void);
+static void dispatchEvent(void);
+
 /*******************************************************************************
  * VARIABLE PROTOTYPES WITH GLOBAL SCOPE
  ******************************************************************************/
@@ -63,6 +108,19 @@ void fill_queue(void);
 //this variable saves the current state of the FSM
 static state *current_state;
 
+// A refill computed a spectrum that is not on the matrix yet
+static bool newSpectrum = false;
+
+// Highest priority first. The longest run of any task delays the refill by as much, the VU draw included
+static const schedulerTask_t appTasks[] =
+{
+	[APP_TASK_AUDIO] =		{refillAudio, refillPending, 0, AUDIO_DEADLINE_US, 0},
+	[APP_TASK_INPUT] =		{fill_queue, NULL, INPUT_PERIOD_US, INPUT_DEADLINE_US, 1},
+	[APP_TASK_EVENTS] =		{dispatchEvent, eventPending, 0, EVENT_DEADLINE_US, 2},
+	[APP_TASK_VUMETER] =	{drawVumeter, vumeterPending, 0, VUMETER_DEADLINE_US, 3},
+	[APP_TASK_READ_AHEAD] =	{mp3Handler_readAhead, NULL, 0, SCHEDULER_NO_DEADLINE, 4}	// Spare time, keeps the SD card ahead of the decoder
+};
+
 
 /*******************************************************************************
  *******************************************************************************
@@ -86,8 +144,8 @@ void App_Init (void)
 	memory_handler_init();
 
 
-	//MP3 decoder Init
-	MP3Decoder_Init();
+	//Audio decoders Init
+	AudioDecoder_Init();
 
 	//Matrix Init
 	md_Init();
@@ -121,20 +179,21 @@ void App_Init (void)
 
 	//Init fsm
 	current_state = get_initial_state();
+
+	//Init Scheduler, after the clocks of PowerMode_Init
+	Scheduler_Init();
+	for (uint8_t task = 0; task < sizeof(appTasks) / sizeof(appTasks[0]); task++)
+	{
+		Scheduler_AddTask(&appTasks[task]);
+	}
 }
 
 
 /* Función que se llama constantemente en un ciclo infinito */
 void App_Run (void)
 {
-	fill_queue();
-
-	Event_Type event = pull_Queue_Element();
-
-	if (event != NONE_EV)
-	{
-		current_state = fsm_dispatcher(current_state, event);
-	}
+	// One task per call, the refill is checked before each of them
+	Scheduler_Run();
 }
 
 
@@ -170,13 +229,6 @@ void fill_queue(void)
 	}
 
 
-	//Check for AudioPLayer Events
-	if (AudioPlayer_IsBackBufferFree())
-	{
-		//push_Queue_Element(FILL_BUFFER_EV);
-		mp3Handler_updateAll();
-	}
-
 
 	//Check for Button Events
 	Event_Type button_event;
@@ -214,3 +266,49 @@ void fill_queue(void)
 		push_Queue_Element(ENCODER_LKP_EV);
 	}
 }
+
+
+static void refillAudio(void)
+{
+	//push_Queue_Element(FILL_BUFFER_EV);
+	mp3Handler_updateAudioPlayerBackBuffer();
+	newSpectrum = true;
+}
+
+
+static bool refillPending(void)
+{
+	// Once the song ended the queue runs out on its own, refilling would only decode silence until the next one loads
+	return AudioPlayer_NeedsRefill() && !mp3Handler_songEnded();
+}
+
+
+static bool vumeterPending(void)
+{
+	return newSpectrum;
+}
+
+
+static void drawVumeter(void)
+{
+	// Waits for the matrix to take the frame, a low priority keeps it out of the way of the refill
+	newSpectrum = false;
+	mp3Handler_showFFT();
+}
+
+
+static bool eventPending(void)
+{
+	return get_Queue_Status() != 0;
+}
+
+
+static void dispatchEvent(void)
+{
+	Event_Type event = pull_Queue_Element();
+
+	if (event != NONE_EV)
+	{
+		current_state = fsm_dispatcher(current_state, event);
+	}
+}
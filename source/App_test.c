@@ -16,7 +16,7 @@
 #include "mp3_handler/mp3_handler.h"
 #include "power_mode_switch.h"
 #include "AudioPlayer.h"
-#include "../HAL/mp3_decoder.h"
+#include "../HAL/audio_decoder.h"
 #include "../HAL/matrix_display.h"
 #include "equalizer/equalizer.h"
 #include "EventQueue/queue.h"
@@ -54,7 +54,7 @@ void App_Init_test (void)
 
 	queue_Init();
 	memory_handler_init();
-	MP3Decoder_Init();
+	AudioDecoder_Init();
 	md_Init();
 	AudioPlayer_Init();
 	VU_Init();
@@ -84,7 +84,7 @@ void App_Run_test (void)
 
 		while(1)
 		{
-			if(AudioPlayer_IsBackBufferFree())
+			if(AudioPlayer_NeedsRefill())
 			{
 				 mp3Handler_updateAll();
 			}
@@ -59,6 +59,7 @@ typedef enum {
 			NEXT_SONG_EV,
 		    PREV_SONG_EV,
 		    FILL_BUFFER_EV,
+		    SONG_CHANGED_EV,
 
 
 			}Event_Type;
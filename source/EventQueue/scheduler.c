@@ -0,0 +1,246 @@
+/***************************************************************************//**
+  @file     scheduler.c
+  @brief    Cooperative scheduler of the main loop, priorities and deadlines
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stddef.h>
+#include "scheduler.h"
+#include "MK64F12.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define NO_SLACK_YET	INT32_MAX
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	schedulerTask_t task;
+	uint32_t periodCycles;
+	uint32_t deadlineCycles;
+	uint32_t release;			// Cycle count of the last release
+	uint32_t nextRelease;		// Periodic tasks only
+	bool released;
+	schedulerStats_t stats;
+} taskEntry_t;
+
+
+/*******************************************************************************
+ * VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static taskEntry_t tasks[SCHEDULER_MAX_TASKS];
+static uint8_t num_Of_Tasks = 0;
+static uint32_t cyclesPerUs = 1;
+
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static void releaseIfDue(taskEntry_t * entry, uint32_t now);
+static void updateStats(taskEntry_t * entry, uint32_t start, uint32_t end);
+static void clearStats(schedulerStats_t * stats);
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+void Scheduler_Init (void)
+{
+	num_Of_Tasks = 0;
+	cyclesPerUs = SystemCoreClock / 1000000U;
+
+	// Cycle counter, the time base of the releases and the measurements
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+int8_t Scheduler_AddTask(const schedulerTask_t * task)
+{
+	if ((num_Of_Tasks >= SCHEDULER_MAX_TASKS) || (task->run == NULL))
+	{
+		return SCHEDULER_ERROR;
+	}
+
+	taskEntry_t * entry = &tasks[num_Of_Tasks];
+
+	entry->task = *task;
+	entry->periodCycles = task->periodUs * cyclesPerUs;
+	entry->deadlineCycles = task->deadlineUs * cyclesPerUs;
+	entry->released = false;
+	entry->nextRelease = DWT->CYCCNT;
+	clearStats(&entry->stats);
+
+	return (int8_t)num_Of_Tasks++;
+}
+
+
+bool Scheduler_Run(void)
+{
+	uint32_t now = DWT->CYCCNT;
+	taskEntry_t * next = NULL;
+	int32_t nextLeft = 0;
+
+	for (uint8_t id = 0; id < num_Of_Tasks; id++)
+	{
+		taskEntry_t * entry = &tasks[id];
+
+		if (!entry->released)
+		{
+			releaseIfDue(entry, now);
+
+			if (!entry->released)
+			{
+				continue;
+			}
+		}
+
+		// Cycles until its deadline, the most there is if it has none
+		int32_t left = entry->deadlineCycles ? (int32_t)(entry->release + entry->deadlineCycles - now) : INT32_MAX;
+
+		if ((next == NULL) || (entry->task.priority < next->task.priority) ||
+			((entry->task.priority == next->task.priority) && (left < nextLeft)))
+		{
+			next = entry;
+			nextLeft = left;
+		}
+	}
+
+	if (next == NULL)
+	{
+		return false;
+	}
+
+	next->released = false;
+
+	uint32_t start = DWT->CYCCNT;
+	next->task.run();
+	updateStats(next, start, DWT->CYCCNT);
+
+	return true;
+}
+
+
+bool Scheduler_GetStats(int8_t id, schedulerStats_t * stats)
+{
+	if ((id < 0) || (id >= num_Of_Tasks))
+	{
+		return false;
+	}
+
+	*stats = tasks[id].stats;
+	return true;
+}
+
+
+void Scheduler_ResetStats(void)
+{
+	for (uint8_t id = 0; id < num_Of_Tasks; id++)
+	{
+		clearStats(&tasks[id].stats);
+	}
+}
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+static void releaseIfDue(taskEntry_t * entry, uint32_t now)
+{
+	if (entry->task.ready != NULL)
+	{
+		// Polled here, the wait until it runs is counted from the first time it is seen ready
+		if (entry->task.ready())
+		{
+			entry->release = now;
+			entry->released = true;
+		}
+	}
+	else if (entry->periodCycles)
+	{
+		if ((int32_t)(now - entry->nextRelease) >= 0)
+		{
+			// Released when it was due, not when it was noticed
+			entry->release = entry->nextRelease;
+			entry->released = true;
+			entry->nextRelease += entry->periodCycles;
+
+			// More than a period late, the missed releases are not made up
+			if ((int32_t)(now - entry->nextRelease) >= 0)
+			{
+				entry->nextRelease = now + entry->periodCycles;
+			}
+		}
+	}
+	else
+	{
+		entry->release = now;
+		entry->released = true;
+	}
+}
+
+
+static void updateStats(taskEntry_t * entry, uint32_t start, uint32_t end)
+{
+	schedulerStats_t * stats = &entry->stats;
+	uint32_t runCycles = end - start;
+	uint32_t responseCycles = end - entry->release;
+
+	stats->runs++;
+	stats->lastRunCycles = runCycles;
+
+	if (runCycles > stats->maxRunCycles)
+	{
+		stats->maxRunCycles = runCycles;
+	}
+
+	if (responseCycles > stats->maxResponseCycles)
+	{
+		stats->maxResponseCycles = responseCycles;
+	}
+
+	if (entry->deadlineCycles)
+	{
+		int32_t slack = (int32_t)(entry->deadlineCycles - responseCycles);
+
+		if (slack < stats->minSlackCycles)
+		{
+			stats->minSlackCycles = slack;
+		}
+
+		if (slack < 0)
+		{
+			stats->misses++;
+		}
+	}
+}
+
+
+static void clearStats(schedulerStats_t * stats)
+{
+	stats->runs = 0;
+	stats->lastRunCycles = 0;
+	stats->maxRunCycles = 0;
+	stats->maxResponseCycles = 0;
+	stats->minSlackCycles = NO_SLACK_YET;
+	stats->misses = 0;
+}
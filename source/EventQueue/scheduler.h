@@ -0,0 +1,103 @@
+/***************************************************************************//**
+  @file     scheduler.h
+  @brief    Cooperative scheduler of the main loop, priorities and deadlines
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+#ifndef _scheduler_H_
+#define _scheduler_H_
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS		8
+#endif
+
+#define SCHEDULER_NO_DEADLINE	0		// deadlineUs of a task that can wait forever
+#define SCHEDULER_ERROR			-1
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+/*
+ * A task is released when ready() says so, every periodUs if it has no ready(), or always if it has neither.
+ * Nothing preempts a task: the longest run of any of them is how late every other one can start.
+ */
+typedef struct
+{
+	void (*run)(void);
+	bool (*ready)(void);		// NULL: periodic
+	uint32_t periodUs;			// 0 (and no ready): whenever nothing else is released
+	uint32_t deadlineUs;		// From the release to the end of the run
+	uint8_t priority;			// 0 runs first, the earliest deadline first within a priority
+} schedulerTask_t;
+
+// In cycles of the core, the DWT counter
+typedef struct
+{
+	uint32_t runs;
+	uint32_t lastRunCycles;
+	uint32_t maxRunCycles;
+	uint32_t maxResponseCycles;		// From the release to the end of the run, the wait included
+	int32_t minSlackCycles;			// Deadline left at the end of the worst run, negative if it was missed
+	uint32_t misses;
+} schedulerStats_t;
+
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+
+/**
+ * @brief Removes every task and starts the cycle counter, after the clocks are set
+ */
+void Scheduler_Init (void);
+
+
+/**
+ * @brief Adds a task. A periodic one is released right away, the others when they are ready
+ * @param task description of the task, copied
+ * @return id of the task, SCHEDULER_ERROR if there is no room for it
+ */
+int8_t Scheduler_AddTask(const schedulerTask_t * task);
+
+
+/**
+ * @brief Runs the released task of highest priority, one per call. Gets called continously
+ * @return true if a task was run
+ */
+bool Scheduler_Run(void);
+
+
+/**
+ * @brief Gets the run time and slack measured for a task
+ * @param id given by Scheduler_AddTask
+ * @param stats here we store them
+ * @return false if there is no such task
+ */
+bool Scheduler_GetStats(int8_t id, schedulerStats_t * stats);
+
+
+/**
+ * @brief Starts measuring again, for every task
+ */
+void Scheduler_ResetStats(void);
+
+
+/*******************************************************************************
+ ******************************************************************************/
+
+#endif // _scheduler_H_
@@ -97,6 +97,10 @@ state AUDIO_PLAYER_STATE[] =
 		//Buttons
 		{Player_ToggleMusic, PLAYPAUSE_EV, AUDIO_PLAYER_STATE},
 		//{Player_Stop, STOP_EV, AUDIO_PLAYER_STATE},
+		{Player_ToggleKaraoke, STOP_LKP_EV, AUDIO_PLAYER_STATE},
+		{Player_StartScrub, PLAYPAUSE_LKP_EV, SCRUB_STATE},
+		{Player_CycleCrossfade, NEXT_LKP_EV, AUDIO_PLAYER_STATE},
+		{Player_CycleTempo, PREV_LKP_EV, AUDIO_PLAYER_STATE},
 		{Player_PlayNextSong, NEXT_EV, AUDIO_PLAYER_STATE},
 		{Player_PlayPreviousSong, PREV_EV, AUDIO_PLAYER_STATE},
 
@@ -116,12 +120,36 @@ state AUDIO_PLAYER_STATE[] =
 		{Player_MP3_UpdateAll, FILL_BUFFER_EV, AUDIO_PLAYER_STATE},
 		{Player_PlayNextSong, NEXT_SONG_EV, AUDIO_PLAYER_STATE},
 		{Player_PlayPreviousSong, PREV_SONG_EV, AUDIO_PLAYER_STATE},
+		{Player_InitState, SONG_CHANGED_EV, AUDIO_PLAYER_STATE},
 
 		//End of Table
 		{pass, END_TABLE, AUDIO_PLAYER_STATE}
 };
 
 
+state SCRUB_STATE[] =
+{
+		//Buttons, any of them goes back to normal playback from here
+		{Player_StopScrub, PLAYPAUSE_EV, AUDIO_PLAYER_STATE},
+		{Player_StopScrub, STOP_EV, AUDIO_PLAYER_STATE},
+
+		//Encoder, turning it changes the speed
+		{Player_StopScrub, ENCODER_PRESS_EV, AUDIO_PLAYER_STATE},
+		{Player_ScrubFaster, ENCODER_RIGHT_EV, SCRUB_STATE},
+		{Player_ScrubSlower, ENCODER_LEFT_EV, SCRUB_STATE},
+
+		//SD
+		{Idle_InitState, SD_OUT_EV, IDLE_STATE},
+
+		//Audio
+		{Player_MP3_UpdateAll, FILL_BUFFER_EV, SCRUB_STATE},
+		{Player_ScrubNextSong, NEXT_SONG_EV, AUDIO_PLAYER_STATE},
+
+		//End of Table
+		{pass, END_TABLE, SCRUB_STATE}
+};
+
+
 state EQUALIZER_FROM_FILES_STATE[] =
 {
 		//Buttons
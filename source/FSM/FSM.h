@@ -47,6 +47,7 @@ extern state INIT_STATE[];
 extern state IDLE_STATE[];
 extern state FILE_SELECT_STATE[];
 extern state AUDIO_PLAYER_STATE[];
+extern state SCRUB_STATE[];
 extern state EQUALIZER_STATE[];
 extern state EQUALIZER_FROM_PLAYER_STATE[];
 extern state EQUALIZER_FROM_FILES_STATE[];
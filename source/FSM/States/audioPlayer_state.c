@@ -39,6 +39,10 @@ static int volumeTimerID = -1;
 
 static void printFileInfo(void);
 static void showVolume(void);
+static void showKaraoke(void);
+static void showScrub(void);
+static void showCrossfade(void);
+static void showTempo(void);
 static void stopShowingVolume(void);
 
 
@@ -95,6 +99,83 @@ void Player_DecVolume(void)
 }
 
 
+void Player_ToggleKaraoke(void)
+{
+	mp3Handler_toggleKaraoke();
+	showKaraoke();
+}
+
+
+void Player_CycleCrossfade(void)
+{
+	// Off, 2 s, 5 s, 10 s
+	static const uint8_t lengths[] = {0, 2, 5, 10};
+	uint8_t current = mp3Handler_getCrossfade();
+	uint8_t i = 0;
+
+	while ((i < sizeof(lengths) - 1) && (lengths[i] <= current))
+	{
+		i++;
+	}
+
+	mp3Handler_setCrossfade((lengths[i] > current) ? lengths[i] : lengths[0]);
+	showCrossfade();
+}
+
+
+void Player_CycleTempo(void)
+{
+	// 1x, 1.25x, 1.5x, 2x, 0.5x, 0.75x, back to 1x
+	static const uint8_t tempos[] = {100, 125, 150, 200, 50, 75};
+	uint8_t current = mp3Handler_getTempo();
+	uint8_t i = 0;
+
+	while ((i < sizeof(tempos) - 1) && (tempos[i] != current))
+	{
+		i++;
+	}
+
+	mp3Handler_setTempo(tempos[(i + 1) % sizeof(tempos)]);
+	showTempo();
+}
+
+
+void Player_StartScrub(void)
+{
+	mp3Handler_startScrub();
+	showScrub();
+}
+
+
+void Player_ScrubFaster(void)
+{
+	mp3Handler_scrubFaster();
+	showScrub();
+}
+
+
+void Player_ScrubSlower(void)
+{
+	mp3Handler_scrubSlower();
+	showScrub();
+}
+
+
+void Player_StopScrub(void)
+{
+	mp3Handler_stopScrub();
+	printFileInfo();
+}
+
+
+void Player_ScrubNextSong(void)
+{
+	// The scrub ran into the end of the song, continue normally with the next one
+	mp3Handler_stopScrub();
+	Player_PlayNextSong();
+}
+
+
 void Player_MP3_UpdateAll(void)
 {
 	mp3Handler_updateAll();
@@ -169,6 +250,117 @@ static void showVolume(void)
 }
 
 
+static void showKaraoke(void)
+{
+	// Shares the volume timer, the song info comes back when it expires
+	if(!showingVolume)
+	{
+		volumeTimerID = Timer_AddCallback(stopShowingVolume, VOLUME_TIME, true);
+	}
+	else
+	{
+		Timer_Reset(volumeTimerID);
+	}
+
+	OLED_Clear();
+	OLED_Refresh();
+	OLED_write_Text(20, 22, mp3Handler_getKaraoke() ? "Karaoke: ON" : "Karaoke: OFF");
+	showingVolume = true;
+}
+
+
+static void showScrub(void)
+{
+	// Stays on screen while scrubbing, the volume timer would bring the song info back
+	if(showingVolume)
+	{
+		Timer_Delete(volumeTimerID);
+		showingVolume = false;
+	}
+
+	char str2wrt[14] = "Scrub: >> x";
+	uint8_t speed = mp3Handler_getScrubSpeed();
+	uint8_t len = strlen(str2wrt);
+
+	if (speed/10 != 0)
+	{
+		str2wrt[len++] = 0x30 + speed/10;
+	}
+	str2wrt[len++] = 0x30 + speed%10;
+	str2wrt[len] = 0;
+
+	OLED_Clear();
+	OLED_Refresh();
+	OLED_write_Text(20, 22, (char*)str2wrt);
+}
+
+
+static void showCrossfade(void)
+{
+	// Shares the volume timer, like the karaoke message
+	if(!showingVolume)
+	{
+		volumeTimerID = Timer_AddCallback(stopShowingVolume, VOLUME_TIME, true);
+	}
+	else
+	{
+		Timer_Reset(volumeTimerID);
+	}
+
+	char str2wrt[16] = "Crossfade: OFF";
+	uint8_t seconds = mp3Handler_getCrossfade();
+
+	if (seconds)
+	{
+		uint8_t len = strlen("Crossfade: ");
+
+		if (seconds/10 != 0)
+		{
+			str2wrt[len++] = 0x30 + seconds/10;
+		}
+		str2wrt[len++] = 0x30 + seconds%10;
+		str2wrt[len++] = 's';
+		str2wrt[len] = 0;
+	}
+
+	OLED_Clear();
+	OLED_Refresh();
+	OLED_write_Text(20, 22, (char*)str2wrt);
+	showingVolume = true;
+}
+
+
+static void showTempo(void)
+{
+	// Shares the volume timer, like the crossfade message
+	if(!showingVolume)
+	{
+		volumeTimerID = Timer_AddCallback(stopShowingVolume, VOLUME_TIME, true);
+	}
+	else
+	{
+		Timer_Reset(volumeTimerID);
+	}
+
+	char str2wrt[16] = "Tempo: ";
+	uint8_t percent = mp3Handler_getTempo();
+	uint8_t len = strlen("Tempo: ");
+
+	// x.yy
+	str2wrt[len++] = 0x30 + percent/100;
+	str2wrt[len++] = '.';
+	str2wrt[len++] = 0x30 + (percent/10)%10;
+	str2wrt[len++] = 0x30 + percent%10;
+	str2wrt[len++] = 'x';
+	str2wrt[len] = 0;
+
+	OLED_Clear();
+	OLED_Refresh();
+	OLED_write_Text(20, 22, (char*)str2wrt);
+	showingVolume = true;
+}
+
+
 static void stopShowingVolume(void)
 {
 	showingVolume = false;
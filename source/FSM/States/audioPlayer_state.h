@@ -22,6 +22,16 @@ void Player_PlayPreviousSong(void);
 void Player_IncVolume(void);
 void Player_DecVolume(void);
 
+void Player_ToggleKaraoke(void);
+void Player_CycleCrossfade(void);
+void Player_CycleTempo(void);
+
+void Player_StartScrub(void);
+void Player_ScrubFaster(void);
+void Player_ScrubSlower(void);
+void Player_StopScrub(void);
+void Player_ScrubNextSong(void);
+
 void Player_MP3_UpdateAll(void);
 
 void Player_Off(void);
@@ -19,10 +19,10 @@
  *
  * 	In this way, when the DAC buffer empties again, the new 16 bytes will be loaded.
  *
- * 	When the activeBuffer reaches its end, the backBuffer is loaded as the new activeBuffer.
- * 	A variable that indicates that the backBuffer is free is then set true, and a function
- * 	that retreives this value is to be used to indicate that the backBuffer should be loaded with new
- * 	data.
+ * 	When the activeBuffer reaches its end, the next committed slot of the queue is loaded as the new
+ * 	activeBuffer. The slots are not copied: the caller acquires a free one, writes the DAC samples in
+ * 	place and commits it. When the queue falls below the low watermark, AudioPlayer_NeedsRefill is true
+ * 	until it is back at the high one. If no slot was committed in time, the DAC plays silence until one is.
  *
  *	We are counting on that the DMA interrupt subroutine that updates the source adress and the
  *	new DMA configuration will last less than the time that the DAC takes to transfer all its 16
@@ -123,16 +123,31 @@ static edma_handle_t audioPlayer_EDMA_Handle;                             /* Edm
 static edma_transfer_config_t audioPlayer_transferConfig;                 /* Edma transfer config. */
 static volatile uint32_t sampleIndex = 0; 							/* Index of the g_dacDataArray array. */
 
-// Buffers
-static int16_t buffers[2][AUDIO_PLAYER_BUFF_SIZE];
-static int16_t * activeBuffer = buffers[0];					// Active has the current playing sound
-static int16_t * backBuffer= buffers[1];					// Back has the next frame of sound to be played
+// Queue of buffers, the active one and the ones committed after it
+static uint16_t buffers[AUDIO_PLAYER_QUEUE_SLOTS][AUDIO_PLAYER_BUFF_SIZE];
+static uint32_t bufferSampleRates[AUDIO_PLAYER_QUEUE_SLOTS];
+static uint32_t activeSampleRate = 0;						// The PDB is only reprogrammed when it changes
+static uint32_t bufferSizes[AUDIO_PLAYER_QUEUE_SLOTS];
 
-static uint32_t backBufferSampleRate;
+static uint8_t activeSlot = 0;								// playedSlots % AUDIO_PLAYER_QUEUE_SLOTS, only the DMA interrupt uses it
+static uint16_t * activeBuffer = buffers[0];				// Active has the current playing sound
 static uint32_t activeBufferSize = AUDIO_PLAYER_BUFF_SIZE;
-static uint32_t nextBufferSize = AUDIO_PLAYER_BUFF_SIZE;
 
-static bool backBufferFree = false;
+// Slots committed and played since the song was loaded, only the main loop writes the first and only the
+// DMA interrupt the second. The difference is the fill of the queue, without disabling interrupts.
+// The silence of LoadSong is in slot 0, the n-th slot committed after it goes to (n + 1) % AUDIO_PLAYER_QUEUE_SLOTS
+static volatile uint32_t committedSlots = 0;
+static volatile uint32_t playedSlots = 0;
+
+static volatile bool refilling = false;						// Below the low watermark, until back at the high one
+static volatile uint32_t refillStartCycles = 0;
+static volatile bool starved = false;						// The DAC is waiting for a slot
+static volatile bool songEnded = false;						// Nothing follows the last slot committed, until the next song
+
+static volatile uint32_t underruns = 0;
+static volatile uint8_t minFill = AUDIO_PLAYER_QUEUE_SLOTS;
+static uint32_t maxRefillCycles = 0;
+
 static bool pause = false;
 static bool stop = true;
 
@@ -162,32 +177,52 @@ void AudioPlayer_Init(void)
 
 	// Initialize DAC.
 	DAC_Configuration();
+
+#if AUDIO_PLAYER_FIXED_RATE
+	// Once, every slot plays at this rate
+	AudioPlayer_UpdateSampleRate(AUDIO_PLAYER_FIXED_RATE);
+#endif
 }
 
 
-void AudioPlayer_LoadSong(uint16_t * firstSongFrame, uint16_t _sampleRate, uint32_t _activeBufferSize)
+void AudioPlayer_LoadSong(uint32_t _sampleRate)
 {
-	memcpy(activeBuffer, firstSongFrame, AUDIO_PLAYER_BUFF_SIZE * sizeof(uint16_t));
+	// The DMA must not take a slot while the queue is emptied
+	uint32_t irq = DisableGlobalIRQ();
 
-	backBufferFree = true;
-	sampleIndex = 0;
+	// One buffer of silence in slot 0, the first frames of the song go to the queue after it
+	activeSlot = 0;
+	activeBuffer = buffers[0];
 
-	backBufferSampleRate = _sampleRate;
+	for (uint32_t i = 0; i < AUDIO_PLAYER_BUFF_SIZE; i++)
+	{
+		activeBuffer[i] = DAC_ZERO_VOLT_VALUE;
+	}
 
-	activeBufferSize = _activeBufferSize;
+	committedSlots = 0;
+	playedSlots = 0;
+	sampleIndex = 0;
 
-	AudioPlayer_UpdateSampleRate(backBufferSampleRate);
-}
+	activeBufferSize = AUDIO_PLAYER_BUFF_SIZE;
 
+	// Filling a whole queue is a refill too
+	refilling = true;
+	refillStartCycles = DWT->CYCCNT;
+	starved = false;
+	songEnded = false;
 
-void AudioPlayer_setSampleRate(uint32_t _sampleRate)
-{
-	backBufferSampleRate = _sampleRate;
+	EnableGlobalIRQ(irq);
+
+#if !AUDIO_PLAYER_FIXED_RATE
+	AudioPlayer_UpdateSampleRate(_sampleRate);
+#endif
 }
 
 
 void AudioPlayer_UpdateSampleRate(uint32_t _sampleRate)
 {
+	activeSampleRate = _sampleRate;
+
 	// PDB_Configuration
     pdb_config_t pdbConfigStruct;
     pdb_dac_trigger_config_t pdbDacTriggerConfigStruct;
@@ -216,29 +251,92 @@ void AudioPlayer_UpdateSampleRate(uint32_t _sampleRate)
 }
 
 
-audioPlayerError_t AudioPlayer_UpdateBackBuffer(uint16_t * newBackBuffer, uint32_t _sampleRate, uint32_t _nextBufferSize)
+uint16_t * AudioPlayer_AcquireBuffer(void)
 {
-	if(backBufferFree)
+	uint32_t fill = committedSlots - playedSlots;
+
+	// The active slot is never free, the DMA does not touch the others until they are committed
+	if (fill >= AUDIO_PLAYER_QUEUE_SLOTS - 1)
 	{
-		memcpy(backBuffer, newBackBuffer, AUDIO_PLAYER_BUFF_SIZE * sizeof(uint16_t));
-		backBufferFree = false;
+		return NULL;
+	}
+
+	// Only from the counter of the main loop, the interrupt may move on meanwhile
+	return buffers[(committedSlots + 1) % AUDIO_PLAYER_QUEUE_SLOTS];
+}
 
-		// Update the backBuffer
-		backBufferSampleRate = _sampleRate;
 
-		nextBufferSize = _nextBufferSize;
-		return AP_NO_ERROR;
+audioPlayerError_t AudioPlayer_CommitBuffer(uint32_t _sampleRate, uint32_t _bufferSize)
+{
+	uint32_t fill = committedSlots - playedSlots;
+
+	if (fill >= AUDIO_PLAYER_QUEUE_SLOTS - 1)
+	{
+		return AP_ERROR_QUEUE_FULL;
 	}
-	else
+
+	uint8_t slot = (committedSlots + 1) % AUDIO_PLAYER_QUEUE_SLOTS;
+
+	bufferSampleRates[slot] = AUDIO_PLAYER_FIXED_RATE ? AUDIO_PLAYER_FIXED_RATE : _sampleRate;
+	bufferSizes[slot] = (_bufferSize > AUDIO_PLAYER_BUFF_SIZE) ? AUDIO_PLAYER_BUFF_SIZE : _bufferSize;
+
+	if (songEnded)
 	{
-		return AP_ERROR_BB_NOT_FREE;
+		// The next song goes on from the same queue, its refill starts now and not when the last one drained it
+		songEnded = false;
+		refillStartCycles = DWT->CYCCNT;
 	}
+
+	// Last, the DMA may take it as soon as it is counted
+	committedSlots++;
+
+	if (refilling && (fill + 1 >= AUDIO_PLAYER_HIGH_WATERMARK))
+	{
+		uint32_t cycles = DWT->CYCCNT - refillStartCycles;
+		if (cycles > maxRefillCycles)
+		{
+			maxRefillCycles = cycles;
+		}
+
+		refilling = false;
+	}
+
+	return AP_NO_ERROR;
+}
+
+
+bool AudioPlayer_NeedsRefill(void)
+{
+	return refilling;
+}
+
+
+uint8_t AudioPlayer_GetFill(void)
+{
+	return committedSlots - playedSlots;
+}
+
+
+void AudioPlayer_SongEnded(void)
+{
+	songEnded = true;
+}
+
+
+void AudioPlayer_GetStats(audioPlayerStats_t * stats)
+{
+	stats->underruns = underruns;
+	stats->minFill = minFill;
+	stats->fill = committedSlots - playedSlots;
+	stats->maxRefillCycles = maxRefillCycles;
 }
 
 
-bool AudioPlayer_IsBackBufferFree(void)
+void AudioPlayer_ResetStats(void)
 {
-	return backBufferFree;
+	underruns = 0;
+	minFill = AUDIO_PLAYER_QUEUE_SLOTS;
+	maxRefillCycles = 0;
 }
 
 
@@ -399,23 +497,61 @@ static void Edma_Callback(edma_handle_t *handle, void *userData, bool transferDo
     	// This should allow playing any sampleRate (MPEG2 and MPEG3 have different MP3_FRAME_SIZES)
     	if (sampleIndex >= activeBufferSize)
 		{
-    		// If the activeBuffer was completely transferred
-			sampleIndex = 0;
-
-			// Load backBuffer as new activeBuffer
-			// and clear backBuffer
-			void * temp = activeBuffer;
-			activeBuffer = backBuffer;
-			backBuffer = temp;
-			backBufferFree = true;
-
-			activeBufferSize = nextBufferSize;
-
-			// Update the sampleRate with the one loaded in the backBuffer
-			AudioPlayer_UpdateSampleRate(backBufferSampleRate);
+    		uint32_t fill = committedSlots - playedSlots;
+
+    		if (fill == 0)
+    		{
+    			// Nothing was committed in time, silence until something is. Counted once per gap,
+    			// not after the end of a song: nothing is committed until the next one loads
+    			if (!starved)
+    			{
+    				starved = true;
+
+    				if (!songEnded)
+    				{
+    					underruns++;
+    					minFill = 0;
+    				}
+    			}
+
+    			srcAdd = muteAudioBuffer;
+    		}
+    		else
+    		{
+				// If the activeBuffer was completely transferred, the next slot of the queue is the new activeBuffer
+				sampleIndex = 0;
+				starved = false;
+
+				playedSlots++;
+				activeSlot = playedSlots % AUDIO_PLAYER_QUEUE_SLOTS;
+				activeBuffer = buffers[activeSlot];
+				activeBufferSize = bufferSizes[activeSlot];
+
+				// Slots left after this one
+				fill--;
+				if ((fill < minFill) && !songEnded)
+				{
+					minFill = fill;
+				}
+
+				if (!refilling && (fill < AUDIO_PLAYER_LOW_WATERMARK))
+				{
+					refilling = true;
+					refillStartCycles = DWT->CYCCNT;
+				}
+
+				// Update the sampleRate with the one loaded in the slot, never with a fixed rate
+				if (bufferSampleRates[activeSlot] != activeSampleRate)
+				{
+					AudioPlayer_UpdateSampleRate(bufferSampleRates[activeSlot]);
+				}
+    		}
 		}
 
-		srcAdd = (activeBuffer + sampleIndex);
+    	if (srcAdd == NULL)
+    	{
+    		srcAdd = (activeBuffer + sampleIndex);
+    	}
     }
 
 	// EDMA:
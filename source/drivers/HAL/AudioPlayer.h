@@ -19,9 +19,18 @@
 typedef enum audioPlayerError
 {
     AP_NO_ERROR,
-    AP_ERROR_BB_NOT_FREE
+    AP_ERROR_QUEUE_FULL
 } audioPlayerError_t;
 
+// Health of the buffer queue, since AudioPlayer_ResetStats
+typedef struct
+{
+	uint32_t underruns;			// Times the DAC ran out of samples and played silence, the end of a song aside
+	uint8_t minFill;			// Fewest slots left committed when the DMA took one, 0 after an underrun
+	uint8_t fill;				// Slots committed now, after the playing one
+	uint32_t maxRefillCycles;	// Longest time from the low watermark back to the high one (DWT cycles, 120 MHz)
+} audioPlayerStats_t;
+
 /*******************************************************************************
 * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
 ******************************************************************************/
@@ -29,6 +38,30 @@ typedef enum audioPlayerError
 
 #define DAC_ZERO_VOLT_VALUE		2048
 
+// Rate the DAC always runs at, the handler resamples every song to it. 0 reprograms the PDB to the rate of each buffer.
+// 48 kHz is an exact divider of the 60 MHz bus (1250), 44.1 kHz is not
+#ifndef AUDIO_PLAYER_FIXED_RATE
+#define AUDIO_PLAYER_FIXED_RATE		48000
+#endif
+
+// Buffers of AUDIO_PLAYER_BUFF_SIZE samples, the playing one included. 4 is about 72 ms of slack at 48 kHz
+#ifndef AUDIO_PLAYER_QUEUE_SLOTS
+#define AUDIO_PLAYER_QUEUE_SLOTS	4
+#endif
+
+// The refill starts when fewer slots than the low watermark are committed, and lasts until the high one
+#ifndef AUDIO_PLAYER_LOW_WATERMARK
+#define AUDIO_PLAYER_LOW_WATERMARK	2
+#endif
+
+#ifndef AUDIO_PLAYER_HIGH_WATERMARK
+#define AUDIO_PLAYER_HIGH_WATERMARK	(AUDIO_PLAYER_QUEUE_SLOTS - 1)
+#endif
+
+#if (AUDIO_PLAYER_HIGH_WATERMARK > AUDIO_PLAYER_QUEUE_SLOTS - 1) || (AUDIO_PLAYER_LOW_WATERMARK > AUDIO_PLAYER_HIGH_WATERMARK)
+#error "The watermarks must fit in the slots after the playing one, low <= high"
+#endif
+
 
 /*******************************************************************************
 * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
@@ -39,12 +72,10 @@ typedef enum audioPlayerError
 void AudioPlayer_Init(void);
 
 /*!
- *@brief Loads a song's first frame and sampleRate
- *@param firstSongFrame first song's frame's samples.
- *@param song's sample rate.
- *@param activeBufferSize: frame size.
+ *@brief Starts a song: the playing buffer becomes silence and the queue is emptied, to be refilled.
+ *@param sampleRate: sample rate of the silence, until the first frame is committed. Ignored with AUDIO_PLAYER_FIXED_RATE.
  */
-void AudioPlayer_LoadSong(uint16_t * firstSongFrame, uint16_t _sampleRate, uint32_t _activeBufferSize);
+void AudioPlayer_LoadSong(uint32_t _sampleRate);
 
 /*!
  *@brief Updates the sample rate that it's being used.
@@ -53,19 +84,47 @@ void AudioPlayer_LoadSong(uint16_t * firstSongFrame, uint16_t _sampleRate, uint3
 void AudioPlayer_UpdateSampleRate(uint32_t _sampleRate);
 
 /*!
- *@brief Checks if the back buffer is free or not, in order to know if it can be filled again or not yet.
- *@return Indication about the back buffer's condition: free or not.
+ *@brief Checks if the queue should be refilled: it fell below the low watermark and is not at the high one yet.
+ *@return true while frames should be committed.
+*/
+bool AudioPlayer_NeedsRefill(void);
+
+/*!
+ *@brief Gets how many slots are committed after the playing one, the time the queue can play without a refill.
+ *@return slots, up to AUDIO_PLAYER_QUEUE_SLOTS - 1.
+*/
+uint8_t AudioPlayer_GetFill(void);
+
+/*!
+ * @brief Gets a free slot of the queue, to write the next DAC samples in place (no copies).
+ * @return the buffer, AUDIO_PLAYER_BUFF_SIZE samples, or NULL if the queue is full.
+*/
+uint16_t * AudioPlayer_AcquireBuffer(void);
+
+/*!
+ * @brief Queues the acquired slot, it plays after the ones committed before.
+ * @param sampleRate of the samples written, ignored with AUDIO_PLAYER_FIXED_RATE.
+ * @param bufferSize: samples written, up to AUDIO_PLAYER_BUFF_SIZE.
+ * @return if there was an error (the queue is full).
+*/
+audioPlayerError_t AudioPlayer_CommitBuffer(uint32_t _sampleRate, uint32_t _bufferSize);
+
+/*!
+ * @brief Tells that the last buffer of the song was committed: the queue drains to silence and that is not
+ *        an underrun. The next commit or LoadSong ends it.
+*/
+void AudioPlayer_SongEnded(void);
+
+/*!
+ * @brief Gets the underrun, fill and refill latency counters of the queue.
+ * @param stats: here we store them.
 */
-bool AudioPlayer_IsBackBufferFree(void);
+void AudioPlayer_GetStats(audioPlayerStats_t * stats);
 
 /*!
- * @brief Updates the back buffer.
- * @param newBackBuffer, new buffer that will fill the back buffer.
- * @param sampleRate needed.
- * @param nextBufferSize: new buffer that will fill the next buffer.
- * @return if there was an error.
+ * @brief Clears the counters of AudioPlayer_GetStats.
 */
-audioPlayerError_t AudioPlayer_UpdateBackBuffer(uint16_t * newBackBuffer, uint32_t _sampleRate, uint32_t _nextBufferSize);
+void AudioPlayer_ResetStats(void);
 
 /*!
  * @brief Reproduces audio using the DAC, from the samples previously saved from the current song.
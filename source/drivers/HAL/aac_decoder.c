@@ -0,0 +1,3889 @@
+/*******************************************************************************
+  @file     aac_decoder.c
+  @brief    AAC-LC decoder for MP4 (.m4a) files, fixed point, mono output
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+ /*******************************************************************************
+  *							INCLUDE HEADER FILES
+  ******************************************************************************/
+
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ff.h"
+#include "fsl_common.h"
+#include "aac_decoder.h"
+
+ /*******************************************************************************
+ *					CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define FILE_SECTOR_SIZE		512		// FatFs sector, reads of whole aligned sectors go straight to our buffer
+
+#define AAC_RING_SIZE			(AAC_READAHEAD_KB * 1024U)	// Power of 2 and whole sectors
+#define AAC_RING_MASK			(AAC_RING_SIZE - 1)
+
+#define AAC_FRAME_LENGTH		1024	// Output samples per frame
+#define AAC_LONG_HALF			1024	// Coefficients of a long window
+#define AAC_SHORT_HALF			128		// Coefficients of each short window
+#define AAC_SHORT_WINDOWS		8
+#define AAC_SHORT_START			448		// First sample of the first short window in the frame
+#define AAC_MAX_CHANNELS		2
+#define AAC_MAX_SFB				51		// Scalefactor bands of a long window, at most (32 kHz)
+#define AAC_MAX_FRAME_BYTES		1536	// Two channels of 6144 bits, the decoder buffer of the standard
+#define AAC_MAX_PULSES			4
+#define AAC_TNS_MAX_ORDER		12		// Of a long window in AAC-LC, 7 for the short ones
+#define AAC_TNS_MAX_FILTERS		8		// Three per long window, one per short one
+#define AAC_SEEK_DECODE			(2 * AAC_FRAME_LENGTH)	// Shorter forward seeks are decoded through
+
+#define AAC_OBJECT_LC			2		// Audio object types of the AudioSpecificConfig
+#define AAC_OBJECT_SBR			5
+#define AAC_OBJECT_PS			29
+#define AAC_FIRST_RATE_INDEX	3		// 48 kHz, the faster ones are not supported
+
+// Syntactic elements of a raw data block
+#define ID_SCE					0
+#define ID_CPE					1
+#define ID_FIL					6
+#define ID_DSE					4
+#define ID_END					7
+
+#define ONLY_LONG_SEQUENCE		0
+#define LONG_START_SEQUENCE		1
+#define EIGHT_SHORT_SEQUENCE	2
+#define LONG_STOP_SEQUENCE		3
+
+#define SINE_WINDOW				0		// Window shapes
+#define KBD_WINDOW				1
+
+#define ZERO_HCB				0		// Section codebooks besides the spectral ones (1 to 11)
+#define ESC_HCB					11
+#define RESERVED_HCB			12
+#define NOISE_HCB				13
+#define INTENSITY_HCB2			14
+#define INTENSITY_HCB			15
+#define ESC_FLAG				16		// Value of ESC_HCB followed by an escape sequence
+
+#define SF_OFFSET				100		// Scalefactor of a gain of 1
+#define NOISE_OFFSET			90		// The noise energies start at global gain - 90
+#define NOISE_PCM_OFFSET		256		// The first one is a 9 bit value instead of a codeword
+#define SF_DIFF_OFFSET			60		// Scalefactor codeword of a difference of 0
+
+// Coefficients are stored multiplied by 2 / N (the scale of the IMDCT of the standard) and by 2^AAC_PCM_SHIFT:
+// the unscaled DCT-IV then gives PCM in Q20 of full scale, 11 bits of headroom for the sums, like vorbis_decoder.c
+#define AAC_PCM_SHIFT			5
+#define POW43_FRAC				13		// pow43Table, Q13
+#define LONG_QUARTERS			(-4 * (POW43_FRAC + 11 - 1 - AAC_PCM_SHIFT))	// 2^(x / 4) exponent of 2 / 2048 * 2^5 / 2^13
+#define SHORT_QUARTERS			(-4 * (POW43_FRAC + 8 - 1 - AAC_PCM_SHIFT))	// 2 / 256 * 2^5 / 2^13
+#define POW43_MAX				8191	// Largest quantized value
+
+#define TNS_LPC_FRAC			20		// The step-up of 12 reflection coefficients can reach 924
+
+#define MP4_MAX_DEPTH			8		// Box nesting followed
+#define MP4_MAX_DESCRIPTOR		4		// Bytes of a descriptor size
+
+#define AAC_TAG_SIZE			48		// Longer tags are cut
+#define AAC_TAG_COUNT			5		// audio_tag_t up to the track number, ReplayGain is in freeform items
+
+// Estimate for a stereo file at 48 kHz with short windows and TNS: two inverse MDCTs and the filters, per 1152 samples
+#define AAC_WORST_CASE_CYCLES	350000
+
+// Sine from 0 to pi / 2 of the FFT twiddles, the same table as vorbis_decoder.c
+#define SINE_HALF_BLOCK			1024
+#define SINE_QUARTER			(2 * SINE_HALF_BLOCK)
+
+#define Q31_ONE					0x7FFFFFFF
+#define MULT31(a, b)			((int32_t)(((int64_t)(a) * (b)) >> 31))
+#define DOT31(a, b, c, d)		((int32_t)(((int64_t)(a) * (b) + (int64_t)(c) * (d) + (1 << 30)) >> 31))	// Rounded, the FFT sums would add up the truncation
+
+#define BOX_TYPE(a, b, c, d)	(((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+#define READ_BE16(p)			(((uint32_t)(p)[0] << 8) | (p)[1])
+#define READ_BE32(p)			(((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (p)[3])
+#define RING_BYTE(st, offset)	((st)->ring[(offset) & AAC_RING_MASK])
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+// Scalefactor bands and TNS limits of a sample rate
+typedef struct
+{
+	uint32_t	sampleRate;
+	const uint16_t * longOffsets;
+	const uint16_t * shortOffsets;
+	uint8_t		longBands;
+	uint8_t		shortBands;
+	uint8_t		tnsLongBands;		// Highest band the filters reach
+	uint8_t		tnsShortBands;
+} aacRate_t;
+
+// Sample table of the file (stsz, stco, co64 or stsc). Read from the file as it is used, a few entries at a time
+typedef struct
+{
+	uint32_t	offset;				// File offset of the first entry
+	uint32_t	count;
+	uint32_t	first;				// Index of the first cached entry
+	uint16_t	cached;				// Entries in the cache, 0 if none
+	uint8_t		entrySize;			// 4 (stsz, stco), 8 (co64) or 12 (stsc)
+	uint8_t		cache[AAC_TABLE_CACHE_BYTES];
+} aacTable_t;
+
+// Where a frame is in the file
+typedef struct
+{
+	uint32_t	offset;				// File offset
+	uint32_t	chunk;				// Its chunk, 0 based (stco entry)
+	uint32_t	inChunk;			// Frames of the chunk before it
+	uint32_t	run;				// stsc entry of the chunk
+} aacPosition_t;
+
+// AAC track found while reading the boxes
+typedef struct
+{
+	bool		isAudio;			// hdlr
+	bool		isAac;				// esds with an AudioSpecificConfig we can play
+	uint8_t		rateIndex;
+	uint32_t	timescale;			// mdhd
+	int64_t		mediaTime;			// elst, where the song starts, in the mdhd timescale. 0 without an edit list
+	uint64_t	editDuration;		// elst, in the mvhd timescale. 0 without an edit list
+	uint32_t	fixedSize;			// stsz sample size, 0 if they are in the table
+	uint32_t	sizesOffset;
+	uint32_t	sizesCount;
+	uint32_t	chunksOffset;
+	uint32_t	chunksCount;
+	uint8_t		chunkEntrySize;		// 4 for stco, 8 for co64
+	uint32_t	runsOffset;
+	uint32_t	runsCount;
+} mp4Track_t;
+
+typedef struct
+{
+	uint32_t	movieTimescale;		// mvhd
+	bool		trackFound;
+	mp4Track_t	track;				// The one being read
+	mp4Track_t	chosen;				// The first AAC one
+} mp4Parse_t;
+
+// The ring index of a byte is its file offset & AAC_RING_MASK, as in flac_decoder.c
+typedef struct
+{
+	FIL			file;
+	bool		fileIsOpened;
+	uint32_t	sampleRate;
+	const aacRate_t * rate;
+	uint32_t	dataEnd;			// File size
+	char		tags[AAC_TAG_COUNT][AAC_TAG_SIZE];	// Empty if the file does not have it
+
+	// Ring
+	uint32_t	position;			// File offset of the next byte
+	uint32_t	readPosition;		// File offset of the next sector to read
+	bool		fileEnded;			// true once f_read returned less than asked for
+
+	// Sample tables and index
+	aacTable_t	sizes;				// stsz, empty if every frame is fixedSize
+	aacTable_t	chunks;				// stco or co64
+	aacTable_t	runs;				// stsc
+	uint32_t	fixedSize;
+	uint32_t	frameCount;
+	uint8_t		indexShift;			// The index has the position of every 2^indexShift-th frame
+	aacPosition_t index[AAC_INDEX_ENTRIES];
+
+	// Frame to read
+	aacPosition_t cursor;
+	uint32_t	frame;
+	uint32_t	chunkFrames;		// Frames of the chunk of the cursor
+	uint32_t	nextRunChunk;		// First chunk of the next stsc entry, UINT32_MAX if none
+
+	// Timeline: frame n outputs samples 1024 n to 1024 n + 1023, the first startSkip are the encoder delay
+	uint32_t	startSkip;
+	uint64_t	endSample;			// Where the song ends
+	uint64_t	sample;				// Of the next output sample
+	uint32_t	skipSamples;		// Decoded and dropped, after seeks and at the start
+
+	// Synthesis
+	uint8_t		previousShape[AAC_MAX_CHANNELS];	// Window shape of the last frame of each channel
+	int32_t		overlap[AAC_LONG_HALF];	// Windowed second half of the last frame, Q20
+
+	uint8_t		ring[AAC_RING_SIZE] __attribute__((aligned(4)));
+} aacStream_t;
+
+_Static_assert(sizeof(aacStream_t) <= AUDIO_DECODER_STREAM_SIZE, "aacStream_t does not fit in the memory of a stream");
+
+// ics_info
+typedef struct
+{
+	uint8_t		windowSequence;
+	uint8_t		windowShape;
+	uint8_t		maxSfb;
+	uint8_t		bands;				// Of the window size
+	uint8_t		groups;
+	uint8_t		groupLength[AAC_SHORT_WINDOWS];
+	const uint16_t * swbOffset;
+} aacIcsInfo_t;
+
+typedef struct
+{
+	uint8_t		window;
+	uint8_t		order;
+	bool		downward;
+	uint16_t	start;				// Coefficients of the window filtered
+	uint16_t	end;
+	int32_t		parcor[AAC_TNS_MAX_ORDER];	// Reflection coefficients, Q31
+} aacTnsFilter_t;
+
+// One channel of the element being decoded
+typedef struct
+{
+	aacIcsInfo_t info;
+	uint8_t		globalGain;
+	uint8_t		codebook[AAC_SHORT_WINDOWS][AAC_MAX_SFB];	// Per group and band
+	int16_t		scalefactor[AAC_SHORT_WINDOWS][AAC_MAX_SFB];	// Intensity positions and noise energies too
+	uint8_t		pulseCount;
+	uint8_t		pulseStart;
+	uint8_t		pulseOffset[AAC_MAX_PULSES];
+	uint8_t		pulseAmplitude[AAC_MAX_PULSES];
+	uint8_t		tnsCount;
+	aacTnsFilter_t tns[AAC_TNS_MAX_FILTERS];
+} aacChannel_t;
+
+// What a frame is decoded in, nothing of it is kept from one call to the next. In the scratch of the decoder layer
+typedef struct
+{
+	aacChannel_t channels[AAC_MAX_CHANNELS];
+	int32_t		spectrum[AAC_MAX_CHANNELS][AAC_LONG_HALF];
+	uint8_t		msUsed[AAC_SHORT_WINDOWS][AAC_MAX_SFB];
+	uint8_t		frameData[AAC_MAX_FRAME_BYTES + 4] __attribute__((aligned(4)));
+} aacScratch_t;
+
+_Static_assert(sizeof(aacScratch_t) <= AUDIO_DECODER_SCRATCH_SIZE, "aacScratch_t does not fit in the scratch");
+
+// Window slopes of a block, as in vorbis_decoder.c
+typedef struct
+{
+	uint32_t	leftStart;
+	uint32_t	leftEnd;
+	uint32_t	rightStart;
+	uint32_t	rightEnd;
+	const int32_t * leftSlope;
+	const int32_t * rightSlope;
+} aacSlopes_t;
+
+// Window of a frame of one channel
+typedef struct
+{
+	bool		eightShort;
+	aacSlopes_t	first;				// The long window, or the first short one
+	aacSlopes_t	others;				// The other seven short ones
+} aacWindow_t;
+
+/*******************************************************************************
+ *      FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief  Reads the boxes of a range of the file, following the ones that lead to the sample tables and tags.
+* @param  st: stream, positioned at the first box.
+* @param  ctx: what was found so far.
+* @param  end: file offset where the range ends.
+* @param  depth: nesting of the range.
+* @returns  false if the file ended before the range.
+*/
+static bool parseBoxes(aacStream_t * st, mp4Parse_t * ctx, uint32_t end, uint8_t depth);
+
+/*
+* @brief  Reads the size and type of the next box.
+* @param  st: stream at the box.
+* @param  end: end of the box that has it.
+* @param  type: here we store the type.
+* @param  boxEnd: here we store the file offset of its end.
+* @returns  false if there is none or it does not fit.
+*/
+static bool readBoxHeader(aacStream_t * st, uint32_t end, uint32_t * type, uint32_t * boxEnd);
+
+/*
+* @brief  Reads the mp4a sample description of a stsd box, and the AudioSpecificConfig of its esds.
+* @param  st: stream at the contents of the stsd.
+* @param  track: here we store the rate and if it is AAC-LC.
+* @param  end: end of the stsd.
+*/
+static void parseSampleDescription(aacStream_t * st, mp4Track_t * track, uint32_t end);
+
+/*
+* @brief  Reads the descriptors of an esds box, down to the AudioSpecificConfig.
+* @param  st: stream at the contents of the esds, after its version.
+* @param  track: here we store the rate and if it is AAC-LC.
+* @param  end: end of the esds.
+*/
+static void parseEsds(aacStream_t * st, mp4Track_t * track, uint32_t end);
+
+/*
+* @brief  Reads the tag and size of an MPEG-4 descriptor.
+* @param  st: stream at the descriptor.
+* @param  size: here we store the size of its contents.
+* @returns  the tag, -1 if the file ended.
+*/
+static int32_t readDescriptor(aacStream_t * st, uint32_t * size);
+
+/*
+* @brief  Reads an AudioSpecificConfig.
+* @param  config: its bytes.
+* @param  length: how many.
+* @param  track: here we store the sample rate index, if it is one we can play.
+* @returns  true if it is mono or stereo AAC-LC (the core of HE-AAC too) at 8 to 48 kHz.
+*/
+static bool parseAudioConfig(const uint8_t * config, uint32_t length, mp4Track_t * track);
+
+/*
+* @brief  Reads a bit field of an AudioSpecificConfig, MSB first.
+* @param  config: its bytes.
+* @param  length: how many.
+* @param  bit: position of the field, moved past it.
+* @param  n: bits, up to 24.
+* @returns  the value, with 0s past the end.
+*/
+static uint32_t configBits(const uint8_t * config, uint32_t length, uint32_t * bit, uint8_t n);
+
+/*
+* @brief  Reads the iTunes tags of an ilst box: title, artist, album, year and track number.
+* @param  st: stream at the contents of the ilst.
+* @param  end: end of the ilst.
+*/
+static void parseTags(aacStream_t * st, uint32_t end);
+
+/*
+* @brief  Reads bytes at the stream position.
+* @param  st: stream.
+* @param  data: here we store them.
+* @param  count: how many.
+* @returns  false if the file ended first.
+*/
+static bool readBytes(aacStream_t * st, uint8_t * data, uint32_t count);
+
+/*
+* @brief  Takes the sample tables of the track and walks them once, keeping the position of every 2^indexShift-th frame.
+* @param  st: stream.
+* @param  track: the AAC track of the file.
+* @returns  false if the tables are empty or do not add up.
+*/
+static bool buildIndex(aacStream_t * st, const mp4Track_t * track);
+
+/*
+* @brief  Moves the cursor to a frame, from the closest index entry before it.
+* @param  st: stream.
+* @param  frame: frame number.
+*/
+static void restoreFrame(aacStream_t * st, uint32_t frame);
+
+/*
+* @brief  Moves the cursor to the next frame.
+* @param  st: stream.
+* @param  size: of the current frame.
+* @returns  false if the chunks ended.
+*/
+static bool advanceCursor(aacStream_t * st, uint32_t size);
+
+/*
+* @brief  Reads the stsc entry of the cursor: frames per chunk, and where the next entry starts.
+* @param  st: stream.
+*/
+static void loadRun(aacStream_t * st);
+
+/*
+* @brief  Gets a field of a sample table entry, reading the part of the table it is in if it is not cached.
+* @param  st: stream.
+* @param  table: sizes, chunks or runs.
+* @param  index: entry.
+* @param  field: 32 bit word of the entry.
+* @returns  the value, 0 if it can't be read.
+*/
+static uint32_t tableRead(aacStream_t * st, aacTable_t * table, uint32_t index, uint8_t field);
+
+/*
+* @brief  Size of a frame, from the stsz box.
+*/
+static inline uint32_t frameSize(aacStream_t * st, uint32_t frame);
+
+/*
+* @brief  Copies a frame to frameData, zero padded.
+* @param  st: stream.
+* @param  offset: file offset.
+* @param  size: bytes.
+* @returns  false if it does not fit or the file ended.
+*/
+static bool readFrame(aacStream_t * st, uint32_t offset, uint32_t size);
+
+/*
+* @brief  Fills the free part of the ring buffer with whole sectors.
+* @param  st: stream.
+* @returns  bytes read.
+*/
+static uint32_t fillRing(aacStream_t * st);
+
+/*
+* @brief  Positions the file at the start of the sector of an offset, the ring restarts there.
+* @param  st: stream.
+* @param  filePosition: file offset of the next byte to read.
+*/
+static void seekAligned(aacStream_t * st, uint32_t filePosition);
+
+/*
+* @brief  Moves the stream position, keeping the ring if the offset is still in it.
+* @param  st: stream.
+* @param  filePosition: file offset of the next byte to read.
+*/
+static void ringSeek(aacStream_t * st, uint32_t filePosition);
+
+/*
+* @brief  Next byte of the file, through the ring.
+* @param  st: stream.
+* @returns  the byte, -1 at the end of the file.
+*/
+static int32_t ringByte(aacStream_t * st);
+
+/*
+* @brief  Decodes the raw data block in frameData, up to its first audio element (SCE or CPE).
+* @param  st: stream.
+* @param  count: here we store the channels decoded.
+* @returns  false if it is damaged or has no audio element.
+*/
+static bool decodeRawBlock(aacStream_t * st, uint8_t * count);
+
+/*
+* @brief  Decodes a channel pair element: both channels and their stereo tools.
+* @param  st: stream.
+* @returns  false if it is damaged.
+*/
+static bool decodeChannelPair(aacStream_t * st);
+
+/*
+* @brief  Decodes an individual channel stream to spectrum, dequantized (but before TNS).
+* @param  st: stream.
+* @param  ch: channel of the element.
+* @param  commonWindow: ics_info was read with the channel pair.
+* @returns  false if it is damaged.
+*/
+static bool decodeIcs(aacStream_t * st, uint8_t ch, bool commonWindow);
+
+/*
+* @brief  Reads ics_info.
+* @param  st: stream.
+* @param  info: here we store it.
+* @returns  false if it is not AAC-LC or the bands do not exist.
+*/
+static bool parseIcsInfo(aacStream_t * st, aacIcsInfo_t * info);
+
+/*
+* @brief  Reads the section data: the codebook of each band.
+* @param  c: channel.
+* @returns  false if it is damaged.
+*/
+static bool parseSections(aacChannel_t * c);
+
+/*
+* @brief  Reads the scalefactors, intensity positions and noise energies.
+* @param  c: channel.
+* @returns  false if it is damaged.
+*/
+static bool parseScalefactors(aacChannel_t * c);
+
+/*
+* @brief  Reads the TNS filters of each window.
+* @param  st: stream.
+* @param  c: channel.
+*/
+static void parseTns(aacStream_t * st, aacChannel_t * c);
+
+/*
+* @brief  Decodes the quantized spectrum of a channel, in window order.
+* @param  c: channel.
+* @param  spec: here we store the values.
+* @returns  false if a codeword is not valid.
+*/
+static bool decodeSpectrum(const aacChannel_t * c, int32_t * spec);
+
+/*
+* @brief  Dequantizes a spectrum in place: x^(4/3) 2^((sf - 100) / 4), and the noise of the PNS bands.
+* @param  c: channel.
+* @param  spec: quantized values.
+*/
+static void dequantize(const aacChannel_t * c, int32_t * spec);
+
+/*
+* @brief  Fills a band of one window with noise of the given energy (PNS).
+* @param  data: first coefficient.
+* @param  width: coefficients.
+* @param  quarters: energy and scale, 2^(quarters / 4).
+*/
+static void fillNoise(int32_t * data, uint32_t width, int32_t quarters);
+
+/*
+* @brief  Mid/side and intensity stereo of a channel pair.
+* @param  msMaskPresent: 0 none, 1 per band (msUsed), 2 all the bands.
+*/
+static void applyStereo(uint8_t msMaskPresent);
+
+/*
+* @brief  Applies the TNS filters of a channel to its spectrum.
+* @param  c: channel.
+* @param  spec: dequantized spectrum.
+*/
+static void applyTns(const aacChannel_t * c, int32_t * spec);
+
+/*
+* @brief  Mixes the channels to mono, runs the inverse MDCT and overlaps it with the last frame.
+* @param  st: stream.
+* @param  count: channels decoded, 0 outputs the end of the last frame (damaged frames).
+* @param  out: here we store the 1024 PCM samples.
+*/
+static void synthesize(aacStream_t * st, uint8_t count, short * out);
+
+/*
+* @brief  Window slopes of a frame.
+* @param  window: here we store them.
+* @param  sequence: window sequence.
+* @param  previousShape: shape of the last frame, for the rising slope.
+* @param  shape: shape of this frame.
+*/
+static void buildWindow(aacWindow_t * window, uint8_t sequence, uint8_t previousShape, uint8_t shape);
+
+/*
+* @brief  Sample of the windowed inverse MDCT of a frame.
+* @param  u: DCT-IV of the spectrum (one per short window for eight short).
+* @param  i: sample, 0 to 2047.
+* @param  window: window of the frame.
+* @returns  the sample, Q20.
+*/
+static int32_t frameSample(const int32_t * u, uint32_t i, const aacWindow_t * window);
+
+/*
+* @brief  Sample of one windowed inverse MDCT block.
+* @param  u: DCT-IV, half values.
+* @param  i: sample, 0 to 2 half - 1.
+* @param  half: coefficients of the block.
+* @param  w: slopes.
+*/
+static inline int32_t windowedSample(const int32_t * u, uint32_t i, uint32_t half, const aacSlopes_t * w);
+
+/*
+* @brief  In place DCT-IV, unscaled, the inverse MDCT before unfolding (same as vorbis_decoder.c).
+* @param  data: half coefficients, replaced by the output.
+* @param  half: power of 2, 128 or 1024.
+*/
+static void imdct(int32_t * data, uint32_t half);
+
+/*
+* @brief  In place radix-2 complex FFT.
+* @param  data: points pairs of real and imaginary parts.
+* @param  points: power of 2.
+*/
+static void fft(int32_t * data, uint32_t points);
+
+/*
+* @brief  Multiplies by 2^(quarters / 4), rounded and saturated.
+* @param  value: magnitude up to 2^31.
+* @param  quarters: exponent, in quarters.
+*/
+static int32_t scaleQuarters(int32_t value, int32_t quarters);
+
+/*
+* @brief  x^(4/3), Q13.
+* @param  x: quantized magnitude, up to 8191.
+*/
+static inline int32_t pow43(uint32_t x);
+
+/*
+* @brief  Reads bits of frameData, MSB first. Past its end it reads 0s and bitsEnded tells.
+* @param  n: up to 25.
+*/
+static uint32_t bitsRead(uint32_t n);
+
+/*
+* @brief  The next 25 bits of frameData, left aligned, without reading them.
+*/
+static inline uint32_t bitsPeek(void);
+
+/*
+* @brief  Skips bits of frameData.
+*/
+static inline void bitsSkip(uint32_t n);
+
+/*
+* @brief  true once more bits were read than the frame has.
+*/
+static inline bool bitsEnded(void);
+
+/*
+* @brief  Decodes a Huffman codeword.
+* @param  tree: two children per node, node 0 is the root: > 0 node, <= 0 -(entry + 1).
+* @returns  the entry, -1 past the end of the frame.
+*/
+static int32_t decodeCodeword(const int16_t * tree);
+
+/*
+* @brief  Reads the escape sequence of a value of the escape codebook.
+* @returns  the magnitude, -1 if it is not valid.
+*/
+static int32_t decodeEscape(void);
+
+static bool aacProbe(const uint8_t * header, uint32_t length);
+static bool aacGetChannels(decoder_stream_t id, uint8_t * channelCount);
+static bool aacSeek(int32_t samples);
+static uint32_t aacGetRemainingMs(void);
+static bool aacPromote(void);
+static bool aacGetTag(audio_tag_t tag, char ** value);
+static void aacSetCenterCancel(bool enable);
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH GLOBAL SCOPE
+ *****************************************************************************/
+const audio_codec_t aacCodec =
+{
+	.name = "AAC",
+	.extension = ".m4a",
+	.worstCaseCycles = AAC_WORST_CASE_CYCLES,
+
+	.init = AacDecoder_Init,
+	.probe = aacProbe,
+	.open = AacDecoder_LoadFile,
+	.decodeFrame = AacDecoder_DecodeFrame,
+	.getChannels = aacGetChannels,
+	.seek = aacSeek,
+	.getRemainingMs = aacGetRemainingMs,
+	.promote = aacPromote,
+	.close = AacDecoder_Close,
+
+	.readAhead = AacDecoder_ReadAhead,
+	.getTag = aacGetTag,
+	.setCenterCancel = aacSetCenterCancel,
+};
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH LOCAL SCOPE
+ *****************************************************************************/
+// In the memory of the decoder layer, NULL while there is no file of ours on the stream
+static aacStream_t *	playing = NULL;
+static aacStream_t *	incoming = NULL;
+static bool				centerCancel;			// Stereo files are output as (L - R) / 2 instead of L + R
+
+// Element being decoded, in aacScratch_t. The spectra are the quantized values, then dequantized, then the inverse MDCT
+static aacChannel_t * channels;
+static int32_t (* spectrum)[AAC_LONG_HALF];
+static uint8_t (* msUsed)[AAC_MAX_SFB];
+
+// Frame being decoded, also in aacScratch_t, and the bit reader over it
+static uint8_t * frameData;
+static uint32_t bitPosition;
+static uint32_t bitLength;
+
+static uint32_t noiseState = 1;					// Random generator of the PNS bands
+
+// Indexed by the codebook: tuple size, values of each element and the smallest one (unsigned ones have sign bits)
+static const uint8_t bookDimension[ESC_HCB + 1] = { 0, 4, 4, 4, 4, 2, 2, 2, 2, 2, 2, 2 };
+static const uint8_t bookModulo[ESC_HCB + 1] = { 0, 3, 3, 3, 3, 9, 9, 8, 8, 13, 13, 17 };
+static const int8_t bookMinimum[ESC_HCB + 1] = { 0, -1, -1, 0, 0, -4, -4, 0, 0, 0, 0, 0 };
+
+// 2^(i / 4), Q30
+static const int32_t pow2QuarterTable[4] = { 1073741824, 1276901417, 1518500250, 1805811301 };
+
+// Huffman trees of the scalefactor and spectral codebooks of ISO/IEC 14496-3, same layout as the vorbis_decoder.c ones
+static const int16_t scalefactorTree[240] =
+{
+	-61, 1, 92, 2, 90, 3, 87, 4, 83, 5, 79, 6,
+	74, 7, 72, 8, 67, 9, 62, 10, 56, 11, 52, 12,
+	44, 13, 14, 22, 18, 15, 16, 98, 17, 106, -1, 105,
+	42, 19, 21, 20, -2, -3, -20, -4, 29, 23, 24, 35,
+	27, 25, 26, 33, -120, -5, 28, 109, -11, -6, 110, 30,
+	113, 31, 32, 34, -119, -7, -8, -16, -9, -10, 39, 36,
+	37, 38, -12, -13, -15, -14, 40, 41, -17, -19, -21, -18,
+	-24, 43, -91, -22, 49, 45, 48, 46, -89, 47, -26, -23,
+	-29, -25, 51, 50, -27, -28, -87, -30, 55, 53, 97, 54,
+	-31, -32, -85, -33, 60, 57, 58, 59, -86, -34, -37, -35,
+	-84, 61, -38, -36, 66, 63, 65, 64, -83, -39, -82, -40,
+	-81, -41, 70, 68, 71, 69, -43, -42, -46, -44, -45, -80,
+	73, 94, -75, -47, 78, 75, 77, 76, -74, -48, -73, -49,
+	-50, -72, 82, 80, -52, 81, -71, -51, -53, -70, 86, 84,
+	-68, 85, -54, -69, -67, -55, 89, 88, -56, -66, -57, -65,
+	-63, 91, -58, -64, -60, 93, -62, -59, 95, 96, -77, -76,
+	-78, -79, -88, -90, 99, 102, 100, 101, -98, -92, -93, -94,
+	103, 104, -95, -96, -97, -105, -99, -100, 107, 108, -101, -102,
+	-103, -118, -104, -121, 116, 111, 119, 112, -111, -106, 114, 115,
+	-107, -108, -109, -110, 117, 118, -112, -113, -114, -115, -116, -117
+};
+
+static const int16_t spectralTree1[160] =
+{
+	-41, 1, 38, 2, 19, 3, 33, 4, 28, 5, 11, 6,
+	16, 7, 25, 8, 9, 14, 10, 58, -1, -75, 12, 55,
+	13, 59, -22, -2, 15, 76, -19, -3, 23, 17, 18, 46,
+	-12, -4, 52, 20, 21, 44, 22, 73, -5, -29, 24, 78,
+	-6, -10, 50, 26, 32, 27, -73, -7, 47, 29, 42, 30,
+	31, 77, -8, -30, -81, -9, 34, 36, 74, 35, -11, -69,
+	37, 41, -13, -67, 39, 60, 40, 71, -68, -14, -15, -31,
+	72, 43, -26, -16, 45, 62, -17, -45, -18, -72, 48, 63,
+	49, 75, -74, -20, 51, 57, -61, -21, 53, 65, 54, 70,
+	-59, -23, 79, 56, -24, -80, -25, -57, -63, -27, -28, -54,
+	69, 61, -44, -32, -71, -33, 67, 64, -34, -56, 66, 68,
+	-35, -43, -48, -36, -77, -37, -42, -38, -39, -47, -40, -50,
+	-66, -46, -65, -49, -53, -51, -62, -52, -55, -79, -60, -58,
+	-76, -64, -70, -78
+};
+
+static const int16_t spectralTree2[160] =
+{
+	38, 1, 20, 2, 9, 3, 16, 4, 29, 5, 6, 13,
+	7, 24, -21, 8, -57, -1, 46, 10, 57, 11, 61, 12,
+	-16, -2, 27, 14, 15, 79, -55, -3, 35, 17, 18, 59,
+	26, 19, -6, -4, 21, 32, 22, 64, 37, 23, -65, -5,
+	56, 25, -81, -7, -8, -18, 45, 28, -9, -73, 30, 66,
+	55, 31, -10, -52, 42, 33, 34, 76, -31, -11, 36, 49,
+	-12, -56, -13, -59, 39, 51, -41, 40, -68, 41, -14, -42,
+	44, 43, -29, -15, -17, -51, -63, -19, 73, 47, 75, 48,
+	-20, -34, -74, 50, -60, -22, 62, 52, 53, 70, -50, 54,
+	-35, -23, -54, -24, -25, -27, 78, 58, -72, -26, 60, 74,
+	-28, -70, -30, -80, 69, 63, -32, -44, 68, 65, -69, -33,
+	67, 77, -58, -36, -37, -71, -38, -40, 72, 71, -49, -39,
+	-47, -43, -45, -67, -64, -46, -48, -66, -77, -53, -78, -61,
+	-62, -76, -75, -79
+};
+
+static const int16_t spectralTree3[160] =
+{
+	-1, 1, 2, 4, 3, 10, -28, -2, 11, 5, 6, 13,
+	52, 7, 55, 8, -38, 9, -55, -3, -10, -4, 12, 27,
+	-37, -5, 14, 22, 15, 17, 16, 20, -6, -64, 18, 29,
+	32, 19, -67, -7, -49, 21, -8, -17, 34, 23, 24, 38,
+	25, 53, 56, 26, -9, -18, 28, 31, -13, -11, 33, 30,
+	-19, -12, -31, -14, -46, -15, -22, -16, 44, 35, 57, 36,
+	37, 63, -35, -20, 48, 39, 46, 40, 50, 41, 42, 65,
+	-54, 43, -21, -61, 67, 45, -23, -43, 47, 59, -25, -24,
+	49, 61, -26, 70, 51, 68, -27, -80, -29, -40, 69, 54,
+	-30, -56, -41, -32, -65, -33, -44, 58, -47, -34, 60, 78,
+	-36, -74, 62, 64, -39, -59, -68, -42, -45, -77, 66, 71,
+	-48, 75, -58, -50, -71, -51, -76, -52, -73, -53, 77, 72,
+	74, 73, -57, 76, -72, -60, -62, -69, -75, -63, -66, 79,
+	-70, -79, -81, -78
+};
+
+static const int16_t spectralTree4[160] =
+{
+	1, 4, 32, 2, 54, 3, -37, -1, 5, 8, 16, 6,
+	31, 7, -2, -11, 14, 9, 17, 10, 11, 24, 22, 12,
+	55, 13, -3, 21, 15, 62, -4, -10, -5, -31, 34, 18,
+	56, 19, 30, 20, -22, -6, -19, -7, 37, 23, -30, -8,
+	48, 25, 38, 26, 45, 27, 28, 52, 29, 41, -9, -61,
+	-56, -12, -29, -13, 33, 60, -41, -14, 35, 42, -17, 36,
+	-15, -43, -16, -20, 39, 58, 40, 44, -18, -74, -21, -57,
+	43, 61, -23, -33, -24, -62, 75, 46, 79, 47, -25, -73,
+	66, 49, 72, 50, 73, 51, -70, -26, 53, 76, -81, -27,
+	-32, -28, -34, -55, 57, 68, -35, -64, 59, 69, -36, -80,
+	-38, -40, -47, -39, 63, 70, 65, 64, -50, -42, -68, -44,
+	74, 67, -71, -45, -58, -46, -48, -60, 78, 71, -49, -59,
+	-51, -69, -52, -76, -53, -77, -66, -54, -79, 77, -75, -63,
+	-67, -65, -72, -78
+};
+
+static const int16_t spectralTree5[160] =
+{
+	-41, 1, 68, 2, 66, 3, 53, 4, 38, 5, 34, 6,
+	19, 7, 16, 8, 13, 9, 28, 10, 31, 11, 30, 12,
+	-81, -1, 27, 14, 50, 15, -64, -2, 32, 17, 18, 77,
+	-3, -79, 23, 20, 21, 25, 22, 63, -4, -45, 24, 79,
+	-37, -5, 73, 26, -6, -46, -71, -7, 29, 49, -8, -72,
+	-73, -9, -74, -10, 33, 48, -65, -11, 51, 35, 36, 46,
+	37, 62, -12, -66, 42, 39, 40, 44, 41, 64, -13, -53,
+	43, 74, -14, -68, 45, 72, -15, -67, 78, 47, -16, -20,
+	-17, -27, -18, -80, -19, -75, 61, 52, -21, -57, 57, 54,
+	55, 59, 56, 65, -22, -60, 58, 75, -23, -43, 60, 71,
+	-24, -58, -25, -61, -26, -56, -76, -28, -69, -29, -30, -52,
+	70, 67, -31, -51, 69, 76, -32, -50, -49, -33, -34, -48,
+	-47, -35, -54, -36, -38, -44, -59, -39, -42, -40, -55, -63,
+	-70, -62, -78, -77
+};
+
+static const int16_t spectralTree6[160] =
+{
+	60, 1, 47, 2, 32, 3, 28, 4, 15, 5, 12, 6,
+	22, 7, 77, 8, 11, 9, 21, 10, -1, -73, -8, -2,
+	13, 19, 14, 42, -7, -3, 25, 16, 17, 65, 56, 18,
+	-6, -4, 20, 55, -5, -79, -81, -9, 74, 23, -45, 24,
+	-10, -18, 40, 26, 27, 41, -65, -11, 36, 29, 30, 43,
+	-70, 31, -12, -26, 45, 33, 38, 34, 35, 57, -13, -53,
+	37, 67, -68, -14, 39, 64, -15, -69, -16, -71, -17, -46,
+	-63, -19, 76, 44, -56, -20, 54, 46, -21, -61, 48, 51,
+	-31, 49, 75, 50, -24, -22, 52, 58, 53, 72, -23, -34,
+	-57, -25, -75, -27, -28, -78, -47, -29, 68, 59, -30, -43,
+	69, 61, 62, 63, -32, -51, -33, -49, -67, -35, 73, 66,
+	-36, -37, -38, -44, -52, -39, 71, 70, -40, -42, -41, -50,
+	-59, -48, -54, -76, -77, -55, -58, -60, -62, -66, 78, 79,
+	-64, -74, -72, -80
+};
+
+static const int16_t spectralTree7[126] =
+{
+	-1, 1, 2, 3, -9, -2, 4, 7, -10, 5, 28, 6,
+	-17, -3, 8, 11, 29, 9, 10, 31, -4, 38, 12, 18,
+	13, 15, 39, 14, -5, -33, 16, 34, 40, 17, -43, -6,
+	19, 23, 41, 20, 36, 21, 22, 47, -31, -7, 43, 24,
+	25, 51, 50, 26, -32, 27, -57, -8, -18, -11, 30, 37,
+	-26, -12, 32, 33, -13, -34, -14, -42, 54, 35, -15, -36,
+	-51, -16, -19, -25, -20, -27, -28, -21, -35, -22, 46, 42,
+	-44, -23, 48, 44, 45, 59, -52, -24, -30, -29, -49, -37,
+	49, 55, -58, -38, -46, -39, 52, 57, 56, 53, -61, -40,
+	-50, -41, -59, -45, -54, -47, 58, 60, -48, -62, -60, -53,
+	61, 62, -63, -55, -56, -64
+};
+
+static const int16_t spectralTree8[126] =
+{
+	1, 6, 29, 2, 5, 3, -19, 4, -1, -17, -11, -2,
+	7, 10, 8, 32, 9, 31, -3, -26, 11, 17, 12, 14,
+	13, 50, -4, -36, 35, 15, 51, 16, -45, -5, 37, 18,
+	19, 22, 20, 47, 21, 56, -53, -6, 40, 23, 24, 26,
+	57, 25, -7, -62, 62, 27, 59, 28, -8, -64, -10, 30,
+	-18, -9, -12, -27, 42, 33, 34, 43, -13, -35, 44, 36,
+	-14, -44, 45, 38, 39, 52, -50, -15, 41, 54, -16, -47,
+	-20, 49, -21, -25, -42, -22, 55, 46, -23, -51, 48, 60,
+	-59, -24, -28, -34, -29, -43, -30, -37, 53, 58, -31, -52,
+	-32, 61, -38, -33, -39, -58, -49, -40, -46, -41, -48, -57,
+	-54, -60, -55, -61, -63, -56
+};
+
+static const int16_t spectralTree9[336] =
+{
+	-1, 1, 2, 3, -14, -2, 4, 7, -15, 5, 53, 6,
+	-27, -3, 8, 16, 9, 12, 74, 10, -17, 11, -40, -4,
+	54, 13, 56, 14, 90, 15, -5, -53, 17, 26, 18, 22,
+	57, 19, 112, 20, -56, 21, -6, -33, 59, 23, 24, 77,
+	25, 79, -93, -7, 27, 34, 28, 65, 63, 29, 30, 32,
+	31, 91, -8, -120, 33, 124, -47, -9, 35, 44, 36, 40,
+	83, 37, 38, 69, 39, 125, -10, -146, 71, 41, 94, 42,
+	43, 138, -148, -11, 86, 45, 46, 129, 47, 50, 110, 48,
+	49, 128, -12, -163, 121, 51, 52, 145, -13, -151, -28, -16,
+	75, 55, -18, -54, -31, -19, 76, 58, -20, -44, 60, 102,
+	61, 62, -66, -21, -45, -22, 64, 114, -23, -94, 80, 66,
+	67, 92, 68, 116, -24, -96, 106, 70, -111, -25, 117, 72,
+	73, 163, -38, -26, -41, -29, -30, -42, -67, -32, 78, 104,
+	-46, -34, -107, -35, 81, 136, 82, 135, -36, -71, 119, 84,
+	-110, 85, -134, -37, 87, 96, 107, 88, 89, 109, -39, -124,
+	-55, -43, -48, -59, 105, 93, -49, -145, 95, 126, -50, -75,
+	97, 99, 127, 98, -51, -76, 100, 139, 141, 101, -162, -52,
+	103, 113, -106, -57, -58, -119, -61, -60, -158, -62, 155, 108,
+	-63, -87, -125, -64, 111, 120, -137, -65, -68, -80, -69, -81,
+	115, 123, -79, -70, -84, -72, 152, 118, -73, -97, -74, -118,
+	-101, -77, 122, 142, -138, -78, -82, -108, -132, -83, -122, -85,
+	-86, -112, -144, -88, -89, -157, 130, 146, 131, 133, 143, 132,
+	-164, -90, 150, 134, -104, -91, -105, -92, 137, 144, -95, -133,
+	-98, -160, 140, 164, -149, -99, -113, -100, -102, -126, -139, -103,
+	-121, -109, -114, -127, 147, 156, 148, 153, 149, 151, -115, -140,
+	-116, -152, -117, -128, -123, -135, 154, 159, -129, -130, -131, -136,
+	157, 160, 158, 165, -141, -153, -142, -166, 167, 161, 162, 166,
+	-143, -155, -159, -147, -161, -150, -165, -154, -156, -169, -167, -168
+};
+
+static const int16_t spectralTree10[336] =
+{
+	6, 1, 2, 19, 3, 15, 4, 13, 59, 5, -1, -56,
+	55, 7, 8, 10, 9, 103, -2, -17, 86, 11, 12, 87,
+	-27, -3, 102, 14, -4, -57, 60, 16, 89, 17, 111, 18,
+	-80, -5, 20, 25, 63, 21, 22, 68, 23, 66, 121, 24,
+	-93, -6, 26, 31, 27, 71, 124, 28, 135, 29, 105, 30,
+	-36, -7, 32, 39, 75, 33, 34, 79, 35, 37, 36, 107,
+	-8, -113, 129, 38, -149, -9, 40, 44, 108, 41, 143, 42,
+	43, 120, -158, -10, 82, 45, 46, 51, 47, 49, 48, 162,
+	-11, -104, 166, 50, -12, -155, 154, 52, 159, 53, 54, 167,
+	-168, -13, 58, 56, -28, 57, -29, -14, -15, -16, -18, -54,
+	88, 61, 62, 104, -19, -67, 64, 91, 65, 122, -20, -46,
+	67, 147, -106, -21, 94, 69, 70, 114, -22, -48, 72, 96,
+	115, 73, 74, 152, -23, -99, 117, 76, 149, 77, 78, 156,
+	-137, -24, 99, 80, 119, 81, -25, -159, 83, 132, 101, 84,
+	-115, 85, -128, -26, -30, -43, -31, -55, -32, -68, 112, 90,
+	-81, -33, 113, 92, 93, 123, -47, -34, 95, 138, -60, -35,
+	127, 97, 98, 106, -37, -132, 100, 142, -148, -38, -163, -39,
+	-44, -40, -42, -41, -69, -45, -49, -119, -50, -124, -136, -51,
+	130, 109, 164, 110, -162, -52, -82, -53, -70, -58, -59, 137,
+	-109, -61, 151, 116, -62, -133, 141, 118, -63, -92, -138, -64,
+	-65, -127, -95, -66, -71, -83, -72, -107, 125, 126, -73, -110,
+	-74, 139, 148, 128, -75, -135, -76, -114, 157, 131, -150, -77,
+	133, 145, 165, 134, -103, -78, 136, 140, -120, -79, -84, -94,
+	-85, -97, -98, -86, -87, -121, -88, -105, -102, -89, 144, 161,
+	-90, -118, 146, 153, -91, -140, -108, -96, -100, -134, -146, 150,
+	-101, -147, -111, -122, -112, -123, -116, -165, 158, 155, -157, -117,
+	-145, -125, -126, -160, -129, -142, 163, 160, -130, -156, -139, -131,
+	-144, -141, -166, -143, -161, -151, -152, -164, -153, -154, -167, -169
+};
+
+static const int16_t spectralTree11[576] =
+{
+	1, 13, 2, 6, 3, 4, -1, -19, 71, 5, -2, -36,
+	72, 7, 8, 10, 9, 76, -38, -3, 116, 11, 12, 187,
+	-52, -4, 14, 20, 15, 84, 78, 16, 81, 17, 169, 18,
+	19, 188, -5, -51, 21, 31, 22, 26, 23, 89, 175, 24,
+	202, 25, -6, 228, 27, 94, 28, 132, 191, 29, 93, 30,
+	-174, -7, 32, 38, 33, 102, 67, 34, 35, 98, 36, 141,
+	37, 264, -8, -65, 39, 48, 40, 44, 41, 107, 42, 218,
+	101, 43, -9, -229, 164, 45, 236, 46, 221, 47, -154, -10,
+	110, 49, 50, 54, 51, 62, 253, 52, 252, 53, -11, -217,
+	55, 58, 56, 279, 269, 57, -222, -12, 271, 59, 60, 65,
+	-254, 61, -15, -13, 260, 63, 64, 285, -14, -251, 284, 66,
+	-16, -271, 135, 68, 245, 69, 217, 70, -17, -82, -289, -18,
+	73, 74, -20, -37, 75, 115, -21, -53, -55, 77, -70, -22,
+	79, 119, 118, 80, -23, -89, 82, 167, 150, 83, -24, -85,
+	85, 125, 122, 86, 212, 87, 223, 88, -34, -25, 90, 129,
+	91, 155, 92, 226, -221, -26, -128, -27, 95, 158, 230, 96,
+	97, 214, -191, -28, 204, 99, 274, 100, -29, -81, -30, -230,
+	103, 137, 104, 183, 105, 162, 161, 106, -31, -207, 146, 108,
+	109, 186, -260, -32, 209, 111, 112, 238, 222, 113, 267, 114,
+	-33, -183, -54, -35, 117, 148, -71, -39, -40, -73, 149, 120,
+	171, 121, -41, -104, 123, 151, 286, 124, -281, -42, 172, 126,
+	127, 153, 128, 262, -43, -93, 130, 177, 131, 229, -127, -44,
+	179, 133, 134, 157, -45, -160, 136, 194, -225, -46, 138, 143,
+	139, 206, 140, 247, -196, -47, 273, 142, -48, -227, 196, 144,
+	266, 145, -49, -115, 208, 147, -50, -261, -72, -56, -57, -90,
+	-106, -58, 152, 189, -122, -59, 227, 154, -60, -86, 190, 156,
+	-61, -142, -62, -112, 159, 181, 160, 193, -129, -63, -189, -64,
+	163, 195, -131, -66, 233, 165, 166, 256, -101, -67, 168, 287,
+	-68, -278, 199, 170, -69, -75, -74, -105, 173, 200, 174, 216,
+	-76, -284, 270, 176, -125, -77, 243, 178, -78, -111, 242, 180,
+	-159, -79, 182, 203, -80, -190, 184, 224, 185, 265, -243, -83,
+	-165, -84, -87, -88, -91, -102, -108, -92, -94, -238, 198, 192,
+	-95, -144, -96, -172, -273, -97, -98, -99, 248, 197, -180, -100,
+	-103, -158, -107, -279, 241, 201, -109, -170, -110, -126, -224, -113,
+	205, 255, -147, -114, 207, 232, -116, -181, -206, -117, 249, 210,
+	257, 211, -215, -118, 213, 215, -119, -283, -120, -177, -123, -121,
+	-124, -285, -130, -146, 219, 220, -132, -212, -133, -259, -257, -134,
+	-135, 251, -282, -136, 275, 225, -211, -137, -138, -255, -140, -139,
+	-141, -288, -143, -156, 231, 244, -175, -145, -258, -148, 235, 234,
+	-231, -149, -246, -150, 276, 237, -263, -151, 258, 239, 240, 281,
+	-200, -152, -153, -274, -173, -155, -157, -272, -176, -161, -193, 246,
+	-192, -162, -163, -244, -164, -245, 250, 277, -167, -166, -168, -264,
+	-216, -169, 278, 254, -249, -171, -179, -178, -182, -198, -184, -248,
+	259, 268, -185, -233, 263, 261, -186, -235, -187, -286, -188, -219,
+	-194, -223, -195, -242, -197, -240, -199, -202, -232, -201, -203, -252,
+	-287, -204, 283, 272, -237, -205, -226, -208, -241, -209, -210, -228,
+	-213, -262, -214, -247, -218, -265, 282, 280, -269, -220, -250, -234,
+	-236, -268, -239, -253, -270, -256, -266, -267, -280, -275, -276, -277
+};
+
+static const int16_t * const spectralTrees[ESC_HCB + 1] =
+{
+	NULL, spectralTree1, spectralTree2, spectralTree3, spectralTree4, spectralTree5, spectralTree6,
+	spectralTree7, spectralTree8, spectralTree9, spectralTree10, spectralTree11
+};
+
+// Scalefactor band offsets. 44.1 kHz uses the 48 kHz ones, 22.05 kHz the 24 kHz ones and 12 and 11.025 kHz the 16 kHz ones
+static const uint16_t swbOffsetLong48[50] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 48, 56, 64, 72, 80,
+	88, 96, 108, 120, 132, 144, 160, 176, 196, 216, 240, 264, 292, 320, 352, 384,
+	416, 448, 480, 512, 544, 576, 608, 640, 672, 704, 736, 768, 800, 832, 864, 896,
+	928, 1024
+};
+
+static const uint16_t swbOffsetShort48[15] =
+{
+	0, 4, 8, 12, 16, 20, 28, 36, 44, 56, 68, 80, 96, 112, 128
+};
+
+static const uint16_t swbOffsetLong32[52] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 48, 56, 64, 72, 80,
+	88, 96, 108, 120, 132, 144, 160, 176, 196, 216, 240, 264, 292, 320, 352, 384,
+	416, 448, 480, 512, 544, 576, 608, 640, 672, 704, 736, 768, 800, 832, 864, 896,
+	928, 960, 992, 1024
+};
+
+static const uint16_t swbOffsetLong24[48] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 52, 60, 68, 76,
+	84, 92, 100, 108, 116, 124, 136, 148, 160, 172, 188, 204, 220, 240, 260, 284,
+	308, 336, 364, 396, 432, 468, 508, 552, 600, 652, 704, 768, 832, 896, 960, 1024
+};
+
+static const uint16_t swbOffsetShort24[16] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 36, 44, 52, 64, 76, 92, 108, 128
+};
+
+static const uint16_t swbOffsetLong16[44] =
+{
+	0, 8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 100, 112, 124, 136,
+	148, 160, 172, 184, 196, 212, 228, 244, 260, 280, 300, 320, 344, 368, 396, 424,
+	456, 492, 532, 572, 616, 664, 716, 772, 832, 896, 960, 1024
+};
+
+static const uint16_t swbOffsetShort16[16] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 32, 40, 48, 60, 72, 88, 108, 128
+};
+
+static const uint16_t swbOffsetLong8[41] =
+{
+	0, 12, 24, 36, 48, 60, 72, 84, 96, 108, 120, 132, 144, 156, 172, 188,
+	204, 220, 236, 252, 268, 288, 308, 328, 348, 372, 396, 420, 448, 476, 508, 544,
+	580, 620, 664, 712, 764, 820, 880, 944, 1024
+};
+
+static const uint16_t swbOffsetShort8[16] =
+{
+	0, 4, 8, 12, 16, 20, 24, 28, 36, 44, 52, 60, 72, 88, 108, 128
+};
+
+// From the 48 kHz sampling frequency index on
+static const aacRate_t rates[] =
+{
+	{ 48000, swbOffsetLong48, swbOffsetShort48, 49, 14, 40, 14 },
+	{ 44100, swbOffsetLong48, swbOffsetShort48, 49, 14, 42, 14 },
+	{ 32000, swbOffsetLong32, swbOffsetShort48, 51, 14, 51, 14 },
+	{ 24000, swbOffsetLong24, swbOffsetShort24, 47, 15, 46, 14 },
+	{ 22050, swbOffsetLong24, swbOffsetShort24, 47, 15, 46, 14 },
+	{ 16000, swbOffsetLong16, swbOffsetShort16, 43, 15, 42, 14 },
+	{ 12000, swbOffsetLong16, swbOffsetShort16, 43, 15, 42, 14 },
+	{ 11025, swbOffsetLong16, swbOffsetShort16, 43, 15, 42, 14 },
+	{ 8000, swbOffsetLong8, swbOffsetShort8, 40, 15, 39, 14 },
+	{ 7350, swbOffsetLong8, swbOffsetShort8, 40, 15, 39, 14 },
+};
+
+// Indexed by audio_tag_t
+static const uint32_t tagBoxes[AAC_TAG_COUNT] =
+{
+	BOX_TYPE(0xA9, 'n', 'a', 'm'), BOX_TYPE(0xA9, 'A', 'R', 'T'), BOX_TYPE(0xA9, 'a', 'l', 'b'),
+	BOX_TYPE(0xA9, 'd', 'a', 'y'), BOX_TYPE('t', 'r', 'k', 'n')
+};
+
+// TNS reflection coefficients, sin(c / ((2^(bits - 1) -+ 1 / 2) / (pi / 2))) for c from -2^(bits - 1), Q31
+static const int32_t tnsCoefficients3[8] =
+{
+	-2114858546, -1859775393, -1380375881, -734482665, 0, 931758235, 1678970324, 2093641749
+};
+
+static const int32_t tnsCoefficients4[16] =
+{
+	-2138322861, -2065504841, -1922348530, -1713728946, -1446750378, -1130504462, -775760571, -394599085,
+	0, 446486956, 873460290, 1262259218, 1595891361, 1859775393, 2042378317, 2135719508
+};
+
+// i^(4/3) up to 1024, Q13. Larger values interpolate i / 8 (times 16)
+static const uint32_t pow43Table[1025] =
+{
+	0, 8192, 20643, 35445, 52016, 70041, 89315, 109695,
+	131072, 153360, 176491, 200407, 225060, 250408, 276414, 303048,
+	330281, 358087, 386444, 415331, 444730, 474623, 504995, 535830,
+	567116, 598839, 630988, 663552, 696521, 729884, 763633, 797760,
+	832255, 867112, 902323, 937880, 973778, 1010010, 1046569, 1083451,
+	1120650, 1158160, 1195976, 1234093, 1272507, 1311213, 1350207, 1389485,
+	1429042, 1468875, 1508979, 1549352, 1589990, 1630889, 1672046, 1713458,
+	1755122, 1797035, 1839193, 1881594, 1924236, 1967115, 2010229, 2053576,
+	2097152, 2140956, 2184985, 2229238, 2273710, 2318402, 2363310, 2408432,
+	2453767, 2499312, 2545065, 2591025, 2637190, 2683558, 2730126, 2776895,
+	2823861, 2871023, 2918379, 2965929, 3013670, 3061600, 3109719, 3158025,
+	3206517, 3255192, 3304050, 3353089, 3402309, 3451707, 3501282, 3551033,
+	3600960, 3651060, 3701332, 3751776, 3802390, 3853172, 3904123, 3955241,
+	4006524, 4057972, 4109583, 4161357, 4213293, 4265389, 4317644, 4370058,
+	4422630, 4475359, 4528243, 4581282, 4634476, 4687822, 4741320, 4794970,
+	4848770, 4902720, 4956819, 5011066, 5065460, 5120000, 5174686, 5229517,
+	5284492, 5339610, 5394871, 5450274, 5505818, 5561502, 5617327, 5673290,
+	5729391, 5785631, 5842007, 5898519, 5955168, 6011951, 6068869, 6125920,
+	6183105, 6240422, 6297871, 6355451, 6413162, 6471004, 6528974, 6587074,
+	6645302, 6703658, 6762141, 6820751, 6879487, 6938349, 6997336, 7056447,
+	7115683, 7175042, 7234524, 7294129, 7353855, 7413703, 7473672, 7533762,
+	7593972, 7654301, 7714750, 7775317, 7836002, 7896805, 7957725, 8018762,
+	8079916, 8141185, 8202570, 8264070, 8325685, 8387413, 8449256, 8511212,
+	8573281, 8635462, 8697756, 8760161, 8822678, 8885305, 8948043, 9010892,
+	9073850, 9136917, 9200094, 9263379, 9326772, 9390274, 9453882, 9517598,
+	9581421, 9645351, 9709386, 9773527, 9837774, 9902125, 9966582, 10031143,
+	10095807, 10160576, 10225448, 10290423, 10355500, 10420681, 10485963, 10551347,
+	10616832, 10682419, 10748106, 10813894, 10879782, 10945770, 11011857, 11078044,
+	11144330, 11210715, 11277198, 11343779, 11410458, 11477234, 11544108, 11611079,
+	11678147, 11745311, 11812571, 11879927, 11947378, 12014925, 12082567, 12150304,
+	12218135, 12286061, 12354081, 12422194, 12490401, 12558701, 12627094, 12695580,
+	12764158, 12832829, 12901592, 12970446, 13039392, 13108429, 13177557, 13246776,
+	13316085, 13385485, 13454975, 13524554, 13594224, 13663982, 13733830, 13803767,
+	13873792, 13943906, 14014108, 14084398, 14154776, 14225242, 14295794, 14366435,
+	14437162, 14507975, 14578876, 14649862, 14720935, 14792093, 14863337, 14934667,
+	15006082, 15077582, 15149167, 15220837, 15292591, 15364429, 15436351, 15508358,
+	15580448, 15652621, 15724878, 15797217, 15869640, 15942146, 16014734, 16087404,
+	16160156, 16232991, 16305907, 16378905, 16451984, 16525145, 16598386, 16671709,
+	16745112, 16818596, 16892160, 16965804, 17039528, 17113332, 17187216, 17261179,
+	17335222, 17409343, 17483544, 17557824, 17632182, 17706618, 17781133, 17855726,
+	17930397, 18005146, 18079973, 18154877, 18229858, 18304917, 18380052, 18455265,
+	18530554, 18605920, 18681362, 18756880, 18832475, 18908145, 18983891, 19059713,
+	19135610, 19211583, 19287630, 19363753, 19439951, 19516223, 19592571, 19668992,
+	19745488, 19822058, 19898702, 19975420, 20052211, 20129076, 20206015, 20283027,
+	20360112, 20437270, 20514501, 20591805, 20669181, 20746630, 20824151, 20901745,
+	20979410, 21057148, 21134957, 21212838, 21290791, 21368815, 21446910, 21525076,
+	21603314, 21681622, 21760001, 21838451, 21916971, 21995561, 22074222, 22152953,
+	22231754, 22310625, 22389566, 22468576, 22547656, 22626806, 22706024, 22785312,
+	22864669, 22944094, 23023589, 23103152, 23182783, 23262484, 23342252, 23422089,
+	23501993, 23581966, 23662007, 23742115, 23822291, 23902534, 23982845, 24063223,
+	24143669, 24224181, 24304761, 24385407, 24466120, 24546899, 24627745, 24708658,
+	24789637, 24870682, 24951793, 25032970, 25114213, 25195521, 25276895, 25358335,
+	25439841, 25521411, 25603047, 25684748, 25766514, 25848345, 25930241, 26012201,
+	26094226, 26176316, 26258469, 26340688, 26422970, 26505317, 26587727, 26670202,
+	26752740, 26835342, 26918008, 27000737, 27083530, 27166386, 27249305, 27332287,
+	27415332, 27498440, 27581611, 27664845, 27748142, 27831501, 27914922, 27998406,
+	28081952, 28165561, 28249231, 28332963, 28416758, 28500614, 28584532, 28668511,
+	28752552, 28836655, 28920819, 29005044, 29089330, 29173677, 29258086, 29342555,
+	29427085, 29511676, 29596328, 29681040, 29765813, 29850646, 29935539, 30020493,
+	30105507, 30190581, 30275714, 30360908, 30446162, 30531475, 30616848, 30702280,
+	30787772, 30873323, 30958934, 31044604, 31130332, 31216120, 31301967, 31387873,
+	31473838, 31559862, 31645944, 31732084, 31818284, 31904541, 31990857, 32077231,
+	32163664, 32250154, 32336703, 32423309, 32509974, 32596696, 32683476, 32770313,
+	32857208, 32944161, 33031171, 33118238, 33205363, 33292544, 33379783, 33467079,
+	33554432, 33641842, 33729308, 33816832, 33904412, 33992048, 34079741, 34167491,
+	34255297, 34343159, 34431078, 34519052, 34607083, 34695170, 34783312, 34871511,
+	34959765, 35048075, 35136441, 35224862, 35313339, 35401872, 35490459, 35579102,
+	35667801, 35756554, 35845363, 35934226, 36023145, 36112118, 36201147, 36290230,
+	36379367, 36468560, 36557807, 36647108, 36736464, 36825875, 36915339, 37004858,
+	37094431, 37184058, 37273739, 37363474, 37453263, 37543106, 37633003, 37722953,
+	37812957, 37903015, 37993126, 38083291, 38173509, 38263780, 38354105, 38444483,
+	38534914, 38625398, 38715935, 38806525, 38897168, 38987864, 39078612, 39169414,
+	39260268, 39351174, 39442133, 39533145, 39624209, 39715325, 39806494, 39897714,
+	39988987, 40080312, 40171690, 40263119, 40354600, 40446133, 40537718, 40629354,
+	40721042, 40812782, 40904574, 40996417, 41088311, 41180257, 41272254, 41364303,
+	41456402, 41548553, 41640755, 41733008, 41825313, 41917668, 42010074, 42102530,
+	42195038, 42287596, 42380205, 42472865, 42565575, 42658336, 42751147, 42844009,
+	42936921, 43029883, 43122895, 43215958, 43309070, 43402233, 43495446, 43588709,
+	43682022, 43775384, 43868797, 43962259, 44055771, 44149332, 44242943, 44336604,
+	44430314, 44524073, 44617882, 44711741, 44805648, 44899605, 44993611, 45087666,
+	45181770, 45275923, 45370126, 45464377, 45558677, 45653025, 45747423, 45841869,
+	45936364, 46030908, 46125500, 46220141, 46314830, 46409567, 46504353, 46599187,
+	46694070, 46789001, 46883980, 46979007, 47074082, 47169205, 47264376, 47359595,
+	47454862, 47550177, 47645540, 47740950, 47836408, 47931914, 48027467, 48123068,
+	48218716, 48314412, 48410155, 48505945, 48601783, 48697668, 48793601, 48889580,
+	48985607, 49081681, 49177802, 49273969, 49370184, 49466446, 49562754, 49659109,
+	49755511, 49851960, 49948456, 50044998, 50141586, 50238222, 50334903, 50431631,
+	50528406, 50625227, 50722094, 50819007, 50915967, 51012973, 51110025, 51207123,
+	51304267, 51401457, 51498694, 51595976, 51693304, 51790677, 51888097, 51985562,
+	52083073, 52180630, 52278232, 52375880, 52473573, 52571312, 52669097, 52766926,
+	52864801, 52962722, 53060688, 53158699, 53256755, 53354856, 53453002, 53551194,
+	53649430, 53747712, 53846038, 53944410, 54042826, 54141287, 54239793, 54338344,
+	54436939, 54535579, 54634263, 54732993, 54831766, 54930585, 55029447, 55128354,
+	55227306, 55326302, 55425342, 55524426, 55623555, 55722728, 55821945, 55921206,
+	56020511, 56119860, 56219253, 56318690, 56418171, 56517696, 56617265, 56716877,
+	56816534, 56916234, 57015977, 57115764, 57215595, 57315470, 57415388, 57515349,
+	57615354, 57715403, 57815494, 57915629, 58015808, 58116029, 58216294, 58316602,
+	58416954, 58517348, 58617785, 58718266, 58818789, 58919356, 59019965, 59120617,
+	59221312, 59322050, 59422831, 59523654, 59624521, 59725429, 59826381, 59927375,
+	60028412, 60129491, 60230613, 60331777, 60432983, 60534232, 60635524, 60736857,
+	60838233, 60939651, 61041112, 61142614, 61244159, 61345746, 61447375, 61549046,
+	61650759, 61752513, 61854310, 61956149, 62058030, 62159952, 62261916, 62363922,
+	62465970, 62568059, 62670191, 62772363, 62874578, 62976833, 63079131, 63181470,
+	63283850, 63386272, 63488735, 63591239, 63693785, 63796372, 63899001, 64001670,
+	64104381, 64207133, 64309926, 64412760, 64515636, 64618552, 64721509, 64824507,
+	64927546, 65030627, 65133747, 65236909, 65340112, 65443355, 65546639, 65649964,
+	65753329, 65856735, 65960182, 66063669, 66167197, 66270765, 66374374, 66478023,
+	66581713, 66685443, 66789213, 66893024, 66996875, 67100766, 67204698, 67308669,
+	67412681, 67516733, 67620825, 67724957, 67829130, 67933342, 68037594, 68141886,
+	68246218, 68350590, 68455002, 68559454, 68663945, 68768476, 68873047, 68977658,
+	69082308, 69186998, 69291728, 69396497, 69501306, 69606154, 69711042, 69815969,
+	69920936, 70025942, 70130987, 70236072, 70341196, 70446360, 70551562, 70656804,
+	70762085, 70867406, 70972765, 71078164, 71183601, 71289078, 71394594, 71500149,
+	71605742, 71711375, 71817046, 71922757, 72028506, 72134294, 72240121, 72345987,
+	72451891, 72557835, 72663817, 72769837, 72875896, 72981994, 73088130, 73194305,
+	73300519, 73406770, 73513061, 73619389, 73725757, 73832162, 73938606, 74045088,
+	74151609, 74258168, 74364765, 74471400, 74578073, 74684785, 74791535, 74898323,
+	75005149, 75112012, 75218914, 75325854, 75432832, 75539848, 75646902, 75753994,
+	75861123, 75968291, 76075496, 76182739, 76290020, 76397338, 76504694, 76612088,
+	76719520, 76826989, 76934495, 77042040, 77149622, 77257241, 77364898, 77472592,
+	77580324, 77688093, 77795899, 77903743, 78011625, 78119543, 78227499, 78335492,
+	78443522, 78551590, 78659695, 78767836, 78876015, 78984232, 79092485, 79200775,
+	79309102, 79417467, 79525868, 79634306, 79742781, 79851293, 79959842, 80068428,
+	80177050, 80285710, 80394406, 80503139, 80611908, 80720715, 80829558, 80938438,
+	81047354, 81156307, 81265296, 81374322, 81483385, 81592484, 81701620, 81810792,
+	81920000, 82029245, 82138526, 82247844, 82357198, 82466588, 82576014, 82685477,
+	82794976, 82904512, 83014083, 83123691, 83233334, 83343014, 83452730, 83562482,
+	83672271, 83782095, 83891955, 84001851, 84111783, 84221751, 84331755, 84441795,
+	84551870
+};
+
+// Rising half of the windows, Q31: sin(pi / N (n + 1 / 2)) and Kaiser-Bessel derived (alpha 4 long, 6 short)
+static const int32_t sineLongWindow[AAC_LONG_HALF] =
+{
+	1647099, 4941294, 8235476, 11529640, 14823776, 18117878, 21411936, 24705945,
+	27999895, 31293780, 34587590, 37881320, 41174960, 44468503, 47761942, 51055268,
+	54348475, 57641553, 60934496, 64227295, 67519943, 70812432, 74104755, 77396903,
+	80688869, 83980645, 87272224, 90563597, 93854758, 97145697, 100436408, 103726882,
+	107017112, 110307091, 113596810, 116886262, 120175438, 123464332, 126752935, 130041240,
+	133329239, 136616925, 139904288, 143191323, 146478021, 149764374, 153050374, 156336015,
+	159621287, 162906184, 166190698, 169474820, 172758544, 176041861, 179324764, 182607245,
+	185889297, 189170911, 192452080, 195732795, 199013051, 202292838, 205572149, 208850976,
+	212129312, 215407149, 218684479, 221961294, 225237587, 228513350, 231788575, 235063255,
+	238337382, 241610947, 244883945, 248156366, 251428203, 254699448, 257970095, 261240134,
+	264509558, 267778360, 271046532, 274314066, 277580955, 280847190, 284112765, 287377671,
+	290641901, 293905447, 297168301, 300430456, 303691904, 306952638, 310212649, 313471930,
+	316730474, 319988272, 323245317, 326501602, 329757119, 333011859, 336265816, 339518981,
+	342771348, 346022908, 349273654, 352523578, 355772673, 359020930, 362268343, 365514903,
+	368760603, 372005435, 375249392, 378492466, 381734649, 384975934, 388216313, 391455778,
+	394694323, 397931939, 401168618, 404404353, 407639137, 410872962, 414105819, 417337703,
+	420568604, 423798515, 427027430, 430255339, 433482236, 436708113, 439932963, 443156777,
+	446379549, 449601270, 452821933, 456041530, 459260055, 462477499, 465693854, 468909114,
+	472123270, 475336316, 478548243, 481759043, 484968710, 488177236, 491384614, 494590835,
+	497795892, 500999778, 504202485, 507404005, 510604332, 513803457, 517001373, 520198072,
+	523393547, 526587791, 529780796, 532972554, 536163058, 539352300, 542540273, 545726969,
+	548912382, 552096502, 555279324, 558460839, 561641039, 564819919, 567997469, 571173682,
+	574348552, 577522070, 580694229, 583865021, 587034440, 590202477, 593369126, 596534378,
+	599698227, 602860664, 606021683, 609181276, 612339436, 615496154, 618651424, 621805239,
+	624957590, 628108471, 631257873, 634405791, 637552215, 640697139, 643840556, 646982457,
+	650122837, 653261686, 656398998, 659534766, 662668981, 665801638, 668932727, 672062243,
+	675190177, 678316522, 681441272, 684564417, 687685952, 690805869, 693924160, 697040818,
+	700155836, 703269207, 706380923, 709490976, 712599360, 715706067, 718811090, 721914422,
+	725016055, 728115982, 731214195, 734310688, 737405453, 740498483, 743589770, 746679308,
+	749767089, 752853105, 755937350, 759019816, 762100496, 765179382, 768256469, 771331747,
+	774405210, 777476851, 780546663, 783614638, 786680769, 789745049, 792807470, 795868026,
+	798926709, 801983513, 805038429, 808091450, 811142571, 814191782, 817239078, 820284450,
+	823327893, 826369398, 829408958, 832446567, 835482217, 838515901, 841547612, 844577343,
+	847605086, 850630835, 853654582, 856676321, 859696043, 862713743, 865729413, 868743045,
+	871754633, 874764170, 877771649, 880777062, 883780402, 886781663, 889780838, 892777918,
+	895772898, 898765769, 901756526, 904745161, 907731667, 910716038, 913698265, 916678342,
+	919656262, 922632018, 925605603, 928577010, 931546231, 934513261, 937478092, 940440717,
+	943401129, 946359321, 949315286, 952269017, 955220508, 958169751, 961116739, 964061465,
+	967003923, 969944106, 972882006, 975817617, 978750932, 981681943, 984610645, 987537030,
+	990461091, 993382821, 996302214, 999219262, 1002133959, 1005046298, 1007956272, 1010863875,
+	1013769098, 1016671936, 1019572382, 1022470428, 1025366069, 1028259297, 1031150105, 1034038487,
+	1036924436, 1039807944, 1042689006, 1045567615, 1048443763, 1051317443, 1054188651, 1057057377,
+	1059923616, 1062787361, 1065648605, 1068507342, 1071363564, 1074217266, 1077068439, 1079917078,
+	1082763176, 1085606726, 1088447722, 1091286156, 1094122023, 1096955314, 1099786025, 1102614148,
+	1105439676, 1108262603, 1111082922, 1113900627, 1116715710, 1119528166, 1122337987, 1125145168,
+	1127949701, 1130751579, 1133550797, 1136347348, 1139141224, 1141932420, 1144720929, 1147506745,
+	1150289860, 1153070269, 1155847964, 1158622939, 1161395188, 1164164704, 1166931481, 1169695512,
+	1172456790, 1175215310, 1177971064, 1180724046, 1183474250, 1186221669, 1188966297, 1191708127,
+	1194447153, 1197183368, 1199916766, 1202647340, 1205375085, 1208099993, 1210822059, 1213541275,
+	1216257636, 1218971135, 1221681765, 1224389521, 1227094395, 1229796382, 1232495475, 1235191668,
+	1237884955, 1240575329, 1243262783, 1245947312, 1248628909, 1251307568, 1253983283, 1256656047,
+	1259325853, 1261992697, 1264656571, 1267317469, 1269975384, 1272630312, 1275282245, 1277931177,
+	1280577102, 1283220013, 1285859905, 1288496772, 1291130606, 1293761402, 1296389154, 1299013855,
+	1301635500, 1304254082, 1306869594, 1309482032, 1312091388, 1314697657, 1317300832, 1319900907,
+	1322497877, 1325091734, 1327682474, 1330270089, 1332854574, 1335435923, 1338014129, 1340589187,
+	1343161090, 1345729833, 1348295409, 1350857812, 1353417037, 1355973077, 1358525926, 1361075579,
+	1363622028, 1366165269, 1368705296, 1371242101, 1373775680, 1376306026, 1378833134, 1381356997,
+	1383877610, 1386394966, 1388909060, 1391419886, 1393927438, 1396431709, 1398932695, 1401430389,
+	1403924785, 1406415878, 1408903661, 1411388129, 1413869275, 1416347095, 1418821582, 1421292730,
+	1423760534, 1426224988, 1428686085, 1431143821, 1433598189, 1436049184, 1438496799, 1440941030,
+	1443381870, 1445819314, 1448253355, 1450683988, 1453111208, 1455535009, 1457955385, 1460372329,
+	1462785838, 1465195904, 1467602523, 1470005688, 1472405394, 1474801636, 1477194407, 1479583702,
+	1481969516, 1484351842, 1486730675, 1489106011, 1491477842, 1493846163, 1496210969, 1498572255,
+	1500930014, 1503284242, 1505634932, 1507982079, 1510325678, 1512665723, 1515002208, 1517335128,
+	1519664478, 1521990252, 1524312445, 1526631051, 1528946064, 1531257480, 1533565293, 1535869497,
+	1538170087, 1540467057, 1542760402, 1545050118, 1547336197, 1549618636, 1551897428, 1554172569,
+	1556444052, 1558711873, 1560976026, 1563236506, 1565493307, 1567746425, 1569995854, 1572241588,
+	1574483623, 1576721952, 1578956572, 1581187476, 1583414660, 1585638117, 1587857843, 1590073833,
+	1592286082, 1594494583, 1596699333, 1598900325, 1601097555, 1603291018, 1605480708, 1607666620,
+	1609848749, 1612027089, 1614201637, 1616372386, 1618539332, 1620702469, 1622861793, 1625017297,
+	1627168978, 1629316830, 1631460848, 1633601027, 1635737362, 1637869848, 1639998480, 1642123253,
+	1644244162, 1646361202, 1648474367, 1650583654, 1652689057, 1654790570, 1656888190, 1658981911,
+	1661071729, 1663157637, 1665239632, 1667317709, 1669391862, 1671462087, 1673528379, 1675590733,
+	1677649144, 1679703608, 1681754118, 1683800672, 1685843263, 1687881888, 1689916541, 1691947217,
+	1693973912, 1695996621, 1698015339, 1700030061, 1702040783, 1704047500, 1706050207, 1708048900,
+	1710043573, 1712034223, 1714020844, 1716003431, 1717981981, 1719956488, 1721926948, 1723893357,
+	1725855708, 1727813999, 1729768224, 1731718378, 1733664458, 1735606458, 1737544374, 1739478202,
+	1741407936, 1743333573, 1745255107, 1747172535, 1749085851, 1750995052, 1752900132, 1754801087,
+	1756697914, 1758590607, 1760479161, 1762363573, 1764243838, 1766119952, 1767991909, 1769859707,
+	1771723340, 1773582803, 1775438094, 1777289206, 1779136137, 1780978881, 1782817434, 1784651792,
+	1786481950, 1788307905, 1790129652, 1791947186, 1793760504, 1795569601, 1797374472, 1799175115,
+	1800971523, 1802763694, 1804551623, 1806335305, 1808114737, 1809889915, 1811660833, 1813427489,
+	1815189877, 1816947994, 1818701835, 1820451397, 1822196675, 1823937666, 1825674364, 1827406767,
+	1829134869, 1830858668, 1832578158, 1834293336, 1836004197, 1837710739, 1839412956, 1841110844,
+	1842804401, 1844493621, 1846178501, 1847859036, 1849535224, 1851207059, 1852874538, 1854537657,
+	1856196413, 1857850800, 1859500816, 1861146456, 1862787717, 1864424594, 1866057085, 1867685184,
+	1869308888, 1870928194, 1872543097, 1874153594, 1875759681, 1877361354, 1878958610, 1880551444,
+	1882139853, 1883723833, 1885303381, 1886878492, 1888449163, 1890015391, 1891577171, 1893134500,
+	1894687374, 1896235790, 1897779744, 1899319232, 1900854251, 1902384797, 1903910867, 1905432457,
+	1906949562, 1908462181, 1909970309, 1911473942, 1912973078, 1914467712, 1915957841, 1917443462,
+	1918924571, 1920401165, 1921873239, 1923340791, 1924803818, 1926262315, 1927716279, 1929165708,
+	1930610597, 1932050943, 1933486742, 1934917992, 1936344689, 1937766830, 1939184411, 1940597428,
+	1942005880, 1943409761, 1944809070, 1946203802, 1947593954, 1948979524, 1950360508, 1951736902,
+	1953108703, 1954475909, 1955838516, 1957196520, 1958549919, 1959898709, 1961242888, 1962582451,
+	1963917396, 1965247720, 1966573420, 1967894492, 1969210933, 1970522741, 1971829912, 1973132443,
+	1974430331, 1975723572, 1977012165, 1978296106, 1979575392, 1980850019, 1982119985, 1983385288,
+	1984645923, 1985901888, 1987153180, 1988399796, 1989641733, 1990878989, 1992111559, 1993339442,
+	1994562635, 1995781134, 1996994937, 1998204040, 1999408442, 2000608139, 2001803128, 2002993407,
+	2004178973, 2005359822, 2006535953, 2007707362, 2008874047, 2010036005, 2011193233, 2012345729,
+	2013493489, 2014636511, 2015774793, 2016908331, 2018037123, 2019161167, 2020280460, 2021394998,
+	2022504780, 2023609803, 2024710064, 2025805561, 2026896291, 2027982251, 2029063439, 2030139853,
+	2031211490, 2032278347, 2033340422, 2034397712, 2035450215, 2036497928, 2037540850, 2038578976,
+	2039612306, 2040640837, 2041664565, 2042683490, 2043697608, 2044706916, 2045711414, 2046711097,
+	2047705965, 2048696014, 2049681242, 2050661647, 2051637227, 2052607979, 2053573901, 2054534991,
+	2055491246, 2056442665, 2057389244, 2058330983, 2059267877, 2060199927, 2061127128, 2062049479,
+	2062966978, 2063879623, 2064787411, 2065690341, 2066588410, 2067481616, 2068369957, 2069253430,
+	2070132035, 2071005769, 2071874629, 2072738614, 2073597721, 2074451950, 2075301296, 2076145760,
+	2076985338, 2077820028, 2078649830, 2079474740, 2080294757, 2081109879, 2081920103, 2082725429,
+	2083525854, 2084321376, 2085111994, 2085897705, 2086678508, 2087454400, 2088225381, 2088991448,
+	2089752599, 2090508833, 2091260147, 2092006541, 2092748012, 2093484559, 2094216179, 2094942872,
+	2095664635, 2096381466, 2097093365, 2097800329, 2098502357, 2099199446, 2099891596, 2100578805,
+	2101261071, 2101938393, 2102610768, 2103278196, 2103940674, 2104598202, 2105250778, 2105898399,
+	2106541065, 2107178775, 2107811526, 2108439317, 2109062146, 2109680013, 2110292916, 2110900853,
+	2111503822, 2112101824, 2112694855, 2113282914, 2113866001, 2114444114, 2115017252, 2115585412,
+	2116148595, 2116706797, 2117260020, 2117808259, 2118351516, 2118889788, 2119423074, 2119951372,
+	2120474683, 2120993003, 2121506333, 2122014670, 2122518015, 2123016364, 2123509718, 2123998076,
+	2124481435, 2124959795, 2125433155, 2125901514, 2126364870, 2126823222, 2127276570, 2127724913,
+	2128168248, 2128606576, 2129039895, 2129468204, 2129891502, 2130309789, 2130723062, 2131131322,
+	2131534567, 2131932796, 2132326009, 2132714204, 2133097381, 2133475538, 2133848675, 2134216791,
+	2134579885, 2134937956, 2135291003, 2135639026, 2135982023, 2136319994, 2136652938, 2136980855,
+	2137303743, 2137621601, 2137934430, 2138242228, 2138544994, 2138842728, 2139135429, 2139423097,
+	2139705730, 2139983329, 2140255892, 2140523418, 2140785908, 2141043360, 2141295774, 2141543150,
+	2141785486, 2142022783, 2142255039, 2142482254, 2142704427, 2142921559, 2143133648, 2143340694,
+	2143542697, 2143739656, 2143931570, 2144118439, 2144300264, 2144477042, 2144648774, 2144815460,
+	2144977098, 2145133690, 2145285233, 2145431729, 2145573176, 2145709574, 2145840924, 2145967224,
+	2146088474, 2146204674, 2146315824, 2146421924, 2146522973, 2146618971, 2146709917, 2146795813,
+	2146876656, 2146952448, 2147023188, 2147088876, 2147149511, 2147205094, 2147255625, 2147301102,
+	2147341527, 2147376899, 2147407218, 2147432484, 2147452697, 2147467857, 2147477963, 2147483016
+};
+
+static const int32_t sineShortWindow[AAC_SHORT_HALF] =
+{
+	13176712, 39528151, 65873638, 92209205, 118530885, 144834714, 171116733, 197372981,
+	223599506, 249792358, 275947592, 302061269, 328129457, 354148230, 380113669, 406021865,
+	431868915, 457650927, 483364019, 509004318, 534567963, 560051104, 585449903, 610760536,
+	635979190, 661102068, 686125387, 711045377, 735858287, 760560380, 785147934, 809617249,
+	833964638, 858186435, 882278992, 906238681, 930061894, 953745043, 977284562, 1000676905,
+	1023918550, 1047005996, 1069935768, 1092704411, 1115308496, 1137744621, 1160009405, 1182099496,
+	1204011567, 1225742318, 1247288478, 1268646800, 1289814068, 1310787095, 1331562723, 1352137822,
+	1372509294, 1392674072, 1412629117, 1432371426, 1451898025, 1471205974, 1490292364, 1509154322,
+	1527789007, 1546193612, 1564365367, 1582301533, 1599999411, 1617456335, 1634669676, 1651636841,
+	1668355276, 1684822463, 1701035922, 1716993211, 1732691928, 1748129707, 1763304224, 1778213194,
+	1792854372, 1807225553, 1821324572, 1835149306, 1848697674, 1861967634, 1874957189, 1887664383,
+	1900087301, 1912224073, 1924072871, 1935631910, 1946899451, 1957873796, 1968553292, 1978936331,
+	1989021350, 1998806829, 2008291295, 2017473321, 2026351522, 2034924562, 2043191150, 2051150040,
+	2058800036, 2066139983, 2073168777, 2079885360, 2086288720, 2092377892, 2098151960, 2103610054,
+	2108751352, 2113575080, 2118080511, 2122266967, 2126133817, 2129680480, 2132906420, 2135811153,
+	2138394240, 2140655293, 2142593971, 2144209982, 2145503083, 2146473080, 2147119825, 2147443222
+};
+
+static const int32_t kbdLongWindow[AAC_LONG_HALF] =
+{
+	628271, 923387, 1174117, 1406222, 1629300, 1848110, 2065397, 2282906,
+	2501826, 2723012, 2947103, 3174596, 3405888, 3641305, 3881121, 4125569,
+	4374855, 4629160, 4888647, 5153463, 5423747, 5699625, 5981218, 6268637,
+	6561992, 6861385, 7166916, 7478682, 7796776, 8121290, 8452313, 8789934,
+	9134238, 9485311, 9843236, 10208098, 10579977, 10958956, 11345116, 11738536,
+	12139297, 12547478, 12963159, 13386417, 13817331, 14255980, 14702441, 15156792,
+	15619110, 16089474, 16567959, 17054643, 17549603, 18052915, 18564657, 19084905,
+	19613735, 20151224, 20697447, 21252482, 21816404, 22389289, 22971213, 23562252,
+	24162482, 24771979, 25390817, 26019072, 26656821, 27304138, 27961098, 28627777,
+	29304249, 29990589, 30686873, 31393175, 32109569, 32836130, 33572932, 34320049,
+	35077556, 35845526, 36624033, 37413151, 38212952, 39023511, 39844901, 40677194,
+	41520463, 42374780, 43240219, 44116850, 45004747, 45903981, 46814623, 47736745,
+	48670418, 49615713, 50572700, 51541450, 52522032, 53514518, 54518975, 55535475,
+	56564085, 57604874, 58657912, 59723266, 60801003, 61891193, 62993901, 64109195,
+	65237141, 66377806, 67531255, 68697555, 69876770, 71068965, 72274205, 73492553,
+	74724075, 75968832, 77226888, 78498305, 79783146, 81081473, 82393346, 83718826,
+	85057974, 86410851, 87777515, 89158025, 90552441, 91960820, 93383221, 94819700,
+	96270314, 97735119, 99214172, 100707528, 102215240, 103737364, 105273954, 106825061,
+	108390740, 109971042, 111566019, 113175722, 114800200, 116439505, 118093685, 119762789,
+	121446866, 123145962, 124860125, 126589402, 128333837, 130093476, 131868364, 133658545,
+	135464061, 137284955, 139121270, 140973047, 142840326, 144723147, 146621550, 148535573,
+	150465255, 152410633, 154371743, 156348621, 158341303, 160349823, 162374216, 164414513,
+	166470747, 168542951, 170631155, 172735390, 174855684, 176992067, 179144566, 181313209,
+	183498022, 185699032, 187916262, 190149737, 192399481, 194665515, 196947863, 199246544,
+	201561580, 203892989, 206240790, 208605002, 210985640, 213382722, 215796262, 218226275,
+	220672775, 223135775, 225615287, 228111322, 230623890, 233153001, 235698663, 238260885,
+	240839674, 243435034, 246046973, 248675493, 251320599, 253982294, 256660578, 259355453,
+	262066918, 264794974, 267539617, 270300846, 273078657, 275873045, 278684005, 281511530,
+	284355614, 287216249, 290093425, 292987132, 295897360, 298824097, 301767330, 304727046,
+	307703231, 310695868, 313704941, 316730434, 319772328, 322830603, 325905241, 328996219,
+	332103517, 335227110, 338366976, 341523090, 344695425, 347883956, 351088655, 354309493,
+	357546441, 360799469, 364068545, 367353637, 370654713, 373971737, 377304674, 380653490,
+	384018146, 387398606, 390794829, 394206777, 397634409, 401077683, 404536556, 408010985,
+	411500925, 415006332, 418527158, 422063357, 425614880, 429181678, 432763701, 436360898,
+	439973217, 443600606, 447243009, 450900373, 454572643, 458259760, 461961669, 465678310,
+	469409624, 473155552, 476916031, 480690999, 484480394, 488284152, 492102208, 495934497,
+	499780950, 503641503, 507516084, 511404627, 515307059, 519223311, 523153310, 527096984,
+	531054258, 535025059, 539009310, 543006936, 547017859, 551042001, 555079284, 559129627,
+	563192950, 567269172, 571358210, 575459981, 579574402, 583701386, 587840850, 591992707,
+	596156868, 600333247, 604521754, 608722300, 612934794, 617159145, 621395261, 625643049,
+	629902416, 634173267, 638455507, 642749041, 647053771, 651369600, 655696431, 660034163,
+	664382698, 668741936, 673111775, 677492113, 681882848, 686283877, 690695096, 695116400,
+	699547684, 703988843, 708439768, 712900354, 717370492, 721850074, 726338990, 730837130,
+	735344384, 739860641, 744385789, 748919715, 753462307, 758013451, 762573032, 767140937,
+	771717048, 776301252, 780893430, 785493467, 790101243, 794716642, 799339545, 803969831,
+	808607382, 813252078, 817903797, 822562418, 827227819, 831899878, 836578473, 841263481,
+	845954776, 850652237, 855355737, 860065153, 864780357, 869501226, 874227633, 878959450,
+	883696551, 888438809, 893186095, 897938282, 902695241, 907456844, 912222960, 916993461,
+	921768216, 926547096, 931329970, 936116707, 940907176, 945701246, 950498785, 955299661,
+	960103742, 964910896, 969720990, 974533891, 979349466, 984167582, 988988106, 993810903,
+	998635840, 1003462782, 1008291597, 1013122148, 1017954303, 1022787925, 1027622881, 1032459036,
+	1037296254, 1042134400, 1046973339, 1051812937, 1056653057, 1061493565, 1066334324, 1071175200,
+	1076016057, 1080856759, 1085697171, 1090537157, 1095376582, 1100215309, 1105053205, 1109890133,
+	1114725957, 1119560543, 1124393754, 1129225457, 1134055515, 1138883793, 1143710157, 1148534471,
+	1153356602, 1158176413, 1162993771, 1167808542, 1172620591, 1177429783, 1182235986, 1187039066,
+	1191838889, 1196635321, 1201428231, 1206217484, 1211002949, 1215784492, 1220561983, 1225335288,
+	1230104277, 1234868817, 1239628779, 1244384031, 1249134443, 1253879884, 1258620225, 1263355337,
+	1268085090, 1272809356, 1277528006, 1282240912, 1286947946, 1291648981, 1296343891, 1301032548,
+	1305714828, 1310390603, 1315059749, 1319722141, 1324377655, 1329026167, 1333667553, 1338301691,
+	1342928457, 1347547731, 1352159391, 1356763315, 1361359384, 1365947477, 1370527475, 1375099259,
+	1379662712, 1384217714, 1388764149, 1393301901, 1397830853, 1402350890, 1406861898, 1411363761,
+	1415856367, 1420339602, 1424813355, 1429277512, 1433731964, 1438176600, 1442611311, 1447035986,
+	1451450518, 1455854799, 1460248722, 1464632180, 1469005069, 1473367282, 1477718717, 1482059268,
+	1486388835, 1490707314, 1495014604, 1499310605, 1503595217, 1507868342, 1512129880, 1516379734,
+	1520617809, 1524844007, 1529058234, 1533260396, 1537450399, 1541628150, 1545793558, 1549946532,
+	1554086981, 1558214816, 1562329949, 1566432292, 1570521759, 1574598263, 1578661719, 1582712044,
+	1586749153, 1590772965, 1594783397, 1598780370, 1602763804, 1606733619, 1610689738, 1614632084,
+	1618560580, 1622475152, 1626375725, 1630262226, 1634134582, 1637992722, 1641836575, 1645666072,
+	1649481144, 1653281724, 1657067744, 1660839139, 1664595844, 1668337795, 1672064930, 1675777186,
+	1679474502, 1683156819, 1686824077, 1690476219, 1694113187, 1697734925, 1701341379, 1704932494,
+	1708508217, 1712068496, 1715613280, 1719142520, 1722656165, 1726154168, 1729636483, 1733103062,
+	1736553861, 1739988835, 1743407943, 1746811141, 1750198389, 1753569648, 1756924877, 1760264039,
+	1763587098, 1766894016, 1770184761, 1773459297, 1776717591, 1779959613, 1783185331, 1786394716,
+	1789587739, 1792764371, 1795924587, 1799068361, 1802195669, 1805306485, 1808400789, 1811478558,
+	1814539773, 1817584412, 1820612459, 1823623894, 1826618703, 1829596869, 1832558378, 1835503217,
+	1838431373, 1841342834, 1844237591, 1847115633, 1849976953, 1852821543, 1855649397, 1858460509,
+	1861254875, 1864032491, 1866793355, 1869537465, 1872264822, 1874975425, 1877669276, 1880346378,
+	1883006733, 1885650347, 1888277225, 1890887373, 1893480798, 1896057508, 1898617514, 1901160824,
+	1903687450, 1906197405, 1908690700, 1911167351, 1913627371, 1916070777, 1918497585, 1920907812,
+	1923301478, 1925678602, 1928039204, 1930383305, 1932710928, 1935022094, 1937316829, 1939595157,
+	1941857104, 1944102695, 1946331959, 1948544924, 1950741618, 1952922072, 1955086316, 1957234381,
+	1959366302, 1961482109, 1963581838, 1965665524, 1967733201, 1969784907, 1971820679, 1973840555,
+	1975844572, 1977832773, 1979805195, 1981761881, 1983702873, 1985628212, 1987537943, 1989432110,
+	1991310756, 1993173929, 1995021673, 1996854037, 1998671067, 2000472811, 2002259320, 2004030642,
+	2005786829, 2007527930, 2009253998, 2010965084, 2012661243, 2014342527, 2016008991, 2017660689,
+	2019297677, 2020920011, 2022527748, 2024120944, 2025699658, 2027263948, 2028813872, 2030349491,
+	2031870864, 2033378052, 2034871116, 2036350117, 2037815118, 2039266181, 2040703369, 2042126746,
+	2043536376, 2044932324, 2046314654, 2047683432, 2049038723, 2050380595, 2051709113, 2053024346,
+	2054326360, 2055615224, 2056891006, 2058153774, 2059403598, 2060640548, 2061864693, 2063076103,
+	2064274849, 2065461003, 2066634634, 2067795815, 2068944617, 2070081113, 2071205375, 2072317476,
+	2073417488, 2074505485, 2075581541, 2076645728, 2077698122, 2078738796, 2079767825, 2080785283,
+	2081791245, 2082785786, 2083768982, 2084740908, 2085701639, 2086651251, 2087589820, 2088517422,
+	2089434132, 2090340029, 2091235186, 2092119682, 2092993593, 2093856996, 2094709966, 2095552582,
+	2096384919, 2097207056, 2098019068, 2098821034, 2099613029, 2100395132, 2101167419, 2101929967,
+	2102682854, 2103426157, 2104159952, 2104884318, 2105599331, 2106305067, 2107001605, 2107689020,
+	2108367391, 2109036793, 2109697303, 2110348998, 2110991955, 2111626250, 2112251959, 2112869159,
+	2113477925, 2114078334, 2114670461, 2115254382, 2115830174, 2116397910, 2116957666, 2117509518,
+	2118053541, 2118589808, 2119118395, 2119639376, 2120152824, 2120658815, 2121157421, 2121648716,
+	2122132773, 2122609666, 2123079466, 2123542247, 2123998082, 2124447041, 2124889196, 2125324620,
+	2125753383, 2126175556, 2126591211, 2127000416, 2127403243, 2127799761, 2128190040, 2128574148,
+	2128952155, 2129324128, 2129690137, 2130050250, 2130404532, 2130753053, 2131095878, 2131433074,
+	2131764707, 2132090844, 2132411549, 2132726887, 2133036924, 2133341723, 2133641348, 2133935864,
+	2134225332, 2134509817, 2134789380, 2135064083, 2135333989, 2135599157, 2135859650, 2136115527,
+	2136366848, 2136613674, 2136856063, 2137094073, 2137327764, 2137557193, 2137782418, 2138003496,
+	2138220483, 2138433435, 2138642409, 2138847460, 2139048643, 2139246011, 2139439620, 2139629523,
+	2139815772, 2139998421, 2140177522, 2140353127, 2140525287, 2140694053, 2140859475, 2141021604,
+	2141180489, 2141336179, 2141488723, 2141638170, 2141784566, 2141927959, 2142068397, 2142205925,
+	2142340590, 2142472436, 2142601510, 2142727855, 2142851516, 2142972536, 2143090959, 2143206828,
+	2143320184, 2143431070, 2143539527, 2143645597, 2143749319, 2143850733, 2143949881, 2144046799,
+	2144141528, 2144234106, 2144324570, 2144412958, 2144499306, 2144583652, 2144666032, 2144746481,
+	2144825034, 2144901726, 2144976591, 2145049664, 2145120978, 2145190566, 2145258461, 2145324695,
+	2145389299, 2145452305, 2145513744, 2145573647, 2145632043, 2145688963, 2145744436, 2145798490,
+	2145851154, 2145902457, 2145952426, 2146001088, 2146048470, 2146094599, 2146139500, 2146183201,
+	2146225725, 2146267098, 2146307345, 2146346490, 2146384557, 2146421568, 2146457548, 2146492519,
+	2146526503, 2146559523, 2146591600, 2146622756, 2146653011, 2146682386, 2146710902, 2146738578,
+	2146765434, 2146791490, 2146816763, 2146841274, 2146865039, 2146888078, 2146910408, 2146932046,
+	2146953009, 2146973314, 2146992977, 2147012015, 2147030443, 2147048277, 2147065531, 2147082222,
+	2147098364, 2147113970, 2147129056, 2147143635, 2147157720, 2147171325, 2147184463, 2147197146,
+	2147209387, 2147221199, 2147232593, 2147243581, 2147254174, 2147264384, 2147274222, 2147283698,
+	2147292823, 2147301608, 2147310062, 2147318195, 2147326018, 2147333538, 2147340767, 2147347711,
+	2147354381, 2147360785, 2147366931, 2147372828, 2147378483, 2147383905, 2147389100, 2147394077,
+	2147398842, 2147403402, 2147407765, 2147411938, 2147415926, 2147419736, 2147423374, 2147426847,
+	2147430160, 2147433318, 2147436329, 2147439196, 2147441925, 2147444522, 2147446991, 2147449337,
+	2147451565, 2147453680, 2147455685, 2147457586, 2147459386, 2147461089, 2147462700, 2147464222,
+	2147465659, 2147467014, 2147468292, 2147469494, 2147470626, 2147471689, 2147472687, 2147473622,
+	2147474499, 2147475318, 2147476084, 2147476799, 2147477464, 2147478084, 2147478659, 2147479192,
+	2147479685, 2147480141, 2147480561, 2147480947, 2147481302, 2147481626, 2147481922, 2147482191,
+	2147482435, 2147482655, 2147482853, 2147483030, 2147483188, 2147483327, 2147483449, 2147483556
+};
+
+static const int32_t kbdShortWindow[AAC_SHORT_HALF] =
+{
+	94051, 254850, 495460, 836387, 1300973, 1915549, 2709535, 3715517,
+	4969293, 6509880, 8379492, 10623473, 13290192, 16430893, 20099503, 24352393,
+	29248099, 34846992, 41210910, 48402746, 56485996, 65524275, 75580796, 86717820,
+	98996087, 112474223, 127208139, 143250415, 160649696, 179450080, 199690531, 221404307,
+	244618414, 269353093, 295621359, 323428568, 352772060, 383640843, 416015351, 449867271,
+	485159445, 521845839, 559871607, 599173223, 639678700, 681307893, 723972875, 767578399,
+	812022434, 857196765, 902987672, 949276659, 995941243, 1042855792, 1089892394, 1136921770,
+	1183814193, 1230440437, 1276672711, 1322385605, 1367457002, 1411768974, 1455208642, 1497668982,
+	1539049589, 1579257366, 1618207150, 1655822263, 1692034967, 1726786844, 1760029076, 1791722627,
+	1821838332, 1850356881, 1877268712, 1902573799, 1926281351, 1948409424, 1968984440, 1988040640,
+	2005619460, 2021768853, 2036542554, 2049999312, 2062202092, 2073217259, 2083113760, 2091962316,
+	2099834626, 2106802612, 2112937700, 2118310150, 2122988455, 2127038794, 2130524567, 2133506000,
+	2136039829, 2138179064, 2139972824, 2141466249, 2142700478, 2143712692, 2144536213, 2145200642,
+	2145732052, 2146153201, 2146483773, 2146740634, 2146938097, 2147088186, 2147200900, 2147284463,
+	2147345566, 2147389585, 2147420789, 2147442523, 2147457371, 2147467300, 2147473781, 2147477899,
+	2147480434, 2147481939, 2147482794, 2147483254, 2147483485, 2147483591, 2147483633, 2147483646
+};
+
+// sin(pi / 2 * i / SINE_QUARTER), Q31
+static const int32_t sineTable[SINE_QUARTER + 1] =
+{
+	0, 1647099, 3294197, 4941294, 6588387, 8235476, 9882561, 11529640,
+	13176712, 14823776, 16470832, 18117878, 19764913, 21411936, 23058947, 24705945,
+	26352928, 27999895, 29646846, 31293780, 32940695, 34587590, 36234466, 37881320,
+	39528151, 41174960, 42821744, 44468503, 46115236, 47761942, 49408620, 51055268,
+	52701887, 54348475, 55995030, 57641553, 59288042, 60934496, 62580914, 64227295,
+	65873638, 67519943, 69166208, 70812432, 72458615, 74104755, 75750851, 77396903,
+	79042909, 80688869, 82334782, 83980645, 85626460, 87272224, 88917937, 90563597,
+	92209205, 93854758, 95500255, 97145697, 98791081, 100436408, 102081675, 103726882,
+	105372028, 107017112, 108662134, 110307091, 111951983, 113596810, 115241570, 116886262,
+	118530885, 120175438, 121819921, 123464332, 125108670, 126752935, 128397125, 130041240,
+	131685278, 133329239, 134973122, 136616925, 138260647, 139904288, 141547847, 143191323,
+	144834714, 146478021, 148121241, 149764374, 151407418, 153050374, 154693240, 156336015,
+	157978697, 159621287, 161263783, 162906184, 164548489, 166190698, 167832808, 169474820,
+	171116733, 172758544, 174400254, 176041861, 177683365, 179324764, 180966058, 182607245,
+	184248325, 185889297, 187530159, 189170911, 190811551, 192452080, 194092495, 195732795,
+	197372981, 199013051, 200653003, 202292838, 203932553, 205572149, 207211624, 208850976,
+	210490206, 212129312, 213768293, 215407149, 217045878, 218684479, 220322951, 221961294,
+	223599506, 225237587, 226875535, 228513350, 230151030, 231788575, 233425984, 235063255,
+	236700388, 238337382, 239974235, 241610947, 243247518, 244883945, 246520228, 248156366,
+	249792358, 251428203, 253063900, 254699448, 256334847, 257970095, 259605191, 261240134,
+	262874923, 264509558, 266144038, 267778360, 269412525, 271046532, 272680379, 274314066,
+	275947592, 277580955, 279214155, 280847190, 282480061, 284112765, 285745302, 287377671,
+	289009871, 290641901, 292273760, 293905447, 295536961, 297168301, 298799466, 300430456,
+	302061269, 303691904, 305322361, 306952638, 308582734, 310212649, 311842381, 313471930,
+	315101295, 316730474, 318359466, 319988272, 321616889, 323245317, 324873555, 326501602,
+	328129457, 329757119, 331384586, 333011859, 334638936, 336265816, 337892498, 339518981,
+	341145265, 342771348, 344397230, 346022908, 347648383, 349273654, 350898719, 352523578,
+	354148230, 355772673, 357396906, 359020930, 360644742, 362268343, 363891730, 365514903,
+	367137861, 368760603, 370383128, 372005435, 373627523, 375249392, 376871039, 378492466,
+	380113669, 381734649, 383355404, 384975934, 386596237, 388216313, 389836160, 391455778,
+	393075166, 394694323, 396313247, 397931939, 399550396, 401168618, 402786604, 404404353,
+	406021865, 407639137, 409256170, 410872962, 412489512, 414105819, 415721883, 417337703,
+	418953276, 420568604, 422183684, 423798515, 425413098, 427027430, 428641511, 430255339,
+	431868915, 433482236, 435095303, 436708113, 438320667, 439932963, 441545000, 443156777,
+	444768294, 446379549, 447990541, 449601270, 451211734, 452821933, 454431865, 456041530,
+	457650927, 459260055, 460868912, 462477499, 464085813, 465693854, 467301622, 468909114,
+	470516330, 472123270, 473729932, 475336316, 476942419, 478548243, 480153784, 481759043,
+	483364019, 484968710, 486573117, 488177236, 489781069, 491384614, 492987869, 494590835,
+	496193509, 497795892, 499397982, 500999778, 502601279, 504202485, 505803394, 507404005,
+	509004318, 510604332, 512204045, 513803457, 515402566, 517001373, 518599875, 520198072,
+	521795963, 523393547, 524990824, 526587791, 528184449, 529780796, 531376831, 532972554,
+	534567963, 536163058, 537757837, 539352300, 540946445, 542540273, 544133781, 545726969,
+	547319836, 548912382, 550504604, 552096502, 553688076, 555279324, 556870245, 558460839,
+	560051104, 561641039, 563230645, 564819919, 566408860, 567997469, 569585743, 571173682,
+	572761285, 574348552, 575935480, 577522070, 579108320, 580694229, 582279796, 583865021,
+	585449903, 587034440, 588618632, 590202477, 591785976, 593369126, 594951927, 596534378,
+	598116479, 599698227, 601279623, 602860664, 604441352, 606021683, 607601658, 609181276,
+	610760536, 612339436, 613917975, 615496154, 617073971, 618651424, 620228514, 621805239,
+	623381598, 624957590, 626533215, 628108471, 629683357, 631257873, 632832018, 634405791,
+	635979190, 637552215, 639124865, 640697139, 642269036, 643840556, 645411696, 646982457,
+	648552838, 650122837, 651692453, 653261686, 654830535, 656398998, 657967075, 659534766,
+	661102068, 662668981, 664235505, 665801638, 667367379, 668932727, 670497682, 672062243,
+	673626408, 675190177, 676753549, 678316522, 679879097, 681441272, 683003045, 684564417,
+	686125387, 687685952, 689246113, 690805869, 692365218, 693924160, 695482694, 697040818,
+	698598533, 700155836, 701712728, 703269207, 704825272, 706380923, 707936158, 709490976,
+	711045377, 712599360, 714152924, 715706067, 717258790, 718811090, 720362968, 721914422,
+	723465451, 725016055, 726566232, 728115982, 729665303, 731214195, 732762657, 734310688,
+	735858287, 737405453, 738952186, 740498483, 742044345, 743589770, 745134758, 746679308,
+	748223418, 749767089, 751310318, 752853105, 754395449, 755937350, 757478806, 759019816,
+	760560380, 762100496, 763640164, 765179382, 766718151, 768256469, 769794334, 771331747,
+	772868706, 774405210, 775941259, 777476851, 779011986, 780546663, 782080880, 783614638,
+	785147934, 786680769, 788213141, 789745049, 791276492, 792807470, 794337982, 795868026,
+	797397602, 798926709, 800455346, 801983513, 803511207, 805038429, 806565177, 808091450,
+	809617249, 811142571, 812667415, 814191782, 815715670, 817239078, 818762005, 820284450,
+	821806413, 823327893, 824848888, 826369398, 827889422, 829408958, 830928007, 832446567,
+	833964638, 835482217, 836999305, 838515901, 840032004, 841547612, 843062726, 844577343,
+	846091463, 847605086, 849118210, 850630835, 852142959, 853654582, 855165703, 856676321,
+	858186435, 859696043, 861205147, 862713743, 864221832, 865729413, 867236484, 868743045,
+	870249095, 871754633, 873259659, 874764170, 876268167, 877771649, 879274614, 880777062,
+	882278992, 883780402, 885281293, 886781663, 888281512, 889780838, 891279640, 892777918,
+	894275671, 895772898, 897269597, 898765769, 900261413, 901756526, 903251110, 904745161,
+	906238681, 907731667, 909224120, 910716038, 912207419, 913698265, 915188572, 916678342,
+	918167572, 919656262, 921144411, 922632018, 924119082, 925605603, 927091579, 928577010,
+	930061894, 931546231, 933030021, 934513261, 935995952, 937478092, 938959681, 940440717,
+	941921200, 943401129, 944880503, 946359321, 947837582, 949315286, 950792431, 952269017,
+	953745043, 955220508, 956695411, 958169751, 959643527, 961116739, 962589385, 964061465,
+	965532978, 967003923, 968474300, 969944106, 971413342, 972882006, 974350098, 975817617,
+	977284562, 978750932, 980216726, 981681943, 983146583, 984610645, 986074127, 987537030,
+	988999351, 990461091, 991922248, 993382821, 994842810, 996302214, 997761031, 999219262,
+	1000676905, 1002133959, 1003590424, 1005046298, 1006501581, 1007956272, 1009410370, 1010863875,
+	1012316784, 1013769098, 1015220816, 1016671936, 1018122458, 1019572382, 1021021705, 1022470428,
+	1023918550, 1025366069, 1026812985, 1028259297, 1029705004, 1031150105, 1032594600, 1034038487,
+	1035481766, 1036924436, 1038366495, 1039807944, 1041248781, 1042689006, 1044128617, 1045567615,
+	1047005996, 1048443763, 1049880912, 1051317443, 1052753357, 1054188651, 1055623324, 1057057377,
+	1058490808, 1059923616, 1061355801, 1062787361, 1064218296, 1065648605, 1067078288, 1068507342,
+	1069935768, 1071363564, 1072790730, 1074217266, 1075643169, 1077068439, 1078493076, 1079917078,
+	1081340445, 1082763176, 1084185270, 1085606726, 1087027544, 1088447722, 1089867259, 1091286156,
+	1092704411, 1094122023, 1095538991, 1096955314, 1098370993, 1099786025, 1101200410, 1102614148,
+	1104027237, 1105439676, 1106851465, 1108262603, 1109673089, 1111082922, 1112492101, 1113900627,
+	1115308496, 1116715710, 1118122267, 1119528166, 1120933406, 1122337987, 1123741908, 1125145168,
+	1126547765, 1127949701, 1129350972, 1130751579, 1132151521, 1133550797, 1134949406, 1136347348,
+	1137744621, 1139141224, 1140537158, 1141932420, 1143327011, 1144720929, 1146114174, 1147506745,
+	1148898640, 1150289860, 1151680403, 1153070269, 1154459456, 1155847964, 1157235792, 1158622939,
+	1160009405, 1161395188, 1162780288, 1164164704, 1165548435, 1166931481, 1168313840, 1169695512,
+	1171076495, 1172456790, 1173836395, 1175215310, 1176593533, 1177971064, 1179347902, 1180724046,
+	1182099496, 1183474250, 1184848308, 1186221669, 1187594332, 1188966297, 1190337562, 1191708127,
+	1193077991, 1194447153, 1195815612, 1197183368, 1198550419, 1199916766, 1201282407, 1202647340,
+	1204011567, 1205375085, 1206737894, 1208099993, 1209461382, 1210822059, 1212182024, 1213541275,
+	1214899813, 1216257636, 1217614743, 1218971135, 1220326809, 1221681765, 1223036002, 1224389521,
+	1225742318, 1227094395, 1228445750, 1229796382, 1231146291, 1232495475, 1233843935, 1235191668,
+	1236538675, 1237884955, 1239230506, 1240575329, 1241919421, 1243262783, 1244605414, 1245947312,
+	1247288478, 1248628909, 1249968606, 1251307568, 1252645794, 1253983283, 1255320034, 1256656047,
+	1257991320, 1259325853, 1260659646, 1261992697, 1263325005, 1264656571, 1265987392, 1267317469,
+	1268646800, 1269975384, 1271303222, 1272630312, 1273956653, 1275282245, 1276607086, 1277931177,
+	1279254516, 1280577102, 1281898935, 1283220013, 1284540337, 1285859905, 1287178717, 1288496772,
+	1289814068, 1291130606, 1292446384, 1293761402, 1295075659, 1296389154, 1297701886, 1299013855,
+	1300325060, 1301635500, 1302945174, 1304254082, 1305562222, 1306869594, 1308176198, 1309482032,
+	1310787095, 1312091388, 1313394909, 1314697657, 1315999631, 1317300832, 1318601257, 1319900907,
+	1321199781, 1322497877, 1323795195, 1325091734, 1326387494, 1327682474, 1328976672, 1330270089,
+	1331562723, 1332854574, 1334145641, 1335435923, 1336725419, 1338014129, 1339302052, 1340589187,
+	1341875533, 1343161090, 1344445857, 1345729833, 1347013017, 1348295409, 1349577007, 1350857812,
+	1352137822, 1353417037, 1354695455, 1355973077, 1357249901, 1358525926, 1359801152, 1361075579,
+	1362349204, 1363622028, 1364894050, 1366165269, 1367435685, 1368705296, 1369974101, 1371242101,
+	1372509294, 1373775680, 1375041258, 1376306026, 1377569986, 1378833134, 1380095472, 1381356997,
+	1382617710, 1383877610, 1385136696, 1386394966, 1387652422, 1388909060, 1390164882, 1391419886,
+	1392674072, 1393927438, 1395179984, 1396431709, 1397682613, 1398932695, 1400181954, 1401430389,
+	1402678000, 1403924785, 1405170745, 1406415878, 1407660183, 1408903661, 1410146309, 1411388129,
+	1412629117, 1413869275, 1415108601, 1416347095, 1417584755, 1418821582, 1420057574, 1421292730,
+	1422527051, 1423760534, 1424993180, 1426224988, 1427455956, 1428686085, 1429915374, 1431143821,
+	1432371426, 1433598189, 1434824109, 1436049184, 1437273414, 1438496799, 1439719338, 1440941030,
+	1442161874, 1443381870, 1444601017, 1445819314, 1447036760, 1448253355, 1449469098, 1450683988,
+	1451898025, 1453111208, 1454323536, 1455535009, 1456745625, 1457955385, 1459164286, 1460372329,
+	1461579514, 1462785838, 1463991302, 1465195904, 1466399645, 1467602523, 1468804538, 1470005688,
+	1471205974, 1472405394, 1473603949, 1474801636, 1475998456, 1477194407, 1478389489, 1479583702,
+	1480777044, 1481969516, 1483161115, 1484351842, 1485541696, 1486730675, 1487918781, 1489106011,
+	1490292364, 1491477842, 1492662441, 1493846163, 1495029006, 1496210969, 1497392053, 1498572255,
+	1499751576, 1500930014, 1502107570, 1503284242, 1504460029, 1505634932, 1506808949, 1507982079,
+	1509154322, 1510325678, 1511496145, 1512665723, 1513834411, 1515002208, 1516169114, 1517335128,
+	1518500250, 1519664478, 1520827813, 1521990252, 1523151797, 1524312445, 1525472197, 1526631051,
+	1527789007, 1528946064, 1530102222, 1531257480, 1532411837, 1533565293, 1534717846, 1535869497,
+	1537020244, 1538170087, 1539319024, 1540467057, 1541614183, 1542760402, 1543905714, 1545050118,
+	1546193612, 1547336197, 1548477872, 1549618636, 1550758488, 1551897428, 1553035455, 1554172569,
+	1555308768, 1556444052, 1557578421, 1558711873, 1559844408, 1560976026, 1562106725, 1563236506,
+	1564365367, 1565493307, 1566620327, 1567746425, 1568871601, 1569995854, 1571119183, 1572241588,
+	1573363068, 1574483623, 1575603251, 1576721952, 1577839726, 1578956572, 1580072489, 1581187476,
+	1582301533, 1583414660, 1584526854, 1585638117, 1586748447, 1587857843, 1588966306, 1590073833,
+	1591180426, 1592286082, 1593390801, 1594494583, 1595597428, 1596699333, 1597800299, 1598900325,
+	1599999411, 1601097555, 1602194758, 1603291018, 1604386335, 1605480708, 1606574136, 1607666620,
+	1608758157, 1609848749, 1610938393, 1612027089, 1613114838, 1614201637, 1615287487, 1616372386,
+	1617456335, 1618539332, 1619621377, 1620702469, 1621782608, 1622861793, 1623940023, 1625017297,
+	1626093616, 1627168978, 1628243383, 1629316830, 1630389319, 1631460848, 1632531418, 1633601027,
+	1634669676, 1635737362, 1636804087, 1637869848, 1638934646, 1639998480, 1641061349, 1642123253,
+	1643184191, 1644244162, 1645303166, 1646361202, 1647418269, 1648474367, 1649529496, 1650583654,
+	1651636841, 1652689057, 1653740300, 1654790570, 1655839867, 1656888190, 1657935539, 1658981911,
+	1660027308, 1661071729, 1662115172, 1663157637, 1664199124, 1665239632, 1666279161, 1667317709,
+	1668355276, 1669391862, 1670427466, 1671462087, 1672495725, 1673528379, 1674560049, 1675590733,
+	1676620432, 1677649144, 1678676870, 1679703608, 1680729357, 1681754118, 1682777890, 1683800672,
+	1684822463, 1685843263, 1686863072, 1687881888, 1688899711, 1689916541, 1690932376, 1691947217,
+	1692961062, 1693973912, 1694985765, 1695996621, 1697006479, 1698015339, 1699023199, 1700030061,
+	1701035922, 1702040783, 1703044642, 1704047500, 1705049355, 1706050207, 1707050055, 1708048900,
+	1709046739, 1710043573, 1711039401, 1712034223, 1713028037, 1714020844, 1715012642, 1716003431,
+	1716993211, 1717981981, 1718969740, 1719956488, 1720942225, 1721926948, 1722910659, 1723893357,
+	1724875040, 1725855708, 1726835361, 1727813999, 1728791620, 1729768224, 1730743810, 1731718378,
+	1732691928, 1733664458, 1734635968, 1735606458, 1736575927, 1737544374, 1738511799, 1739478202,
+	1740443581, 1741407936, 1742371267, 1743333573, 1744294853, 1745255107, 1746214334, 1747172535,
+	1748129707, 1749085851, 1750040966, 1750995052, 1751948107, 1752900132, 1753851126, 1754801087,
+	1755750017, 1756697914, 1757644777, 1758590607, 1759535401, 1760479161, 1761421885, 1762363573,
+	1763304224, 1764243838, 1765182414, 1766119952, 1767056450, 1767991909, 1768926328, 1769859707,
+	1770792044, 1771723340, 1772653593, 1773582803, 1774510970, 1775438094, 1776364172, 1777289206,
+	1778213194, 1779136137, 1780058032, 1780978881, 1781898681, 1782817434, 1783735137, 1784651792,
+	1785567396, 1786481950, 1787395453, 1788307905, 1789219305, 1790129652, 1791038946, 1791947186,
+	1792854372, 1793760504, 1794665580, 1795569601, 1796472565, 1797374472, 1798275323, 1799175115,
+	1800073849, 1800971523, 1801868139, 1802763694, 1803658189, 1804551623, 1805443995, 1806335305,
+	1807225553, 1808114737, 1809002858, 1809889915, 1810775906, 1811660833, 1812544694, 1813427489,
+	1814309216, 1815189877, 1816069469, 1816947994, 1817825449, 1818701835, 1819577151, 1820451397,
+	1821324572, 1822196675, 1823067707, 1823937666, 1824806552, 1825674364, 1826541103, 1827406767,
+	1828271356, 1829134869, 1829997307, 1830858668, 1831718951, 1832578158, 1833436286, 1834293336,
+	1835149306, 1836004197, 1836858008, 1837710739, 1838562388, 1839412956, 1840262441, 1841110844,
+	1841958164, 1842804401, 1843649553, 1844493621, 1845336604, 1846178501, 1847019312, 1847859036,
+	1848697674, 1849535224, 1850371686, 1851207059, 1852041343, 1852874538, 1853706643, 1854537657,
+	1855367581, 1856196413, 1857024153, 1857850800, 1858676355, 1859500816, 1860324183, 1861146456,
+	1861967634, 1862787717, 1863606704, 1864424594, 1865241388, 1866057085, 1866871683, 1867685184,
+	1868497586, 1869308888, 1870119091, 1870928194, 1871736196, 1872543097, 1873348897, 1874153594,
+	1874957189, 1875759681, 1876561070, 1877361354, 1878160535, 1878958610, 1879755580, 1880551444,
+	1881346202, 1882139853, 1882932397, 1883723833, 1884514161, 1885303381, 1886091491, 1886878492,
+	1887664383, 1888449163, 1889232832, 1890015391, 1890796837, 1891577171, 1892356392, 1893134500,
+	1893911494, 1894687374, 1895462140, 1896235790, 1897008325, 1897779744, 1898550047, 1899319232,
+	1900087301, 1900854251, 1901620084, 1902384797, 1903148392, 1903910867, 1904672222, 1905432457,
+	1906191570, 1906949562, 1907706433, 1908462181, 1909216806, 1909970309, 1910722688, 1911473942,
+	1912224073, 1912973078, 1913720958, 1914467712, 1915213340, 1915957841, 1916701216, 1917443462,
+	1918184581, 1918924571, 1919663432, 1920401165, 1921137767, 1921873239, 1922607581, 1923340791,
+	1924072871, 1924803818, 1925533633, 1926262315, 1926989864, 1927716279, 1928441561, 1929165708,
+	1929888720, 1930610597, 1931331338, 1932050943, 1932769411, 1933486742, 1934202936, 1934917992,
+	1935631910, 1936344689, 1937056329, 1937766830, 1938476190, 1939184411, 1939891490, 1940597428,
+	1941302225, 1942005880, 1942708392, 1943409761, 1944109987, 1944809070, 1945507008, 1946203802,
+	1946899451, 1947593954, 1948287312, 1948979524, 1949670589, 1950360508, 1951049279, 1951736902,
+	1952423377, 1953108703, 1953792881, 1954475909, 1955157788, 1955838516, 1956518093, 1957196520,
+	1957873796, 1958549919, 1959224890, 1959898709, 1960571375, 1961242888, 1961913246, 1962582451,
+	1963250501, 1963917396, 1964583136, 1965247720, 1965911148, 1966573420, 1967234535, 1967894492,
+	1968553292, 1969210933, 1969867417, 1970522741, 1971176906, 1971829912, 1972481757, 1973132443,
+	1973781967, 1974430331, 1975077532, 1975723572, 1976368450, 1977012165, 1977654717, 1978296106,
+	1978936331, 1979575392, 1980213288, 1980850019, 1981485585, 1982119985, 1982753220, 1983385288,
+	1984016189, 1984645923, 1985274489, 1985901888, 1986528118, 1987153180, 1987777073, 1988399796,
+	1989021350, 1989641733, 1990260946, 1990878989, 1991495860, 1992111559, 1992726087, 1993339442,
+	1993951625, 1994562635, 1995172471, 1995781134, 1996388622, 1996994937, 1997600076, 1998204040,
+	1998806829, 1999408442, 2000008879, 2000608139, 2001206222, 2001803128, 2002398857, 2002993407,
+	2003586779, 2004178973, 2004769987, 2005359822, 2005948478, 2006535953, 2007122248, 2007707362,
+	2008291295, 2008874047, 2009455617, 2010036005, 2010615210, 2011193233, 2011770073, 2012345729,
+	2012920201, 2013493489, 2014065592, 2014636511, 2015206245, 2015774793, 2016342155, 2016908331,
+	2017473321, 2018037123, 2018599739, 2019161167, 2019721407, 2020280460, 2020838323, 2021394998,
+	2021950484, 2022504780, 2023057887, 2023609803, 2024160529, 2024710064, 2025258408, 2025805561,
+	2026351522, 2026896291, 2027439867, 2027982251, 2028523442, 2029063439, 2029602243, 2030139853,
+	2030676269, 2031211490, 2031745516, 2032278347, 2032809982, 2033340422, 2033869665, 2034397712,
+	2034924562, 2035450215, 2035974670, 2036497928, 2037019988, 2037540850, 2038060512, 2038578976,
+	2039096241, 2039612306, 2040127172, 2040640837, 2041153301, 2041664565, 2042174628, 2042683490,
+	2043191150, 2043697608, 2044202863, 2044706916, 2045209767, 2045711414, 2046211857, 2046711097,
+	2047209133, 2047705965, 2048201592, 2048696014, 2049189231, 2049681242, 2050172048, 2050661647,
+	2051150040, 2051637227, 2052123207, 2052607979, 2053091544, 2053573901, 2054055050, 2054534991,
+	2055013723, 2055491246, 2055967560, 2056442665, 2056916560, 2057389244, 2057860719, 2058330983,
+	2058800036, 2059267877, 2059734508, 2060199927, 2060664133, 2061127128, 2061588910, 2062049479,
+	2062508835, 2062966978, 2063423908, 2063879623, 2064334124, 2064787411, 2065239484, 2065690341,
+	2066139983, 2066588410, 2067035621, 2067481616, 2067926394, 2068369957, 2068812302, 2069253430,
+	2069693342, 2070132035, 2070569511, 2071005769, 2071440808, 2071874629, 2072307231, 2072738614,
+	2073168777, 2073597721, 2074025446, 2074451950, 2074877233, 2075301296, 2075724139, 2076145760,
+	2076566160, 2076985338, 2077403294, 2077820028, 2078235540, 2078649830, 2079062896, 2079474740,
+	2079885360, 2080294757, 2080702930, 2081109879, 2081515603, 2081920103, 2082323379, 2082725429,
+	2083126254, 2083525854, 2083924228, 2084321376, 2084717298, 2085111994, 2085505463, 2085897705,
+	2086288720, 2086678508, 2087067068, 2087454400, 2087840505, 2088225381, 2088609029, 2088991448,
+	2089372638, 2089752599, 2090131331, 2090508833, 2090885105, 2091260147, 2091633960, 2092006541,
+	2092377892, 2092748012, 2093116901, 2093484559, 2093850985, 2094216179, 2094580142, 2094942872,
+	2095304370, 2095664635, 2096023667, 2096381466, 2096738032, 2097093365, 2097447464, 2097800329,
+	2098151960, 2098502357, 2098851519, 2099199446, 2099546139, 2099891596, 2100235819, 2100578805,
+	2100920556, 2101261071, 2101600350, 2101938393, 2102275199, 2102610768, 2102945101, 2103278196,
+	2103610054, 2103940674, 2104270057, 2104598202, 2104925109, 2105250778, 2105575208, 2105898399,
+	2106220352, 2106541065, 2106860540, 2107178775, 2107495770, 2107811526, 2108126041, 2108439317,
+	2108751352, 2109062146, 2109371700, 2109680013, 2109987085, 2110292916, 2110597505, 2110900853,
+	2111202959, 2111503822, 2111803444, 2112101824, 2112398960, 2112694855, 2112989506, 2113282914,
+	2113575080, 2113866001, 2114155680, 2114444114, 2114731305, 2115017252, 2115301954, 2115585412,
+	2115867626, 2116148595, 2116428319, 2116706797, 2116984031, 2117260020, 2117534762, 2117808259,
+	2118080511, 2118351516, 2118621275, 2118889788, 2119157054, 2119423074, 2119687847, 2119951372,
+	2120213651, 2120474683, 2120734467, 2120993003, 2121250292, 2121506333, 2121761126, 2122014670,
+	2122266967, 2122518015, 2122767814, 2123016364, 2123263666, 2123509718, 2123754522, 2123998076,
+	2124240380, 2124481435, 2124721240, 2124959795, 2125197100, 2125433155, 2125667960, 2125901514,
+	2126133817, 2126364870, 2126594672, 2126823222, 2127050522, 2127276570, 2127501367, 2127724913,
+	2127947206, 2128168248, 2128388038, 2128606576, 2128823862, 2129039895, 2129254676, 2129468204,
+	2129680480, 2129891502, 2130101272, 2130309789, 2130517052, 2130723062, 2130927819, 2131131322,
+	2131333572, 2131534567, 2131734309, 2131932796, 2132130030, 2132326009, 2132520734, 2132714204,
+	2132906420, 2133097381, 2133287087, 2133475538, 2133662734, 2133848675, 2134033361, 2134216791,
+	2134398966, 2134579885, 2134759548, 2134937956, 2135115107, 2135291003, 2135465642, 2135639026,
+	2135811153, 2135982023, 2136151637, 2136319994, 2136487095, 2136652938, 2136817525, 2136980855,
+	2137142927, 2137303743, 2137463301, 2137621601, 2137778644, 2137934430, 2138088958, 2138242228,
+	2138394240, 2138544994, 2138694490, 2138842728, 2138989708, 2139135429, 2139279892, 2139423097,
+	2139565043, 2139705730, 2139845159, 2139983329, 2140120240, 2140255892, 2140390284, 2140523418,
+	2140655293, 2140785908, 2140915264, 2141043360, 2141170197, 2141295774, 2141420092, 2141543150,
+	2141664948, 2141785486, 2141904764, 2142022783, 2142139541, 2142255039, 2142369276, 2142482254,
+	2142593971, 2142704427, 2142813624, 2142921559, 2143028234, 2143133648, 2143237802, 2143340694,
+	2143442326, 2143542697, 2143641807, 2143739656, 2143836244, 2143931570, 2144025635, 2144118439,
+	2144209982, 2144300264, 2144389283, 2144477042, 2144563539, 2144648774, 2144732748, 2144815460,
+	2144896910, 2144977098, 2145056025, 2145133690, 2145210092, 2145285233, 2145359112, 2145431729,
+	2145503083, 2145573176, 2145642006, 2145709574, 2145775880, 2145840924, 2145904705, 2145967224,
+	2146028480, 2146088474, 2146147205, 2146204674, 2146260881, 2146315824, 2146369505, 2146421924,
+	2146473080, 2146522973, 2146571603, 2146618971, 2146665076, 2146709917, 2146753497, 2146795813,
+	2146836866, 2146876656, 2146915184, 2146952448, 2146988450, 2147023188, 2147056664, 2147088876,
+	2147119825, 2147149511, 2147177934, 2147205094, 2147230991, 2147255625, 2147278995, 2147301102,
+	2147321946, 2147341527, 2147359845, 2147376899, 2147392690, 2147407218, 2147420483, 2147432484,
+	2147443222, 2147452697, 2147460908, 2147467857, 2147473542, 2147477963, 2147481121, 2147483016,
+	2147483647
+};
+
+
+/*******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+void AacDecoder_Init(void)
+{
+	aacScratch_t * scratch = AudioDecoder_GetScratch();
+
+	channels = scratch->channels;
+	spectrum = scratch->spectrum;
+	msUsed = scratch->msUsed;
+	frameData = scratch->frameData;
+
+	playing = NULL;
+	incoming = NULL;
+	centerCancel = false;
+}
+
+
+bool AacDecoder_LoadFile(decoder_stream_t stream, const char* filename)
+{
+	mp4Parse_t ctx;
+
+	AacDecoder_Close(stream);
+
+	// Another codec may have used the memory, nothing but the ring is read before it is set
+	aacStream_t * st = AudioDecoder_GetStreamMemory(stream);
+	memset(st, 0, offsetof(aacStream_t, ring));
+
+	if (f_open(&st->file, _T(filename), FA_READ) != FR_OK)
+	{
+		return false;
+	}
+
+	st->dataEnd = f_size(&st->file);
+	memset(&ctx, 0, sizeof(ctx));
+	seekAligned(st, 0);
+
+	// The moov box can be before or after the audio (mdat), the top level boxes are walked until it is found
+	if (!parseBoxes(st, &ctx, st->dataEnd, 0) || !ctx.trackFound || !buildIndex(st, &ctx.chosen))
+	{
+		f_close(&st->file);
+		return false;
+	}
+
+	const mp4Track_t * track = &ctx.chosen;
+	st->rate = &rates[track->rateIndex - AAC_FIRST_RATE_INDEX];
+	st->sampleRate = st->rate->sampleRate;
+	st->endSample = (uint64_t)st->frameCount * AAC_FRAME_LENGTH;
+	st->startSkip = 0;
+
+	// The edit list says where the encoder delay ends and, with the duration, where the padding of the last frame starts
+	if ((track->mediaTime > 0) && track->timescale)
+	{
+		uint64_t start = (uint64_t)track->mediaTime * st->sampleRate / track->timescale;
+		st->startSkip = (start < st->endSample) ? (uint32_t)start : 0;
+	}
+	if (track->editDuration && ctx.movieTimescale)
+	{
+		uint64_t end = st->startSkip + track->editDuration * st->sampleRate / ctx.movieTimescale;
+		if (end < st->endSample)
+		{
+			st->endSample = end;
+		}
+	}
+
+	restoreFrame(st, 0);
+	st->fileIsOpened = true;
+	st->sample = 0;
+	st->skipSamples = st->startSkip;
+	st->previousShape[0] = SINE_WINDOW;
+	st->previousShape[1] = SINE_WINDOW;
+
+	if (stream == DECODER_PLAYING_STREAM)
+	{
+		playing = st;
+	}
+	else
+	{
+		incoming = st;
+	}
+	return true;
+}
+
+
+decoder_result_t AacDecoder_DecodeFrame(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate)
+{
+	aacStream_t * st = (stream == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	*numSamplesDecoded = 0;
+	*sampleRate = 0;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return DECODER_NO_FILE;
+	}
+	if (decodedBufferSize < AAC_FRAME_LENGTH)
+	{
+		return DECODER_OVERFLOW;
+	}
+
+	for (;;)
+	{
+		if ((st->frame >= st->frameCount) || (st->sample >= st->endSample))
+		{
+			return DECODER_END_OF_FILE;
+		}
+
+		// A damaged frame outputs the end of the last one, the frames keep their place in time
+		uint32_t size = frameSize(st, st->frame);
+		uint8_t count = 0;
+
+		if (!readFrame(st, st->cursor.offset, size) || !decodeRawBlock(st, &count))
+		{
+			count = 0;
+		}
+		synthesize(st, count, decodedDataBuffer);
+
+		if (!advanceCursor(st, size))
+		{
+			st->frameCount = st->frame;
+		}
+
+		uint32_t frames = AAC_FRAME_LENGTH;
+		if (st->sample + frames > st->endSample)
+		{
+			frames = (uint32_t)(st->endSample - st->sample);
+		}
+		st->sample += frames;
+
+		uint32_t skip = (frames < st->skipSamples) ? frames : st->skipSamples;
+		st->skipSamples -= skip;
+		frames -= skip;
+
+		if (frames > 0)
+		{
+			if (skip)
+			{
+				memmove(decodedDataBuffer, decodedDataBuffer + skip, frames * sizeof(short));
+			}
+			*numSamplesDecoded = frames;
+			*sampleRate = st->sampleRate;
+			return DECODER_WORKED;
+		}
+	}
+}
+
+
+bool AacDecoder_ReadAhead(void)
+{
+	bool res = false;
+
+	if (playing && playing->fileIsOpened)
+	{
+		res = (fillRing(playing) != 0);
+	}
+	if (!res && incoming && incoming->fileIsOpened)
+	{
+		res = (fillRing(incoming) != 0);
+	}
+	return res;
+}
+
+
+void AacDecoder_Close(decoder_stream_t stream)
+{
+	aacStream_t ** st = (stream == DECODER_PLAYING_STREAM) ? &playing : &incoming;
+
+	if (*st && (*st)->fileIsOpened)
+	{
+		f_close(&(*st)->file);
+		(*st)->fileIsOpened = false;
+	}
+
+	// The memory goes back to the decoder layer
+	*st = NULL;
+}
+
+
+/*******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+static bool parseBoxes(aacStream_t * st, mp4Parse_t * ctx, uint32_t end, uint8_t depth)
+{
+	uint32_t type;
+	uint32_t boxEnd;
+	uint8_t data[24];
+
+	while ((st->position < end) && readBoxHeader(st, end, &type, &boxEnd))
+	{
+		switch (type)
+		{
+			case BOX_TYPE('m', 'o', 'o', 'v'):
+			case BOX_TYPE('m', 'd', 'i', 'a'):
+			case BOX_TYPE('m', 'i', 'n', 'f'):
+			case BOX_TYPE('s', 't', 'b', 'l'):
+			case BOX_TYPE('e', 'd', 't', 's'):
+			case BOX_TYPE('u', 'd', 't', 'a'):
+				if ((depth < MP4_MAX_DEPTH) && !parseBoxes(st, ctx, boxEnd, depth + 1))
+				{
+					return false;
+				}
+				break;
+
+			case BOX_TYPE('t', 'r', 'a', 'k'):
+				memset(&ctx->track, 0, sizeof(ctx->track));
+				if ((depth < MP4_MAX_DEPTH) && !parseBoxes(st, ctx, boxEnd, depth + 1))
+				{
+					return false;
+				}
+				if (!ctx->trackFound && ctx->track.isAudio && ctx->track.isAac &&
+					ctx->track.sizesOffset && ctx->track.chunksCount && ctx->track.runsCount)
+				{
+					ctx->chosen = ctx->track;
+					ctx->trackFound = true;
+				}
+				break;
+
+			case BOX_TYPE('m', 'e', 't', 'a'):
+				// A full box in MP4 files, not in QuickTime ones: there the first child follows
+				if (!readBytes(st, data, 4))
+				{
+					return false;
+				}
+				if (READ_BE32(data))
+				{
+					ringSeek(st, st->position - 4);
+				}
+				if ((depth < MP4_MAX_DEPTH) && !parseBoxes(st, ctx, boxEnd, depth + 1))
+				{
+					return false;
+				}
+				break;
+
+			case BOX_TYPE('i', 'l', 's', 't'):
+				parseTags(st, boxEnd);
+				break;
+
+			case BOX_TYPE('m', 'v', 'h', 'd'):
+				if (readBytes(st, data, 24))
+				{
+					ctx->movieTimescale = READ_BE32(data[0] ? &data[20] : &data[12]);
+				}
+				break;
+
+			case BOX_TYPE('m', 'd', 'h', 'd'):
+				if (readBytes(st, data, 24))
+				{
+					ctx->track.timescale = READ_BE32(data[0] ? &data[20] : &data[12]);
+				}
+				break;
+
+			case BOX_TYPE('h', 'd', 'l', 'r'):
+				if (readBytes(st, data, 12))
+				{
+					// The hdlr of a meta box inside the track does not undo the one of the media
+					ctx->track.isAudio |= (READ_BE32(&data[8]) == BOX_TYPE('s', 'o', 'u', 'n'));
+				}
+				break;
+
+			case BOX_TYPE('e', 'l', 's', 't'):
+				// The first entry, or the second if the first one is an empty edit (media time -1)
+				if (readBytes(st, data, 8))
+				{
+					bool version1 = (data[0] != 0);
+					uint32_t entries = READ_BE32(&data[4]);
+
+					for (uint32_t i = 0; (i < entries) && (i < 2); i++)
+					{
+						if (!readBytes(st, data, version1 ? 20 : 12))
+						{
+							break;
+						}
+						int64_t mediaTime = version1 ? (int64_t)(((uint64_t)READ_BE32(&data[8]) << 32) | READ_BE32(&data[12]))
+													 : (int32_t)READ_BE32(&data[4]);
+						if (mediaTime >= 0)
+						{
+							ctx->track.mediaTime = mediaTime;
+							ctx->track.editDuration = version1 ? (((uint64_t)READ_BE32(&data[0]) << 32) | READ_BE32(&data[4]))
+															   : READ_BE32(&data[0]);
+							break;
+						}
+					}
+				}
+				break;
+
+			case BOX_TYPE('s', 't', 's', 'd'):
+				parseSampleDescription(st, &ctx->track, boxEnd);
+				break;
+
+			case BOX_TYPE('s', 't', 's', 'z'):
+				// Version, sample size, sample count, then the sizes if they are not all the same
+				if (readBytes(st, data, 12))
+				{
+					ctx->track.fixedSize = READ_BE32(&data[4]);
+					ctx->track.sizesCount = READ_BE32(&data[8]);
+					ctx->track.sizesOffset = st->position;
+					if (!ctx->track.fixedSize && ((uint64_t)ctx->track.sizesCount * 4 > boxEnd - st->position))
+					{
+						ctx->track.sizesCount = (boxEnd - st->position) / 4;
+					}
+				}
+				break;
+
+			case BOX_TYPE('s', 't', 'c', 'o'):
+			case BOX_TYPE('c', 'o', '6', '4'):
+				if (readBytes(st, data, 8))
+				{
+					ctx->track.chunkEntrySize = (type == BOX_TYPE('c', 'o', '6', '4')) ? 8 : 4;
+					ctx->track.chunksCount = READ_BE32(&data[4]);
+					ctx->track.chunksOffset = st->position;
+					if ((uint64_t)ctx->track.chunksCount * ctx->track.chunkEntrySize > boxEnd - st->position)
+					{
+						ctx->track.chunksCount = (boxEnd - st->position) / ctx->track.chunkEntrySize;
+					}
+				}
+				break;
+
+			case BOX_TYPE('s', 't', 's', 'c'):
+				if (readBytes(st, data, 8))
+				{
+					ctx->track.runsCount = READ_BE32(&data[4]);
+					ctx->track.runsOffset = st->position;
+					if ((uint64_t)ctx->track.runsCount * 12 > boxEnd - st->position)
+					{
+						ctx->track.runsCount = (boxEnd - st->position) / 12;
+					}
+				}
+				break;
+
+			default:
+				break;
+		}
+
+		ringSeek(st, boxEnd);
+
+		if ((depth == 0) && (type == BOX_TYPE('m', 'o', 'o', 'v')))
+		{
+			// Nothing else is needed
+			return true;
+		}
+	}
+
+	return (st->position >= end);
+}
+
+
+static bool readBoxHeader(aacStream_t * st, uint32_t end, uint32_t * type, uint32_t * boxEnd)
+{
+	uint32_t start = st->position;
+	uint8_t header[16];
+
+	if ((end - start < 8) || !readBytes(st, header, 8))
+	{
+		return false;
+	}
+
+	uint64_t size = READ_BE32(header);
+	*type = READ_BE32(&header[4]);
+
+	if (size == 1)
+	{
+		// 64 bit size, more than FAT files can hold unless the high half is 0
+		if (!readBytes(st, &header[8], 8))
+		{
+			return false;
+		}
+		size = ((uint64_t)READ_BE32(&header[8]) << 32) | READ_BE32(&header[12]);
+	}
+	else if (size == 0)
+	{
+		// Up to the end of the file
+		size = end - start;
+	}
+
+	if ((size < st->position - start) || (size > end - start))
+	{
+		return false;
+	}
+
+	*boxEnd = start + (uint32_t)size;
+	return true;
+}
+
+
+static void parseSampleDescription(aacStream_t * st, mp4Track_t * track, uint32_t end)
+{
+	uint32_t type;
+	uint32_t boxEnd;
+	uint8_t data[36];
+
+	// Version and entry count, then the first entry. Its 28 bytes of AudioSampleEntry are 16 or 36 longer for QuickTime 1 and 2
+	if (!readBytes(st, data, 8) || !READ_BE32(&data[4]) || !readBoxHeader(st, end, &type, &end) ||
+		(type != BOX_TYPE('m', 'p', '4', 'a')) || !readBytes(st, data, 28))
+	{
+		return;
+	}
+
+	uint32_t version = READ_BE16(&data[8]);
+	if (version == 1)
+	{
+		ringSeek(st, st->position + 16);
+	}
+	else if (version == 2)
+	{
+		ringSeek(st, st->position + 36);
+	}
+
+	// The esds is a child, or inside a wave box in QuickTime files
+	while ((st->position < end) && readBoxHeader(st, end, &type, &boxEnd))
+	{
+		if (type == BOX_TYPE('w', 'a', 'v', 'e'))
+		{
+			end = boxEnd;
+			continue;
+		}
+		if ((type == BOX_TYPE('e', 's', 'd', 's')) && readBytes(st, data, 4))
+		{
+			parseEsds(st, track, boxEnd);
+			return;
+		}
+		ringSeek(st, boxEnd);
+	}
+}
+
+
+static void parseEsds(aacStream_t * st, mp4Track_t * track, uint32_t end)
+{
+	uint8_t data[16];
+	uint32_t size;
+
+	// ES_Descriptor: ES_ID, flags and what they say is there
+	if ((readDescriptor(st, &size) != 0x03) || !readBytes(st, data, 3))
+	{
+		return;
+	}
+	// Fields in flag order: depended on stream, URL, OCR stream
+	ringSeek(st, st->position + ((data[2] & 0x80) ? 2 : 0));
+	if (data[2] & 0x40)
+	{
+		int32_t urlLength = ringByte(st);
+		ringSeek(st, st->position + ((urlLength > 0) ? urlLength : 0));
+	}
+	ringSeek(st, st->position + ((data[2] & 0x20) ? 2 : 0));
+
+	// DecoderConfigDescriptor: MPEG-4 audio, then the DecoderSpecificInfo has the AudioSpecificConfig
+	if ((readDescriptor(st, &size) != 0x04) || !readBytes(st, data, 13) || (data[0] != 0x40) ||
+		(readDescriptor(st, &size) != 0x05) || (st->position + size > end))
+	{
+		return;
+	}
+	if (size > sizeof(data))
+	{
+		size = sizeof(data);
+	}
+	if (readBytes(st, data, size))
+	{
+		track->isAac = parseAudioConfig(data, size, track);
+	}
+}
+
+
+static int32_t readDescriptor(aacStream_t * st, uint32_t * size)
+{
+	int32_t tag = ringByte(st);
+
+	*size = 0;
+	for (uint8_t i = 0; i < MP4_MAX_DESCRIPTOR; i++)
+	{
+		int32_t byte = ringByte(st);
+		if (byte < 0)
+		{
+			return -1;
+		}
+		*size = (*size << 7) | (byte & 0x7F);
+		if (!(byte & 0x80))
+		{
+			break;
+		}
+	}
+	return tag;
+}
+
+
+static bool parseAudioConfig(const uint8_t * config, uint32_t length, mp4Track_t * track)
+{
+	uint32_t bits = 0;
+	uint32_t objectType;
+	uint32_t rateIndex;
+	uint32_t channelConfig;
+
+	// Past the end the fields read 0s, the check at the end refuses it
+	objectType = configBits(config, length, &bits, 5);
+	rateIndex = configBits(config, length, &bits, 4);
+	if (rateIndex == 15)
+	{
+		// Explicit rate, only the standard ones have scalefactor bands
+		uint32_t rate = configBits(config, length, &bits, 24);
+		for (rateIndex = 0; (rateIndex < sizeof(rates) / sizeof(rates[0])) && (rates[rateIndex].sampleRate != rate); rateIndex++);
+		rateIndex += AAC_FIRST_RATE_INDEX;
+	}
+	channelConfig = configBits(config, length, &bits, 4);
+
+	if ((objectType == AAC_OBJECT_SBR) || (objectType == AAC_OBJECT_PS))
+	{
+		// HE-AAC: the output rate, then the AAC-LC it extends, which is what we play
+		if (configBits(config, length, &bits, 4) == 15)
+		{
+			configBits(config, length, &bits, 24);
+		}
+		objectType = configBits(config, length, &bits, 5);
+	}
+
+	// GASpecificConfig: frames of 1024, the 960 ones are not supported
+	uint32_t frameLengthFlag = configBits(config, length, &bits, 1);
+
+	if ((bits > length * 8) || (objectType != AAC_OBJECT_LC) || frameLengthFlag ||
+		(channelConfig < 1) || (channelConfig > AAC_MAX_CHANNELS) ||
+		(rateIndex < AAC_FIRST_RATE_INDEX) || (rateIndex >= AAC_FIRST_RATE_INDEX + sizeof(rates) / sizeof(rates[0])))
+	{
+		return false;
+	}
+
+	track->rateIndex = rateIndex;
+	return true;
+}
+
+
+static uint32_t configBits(const uint8_t * config, uint32_t length, uint32_t * bit, uint8_t n)
+{
+	uint32_t value = 0;
+
+	for (uint8_t i = 0; i < n; i++, (*bit)++)
+	{
+		uint32_t byte = *bit >> 3;
+		value = (value << 1) | ((byte < length) ? ((config[byte] >> (7 - (*bit & 7))) & 1) : 0);
+	}
+	return value;
+}
+
+
+static void parseTags(aacStream_t * st, uint32_t end)
+{
+	uint32_t type;
+	uint32_t itemEnd;
+	uint32_t dataType;
+	uint32_t dataEnd;
+	uint8_t header[8];
+
+	// Each item box has a data box: its type, a locale, then the value
+	while ((st->position < end) && readBoxHeader(st, end, &type, &itemEnd))
+	{
+		uint8_t tag;
+		for (tag = 0; (tag < AAC_TAG_COUNT) && (tagBoxes[tag] != type); tag++);
+
+		if ((tag < AAC_TAG_COUNT) && readBoxHeader(st, itemEnd, &dataType, &dataEnd) &&
+			(dataType == BOX_TYPE('d', 'a', 't', 'a')) && readBytes(st, header, 8))
+		{
+			char * value = st->tags[tag];
+			uint32_t length = dataEnd - st->position;
+
+			if (tag == AUDIO_TAG_TRACK_NUM)
+			{
+				// Binary: 2 bytes, the track number and the count
+				uint8_t number[4];
+				if ((length >= 4) && readBytes(st, number, 4))
+				{
+					uint32_t track = READ_BE16(&number[2]);
+					char digits[6];
+					uint8_t n = 0;
+					do
+					{
+						digits[n++] = '0' + track % 10;
+						track /= 10;
+					} while (track);
+					for (uint8_t i = 0; i < n; i++)
+					{
+						value[i] = digits[n - 1 - i];
+					}
+					value[n] = '\0';
+				}
+			}
+			else
+			{
+				if (length > AAC_TAG_SIZE - 1)
+				{
+					length = AAC_TAG_SIZE - 1;
+				}
+				if (!readBytes(st, (uint8_t *)value, length))
+				{
+					length = 0;
+				}
+				value[length] = '\0';
+			}
+		}
+		ringSeek(st, itemEnd);
+	}
+}
+
+
+static bool readBytes(aacStream_t * st, uint8_t * data, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		int32_t byte = ringByte(st);
+		if (byte < 0)
+		{
+			return false;
+		}
+		data[i] = byte;
+	}
+	return true;
+}
+
+
+static bool buildIndex(aacStream_t * st, const mp4Track_t * track)
+{
+	st->fixedSize = track->fixedSize;
+	st->frameCount = track->sizesCount;
+
+	st->sizes.offset = track->sizesOffset;
+	st->sizes.count = track->fixedSize ? 0 : track->sizesCount;
+	st->sizes.entrySize = 4;
+	st->chunks.offset = track->chunksOffset;
+	st->chunks.count = track->chunksCount;
+	st->chunks.entrySize = track->chunkEntrySize;
+	st->runs.offset = track->runsOffset;
+	st->runs.count = track->runsCount;
+	st->runs.entrySize = 12;
+	st->sizes.cached = 0;
+	st->chunks.cached = 0;
+	st->runs.cached = 0;
+
+	// The first stsc entry is for the first chunk
+	if (!st->frameCount || (tableRead(st, &st->runs, 0, 0) != 1))
+	{
+		return false;
+	}
+
+	st->indexShift = 0;
+	while (((st->frameCount - 1) >> st->indexShift) >= AAC_INDEX_ENTRIES)
+	{
+		st->indexShift++;
+	}
+
+	st->frame = 0;
+	st->cursor.chunk = 0;
+	st->cursor.inChunk = 0;
+	st->cursor.run = 0;
+	st->cursor.offset = tableRead(st, &st->chunks, 0, (st->chunks.entrySize == 8) ? 1 : 0);
+	loadRun(st);
+	if (!st->chunkFrames)
+	{
+		return false;
+	}
+
+	// One pass over the sizes, through the ring (the chunk and run tables go through their caches)
+	uint32_t mask = (1U << st->indexShift) - 1;
+	seekAligned(st, st->sizes.offset);
+
+	while (st->frame < st->frameCount)
+	{
+		uint32_t size = st->fixedSize;
+		uint8_t data[4];
+
+		if (!(st->frame & mask))
+		{
+			st->index[st->frame >> st->indexShift] = st->cursor;
+		}
+		if (!size)
+		{
+			if (!readBytes(st, data, 4))
+			{
+				break;
+			}
+			size = READ_BE32(data);
+		}
+		if (!advanceCursor(st, size))
+		{
+			break;
+		}
+	}
+
+	// The frames past the last chunk, if the tables do not add up, are left out
+	st->frameCount = st->frame;
+	return (st->frameCount != 0);
+}
+
+
+static void restoreFrame(aacStream_t * st, uint32_t frame)
+{
+	uint32_t entry = frame >> st->indexShift;
+
+	st->cursor = st->index[entry];
+	st->frame = entry << st->indexShift;
+	loadRun(st);
+
+	while ((st->frame < frame) && advanceCursor(st, frameSize(st, st->frame)));
+}
+
+
+static bool advanceCursor(aacStream_t * st, uint32_t size)
+{
+	aacPosition_t * c = &st->cursor;
+
+	st->frame++;
+	c->offset += size;
+	c->inChunk++;
+
+	if (c->inChunk >= st->chunkFrames)
+	{
+		// Next chunk, it can be anywhere in the file
+		c->chunk++;
+		c->inChunk = 0;
+		if (c->chunk >= st->chunks.count)
+		{
+			return false;
+		}
+		if (c->chunk >= st->nextRunChunk)
+		{
+			c->run++;
+			loadRun(st);
+			if (!st->chunkFrames)
+			{
+				return false;
+			}
+		}
+		c->offset = tableRead(st, &st->chunks, c->chunk, (st->chunks.entrySize == 8) ? 1 : 0);
+	}
+	return true;
+}
+
+
+static void loadRun(aacStream_t * st)
+{
+	// First chunk (1 based), frames per chunk, sample description
+	st->chunkFrames = tableRead(st, &st->runs, st->cursor.run, 1);
+	st->nextRunChunk = (st->cursor.run + 1 < st->runs.count) ? tableRead(st, &st->runs, st->cursor.run + 1, 0) - 1 : UINT32_MAX;
+
+	if (st->nextRunChunk <= st->cursor.chunk)
+	{
+		// Out of order, this run is taken to last one chunk
+		st->nextRunChunk = st->cursor.chunk + 1;
+	}
+}
+
+
+static uint32_t tableRead(aacStream_t * st, aacTable_t * table, uint32_t index, uint8_t field)
+{
+	if (index >= table->count)
+	{
+		return 0;
+	}
+
+	if (index - table->first >= table->cached)
+	{
+		// The block of entries it is in, then back to where the ring reads from
+		uint32_t perCache = AAC_TABLE_CACHE_BYTES / table->entrySize;
+		uint32_t first = index - index % perCache;
+		uint32_t count = (table->count - first < perCache) ? (table->count - first) : perCache;
+		UINT bytesRead = 0;
+
+		if ((f_lseek(&st->file, table->offset + first * table->entrySize) != FR_OK) ||
+			(f_read(&st->file, table->cache, count * table->entrySize, &bytesRead) != FR_OK))
+		{
+			bytesRead = 0;
+		}
+		f_lseek(&st->file, st->readPosition);
+
+		table->first = first;
+		table->cached = bytesRead / table->entrySize;
+		if (index - first >= table->cached)
+		{
+			return 0;
+		}
+	}
+
+	const uint8_t * entry = &table->cache[(index - table->first) * table->entrySize + field * 4];
+	return READ_BE32(entry);
+}
+
+
+static inline uint32_t frameSize(aacStream_t * st, uint32_t frame)
+{
+	return st->fixedSize ? st->fixedSize : tableRead(st, &st->sizes, frame, 0);
+}
+
+
+static bool readFrame(aacStream_t * st, uint32_t offset, uint32_t size)
+{
+	if (!size || (size > AAC_MAX_FRAME_BYTES))
+	{
+		return false;
+	}
+
+	ringSeek(st, offset);
+
+	uint32_t copied = 0;
+	while (copied < size)
+	{
+		if ((st->position >= st->readPosition) && (!fillRing(st) || (st->position >= st->readPosition)))
+		{
+			return false;
+		}
+
+		uint32_t ringIndex = st->position & AAC_RING_MASK;
+		uint32_t bytes = size - copied;
+		if (bytes > st->readPosition - st->position)
+		{
+			bytes = st->readPosition - st->position;
+		}
+		if (bytes > AAC_RING_SIZE - ringIndex)
+		{
+			bytes = AAC_RING_SIZE - ringIndex;
+		}
+
+		memcpy(&frameData[copied], &st->ring[ringIndex], bytes);
+		st->position += bytes;
+		copied += bytes;
+	}
+
+	memset(&frameData[size], 0, 4);
+	bitPosition = 0;
+	bitLength = size * 8;
+	return true;
+}
+
+
+static uint32_t fillRing(aacStream_t * st)
+{
+	uint32_t totalBytesRead = 0;
+
+	while (!st->fileEnded && (st->readPosition < st->dataEnd))
+	{
+		// Whole sectors, up to the sector of the next byte (still in use) or the end of the ring
+		uint32_t ringIndex = st->readPosition & AAC_RING_MASK;
+		uint32_t bytesToRead = AAC_RING_SIZE - (st->readPosition - (st->position & ~(FILE_SECTOR_SIZE - 1)));
+
+		if (bytesToRead > AAC_RING_SIZE - ringIndex)
+		{
+			bytesToRead = AAC_RING_SIZE - ringIndex;
+		}
+
+		if (bytesToRead < FILE_SECTOR_SIZE)
+		{
+			break;
+		}
+
+		UINT bytesRead = 0;
+		if (f_read(&st->file, &st->ring[ringIndex], bytesToRead, &bytesRead) != FR_OK)
+		{
+			bytesRead = 0;
+		}
+
+		st->readPosition += bytesRead;
+		totalBytesRead += bytesRead;
+		st->fileEnded = (bytesRead < bytesToRead);
+	}
+
+	return totalBytesRead;
+}
+
+
+static void seekAligned(aacStream_t * st, uint32_t filePosition)
+{
+	uint32_t sectorStart = filePosition & ~(FILE_SECTOR_SIZE - 1);
+
+	f_lseek(&st->file, sectorStart);
+
+	st->readPosition = sectorStart;
+	st->position = filePosition;
+	st->fileEnded = false;
+}
+
+
+static void ringSeek(aacStream_t * st, uint32_t filePosition)
+{
+	// The ring has from the sector of the position up to readPosition
+	if ((filePosition >= (st->position & ~(FILE_SECTOR_SIZE - 1))) && (filePosition <= st->readPosition))
+	{
+		st->position = filePosition;
+	}
+	else
+	{
+		seekAligned(st, filePosition);
+	}
+}
+
+
+static int32_t ringByte(aacStream_t * st)
+{
+	if ((st->position >= st->readPosition) && (!fillRing(st) || (st->position >= st->readPosition)))
+	{
+		return -1;
+	}
+	return RING_BYTE(st, st->position++);
+}
+
+
+static bool decodeRawBlock(aacStream_t * st, uint8_t * count)
+{
+	*count = 0;
+
+	for (;;)
+	{
+		uint32_t id = bitsRead(3);
+		uint32_t length;
+
+		if (bitsEnded())
+		{
+			return false;
+		}
+
+		switch (id)
+		{
+			case ID_SCE:
+				if (*count)
+				{
+					// A second audio element, only the first one is played
+					return true;
+				}
+				bitsRead(4);
+				if (!decodeIcs(st, 0, false))
+				{
+					return false;
+				}
+				applyTns(&channels[0], spectrum[0]);
+				*count = 1;
+				break;
+
+			case ID_CPE:
+				if (*count)
+				{
+					return true;
+				}
+				bitsRead(4);
+				if (!decodeChannelPair(st))
+				{
+					return false;
+				}
+				*count = 2;
+				break;
+
+			case ID_FIL:
+				length = bitsRead(4);
+				if (length == 15)
+				{
+					length += bitsRead(8) - 1;
+				}
+				bitsSkip(8 * length);
+				break;
+
+			case ID_DSE:
+			{
+				bitsRead(4);
+				bool align = bitsRead(1);
+				length = bitsRead(8);
+				if (length == 255)
+				{
+					length += bitsRead(8);
+				}
+				if (align)
+				{
+					bitsSkip((8 - (bitPosition & 7)) & 7);
+				}
+				bitsSkip(8 * length);
+				break;
+			}
+
+			case ID_END:
+				return (*count != 0);
+
+			default:
+				// CCE, LFE and PCE are not played. The frame size says where the next frame is
+				return (*count != 0);
+		}
+	}
+}
+
+
+static bool decodeChannelPair(aacStream_t * st)
+{
+	bool commonWindow = bitsRead(1);
+	uint8_t msMaskPresent = 0;
+
+	if (commonWindow)
+	{
+		if (!parseIcsInfo(st, &channels[0].info))
+		{
+			return false;
+		}
+		channels[1].info = channels[0].info;
+
+		msMaskPresent = bitsRead(2);
+		if (msMaskPresent == 3)
+		{
+			return false;
+		}
+		if (msMaskPresent == 1)
+		{
+			const aacIcsInfo_t * info = &channels[0].info;
+			for (uint8_t g = 0; g < info->groups; g++)
+			{
+				for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+				{
+					msUsed[g][sfb] = bitsRead(1);
+				}
+			}
+		}
+	}
+
+	if (!decodeIcs(st, 0, commonWindow) || !decodeIcs(st, 1, commonWindow))
+	{
+		return false;
+	}
+
+	if (commonWindow)
+	{
+		applyStereo(msMaskPresent);
+	}
+	applyTns(&channels[0], spectrum[0]);
+	applyTns(&channels[1], spectrum[1]);
+	return true;
+}
+
+
+static bool decodeIcs(aacStream_t * st, uint8_t ch, bool commonWindow)
+{
+	aacChannel_t * c = &channels[ch];
+	int32_t * spec = spectrum[ch];
+
+	c->globalGain = bitsRead(8);
+	if (!commonWindow && !parseIcsInfo(st, &c->info))
+	{
+		return false;
+	}
+	if (!parseSections(c) || !parseScalefactors(c))
+	{
+		return false;
+	}
+
+	// Pulses, long windows only
+	c->pulseCount = 0;
+	if (bitsRead(1))
+	{
+		if (c->info.windowSequence == EIGHT_SHORT_SEQUENCE)
+		{
+			return false;
+		}
+		c->pulseCount = bitsRead(2) + 1;
+		c->pulseStart = bitsRead(6);
+		for (uint8_t i = 0; i < c->pulseCount; i++)
+		{
+			c->pulseOffset[i] = bitsRead(5);
+			c->pulseAmplitude[i] = bitsRead(4);
+		}
+		if (c->pulseStart >= c->info.bands)
+		{
+			return false;
+		}
+	}
+
+	c->tnsCount = 0;
+	if (bitsRead(1))
+	{
+		parseTns(st, c);
+	}
+
+	// Gain control is for the SSR profile
+	if (bitsRead(1))
+	{
+		return false;
+	}
+
+	memset(spec, 0, AAC_LONG_HALF * sizeof(int32_t));
+	if (!decodeSpectrum(c, spec))
+	{
+		return false;
+	}
+
+	if (c->pulseCount)
+	{
+		uint32_t k = c->info.swbOffset[c->pulseStart];
+		for (uint8_t i = 0; i < c->pulseCount; i++)
+		{
+			k += c->pulseOffset[i];
+			if (k >= AAC_LONG_HALF)
+			{
+				return false;
+			}
+			spec[k] += (spec[k] > 0) ? c->pulseAmplitude[i] : -c->pulseAmplitude[i];
+		}
+	}
+
+	dequantize(c, spec);
+	return !bitsEnded();
+}
+
+
+static bool parseIcsInfo(aacStream_t * st, aacIcsInfo_t * info)
+{
+	bitsRead(1);
+	info->windowSequence = bitsRead(2);
+	info->windowShape = bitsRead(1);
+
+	if (info->windowSequence == EIGHT_SHORT_SEQUENCE)
+	{
+		info->maxSfb = bitsRead(4);
+		info->bands = st->rate->shortBands;
+		info->swbOffset = st->rate->shortOffsets;
+
+		// A 0 in the grouping starts a new group
+		uint32_t grouping = bitsRead(7);
+		info->groups = 1;
+		info->groupLength[0] = 1;
+		for (int8_t bit = 6; bit >= 0; bit--)
+		{
+			if (grouping & (1U << bit))
+			{
+				info->groupLength[info->groups - 1]++;
+			}
+			else
+			{
+				info->groupLength[info->groups++] = 1;
+			}
+		}
+	}
+	else
+	{
+		info->maxSfb = bitsRead(6);
+		info->bands = st->rate->longBands;
+		info->swbOffset = st->rate->longOffsets;
+		info->groups = 1;
+		info->groupLength[0] = 1;
+
+		// Prediction is for the Main profile
+		if (bitsRead(1))
+		{
+			return false;
+		}
+	}
+
+	return (info->maxSfb <= info->bands);
+}
+
+
+static bool parseSections(aacChannel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint32_t lengthBits = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? 3 : 5;
+	uint32_t escape = (1U << lengthBits) - 1;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		uint32_t sfb = 0;
+		while (sfb < info->maxSfb)
+		{
+			uint32_t codebook = bitsRead(4);
+			uint32_t length = 0;
+			uint32_t increment;
+
+			do
+			{
+				increment = bitsRead(lengthBits);
+				length += increment;
+			} while ((increment == escape) && !bitsEnded());
+
+			if ((codebook == RESERVED_HCB) || !length || (sfb + length > info->maxSfb) || bitsEnded())
+			{
+				return false;
+			}
+			memset(&c->codebook[g][sfb], codebook, length);
+			sfb += length;
+		}
+	}
+	return true;
+}
+
+
+static bool parseScalefactors(aacChannel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+	int32_t scalefactor = c->globalGain;
+	int32_t position = 0;
+	int32_t energy = c->globalGain - NOISE_OFFSET;
+	bool firstNoise = true;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			int32_t diff;
+
+			switch (c->codebook[g][sfb])
+			{
+				case ZERO_HCB:
+					c->scalefactor[g][sfb] = 0;
+					break;
+
+				case INTENSITY_HCB:
+				case INTENSITY_HCB2:
+					if ((diff = decodeCodeword(scalefactorTree)) < 0)
+					{
+						return false;
+					}
+					position += diff - SF_DIFF_OFFSET;
+					c->scalefactor[g][sfb] = position;
+					break;
+
+				case NOISE_HCB:
+					if (firstNoise)
+					{
+						energy += (int32_t)bitsRead(9) - NOISE_PCM_OFFSET;
+						firstNoise = false;
+					}
+					else
+					{
+						if ((diff = decodeCodeword(scalefactorTree)) < 0)
+						{
+							return false;
+						}
+						energy += diff - SF_DIFF_OFFSET;
+					}
+					c->scalefactor[g][sfb] = energy;
+					break;
+
+				default:
+					if ((diff = decodeCodeword(scalefactorTree)) < 0)
+					{
+						return false;
+					}
+					scalefactor += diff - SF_DIFF_OFFSET;
+					if ((scalefactor < 0) || (scalefactor > 255))
+					{
+						return false;
+					}
+					c->scalefactor[g][sfb] = scalefactor;
+					break;
+			}
+		}
+	}
+	return true;
+}
+
+
+static void parseTns(aacStream_t * st, aacChannel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+	bool eightShort = (info->windowSequence == EIGHT_SHORT_SEQUENCE);
+	uint8_t windows = eightShort ? AAC_SHORT_WINDOWS : 1;
+	uint8_t maxOrder = eightShort ? 7 : AAC_TNS_MAX_ORDER;
+	uint8_t maxBand = eightShort ? st->rate->tnsShortBands : st->rate->tnsLongBands;
+
+	if (maxBand > info->maxSfb)
+	{
+		maxBand = info->maxSfb;
+	}
+
+	for (uint8_t w = 0; w < windows; w++)
+	{
+		uint32_t filters = bitsRead(eightShort ? 1 : 2);
+		uint32_t resolution = filters ? bitsRead(1) : 0;
+		uint32_t top = info->bands;
+
+		for (uint32_t f = 0; f < filters; f++)
+		{
+			uint32_t length = bitsRead(eightShort ? 4 : 6);
+			uint32_t order = bitsRead(eightShort ? 3 : 5);
+			uint32_t bottom = (top > length) ? (top - length) : 0;
+
+			if (order)
+			{
+				bool downward = bitsRead(1);
+				uint32_t coefficientBits = resolution + 3 - bitsRead(1);
+				aacTnsFilter_t * filter = &c->tns[c->tnsCount];
+
+				// Sign extended, the compressed ones index the same table
+				for (uint32_t i = 0; i < order; i++)
+				{
+					int32_t value = bitsRead(coefficientBits);
+					value -= (value & (1 << (coefficientBits - 1))) ? (1 << coefficientBits) : 0;
+					if (i < AAC_TNS_MAX_ORDER)
+					{
+						filter->parcor[i] = resolution ? tnsCoefficients4[value + 8] : tnsCoefficients3[value + 4];
+					}
+				}
+
+				filter->window = w;
+				filter->order = (order > maxOrder) ? maxOrder : order;
+				filter->downward = downward;
+				filter->start = info->swbOffset[(bottom < maxBand) ? bottom : maxBand];
+				filter->end = info->swbOffset[(top < maxBand) ? top : maxBand];
+				if ((filter->end > filter->start) && (c->tnsCount < AAC_TNS_MAX_FILTERS))
+				{
+					c->tnsCount++;
+				}
+			}
+			top = bottom;
+		}
+	}
+}
+
+
+static bool decodeSpectrum(const aacChannel_t * c, int32_t * spec)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint32_t windowSize = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? AAC_SHORT_HALF : 0;
+	uint32_t window = 0;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint32_t codebook = c->codebook[g][sfb];
+			if ((codebook == ZERO_HCB) || (codebook > ESC_HCB))
+			{
+				continue;
+			}
+
+			const int16_t * tree = spectralTrees[codebook];
+			uint32_t dimension = bookDimension[codebook];
+			uint32_t modulo = bookModulo[codebook];
+			int32_t minimum = bookMinimum[codebook];
+			uint32_t start = info->swbOffset[sfb];
+			uint32_t end = info->swbOffset[sfb + 1];
+
+			// Grouped short windows are interleaved: each band of every window of the group, then the next band
+			for (uint32_t w = 0; w < info->groupLength[g]; w++)
+			{
+				int32_t * data = &spec[(window + w) * windowSize];
+
+				for (uint32_t k = start; k < end; k += dimension)
+				{
+					int32_t entry = decodeCodeword(tree);
+					int32_t values[4];
+
+					if (entry < 0)
+					{
+						return false;
+					}
+
+					if (dimension == 4)
+					{
+						values[0] = entry / 27 + minimum;
+						values[1] = (entry / 9) % 3 + minimum;
+						values[2] = (entry / 3) % 3 + minimum;
+						values[3] = entry % 3 + minimum;
+					}
+					else
+					{
+						values[0] = entry / modulo + minimum;
+						values[1] = entry % modulo + minimum;
+					}
+
+					// Unsigned codebooks: a sign bit per value that is not 0, then the escapes
+					if (!minimum)
+					{
+						for (uint32_t i = 0; i < dimension; i++)
+						{
+							if (values[i] && bitsRead(1))
+							{
+								values[i] = -values[i];
+							}
+						}
+						if (codebook == ESC_HCB)
+						{
+							for (uint32_t i = 0; i < 2; i++)
+							{
+								if ((values[i] == ESC_FLAG) || (values[i] == -ESC_FLAG))
+								{
+									int32_t escape = decodeEscape();
+									if (escape < 0)
+									{
+										return false;
+									}
+									values[i] = (values[i] > 0) ? escape : -escape;
+								}
+							}
+						}
+					}
+
+					for (uint32_t i = 0; i < dimension; i++)
+					{
+						data[k + i] = values[i];
+					}
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+	return !bitsEnded();
+}
+
+
+static void dequantize(const aacChannel_t * c, int32_t * spec)
+{
+	const aacIcsInfo_t * info = &c->info;
+	bool eightShort = (info->windowSequence == EIGHT_SHORT_SEQUENCE);
+	uint32_t windowSize = eightShort ? AAC_SHORT_HALF : 0;
+	int32_t offset = eightShort ? SHORT_QUARTERS : LONG_QUARTERS;
+	uint32_t window = 0;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint32_t codebook = c->codebook[g][sfb];
+			uint32_t start = info->swbOffset[sfb];
+			uint32_t width = info->swbOffset[sfb + 1] - start;
+
+			if (codebook == NOISE_HCB)
+			{
+				// The energy has no offset of 100 and x^(4/3) is not in Q13
+				for (uint32_t w = 0; w < info->groupLength[g]; w++)
+				{
+					fillNoise(&spec[(window + w) * windowSize + start], width,
+							  c->scalefactor[g][sfb] + offset + 4 * POW43_FRAC);
+				}
+				continue;
+			}
+			if ((codebook == ZERO_HCB) || (codebook > ESC_HCB))
+			{
+				// Only a pulse of a damaged frame could have put something here
+				for (uint32_t w = 0; w < info->groupLength[g]; w++)
+				{
+					memset(&spec[(window + w) * windowSize + start], 0, width * sizeof(int32_t));
+				}
+				continue;
+			}
+
+			int32_t quarters = c->scalefactor[g][sfb] - SF_OFFSET + offset;
+			for (uint32_t w = 0; w < info->groupLength[g]; w++)
+			{
+				int32_t * data = &spec[(window + w) * windowSize + start];
+				for (uint32_t k = 0; k < width; k++)
+				{
+					int32_t q = data[k];
+					if (q)
+					{
+						int32_t value = scaleQuarters(pow43((q > 0) ? q : -q), quarters);
+						data[k] = (q > 0) ? value : -value;
+					}
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+}
+
+
+static void fillNoise(int32_t * data, uint32_t width, int32_t quarters)
+{
+	int64_t energy = 0;
+
+	for (uint32_t k = 0; k < width; k++)
+	{
+		noiseState = noiseState * 1664525U + 1013904223U;
+		data[k] = (int32_t)noiseState >> 16;
+		energy += (int64_t)data[k] * data[k];
+	}
+
+	// Normalized to an energy of 1, Q30, then scaled
+	uint64_t root = 0;
+	for (uint64_t bit = (uint64_t)1 << 38; bit; bit >>= 2)
+	{
+		if ((uint64_t)energy >= root + bit)
+		{
+			energy -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+	}
+	if (!root)
+	{
+		return;
+	}
+
+	for (uint32_t k = 0; k < width; k++)
+	{
+		int32_t normalized = (int32_t)((int64_t)data[k] * (1 << 30) / (int64_t)root);
+		data[k] = scaleQuarters(normalized, quarters - 4 * 30);
+	}
+}
+
+
+static void applyStereo(uint8_t msMaskPresent)
+{
+	const aacIcsInfo_t * info = &channels[0].info;
+	uint32_t windowSize = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? AAC_SHORT_HALF : 0;
+	uint32_t window = 0;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint32_t leftBook = channels[0].codebook[g][sfb];
+			uint32_t rightBook = channels[1].codebook[g][sfb];
+			bool ms = (msMaskPresent == 2) || ((msMaskPresent == 1) && msUsed[g][sfb]);
+			uint32_t start = info->swbOffset[sfb];
+			uint32_t end = info->swbOffset[sfb + 1];
+
+			if ((rightBook == INTENSITY_HCB) || (rightBook == INTENSITY_HCB2))
+			{
+				// The right channel is the left one scaled by 2^(-position / 4), the mask inverts it
+				bool invert = (rightBook == INTENSITY_HCB2);
+				if ((msMaskPresent == 1) && msUsed[g][sfb])
+				{
+					invert = !invert;
+				}
+				int32_t quarters = -channels[1].scalefactor[g][sfb];
+
+				for (uint32_t w = 0; w < info->groupLength[g]; w++)
+				{
+					const int32_t * left = &spectrum[0][(window + w) * windowSize];
+					int32_t * right = &spectrum[1][(window + w) * windowSize];
+					for (uint32_t k = start; k < end; k++)
+					{
+						int32_t value = (left[k] > 0) ? scaleQuarters(left[k], quarters) : -scaleQuarters(-left[k], quarters);
+						right[k] = invert ? -value : value;
+					}
+				}
+			}
+			else if (ms && (leftBook < NOISE_HCB) && (rightBook < NOISE_HCB))
+			{
+				for (uint32_t w = 0; w < info->groupLength[g]; w++)
+				{
+					int32_t * left = &spectrum[0][(window + w) * windowSize];
+					int32_t * right = &spectrum[1][(window + w) * windowSize];
+					for (uint32_t k = start; k < end; k++)
+					{
+						int32_t mid = left[k];
+						left[k] = mid + right[k];
+						right[k] = mid - right[k];
+					}
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+}
+
+
+static void applyTns(const aacChannel_t * c, int32_t * spec)
+{
+	for (uint8_t f = 0; f < c->tnsCount; f++)
+	{
+		const aacTnsFilter_t * filter = &c->tns[f];
+		int32_t lpc[AAC_TNS_MAX_ORDER + 1];
+		int32_t previous[AAC_TNS_MAX_ORDER + 1];
+		int32_t state[AAC_TNS_MAX_ORDER];
+
+		// Reflection to direct form coefficients (step-up)
+		lpc[0] = 1 << TNS_LPC_FRAC;
+		for (uint8_t m = 1; m <= filter->order; m++)
+		{
+			memcpy(previous, lpc, m * sizeof(int32_t));
+			for (uint8_t i = 1; i < m; i++)
+			{
+				lpc[i] = previous[i] + MULT31(filter->parcor[m - 1], previous[m - i]);
+			}
+			lpc[m] = filter->parcor[m - 1] >> (31 - TNS_LPC_FRAC);
+		}
+
+		// All-pole filter over the coefficients, upwards or downwards
+		int32_t * data = &spec[(c->info.windowSequence == EIGHT_SHORT_SEQUENCE) ? filter->window * AAC_SHORT_HALF : 0];
+		int32_t step = filter->downward ? -1 : 1;
+		int32_t k = filter->downward ? (filter->end - 1) : filter->start;
+
+		memset(state, 0, sizeof(state));
+		for (uint32_t n = filter->end - filter->start; n; n--, k += step)
+		{
+			int64_t acc = (int64_t)data[k] * (1 << TNS_LPC_FRAC);
+			for (uint8_t i = 0; i < filter->order; i++)
+			{
+				acc -= (int64_t)lpc[i + 1] * state[i];
+			}
+			int32_t y = (int32_t)((acc + (1 << (TNS_LPC_FRAC - 1))) >> TNS_LPC_FRAC);
+
+			for (uint8_t i = filter->order - 1; i > 0; i--)
+			{
+				state[i] = state[i - 1];
+			}
+			state[0] = y;
+			data[k] = y;
+		}
+	}
+}
+
+
+static void synthesize(aacStream_t * st, uint8_t count, short * out)
+{
+	aacWindow_t windows[AAC_MAX_CHANNELS];
+
+	if (count == 2)
+	{
+		const aacIcsInfo_t * left = &channels[0].info;
+		const aacIcsInfo_t * right = &channels[1].info;
+
+		if (centerCancel)
+		{
+			// Halved rounding half to even: truncating would leave the same bias on every coefficient, and the
+			// inverse MDCT adds those up at the ends of the block
+			for (uint32_t k = 0; k < AAC_LONG_HALF; k++)
+			{
+				int32_t left = spectrum[0][k];
+				int32_t right = spectrum[1][k];
+				spectrum[0][k] = (left + ((left >> 1) & 1)) >> 1;
+				spectrum[1][k] = -((right + ((right >> 1) & 1)) >> 1);
+			}
+		}
+
+		// Same window on both channels: one inverse MDCT of the sum
+		if ((left->windowSequence == right->windowSequence) && (left->windowShape == right->windowShape) &&
+			(st->previousShape[0] == st->previousShape[1]))
+		{
+			for (uint32_t k = 0; k < AAC_LONG_HALF; k++)
+			{
+				spectrum[0][k] += spectrum[1][k];
+			}
+			st->previousShape[1] = right->windowShape;
+			count = 1;
+		}
+	}
+
+	for (uint8_t ch = 0; ch < count; ch++)
+	{
+		const aacIcsInfo_t * info = &channels[ch].info;
+
+		buildWindow(&windows[ch], info->windowSequence, st->previousShape[ch], info->windowShape);
+		st->previousShape[ch] = info->windowShape;
+
+		if (info->windowSequence == EIGHT_SHORT_SEQUENCE)
+		{
+			for (uint8_t w = 0; w < AAC_SHORT_WINDOWS; w++)
+			{
+				imdct(&spectrum[ch][w * AAC_SHORT_HALF], AAC_SHORT_HALF);
+			}
+		}
+		else
+		{
+			imdct(spectrum[ch], AAC_LONG_HALF);
+		}
+	}
+
+	for (uint32_t i = 0; i < AAC_FRAME_LENGTH; i++)
+	{
+		int32_t value = st->overlap[i];
+		int32_t next = 0;
+
+		for (uint8_t ch = 0; ch < count; ch++)
+		{
+			value += frameSample(spectrum[ch], i, &windows[ch]);
+			next += frameSample(spectrum[ch], AAC_FRAME_LENGTH + i, &windows[ch]);
+		}
+		st->overlap[i] = next;
+
+		value = (value + (1 << (AAC_PCM_SHIFT - 1))) >> AAC_PCM_SHIFT;
+		out[i] = (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : value);
+	}
+}
+
+
+static void buildWindow(aacWindow_t * window, uint8_t sequence, uint8_t previousShape, uint8_t shape)
+{
+	const int32_t * previousLong = (previousShape == KBD_WINDOW) ? kbdLongWindow : sineLongWindow;
+	const int32_t * previousShort = (previousShape == KBD_WINDOW) ? kbdShortWindow : sineShortWindow;
+	const int32_t * currentLong = (shape == KBD_WINDOW) ? kbdLongWindow : sineLongWindow;
+	const int32_t * currentShort = (shape == KBD_WINDOW) ? kbdShortWindow : sineShortWindow;
+	aacSlopes_t * first = &window->first;
+
+	window->eightShort = (sequence == EIGHT_SHORT_SEQUENCE);
+
+	if (window->eightShort)
+	{
+		first->leftStart = 0;
+		first->leftEnd = AAC_SHORT_HALF;
+		first->rightStart = AAC_SHORT_HALF;
+		first->rightEnd = 2 * AAC_SHORT_HALF;
+		first->leftSlope = previousShort;
+		first->rightSlope = currentShort;
+		window->others = *first;
+		window->others.leftSlope = currentShort;
+		return;
+	}
+
+	// Long windows: the start and stop ones have a short slope, flat around it, on one side
+	if (sequence == LONG_STOP_SEQUENCE)
+	{
+		first->leftStart = AAC_SHORT_START;
+		first->leftEnd = AAC_SHORT_START + AAC_SHORT_HALF;
+		first->leftSlope = previousShort;
+	}
+	else
+	{
+		first->leftStart = 0;
+		first->leftEnd = AAC_LONG_HALF;
+		first->leftSlope = previousLong;
+	}
+
+	if (sequence == LONG_START_SEQUENCE)
+	{
+		first->rightStart = AAC_LONG_HALF + AAC_SHORT_START;
+		first->rightEnd = AAC_LONG_HALF + AAC_SHORT_START + AAC_SHORT_HALF;
+		first->rightSlope = currentShort;
+	}
+	else
+	{
+		first->rightStart = AAC_LONG_HALF;
+		first->rightEnd = 2 * AAC_LONG_HALF;
+		first->rightSlope = currentLong;
+	}
+}
+
+
+static int32_t frameSample(const int32_t * u, uint32_t i, const aacWindow_t * window)
+{
+	if (!window->eightShort)
+	{
+		return windowedSample(u, i, AAC_LONG_HALF, &window->first);
+	}
+
+	// Eight short blocks of 256 every 128 samples from AAC_SHORT_START: each sample is in one or two of them
+	if ((i < AAC_SHORT_START) || (i >= AAC_SHORT_START + (AAC_SHORT_WINDOWS + 1) * AAC_SHORT_HALF))
+	{
+		return 0;
+	}
+
+	uint32_t j = i - AAC_SHORT_START;
+	uint32_t w = j / AAC_SHORT_HALF;
+	uint32_t offset = j % AAC_SHORT_HALF;
+	int32_t value = 0;
+
+	if (w < AAC_SHORT_WINDOWS)
+	{
+		value = windowedSample(&u[w * AAC_SHORT_HALF], offset, AAC_SHORT_HALF, w ? &window->others : &window->first);
+	}
+	if (w > 0)
+	{
+		value += windowedSample(&u[(w - 1) * AAC_SHORT_HALF], offset + AAC_SHORT_HALF, AAC_SHORT_HALF,
+								(w > 1) ? &window->others : &window->first);
+	}
+	return value;
+}
+
+
+static inline int32_t windowedSample(const int32_t * u, uint32_t i, uint32_t half, const aacSlopes_t * w)
+{
+	// The IMDCT output is the DCT-IV unfolded: its second half, then all of it reversed and negated, then its first half negated
+	uint32_t quarter = half / 2;
+	int32_t value;
+
+	if (i < quarter)
+	{
+		value = u[i + quarter];
+	}
+	else if (i < 3 * quarter)
+	{
+		value = -u[3 * quarter - 1 - i];
+	}
+	else
+	{
+		value = -u[i - 3 * quarter];
+	}
+
+	if (i < half)
+	{
+		if (i < w->leftStart)
+		{
+			return 0;
+		}
+		return (i < w->leftEnd) ? MULT31(value, w->leftSlope[i - w->leftStart]) : value;
+	}
+
+	if (i >= w->rightEnd)
+	{
+		return 0;
+	}
+	return (i < w->rightStart) ? value : MULT31(value, w->rightSlope[w->rightEnd - 1 - i]);
+}
+
+
+static void imdct(int32_t * data, uint32_t half)
+{
+	// DCT-IV of half values through an FFT of half / 2 complex points:
+	// z[n] = (x[2n] + i x[half - 1 - 2n]) e^(-i pi (4n + 1) / (4 half)), FFT, then times e^(-i pi k / half):
+	// u[2k] is the real part and u[half - 1 - 2k] minus the imaginary part. In place, in pairs from both ends
+	uint32_t points = half / 2;
+	uint32_t step = SINE_HALF_BLOCK / half;
+
+	for (uint32_t n = 0; n < points / 2; n++)
+	{
+		uint32_t m = points - 1 - n;
+		int32_t nRe = data[2 * n];
+		int32_t nIm = data[half - 1 - 2 * n];
+		int32_t mRe = data[2 * m];
+		int32_t mIm = data[half - 1 - 2 * m];
+
+		uint32_t j = (4 * n + 1) * step;
+		int32_t s = sineTable[j];
+		int32_t c = sineTable[SINE_QUARTER - j];
+		data[2 * n] = DOT31(nRe, c, nIm, s);
+		data[2 * n + 1] = DOT31(nIm, c, -nRe, s);
+
+		j = (4 * m + 1) * step;
+		s = sineTable[j];
+		c = sineTable[SINE_QUARTER - j];
+		data[2 * m] = DOT31(mRe, c, mIm, s);
+		data[2 * m + 1] = DOT31(mIm, c, -mRe, s);
+	}
+
+	fft(data, points);
+
+	for (uint32_t k = 0; k < points / 2; k++)
+	{
+		uint32_t m = points - 1 - k;
+		int32_t kRe = data[2 * k];
+		int32_t kIm = data[2 * k + 1];
+		int32_t mRe = data[2 * m];
+		int32_t mIm = data[2 * m + 1];
+
+		uint32_t j = 4 * k * step;
+		int32_t s = sineTable[j];
+		int32_t c = sineTable[SINE_QUARTER - j];
+		data[2 * k] = DOT31(kRe, c, kIm, s);
+		data[half - 1 - 2 * k] = -DOT31(kIm, c, -kRe, s);
+
+		j = 4 * m * step;
+		s = sineTable[j];
+		c = sineTable[SINE_QUARTER - j];
+		data[2 * m] = DOT31(mRe, c, mIm, s);
+		data[half - 1 - 2 * m] = -DOT31(mIm, c, -mRe, s);
+	}
+}
+
+
+static void fft(int32_t * data, uint32_t points)
+{
+	// Bit reversed order
+	for (uint32_t i = 0, j = 0; i < points; i++)
+	{
+		if (i < j)
+		{
+			int32_t re = data[2 * i];
+			int32_t im = data[2 * i + 1];
+			data[2 * i] = data[2 * j];
+			data[2 * i + 1] = data[2 * j + 1];
+			data[2 * j] = re;
+			data[2 * j + 1] = im;
+		}
+
+		uint32_t bit = points >> 1;
+		while (j & bit)
+		{
+			j ^= bit;
+			bit >>= 1;
+		}
+		j |= bit;
+	}
+
+	// Radix-2 butterflies, twiddle e^(-2 pi i k / size): past pi / 2 from the other end of the table
+	for (uint32_t size = 2; size <= points; size <<= 1)
+	{
+		uint32_t halfSize = size / 2;
+		uint32_t tableStep = 4 * SINE_QUARTER / size;
+
+		for (uint32_t k = 0; k < halfSize; k++)
+		{
+			uint32_t j = k * tableStep;
+			int32_t s = (j <= SINE_QUARTER) ? sineTable[j] : sineTable[2 * SINE_QUARTER - j];
+			int32_t c = (j <= SINE_QUARTER) ? sineTable[SINE_QUARTER - j] : -sineTable[j - SINE_QUARTER];
+
+			for (uint32_t i = k; i < points; i += size)
+			{
+				int32_t * a = &data[2 * i];
+				int32_t * b = &data[2 * (i + halfSize)];
+				int32_t re = DOT31(b[0], c, b[1], s);
+				int32_t im = DOT31(b[1], c, -b[0], s);
+
+				b[0] = a[0] - re;
+				b[1] = a[1] - im;
+				a[0] += re;
+				a[1] += im;
+			}
+		}
+	}
+}
+
+static int32_t scaleQuarters(int32_t value, int32_t quarters)
+{
+	int32_t shift = 30 - (quarters >> 2);			// Arithmetic, rounds down
+	int64_t product = (int64_t)value * pow2QuarterTable[quarters & 3];
+
+	if (shift >= 63)
+	{
+		return 0;
+	}
+	if (shift <= 0)
+	{
+		// Only small values fit, the rest saturate (damaged frames)
+		int64_t limit = (shift > -31) ? (INT32_MAX >> -shift) : 0;
+		product = ((product <= limit) && (product >= -limit)) ? product * ((int64_t)1 << -shift) : ((value > 0) ? INT32_MAX : -INT32_MAX);
+	}
+	else
+	{
+		product = (product + ((int64_t)1 << (shift - 1))) >> shift;
+	}
+
+	return (product > INT32_MAX) ? INT32_MAX : ((product < -INT32_MAX) ? -INT32_MAX : (int32_t)product);
+}
+
+
+static inline int32_t pow43(uint32_t x)
+{
+	if (x < 1024)
+	{
+		return pow43Table[x];
+	}
+	if (x > POW43_MAX)
+	{
+		x = POW43_MAX;
+	}
+
+	// (8 i)^(4/3) = 16 i^(4/3)
+	uint32_t i = x >> 3;
+	uint32_t fraction = x & 7;
+	return 16 * (pow43Table[i] + (((pow43Table[i + 1] - pow43Table[i]) * fraction) >> 3));
+}
+
+
+static uint32_t bitsRead(uint32_t n)
+{
+	if (!n)
+	{
+		return 0;
+	}
+
+	uint32_t value = bitsPeek() >> (32 - n);
+	bitsSkip(n);
+	return value;
+}
+
+
+static inline uint32_t bitsPeek(void)
+{
+	uint32_t byte = bitPosition >> 3;
+	const uint8_t * p = &frameData[(byte < AAC_MAX_FRAME_BYTES) ? byte : AAC_MAX_FRAME_BYTES];
+
+	return READ_BE32(p) << (bitPosition & 7);
+}
+
+
+static inline void bitsSkip(uint32_t n)
+{
+	bitPosition += n;
+	if (bitPosition > bitLength)
+	{
+		// Past the end: the rest reads 0s from the padding
+		bitPosition = bitLength + 1;
+	}
+}
+
+
+static inline bool bitsEnded(void)
+{
+	return bitPosition > bitLength;
+}
+
+
+static int32_t decodeCodeword(const int16_t * tree)
+{
+	// The longest codeword is 19 bits, the peek has 25
+	uint32_t cache = bitsPeek();
+	uint32_t length = 0;
+	int32_t node = 0;
+
+	do
+	{
+		node = tree[2 * node + (cache >> 31)];
+		cache <<= 1;
+		length++;
+	} while (node > 0);
+
+	bitsSkip(length);
+	return bitsEnded() ? -1 : (-node - 1);
+}
+
+
+static int32_t decodeEscape(void)
+{
+	// N ones and a zero, then an N + 4 bit word: 2^(N + 4) + word
+	uint32_t ones = 0;
+
+	while (bitsRead(1))
+	{
+		if (++ones > 8)
+		{
+			return -1;
+		}
+	}
+	return (1 << (ones + 4)) + bitsRead(ones + 4);
+}
+
+
+static bool aacProbe(const uint8_t * header, uint32_t length)
+{
+	return (length >= 8) && (memcmp(&header[4], "ftyp", 4) == 0);
+}
+
+
+static bool aacGetChannels(decoder_stream_t id, uint8_t * channelCount)
+{
+	aacStream_t * st = (id == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+
+	// Always mixed to mono
+	*channelCount = 1;
+	return true;
+}
+
+
+static bool aacSeek(int32_t samples)
+{
+	aacStream_t * st = playing;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+
+	int64_t target = (int64_t)(st->sample + st->skipSamples) + samples;
+
+	if (target < st->startSkip)
+	{
+		target = st->startSkip;
+	}
+	if ((uint64_t)target >= st->endSample)
+	{
+		// Past the end, the song is over
+		st->sample = st->endSample;
+		st->skipSamples = 0;
+		return false;
+	}
+
+	if ((samples > 0) && (samples < AAC_SEEK_DECODE))
+	{
+		// Close ahead, decoding through is cheaper than reading the sizes
+		st->skipSamples += samples;
+		return true;
+	}
+
+	// The frame before the target is decoded too (and dropped), its second half overlaps the first one of the target's
+	uint32_t frame = (uint32_t)(target / AAC_FRAME_LENGTH);
+	if (frame)
+	{
+		frame--;
+	}
+	restoreFrame(st, frame);
+	st->sample = (uint64_t)frame * AAC_FRAME_LENGTH;
+	st->skipSamples = (uint32_t)(target - st->sample);
+	memset(st->overlap, 0, sizeof(st->overlap));
+	return true;
+}
+
+
+static uint32_t aacGetRemainingMs(void)
+{
+	if (!playing || !playing->fileIsOpened)
+	{
+		return UINT32_MAX;
+	}
+
+	uint64_t current = playing->sample + playing->skipSamples;
+	uint64_t samples = (playing->endSample > current) ? (playing->endSample - current) : 0;
+	return (uint32_t)(samples * 1000U / playing->sampleRate);
+}
+
+
+static bool aacPromote(void)
+{
+	if (!incoming || !incoming->fileIsOpened)
+	{
+		return false;
+	}
+
+	// Its memory is free for the next crossfade (AudioDecoder_PromoteIncoming)
+	AacDecoder_Close(DECODER_PLAYING_STREAM);
+
+	playing = incoming;
+	incoming = NULL;
+
+	return true;
+}
+
+
+static bool aacGetTag(audio_tag_t tag, char ** value)
+{
+	if (!playing || !playing->fileIsOpened || (tag >= AAC_TAG_COUNT) || !playing->tags[tag][0])
+	{
+		return false;
+	}
+	*value = playing->tags[tag];
+	return true;
+}
+
+
+static void aacSetCenterCancel(bool enable)
+{
+	centerCancel = enable;
+}
@@ -0,0 +1,99 @@
+/***************************************************************************//**
+  @file     aac_decoder.h
+  @brief    AAC-LC decoder for MP4 (.m4a) files, fixed point, mono output
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/*******************************************************************************
+*							INCLUDE HEADER FILES
+******************************************************************************/
+
+#ifndef _AAC_DECODER_H_
+#define _AAC_DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_decoder.h"
+
+
+/*******************************************************************************
+*				  CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+******************************************************************************/
+
+// Compressed data kept buffered ahead of the decoder (KB, power of 2)
+#ifndef AAC_READAHEAD_KB
+#define AAC_READAHEAD_KB		4
+#endif
+
+// Entries of the sample index of each stream. Every 2^n-th frame of the file gets one, n as small as fits,
+// so a seek walks the sizes of at most that many frames. 16 bytes each
+#ifndef AAC_INDEX_ENTRIES
+#define AAC_INDEX_ENTRIES		128
+#endif
+
+// Sample table entries (stsz, stco, stsc) read from the file at a time, per table and stream
+#ifndef AAC_TABLE_CACHE_BYTES
+#define AAC_TABLE_CACHE_BYTES	256
+#endif
+
+
+/*******************************************************************************
+ *					VARIABLE PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+// AAC entry of the codec table (audio_decoder.c)
+extern const audio_codec_t aacCodec;
+
+
+/*******************************************************************************
+ *					FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief Initializes both AAC streams (playing and incoming).
+*/
+void AacDecoder_Init(void);
+
+
+/**
+ * @brief: Parses the boxes of the file, up to the sample tables of its first AAC track, and builds the sample index.
+ * @param stream: playing or incoming.
+ * @param filename: file's path.
+ * @return: false if it can't be opened or it has no mono or stereo AAC-LC track (HE-AAC plays its AAC-LC part).
+ */
+bool AacDecoder_LoadFile(decoder_stream_t stream, const char* filename);
+
+
+/**
+ * @brief: Decodes the next frame (1024 samples). Stereo is mixed to mono before the inverse MDCT when both
+ *         channels use the same window: L + R like the handler sums them for the DAC, or (L - R) / 2 with center cancel.
+ * @param stream: playing or incoming.
+ * @param decodedDataBuffer: output, mono.
+ * @param decodedBufferSize: size of the output in samples, at least 1024.
+ * @param numSamplesDecoded: here we store the number of samples.
+ * @param sampleRate: here we store the sample rate of the file.
+ * @return: DECODER_END_OF_FILE after the last frame, DECODER_OVERFLOW if the output is too small.
+ */
+decoder_result_t AacDecoder_DecodeFrame(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate);
+
+
+/**
+ * @brief: Background read into the read-ahead buffer of the open files, whole sectors only.
+ * @return: true if something was read.
+ */
+bool AacDecoder_ReadAhead(void);
+
+
+/**
+ * @brief: Closes the file of a stream.
+ * @param stream: playing or incoming.
+ */
+void AacDecoder_Close(decoder_stream_t stream);
+
+
+#endif /* _AAC_DECODER_H_ */
@@ -0,0 +1,525 @@
+/*******************************************************************************
+  @file     audio_decoder.c
+  @brief    Codec interface, picks the decoder of each file from its first bytes
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+ /*******************************************************************************
+  *							INCLUDE HEADER FILES
+  ******************************************************************************/
+
+#include <string.h>
+#include <ctype.h>
+
+#include "ff.h"
+#include "fsl_common.h"
+#include "audio_decoder.h"
+#include "mp3_decoder.h"
+#include "wav_decoder.h"
+#include "flac_decoder.h"
+#include "vorbis_decoder.h"
+#include "aac_decoder.h"
+
+ /*******************************************************************************
+ *					CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define AUDIO_PATH_SIZE		256		// Longer paths are probed when they are loaded
+
+#define CODECS_COUNT		(sizeof(codecs) / sizeof(codecs[0]))
+
+#define AUDIO_RAM2			__attribute__((section(".bss.$RAM2")))
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+// A file to be opened ahead of time. Probed first, then handed to its codec
+typedef struct
+{
+	char path[AUDIO_PATH_SIZE];
+	bool pending;							// Path set, not probed yet
+	const audio_codec_t * codec;			// Codec of the file once probed, NULL if none
+} audioPreOpen_t;
+
+// Decode cost of a codec, playing stream only (DWT cycles, enabled by the handler)
+typedef struct
+{
+	uint32_t maxCycles;						// Worst call, per AUDIO_DECODER_CYCLES_SAMPLES samples
+	uint64_t totalCycles;
+	uint64_t totalSamples;					// Per channel
+} audioCodecCycles_t;
+
+/*******************************************************************************
+ *      FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief  Reads the first bytes of the file and asks every codec if they are its own.
+* @param  filename: file's path.
+* @returns  the codec of the file, NULL if none or it can't be opened.
+*/
+static const audio_codec_t * probeFile(const char * filename);
+
+
+/*
+* @brief  Finds the codec of a file, from the pre-open slots if it was probed already.
+* @param  filename: file's path.
+* @returns  the codec of the file, NULL if none.
+*/
+static const audio_codec_t * findCodec(const char * filename);
+
+/*******************************************************************************
+ *  					VARIABLES WITH LOCAL SCOPE
+ ******************************************************************************/
+
+// Registered codecs, in the order they are probed
+static const audio_codec_t * const codecs[] =
+{
+	&mp3Codec,
+	&wavCodec,
+	&flacCodec,
+	&vorbisCodec,
+	&aacCodec,
+};
+
+static const audio_codec_t * playingCodec = NULL;		// Codec of the loaded file
+static const audio_codec_t * incomingCodec = NULL;		// Codec of the file fading in
+
+static audioPreOpen_t preOpen[AUDIO_DECODER_PREOPEN_SLOTS];
+
+static bool centerCancel = false;
+
+static FIL probeFileObject;			// Static, a FIL is too big for the stack
+
+static audioCodecCycles_t codecCycles[CODECS_COUNT];
+
+// Memory of the streams, used by the codec of the file open on each one. The lower SRAM (64 KB) takes one of
+// them and the scratch, the other one is in the upper SRAM with the rest
+static uint64_t lowerStreamMemory[AUDIO_DECODER_STREAM_SIZE / sizeof(uint64_t)] AUDIO_RAM2;
+static uint64_t upperStreamMemory[AUDIO_DECODER_STREAM_SIZE / sizeof(uint64_t)];
+static void * streamMemory[2] = {lowerStreamMemory, upperStreamMemory};	// By decoder_stream_t, swapped on a promote
+
+static uint64_t scratch[AUDIO_DECODER_SCRATCH_SIZE / sizeof(uint64_t)] AUDIO_RAM2;
+
+/*******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+void AudioDecoder_Init(void)
+{
+	streamMemory[DECODER_PLAYING_STREAM] = lowerStreamMemory;
+	streamMemory[DECODER_INCOMING_STREAM] = upperStreamMemory;
+
+	for (uint8_t i = 0; i < CODECS_COUNT; i++)
+	{
+		codecs[i]->init();
+	}
+
+	playingCodec = NULL;
+	incomingCodec = NULL;
+	centerCancel = false;
+	memset(preOpen, 0, sizeof(preOpen));
+	AudioDecoder_ResetCodecCycles();
+}
+
+
+bool AudioDecoder_IsSupportedFile(const char * path)
+{
+	const char * extension = strrchr(path, '.');
+
+	if (extension)
+	{
+		for (uint8_t i = 0; i < CODECS_COUNT; i++)
+		{
+			const char * a = extension;
+			const char * b = codecs[i]->extension;
+
+			// Case insensitive, FAT names are often upper case
+			while (*a && (tolower((unsigned char)*a) == *b))
+			{
+				a++;
+				b++;
+			}
+			if (!*a && !*b)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+bool AudioDecoder_LoadFile(const char * filename)
+{
+	const audio_codec_t * codec = findCodec(filename);
+
+	if (playingCodec)
+	{
+		playingCodec->close(DECODER_PLAYING_STREAM);
+	}
+
+	playingCodec = (codec && codec->open(DECODER_PLAYING_STREAM, filename)) ? codec : NULL;
+
+	return (playingCodec != NULL);
+}
+
+
+decoder_result_t AudioDecoder_DecodeFrame(short * buffer, uint32_t bufferSize, uint32_t * numSamples, int * sampleRate)
+{
+	if (!playingCodec)
+	{
+		*numSamples = 0;
+		*sampleRate = 0;
+		return DECODER_NO_FILE;
+	}
+
+	uint32_t startCycles = DWT->CYCCNT;
+	decoder_result_t res = playingCodec->decodeFrame(DECODER_PLAYING_STREAM, buffer, bufferSize, numSamples, sampleRate);
+	uint32_t cycles = DWT->CYCCNT - startCycles;
+
+	uint8_t channels = 0;
+	if ((res == DECODER_WORKED) && *numSamples && playingCodec->getChannels(DECODER_PLAYING_STREAM, &channels) && channels)
+	{
+		for (uint8_t i = 0; i < CODECS_COUNT; i++)
+		{
+			if (codecs[i] == playingCodec)
+			{
+				uint32_t samples = *numSamples / channels;
+				uint32_t scaled = (uint32_t)((uint64_t)cycles * AUDIO_DECODER_CYCLES_SAMPLES / samples);
+
+				if (scaled > codecCycles[i].maxCycles)
+				{
+					codecCycles[i].maxCycles = scaled;
+				}
+				codecCycles[i].totalCycles += cycles;
+				codecCycles[i].totalSamples += samples;
+			}
+		}
+	}
+	return res;
+}
+
+
+bool AudioDecoder_GetChannels(uint8_t * channelCount)
+{
+	return playingCodec && playingCodec->getChannels(DECODER_PLAYING_STREAM, channelCount);
+}
+
+
+bool AudioDecoder_Seek(int32_t samples)
+{
+	return playingCodec && playingCodec->seek(samples);
+}
+
+
+uint32_t AudioDecoder_GetRemainingMs(void)
+{
+	return playingCodec ? playingCodec->getRemainingMs() : UINT32_MAX;
+}
+
+
+bool AudioDecoder_GetTag(audio_tag_t tag, char ** value)
+{
+	return playingCodec && playingCodec->getTag && playingCodec->getTag(tag, value);
+}
+
+
+bool AudioDecoder_LoadIncomingFile(const char * filename)
+{
+	const audio_codec_t * codec = findCodec(filename);
+
+	AudioDecoder_CloseIncoming();
+
+	incomingCodec = (codec && codec->open(DECODER_INCOMING_STREAM, filename)) ? codec : NULL;
+
+	return (incomingCodec != NULL);
+}
+
+
+decoder_result_t AudioDecoder_DecodeIncomingFrame(short * buffer, uint32_t bufferSize, uint32_t * numSamples, int * sampleRate)
+{
+	if (!incomingCodec)
+	{
+		*numSamples = 0;
+		*sampleRate = 0;
+		return DECODER_NO_FILE;
+	}
+	return incomingCodec->decodeFrame(DECODER_INCOMING_STREAM, buffer, bufferSize, numSamples, sampleRate);
+}
+
+
+bool AudioDecoder_GetIncomingChannels(uint8_t * channelCount)
+{
+	return incomingCodec && incomingCodec->getChannels(DECODER_INCOMING_STREAM, channelCount);
+}
+
+
+bool AudioDecoder_PromoteIncoming(void)
+{
+	if (!incomingCodec)
+	{
+		return false;
+	}
+
+	// The codecs may differ, each one closes or promotes its own file
+	if (playingCodec)
+	{
+		playingCodec->close(DECODER_PLAYING_STREAM);
+	}
+	incomingCodec->promote();
+
+	// The incoming file stays where it is, in the memory that is now of the playing stream
+	void * memory = streamMemory[DECODER_PLAYING_STREAM];
+	streamMemory[DECODER_PLAYING_STREAM] = streamMemory[DECODER_INCOMING_STREAM];
+	streamMemory[DECODER_INCOMING_STREAM] = memory;
+
+	playingCodec = incomingCodec;
+	incomingCodec = NULL;
+
+	return true;
+}
+
+
+void AudioDecoder_CloseIncoming(void)
+{
+	if (incomingCodec)
+	{
+		incomingCodec->close(DECODER_INCOMING_STREAM);
+		incomingCodec = NULL;
+	}
+}
+
+
+void AudioDecoder_PreOpen(uint8_t slot, const char * filename)
+{
+	if ((slot >= AUDIO_DECODER_PREOPEN_SLOTS) || (strlen(filename) >= AUDIO_PATH_SIZE))
+	{
+		return;
+	}
+
+	// Already there
+	if (strcmp(preOpen[slot].path, filename) == 0)
+	{
+		return;
+	}
+
+	strcpy(preOpen[slot].path, filename);
+	preOpen[slot].pending = true;
+	preOpen[slot].codec = NULL;
+}
+
+
+bool AudioDecoder_Background(void)
+{
+	// The open files first, the next and previous ones only when their FIFOs are full
+	if (playingCodec && playingCodec->readAhead && playingCodec->readAhead())
+	{
+		return true;
+	}
+	if (incomingCodec && (incomingCodec != playingCodec) && incomingCodec->readAhead && incomingCodec->readAhead())
+	{
+		return true;
+	}
+
+	for (uint8_t i = 0; i < AUDIO_DECODER_PREOPEN_SLOTS; i++)
+	{
+		if (preOpen[i].pending)
+		{
+			// Probing is a step on its own, then the codec opens the file in its own steps
+			preOpen[i].pending = false;
+			preOpen[i].codec = probeFile(preOpen[i].path);
+
+			if (preOpen[i].codec && preOpen[i].codec->preOpen)
+			{
+				preOpen[i].codec->preOpen(i, preOpen[i].path);
+			}
+			return true;
+		}
+	}
+
+	for (uint8_t i = 0; i < CODECS_COUNT; i++)
+	{
+		if (codecs[i]->preOpenStep && codecs[i]->preOpenStep())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void AudioDecoder_SetCenterCancel(bool enable)
+{
+	centerCancel = enable;
+
+	for (uint8_t i = 0; i < CODECS_COUNT; i++)
+	{
+		if (codecs[i]->setCenterCancel)
+		{
+			codecs[i]->setCenterCancel(enable);
+		}
+	}
+}
+
+
+bool AudioDecoder_GetCenterCancel(void)
+{
+	return centerCancel;
+}
+
+
+uint32_t AudioDecoder_GetWorstCaseCycles(void)
+{
+	uint32_t cycles = 0;
+
+	if (playingCodec)
+	{
+		cycles += playingCodec->worstCaseCycles;
+	}
+	if (incomingCodec)
+	{
+		cycles += incomingCodec->worstCaseCycles;
+	}
+	return cycles;
+}
+
+
+bool AudioDecoder_GetCodecCycles(uint8_t index, const char ** name, uint32_t * maxCycles, uint32_t * averageCycles)
+{
+	if (index >= CODECS_COUNT)
+	{
+		return false;
+	}
+
+	*name = codecs[index]->name;
+	*maxCycles = codecCycles[index].maxCycles;
+	*averageCycles = codecCycles[index].totalSamples ?
+					(uint32_t)(codecCycles[index].totalCycles * AUDIO_DECODER_CYCLES_SAMPLES / codecCycles[index].totalSamples) : 0;
+	return true;
+}
+
+
+void AudioDecoder_ResetCodecCycles(void)
+{
+	memset(codecCycles, 0, sizeof(codecCycles));
+}
+
+
+bool AudioDecoder_Benchmark(const char * filename, uint32_t seconds, short * buffer, uint32_t bufferSize, uint32_t * realTimePermille)
+{
+	uint64_t cycles = 0;
+	uint64_t samples = 0;
+	uint32_t numSamples = 0;
+	int sampleRate = 0;
+	uint8_t channels = 0;
+
+	if (!AudioDecoder_LoadFile(filename))
+	{
+		return false;
+	}
+
+	// Frames per channel, until the end of the file or the audio asked for
+	while (!seconds || !sampleRate || (samples < (uint64_t)seconds * sampleRate))
+	{
+		uint32_t startCycles = DWT->CYCCNT;
+		decoder_result_t res = playingCodec->decodeFrame(DECODER_PLAYING_STREAM, buffer, bufferSize, &numSamples, &sampleRate);
+		cycles += DWT->CYCCNT - startCycles;
+
+		if ((res != DECODER_WORKED) || !playingCodec->getChannels(DECODER_PLAYING_STREAM, &channels) || !channels)
+		{
+			break;
+		}
+		samples += numSamples / channels;
+	}
+
+	playingCodec->close(DECODER_PLAYING_STREAM);
+	playingCodec = NULL;
+
+	if (!samples || !sampleRate)
+	{
+		return false;
+	}
+
+	// Decode time over audio time: (cycles / SystemCoreClock) / (samples / sampleRate)
+	*realTimePermille = (uint32_t)(cycles * sampleRate * 1000U / (samples * SystemCoreClock));
+	return true;
+}
+
+
+void AudioDecoder_ShutDown(void)
+{
+	AudioDecoder_CloseIncoming();
+
+	if (playingCodec)
+	{
+		playingCodec->close(DECODER_PLAYING_STREAM);
+		playingCodec = NULL;
+	}
+
+	for (uint8_t i = 0; i < CODECS_COUNT; i++)
+	{
+		if (codecs[i]->shutDown)
+		{
+			codecs[i]->shutDown();
+		}
+	}
+	memset(preOpen, 0, sizeof(preOpen));
+}
+
+
+void * AudioDecoder_GetStreamMemory(decoder_stream_t stream)
+{
+	return streamMemory[stream];
+}
+
+
+void * AudioDecoder_GetScratch(void)
+{
+	return scratch;
+}
+
+
+/*******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+static const audio_codec_t * probeFile(const char * filename)
+{
+	const audio_codec_t * codec = NULL;
+	uint8_t header[AUDIO_DECODER_PROBE_SIZE];
+	UINT bytesRead = 0;
+
+	if (f_open(&probeFileObject, _T(filename), FA_READ) != FR_OK)
+	{
+		return NULL;
+	}
+
+	f_read(&probeFileObject, header, sizeof(header), &bytesRead);
+	f_close(&probeFileObject);
+
+	for (uint8_t i = 0; (i < CODECS_COUNT) && !codec; i++)
+	{
+		if (codecs[i]->probe(header, bytesRead))
+		{
+			codec = codecs[i];
+		}
+	}
+
+	return codec;
+}
+
+
+static const audio_codec_t * findCodec(const char * filename)
+{
+	for (uint8_t i = 0; i < AUDIO_DECODER_PREOPEN_SLOTS; i++)
+	{
+		if (!preOpen[i].pending && preOpen[i].codec && (strcmp(preOpen[i].path, filename) == 0))
+		{
+			// Probed in the background, no need to open the file twice
+			return preOpen[i].codec;
+		}
+	}
+
+	return probeFile(filename);
+}
@@ -0,0 +1,290 @@
+/***************************************************************************//**
+  @file     audio_decoder.h
+  @brief    Codec interface, picks the decoder of each file from its first bytes
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/*******************************************************************************
+*							INCLUDE HEADER FILES
+******************************************************************************/
+
+#ifndef _AUDIO_DECODER_H_
+#define _AUDIO_DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*******************************************************************************
+*				  CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+******************************************************************************/
+
+#define AUDIO_DECODER_PROBE_SIZE	12		// Bytes from the start of the file handed to probe
+
+#define AUDIO_DECODER_CYCLES_SAMPLES	1152	// worstCaseCycles is per this many output samples (one DAC buffer)
+
+#define AUDIO_DECODER_PREOPEN_SLOTS	2		// Files that can be opened ahead of time (next and previous songs)
+
+#define AUDIO_DECODER_STREAM_SIZE	(32U * 1024U)	// Memory of each stream, all the codec keeps of the file open on it
+
+#define AUDIO_DECODER_SCRATCH_SIZE	(18U * 1024U)	// Shared by every stream and codec, only within a call
+
+/*******************************************************************************
+ *					ENUMERATIONS, STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef enum
+{
+	DECODER_WORKED,
+	DECODER_ERROR,
+	DECODER_FRAME_NOT_VALID,
+	DECODER_NO_FILE,
+	DECODER_END_OF_FILE,
+	DECODER_OVERFLOW
+} decoder_result_t;
+
+
+// Each codec can decode two files at the same time, the incoming one is only used to crossfade
+typedef enum
+{
+	DECODER_PLAYING_STREAM,
+	DECODER_INCOMING_STREAM
+} decoder_stream_t;
+
+
+typedef enum
+{
+	AUDIO_TAG_TITLE,
+	AUDIO_TAG_ARTIST,
+	AUDIO_TAG_ALBUM,
+	AUDIO_TAG_YEAR,
+	AUDIO_TAG_TRACK_NUM,
+	AUDIO_TAG_REPLAYGAIN_GAIN,		// REPLAYGAIN_TRACK_GAIN, "-6.54 dB"
+	AUDIO_TAG_REPLAYGAIN_PEAK		// REPLAYGAIN_TRACK_PEAK, "0.988525"
+} audio_tag_t;
+
+
+// A decoder. The optional functions are NULL if the codec does not have them.
+// A codec has no memory of its own for its files: open takes the memory of the stream
+// (AudioDecoder_GetStreamMemory), close and promote give it back. Whatever is done with both
+// streams (readAhead, setCenterCancel, shutDown) skips the ones the codec does not have open
+typedef struct
+{
+	const char * name;
+	const char * extension;						// Lowercase, with the dot, files listed by the browser
+	uint32_t worstCaseCycles;					// Per AUDIO_DECODER_CYCLES_SAMPLES output samples, at 120 MHz. Estimated, not measured
+
+	void (*init)(void);
+	bool (*probe)(const uint8_t * header, uint32_t length);		// true if the first bytes are of this format
+	bool (*open)(decoder_stream_t stream, const char * filename);
+	decoder_result_t (*decodeFrame)(decoder_stream_t stream, short * buffer, uint32_t bufferSize,
+									uint32_t * numSamples, int * sampleRate);
+	bool (*getChannels)(decoder_stream_t stream, uint8_t * channelCount);
+	bool (*seek)(int32_t samples);				// Relative to the playing position, per channel samples
+	uint32_t (*getRemainingMs)(void);
+	bool (*promote)(void);						// The incoming file becomes the playing one
+	void (*close)(decoder_stream_t stream);
+
+	bool (*readAhead)(void);					// Optional
+	void (*preOpen)(uint8_t slot, const char * filename);		// Optional
+	bool (*preOpenStep)(void);					// Optional
+	bool (*getTag)(audio_tag_t tag, char ** value);				// Optional
+	void (*setCenterCancel)(bool enable);		// Optional
+	void (*shutDown)(void);						// Optional, closes what the codec opened ahead of time
+} audio_codec_t;
+
+
+/*******************************************************************************
+ *					FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief Initializes every codec.
+*/
+void AudioDecoder_Init(void);
+
+
+/**
+ * @brief: Checks the extension against the ones of the codecs, to list the file or not.
+ * @param path: file's path.
+ * @return: true if some codec plays it.
+ */
+bool AudioDecoder_IsSupportedFile(const char * path);
+
+
+/**
+ * @brief: Opens a file with the codec its first bytes belong to, closing the previous one.
+ * @param filename: file's path.
+ * @return: true if a codec recognized and opened it.
+ */
+bool AudioDecoder_LoadFile(const char * filename);
+
+
+/**
+ * @brief: Decodes the next frame of the loaded file.
+ * @param buffer: output PCM, interleaved if stereo.
+ * @param bufferSize: size of the buffer in samples.
+ * @param numSamples: here we store the number of samples decoded (all channels).
+ * @param sampleRate: here we store the sample rate of the frame.
+ * @return: DECODER_WORKED, DECODER_END_OF_FILE at the end, an error otherwise.
+ */
+decoder_result_t AudioDecoder_DecodeFrame(short * buffer, uint32_t bufferSize, uint32_t * numSamples, int * sampleRate);
+
+
+/**
+ * @brief: Gets the number of channels of the last decoded frame.
+ * @param channelCount: here we store the number of channels.
+ * @return: true if a frame was decoded.
+ */
+bool AudioDecoder_GetChannels(uint8_t * channelCount);
+
+
+/**
+ * @brief: Moves the playing position.
+ * @param samples: per channel samples to skip, negative to go back.
+ * @return: false if there is no file or it went past the end.
+ */
+bool AudioDecoder_Seek(int32_t samples);
+
+
+/**
+ * @brief: Estimates the play time left of the loaded file.
+ * @return: milliseconds, UINT32_MAX if it is not known yet.
+ */
+uint32_t AudioDecoder_GetRemainingMs(void);
+
+
+/**
+ * @brief: Gets a tag of the loaded file.
+ * @param tag: which one.
+ * @param value: here we store a pointer to the text.
+ * @return: false if the file does not have it.
+ */
+bool AudioDecoder_GetTag(audio_tag_t tag, char ** value);
+
+
+/**
+ * @brief: Opens the next file on the incoming stream, to crossfade into it.
+ * @param filename: file's path.
+ * @return: false if it can't be opened or its codec can't decode two files at once.
+ */
+bool AudioDecoder_LoadIncomingFile(const char * filename);
+
+
+/**
+ * @brief: Same as AudioDecoder_DecodeFrame, for the incoming file.
+ */
+decoder_result_t AudioDecoder_DecodeIncomingFrame(short * buffer, uint32_t bufferSize, uint32_t * numSamples, int * sampleRate);
+
+
+/**
+ * @brief: Same as AudioDecoder_GetChannels, for the incoming file.
+ */
+bool AudioDecoder_GetIncomingChannels(uint8_t * channelCount);
+
+
+/**
+ * @brief: Closes the loaded file, the incoming one takes its place.
+ * @return: false if there was no incoming file.
+ */
+bool AudioDecoder_PromoteIncoming(void);
+
+
+/**
+ * @brief: Closes the incoming file, if any.
+ */
+void AudioDecoder_CloseIncoming(void);
+
+
+/**
+ * @brief: Sets a file to be opened ahead of time, in the background (AudioDecoder_Background).
+ * @param slot: slot to use.
+ * @param filename: file's path.
+ */
+void AudioDecoder_PreOpen(uint8_t slot, const char * filename);
+
+
+/**
+ * @brief: Background work: tops up the read-ahead of the open files, or does one pre-open step
+ *         if they are full. To be called from the main loop when there is spare time.
+ * @return: true if there was something to do.
+ */
+bool AudioDecoder_Background(void);
+
+
+/**
+ * @brief: Enables or disables center-channel removal (karaoke) on every codec that has it.
+ * @param enable: true to remove the center channel.
+ */
+void AudioDecoder_SetCenterCancel(bool enable);
+
+
+/**
+ * @brief: getter of the center-channel removal state.
+ * @return: true if the center channel is being removed.
+ */
+bool AudioDecoder_GetCenterCancel(void);
+
+
+/**
+ * @brief: Worst case cost of the next buffer, from the codecs of the open files (both while crossfading).
+ *         These are the codecs' estimates, AudioDecoder_GetCodecCycles has what they really took.
+ * @return: cycles per AUDIO_DECODER_CYCLES_SAMPLES output samples.
+ */
+uint32_t AudioDecoder_GetWorstCaseCycles(void);
+
+
+/**
+ * @brief: Measured decode cost of a codec, to compare codecs playing the same content.
+ *         Only the playing stream counts, crossfades add the incoming one on top.
+ * @param index: codec, in probe order. The ones past the last return false.
+ * @param name: here we store the name of the codec.
+ * @param maxCycles: here we store the worst call, cycles per AUDIO_DECODER_CYCLES_SAMPLES samples.
+ * @param averageCycles: here we store the average, cycles per AUDIO_DECODER_CYCLES_SAMPLES samples.
+ * @return: false if there is no such codec.
+ */
+bool AudioDecoder_GetCodecCycles(uint8_t index, const char ** name, uint32_t * maxCycles, uint32_t * averageCycles);
+
+
+/**
+ * @brief: Clears what AudioDecoder_GetCodecCycles measured.
+ */
+void AudioDecoder_ResetCodecCycles(void);
+
+
+/**
+ * @brief: Decodes a file as fast as it can and measures how much of real time that takes. Call it with nothing
+ *         playing (it uses the playing stream) and after mp3Handler_init, which enables the DWT counter.
+ * @param filename: file's path.
+ * @param seconds: audio decoded, 0 for the whole file.
+ * @param buffer: output, discarded. Large enough for the codec (2304 samples covers all of them).
+ * @param bufferSize: size of the output in samples.
+ * @param realTimePermille: here we store the decode time over the audio time, in thousandths (1000 is real time).
+ * @return: false if the file can't be opened or nothing was decoded.
+ */
+bool AudioDecoder_Benchmark(const char * filename, uint32_t seconds, short * buffer, uint32_t bufferSize, uint32_t * realTimePermille);
+
+
+/**
+ * @brief: Closes every file.
+ */
+void AudioDecoder_ShutDown(void);
+
+
+/**
+ * @brief: Memory of a stream, for the codec that opens a file on it. It holds whatever the codec before left there.
+ *         AudioDecoder_PromoteIncoming gives the memory of the incoming stream to the playing one.
+ * @param stream: playing or incoming.
+ * @return: AUDIO_DECODER_STREAM_SIZE bytes, 8 byte aligned.
+ */
+void * AudioDecoder_GetStreamMemory(decoder_stream_t stream);
+
+
+/**
+ * @brief: Scratch shared by every codec. Nothing is kept in it from one call of a codec to the next.
+ * @return: AUDIO_DECODER_SCRATCH_SIZE bytes, 8 byte aligned.
+ */
+void * AudioDecoder_GetScratch(void);
+
+
+#endif /* _AUDIO_DECODER_H_ */
@@ -0,0 +1,1536 @@
+/*******************************************************************************
+  @file     flac_decoder.c
+  @brief    FLAC decoder, fixed point, mono or stereo, frames streamed from FatFs
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+ /*******************************************************************************
+  *							INCLUDE HEADER FILES
+  ******************************************************************************/
+
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ff.h"
+#include "fsl_common.h"
+#include "flac_decoder.h"
+
+ /*******************************************************************************
+ *					CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define FILE_SECTOR_SIZE		512		// FatFs sector, reads of whole aligned sectors go straight to our buffer
+
+#define FLAC_RING_SIZE			(FLAC_READAHEAD_KB * 1024U)	// Power of 2 and whole sectors
+#define FLAC_RING_MASK			(FLAC_RING_SIZE - 1)
+
+#define FLAC_OUTPUT_SAMPLES		1152	// Per channel samples per call, same as an MP3 frame
+
+#define FLAC_META_STREAMINFO	0
+#define FLAC_META_SEEKTABLE		3
+#define FLAC_META_COMMENT		4
+#define FLAC_STREAMINFO_BYTES	34
+#define FLAC_SEEKPOINT_BYTES	18
+
+#define FLAC_SEEK_POINTS		32		// Seek points kept, evenly picked if the table has more
+#define FLAC_SEEK_DECODE_FRAMES	4		// Frames decoded through after a seek to reach the target
+#define FLAC_SEEK_STEPS			6		// Frames looked at while narrowing the search for the target
+#define FLAC_SYNC_SEARCH		(64 * 1024U)	// Bytes looked at for a frame before giving up
+#define FLAC_FRAME_RETRIES		8		// Damaged frames (or false sync codes) skipped per call
+
+#define FLAC_MAX_CHANNELS		2
+#define FLAC_MAX_HEADER_BYTES	16
+#define FLAC_MAX_LPC_ORDER		32
+#define FLAC_UNROLLED_ORDER		12		// Most the subset allows up to 48 kHz, hand unrolled kernels up to here
+
+#define FLAC_LEFT_SIDE			8		// Channel assignments, 0 to 7 are independent channels
+#define FLAC_RIGHT_SIDE			9
+#define FLAC_MID_SIDE			10
+
+#define FLAC_TAG_SIZE			48		// Longer tags are cut
+#define FLAC_TAG_COUNT			7		// One per audio_tag_t
+#define FLAC_MAX_COMMENTS		32		// Comments looked at before giving up on the tags
+
+// Per 1152 output samples. A call that decodes a 4608 stereo block (order 12 LPC) is ~500k, estimate.
+// 16 bit 44.1 kHz stereo averages ~50 cycles per sample, ~4% of the CPU
+#define FLAC_WORST_CASE_CYCLES	1000000
+
+#define RING_BYTE(st, offset)	((st)->ring[(offset) & FLAC_RING_MASK])
+
+// acc += c[n] * x[i - n - 1], one SMLAL each
+#define LPC_TAP(n)				acc += (int64_t)c##n * x[-(n) - 1]
+#define LPC_TAPS_1				LPC_TAP(0)
+#define LPC_TAPS_2				LPC_TAPS_1; LPC_TAP(1)
+#define LPC_TAPS_3				LPC_TAPS_2; LPC_TAP(2)
+#define LPC_TAPS_4				LPC_TAPS_3; LPC_TAP(3)
+#define LPC_TAPS_5				LPC_TAPS_4; LPC_TAP(4)
+#define LPC_TAPS_6				LPC_TAPS_5; LPC_TAP(5)
+#define LPC_TAPS_7				LPC_TAPS_6; LPC_TAP(6)
+#define LPC_TAPS_8				LPC_TAPS_7; LPC_TAP(7)
+#define LPC_TAPS_9				LPC_TAPS_8; LPC_TAP(8)
+#define LPC_TAPS_10				LPC_TAPS_9; LPC_TAP(9)
+#define LPC_TAPS_11				LPC_TAPS_10; LPC_TAP(10)
+#define LPC_TAPS_12				LPC_TAPS_11; LPC_TAP(11)
+
+#define LPC_KERNEL(order)		case order:										\
+									for (; x < end; x++)						\
+									{											\
+										int64_t acc = 0;						\
+										LPC_TAPS_##order;						\
+										*x += (int32_t)(acc >> shift);			\
+									}											\
+									break
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	uint32_t	sample;				// First sample of the frame
+	uint32_t	offset;				// From the first frame
+} flacSeekPoint_t;
+
+// MSB first bit reader over the ring. The bits of cache below count are 0, so CLZ finds the unary codes
+typedef struct
+{
+	uint32_t	cache;
+	uint32_t	count;				// Valid bits in cache
+	uint32_t	position;			// File offset of the next byte to load
+	bool		underrun;			// Loaded past the end of the file, what follows reads as 0
+} flacBits_t;
+
+// The ring index of a byte is its file offset & FLAC_RING_MASK, as in wav_decoder.c
+typedef struct
+{
+	FIL			file;
+	bool		fileIsOpened;
+	uint8_t		channels;
+	uint8_t		bitsPerSample;
+	uint32_t	sampleRate;
+	uint16_t	maxBlockSize;		// Fixed block size streams number their frames instead of their samples
+	uint64_t	totalSamples;		// 0 if STREAMINFO does not say
+	uint32_t	dataStart;			// File offset of the first frame
+	uint32_t	dataEnd;			// File size
+	flacSeekPoint_t seekPoints[FLAC_SEEK_POINTS];
+	uint8_t		seekPointCount;
+	char		tags[FLAC_TAG_COUNT][FLAC_TAG_SIZE];	// Empty if the file does not have it
+	uint32_t	position;			// File offset of the next frame
+	uint32_t	readPosition;		// File offset of the next sector to read
+	bool		fileEnded;			// true once f_read returned less than asked for
+	uint64_t	blockSample;		// Sample number of the first frame of the block
+	uint32_t	blockPosition;		// File offset of the frame of the block
+	uint32_t	blockRate;
+	uint16_t	blockFrames;
+	uint16_t	blockFramesOut;		// Already output
+	uint8_t		blockChannels;
+	uint8_t		lastChannels;		// Output channels of the last call (1 with center cancel)
+	uint8_t		ring[FLAC_RING_SIZE] __attribute__((aligned(4)));
+
+	// First channel of the frame, then its packed PCM: one stereo frame or two mono samples per word.
+	// The second channel is decoded in the scratch of the decoder layer
+	int32_t		block[FLAC_MAX_BLOCK_SIZE];
+} flacStream_t;
+
+_Static_assert(sizeof(flacStream_t) <= AUDIO_DECODER_STREAM_SIZE, "flacStream_t does not fit in the memory of a stream");
+_Static_assert(FLAC_MAX_BLOCK_SIZE * sizeof(int32_t) <= AUDIO_DECODER_SCRATCH_SIZE, "A FLAC channel does not fit in the scratch");
+
+/*******************************************************************************
+ *      FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief  Walks the metadata blocks and fills the format, the seek points and the tags of the stream.
+* @param  st: stream with the file open.
+* @returns  false if it is not a FLAC stream we can play.
+*/
+static bool parseMetadata(flacStream_t * st);
+
+
+/*
+* @brief  Stores the TITLE, ARTIST, ALBUM, DATE and TRACKNUMBER comments of a VORBIS_COMMENT block.
+* @param  st: stream with the file open.
+* @param  offset: file offset of the block data.
+* @param  length: block data length.
+*/
+static void parseComments(flacStream_t * st, uint32_t offset, uint32_t length);
+
+
+/*
+* @brief  Reads whole sectors into the free space of the ring.
+* @param  st: stream.
+* @returns  the number of bytes read.
+*/
+static uint32_t fillRing(flacStream_t * st);
+
+
+/*
+* @brief  Positions the file at the sector containing filePosition, the ring starts empty there.
+* @param  st: stream.
+* @param  filePosition: absolute position in the file.
+*/
+static void seekAligned(flacStream_t * st, uint32_t filePosition);
+
+
+/*
+* @brief  Decodes the frame at the next sync code into the block of the stream, skipping damaged ones.
+* @param  st: stream.
+* @returns  false at the end of the file.
+*/
+static bool decodeNextBlock(flacStream_t * st);
+
+
+/*
+* @brief  Moves st->position to the next frame sync code.
+* @param  st: stream.
+* @returns  false if there is none before the end of the file.
+*/
+static bool findSync(flacStream_t * st);
+
+
+/*
+* @brief  Decodes the frame at st->position: header, subframes, stereo decorrelation and packing.
+* @param  st: stream.
+* @returns  false if it is not a valid frame, st->position is then undefined.
+*/
+static bool decodeFrameAt(flacStream_t * st);
+
+
+/*
+* @brief  Decodes one subframe (one channel) of the frame.
+* @param  st: stream, for the ring.
+* @param  br: bit reader.
+* @param  data: output, blockSize samples.
+* @param  blockSize: samples of the frame.
+* @param  bitsPerSample: bits of this channel (one more for a side channel).
+* @returns  false if it is not valid.
+*/
+static bool decodeSubframe(flacStream_t * st, flacBits_t * br, int32_t * data, uint32_t blockSize, uint32_t bitsPerSample);
+
+
+/*
+* @brief  Decodes the Rice coded residual of a subframe into data[order...].
+* @param  st: stream, for the ring.
+* @param  br: bit reader.
+* @param  data: subframe output, the warm-up samples are already there.
+* @param  blockSize: samples of the frame.
+* @param  order: predictor order.
+* @returns  false if it is not valid.
+*/
+static bool decodeResidual(flacStream_t * st, flacBits_t * br, int32_t * data, uint32_t blockSize, uint32_t order);
+
+
+/*
+* @brief  Rice decodes count residuals with parameter k (CLZ for the unary part).
+* @param  st: stream, for the ring.
+* @param  br: bit reader.
+* @param  out: output.
+* @param  count: residuals.
+* @param  k: Rice parameter.
+*/
+static void readRice(flacStream_t * st, flacBits_t * br, int32_t * out, uint32_t count, uint32_t k);
+
+
+/*
+* @brief  Adds the fixed polynomial prediction (order 0 to 4) to the residual, in place.
+* @param  data: warm-up samples then residuals.
+* @param  blockSize: samples.
+* @param  order: predictor order.
+*/
+static void fixedRestore(int32_t * data, uint32_t blockSize, uint32_t order);
+
+
+/*
+* @brief  Adds the LPC prediction to the residual, in place. 32 bit coefficients and samples, 64 bit sums.
+* @param  data: warm-up samples then residuals.
+* @param  blockSize: samples.
+* @param  coefs: quantized coefficients, FLAC_MAX_LPC_ORDER of them, 0 past the order.
+* @param  order: predictor order (1 to 32).
+* @param  shift: quantization shift.
+*/
+static void lpcRestore(int32_t * data, uint32_t blockSize, const int32_t * coefs, uint32_t order, uint32_t shift);
+
+
+/*
+* @brief  Bit reader: tops the cache up to at least 25 bits, reading the ring (or the file if it ran dry).
+* @param  st: stream.
+* @param  br: bit reader.
+*/
+static inline void bitsRefill(flacStream_t * st, flacBits_t * br);
+
+
+/*
+* @brief  Bit reader: reads n bits, n up to 32.
+* @param  st: stream.
+* @param  br: bit reader.
+* @param  n: bits.
+* @returns  the bits, right aligned.
+*/
+static inline uint32_t bitsRead(flacStream_t * st, flacBits_t * br, uint32_t n);
+
+
+/*
+* @brief  Bit reader: reads n bits as a two's complement number, n up to 32.
+* @param  st: stream.
+* @param  br: bit reader.
+* @param  n: bits.
+* @returns  the number.
+*/
+static inline int32_t bitsReadSigned(flacStream_t * st, flacBits_t * br, uint32_t n);
+
+
+/*
+* @brief  Bit reader: counts the 0 bits before the next 1, and skips the 1.
+* @param  st: stream.
+* @param  br: bit reader.
+* @returns  the number of 0 bits.
+*/
+static inline uint32_t bitsReadUnary(flacStream_t * st, flacBits_t * br);
+
+
+/*
+* @brief  Bit reader: checks if what was read went past the end of the file (not just what was loaded ahead).
+* @param  st: stream.
+* @param  br: bit reader.
+* @returns  true if it did.
+*/
+static inline bool bitsPastEnd(const flacStream_t * st, const flacBits_t * br);
+
+
+/*
+* @brief  CRC-8 of the frame header (polynomial x^8 + x^2 + x + 1).
+* @param  data: header bytes.
+* @param  length: header length.
+* @returns  the CRC.
+*/
+static uint8_t crc8(const uint8_t * data, uint32_t length);
+
+
+/*
+* @brief  Codec table adapters, see audio_codec_t.
+*/
+static bool flacProbe(const uint8_t * header, uint32_t length);
+static bool flacGetChannels(decoder_stream_t id, uint8_t * channelCount);
+static bool flacSeek(int32_t samples);
+static uint32_t flacGetRemainingMs(void);
+static bool flacPromote(void);
+static bool flacGetTag(audio_tag_t tag, char ** value);
+static void flacSetCenterCancel(bool enable);
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH GLOBAL SCOPE
+ *****************************************************************************/
+const audio_codec_t flacCodec =
+{
+	.name = "FLAC",
+	.extension = ".flac",
+	.worstCaseCycles = FLAC_WORST_CASE_CYCLES,
+
+	.init = FLACDecoder_Init,
+	.probe = flacProbe,
+	.open = FLACDecoder_LoadFile,
+	.decodeFrame = FLACDecoder_DecodeFrame,
+	.getChannels = flacGetChannels,
+	.seek = flacSeek,
+	.getRemainingMs = flacGetRemainingMs,
+	.promote = flacPromote,
+	.close = FLACDecoder_Close,
+
+	.readAhead = FLACDecoder_ReadAhead,
+	.getTag = flacGetTag,
+	.setCenterCancel = flacSetCenterCancel,
+};
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH LOCAL SCOPE
+ *****************************************************************************/
+// In the memory of the decoder layer, NULL while there is no file of ours on the stream
+static flacStream_t *	playing = NULL;
+static flacStream_t *	incoming = NULL;
+static bool				centerCancel;			// Stereo files are output as mono L-R
+
+static const uint32_t frameRates[12] =
+{
+	0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000
+};
+
+static const uint8_t frameSampleSizes[8] = { 0, 8, 12, 0, 16, 20, 24, 0 };
+
+// Indexed by audio_tag_t
+static const char * const tagNames[FLAC_TAG_COUNT] = { "TITLE", "ARTIST", "ALBUM", "DATE", "TRACKNUMBER",
+														"REPLAYGAIN_TRACK_GAIN", "REPLAYGAIN_TRACK_PEAK" };
+
+
+/*******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+void FLACDecoder_Init(void)
+{
+	playing = NULL;
+	incoming = NULL;
+	centerCancel = false;
+}
+
+
+bool FLACDecoder_LoadFile(decoder_stream_t stream, const char* filename)
+{
+	FLACDecoder_Close(stream);
+
+	// Another codec may have used the memory, nothing but the ring and the block is read before it is set
+	flacStream_t * st = AudioDecoder_GetStreamMemory(stream);
+	memset(st, 0, offsetof(flacStream_t, ring));
+
+	if (f_open(&st->file, _T(filename), FA_READ) != FR_OK)
+	{
+		return false;
+	}
+
+	if (!parseMetadata(st))
+	{
+		f_close(&st->file);
+		return false;
+	}
+
+	st->fileIsOpened = true;
+	st->lastChannels = st->channels;
+	st->blockSample = 0;
+	st->blockFrames = 0;
+	st->blockFramesOut = 0;
+	st->blockChannels = 0;
+	seekAligned(st, st->dataStart);
+	fillRing(st);
+
+	if (stream == DECODER_PLAYING_STREAM)
+	{
+		playing = st;
+	}
+	else
+	{
+		incoming = st;
+	}
+	return true;
+}
+
+
+decoder_result_t FLACDecoder_DecodeFrame(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate)
+{
+	flacStream_t * st = (stream == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	*numSamplesDecoded = 0;
+	*sampleRate = 0;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return DECODER_NO_FILE;
+	}
+
+	if ((st->blockFramesOut >= st->blockFrames) && !decodeNextBlock(st))
+	{
+		return DECODER_END_OF_FILE;
+	}
+
+	st->lastChannels = (centerCancel && (st->blockChannels == 2)) ? 1 : st->blockChannels;
+
+	uint32_t frames = st->blockFrames - st->blockFramesOut;
+	if (frames > FLAC_OUTPUT_SAMPLES)
+	{
+		frames = FLAC_OUTPUT_SAMPLES;
+	}
+	if (frames > decodedBufferSize / st->lastChannels)
+	{
+		frames = decodedBufferSize / st->lastChannels;
+	}
+
+	if (st->lastChannels == st->blockChannels)
+	{
+		// Already 16 bit interleaved
+		memcpy(decodedDataBuffer, (const uint8_t *)st->block + st->blockFramesOut * st->blockChannels * 2, frames * st->blockChannels * 2);
+	}
+	else
+	{
+		// Center cancel: (L - R) / 2
+		const uint32_t * packed = (const uint32_t *)st->block + st->blockFramesOut;
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			decodedDataBuffer[i] = ((int16_t)(packed[i] & 0xFFFF) - (int16_t)(packed[i] >> 16)) / 2;
+		}
+	}
+
+	st->blockFramesOut += frames;
+
+	*numSamplesDecoded = frames * st->lastChannels;
+	*sampleRate = st->blockRate;
+
+	return DECODER_WORKED;
+}
+
+
+bool FLACDecoder_ReadAhead(void)
+{
+	bool res = false;
+
+	if (playing && playing->fileIsOpened)
+	{
+		res = (fillRing(playing) != 0);
+	}
+	if (!res && incoming && incoming->fileIsOpened)
+	{
+		res = (fillRing(incoming) != 0);
+	}
+	return res;
+}
+
+
+void FLACDecoder_Close(decoder_stream_t stream)
+{
+	flacStream_t ** st = (stream == DECODER_PLAYING_STREAM) ? &playing : &incoming;
+
+	if (*st && (*st)->fileIsOpened)
+	{
+		f_close(&(*st)->file);
+		(*st)->fileIsOpened = false;
+	}
+
+	// The memory goes back to the decoder layer
+	*st = NULL;
+}
+
+
+/*******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+static bool parseMetadata(flacStream_t * st)
+{
+	uint8_t data[FLAC_STREAMINFO_BYTES];
+	UINT bytesRead = 0;
+	uint32_t offset = 4;					// After "fLaC"
+	bool hasStreamInfo = false;
+	bool last = false;
+
+	st->dataEnd = f_size(&st->file);
+	st->seekPointCount = 0;
+	memset(st->tags, 0, sizeof(st->tags));
+
+	if ((f_read(&st->file, data, 4, &bytesRead) != FR_OK) || (bytesRead < 4) || (memcmp(data, "fLaC", 4) != 0))
+	{
+		return false;
+	}
+
+	while (!last)
+	{
+		// Last flag and type, then a 24 bit length
+		f_lseek(&st->file, offset);
+		if ((f_read(&st->file, data, 4, &bytesRead) != FR_OK) || (bytesRead < 4))
+		{
+			return false;
+		}
+
+		uint8_t type = data[0] & 0x7F;
+		uint32_t length = (data[1] << 16) | (data[2] << 8) | data[3];
+		last = (data[0] & 0x80) != 0;
+
+		if ((type == FLAC_META_STREAMINFO) && (length >= FLAC_STREAMINFO_BYTES))
+		{
+			if ((f_read(&st->file, data, FLAC_STREAMINFO_BYTES, &bytesRead) != FR_OK) || (bytesRead < FLAC_STREAMINFO_BYTES))
+			{
+				return false;
+			}
+
+			// Min and max block size (16 bits each), min and max frame size (24 each), rate (20), channels - 1 (3),
+			// bits per sample - 1 (5), total samples (36), MD5
+			st->maxBlockSize = (data[2] << 8) | data[3];
+			st->sampleRate = (data[10] << 12) | (data[11] << 4) | (data[12] >> 4);
+			st->channels = ((data[12] >> 1) & 0x07) + 1;
+			st->bitsPerSample = (((data[12] & 0x01) << 4) | (data[13] >> 4)) + 1;
+			st->totalSamples = ((uint64_t)(data[13] & 0x0F) << 32) |
+								((uint32_t)data[14] << 24) | (data[15] << 16) | (data[16] << 8) | data[17];
+			hasStreamInfo = true;
+		}
+		else if (type == FLAC_META_SEEKTABLE)
+		{
+			// Evenly picked if there are more than we keep. Sample number (64 bits), offset (64), frame samples (16)
+			uint32_t points = length / FLAC_SEEKPOINT_BYTES;
+			uint32_t stride = (points + FLAC_SEEK_POINTS - 1) / FLAC_SEEK_POINTS;
+
+			for (uint32_t i = 0; (i < points) && (st->seekPointCount < FLAC_SEEK_POINTS); i += stride)
+			{
+				f_lseek(&st->file, offset + 4 + i * FLAC_SEEKPOINT_BYTES);
+				if ((f_read(&st->file, data, FLAC_SEEKPOINT_BYTES, &bytesRead) != FR_OK) || (bytesRead < FLAC_SEEKPOINT_BYTES))
+				{
+					break;
+				}
+
+				// Placeholders are all ones, and anything past 32 bits is no use here
+				if (data[0] || data[1] || data[2] || data[3] || data[8] || data[9] || data[10] || data[11])
+				{
+					continue;
+				}
+				st->seekPoints[st->seekPointCount].sample = ((uint32_t)data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+				st->seekPoints[st->seekPointCount].offset = ((uint32_t)data[12] << 24) | (data[13] << 16) | (data[14] << 8) | data[15];
+				st->seekPointCount++;
+			}
+		}
+		else if (type == FLAC_META_COMMENT)
+		{
+			parseComments(st, offset + 4, length);
+		}
+
+		offset += 4 + length;
+		if (offset >= st->dataEnd)
+		{
+			return false;
+		}
+	}
+
+	st->dataStart = offset;
+
+	return hasStreamInfo && st->sampleRate && (st->channels <= FLAC_MAX_CHANNELS) &&
+			(st->bitsPerSample >= 8) && (st->bitsPerSample <= 24) && (st->maxBlockSize <= FLAC_MAX_BLOCK_SIZE);
+}
+
+
+static void parseComments(flacStream_t * st, uint32_t offset, uint32_t length)
+{
+	char text[FLAC_TAG_SIZE + 16];
+	uint8_t field[4];
+	UINT bytesRead = 0;
+	uint32_t end = offset + length;
+
+	// Vendor string, then the number of comments. Every length is 32 bit little endian
+	f_lseek(&st->file, offset);
+	if ((f_read(&st->file, field, 4, &bytesRead) != FR_OK) || (bytesRead < 4))
+	{
+		return;
+	}
+	offset += 4 + (field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24));
+
+	f_lseek(&st->file, offset);
+	if ((offset + 4 > end) || (f_read(&st->file, field, 4, &bytesRead) != FR_OK) || (bytesRead < 4))
+	{
+		return;
+	}
+	uint32_t count = field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+	offset += 4;
+
+	for (uint32_t i = 0; (i < count) && (i < FLAC_MAX_COMMENTS) && (offset + 4 <= end); i++)
+	{
+		f_lseek(&st->file, offset);
+		if ((f_read(&st->file, field, 4, &bytesRead) != FR_OK) || (bytesRead < 4))
+		{
+			return;
+		}
+		uint32_t commentLength = field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+		uint32_t textLength = (commentLength < sizeof(text) - 1) ? commentLength : (sizeof(text) - 1);
+
+		if ((f_read(&st->file, text, textLength, &bytesRead) != FR_OK) || (bytesRead < textLength))
+		{
+			return;
+		}
+		text[textLength] = '\0';
+
+		// "NAME=value", the name is case insensitive
+		for (uint8_t t = 0; t < FLAC_TAG_COUNT; t++)
+		{
+			const char * name = tagNames[t];
+			uint32_t n = 0;
+
+			while (name[n] && (toupper((unsigned char)text[n]) == name[n]))
+			{
+				n++;
+			}
+			if (!name[n] && (text[n] == '='))
+			{
+				strncpy(st->tags[t], &text[n + 1], FLAC_TAG_SIZE - 1);
+				st->tags[t][FLAC_TAG_SIZE - 1] = '\0';
+			}
+		}
+
+		offset += 4 + commentLength;
+	}
+}
+
+
+static uint32_t fillRing(flacStream_t * st)
+{
+	uint32_t totalBytesRead = 0;
+
+	while (!st->fileEnded && (st->readPosition < st->dataEnd))
+	{
+		// Whole sectors, up to the sector of the next byte (still in use) or the end of the ring
+		uint32_t ringIndex = st->readPosition & FLAC_RING_MASK;
+		uint32_t bytesToRead = FLAC_RING_SIZE - (st->readPosition - (st->position & ~(FILE_SECTOR_SIZE - 1)));
+
+		if (bytesToRead > FLAC_RING_SIZE - ringIndex)
+		{
+			bytesToRead = FLAC_RING_SIZE - ringIndex;
+		}
+
+		if (bytesToRead < FILE_SECTOR_SIZE)
+		{
+			break;
+		}
+
+		UINT bytesRead = 0;
+		if (f_read(&st->file, &st->ring[ringIndex], bytesToRead, &bytesRead) != FR_OK)
+		{
+			bytesRead = 0;
+		}
+
+		st->readPosition += bytesRead;
+		totalBytesRead += bytesRead;
+		st->fileEnded = (bytesRead < bytesToRead);
+	}
+
+	return totalBytesRead;
+}
+
+
+static void seekAligned(flacStream_t * st, uint32_t filePosition)
+{
+	uint32_t sectorStart = filePosition & ~(FILE_SECTOR_SIZE - 1);
+
+	f_lseek(&st->file, sectorStart);
+
+	st->readPosition = sectorStart;
+	st->position = filePosition;
+	st->fileEnded = false;
+}
+
+
+static bool decodeNextBlock(flacStream_t * st)
+{
+	// Stays right at the end if there is no next block
+	st->blockSample += st->blockFrames;
+	st->blockFrames = 0;
+	st->blockFramesOut = 0;
+
+	for (uint8_t i = 0; i < FLAC_FRAME_RETRIES; i++)
+	{
+		if (!findSync(st))
+		{
+			return false;
+		}
+
+		uint32_t frameStart = st->position;
+		if (decodeFrameAt(st))
+		{
+			st->blockPosition = frameStart;
+			return true;
+		}
+
+		// Not a frame after all (or a damaged one), on to the next sync code after this one.
+		// Its bytes may be gone from the ring if the frame was read as it was decoded
+		if (frameStart + 1 + FLAC_RING_SIZE < st->readPosition)
+		{
+			seekAligned(st, frameStart + 1);
+		}
+		else
+		{
+			st->position = frameStart + 1;
+		}
+	}
+	return false;
+}
+
+
+static bool findSync(flacStream_t * st)
+{
+	for (uint32_t scanned = 0; scanned < FLAC_SYNC_SEARCH; )
+	{
+		if (st->position + 2 > st->dataEnd)
+		{
+			return false;
+		}
+
+		if (st->position + 2 > st->readPosition)
+		{
+			// Ran dry: read now, after a seek the first sector is not read yet
+			if (!fillRing(st) && (st->fileEnded || (st->position + 2 > st->readPosition)))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		// 14 sync bits, a reserved 0, then the blocking strategy
+		if ((RING_BYTE(st, st->position) == 0xFF) && ((RING_BYTE(st, st->position + 1) & 0xFE) == 0xF8))
+		{
+			return true;
+		}
+		st->position++;
+		scanned++;
+	}
+	return false;
+}
+
+
+static bool decodeFrameAt(flacStream_t * st)
+{
+	flacBits_t br = { .cache = 0, .count = 0, .position = st->position, .underrun = false };
+	uint8_t header[FLAC_MAX_HEADER_BYTES];
+	uint32_t length = 0;
+
+	for (; length < 4; length++)
+	{
+		header[length] = bitsRead(st, &br, 8);
+	}
+
+	uint32_t blockSizeCode = header[2] >> 4;
+	uint32_t rateCode = header[2] & 0x0F;
+	uint32_t assignment = header[3] >> 4;
+	uint32_t sizeCode = (header[3] >> 1) & 0x07;
+
+	if (!blockSizeCode || (rateCode == 0x0F) || (sizeCode && !frameSampleSizes[sizeCode]) ||
+		(assignment > FLAC_MID_SIDE) || (header[3] & 0x01))
+	{
+		return false;
+	}
+
+	// Frame or sample number, coded as UTF-8 (up to 7 bytes)
+	uint8_t first = header[length++] = bitsRead(st, &br, 8);
+	uint32_t extraBytes = 0;
+	uint64_t number = first;
+
+	if (first & 0x80)
+	{
+		uint32_t ones = __CLZ(~((uint32_t)first << 24));
+		if ((ones < 2) || (ones > 7))
+		{
+			return false;
+		}
+		extraBytes = ones - 1;
+		number = first & (0x7F >> ones);
+	}
+	for (uint32_t i = 0; i < extraBytes; i++)
+	{
+		uint8_t next = header[length++] = bitsRead(st, &br, 8);
+		if ((next & 0xC0) != 0x80)
+		{
+			return false;
+		}
+		number = (number << 6) | (next & 0x3F);
+	}
+
+	uint32_t blockSize;
+	if (blockSizeCode == 1)
+	{
+		blockSize = 192;
+	}
+	else if (blockSizeCode <= 5)
+	{
+		blockSize = 576U << (blockSizeCode - 2);
+	}
+	else if (blockSizeCode == 6)
+	{
+		blockSize = (header[length++] = bitsRead(st, &br, 8)) + 1;
+	}
+	else if (blockSizeCode == 7)
+	{
+		header[length++] = bitsRead(st, &br, 8);
+		header[length++] = bitsRead(st, &br, 8);
+		blockSize = ((header[length - 2] << 8) | header[length - 1]) + 1;
+	}
+	else
+	{
+		blockSize = 256U << (blockSizeCode - 8);
+	}
+
+	uint32_t rate;
+	if (rateCode == 0)
+	{
+		rate = st->sampleRate;
+	}
+	else if (rateCode < 12)
+	{
+		rate = frameRates[rateCode];
+	}
+	else
+	{
+		// kHz in 8 bits, Hz in 16 bits or tens of Hz in 16 bits
+		rate = header[length++] = bitsRead(st, &br, 8);
+		if (rateCode != 12)
+		{
+			header[length++] = bitsRead(st, &br, 8);
+			rate = (header[length - 2] << 8) | header[length - 1];
+		}
+		rate *= (rateCode == 12) ? 1000 : ((rateCode == 14) ? 10 : 1);
+	}
+
+	if (bitsRead(st, &br, 8) != crc8(header, length))
+	{
+		return false;
+	}
+
+	uint32_t bitsPerSample = sizeCode ? frameSampleSizes[sizeCode] : st->bitsPerSample;
+	uint32_t channels = (assignment < FLAC_LEFT_SIDE) ? (assignment + 1) : 2;
+
+	if ((blockSize > FLAC_MAX_BLOCK_SIZE) || (channels > FLAC_MAX_CHANNELS) || !rate)
+	{
+		return false;
+	}
+
+	// The side channel has one more bit: the second one of left/side and mid/side, the first one of right/side
+	int32_t * data[FLAC_MAX_CHANNELS] = { st->block, AudioDecoder_GetScratch() };
+
+	for (uint32_t ch = 0; ch < channels; ch++)
+	{
+		uint32_t sideBit = ((assignment == FLAC_RIGHT_SIDE) && (ch == 0)) ||
+							(((assignment == FLAC_LEFT_SIDE) || (assignment == FLAC_MID_SIDE)) && (ch == 1));
+
+		if (!decodeSubframe(st, &br, data[ch], blockSize, bitsPerSample + sideBit))
+		{
+			return false;
+		}
+	}
+
+	// Byte align, then the CRC-16 of the frame (not checked, the header CRC and the subframe checks catch false syncs)
+	bitsRead(st, &br, br.count & 0x07);
+	bitsRead(st, &br, 16);
+
+	if (bitsPastEnd(st, &br))
+	{
+		return false;
+	}
+
+	// What was loaded into the cache and not used is the start of the next frame
+	st->position = br.position - br.count / 8;
+
+	st->blockSample = (header[1] & 0x01) ? number : (number * st->maxBlockSize);
+	st->blockRate = rate;
+	st->blockFrames = blockSize;
+	st->blockFramesOut = 0;
+	st->blockChannels = channels;
+
+	// Back to stereo, 16 bit and packed in place over the first channel
+	int32_t * a = data[0];
+	int32_t * b = data[1];
+	int32_t shift = (int32_t)bitsPerSample - 16;
+
+	if (channels == 1)
+	{
+		for (uint32_t i = 0; i < blockSize; i += 2)
+		{
+			int32_t first = a[i];
+			int32_t second = (i + 1 < blockSize) ? a[i + 1] : 0;
+
+			first = (shift >= 0) ? (first >> shift) : (first << -shift);
+			second = (shift >= 0) ? (second >> shift) : (second << -shift);
+			a[i / 2] = (int32_t)((uint16_t)first | ((uint32_t)second << 16));
+		}
+		return true;
+	}
+
+	for (uint32_t i = 0; i < blockSize; i++)
+	{
+		int32_t left;
+		int32_t right;
+
+		switch (assignment)
+		{
+			case FLAC_LEFT_SIDE:
+				left = a[i];
+				right = a[i] - b[i];
+				break;
+
+			case FLAC_RIGHT_SIDE:
+				left = a[i] + b[i];
+				right = b[i];
+				break;
+
+			case FLAC_MID_SIDE:
+			{
+				int32_t mid = ((uint32_t)a[i] << 1) | (b[i] & 0x01);
+				left = (mid + b[i]) >> 1;
+				right = (mid - b[i]) >> 1;
+				break;
+			}
+
+			default:
+				left = a[i];
+				right = b[i];
+				break;
+		}
+
+		left = (shift >= 0) ? (left >> shift) : (left << -shift);
+		right = (shift >= 0) ? (right >> shift) : (right << -shift);
+		a[i] = (int32_t)((uint16_t)left | ((uint32_t)right << 16));
+	}
+
+	return true;
+}
+
+
+static bool decodeSubframe(flacStream_t * st, flacBits_t * br, int32_t * data, uint32_t blockSize, uint32_t bitsPerSample)
+{
+	// Zero padding bit, 6 bit type, wasted bits flag
+	uint32_t header = bitsRead(st, br, 8);
+	uint32_t type = (header >> 1) & 0x3F;
+	uint32_t wasted = 0;
+
+	if (header & 0x80)
+	{
+		return false;
+	}
+
+	if (header & 0x01)
+	{
+		wasted = bitsReadUnary(st, br) + 1;
+		if (wasted >= bitsPerSample)
+		{
+			return false;
+		}
+		bitsPerSample -= wasted;
+	}
+
+	if (type == 0)
+	{
+		// Constant
+		int32_t value = bitsReadSigned(st, br, bitsPerSample);
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			data[i] = value;
+		}
+	}
+	else if (type == 1)
+	{
+		// Verbatim
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			data[i] = bitsReadSigned(st, br, bitsPerSample);
+		}
+	}
+	else if ((type >= 8) && (type <= 12))
+	{
+		// Fixed polynomial predictor, order 0 to 4
+		uint32_t order = type - 8;
+
+		if (order > blockSize)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < order; i++)
+		{
+			data[i] = bitsReadSigned(st, br, bitsPerSample);
+		}
+		if (!decodeResidual(st, br, data, blockSize, order))
+		{
+			return false;
+		}
+		fixedRestore(data, blockSize, order);
+	}
+	else if (type >= 32)
+	{
+		// LPC, order 1 to 32: warm-up, coefficient precision, shift, coefficients, residual
+		uint32_t order = type - 31;
+		int32_t coefs[FLAC_MAX_LPC_ORDER] = { 0 };
+
+		if (order > blockSize)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < order; i++)
+		{
+			data[i] = bitsReadSigned(st, br, bitsPerSample);
+		}
+
+		uint32_t precision = bitsRead(st, br, 4) + 1;
+		int32_t shift = bitsReadSigned(st, br, 5);
+
+		if ((precision == 16) || (shift < 0))
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < order; i++)
+		{
+			coefs[i] = bitsReadSigned(st, br, precision);
+		}
+		if (!decodeResidual(st, br, data, blockSize, order))
+		{
+			return false;
+		}
+		lpcRestore(data, blockSize, coefs, order, shift);
+	}
+	else
+	{
+		return false;
+	}
+
+	if (wasted)
+	{
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			data[i] = (int32_t)((uint32_t)data[i] << wasted);
+		}
+	}
+
+	return !bitsPastEnd(st, br);
+}
+
+
+static bool decodeResidual(flacStream_t * st, flacBits_t * br, int32_t * data, uint32_t blockSize, uint32_t order)
+{
+	// 4 bit Rice parameters (escape 15) or 5 bit ones (escape 31), then 2^partitionOrder partitions
+	uint32_t method = bitsRead(st, br, 2);
+	uint32_t partitionOrder = bitsRead(st, br, 4);
+	uint32_t parameterBits = method ? 5 : 4;
+	uint32_t escape = method ? 0x1F : 0x0F;
+	uint32_t partitionSamples = blockSize >> partitionOrder;
+
+	if ((method > 1) || ((partitionSamples << partitionOrder) != blockSize) || (partitionSamples < order))
+	{
+		return false;
+	}
+
+	int32_t * out = data + order;
+
+	for (uint32_t p = 0; p < (1U << partitionOrder); p++)
+	{
+		// The warm-up samples come out of the first partition
+		uint32_t count = p ? partitionSamples : (partitionSamples - order);
+		uint32_t k = bitsRead(st, br, parameterBits);
+
+		if (k == escape)
+		{
+			// Unencoded, n bits each
+			uint32_t bits = bitsRead(st, br, 5);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				out[i] = bitsReadSigned(st, br, bits);
+			}
+		}
+		else
+		{
+			readRice(st, br, out, count, k);
+		}
+
+		if (bitsPastEnd(st, br))
+		{
+			return false;
+		}
+		out += count;
+	}
+
+	return true;
+}
+
+
+static void readRice(flacStream_t * st, flacBits_t * br, int32_t * out, uint32_t count, uint32_t k)
+{
+	// Local copy, so it stays in registers across the stores to out
+	flacBits_t bits = *br;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t q = 0;
+
+		// Unary quotient: the 0s before the first 1 of the cache
+		while (!bits.cache)
+		{
+			if (bits.underrun)
+			{
+				*br = bits;
+				return;
+			}
+			q += bits.count;
+			bits.count = 0;
+			bitsRefill(st, &bits);
+		}
+
+		uint32_t zeros = __CLZ(bits.cache);
+		q += zeros;
+		bits.cache <<= zeros;
+		bits.cache <<= 1;
+		bits.count -= zeros + 1;
+
+		// k bit remainder
+		uint32_t u = q << k;
+		if (k)
+		{
+			u |= bitsRead(st, &bits, k);
+		}
+
+		// Zigzag back to signed
+		out[i] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+	}
+
+	*br = bits;
+}
+
+
+static void fixedRestore(int32_t * data, uint32_t blockSize, uint32_t order)
+{
+	switch (order)
+	{
+		case 1:
+			for (uint32_t i = 1; i < blockSize; i++)
+			{
+				data[i] += data[i - 1];
+			}
+			break;
+
+		case 2:
+			for (uint32_t i = 2; i < blockSize; i++)
+			{
+				data[i] += 2 * data[i - 1] - data[i - 2];
+			}
+			break;
+
+		case 3:
+			for (uint32_t i = 3; i < blockSize; i++)
+			{
+				data[i] += 3 * (data[i - 1] - data[i - 2]) + data[i - 3];
+			}
+			break;
+
+		case 4:
+			for (uint32_t i = 4; i < blockSize; i++)
+			{
+				data[i] += 4 * (data[i - 1] + data[i - 3]) - 6 * data[i - 2] - data[i - 4];
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+static void lpcRestore(int32_t * data, uint32_t blockSize, const int32_t * coefs, uint32_t order, uint32_t shift)
+{
+	int32_t * x = data + order;
+	int32_t * end = data + blockSize;
+
+	if (order > FLAC_UNROLLED_ORDER)
+	{
+		// Out of the subset, plain loop
+		for (; x < end; x++)
+		{
+			int64_t acc = 0;
+			for (uint32_t j = 0; j < order; j++)
+			{
+				acc += (int64_t)coefs[j] * x[-(int32_t)j - 1];
+			}
+			*x += (int32_t)(acc >> shift);
+		}
+		return;
+	}
+
+	// Locals, so the compiler keeps them in registers and knows the stores to data do not change them
+	const int32_t c0 = coefs[0], c1 = coefs[1], c2 = coefs[2], c3 = coefs[3];
+	const int32_t c4 = coefs[4], c5 = coefs[5], c6 = coefs[6], c7 = coefs[7];
+	const int32_t c8 = coefs[8], c9 = coefs[9], c10 = coefs[10], c11 = coefs[11];
+
+	switch (order)
+	{
+		LPC_KERNEL(1);
+		LPC_KERNEL(2);
+		LPC_KERNEL(3);
+		LPC_KERNEL(4);
+		LPC_KERNEL(5);
+		LPC_KERNEL(6);
+		LPC_KERNEL(7);
+		LPC_KERNEL(8);
+		LPC_KERNEL(9);
+		LPC_KERNEL(10);
+		LPC_KERNEL(11);
+		LPC_KERNEL(12);
+
+		default:
+			break;
+	}
+}
+
+
+static inline void bitsRefill(flacStream_t * st, flacBits_t * br)
+{
+	while (br->count <= 24)
+	{
+		if (br->position >= st->readPosition)
+		{
+			// Frame longer than what was read ahead: read now. The bytes before this one are not needed anymore
+			st->position = br->position;
+			if (br->underrun || (br->position >= st->dataEnd) || !fillRing(st))
+			{
+				// Zeros past the end, bitsPastEnd tells if they were used
+				br->underrun = true;
+				br->position++;
+				br->count += 8;
+				continue;
+			}
+		}
+
+		br->cache |= (uint32_t)RING_BYTE(st, br->position) << (24 - br->count);
+		br->position++;
+		br->count += 8;
+	}
+}
+
+
+static inline uint32_t bitsRead(flacStream_t * st, flacBits_t * br, uint32_t n)
+{
+	if (n > 24)
+	{
+		uint32_t high = bitsRead(st, br, n - 16);
+		return (high << 16) | bitsRead(st, br, 16);
+	}
+	if (!n)
+	{
+		return 0;
+	}
+
+	if (br->count < n)
+	{
+		bitsRefill(st, br);
+	}
+
+	uint32_t value = br->cache >> (32 - n);
+	br->cache <<= n;
+	br->count -= n;
+	return value;
+}
+
+
+static inline int32_t bitsReadSigned(flacStream_t * st, flacBits_t * br, uint32_t n)
+{
+	if (!n)
+	{
+		return 0;
+	}
+	return (int32_t)(bitsRead(st, br, n) << (32 - n)) >> (32 - n);
+}
+
+
+static inline uint32_t bitsReadUnary(flacStream_t * st, flacBits_t * br)
+{
+	uint32_t q = 0;
+
+	bitsRefill(st, br);
+	while (!br->cache)
+	{
+		if (br->underrun)
+		{
+			return q;
+		}
+		q += br->count;
+		br->count = 0;
+		bitsRefill(st, br);
+	}
+
+	uint32_t zeros = __CLZ(br->cache);
+	br->cache <<= zeros;
+	br->cache <<= 1;
+	br->count -= zeros + 1;
+	return q + zeros;
+}
+
+
+static inline bool bitsPastEnd(const flacStream_t * st, const flacBits_t * br)
+{
+	return br->underrun && ((uint64_t)br->position * 8 - br->count > (uint64_t)st->dataEnd * 8);
+}
+
+
+static uint8_t crc8(const uint8_t * data, uint32_t length)
+{
+	uint8_t crc = 0;
+
+	for (uint32_t i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+
+static bool flacProbe(const uint8_t * header, uint32_t length)
+{
+	return (length >= 4) && (memcmp(header, "fLaC", 4) == 0);
+}
+
+
+static bool flacGetChannels(decoder_stream_t id, uint8_t * channelCount)
+{
+	flacStream_t * st = (id == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	if (!st || !st->fileIsOpened || !st->blockChannels)
+	{
+		return false;
+	}
+	*channelCount = st->lastChannels;
+	return true;
+}
+
+
+static bool flacSeek(int32_t samples)
+{
+	flacStream_t * st = playing;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+
+	uint64_t current = st->blockSample + st->blockFramesOut;
+	int64_t target = (int64_t)current + samples;
+
+	if (target < 0)
+	{
+		target = 0;
+	}
+	if (st->totalSamples && ((uint64_t)target >= st->totalSamples))
+	{
+		// Past the end, the song is over
+		st->blockFramesOut = st->blockFrames;
+		seekAligned(st, st->dataEnd);
+		return false;
+	}
+
+	uint64_t blockEnd = st->blockSample + st->blockFrames;
+
+	if (((uint64_t)target < st->blockSample) || ((uint64_t)target >= blockEnd + st->maxBlockSize))
+	{
+		// Far, or back: between the seek points around the target, interpolating about a block early.
+		// Bytes per sample change from frame to frame, so a guess can land past the target: that frame
+		// is then the upper bound and the next guess goes further back. One far before it is the lower
+		uint64_t sampleBefore = 0;
+		uint64_t offsetBefore = 0;
+		uint64_t sampleAfter = st->totalSamples;
+		uint64_t offsetAfter = st->dataEnd - st->dataStart;
+		uint64_t early = st->maxBlockSize;
+
+		for (uint8_t i = 0; i < st->seekPointCount; i++)
+		{
+			if (st->seekPoints[i].sample <= (uint64_t)target)
+			{
+				sampleBefore = st->seekPoints[i].sample;
+				offsetBefore = st->seekPoints[i].offset;
+			}
+			else
+			{
+				sampleAfter = st->seekPoints[i].sample;
+				offsetAfter = st->seekPoints[i].offset;
+				break;
+			}
+		}
+
+		for (uint8_t step = 0; step < FLAC_SEEK_STEPS; step++)
+		{
+			uint64_t offset = offsetBefore;
+			if ((sampleAfter > sampleBefore) && (offsetAfter > offsetBefore))
+			{
+				uint64_t samplesIn = (uint64_t)target - sampleBefore;
+				samplesIn = (samplesIn > early) ? (samplesIn - early) : 0;
+				offset += samplesIn * (offsetAfter - offsetBefore) / (sampleAfter - sampleBefore);
+			}
+
+			seekAligned(st, st->dataStart + (uint32_t)offset);
+			if (!decodeNextBlock(st))
+			{
+				return false;
+			}
+
+			if ((uint64_t)target < st->blockSample)
+			{
+				sampleAfter = st->blockSample;
+				offsetAfter = st->blockPosition - st->dataStart;
+				early *= 2;
+			}
+			else if ((uint64_t)target >= st->blockSample + (FLAC_SEEK_DECODE_FRAMES + 1) * st->blockFrames)
+			{
+				sampleBefore = st->blockSample;
+				offsetBefore = st->blockPosition - st->dataStart;
+				early = st->maxBlockSize;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		// Still past it: from the frame of the lower bound, before the target for sure
+		if ((uint64_t)target < st->blockSample)
+		{
+			seekAligned(st, st->dataStart + (uint32_t)offsetBefore);
+			if (!decodeNextBlock(st))
+			{
+				return false;
+			}
+		}
+		blockEnd = st->blockSample + st->blockFrames;
+	}
+
+	// Decoded through to the frame with the target, a frame past it is as good as it gets
+	for (uint8_t i = 0; ((uint64_t)target >= blockEnd) && (i < FLAC_SEEK_DECODE_FRAMES); i++)
+	{
+		if (!decodeNextBlock(st))
+		{
+			return false;
+		}
+		blockEnd = st->blockSample + st->blockFrames;
+	}
+
+	if (((uint64_t)target >= st->blockSample) && ((uint64_t)target < blockEnd))
+	{
+		st->blockFramesOut = (uint16_t)(target - st->blockSample);
+	}
+	return true;
+}
+
+
+static uint32_t flacGetRemainingMs(void)
+{
+	if (!playing || !playing->fileIsOpened || !playing->totalSamples)
+	{
+		return UINT32_MAX;
+	}
+
+	uint64_t current = playing->blockSample + playing->blockFramesOut;
+	uint64_t samples = (playing->totalSamples > current) ? (playing->totalSamples - current) : 0;
+	return (uint32_t)(samples * 1000U / playing->sampleRate);
+}
+
+
+static bool flacPromote(void)
+{
+	if (!incoming || !incoming->fileIsOpened)
+	{
+		return false;
+	}
+
+	// Its memory is free for the next crossfade (AudioDecoder_PromoteIncoming)
+	FLACDecoder_Close(DECODER_PLAYING_STREAM);
+
+	playing = incoming;
+	incoming = NULL;
+
+	return true;
+}
+
+
+static bool flacGetTag(audio_tag_t tag, char ** value)
+{
+	if (!playing || !playing->fileIsOpened || (tag >= FLAC_TAG_COUNT) || !playing->tags[tag][0])
+	{
+		return false;
+	}
+	*value = playing->tags[tag];
+	return true;
+}
+
+
+static void flacSetCenterCancel(bool enable)
+{
+	centerCancel = enable;
+}
@@ -0,0 +1,94 @@
+/***************************************************************************//**
+  @file     flac_decoder.h
+  @brief    FLAC decoder, fixed point, mono or stereo, frames streamed from FatFs
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/*******************************************************************************
+*							INCLUDE HEADER FILES
+******************************************************************************/
+
+#ifndef _FLAC_DECODER_H_
+#define _FLAC_DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_decoder.h"
+
+
+/*******************************************************************************
+*				  CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+******************************************************************************/
+
+// Compressed data kept buffered ahead of the decoder (KB, power of 2). Frames longer than it are read as they are decoded
+#ifndef FLAC_READAHEAD_KB
+#define FLAC_READAHEAD_KB		8
+#endif
+
+// Largest block played, per channel samples. 4608 is the most the FLAC subset allows up to 48 kHz.
+// Each stream keeps one decoded block (4 * FLAC_MAX_BLOCK_SIZE bytes) in its memory, AUDIO_DECODER_STREAM_SIZE.
+// The second channel is decoded in the scratch of the decoder layer
+#ifndef FLAC_MAX_BLOCK_SIZE
+#define FLAC_MAX_BLOCK_SIZE		4608
+#endif
+
+
+/*******************************************************************************
+ *					VARIABLE PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+// FLAC entry of the codec table (audio_decoder.c)
+extern const audio_codec_t flacCodec;
+
+
+/*******************************************************************************
+ *					FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief Initializes both FLAC streams (playing and incoming).
+*/
+void FLACDecoder_Init(void);
+
+
+/**
+ * @brief: Reads the metadata blocks (STREAMINFO, SEEKTABLE, VORBIS_COMMENT) and positions the file at the first frame.
+ * @param stream: playing or incoming.
+ * @param filename: file's path.
+ * @return: false if it can't be opened or it is not 8 to 24 bit, mono or stereo, with blocks up to FLAC_MAX_BLOCK_SIZE.
+ */
+bool FLACDecoder_LoadFile(decoder_stream_t stream, const char* filename);
+
+
+/**
+ * @brief: Outputs the next samples of the decoded block (up to 1152 per channel), decoding the next frame when it is used up.
+ * @param stream: playing or incoming.
+ * @param decodedDataBuffer: output, interleaved if stereo.
+ * @param decodedBufferSize: size of the output in samples.
+ * @param numSamplesDecoded: here we store the number of samples (all channels).
+ * @param sampleRate: here we store the sample rate of the frame.
+ * @return: DECODER_END_OF_FILE after the last frame.
+ */
+decoder_result_t FLACDecoder_DecodeFrame(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate);
+
+
+/**
+ * @brief: Background read into the read-ahead buffer of the open files, whole sectors only.
+ * @return: true if something was read.
+ */
+bool FLACDecoder_ReadAhead(void);
+
+
+/**
+ * @brief: Closes the file of a stream.
+ * @param stream: playing or incoming.
+ */
+void FLACDecoder_Close(decoder_stream_t stream);
+
+
+#endif /* _FLAC_DECODER_H_ */
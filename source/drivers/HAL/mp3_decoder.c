@@ -21,20 +21,147 @@
  *					CONSTANT AND MACRO DEFINITIONS USING #DEFINE
  ******************************************************************************/
 
-#define NUMBER_BYTES_PER_FRAME 	3200
+#define FILE_SECTOR_SIZE		512		// FatFs sector, reads of whole aligned sectors go straight to our buffer
 
-#define BYTES_PER_READ_OPERATION	500
+#define MP3_MAX_FRAME_BYTES		1441	// MPEG1 Layer III, 320 kbps @ 32 kHz, with padding
+
+#define MP3_BUFFER_GUARD_SIZE	(3 * FILE_SECTOR_SIZE)	// Holds the unconsumed tail on wrap (>= MP3_MAX_FRAME_BYTES)
+#define MP3_BUFFER_RING_SIZE	(MP3_READAHEAD_KB * 1024U)	// Read-ahead depth, power of 2 and whole sectors
+
+#define MP3_BUFFER_SIZE			(MP3_BUFFER_GUARD_SIZE + MP3_BUFFER_RING_SIZE)
+
+#define MP3_READAHEAD_CHUNK		(4 * FILE_SECTOR_SIZE)	// Max bytes read per MP3Decoder_ReadAhead call
 
 #define DECODER_NORMAL_MODE 0
 
 #define NO_ERROR_INFO 0
 
+#define MP3_MAX_PRIMING_FRAMES	3		// main_data_begin reaches 511 bytes back, 3 frames at 32 kbps
+#define MP3_OUTPUT_TOO_SMALL	(-100)	// Not a Helix code, the PCM buffer can't hold the next frame
+
 #define DEFAULT_ID3 "Unknown"
 
+#define MP3_DEFAULT_FRAME_SAMPLES	1152	// Per channel, MPEG1 Layer III
+
+#define MP3_WORST_CASE_CYCLES	1000000	// Per 1152 samples (~38 MHz): Helix at 320 kbps stereo, an estimate not measured on the K64F
+
+#define MP3_PATH_SIZE			256		// Longer paths are not pre-opened, they load the normal way
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+// Where the audio is and what the tags say, per file
+typedef struct
+{
+	uint32_t fileSize;							// Size of the file used
+	uint32_t audioStart;						// File offset where the audio starts (after the ID3v2 tag)
+	uint32_t audioEnd;							// File offset where the audio ends (trailing tags excluded)
+	bool hasID3;								// True if the file has valid ID3 tag
+	char title[ID3_MAX_NUM_CHARS];				// Title of the song
+	char artist[ID3_MAX_NUM_CHARS];				// Artist of the song
+	char album[ID3_MAX_NUM_CHARS];				// Album of the song
+	char trackNum[ID3_MAX_NUM_CHARS];			// Number of the track inside the album of the song
+	char year[ID3_MAX_NUM_CHARS];				// Year of the songs' album
+	char replayGain[ID3_MAX_NUM_CHARS];			// REPLAYGAIN_TRACK_GAIN (TXXX or APE)
+	char replayGainPeak[ID3_MAX_NUM_CHARS];		// REPLAYGAIN_TRACK_PEAK
+} mp3TrackInfo_t;
+
+
+// Pre-open steps, each one is done in a different call to MP3Decoder_PreOpenStep
+typedef enum
+{
+	PREOPEN_EMPTY,								// Nothing to do
+	PREOPEN_PENDING,							// Path set, the file is not opened yet
+	PREOPEN_OPENED,								// f_open done (the directory walk)
+	PREOPEN_TAGGED,								// Tags read, audio bounds known
+	PREOPEN_READY								// First sectors of audio in data
+} preopen_step_t;
+
+
+// A file opened ahead of time, LoadFile takes it over if asked for the same path
+typedef struct
+{
+	char path[MP3_PATH_SIZE];
+	preopen_step_t step;
+	FIL file;
+	mp3TrackInfo_t info;
+	uint8_t data[MP3_READAHEAD_CHUNK] __attribute__((aligned(4)));	// Sector aligned, like the ring
+	uint32_t dataLength;
+} mp3PreOpen_t;
+
+
+// MP3-encoded buffer data
+//
+//	|<---- GUARD ---->|<-------------------- RING -------------------->|
+//	|........|tail....|Sector|Sector|Sector|......|Sector|Sector|tail..|
+//	         ^                                 ^          ^
+//	        Out (after a wrap)                 In         Out (before the wrap)
+//
+// The ring is a read-ahead FIFO of whole sectors, so FatFs skips its sector window and the SD
+// DMA writes them straight into it. MP3Decoder_ReadAhead tops it up from the main loop while there
+// is nothing else to do, the decoder itself only touches RAM unless the FIFO runs dry.
+// Helix decodes in place from the ring. Only a frame that really crosses the end of the ring is
+// stitched: the tail before the wrap is copied to the end of the guard, just before the ring,
+// so the frame stays contiguous.
+typedef struct
+{
+	// Helix data
+	HMP3Decoder		helixDecoder;       // Helix MP3 decoder instance
+	MP3FrameInfo	lastFrameInfo;      // MP3 frame info
+
+	// MP3 file data
+	FIL				mp3FileObject;		// MP3 file object
+	uint32_t		remainingBytes;		// Encoded MP3 bytes remaining to be decoded
+	uint32_t		decodedFrames;		// Frames decoded since the file was loaded
+	uint32_t		decodedFrameBytes;	// Bytes of those frames, for the average frame length
+	bool			mp3Resync;			// true after a seek, the next sync word is verified
+	bool			fileIsOpened;       // true if there is an open file, false if is not
+	uint32_t		lastFrameLength;   	// Last frame length
+	mp3TrackInfo_t	track;				// Data of the loaded song
+
+	// MP3-encoded buffer data
+	uint8_t			mp3FrameBuffer[MP3_BUFFER_SIZE] __attribute__((aligned(4)));
+	uint8_t *		mp3Ring;			// mp3FrameBuffer + MP3_BUFFER_GUARD_SIZE
+	uint32_t		mp3BufferOut;  		// Bytes consumed since the last seek (ring index = Out % RING_SIZE)
+	uint32_t		mp3BufferIn;   		// Bytes loaded since the last seek (always whole sectors until EOF)
+	uint32_t		mp3GuardWrap;		// Value of Out at the wrap whose tail is already in the guard
+	bool			mp3FileEnded;  		// true once f_read returned less than asked for
+	uint32_t		readAheadStalls;	// Times the decoder had to read the file itself
+
+	// Helix keeps its state here, the scratch is the one shared by the codecs
+	uint32_t		helixState[MP3_DECODER_STATE_SIZE / sizeof(uint32_t)];
+} mp3Stream_t;
+
+_Static_assert(sizeof(mp3Stream_t) <= AUDIO_DECODER_STREAM_SIZE, "mp3Stream_t does not fit in the memory of a stream");
+_Static_assert(MP3_DECODER_SCRATCH_SIZE <= AUDIO_DECODER_SCRATCH_SIZE, "Helix does not fit in the scratch");
+
 /*******************************************************************************
  *      FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
  ******************************************************************************/
 
+/*
+* @brief  Takes the memory of a stream and starts Helix in it, from silence.
+* @param  id: playing or incoming.
+* @returns  the stream, cleared.
+*/
+static mp3Stream_t * takeStream(decoder_stream_t id);
+
+
+/*
+* @brief  Opens a file on the current stream, from a pre-open slot if it is there.
+* @param  filename: file's path.
+* @returns  true if it was opened.
+*/
+static bool loadFile(const char* filename);
+
+
+/*
+* @brief  Closes the file of the current stream, if any, and resets its buffer.
+*/
+static void closeFile(void);
+
+
  /*
  * @brief  Open the file to read the information inside
  * @returns  the number of bytes of the file
@@ -43,22 +170,67 @@ static bool openFile(const char* filename);
 
 
 /*
-* @brief  This function reads the ID3 Tag of the file if it has and move the read position according to the size of the ID3Tag to avoid read it twice
+* @brief  This function reads the ID3 Tags of the file, if it has, and finds where the audio data is
+* @param  file: opened file.
+* @param  info: here we store the tags and the audio bounds.
+*/
+static void readID3Tag(FIL* file, mp3TrackInfo_t* info);
+
+
+/*
+* @brief  Does the next step of a pre-open slot (open, tags or first sectors).
+* @param  slot: slot to advance.
+*/
+static void preOpenAdvance(mp3PreOpen_t* slot);
+
+
+/*
+* @brief  Closes a pre-open slot and leaves it empty.
+* @param  slot: slot to close.
+*/
+static void preOpenClose(mp3PreOpen_t* slot);
+
+
+/*
+* @brief  This function makes sure the next frame is contiguous in the buffer and returns it.
+* 		  Only reads the file if the read-ahead ran dry.
+* @param  bytesAvailable: here we store the number of contiguous bytes at the returned pointer.
+* @returns  pointer to the next byte to be decoded.
+*/
+static uint8_t * fill_buffer_with_mp3_frame(int32_t * bytesAvailable);
+
+
+/*
+* @brief  Reads whole sectors of the file into the free space of the ring.
+* @param  maxBytes: upper bound of bytes to read in this call.
+* @returns  the number of bytes read.
+*/
+static uint32_t readAheadFill(uint32_t maxBytes);
+
+
+/*
+* @brief  Finds the next frame in the buffer and decodes it, moving the buffer pointers past it.
+* @param  decodedDataBuffer: output PCM buffer.
+* @param  decodedBufferSize: size of the output buffer in samples.
+* @returns  Helix error code, ERR_MP3_NONE if a frame was decoded.
 */
-static void readID3Tag(void);
+static int decodeNextFrame(short* decodedDataBuffer, uint32_t decodedBufferSize);
 
 
 /*
-* @brief  calculate the number of bytes of the file
-* @returns  the number of bytes of the file
+* @brief  Computes the length of a Layer III frame from its header.
+* @param  header: pointer to the 4 header bytes.
+* @returns  frame length in bytes, 0 if the header is not valid or it is free format.
 */
-static uint32_t mp3FileObjectSize(void);
+static uint32_t mp3FrameLength(const uint8_t * header);
 
 
 /*
-* @brief  This function fills buffer with info encoded in mp3 file and update the pointers
+* @brief  Positions the file at the sector containing filePosition and resets the buffer so
+* 		  every following read is a whole, aligned sector. The decoder starts at filePosition.
+* @param  filePosition: absolute position in the file.
 */
-static void fill_buffer_with_mp3_frame(void);
+static void seekAligned(uint32_t filePosition);
 
 
 /**
@@ -69,35 +241,61 @@ static void fill_buffer_with_mp3_frame(void);
 static uint32_t readMp3Data(void* buf, uint32_t count);
 
 
-/*****************************************************************************
- *  					VARIABLES WITH LOCAL SCOPE
- *****************************************************************************/
-// Helix data
-static HMP3Decoder   	helixDecoder;       // Helix MP3 decoder instance
-static MP3FrameInfo 	lastFrameInfo;      // MP3 frame info
+/*
+* @brief  Codec table adapters, see audio_codec_t. The stream selects the MP3Decoder_ or
+* 		  MP3Decoder_...Incoming function.
+*/
+static bool mp3Probe(const uint8_t * header, uint32_t length);
+static bool mp3Open(decoder_stream_t id, const char * filename);
+static decoder_result_t mp3DecodeFrame(decoder_stream_t id, short * buffer, uint32_t bufferSize, uint32_t * numSamples, int * sampleRate);
+static bool mp3GetChannels(decoder_stream_t id, uint8_t * channelCount);
+static bool mp3Seek(int32_t samples);
+static void mp3Close(decoder_stream_t id);
+static bool mp3GetTag(audio_tag_t tag, char ** value);
+static void mp3ShutDown(void);
 
 
-// MP3 file data
-static FIL 				mp3FileObject;		// MP3 file object
-static uint32_t      	fileSize;          	// Size of the file used
-static uint32_t      	remainingBytes;		// Encoded MP3 bytes remaining to be decoded
-static bool          	fileIsOpened;       // true if there is an open file, false if is not
-static uint32_t      	lastFrameLength;   	// Last frame length
+/*****************************************************************************
+ *  					VARIABLES WITH GLOBAL SCOPE
+ *****************************************************************************/
+const audio_codec_t mp3Codec =
+{
+	.name = "MP3",
+	.extension = ".mp3",
+	.worstCaseCycles = MP3_WORST_CASE_CYCLES,
+
+	.init = MP3Decoder_Init,
+	.probe = mp3Probe,
+	.open = mp3Open,
+	.decodeFrame = mp3DecodeFrame,
+	.getChannels = mp3GetChannels,
+	.seek = mp3Seek,
+	.getRemainingMs = MP3Decoder_GetRemainingMs,
+	.promote = MP3Decoder_PromoteIncoming,
+	.close = mp3Close,
+
+	.readAhead = MP3Decoder_ReadAhead,
+	.preOpen = MP3Decoder_PreOpen,
+	.preOpenStep = MP3Decoder_PreOpenStep,
+	.getTag = mp3GetTag,
+	.setCenterCancel = MP3Decoder_SetCenterCancel,
+	.shutDown = mp3ShutDown,
+};
 
 
-// MP3-encoded buffer data
-static uint8_t 		mp3FrameBuffer[NUMBER_BYTES_PER_FRAME] __attribute__((aligned(4)));
-static int32_t    	mp3BufferOut;  // Index of the next element to be read (first element in buffer)
-static int32_t     mp3BufferIn;   // Index of the next element to be loaded (after the last element in buffer)
+/*****************************************************************************
+ *  					VARIABLES WITH LOCAL SCOPE
+ *****************************************************************************/
+// Decoding streams, in the memory of the decoder layer: the playing song and, during a crossfade, the incoming one.
+// NULL while there is no file of ours on them
+static mp3Stream_t *	playing = NULL;			// The song being played
+static mp3Stream_t *	incoming = NULL;		// The next song, only open while crossfading
+static mp3Stream_t *	stream = NULL;			// Stream the functions below work on (playing but for the Incoming calls)
+static bool				centerCancel;			// true if the center channel (vocals) is removed
 
 
-// ID3 tag data
-static bool hasID3;								// True if the file has valid ID3 tag
-static char title[ID3_MAX_NUM_CHARS];         	// Title of the song
-static char artist[ID3_MAX_NUM_CHARS];        	// Artist of the song
-static char album[ID3_MAX_NUM_CHARS];         	// Album of the song
-static char trackNum[ID3_MAX_NUM_CHARS];      	// Number of the track inside the album of the song
-static char year[ID3_MAX_NUM_CHARS];          	// Year of the songs' album
+// Files opened ahead of time (next and previous songs)
+static mp3PreOpen_t	preOpen[MP3_PREOPEN_SLOTS];
 
 
 /*******************************************************************************
@@ -105,54 +303,72 @@ static char year[ID3_MAX_NUM_CHARS];          	// Year of the songs' album
  ******************************************************************************/
 void MP3Decoder_Init(void)
 {
-    helixDecoder = MP3InitDecoder();
-    fileIsOpened = false;
-    mp3BufferIn = 0;
-    mp3BufferOut = 0;
-    fileSize = 0;
-    remainingBytes = 0;
-    hasID3 = false;
+    centerCancel = false;
+
+    // Helix is started in the memory of each stream when a file is opened on it
+    playing = NULL;
+    incoming = NULL;
+    stream = NULL;
+    memset(preOpen, 0, sizeof(preOpen));
 }
 
 
 bool MP3Decoder_LoadFile(const char* filename)
 {
-    bool res = false;
-
     // If the file was already opened, close it, to open it again
-    if (fileIsOpened)
+    closeFile();
+
+    playing = takeStream(DECODER_PLAYING_STREAM);
+    stream = playing;
+
+    if (!loadFile(filename))
     {
-        // Close the file
-        f_close(&mp3FileObject);
-
-        // Reset pointers and variables
-        fileIsOpened = false;
-        mp3BufferIn = 0;
-        mp3BufferOut = 0;
-        fileSize = 0;
-        remainingBytes = 0;
-        hasID3 = false;
+    	// The memory goes back to the decoder layer
+    	playing = NULL;
+    	stream = NULL;
+    	return false;
     }
+    return true;
+}
 
-    // try to open the file an if it can modify the variables inside decoder.
-    if (openFile(filename))
-    {
-        fileIsOpened = true;
-        fileSize = mp3FileObjectSize();
 
-        // Initialize remainingBytes
-        remainingBytes = fileSize;
+void MP3Decoder_PreOpen(uint8_t slotIndex, const char* filename)
+{
+	if (slotIndex >= MP3_PREOPEN_SLOTS)
+	{
+		return;
+	}
 
-        // Read ID3 tag if it exits
-        readID3Tag();
+	mp3PreOpen_t* slot = &preOpen[slotIndex];
 
-        // Fill buffer with the first frame
-        fill_buffer_with_mp3_frame();
+	// Already there (or being opened)
+	if ((slot->step != PREOPEN_EMPTY) && (strcmp(slot->path, filename) == 0))
+	{
+		return;
+	}
 
-        res = true;
+	preOpenClose(slot);
 
-    }
-    return res;
+	if (strlen(filename) < MP3_PATH_SIZE)
+	{
+		strcpy(slot->path, filename);
+		slot->step = PREOPEN_PENDING;
+	}
+}
+
+
+bool MP3Decoder_PreOpenStep(void)
+{
+	for (uint8_t i = 0; i < MP3_PREOPEN_SLOTS; i++)
+	{
+		if ((preOpen[i].step != PREOPEN_EMPTY) && (preOpen[i].step != PREOPEN_READY))
+		{
+			preOpenAdvance(&preOpen[i]);
+			return true;
+		}
+	}
+
+	return false;
 }
 
 
@@ -167,112 +383,43 @@ decoder_result_t MP3Decoder_DecodeFrame	(short* decodedDataBuffer,
     *numSamplesDecoded = 0;
     *sampleRate = 0;
 
-    if (!fileIsOpened)
+    if (!stream || !stream->fileIsOpened)
     {
         res = DECODER_NO_FILE;
     }
 
     // If there are still bytes to decode
-    else if (remainingBytes)
+    else if (stream->remainingBytes)
     {
-        // Fill the frame buffer with new data
-    	// To do that, move the data again to the beginning
-    	//	From this:
-
-    	/*	Start     Output	Data	  Input     Space to read      End
-    	 * 											 new data
-    	 *
-    	 * 	|---------|O|-----------------|I|..........................|
-    	 *
-    	 *							(mp3FrameBuffer)
-    	 */
-
-    	// To this:
-
-    	/*	Start     Data    Input     	Space to read      		End
-    	 * 	Output								new data
-    	 *
-    	 * 	|O|----------------|I|....................................|
-    	 *
-    	 *							(mp3FrameBuffer)
-    	 */
-
-        if ((mp3BufferOut > 0) && ((mp3BufferIn - mp3BufferOut) > 0) && (mp3BufferIn - mp3BufferOut < NUMBER_BYTES_PER_FRAME))
-        {
-            memmove(mp3FrameBuffer, mp3FrameBuffer + mp3BufferOut, mp3BufferIn - mp3BufferOut);
-            mp3BufferIn = mp3BufferIn - mp3BufferOut;
-            mp3BufferOut = 0;
-        }
-
-        // Read data and store it in the buffer
-        fill_buffer_with_mp3_frame();
-
-    	/*	Start     Data    Input     	     					End
-    	 * 	Output
-    	 *
-    	 * 	|O|xxxxx-HEADER-DATA-HEADER-DATA-HEADER-DATA-....|I|......|
-    	 *
-    	 *							(mp3FrameBuffer)
-    	 */
-        // Search for the mp3 frame header in the buffer
-        int32_t offset = MP3FindSyncWord(mp3FrameBuffer + mp3BufferOut, mp3BufferIn);
-        if (offset >= 0)
-        {
-            mp3BufferOut += offset;
-            remainingBytes -= offset;
-        }
-
-        // If offset is negative, we should continue (maybe the SyncWord is in the next buffer)
-        // Bytes remaining is te variable that analizes this cases
-
-        MP3FrameInfo nextFrameInfo;
-
-        // Read the next frame information and check that the number of PCM
-        // samples do not exceed the
-        int err = MP3GetNextFrameInfo(helixDecoder, &nextFrameInfo, mp3FrameBuffer + mp3BufferOut);
-
-        if (err == NO_ERROR_INFO)
-        {
-        	// If no error, but the number of samples exceedes the output buffer, it is an error
-            if (nextFrameInfo.outputSamps > decodedBufferSize)
-            {
-                return DECODER_OVERFLOW;
-            }
-        }
-
-        // If there was an error, maybe the found SYNCWord was not a proper SYNCWord
-        // Continue reading to find the proper SYNCWord
-
-        uint8_t* mp3DataStart = mp3FrameBuffer + mp3BufferOut;
-        int bytesLeft = mp3BufferIn - mp3BufferOut;
-
-        // DECODE A MP3 FRAME (Finally, what we came here for!)
-        int res = MP3Decode(helixDecoder, &mp3DataStart, &(bytesLeft), decodedDataBuffer, DECODER_NORMAL_MODE);
-
-        if (res == ERR_MP3_NONE)
+    	int err;
+    	uint8_t frames = 0;
+
+    	// After a seek the first frames only fill the bit reservoir. Helix just copies their main
+    	// data and outputs silence, so they are decoded in the same call as the next real frame
+    	do
+    	{
+    		err = decodeNextFrame(decodedDataBuffer, decodedBufferSize);
+    	}
+    	while ((err == ERR_MP3_MAINDATA_UNDERFLOW) && (++frames <= MP3_MAX_PRIMING_FRAMES));
+
+        if (err == ERR_MP3_NONE)
         {
-        	//If no error
-
-            // Calculate the length of the mp3Frame that was decoded
-            uint32_t decodedBytes = mp3BufferIn - mp3BufferOut - bytesLeft;
-            lastFrameLength = decodedBytes;
-
-            // Update the mp3Buffer pointers
-            mp3BufferOut += decodedBytes;
-            remainingBytes -= decodedBytes;
-
             // Get the last frame info (should be the same info as before)
-            MP3GetLastFrameInfo(helixDecoder, &(lastFrameInfo));
+            MP3GetLastFrameInfo(stream->helixDecoder, &(stream->lastFrameInfo));
 
             // Return the number of PCM samples decoded
-            *numSamplesDecoded = lastFrameInfo.outputSamps;
-            *sampleRate = lastFrameInfo.samprate;
+            *numSamplesDecoded = stream->lastFrameInfo.outputSamps;
+            *sampleRate = stream->lastFrameInfo.samprate;
             res = DECODER_WORKED;
         }
+        else if (err == MP3_OUTPUT_TOO_SMALL)
+        {
+        	res = DECODER_OVERFLOW;
+        }
         else
         {
         	// We'll indicate that the file has ended
-			return DECODER_END_OF_FILE;
+        	res = DECODER_END_OF_FILE;
         }
     }
     else
@@ -289,9 +436,9 @@ bool MP3Decoder_GetLastFrameNumOfChannels(uint8_t* channelCount)
 {
     // we assume that there are no last frame.
     bool ret = false;
-    if (remainingBytes < fileSize)
+    if (stream && stream->decodedFrames)
     {
-        *channelCount = lastFrameInfo.nChans;
+        *channelCount = stream->lastFrameInfo.nChans;
         ret = true;
     }
     return ret;
@@ -300,38 +447,38 @@ bool MP3Decoder_GetLastFrameNumOfChannels(uint8_t* channelCount)
 
 void MP3Decoder_GetTagData(char* _title_, char* _album_, char* _artist_, char* _trackNum_, char* _year_)
 {
-    strcpy(album, _album_);
-    strcpy(artist, _artist_);
-    strcpy(title, _title_);
+    if (!stream)
+    {
+    	return;
+    }
+
+    strcpy(stream->track.album, _album_);
+    strcpy(stream->track.artist, _artist_);
+    strcpy(stream->track.title, _title_);
     for(uint8_t i = 0; i < ID3_MAX_NUM_CHARS; i++)
     {
-    	trackNum[i] = _trackNum_[i];
-    	year[i] = _year_[i];
+    	stream->track.trackNum[i] = _trackNum_[i];
+    	stream->track.year[i] = _year_[i];
     }
 }
 
 
 bool MP3Decoder_hasID3(void)
 {
-    return hasID3;
+    return stream && stream->track.hasID3;
 }
 
 
 bool MP3Decoder_shutDown(void)
 {
-	if (fileIsOpened)
-	{
-		// Close the file
-		f_close(&mp3FileObject);
-
-		// Reset pointers and variables
-		fileIsOpened = false;
-		mp3BufferIn = 0;
-		mp3BufferOut = 0;
-		fileSize = 0;
-		remainingBytes = 0;
-		hasID3 = false;
+	closeFile();
+	playing = NULL;
+	stream = NULL;
+	MP3Decoder_CloseIncoming();
 
+	for (uint8_t i = 0; i < MP3_PREOPEN_SLOTS; i++)
+	{
+		preOpenClose(&preOpen[i]);
 	}
 	return true;
 }
@@ -339,12 +486,12 @@ bool MP3Decoder_shutDown(void)
 
 bool MP3Decoder_getFileTitle(char ** title_)
 {
-    if(hasID3)
+    if(stream && stream->track.hasID3)
     {
         // Verify that the title is not Unknown
-        if ( strcmp(title,"Unknown") != 0)
+        if ( strcmp(stream->track.title,"Unknown") != 0)
         {
-            (*title_) = title;
+            (*title_) = stream->track.title;
             return true;
         }
     }
@@ -354,12 +501,12 @@ bool MP3Decoder_getFileTitle(char ** title_)
 
 bool MP3Decoder_getFileAlbum(char** album_)
 {
-	if(hasID3)
+	if(stream && stream->track.hasID3)
     {
         // Verify that the album is not Unknown
-        if ( strcmp(album,"Unknown") != 0)
+        if ( strcmp(stream->track.album,"Unknown") != 0)
         {
-            (*album_) = album;
+            (*album_) = stream->track.album;
             return true;
         }
     }
@@ -369,12 +516,12 @@ bool MP3Decoder_getFileAlbum(char** album_)
 
 bool MP3Decoder_getFileArtist(char** artist_)
 {
-	if(hasID3)
+	if(stream && stream->track.hasID3)
     {
         // Verify that the artist is not Unknown
-        if (strcmp(artist, "Unknown") != 0)
+        if (strcmp(stream->track.artist, "Unknown") != 0)
         {
-            (*artist_) = artist;
+            (*artist_) = stream->track.artist;
             return true;
         }
     }
@@ -384,12 +531,12 @@ bool MP3Decoder_getFileArtist(char** artist_)
 
 bool MP3Decoder_getFileYear(char** year_)
 {
-	if(hasID3)
+	if(stream && stream->track.hasID3)
     {
         // Verify that the year is not Unknown
-        if ( strcmp(year,"Unknown") != 0)
+        if ( strcmp(stream->track.year,"Unknown") != 0)
         {
-            (*year_) = year;
+            (*year_) = stream->track.year;
             return true;
         }
     }
@@ -399,12 +546,12 @@ bool MP3Decoder_getFileYear(char** year_)
 
 bool MP3Decoder_getFileTrackNum(char** trackNum_)
 {
-	if(hasID3)
+	if(stream && stream->track.hasID3)
     {
         // Verify that the trackNum is not Unknown
-        if ( strcmp(trackNum,"Unknown") != 0)
+        if ( strcmp(stream->track.trackNum,"Unknown") != 0)
         {
-            (*trackNum_) = trackNum;
+            (*trackNum_) = stream->track.trackNum;
             return true;
         }
     }
@@ -412,164 +559,754 @@ bool MP3Decoder_getFileTrackNum(char** trackNum_)
 }
 
 
-void MP3Decoded_rewindFile(void)
+void MP3Decoder_SetCenterCancel(bool enable)
 {
-	FSIZE_t currentFilePointer = f_tell(&mp3FileObject);
-	currentFilePointer -= lastFrameLength;
-	remainingBytes += lastFrameLength;
+	centerCancel = enable;
 
-	// Check that rewind does not go out of range
-	if (fileSize - remainingBytes < 0)
+	// Those without a file are set when one is opened
+	if (playing)
 	{
-		// If that is the case, return to the beginning
-		f_lseek(&mp3FileObject, 0);
+		MP3SetCenterCancel(playing->helixDecoder, centerCancel);
 	}
-	else
+	if (incoming)
 	{
-		f_lseek(&mp3FileObject, currentFilePointer);
+		MP3SetCenterCancel(incoming->helixDecoder, centerCancel);
 	}
 }
 
 
-void MP3Decoded_fastForwardFile(void)
+bool MP3Decoder_GetCenterCancel(void)
 {
-	FSIZE_t currentFilePointer = f_tell(&mp3FileObject);
-	currentFilePointer += lastFrameLength;	// An approximate of next frame
-	remainingBytes -= lastFrameLength;
+	return centerCancel;
+}
+
+
+bool MP3Decoder_ReadAhead(void)
+{
+	bool res = false;
+
+	if (stream && stream->fileIsOpened)
+	{
+		res = (readAheadFill(MP3_READAHEAD_CHUNK) != 0);
+	}
+
+	// Then the song fading in, if any
+	if (!res && incoming && incoming->fileIsOpened)
+	{
+		stream = incoming;
+		res = (readAheadFill(MP3_READAHEAD_CHUNK) != 0);
+		stream = playing;
+	}
+	return res;
+}
+
+
+uint32_t MP3Decoder_GetReadAheadLevel(void)
+{
+	return stream ? (stream->mp3BufferIn - stream->mp3BufferOut) : 0;
+}
+
+
+uint32_t MP3Decoder_GetReadAheadStalls(void)
+{
+	return stream ? stream->readAheadStalls : 0;
+}
+
+
+bool MP3Decoder_SkipFrames(int32_t frames)
+{
+	if (!stream || !stream->fileIsOpened)
+	{
+		return false;
+	}
 
-	// Check that fast forward does not go out of range
-	if (remainingBytes < 0)
+	// Frame lengths only change with the bitrate, the average so far is a good guess (VBR included)
+	uint32_t frameBytes = stream->decodedFrames ? (stream->decodedFrameBytes / stream->decodedFrames) : stream->lastFrameLength;
+	int32_t skipBytes = frames * (int32_t)frameBytes;
+	uint32_t position = stream->track.audioEnd - stream->remainingBytes;
+
+	if ((skipBytes >= 0) && ((uint32_t)skipBytes >= stream->remainingBytes))
+	{
+		// Past the end, the song is over
+		stream->remainingBytes = 0;
+		return false;
+	}
+
+	if ((skipBytes < 0) && ((uint32_t)(-skipBytes) > position - stream->track.audioStart))
+	{
+		// Not before the first frame
+		skipBytes = -(int32_t)(position - stream->track.audioStart);
+	}
+
+	stream->remainingBytes -= skipBytes;
+	stream->mp3Resync = true;
+
+	if ((skipBytes >= 0) && ((uint32_t)skipBytes + MP3_MAX_FRAME_BYTES <= stream->mp3BufferIn - stream->mp3BufferOut))
 	{
-		// If that is the case, go to the end
-		f_lseek(&mp3FileObject, f_size(&mp3FileObject));
+		// Still in the read-ahead, no need to touch the file
+		stream->mp3BufferOut += skipBytes;
 	}
 	else
 	{
-		f_lseek(&mp3FileObject, currentFilePointer);
+		seekAligned(position + skipBytes);
+	}
+
+	// The reservoir belongs to the old position, the next frames will fill it again
+	MP3ClearReservoir(stream->helixDecoder);
+
+	return true;
+}
+
+
+uint32_t MP3Decoder_GetRemainingMs(void)
+{
+	if (!stream)
+	{
+		return UINT32_MAX;
+	}
+
+	uint32_t frameBytes = stream->decodedFrames ? (stream->decodedFrameBytes / stream->decodedFrames) : 0;
+	uint8_t channels = stream->lastFrameInfo.nChans;
+
+	if (!stream->fileIsOpened || !frameBytes || !channels || !stream->lastFrameInfo.samprate)
+	{
+		// Nothing decoded yet, can't tell
+		return UINT32_MAX;
 	}
+
+	uint64_t samples = (uint64_t)(stream->remainingBytes / frameBytes) * (stream->lastFrameInfo.outputSamps / channels);
+	return (uint32_t)(samples * 1000U / stream->lastFrameInfo.samprate);
+}
+
+
+bool MP3Decoder_LoadIncomingFile(const char* filename)
+{
+	MP3Decoder_CloseIncoming();
+
+	incoming = takeStream(DECODER_INCOMING_STREAM);
+	stream = incoming;
+	bool res = loadFile(filename);
+	stream = playing;
+
+	if (!res)
+	{
+		// The memory goes back to the decoder layer
+		incoming = NULL;
+	}
+	return res;
+}
+
+
+decoder_result_t MP3Decoder_DecodeIncomingFrame	(short* decodedDataBuffer,
+												uint32_t decodedBufferSize,
+												uint32_t* numSamplesDecoded,
+												int* sampleRate)
+{
+	stream = incoming;
+	decoder_result_t res = MP3Decoder_DecodeFrame(decodedDataBuffer, decodedBufferSize, numSamplesDecoded, sampleRate);
+	stream = playing;
+
+	return res;
+}
+
+
+bool MP3Decoder_GetIncomingFrameNumOfChannels(uint8_t* channelCount)
+{
+	stream = incoming;
+	bool res = MP3Decoder_GetLastFrameNumOfChannels(channelCount);
+	stream = playing;
+
+	return res;
+}
+
+
+bool MP3Decoder_PromoteIncoming(void)
+{
+	if (!incoming || !incoming->fileIsOpened)
+	{
+		return false;
+	}
+
+	// The outgoing song is over, its memory is free for the next crossfade (AudioDecoder_PromoteIncoming)
+	closeFile();
+
+	playing = incoming;
+	incoming = NULL;
+	stream = playing;
+
+	return true;
+}
+
+
+void MP3Decoder_CloseIncoming(void)
+{
+	stream = incoming;
+	closeFile();
+	incoming = NULL;
+	stream = playing;
 }
 
 
 /*******************************************************************************
                         LOCAL FUNCTION DEFINITIONS
  ******************************************************************************/
-static bool openFile(const char* filename)
+static mp3Stream_t * takeStream(decoder_stream_t id)
 {
-    FRESULT fr = f_open(&mp3FileObject, _T(filename), FA_READ);
-    if (fr == FR_OK)
-        return true;
-    return false;
+	mp3Stream_t * memory = AudioDecoder_GetStreamMemory(id);
+
+	// Another codec may have used it, nothing in it is valid
+	memset(memory, 0, sizeof(mp3Stream_t));
+	memory->mp3Ring = memory->mp3FrameBuffer + MP3_BUFFER_GUARD_SIZE;
+
+	memory->helixDecoder = MP3InitDecoder(memory->helixState, AudioDecoder_GetScratch());
+	MP3SetCenterCancel(memory->helixDecoder, centerCancel);
+
+	return memory;
 }
 
 
-static void readID3Tag(void)
+static bool loadFile(const char* filename)
 {
-    // Checks if the file has an ID3 Tag. (ID3 library)
-    if (has_ID3_tag(&mp3FileObject))
-    {
-        hasID3 = true;
+    bool res = false;
+    mp3PreOpen_t* slot = NULL;
 
-        if (!read_ID3_info(TITLE_ID3, title, ID3_MAX_NUM_CHARS, &mp3FileObject))
-            strcpy(title, DEFAULT_ID3);
+    // Check if the file was opened ahead of time
+    for (uint8_t i = 0; i < MP3_PREOPEN_SLOTS; i++)
+    {
+    	if ((preOpen[i].step != PREOPEN_EMPTY) && (strcmp(preOpen[i].path, filename) == 0))
+    	{
+    		slot = &preOpen[i];
+    	}
+    }
 
-        if (!read_ID3_info(ALBUM_ID3, album, ID3_MAX_NUM_CHARS, &mp3FileObject))
-            strcpy(album, DEFAULT_ID3);
+    if (slot)
+    {
+    	// Finish what the background did not get to
+    	while ((slot->step != PREOPEN_READY) && (slot->step != PREOPEN_EMPTY))
+    	{
+    		preOpenAdvance(slot);
+    	}
+    }
 
-        if (!read_ID3_info(ARTIST_ID3, artist, ID3_MAX_NUM_CHARS, &mp3FileObject))
-            strcpy(artist, DEFAULT_ID3);
+    if (slot && (slot->step == PREOPEN_READY))
+    {
+    	// Take the file over, no f_open, no tags and no SD read: the first frames are in RAM
+    	stream->mp3FileObject = slot->file;
+    	stream->track = slot->info;
+
+    	memcpy(stream->mp3Ring, slot->data, slot->dataLength);
+    	stream->mp3BufferIn = slot->dataLength;
+    	stream->mp3BufferOut = stream->track.audioStart & (FILE_SECTOR_SIZE - 1);
+    	stream->mp3GuardWrap = 0;
+    	stream->mp3FileEnded = (slot->dataLength < sizeof(slot->data));
+
+    	// The FIL belongs to the decoder now
+    	slot->step = PREOPEN_EMPTY;
+    	slot->path[0] = 0;
+
+    	stream->fileIsOpened = true;
+    	res = true;
+    }
 
-        if (!read_ID3_info(YEAR_ID3, (char *)year, ID3_MAX_NUM_CHARS, &mp3FileObject))
-            strcpy(year, (char*)DEFAULT_ID3);
+    // try to open the file an if it can modify the variables inside decoder.
+    else if (openFile(filename))
+    {
+        stream->fileIsOpened = true;
 
-        if (!read_ID3_info(TRACK_NUM_ID3, (char *)trackNum, ID3_MAX_NUM_CHARS, &mp3FileObject))
-            strcpy(trackNum, (char*)DEFAULT_ID3);
+        // Read ID3 tag if it exits
+        readID3Tag(&stream->mp3FileObject, &stream->track);
 
-        unsigned int tagSize = get_ID3_size(&mp3FileObject);
+        // Fill buffer from the start of the audio data
+        seekAligned(stream->track.audioStart);
 
-        // Position the internal file pointer where the data starts
-        f_lseek(&mp3FileObject, tagSize);
-        remainingBytes -= tagSize;
+        res = true;
     }
-    else
+
+    if (res)
     {
-    	// Position the internal file pointer where the data starts (the beginning)
-        f_rewind(&mp3FileObject);
+    	stream->remainingBytes = stream->track.audioEnd - stream->track.audioStart;
+    	stream->decodedFrames = 0;
+    	stream->decodedFrameBytes = 0;
+    	stream->mp3Resync = false;
+
+    	// Nothing from the previous song in the bit reservoir
+    	MP3ClearReservoir(stream->helixDecoder);
     }
+
+    return res;
+}
+
+
+static void closeFile(void)
+{
+	if (!stream)
+	{
+		return;
+	}
+
+	if (stream->fileIsOpened)
+	{
+		f_close(&stream->mp3FileObject);
+	}
+
+	// Reset pointers and variables
+	stream->fileIsOpened = false;
+	stream->mp3BufferIn = 0;
+	stream->mp3BufferOut = 0;
+	stream->mp3FileEnded = false;
+	stream->track.fileSize = 0;
+	stream->remainingBytes = 0;
+	stream->track.hasID3 = false;
+	stream->decodedFrames = 0;
+	stream->decodedFrameBytes = 0;
+}
+
+
+static bool openFile(const char* filename)
+{
+    FRESULT fr = f_open(&stream->mp3FileObject, _T(filename), FA_READ);
+    if (fr == FR_OK)
+        return true;
+    return false;
 }
 
 
-static uint32_t mp3FileObjectSize()
+static void readID3Tag(FIL* file, mp3TrackInfo_t* info)
 {
-    uint32_t size = 0;
-    if (fileIsOpened)
+    char * fields[ID3_NUM_FIELDS] = {NULL};
+    unsigned int tagSize;
+    unsigned int trailerSize;
+
+    fields[TITLE_ID3] = info->title;
+    fields[ALBUM_ID3] = info->album;
+    fields[ARTIST_ID3] = info->artist;
+    fields[YEAR_ID3] = (char *)info->year;
+    fields[TRACK_NUM_ID3] = (char *)info->trackNum;
+    fields[REPLAYGAIN_GAIN_ID3] = info->replayGain;
+    fields[REPLAYGAIN_PEAK_ID3] = info->replayGainPeak;
+
+    info->fileSize = f_size(file);
+    info->audioStart = 0;
+    info->audioEnd = info->fileSize;
+    info->hasID3 = false;
+
+    // Reads every field in one pass over the tag (ID3 library)
+    unsigned int found = read_ID3_tags(fields, ID3_MAX_NUM_CHARS, &tagSize, file);
+
+    // The missing fields may be in the APE/ID3v1 tags at the end, read in one go
+    found = read_ID3_trailer(fields, ID3_MAX_NUM_CHARS, found, &trailerSize, file);
+
+    // The trailing tags are not audio, the decoder stops before them
+    if (trailerSize < info->fileSize)
+    {
+    	info->audioEnd -= trailerSize;
+    }
+
+    // Checks if the file has any tag
+    if (tagSize || found)
     {
-        size = f_size(&mp3FileObject);
+        info->hasID3 = true;
+
+        for (uint8_t i = 0; i < ID3_NUM_FIELDS; i++)
+        {
+        	if (fields[i] && !(found & (1 << i)))
+        	{
+        		strcpy(fields[i], DEFAULT_ID3);
+        	}
+        }
+
+        // The data starts after the tag, the buffer is positioned there by seekAligned
+        info->audioStart = (tagSize < info->audioEnd) ? tagSize : info->audioEnd;
     }
-    return size;
 }
 
 
-static void fill_buffer_with_mp3_frame(void)
+static void preOpenAdvance(mp3PreOpen_t* slot)
+{
+	switch (slot->step)
+	{
+		case PREOPEN_PENDING:
+			// The directory walk, usually the slowest part
+			slot->step = (f_open(&slot->file, _T(slot->path), FA_READ) == FR_OK) ? PREOPEN_OPENED : PREOPEN_EMPTY;
+			break;
+
+		case PREOPEN_OPENED:
+			readID3Tag(&slot->file, &slot->info);
+			slot->step = PREOPEN_TAGGED;
+			break;
+
+		case PREOPEN_TAGGED:
+		{
+			// Same sector alignment as seekAligned, so the data can go straight to the ring
+			UINT bytesRead = 0;
+			f_lseek(&slot->file, slot->info.audioStart & ~(FILE_SECTOR_SIZE - 1));
+			f_read(&slot->file, slot->data, sizeof(slot->data), &bytesRead);
+			slot->dataLength = bytesRead;
+			slot->step = PREOPEN_READY;
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+
+static void preOpenClose(mp3PreOpen_t* slot)
+{
+	if ((slot->step != PREOPEN_EMPTY) && (slot->step != PREOPEN_PENDING))
+	{
+		f_close(&slot->file);
+	}
+	slot->step = PREOPEN_EMPTY;
+	slot->path[0] = 0;
+}
+
+
+static uint8_t * fill_buffer_with_mp3_frame(int32_t * bytesAvailable)
 {
-	/*	Start     Output	Data   Input     Space to read      End
-	 * 											new data
+	// If the read-ahead ran dry, read synchronously (this is the SD stall the FIFO should hide)
+	if ((stream->mp3BufferIn - stream->mp3BufferOut < MP3_MAX_FRAME_BYTES) && !stream->mp3FileEnded)
+	{
+		stream->readAheadStalls++;
+		readAheadFill(MP3_BUFFER_RING_SIZE);
+	}
+
+	int32_t available = stream->mp3BufferIn - stream->mp3BufferOut;
+	uint32_t ringIndex = stream->mp3BufferOut % MP3_BUFFER_RING_SIZE;
+	int32_t toWrap = MP3_BUFFER_RING_SIZE - ringIndex;
+
+	*bytesAvailable = available;
+
+	if (available <= 0)
+	{
+		return NULL;
+	}
+
+	if ((available <= toWrap) || (toWrap >= MP3_MAX_FRAME_BYTES))
+	{
+		// The next frame does not cross the end of the ring
+		if (available > toWrap)
+		{
+			*bytesAvailable = toWrap;
+		}
+		return &stream->mp3Ring[ringIndex];
+	}
+
+	// Near the wrap, the next frame may still fit before it. Check its header to avoid stitching it
+	int32_t sync = MP3FindSyncWord(&stream->mp3Ring[ringIndex], toWrap);
+	if ((sync >= 0) && (sync + 4 <= toWrap))
+	{
+		uint32_t frameLength = mp3FrameLength(&stream->mp3Ring[ringIndex + sync]);
+
+		if (frameLength && (sync + frameLength <= toWrap))
+		{
+			*bytesAvailable = toWrap;
+			return &stream->mp3Ring[ringIndex];
+		}
+	}
+
+	/*	Start     Output    Ring start                                  End
 	 *
-	 * 	|---------|O|--------------|I|............................|
+	 * 	|.........|O|-toWrap-|-----------------|I|..............|-toWrap-|
 	 *
 	 *							(mp3FrameBuffer)
 	 */
+	if (stream->mp3GuardWrap != stream->mp3BufferOut + toWrap)
+	{
+		// Copy the tail only once per wrap, later frames before the wrap are already there
+		memcpy(stream->mp3Ring - toWrap, &stream->mp3Ring[ringIndex], toWrap);
+		stream->mp3GuardWrap = stream->mp3BufferOut + toWrap;
+	}
+
+	return stream->mp3Ring - toWrap;
+}
+
+
+static int decodeNextFrame(short* decodedDataBuffer, uint32_t decodedBufferSize)
+{
+	// Make sure there is a whole frame contiguous in the buffer
+	int32_t bytesAvailable;
+	uint8_t* mp3DataStart = fill_buffer_with_mp3_frame(&bytesAvailable);
+
+	// Never hand the trailing tags to Helix
+	if ((bytesAvailable > 0) && ((uint32_t)bytesAvailable > stream->remainingBytes))
+	{
+		bytesAvailable = stream->remainingBytes;
+	}
+
+	if (bytesAvailable <= 0)
+	{
+		return ERR_MP3_INDATA_UNDERFLOW;
+	}
+
+	// Search for the mp3 frame header in the buffer
+	int32_t offset = MP3FindSyncWord(mp3DataStart, bytesAvailable);
+
+	// After a seek we may be in the middle of a frame, a sync word only counts if the next frame follows it
+	while (stream->mp3Resync && (offset >= 0) && (offset + 4 <= bytesAvailable))
+	{
+		uint32_t frameLength = mp3FrameLength(&mp3DataStart[offset]);
+
+		if (frameLength && ((offset + frameLength + 2) > bytesAvailable))
+		{
+			// Can't check it, take it
+			break;
+		}
+		if (frameLength && (mp3DataStart[offset + frameLength] == 0xFF) && ((mp3DataStart[offset + frameLength + 1] & 0xE0) == 0xE0))
+		{
+			break;
+		}
+
+		int32_t next = MP3FindSyncWord(&mp3DataStart[offset + 1], bytesAvailable - offset - 1);
+		offset = (next >= 0) ? (offset + 1 + next) : -1;
+	}
+	stream->mp3Resync = false;
+
+	if (offset >= 0)
+	{
+		stream->mp3BufferOut += offset;
+		stream->remainingBytes -= offset;
+		mp3DataStart += offset;
+		bytesAvailable -= offset;
+	}
+
+	// If offset is negative, we should continue (maybe the SyncWord is in the next buffer)
+	// Bytes remaining is te variable that analizes this cases
+
+	MP3FrameInfo nextFrameInfo;
+
+	// Read the next frame information and check that the number of PCM
+	// samples do not exceed the
+	int err = MP3GetNextFrameInfo(stream->helixDecoder, &nextFrameInfo, mp3DataStart);
 
-    // Fill the remaining buffer space with the new mp3 data
-    uint16_t bytesRead;
+	// If no error, but the number of samples exceedes the output buffer, it is an error
+	if ((err == NO_ERROR_INFO) && (nextFrameInfo.outputSamps > decodedBufferSize))
+	{
+		return MP3_OUTPUT_TOO_SMALL;
+	}
+
+	// If there was an error, maybe the found SYNCWord was not a proper SYNCWord
+	// Continue reading to find the proper SYNCWord
+
+	int bytesLeft = bytesAvailable;
+
+	// DECODE A MP3 FRAME (Finally, what we came here for!)
+	err = MP3Decode(stream->helixDecoder, &mp3DataStart, &(bytesLeft), decodedDataBuffer, DECODER_NORMAL_MODE);
+
+	if ((err == ERR_MP3_NONE) || (err == ERR_MP3_MAINDATA_UNDERFLOW))
+	{
+		// Calculate the length of the mp3Frame that was decoded
+		uint32_t decodedBytes = bytesAvailable - bytesLeft;
+		stream->lastFrameLength = decodedBytes;
 
-    uint8_t* free_space = &mp3FrameBuffer[mp3BufferIn];
+		// Update the mp3Buffer pointers
+		stream->mp3BufferOut += decodedBytes;
+		stream->remainingBytes -= decodedBytes;
 
-    // Read from mp3BufferIn to the end of the buffer or until there's no more data
-    bytesRead = readMp3Data(free_space, (NUMBER_BYTES_PER_FRAME - mp3BufferIn));
+		stream->decodedFrames++;
+		stream->decodedFrameBytes += decodedBytes;
+	}
 
-    // Update Input Index (if bytesRead == NUMBER_BYTES_PER_FRAME - mp3BufferIn - 1)
-    // Then mp3BufferIn will point just outside the buffer
-    mp3BufferIn += bytesRead;
+	return err;
 }
 
 
-static uint32_t readMp3Data(void* buffer, uint32_t bytes_to_read)
+static uint32_t mp3FrameLength(const uint8_t * header)
 {
-	uint32_t total_bytes_read = 0;
-	uint32_t bytes_read;
-    uint32_t i;
+	// Layer III only, indexed by the bitrate index of the header (kbps)
+	static const uint16_t bitrateMpeg1[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+	static const uint16_t bitrateMpeg2[15] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+	static const uint16_t samplerateMpeg1[3] = {44100, 48000, 32000};
+
+	uint8_t version = (header[1] >> 3) & 0x03;		// 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+	uint8_t layer = (header[1] >> 1) & 0x03;		// 1: Layer III
+	uint8_t bitrateIndex = (header[2] >> 4) & 0x0F;
+	uint8_t samplerateIndex = (header[2] >> 2) & 0x03;
+	uint8_t padding = (header[2] >> 1) & 0x01;
+
+	if ((header[0] != 0xFF) || ((header[1] & 0xE0) != 0xE0) || (version == 1) || (layer != 1) ||
+		(bitrateIndex == 0) || (bitrateIndex == 15) || (samplerateIndex == 3))
+	{
+		return 0;
+	}
 
-    char * auxBufferPointer = buffer;
+	if (version == 3)
+	{
+		return 144000U * bitrateMpeg1[bitrateIndex] / samplerateMpeg1[samplerateIndex] + padding;
+	}
 
-    FRESULT fr;
+	// MPEG2 halves the sample rate and MPEG2.5 quarters it, both with half the samples per frame
+	uint32_t samplerate = samplerateMpeg1[samplerateIndex] >> ((version == 2) ? 1 : 2);
+	return 72000U * bitrateMpeg2[bitrateIndex] / samplerate + padding;
+}
 
-    // Read per multiples of BYTES_PER_READ_OPERATION
-    for(i = 0; i < bytes_to_read / BYTES_PER_READ_OPERATION; i++)
-    {
-    	fr = f_read(&mp3FileObject, auxBufferPointer, BYTES_PER_READ_OPERATION, &bytes_read);
-    	if (fr != FR_OK)
-    	     break;
 
-    	// Update buffer pointer
-    	auxBufferPointer += BYTES_PER_READ_OPERATION;
+static uint32_t readAheadFill(uint32_t maxBytes)
+{
+	uint32_t totalBytesRead = 0;
 
-    	// Update total number of bytes read
-    	total_bytes_read += bytes_read;
-    }
+	while (!stream->mp3FileEnded && (totalBytesRead < maxBytes))
+	{
+		// Whole sectors only, from In to the first of: consumed data, end of the ring, maxBytes
+		uint32_t ringIndex = stream->mp3BufferIn % MP3_BUFFER_RING_SIZE;
+		uint32_t bytesToRead = MP3_BUFFER_RING_SIZE - (stream->mp3BufferIn - stream->mp3BufferOut);
+
+		if (bytesToRead > MP3_BUFFER_RING_SIZE - ringIndex)
+		{
+			bytesToRead = MP3_BUFFER_RING_SIZE - ringIndex;
+		}
+		if (bytesToRead > maxBytes - totalBytesRead)
+		{
+			bytesToRead = maxBytes - totalBytesRead;
+		}
+		bytesToRead &= ~(FILE_SECTOR_SIZE - 1);
+
+		if (bytesToRead == 0)
+		{
+			break;
+		}
+
+		uint32_t bytesRead = readMp3Data(&stream->mp3Ring[ringIndex], bytesToRead);
+
+		stream->mp3BufferIn += bytesRead;
+		totalBytesRead += bytesRead;
+		stream->mp3FileEnded = (bytesRead < bytesToRead);
+	}
 
-    i = bytes_to_read % BYTES_PER_READ_OPERATION;
+	return totalBytesRead;
+}
 
-    // If there are still bytes to read (bytes_to_read is not multiple of
-    // BYTES_PER_READ_OPERATION
-    if(fr == FR_OK && i != 0)
-    {
-    	fr = f_read(&mp3FileObject, auxBufferPointer, i, &bytes_read);
-    	if (fr == FR_OK)
-    		total_bytes_read += bytes_read;
-    }
+
+static void seekAligned(uint32_t filePosition)
+{
+	uint32_t sectorStart = filePosition & ~(FILE_SECTOR_SIZE - 1);
+
+	f_lseek(&stream->mp3FileObject, sectorStart);
+
+	// The bytes of the first sector before filePosition are read but skipped
+	stream->mp3BufferIn = 0;
+	stream->mp3BufferOut = filePosition - sectorStart;
+	stream->mp3GuardWrap = 0;
+	stream->mp3FileEnded = false;
+
+	// Enough for the first frames, MP3Decoder_ReadAhead fills the rest in the background
+	readAheadFill(MP3_READAHEAD_CHUNK);
+}
+
+
+static uint32_t readMp3Data(void* buffer, uint32_t bytes_to_read)
+{
+	UINT bytes_read = 0;
+
+	// Whole aligned sectors: FatFs reads them directly into buffer, without its window copy
+	FRESULT fr = f_read(&stream->mp3FileObject, buffer, bytes_to_read, &bytes_read);
 
     // Return the number of bytes read
-    return fr == FR_OK ? total_bytes_read : 0;
+    return fr == FR_OK ? bytes_read : 0;
+}
+
+
+static bool mp3Probe(const uint8_t * header, uint32_t length)
+{
+	// An ID3v2 tag (only MP3 files have them) or the header of the first frame
+	if ((length >= 3) && (memcmp(header, "ID3", 3) == 0))
+	{
+		return true;
+	}
+	return (length >= 4) && (mp3FrameLength(header) != 0);
+}
+
+
+static bool mp3Open(decoder_stream_t id, const char * filename)
+{
+	return (id == DECODER_PLAYING_STREAM) ? MP3Decoder_LoadFile(filename) : MP3Decoder_LoadIncomingFile(filename);
+}
+
+
+static decoder_result_t mp3DecodeFrame(decoder_stream_t id, short * buffer, uint32_t bufferSize, uint32_t * numSamples, int * sampleRate)
+{
+	return (id == DECODER_PLAYING_STREAM) ? MP3Decoder_DecodeFrame(buffer, bufferSize, numSamples, sampleRate) :
+											MP3Decoder_DecodeIncomingFrame(buffer, bufferSize, numSamples, sampleRate);
 }
 
 
+static bool mp3GetChannels(decoder_stream_t id, uint8_t * channelCount)
+{
+	return (id == DECODER_PLAYING_STREAM) ? MP3Decoder_GetLastFrameNumOfChannels(channelCount) :
+											MP3Decoder_GetIncomingFrameNumOfChannels(channelCount);
+}
+
+
+static bool mp3Seek(int32_t samples)
+{
+	// 1152 samples per frame for MPEG1, 576 for MPEG2/2.5
+	uint32_t frameSamples = MP3_DEFAULT_FRAME_SAMPLES;
+
+	if (!playing)
+	{
+		return false;
+	}
+
+	if (playing->decodedFrames && playing->lastFrameInfo.nChans)
+	{
+		frameSamples = playing->lastFrameInfo.outputSamps / playing->lastFrameInfo.nChans;
+	}
+
+	return MP3Decoder_SkipFrames(samples / (int32_t)frameSamples);
+}
+
+
+static void mp3Close(decoder_stream_t id)
+{
+	if (id == DECODER_PLAYING_STREAM)
+	{
+		closeFile();
+		playing = NULL;
+		stream = NULL;
+	}
+	else
+	{
+		MP3Decoder_CloseIncoming();
+	}
+}
+
+
+static bool mp3GetTag(audio_tag_t tag, char ** value)
+{
+	if (!playing)
+	{
+		return false;
+	}
+
+	switch (tag)
+	{
+		case AUDIO_TAG_TITLE:		return MP3Decoder_getFileTitle(value);
+		case AUDIO_TAG_ARTIST:		return MP3Decoder_getFileArtist(value);
+		case AUDIO_TAG_ALBUM:		return MP3Decoder_getFileAlbum(value);
+		case AUDIO_TAG_YEAR:		return MP3Decoder_getFileYear(value);
+		case AUDIO_TAG_TRACK_NUM:	return MP3Decoder_getFileTrackNum(value);
+
+		// Only read, never shown: no getter of their own
+		case AUDIO_TAG_REPLAYGAIN_GAIN:
+		case AUDIO_TAG_REPLAYGAIN_PEAK:
+		{
+			char * text = (tag == AUDIO_TAG_REPLAYGAIN_GAIN) ? stream->track.replayGain : stream->track.replayGainPeak;
+
+			if (stream->track.hasID3 && (strcmp(text, DEFAULT_ID3) != 0))
+			{
+				*value = text;
+				return true;
+			}
+			return false;
+		}
+
+		default:					return false;
+	}
+}
+
+
+static void mp3ShutDown(void)
+{
+	MP3Decoder_shutDown();
+}
@@ -15,6 +15,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "audio_decoder.h"
+
 
 /*******************************************************************************
 *				  CONSTANT AND MACRO DEFINITIONS USING #DEFINE
@@ -24,19 +26,28 @@
 
 #define DECODED_BUFFER_SIZE 5000
 
+// Compressed data kept buffered ahead of the decoder (KB, power of 2). SD stalls shorter than
+// this (~30 ms per KB at 128 kbps) do not reach the audio path.
+#ifndef MP3_READAHEAD_KB
+#define MP3_READAHEAD_KB	8
+#endif
+
+// Files that can be opened ahead of time (next and previous songs)
+#define MP3_PREOPEN_SLOTS	2
+
 /*******************************************************************************
  *					ENUMERATIONS, STRUCTURES AND TYPEDEFS
  ******************************************************************************/
 
-typedef enum
-{
-	DECODER_WORKED,
-	DECODER_ERROR,
-	DECODER_FRAME_NOT_VALID,
-	DECODER_NO_FILE,
-	DECODER_END_OF_FILE,
-	DECODER_OVERFLOW
-} decoder_result_t;
+// decoder_result_t is in audio_decoder.h, shared by every codec
+
+
+/*******************************************************************************
+ *					VARIABLE PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+// MP3 entry of the codec table (audio_decoder.c)
+extern const audio_codec_t mp3Codec;
 
 
 /*******************************************************************************
@@ -145,4 +156,115 @@ bool MP3Decoder_getFileYear(char** year_);
 bool MP3Decoder_getFileTrackNum(char** trackNum_);
 
 
+/**
+ * @brief: Background read of the current file into the read-ahead FIFO. Reads a few whole
+ *         sectors per call, to be called from the main loop when there is spare time.
+ * @return: true if something was read, false if the FIFO is full or the file ended.
+ */
+bool MP3Decoder_ReadAhead(void);
+
+
+/**
+ * @brief: Sets a file to be opened ahead of time. The work is done by MP3Decoder_PreOpenStep,
+ *         and MP3Decoder_LoadFile takes the file over if it is asked for the same path.
+ * @param slot: slot to use, less than MP3_PREOPEN_SLOTS. The file it had is closed.
+ * @param filename: path of the file.
+ */
+void MP3Decoder_PreOpen(uint8_t slot, const char* filename);
+
+
+/**
+ * @brief: Does one step of the pending pre-opens (f_open, tags or the first sectors of audio),
+ *         to be called from the main loop when there is spare time.
+ * @return: true if there was something to do.
+ */
+bool MP3Decoder_PreOpenStep(void);
+
+
+/**
+ * @brief: Gets the number of compressed bytes buffered ahead of the decoder.
+ * @return: bytes in the read-ahead FIFO.
+ */
+uint32_t MP3Decoder_GetReadAheadLevel(void);
+
+
+/**
+ * @brief: Gets the number of times the decoder found the read-ahead empty and had to read the file.
+ * @return: number of stalls since MP3Decoder_Init.
+ */
+uint32_t MP3Decoder_GetReadAheadStalls(void);
+
+
+/**
+ * @brief: Moves the decoding position by a number of frames (forward or backwards), from the
+ *         average frame length. The next decode resyncs on a verified frame header and primes
+ *         the bit reservoir, so it costs about one frame decode.
+ * @param frames: number of frames to skip, negative to go back.
+ * @return: false if there is no file or the position went past the end.
+ */
+bool MP3Decoder_SkipFrames(int32_t frames);
+
+
+/**
+ * @brief: Enables or disables center-channel removal (karaoke). When enabled, stereo frames
+ *         are decoded as mono L-R, computed by helix before the IMDCT, so only one channel is synthesized
+ *         (granules where the channels' block types differ go through both IMDCTs and are subtracted after them).
+ * @param enable: true to remove the center channel.
+ */
+void MP3Decoder_SetCenterCancel(bool enable);
+
+
+/**
+ * @brief: getter of the center-channel removal state.
+ * @return: true if the center channel is being removed.
+ */
+bool MP3Decoder_GetCenterCancel(void);
+
+
+/**
+ * @brief: Estimates the play time left of the loaded song, from the bytes left and the average
+ *         frame length.
+ * @return: milliseconds left, UINT32_MAX if no frame was decoded yet.
+ */
+uint32_t MP3Decoder_GetRemainingMs(void);
+
+
+/**
+ * @brief: Loads a second song on the incoming stream (its own helix instance and read-ahead
+ *         buffer), used to crossfade into it while the loaded song ends. Takes over pre-opened files.
+ * @param filename: file's path.
+ * @return: true if it can open the mp3 file and false if it can not.
+ */
+bool MP3Decoder_LoadIncomingFile(const char* filename);
+
+
+/**
+ * @brief: Same as MP3Decoder_DecodeFrame, for the incoming song.
+ */
+decoder_result_t MP3Decoder_DecodeIncomingFrame	(short* decodedDataBuffer,
+												uint32_t decodedBufferSize,
+												uint32_t* numSamplesDecoded,
+												int* sampleRate);
+
+
+/**
+ * @brief: Same as MP3Decoder_GetLastFrameNumOfChannels, for the incoming song.
+ */
+bool MP3Decoder_GetIncomingFrameNumOfChannels(uint8_t* channelCount);
+
+
+/**
+ * @brief: Ends the crossfade: closes the loaded song and the incoming one takes its place
+ *         (tags, position, read-ahead). The outgoing decoder stops here.
+ * @return: false if there was no incoming song.
+ */
+bool MP3Decoder_PromoteIncoming(void);
+
+
+/**
+ * @brief: Closes the incoming song, if any (crossfade cancelled).
+ */
+void MP3Decoder_CloseIncoming(void);
+
+
 #endif /* _MP3_DECODER_H_ */
@@ -0,0 +1,3114 @@
+/*******************************************************************************
+  @file     vorbis_decoder.c
+  @brief    Ogg Vorbis decoder, fixed point, pages streamed from FatFs, mono output
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+ /*******************************************************************************
+  *							INCLUDE HEADER FILES
+  ******************************************************************************/
+
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ff.h"
+#include "fsl_common.h"
+#include "vorbis_decoder.h"
+
+ /*******************************************************************************
+ *					CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define FILE_SECTOR_SIZE		512		// FatFs sector, reads of whole aligned sectors go straight to our buffer
+
+#define VORBIS_RING_SIZE		(VORBIS_READAHEAD_KB * 1024U)	// Power of 2 and whole sectors
+#define VORBIS_RING_MASK		(VORBIS_RING_SIZE - 1)
+#define VORBIS_ARENA_SIZE		(VORBIS_ARENA_KB * 1024U)
+#define VORBIS_MAX_HALF			(VORBIS_MAX_BLOCKSIZE / 2)
+
+#define OGG_HEADER_BYTES		27		// Up to the segment count, the segment table follows
+#define OGG_MAX_SEGMENTS		255
+#define OGG_CONTINUED			0x01	// Page flags
+#define OGG_LAST_PAGE			0x04
+#define OGG_NO_GRANULE			UINT64_MAX	// Pages where no packet ends
+
+#define VORBIS_IDENTIFICATION	1		// Header packet types
+#define VORBIS_COMMENT			3
+#define VORBIS_SETUP			5
+#define VORBIS_CODEBOOK_SYNC	0x564342
+
+#define VORBIS_MAX_CHANNELS		2
+#define VORBIS_MAX_ENTRIES		32768	// Codebook trees are 16 bit
+#define VORBIS_FLOOR1_VALUES	65		// Most X values a floor 1 can have
+#define VORBIS_FLOOR1_CLASSES	16
+#define VORBIS_MAX_PARTITIONS	256		// Residue partitions per block
+#define VORBIS_MAX_COUPLING		8		// Coupling steps per mapping
+#define VORBIS_MAX_SUBMAPS		16
+
+#define VORBIS_RESIDUE_FRAC		8		// Residue (VQ values), Q8
+#define VORBIS_SPECTRUM_FRAC	20		// Spectrum and PCM, Q20: 11 bits of headroom over full scale for the IMDCT sums
+#define VORBIS_FLOOR_SHIFT		(VORBIS_RESIDUE_FRAC + 31 - VORBIS_SPECTRUM_FRAC)	// Q8 residue * Q31 floor to Q20
+#define VORBIS_PCM_SHIFT		(VORBIS_SPECTRUM_FRAC - 15)
+
+#define VORBIS_SYNC_SEARCH		(64 * 1024U)	// Bytes looked at for a page before giving up
+#define VORBIS_TAIL_SEARCH		(64 * 1024U)	// End of the file looked at for the last granule position
+#define VORBIS_SEEK_CHUNK		(2 * FILE_SECTOR_SIZE)	// Read at a time looking for a page while seeking
+#define VORBIS_SEEK_STOP		(4 * FILE_SECTOR_SIZE)	// The bisection stops here, the pages are walked from then on
+#define VORBIS_SEEK_DECODE		(2 * VORBIS_MAX_BLOCKSIZE)	// Shorter forward seeks are decoded through
+
+#define VORBIS_TAG_SIZE			48		// Longer tags are cut
+#define VORBIS_TAG_COUNT		7		// One per audio_tag_t
+#define VORBIS_MAX_COMMENTS		32		// Comments looked at before giving up on the tags
+
+// Per 1152 output samples. A long stereo block (two residues, one 2048 IMDCT, 1024 samples out) is ~200k, estimate.
+// Runs of short blocks cost more per sample
+#define VORBIS_WORST_CASE_CYCLES	400000
+
+// sineTable: sin(pi * j / (4 * SINE_HALF_BLOCK)), j = 0 to 2 * SINE_HALF_BLOCK (0 to pi / 2)
+#define SINE_HALF_BLOCK			1024
+#define SINE_QUARTER			(2 * SINE_HALF_BLOCK)
+
+#if VORBIS_MAX_HALF > SINE_HALF_BLOCK
+#error "sineTable only goes down to the angles of 2048 sample blocks"
+#endif
+
+#define Q31_ONE					0x7FFFFFFF
+#define MULT31(a, b)			((int32_t)(((int64_t)(a) * (b)) >> 31))
+#define DOT31(a, b, c, d)		((int32_t)(((int64_t)(a) * (b) + (int64_t)(c) * (d) + (1 << 30)) >> 31))	// Rounded, the FFT sums would add up the truncation
+
+#define RING_BYTE(st, offset)	((st)->ring[(offset) & VORBIS_RING_MASK])
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+// Huffman tree of the codewords and VQ values, in the arena
+typedef struct
+{
+	int16_t *	tree;				// Two children per node, node 0 is the root: > 0 node, < 0 -(entry + 1), 0 unused codeword
+	int32_t *	values;				// Multiplicand * delta, Q8. NULL without lookup
+	int32_t		minimum;			// Q8
+	uint32_t	entries;
+	uint32_t	lookupValues;
+	uint16_t	dimensions;
+	uint8_t		lookupType;
+	bool		sequenceP;
+} vorbisCodebook_t;
+
+typedef struct
+{
+	uint8_t		partitions;
+	uint8_t		partitionClass[31];
+	uint8_t		classDimensions[VORBIS_FLOOR1_CLASSES];
+	uint8_t		classSubclasses[VORBIS_FLOOR1_CLASSES];
+	uint8_t		classMasterbook[VORBIS_FLOOR1_CLASSES];
+	int16_t		subclassBooks[VORBIS_FLOOR1_CLASSES][8];	// -1 if none
+	uint8_t		multiplier;
+	uint8_t		values;
+	uint16_t	x[VORBIS_FLOOR1_VALUES];
+	uint8_t		sorted[VORBIS_FLOOR1_VALUES];		// Indexes of x, in x order
+	uint8_t		lowNeighbor[VORBIS_FLOOR1_VALUES];
+	uint8_t		highNeighbor[VORBIS_FLOOR1_VALUES];
+} vorbisFloor_t;
+
+typedef struct
+{
+	uint8_t		type;
+	uint8_t		classifications;
+	uint8_t		classbook;
+	uint32_t	begin;
+	uint32_t	end;
+	uint32_t	partitionSize;
+	int16_t *	books;				// [classification * 8 + pass], -1 if none
+} vorbisResidue_t;
+
+typedef struct
+{
+	uint8_t		submaps;
+	uint8_t		couplingSteps;
+	uint8_t		magnitude[VORBIS_MAX_COUPLING];
+	uint8_t		angle[VORBIS_MAX_COUPLING];
+	uint8_t		mux[VORBIS_MAX_CHANNELS];
+	uint8_t		submapFloor[VORBIS_MAX_SUBMAPS];
+	uint8_t		submapResidue[VORBIS_MAX_SUBMAPS];
+} vorbisMapping_t;
+
+typedef struct
+{
+	uint8_t		blockFlag;
+	uint8_t		mapping;
+} vorbisMode_t;
+
+// The ring index of a byte is its file offset & VORBIS_RING_MASK, as in flac_decoder.c
+typedef struct
+{
+	FIL			file;
+	bool		fileIsOpened;
+	uint8_t		channels;
+	uint32_t	sampleRate;
+	uint16_t	blockSizes[2];
+	uint64_t	totalSamples;		// Granule position of the last page, 0 if not found
+	uint32_t	dataStart;			// File offset of the page where the audio starts
+	uint32_t	dataEnd;			// File size
+	char		tags[VORBIS_TAG_COUNT][VORBIS_TAG_SIZE];	// Empty if the file does not have it
+
+	// Ring
+	uint32_t	position;			// File offset of the next byte
+	uint32_t	readPosition;		// File offset of the next sector to read
+	bool		fileEnded;			// true once f_read returned less than asked for
+
+	// Ogg page being read
+	uint32_t	serial;
+	bool		serialKnown;
+	bool		lastPage;			// The page has the end of stream flag
+	bool		resync;				// Skip the packet continued from the previous page (after a seek)
+	uint32_t	pageStart;			// File offset
+	uint64_t	pageGranule;
+	uint8_t		segments[OGG_MAX_SEGMENTS];
+	uint16_t	segmentCount;
+	uint16_t	segmentIndex;		// Next one
+	int16_t		lastPacketSegment;	// Last segment where a packet ends, -1 if none
+	uint8_t		segmentLeft;		// Bytes of the current segment not read yet
+	bool		lastSegment;		// The current segment ends the packet
+	uint64_t	packetGranule;		// Of the packet being read if it is the last one to end in its page
+
+	// LSB first bit reader over the packet. Past its end it reads 0s, padBits tells if they were used
+	uint32_t	bitCache;
+	uint32_t	bitCount;
+	uint32_t	padBits;
+
+	// Setup, in the arena
+	vorbisCodebook_t * codebooks;
+	vorbisFloor_t *	floors;
+	vorbisResidue_t * residues;
+	vorbisMapping_t * mappings;
+	vorbisMode_t *	modes;
+	int32_t *	windows[2];			// Rising slope of each block size, blockSizes[i] / 2 samples, Q31
+	uint16_t	codebookCount;
+	uint8_t		floorCount;
+	uint8_t		residueCount;
+	uint8_t		mappingCount;
+	uint8_t		modeCount;
+	uint8_t		modeBits;
+	uint32_t	arenaUsed;
+
+	// Synthesis
+	uint16_t	previousHalf;		// Half the size of the last block, 0 if there is none (the next one only primes)
+	uint64_t	sample;				// Sample number of the next output sample
+	bool		sampleKnown;		// false after a seek, until a page with a granule position ends
+	uint64_t	seekTarget;
+	uint64_t	seekGranule;		// Of the page decoding restarted at
+	uint32_t	skipSamples;		// Decoded and dropped, forward seeks
+	int32_t		overlap[VORBIS_MAX_HALF];	// Windowed second half of the last block, Q20
+
+	uint8_t		arena[VORBIS_ARENA_SIZE] __attribute__((aligned(4)));
+	uint8_t		ring[VORBIS_RING_SIZE] __attribute__((aligned(4)));
+} vorbisStream_t;
+
+_Static_assert(sizeof(vorbisStream_t) <= AUDIO_DECODER_STREAM_SIZE, "vorbisStream_t does not fit in the memory of a stream");
+_Static_assert(VORBIS_MAX_CHANNELS * VORBIS_MAX_HALF * sizeof(int32_t) <= AUDIO_DECODER_SCRATCH_SIZE,
+				"The Vorbis spectra do not fit in the scratch");
+
+// Window of the block being output
+typedef struct
+{
+	uint32_t	half;
+	uint32_t	leftStart;
+	uint32_t	leftEnd;
+	uint32_t	rightStart;
+	uint32_t	rightEnd;
+	const int32_t * leftSlope;
+	const int32_t * rightSlope;
+} vorbisWindow_t;
+
+/*******************************************************************************
+ *      FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief  Reads the identification header: channels, sample rate and block sizes.
+* @param  st: stream at the start of the packet.
+* @returns  false if it is not one we can play.
+*/
+static bool parseIdentification(vorbisStream_t * st);
+
+
+/*
+* @brief  Stores the TITLE, ARTIST, ALBUM, DATE and TRACKNUMBER comments of the comment header.
+* @param  st: stream at the start of the packet.
+* @returns  false if it is not a comment header.
+*/
+static bool parseComments(vorbisStream_t * st);
+
+
+/*
+* @brief  Decodes the setup header into the arena: codebooks, floors, residues, mappings and modes.
+* @param  st: stream at the start of the packet.
+* @returns  false if it is not valid, uses floor 0 or does not fit.
+*/
+static bool parseSetup(vorbisStream_t * st);
+
+
+/*
+* @brief  Reads a codebook and builds its tree (the codeword lengths stay at the top of the arena meanwhile).
+* @param  st: stream.
+* @param  book: output.
+* @returns  false if it is not valid or does not fit.
+*/
+static bool parseCodebook(vorbisStream_t * st, vorbisCodebook_t * book);
+
+
+/*
+* @brief  Builds the decoding tree of a codebook, assigning the codewords in entry order as the spec does.
+* @param  st: stream, the tree goes at the bottom of the free arena.
+* @param  book: codebook, entries set.
+* @param  lengths: codeword length of each entry, 0 if unused.
+* @returns  false if the lengths do not make a prefix code or the tree does not fit.
+*/
+static bool buildTree(vorbisStream_t * st, vorbisCodebook_t * book, const uint8_t * lengths);
+
+
+/*
+* @brief  Reads a floor 1 configuration and sorts its X values.
+* @param  st: stream.
+* @param  floor: output.
+* @returns  false if it is not valid.
+*/
+static bool parseFloor(vorbisStream_t * st, vorbisFloor_t * floor);
+
+
+/*
+* @brief  Reads a residue configuration (type already read).
+* @param  st: stream.
+* @param  residue: output.
+* @returns  false if it is not valid or does not fit.
+*/
+static bool parseResidue(vorbisStream_t * st, vorbisResidue_t * residue);
+
+
+/*
+* @brief  Reads a mapping configuration (type already read).
+* @param  st: stream.
+* @param  mapping: output.
+* @returns  false if it is not valid.
+*/
+static bool parseMapping(vorbisStream_t * st, vorbisMapping_t * mapping);
+
+
+/*
+* @brief  Checks the packet type and the "vorbis" string of a header packet.
+* @param  st: stream at the start of the packet.
+* @param  type: header type expected.
+* @returns  true if it matches.
+*/
+static bool checkHeader(vorbisStream_t * st, uint8_t type);
+
+
+/*
+* @brief  Reserves room in the arena of the stream, 4 byte aligned.
+* @param  st: stream.
+* @param  bytes: size.
+* @returns  the memory, NULL if it does not fit.
+*/
+static void * arenaAlloc(vorbisStream_t * st, uint32_t bytes);
+
+
+/*
+* @brief  Fills the rising window slopes of both block sizes.
+* @param  st: stream, block sizes set.
+* @returns  false if they do not fit in the arena.
+*/
+static bool computeWindows(vorbisStream_t * st);
+
+
+/*
+* @brief  Looks at the end of the file for the granule position of the last page (the length of the file).
+* @param  st: stream, serial number known.
+*/
+static void findLastGranule(vorbisStream_t * st);
+
+
+/*
+* @brief  Finds the first page of the stream with a granule position at or after an offset.
+* @param  st: stream.
+* @param  from: file offset to start looking at.
+* @param  limit: pages starting from here on are not looked at.
+* @param  page: here we store the file offset of the page.
+* @param  granule: here we store its granule position.
+* @returns  false if there is none.
+*/
+static bool findPage(vorbisStream_t * st, uint32_t from, uint32_t limit, uint32_t * page, uint64_t * granule);
+
+
+/*
+* @brief  Bisects the pages for the last one with a granule position up to a limit and restarts decoding there.
+* @param  st: stream.
+* @param  target: sample number to output next.
+* @param  limit: granule position looked for, target or less.
+*/
+static void seekToSample(vorbisStream_t * st, uint64_t target, uint64_t limit);
+
+
+/*
+* @brief  Reads whole sectors into the free space of the ring.
+* @param  st: stream.
+* @returns  the number of bytes read.
+*/
+static uint32_t fillRing(vorbisStream_t * st);
+
+
+/*
+* @brief  Positions the file at the sector containing filePosition, the ring starts empty there.
+* @param  st: stream.
+* @param  filePosition: absolute position in the file.
+*/
+static void seekAligned(vorbisStream_t * st, uint32_t filePosition);
+
+
+/*
+* @brief  Reads the next byte of the file through the ring, reading it now if it ran dry.
+* @param  st: stream.
+* @returns  the byte, -1 at the end of the file.
+*/
+static int32_t ringByte(vorbisStream_t * st);
+
+
+/*
+* @brief  Skips bytes of the file, through the ring if they were read already.
+* @param  st: stream.
+* @param  count: bytes.
+*/
+static void ringSkip(vorbisStream_t * st, uint32_t count);
+
+
+/*
+* @brief  Reads the next page header and its segment table, looking for the capture pattern if it is not there.
+* @param  st: stream.
+* @returns  false at the end of the stream (end of file, last page or another logical stream).
+*/
+static bool readPageHeader(vorbisStream_t * st);
+
+
+/*
+* @brief  Moves to the next segment of the packet, reading the next page header if needed.
+* @param  st: stream.
+* @returns  false at the end of the stream.
+*/
+static bool nextSegment(vorbisStream_t * st);
+
+
+/*
+* @brief  Skips what is left of the current packet.
+* @param  st: stream.
+* @returns  false at the end of the stream.
+*/
+static bool finishPacket(vorbisStream_t * st);
+
+
+/*
+* @brief  Skips what is left of the current packet and starts reading the next one.
+* @param  st: stream.
+* @returns  false at the end of the stream.
+*/
+static bool beginPacket(vorbisStream_t * st);
+
+
+/*
+* @brief  Reads the next byte of the packet.
+* @param  st: stream.
+* @returns  the byte, -1 past the end of the packet.
+*/
+static int32_t packetByte(vorbisStream_t * st);
+
+
+/*
+* @brief  Skips bytes of the packet, whole segments at a time. The bit reader must be byte aligned.
+* @param  st: stream.
+* @param  count: bytes.
+*/
+static void packetSkip(vorbisStream_t * st, uint32_t count);
+
+
+/*
+* @brief  Bit reader: tops the cache up to at least 25 bits.
+* @param  st: stream.
+*/
+static void bitsFill(vorbisStream_t * st);
+
+
+/*
+* @brief  Bit reader: reads n bits, n up to 32.
+* @param  st: stream.
+* @param  n: bits.
+* @returns  the bits, the first one read in the LSB.
+*/
+static uint32_t bitsRead(vorbisStream_t * st, uint32_t n);
+
+
+/*
+* @brief  Bit reader: checks if what was read went past the end of the packet.
+* @param  st: stream.
+* @returns  true if it did.
+*/
+static inline bool bitsEnded(const vorbisStream_t * st);
+
+
+/*
+* @brief  Decodes one codeword, walking the tree of the codebook one bit at a time.
+* @param  st: stream.
+* @param  book: codebook.
+* @returns  the entry, -1 if the codeword is not in the book or the packet ended.
+*/
+static int32_t decodeEntry(vorbisStream_t * st, const vorbisCodebook_t * book);
+
+
+/*
+* @brief  Decodes an audio packet and outputs its samples, mixed to mono.
+* @param  st: stream at the start of the packet.
+* @param  out: output, half the long block size at most.
+* @returns  the number of samples, 0 for the first block, -1 if it is not an audio packet or it is damaged.
+*/
+static int32_t decodeAudioPacket(vorbisStream_t * st, short * out);
+
+
+/*
+* @brief  Decodes the floor 1 values of a channel.
+* @param  st: stream.
+* @param  floor: floor configuration.
+* @param  y: output, floor->values of them.
+* @returns  false if the channel is unused.
+*/
+static bool decodeFloor(vorbisStream_t * st, const vorbisFloor_t * floor, int16_t * y);
+
+
+/*
+* @brief  Synthesizes the floor curve of a channel and multiplies the residue by it, into Q20.
+* @param  floor: floor configuration.
+* @param  y: decoded floor values.
+* @param  data: residue in, spectrum out.
+* @param  half: half the block size.
+*/
+static void applyFloor(const vorbisFloor_t * floor, const int16_t * y, int32_t * data, uint32_t half);
+
+
+/*
+* @brief  Multiplies the residue by a straight segment of the floor curve (floor 1 render_line).
+* @param  x0, y0, x1, y1: segment, x1 not included.
+* @param  data: residue in, spectrum out.
+* @param  half: half the block size, the end of data.
+*/
+static void renderLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t * data, uint32_t half);
+
+
+/*
+* @brief  Decodes the residue vectors of the channels of a submap, adding into them.
+* @param  st: stream.
+* @param  residue: residue configuration.
+* @param  vectors: one per channel, half long, zeroed.
+* @param  count: channels.
+* @param  skip: the channels not to decode.
+* @param  half: half the block size.
+*/
+static void decodeResidue(vorbisStream_t * st, const vorbisResidue_t * residue, int32_t ** vectors,
+							uint32_t count, const bool * skip, uint32_t half);
+
+
+/*
+* @brief  Decodes the VQ vectors of one partition, adding them into the residue.
+* @param  st: stream.
+* @param  book: VQ codebook.
+* @param  vectors: residue vectors.
+* @param  interleave: 2 for residue type 2 of two channels (even samples to the first vector), 1 otherwise.
+* @param  offset: first value of the partition.
+* @param  size: values in the partition.
+* @param  stepped: residue type 0 (the values of each vector are spread over the partition).
+* @returns  false if the packet ended or a codeword is not valid.
+*/
+static bool decodePartition(vorbisStream_t * st, const vorbisCodebook_t * book, int32_t ** vectors,
+							uint32_t interleave, uint32_t offset, uint32_t size, bool stepped);
+
+
+/*
+* @brief  Inverse MDCT core: in-place DCT-IV of the half spectrum, through a complex FFT of a quarter of the block.
+* @param  data: spectrum in, DCT-IV out, half values, Q20.
+* @param  half: half the block size.
+*/
+static void imdct(int32_t * data, uint32_t half);
+
+
+/*
+* @brief  In-place radix-2 complex FFT, e^(-i) twiddles from sineTable.
+* @param  data: interleaved real and imaginary parts.
+* @param  points: complex points, power of 2.
+*/
+static void fft(int32_t * data, uint32_t points);
+
+
+/*
+* @brief  One sample of the block: the IMDCT output unfolded from the DCT-IV, times the window.
+* @param  u: DCT-IV of the block.
+* @param  i: sample of the block, 0 to twice half.
+* @param  w: window of the block.
+* @returns  the sample, Q20.
+*/
+static inline int32_t windowedSample(const int32_t * u, uint32_t i, const vorbisWindow_t * w);
+
+
+/*
+* @brief  sin(pi / 2 * x), interpolated from sineTable.
+* @param  x: 0 to 1, Q31.
+* @returns  the sine, Q31.
+*/
+static int32_t sineQuarter(int32_t x);
+
+
+/*
+* @brief  Number of bits needed to code a number (ilog of the spec).
+* @param  value: number.
+* @returns  the bits, 0 for 0.
+*/
+static inline uint32_t ilog(uint32_t value);
+
+
+/*
+* @brief  Codec table adapters, see audio_codec_t.
+*/
+static bool vorbisProbe(const uint8_t * header, uint32_t length);
+static bool vorbisGetChannels(decoder_stream_t id, uint8_t * channelCount);
+static bool vorbisSeek(int32_t samples);
+static uint32_t vorbisGetRemainingMs(void);
+static bool vorbisPromote(void);
+static bool vorbisGetTag(audio_tag_t tag, char ** value);
+static void vorbisSetCenterCancel(bool enable);
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH GLOBAL SCOPE
+ *****************************************************************************/
+const audio_codec_t vorbisCodec =
+{
+	.name = "Vorbis",
+	.extension = ".ogg",
+	.worstCaseCycles = VORBIS_WORST_CASE_CYCLES,
+
+	.init = VorbisDecoder_Init,
+	.probe = vorbisProbe,
+	.open = VorbisDecoder_LoadFile,
+	.decodeFrame = VorbisDecoder_DecodeFrame,
+	.getChannels = vorbisGetChannels,
+	.seek = vorbisSeek,
+	.getRemainingMs = vorbisGetRemainingMs,
+	.promote = vorbisPromote,
+	.close = VorbisDecoder_Close,
+
+	.readAhead = VorbisDecoder_ReadAhead,
+	.getTag = vorbisGetTag,
+	.setCenterCancel = vorbisSetCenterCancel,
+};
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH LOCAL SCOPE
+ *****************************************************************************/
+// In the memory of the decoder layer, NULL while there is no file of ours on the stream
+static vorbisStream_t *	playing = NULL;
+static vorbisStream_t *	incoming = NULL;
+static bool				centerCancel;			// Stereo files are output as (L - R) / 2 instead of L + R
+
+// Residue and spectrum of each channel of the packet being decoded, in the scratch of the decoder layer.
+// The page searches use the scratch as their buffer too
+static int32_t (* spectrum)[VORBIS_MAX_HALF];
+
+// Floor values and residue classifications of the packet being decoded
+static int16_t floorValues[VORBIS_MAX_CHANNELS][VORBIS_FLOOR1_VALUES];
+static uint8_t partitionClasses[VORBIS_MAX_CHANNELS][VORBIS_MAX_PARTITIONS];
+
+// Indexed by multiplier - 1
+static const uint16_t floorRanges[4] = { 256, 128, 86, 64 };
+
+// Indexed by audio_tag_t
+static const char * const tagNames[VORBIS_TAG_COUNT] = { "TITLE", "ARTIST", "ALBUM", "DATE", "TRACKNUMBER",
+														  "REPLAYGAIN_TRACK_GAIN", "REPLAYGAIN_TRACK_PEAK" };
+
+// Floor 1 amplitudes, 10^((i - 255) * 7 / 256): -140 to 0 dB, Q31
+static const int32_t inverseDbTable[256] =
+{
+	229, 244, 259, 276, 294, 313, 334, 355,
+	378, 403, 429, 457, 487, 518, 552, 588,
+	626, 667, 710, 756, 806, 858, 914, 973,
+	1036, 1104, 1175, 1252, 1333, 1420, 1512, 1610,
+	1715, 1826, 1945, 2072, 2206, 2350, 2502, 2665,
+	2838, 3023, 3219, 3428, 3651, 3888, 4141, 4410,
+	4696, 5002, 5327, 5673, 6042, 6434, 6852, 7298,
+	7772, 8277, 8815, 9388, 9998, 10647, 11339, 12076,
+	12861, 13697, 14587, 15535, 16544, 17619, 18764, 19984,
+	21283, 22666, 24139, 25707, 27378, 29157, 31052, 33070,
+	35219, 37507, 39945, 42541, 45305, 48249, 51385, 54724,
+	58281, 62068, 66101, 70397, 74972, 79844, 85033, 90559,
+	96444, 102711, 109386, 116494, 124065, 132127, 140714, 149858,
+	159597, 169968, 181014, 192777, 205305, 218646, 232855, 247988,
+	264103, 281266, 299544, 319010, 339742, 361820, 385333, 410374,
+	437042, 465444, 495691, 527904, 562210, 598746, 637656, 679094,
+	723225, 770225, 820278, 873584, 930355, 990815, 1055203, 1123776,
+	1196806, 1274581, 1357410, 1445622, 1539567, 1639617, 1746168, 1859644,
+	1980494, 2109198, 2246266, 2392241, 2547702, 2713266, 2889589, 3077371,
+	3277356, 3490337, 3717159, 3958721, 4215981, 4489959, 4781742, 5092486,
+	5423425, 5775869, 6151218, 6550959, 6976677, 7430061, 7912908, 8427133,
+	8974776, 9558007, 10179141, 10840639, 11545124, 12295392, 13094415, 13945364,
+	14851613, 15816754, 16844616, 17939274, 19105069, 20346624, 21668863, 23077027,
+	24576703, 26173835, 27874759, 29686218, 31615395, 33669942, 35858004, 38188260,
+	40669948, 43312910, 46127627, 49125260, 52317697, 55717595, 59338439, 63194585,
+	67301325, 71674945, 76332786, 81293321, 86576219, 92202430, 98194263, 104575480,
+	111371384, 118608924, 126316800, 134525578, 143267808, 152578157, 162493546, 173053292,
+	184299270, 196276075, 209031201, 222615226, 237082018, 252488944, 268897098, 286371547,
+	304981584, 324801006, 345908406, 368387483, 392327378, 417823022, 444975516, 473892533,
+	504688740, 537486259, 572415145, 609613907, 649230054, 691420681, 736353093, 784205467,
+	835167557, 889441452, 947242370, 1008799517, 1074356994, 1144174766, 1218529690, 1297716617,
+	1382049555, 1471862924, 1567512871, 1669378691, 1777864326, 1893399969, 2016443769, 2147483647
+};
+
+// sin(pi * j / 4096), j = 0 to 2048, Q31
+static const int32_t sineTable[SINE_QUARTER + 1] =
+{
+	0, 1647099, 3294197, 4941294, 6588387, 8235476, 9882561, 11529640,
+	13176712, 14823776, 16470832, 18117878, 19764913, 21411936, 23058947, 24705945,
+	26352928, 27999895, 29646846, 31293780, 32940695, 34587590, 36234466, 37881320,
+	39528151, 41174960, 42821744, 44468503, 46115236, 47761942, 49408620, 51055268,
+	52701887, 54348475, 55995030, 57641553, 59288042, 60934496, 62580914, 64227295,
+	65873638, 67519943, 69166208, 70812432, 72458615, 74104755, 75750851, 77396903,
+	79042909, 80688869, 82334782, 83980645, 85626460, 87272224, 88917937, 90563597,
+	92209205, 93854758, 95500255, 97145697, 98791081, 100436408, 102081675, 103726882,
+	105372028, 107017112, 108662134, 110307091, 111951983, 113596810, 115241570, 116886262,
+	118530885, 120175438, 121819921, 123464332, 125108670, 126752935, 128397125, 130041240,
+	131685278, 133329239, 134973122, 136616925, 138260647, 139904288, 141547847, 143191323,
+	144834714, 146478021, 148121241, 149764374, 151407418, 153050374, 154693240, 156336015,
+	157978697, 159621287, 161263783, 162906184, 164548489, 166190698, 167832808, 169474820,
+	171116733, 172758544, 174400254, 176041861, 177683365, 179324764, 180966058, 182607245,
+	184248325, 185889297, 187530159, 189170911, 190811551, 192452080, 194092495, 195732795,
+	197372981, 199013051, 200653003, 202292838, 203932553, 205572149, 207211624, 208850976,
+	210490206, 212129312, 213768293, 215407149, 217045878, 218684479, 220322951, 221961294,
+	223599506, 225237587, 226875535, 228513350, 230151030, 231788575, 233425984, 235063255,
+	236700388, 238337382, 239974235, 241610947, 243247518, 244883945, 246520228, 248156366,
+	249792358, 251428203, 253063900, 254699448, 256334847, 257970095, 259605191, 261240134,
+	262874923, 264509558, 266144038, 267778360, 269412525, 271046532, 272680379, 274314066,
+	275947592, 277580955, 279214155, 280847190, 282480061, 284112765, 285745302, 287377671,
+	289009871, 290641901, 292273760, 293905447, 295536961, 297168301, 298799466, 300430456,
+	302061269, 303691904, 305322361, 306952638, 308582734, 310212649, 311842381, 313471930,
+	315101295, 316730474, 318359466, 319988272, 321616889, 323245317, 324873555, 326501602,
+	328129457, 329757119, 331384586, 333011859, 334638936, 336265816, 337892498, 339518981,
+	341145265, 342771348, 344397230, 346022908, 347648383, 349273654, 350898719, 352523578,
+	354148230, 355772673, 357396906, 359020930, 360644742, 362268343, 363891730, 365514903,
+	367137861, 368760603, 370383128, 372005435, 373627523, 375249392, 376871039, 378492466,
+	380113669, 381734649, 383355404, 384975934, 386596237, 388216313, 389836160, 391455778,
+	393075166, 394694323, 396313247, 397931939, 399550396, 401168618, 402786604, 404404353,
+	406021865, 407639137, 409256170, 410872962, 412489512, 414105819, 415721883, 417337703,
+	418953276, 420568604, 422183684, 423798515, 425413098, 427027430, 428641511, 430255339,
+	431868915, 433482236, 435095303, 436708113, 438320667, 439932963, 441545000, 443156777,
+	444768294, 446379549, 447990541, 449601270, 451211734, 452821933, 454431865, 456041530,
+	457650927, 459260055, 460868912, 462477499, 464085813, 465693854, 467301622, 468909114,
+	470516330, 472123270, 473729932, 475336316, 476942419, 478548243, 480153784, 481759043,
+	483364019, 484968710, 486573117, 488177236, 489781069, 491384614, 492987869, 494590835,
+	496193509, 497795892, 499397982, 500999778, 502601279, 504202485, 505803394, 507404005,
+	509004318, 510604332, 512204045, 513803457, 515402566, 517001373, 518599875, 520198072,
+	521795963, 523393547, 524990824, 526587791, 528184449, 529780796, 531376831, 532972554,
+	534567963, 536163058, 537757837, 539352300, 540946445, 542540273, 544133781, 545726969,
+	547319836, 548912382, 550504604, 552096502, 553688076, 555279324, 556870245, 558460839,
+	560051104, 561641039, 563230645, 564819919, 566408860, 567997469, 569585743, 571173682,
+	572761285, 574348552, 575935480, 577522070, 579108320, 580694229, 582279796, 583865021,
+	585449903, 587034440, 588618632, 590202477, 591785976, 593369126, 594951927, 596534378,
+	598116479, 599698227, 601279623, 602860664, 604441352, 606021683, 607601658, 609181276,
+	610760536, 612339436, 613917975, 615496154, 617073971, 618651424, 620228514, 621805239,
+	623381598, 624957590, 626533215, 628108471, 629683357, 631257873, 632832018, 634405791,
+	635979190, 637552215, 639124865, 640697139, 642269036, 643840556, 645411696, 646982457,
+	648552838, 650122837, 651692453, 653261686, 654830535, 656398998, 657967075, 659534766,
+	661102068, 662668981, 664235505, 665801638, 667367379, 668932727, 670497682, 672062243,
+	673626408, 675190177, 676753549, 678316522, 679879097, 681441272, 683003045, 684564417,
+	686125387, 687685952, 689246113, 690805869, 692365218, 693924160, 695482694, 697040818,
+	698598533, 700155836, 701712728, 703269207, 704825272, 706380923, 707936158, 709490976,
+	711045377, 712599360, 714152924, 715706067, 717258790, 718811090, 720362968, 721914422,
+	723465451, 725016055, 726566232, 728115982, 729665303, 731214195, 732762657, 734310688,
+	735858287, 737405453, 738952186, 740498483, 742044345, 743589770, 745134758, 746679308,
+	748223418, 749767089, 751310318, 752853105, 754395449, 755937350, 757478806, 759019816,
+	760560380, 762100496, 763640164, 765179382, 766718151, 768256469, 769794334, 771331747,
+	772868706, 774405210, 775941259, 777476851, 779011986, 780546663, 782080880, 783614638,
+	785147934, 786680769, 788213141, 789745049, 791276492, 792807470, 794337982, 795868026,
+	797397602, 798926709, 800455346, 801983513, 803511207, 805038429, 806565177, 808091450,
+	809617249, 811142571, 812667415, 814191782, 815715670, 817239078, 818762005, 820284450,
+	821806413, 823327893, 824848888, 826369398, 827889422, 829408958, 830928007, 832446567,
+	833964638, 835482217, 836999305, 838515901, 840032004, 841547612, 843062726, 844577343,
+	846091463, 847605086, 849118210, 850630835, 852142959, 853654582, 855165703, 856676321,
+	858186435, 859696043, 861205147, 862713743, 864221832, 865729413, 867236484, 868743045,
+	870249095, 871754633, 873259659, 874764170, 876268167, 877771649, 879274614, 880777062,
+	882278992, 883780402, 885281293, 886781663, 888281512, 889780838, 891279640, 892777918,
+	894275671, 895772898, 897269597, 898765769, 900261413, 901756526, 903251110, 904745161,
+	906238681, 907731667, 909224120, 910716038, 912207419, 913698265, 915188572, 916678342,
+	918167572, 919656262, 921144411, 922632018, 924119082, 925605603, 927091579, 928577010,
+	930061894, 931546231, 933030021, 934513261, 935995952, 937478092, 938959681, 940440717,
+	941921200, 943401129, 944880503, 946359321, 947837582, 949315286, 950792431, 952269017,
+	953745043, 955220508, 956695411, 958169751, 959643527, 961116739, 962589385, 964061465,
+	965532978, 967003923, 968474300, 969944106, 971413342, 972882006, 974350098, 975817617,
+	977284562, 978750932, 980216726, 981681943, 983146583, 984610645, 986074127, 987537030,
+	988999351, 990461091, 991922248, 993382821, 994842810, 996302214, 997761031, 999219262,
+	1000676905, 1002133959, 1003590424, 1005046298, 1006501581, 1007956272, 1009410370, 1010863875,
+	1012316784, 1013769098, 1015220816, 1016671936, 1018122458, 1019572382, 1021021705, 1022470428,
+	1023918550, 1025366069, 1026812985, 1028259297, 1029705004, 1031150105, 1032594600, 1034038487,
+	1035481766, 1036924436, 1038366495, 1039807944, 1041248781, 1042689006, 1044128617, 1045567615,
+	1047005996, 1048443763, 1049880912, 1051317443, 1052753357, 1054188651, 1055623324, 1057057377,
+	1058490808, 1059923616, 1061355801, 1062787361, 1064218296, 1065648605, 1067078288, 1068507342,
+	1069935768, 1071363564, 1072790730, 1074217266, 1075643169, 1077068439, 1078493076, 1079917078,
+	1081340445, 1082763176, 1084185270, 1085606726, 1087027544, 1088447722, 1089867259, 1091286156,
+	1092704411, 1094122023, 1095538991, 1096955314, 1098370993, 1099786025, 1101200410, 1102614148,
+	1104027237, 1105439676, 1106851465, 1108262603, 1109673089, 1111082922, 1112492101, 1113900627,
+	1115308496, 1116715710, 1118122267, 1119528166, 1120933406, 1122337987, 1123741908, 1125145168,
+	1126547765, 1127949701, 1129350972, 1130751579, 1132151521, 1133550797, 1134949406, 1136347348,
+	1137744621, 1139141224, 1140537158, 1141932420, 1143327011, 1144720929, 1146114174, 1147506745,
+	1148898640, 1150289860, 1151680403, 1153070269, 1154459456, 1155847964, 1157235792, 1158622939,
+	1160009405, 1161395188, 1162780288, 1164164704, 1165548435, 1166931481, 1168313840, 1169695512,
+	1171076495, 1172456790, 1173836395, 1175215310, 1176593533, 1177971064, 1179347902, 1180724046,
+	1182099496, 1183474250, 1184848308, 1186221669, 1187594332, 1188966297, 1190337562, 1191708127,
+	1193077991, 1194447153, 1195815612, 1197183368, 1198550419, 1199916766, 1201282407, 1202647340,
+	1204011567, 1205375085, 1206737894, 1208099993, 1209461382, 1210822059, 1212182024, 1213541275,
+	1214899813, 1216257636, 1217614743, 1218971135, 1220326809, 1221681765, 1223036002, 1224389521,
+	1225742318, 1227094395, 1228445750, 1229796382, 1231146291, 1232495475, 1233843935, 1235191668,
+	1236538675, 1237884955, 1239230506, 1240575329, 1241919421, 1243262783, 1244605414, 1245947312,
+	1247288478, 1248628909, 1249968606, 1251307568, 1252645794, 1253983283, 1255320034, 1256656047,
+	1257991320, 1259325853, 1260659646, 1261992697, 1263325005, 1264656571, 1265987392, 1267317469,
+	1268646800, 1269975384, 1271303222, 1272630312, 1273956653, 1275282245, 1276607086, 1277931177,
+	1279254516, 1280577102, 1281898935, 1283220013, 1284540337, 1285859905, 1287178717, 1288496772,
+	1289814068, 1291130606, 1292446384, 1293761402, 1295075659, 1296389154, 1297701886, 1299013855,
+	1300325060, 1301635500, 1302945174, 1304254082, 1305562222, 1306869594, 1308176198, 1309482032,
+	1310787095, 1312091388, 1313394909, 1314697657, 1315999631, 1317300832, 1318601257, 1319900907,
+	1321199781, 1322497877, 1323795195, 1325091734, 1326387494, 1327682474, 1328976672, 1330270089,
+	1331562723, 1332854574, 1334145641, 1335435923, 1336725419, 1338014129, 1339302052, 1340589187,
+	1341875533, 1343161090, 1344445857, 1345729833, 1347013017, 1348295409, 1349577007, 1350857812,
+	1352137822, 1353417037, 1354695455, 1355973077, 1357249901, 1358525926, 1359801152, 1361075579,
+	1362349204, 1363622028, 1364894050, 1366165269, 1367435685, 1368705296, 1369974101, 1371242101,
+	1372509294, 1373775680, 1375041258, 1376306026, 1377569986, 1378833134, 1380095472, 1381356997,
+	1382617710, 1383877610, 1385136696, 1386394966, 1387652422, 1388909060, 1390164882, 1391419886,
+	1392674072, 1393927438, 1395179984, 1396431709, 1397682613, 1398932695, 1400181954, 1401430389,
+	1402678000, 1403924785, 1405170745, 1406415878, 1407660183, 1408903661, 1410146309, 1411388129,
+	1412629117, 1413869275, 1415108601, 1416347095, 1417584755, 1418821582, 1420057574, 1421292730,
+	1422527051, 1423760534, 1424993180, 1426224988, 1427455956, 1428686085, 1429915374, 1431143821,
+	1432371426, 1433598189, 1434824109, 1436049184, 1437273414, 1438496799, 1439719338, 1440941030,
+	1442161874, 1443381870, 1444601017, 1445819314, 1447036760, 1448253355, 1449469098, 1450683988,
+	1451898025, 1453111208, 1454323536, 1455535009, 1456745625, 1457955385, 1459164286, 1460372329,
+	1461579514, 1462785838, 1463991302, 1465195904, 1466399645, 1467602523, 1468804538, 1470005688,
+	1471205974, 1472405394, 1473603949, 1474801636, 1475998456, 1477194407, 1478389489, 1479583702,
+	1480777044, 1481969516, 1483161115, 1484351842, 1485541696, 1486730675, 1487918781, 1489106011,
+	1490292364, 1491477842, 1492662441, 1493846163, 1495029006, 1496210969, 1497392053, 1498572255,
+	1499751576, 1500930014, 1502107570, 1503284242, 1504460029, 1505634932, 1506808949, 1507982079,
+	1509154322, 1510325678, 1511496145, 1512665723, 1513834411, 1515002208, 1516169114, 1517335128,
+	1518500250, 1519664478, 1520827813, 1521990252, 1523151797, 1524312445, 1525472197, 1526631051,
+	1527789007, 1528946064, 1530102222, 1531257480, 1532411837, 1533565293, 1534717846, 1535869497,
+	1537020244, 1538170087, 1539319024, 1540467057, 1541614183, 1542760402, 1543905714, 1545050118,
+	1546193612, 1547336197, 1548477872, 1549618636, 1550758488, 1551897428, 1553035455, 1554172569,
+	1555308768, 1556444052, 1557578421, 1558711873, 1559844408, 1560976026, 1562106725, 1563236506,
+	1564365367, 1565493307, 1566620327, 1567746425, 1568871601, 1569995854, 1571119183, 1572241588,
+	1573363068, 1574483623, 1575603251, 1576721952, 1577839726, 1578956572, 1580072489, 1581187476,
+	1582301533, 1583414660, 1584526854, 1585638117, 1586748447, 1587857843, 1588966306, 1590073833,
+	1591180426, 1592286082, 1593390801, 1594494583, 1595597428, 1596699333, 1597800299, 1598900325,
+	1599999411, 1601097555, 1602194758, 1603291018, 1604386335, 1605480708, 1606574136, 1607666620,
+	1608758157, 1609848749, 1610938393, 1612027089, 1613114838, 1614201637, 1615287487, 1616372386,
+	1617456335, 1618539332, 1619621377, 1620702469, 1621782608, 1622861793, 1623940023, 1625017297,
+	1626093616, 1627168978, 1628243383, 1629316830, 1630389319, 1631460848, 1632531418, 1633601027,
+	1634669676, 1635737362, 1636804087, 1637869848, 1638934646, 1639998480, 1641061349, 1642123253,
+	1643184191, 1644244162, 1645303166, 1646361202, 1647418269, 1648474367, 1649529496, 1650583654,
+	1651636841, 1652689057, 1653740300, 1654790570, 1655839867, 1656888190, 1657935539, 1658981911,
+	1660027308, 1661071729, 1662115172, 1663157637, 1664199124, 1665239632, 1666279161, 1667317709,
+	1668355276, 1669391862, 1670427466, 1671462087, 1672495725, 1673528379, 1674560049, 1675590733,
+	1676620432, 1677649144, 1678676870, 1679703608, 1680729357, 1681754118, 1682777890, 1683800672,
+	1684822463, 1685843263, 1686863072, 1687881888, 1688899711, 1689916541, 1690932376, 1691947217,
+	1692961062, 1693973912, 1694985765, 1695996621, 1697006479, 1698015339, 1699023199, 1700030061,
+	1701035922, 1702040783, 1703044642, 1704047500, 1705049355, 1706050207, 1707050055, 1708048900,
+	1709046739, 1710043573, 1711039401, 1712034223, 1713028037, 1714020844, 1715012642, 1716003431,
+	1716993211, 1717981981, 1718969740, 1719956488, 1720942225, 1721926948, 1722910659, 1723893357,
+	1724875040, 1725855708, 1726835361, 1727813999, 1728791620, 1729768224, 1730743810, 1731718378,
+	1732691928, 1733664458, 1734635968, 1735606458, 1736575927, 1737544374, 1738511799, 1739478202,
+	1740443581, 1741407936, 1742371267, 1743333573, 1744294853, 1745255107, 1746214334, 1747172535,
+	1748129707, 1749085851, 1750040966, 1750995052, 1751948107, 1752900132, 1753851126, 1754801087,
+	1755750017, 1756697914, 1757644777, 1758590607, 1759535401, 1760479161, 1761421885, 1762363573,
+	1763304224, 1764243838, 1765182414, 1766119952, 1767056450, 1767991909, 1768926328, 1769859707,
+	1770792044, 1771723340, 1772653593, 1773582803, 1774510970, 1775438094, 1776364172, 1777289206,
+	1778213194, 1779136137, 1780058032, 1780978881, 1781898681, 1782817434, 1783735137, 1784651792,
+	1785567396, 1786481950, 1787395453, 1788307905, 1789219305, 1790129652, 1791038946, 1791947186,
+	1792854372, 1793760504, 1794665580, 1795569601, 1796472565, 1797374472, 1798275323, 1799175115,
+	1800073849, 1800971523, 1801868139, 1802763694, 1803658189, 1804551623, 1805443995, 1806335305,
+	1807225553, 1808114737, 1809002858, 1809889915, 1810775906, 1811660833, 1812544694, 1813427489,
+	1814309216, 1815189877, 1816069469, 1816947994, 1817825449, 1818701835, 1819577151, 1820451397,
+	1821324572, 1822196675, 1823067707, 1823937666, 1824806552, 1825674364, 1826541103, 1827406767,
+	1828271356, 1829134869, 1829997307, 1830858668, 1831718951, 1832578158, 1833436286, 1834293336,
+	1835149306, 1836004197, 1836858008, 1837710739, 1838562388, 1839412956, 1840262441, 1841110844,
+	1841958164, 1842804401, 1843649553, 1844493621, 1845336604, 1846178501, 1847019312, 1847859036,
+	1848697674, 1849535224, 1850371686, 1851207059, 1852041343, 1852874538, 1853706643, 1854537657,
+	1855367581, 1856196413, 1857024153, 1857850800, 1858676355, 1859500816, 1860324183, 1861146456,
+	1861967634, 1862787717, 1863606704, 1864424594, 1865241388, 1866057085, 1866871683, 1867685184,
+	1868497586, 1869308888, 1870119091, 1870928194, 1871736196, 1872543097, 1873348897, 1874153594,
+	1874957189, 1875759681, 1876561070, 1877361354, 1878160535, 1878958610, 1879755580, 1880551444,
+	1881346202, 1882139853, 1882932397, 1883723833, 1884514161, 1885303381, 1886091491, 1886878492,
+	1887664383, 1888449163, 1889232832, 1890015391, 1890796837, 1891577171, 1892356392, 1893134500,
+	1893911494, 1894687374, 1895462140, 1896235790, 1897008325, 1897779744, 1898550047, 1899319232,
+	1900087301, 1900854251, 1901620084, 1902384797, 1903148392, 1903910867, 1904672222, 1905432457,
+	1906191570, 1906949562, 1907706433, 1908462181, 1909216806, 1909970309, 1910722688, 1911473942,
+	1912224073, 1912973078, 1913720958, 1914467712, 1915213340, 1915957841, 1916701216, 1917443462,
+	1918184581, 1918924571, 1919663432, 1920401165, 1921137767, 1921873239, 1922607581, 1923340791,
+	1924072871, 1924803818, 1925533633, 1926262315, 1926989864, 1927716279, 1928441561, 1929165708,
+	1929888720, 1930610597, 1931331338, 1932050943, 1932769411, 1933486742, 1934202936, 1934917992,
+	1935631910, 1936344689, 1937056329, 1937766830, 1938476190, 1939184411, 1939891490, 1940597428,
+	1941302225, 1942005880, 1942708392, 1943409761, 1944109987, 1944809070, 1945507008, 1946203802,
+	1946899451, 1947593954, 1948287312, 1948979524, 1949670589, 1950360508, 1951049279, 1951736902,
+	1952423377, 1953108703, 1953792881, 1954475909, 1955157788, 1955838516, 1956518093, 1957196520,
+	1957873796, 1958549919, 1959224890, 1959898709, 1960571375, 1961242888, 1961913246, 1962582451,
+	1963250501, 1963917396, 1964583136, 1965247720, 1965911148, 1966573420, 1967234535, 1967894492,
+	1968553292, 1969210933, 1969867417, 1970522741, 1971176906, 1971829912, 1972481757, 1973132443,
+	1973781967, 1974430331, 1975077532, 1975723572, 1976368450, 1977012165, 1977654717, 1978296106,
+	1978936331, 1979575392, 1980213288, 1980850019, 1981485585, 1982119985, 1982753220, 1983385288,
+	1984016189, 1984645923, 1985274489, 1985901888, 1986528118, 1987153180, 1987777073, 1988399796,
+	1989021350, 1989641733, 1990260946, 1990878989, 1991495860, 1992111559, 1992726087, 1993339442,
+	1993951625, 1994562635, 1995172471, 1995781134, 1996388622, 1996994937, 1997600076, 1998204040,
+	1998806829, 1999408442, 2000008879, 2000608139, 2001206222, 2001803128, 2002398857, 2002993407,
+	2003586779, 2004178973, 2004769987, 2005359822, 2005948478, 2006535953, 2007122248, 2007707362,
+	2008291295, 2008874047, 2009455617, 2010036005, 2010615210, 2011193233, 2011770073, 2012345729,
+	2012920201, 2013493489, 2014065592, 2014636511, 2015206245, 2015774793, 2016342155, 2016908331,
+	2017473321, 2018037123, 2018599739, 2019161167, 2019721407, 2020280460, 2020838323, 2021394998,
+	2021950484, 2022504780, 2023057887, 2023609803, 2024160529, 2024710064, 2025258408, 2025805561,
+	2026351522, 2026896291, 2027439867, 2027982251, 2028523442, 2029063439, 2029602243, 2030139853,
+	2030676269, 2031211490, 2031745516, 2032278347, 2032809982, 2033340422, 2033869665, 2034397712,
+	2034924562, 2035450215, 2035974670, 2036497928, 2037019988, 2037540850, 2038060512, 2038578976,
+	2039096241, 2039612306, 2040127172, 2040640837, 2041153301, 2041664565, 2042174628, 2042683490,
+	2043191150, 2043697608, 2044202863, 2044706916, 2045209767, 2045711414, 2046211857, 2046711097,
+	2047209133, 2047705965, 2048201592, 2048696014, 2049189231, 2049681242, 2050172048, 2050661647,
+	2051150040, 2051637227, 2052123207, 2052607979, 2053091544, 2053573901, 2054055050, 2054534991,
+	2055013723, 2055491246, 2055967560, 2056442665, 2056916560, 2057389244, 2057860719, 2058330983,
+	2058800036, 2059267877, 2059734508, 2060199927, 2060664133, 2061127128, 2061588910, 2062049479,
+	2062508835, 2062966978, 2063423908, 2063879623, 2064334124, 2064787411, 2065239484, 2065690341,
+	2066139983, 2066588410, 2067035621, 2067481616, 2067926394, 2068369957, 2068812302, 2069253430,
+	2069693342, 2070132035, 2070569511, 2071005769, 2071440808, 2071874629, 2072307231, 2072738614,
+	2073168777, 2073597721, 2074025446, 2074451950, 2074877233, 2075301296, 2075724139, 2076145760,
+	2076566160, 2076985338, 2077403294, 2077820028, 2078235540, 2078649830, 2079062896, 2079474740,
+	2079885360, 2080294757, 2080702930, 2081109879, 2081515603, 2081920103, 2082323379, 2082725429,
+	2083126254, 2083525854, 2083924228, 2084321376, 2084717298, 2085111994, 2085505463, 2085897705,
+	2086288720, 2086678508, 2087067068, 2087454400, 2087840505, 2088225381, 2088609029, 2088991448,
+	2089372638, 2089752599, 2090131331, 2090508833, 2090885105, 2091260147, 2091633960, 2092006541,
+	2092377892, 2092748012, 2093116901, 2093484559, 2093850985, 2094216179, 2094580142, 2094942872,
+	2095304370, 2095664635, 2096023667, 2096381466, 2096738032, 2097093365, 2097447464, 2097800329,
+	2098151960, 2098502357, 2098851519, 2099199446, 2099546139, 2099891596, 2100235819, 2100578805,
+	2100920556, 2101261071, 2101600350, 2101938393, 2102275199, 2102610768, 2102945101, 2103278196,
+	2103610054, 2103940674, 2104270057, 2104598202, 2104925109, 2105250778, 2105575208, 2105898399,
+	2106220352, 2106541065, 2106860540, 2107178775, 2107495770, 2107811526, 2108126041, 2108439317,
+	2108751352, 2109062146, 2109371700, 2109680013, 2109987085, 2110292916, 2110597505, 2110900853,
+	2111202959, 2111503822, 2111803444, 2112101824, 2112398960, 2112694855, 2112989506, 2113282914,
+	2113575080, 2113866001, 2114155680, 2114444114, 2114731305, 2115017252, 2115301954, 2115585412,
+	2115867626, 2116148595, 2116428319, 2116706797, 2116984031, 2117260020, 2117534762, 2117808259,
+	2118080511, 2118351516, 2118621275, 2118889788, 2119157054, 2119423074, 2119687847, 2119951372,
+	2120213651, 2120474683, 2120734467, 2120993003, 2121250292, 2121506333, 2121761126, 2122014670,
+	2122266967, 2122518015, 2122767814, 2123016364, 2123263666, 2123509718, 2123754522, 2123998076,
+	2124240380, 2124481435, 2124721240, 2124959795, 2125197100, 2125433155, 2125667960, 2125901514,
+	2126133817, 2126364870, 2126594672, 2126823222, 2127050522, 2127276570, 2127501367, 2127724913,
+	2127947206, 2128168248, 2128388038, 2128606576, 2128823862, 2129039895, 2129254676, 2129468204,
+	2129680480, 2129891502, 2130101272, 2130309789, 2130517052, 2130723062, 2130927819, 2131131322,
+	2131333572, 2131534567, 2131734309, 2131932796, 2132130030, 2132326009, 2132520734, 2132714204,
+	2132906420, 2133097381, 2133287087, 2133475538, 2133662734, 2133848675, 2134033361, 2134216791,
+	2134398966, 2134579885, 2134759548, 2134937956, 2135115107, 2135291003, 2135465642, 2135639026,
+	2135811153, 2135982023, 2136151637, 2136319994, 2136487095, 2136652938, 2136817525, 2136980855,
+	2137142927, 2137303743, 2137463301, 2137621601, 2137778644, 2137934430, 2138088958, 2138242228,
+	2138394240, 2138544994, 2138694490, 2138842728, 2138989708, 2139135429, 2139279892, 2139423097,
+	2139565043, 2139705730, 2139845159, 2139983329, 2140120240, 2140255892, 2140390284, 2140523418,
+	2140655293, 2140785908, 2140915264, 2141043360, 2141170197, 2141295774, 2141420092, 2141543150,
+	2141664948, 2141785486, 2141904764, 2142022783, 2142139541, 2142255039, 2142369276, 2142482254,
+	2142593971, 2142704427, 2142813624, 2142921559, 2143028234, 2143133648, 2143237802, 2143340694,
+	2143442326, 2143542697, 2143641807, 2143739656, 2143836244, 2143931570, 2144025635, 2144118439,
+	2144209982, 2144300264, 2144389283, 2144477042, 2144563539, 2144648774, 2144732748, 2144815460,
+	2144896910, 2144977098, 2145056025, 2145133690, 2145210092, 2145285233, 2145359112, 2145431729,
+	2145503083, 2145573176, 2145642006, 2145709574, 2145775880, 2145840924, 2145904705, 2145967224,
+	2146028480, 2146088474, 2146147205, 2146204674, 2146260881, 2146315824, 2146369505, 2146421924,
+	2146473080, 2146522973, 2146571603, 2146618971, 2146665076, 2146709917, 2146753497, 2146795813,
+	2146836866, 2146876656, 2146915184, 2146952448, 2146988450, 2147023188, 2147056664, 2147088876,
+	2147119825, 2147149511, 2147177934, 2147205094, 2147230991, 2147255625, 2147278995, 2147301102,
+	2147321946, 2147341527, 2147359845, 2147376899, 2147392690, 2147407218, 2147420483, 2147432484,
+	2147443222, 2147452697, 2147460908, 2147467857, 2147473542, 2147477963, 2147481121, 2147483016,
+	2147483647
+};
+
+
+/*******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+void VorbisDecoder_Init(void)
+{
+	playing = NULL;
+	incoming = NULL;
+	spectrum = AudioDecoder_GetScratch();
+	centerCancel = false;
+}
+
+
+bool VorbisDecoder_LoadFile(decoder_stream_t stream, const char* filename)
+{
+	VorbisDecoder_Close(stream);
+
+	// Another codec may have used the memory. The overlap is not read before the first block, nor the arena and
+	// the ring before they are written
+	vorbisStream_t * st = AudioDecoder_GetStreamMemory(stream);
+	memset(st, 0, offsetof(vorbisStream_t, overlap));
+
+	if (f_open(&st->file, _T(filename), FA_READ) != FR_OK)
+	{
+		return false;
+	}
+
+	st->dataEnd = f_size(&st->file);
+	st->serialKnown = false;
+	st->lastPage = false;
+	st->resync = false;
+	st->segmentCount = 0;
+	st->segmentIndex = 0;
+	st->segmentLeft = 0;
+	st->lastSegment = true;
+	st->arenaUsed = 0;
+	memset(st->tags, 0, sizeof(st->tags));
+	seekAligned(st, 0);
+
+	// The three headers, each one a packet of its own
+	if (!beginPacket(st) || !parseIdentification(st) ||
+		!beginPacket(st) || !parseComments(st) ||
+		!beginPacket(st) || !parseSetup(st) || !computeWindows(st) || !finishPacket(st))
+	{
+		f_close(&st->file);
+		return false;
+	}
+
+	// The audio starts with the next page, or in this one if the setup did not end it
+	st->dataStart = (st->segmentIndex >= st->segmentCount) ? st->position : st->pageStart;
+
+	findLastGranule(st);
+
+	st->fileIsOpened = true;
+	st->previousHalf = 0;
+	st->sample = 0;
+	st->sampleKnown = true;
+	st->seekTarget = 0;
+	st->skipSamples = 0;
+
+	if (stream == DECODER_PLAYING_STREAM)
+	{
+		playing = st;
+	}
+	else
+	{
+		incoming = st;
+	}
+	return true;
+}
+
+
+decoder_result_t VorbisDecoder_DecodeFrame(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate)
+{
+	vorbisStream_t * st = (stream == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	*numSamplesDecoded = 0;
+	*sampleRate = 0;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return DECODER_NO_FILE;
+	}
+	if (decodedBufferSize < st->blockSizes[1] / 2U)
+	{
+		return DECODER_OVERFLOW;
+	}
+
+	for (;;)
+	{
+		if (st->sampleKnown && st->totalSamples && (st->sample >= st->totalSamples))
+		{
+			return DECODER_END_OF_FILE;
+		}
+		if (!beginPacket(st))
+		{
+			return DECODER_END_OF_FILE;
+		}
+
+		int32_t frames = decodeAudioPacket(st, decodedDataBuffer);
+		if (frames < 0)
+		{
+			// Not audio or damaged, on to the next one
+			continue;
+		}
+
+		if (!st->sampleKnown)
+		{
+			// After a seek: dropped until a page ends, its granule position is the sample number from then on
+			if (st->packetGranule != OGG_NO_GRANULE)
+			{
+				if (st->packetGranule > st->seekTarget)
+				{
+					// The packets that end in that page started before it (they were skipped), one page back
+					seekToSample(st, st->seekTarget, st->seekGranule - 1);	// Not 0, that restarts at dataStart
+					continue;
+				}
+				st->sample = st->packetGranule;
+				st->sampleKnown = true;
+				st->skipSamples = (st->seekTarget > st->sample) ? (uint32_t)(st->seekTarget - st->sample) : 0;
+			}
+			continue;
+		}
+
+		// The last page says where the song ends, inside its last block
+		if (st->totalSamples && (st->sample + frames > st->totalSamples))
+		{
+			frames = (int32_t)(st->totalSamples - st->sample);
+		}
+		st->sample += frames;
+
+		uint32_t skip = ((uint32_t)frames < st->skipSamples) ? (uint32_t)frames : st->skipSamples;
+		st->skipSamples -= skip;
+		frames -= skip;
+
+		if (frames > 0)
+		{
+			if (skip)
+			{
+				memmove(decodedDataBuffer, decodedDataBuffer + skip, frames * sizeof(short));
+			}
+			*numSamplesDecoded = frames;
+			*sampleRate = st->sampleRate;
+			return DECODER_WORKED;
+		}
+	}
+}
+
+
+bool VorbisDecoder_ReadAhead(void)
+{
+	bool res = false;
+
+	if (playing && playing->fileIsOpened)
+	{
+		res = (fillRing(playing) != 0);
+	}
+	if (!res && incoming && incoming->fileIsOpened)
+	{
+		res = (fillRing(incoming) != 0);
+	}
+	return res;
+}
+
+
+void VorbisDecoder_Close(decoder_stream_t stream)
+{
+	vorbisStream_t ** st = (stream == DECODER_PLAYING_STREAM) ? &playing : &incoming;
+
+	if (*st && (*st)->fileIsOpened)
+	{
+		f_close(&(*st)->file);
+		(*st)->fileIsOpened = false;
+	}
+
+	// The memory goes back to the decoder layer
+	*st = NULL;
+}
+
+
+/*******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+static bool parseIdentification(vorbisStream_t * st)
+{
+	if (!checkHeader(st, VORBIS_IDENTIFICATION) || (bitsRead(st, 32) != 0))
+	{
+		return false;
+	}
+
+	// Channels (8 bits), rate (32), maximum, nominal and minimum bitrates (32 each), block size exponents (4 each), framing bit
+	st->channels = bitsRead(st, 8);
+	st->sampleRate = bitsRead(st, 32);
+	bitsRead(st, 32);
+	bitsRead(st, 32);
+	bitsRead(st, 32);
+
+	uint32_t shortExponent = bitsRead(st, 4);
+	uint32_t longExponent = bitsRead(st, 4);
+
+	if (!bitsRead(st, 1) || bitsEnded(st) || !st->channels || (st->channels > VORBIS_MAX_CHANNELS) || !st->sampleRate ||
+		(shortExponent < 6) || (shortExponent > longExponent) || ((1U << longExponent) > VORBIS_MAX_BLOCKSIZE))
+	{
+		return false;
+	}
+
+	st->blockSizes[0] = 1U << shortExponent;
+	st->blockSizes[1] = 1U << longExponent;
+	return true;
+}
+
+
+static bool parseComments(vorbisStream_t * st)
+{
+	char text[VORBIS_TAG_SIZE + 16];
+
+	if (!checkHeader(st, VORBIS_COMMENT))
+	{
+		return false;
+	}
+
+	// Vendor string, then the number of comments. Every length is 32 bit little endian, as the bits are read
+	packetSkip(st, bitsRead(st, 32));
+	uint32_t count = bitsRead(st, 32);
+
+	for (uint32_t i = 0; (i < count) && (i < VORBIS_MAX_COMMENTS) && !bitsEnded(st); i++)
+	{
+		uint32_t commentLength = bitsRead(st, 32);
+		uint32_t textLength = (commentLength < sizeof(text) - 1) ? commentLength : (sizeof(text) - 1);
+
+		for (uint32_t c = 0; c < textLength; c++)
+		{
+			text[c] = bitsRead(st, 8);
+		}
+		text[textLength] = '\0';
+		packetSkip(st, commentLength - textLength);
+
+		// "NAME=value", the name is case insensitive
+		for (uint8_t t = 0; t < VORBIS_TAG_COUNT; t++)
+		{
+			const char * name = tagNames[t];
+			uint32_t n = 0;
+
+			while (name[n] && (toupper((unsigned char)text[n]) == name[n]))
+			{
+				n++;
+			}
+			if (!name[n] && (text[n] == '='))
+			{
+				strncpy(st->tags[t], &text[n + 1], VORBIS_TAG_SIZE - 1);
+				st->tags[t][VORBIS_TAG_SIZE - 1] = '\0';
+			}
+		}
+	}
+
+	// Damaged comments only cost the tags
+	return true;
+}
+
+
+static bool parseSetup(vorbisStream_t * st)
+{
+	if (!checkHeader(st, VORBIS_SETUP))
+	{
+		return false;
+	}
+
+	st->codebookCount = bitsRead(st, 8) + 1;
+	st->codebooks = arenaAlloc(st, st->codebookCount * sizeof(vorbisCodebook_t));
+	if (!st->codebooks)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < st->codebookCount; i++)
+	{
+		if (!parseCodebook(st, &st->codebooks[i]))
+		{
+			return false;
+		}
+	}
+
+	// Time domain transforms, placeholders
+	uint32_t count = bitsRead(st, 6) + 1;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (bitsRead(st, 16) != 0)
+		{
+			return false;
+		}
+	}
+
+	// Floors, type 1 only: floor 0 was replaced by it before libvorbis 1.0
+	st->floorCount = bitsRead(st, 6) + 1;
+	st->floors = arenaAlloc(st, st->floorCount * sizeof(vorbisFloor_t));
+	if (!st->floors)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < st->floorCount; i++)
+	{
+		if ((bitsRead(st, 16) != 1) || !parseFloor(st, &st->floors[i]))
+		{
+			return false;
+		}
+	}
+
+	st->residueCount = bitsRead(st, 6) + 1;
+	st->residues = arenaAlloc(st, st->residueCount * sizeof(vorbisResidue_t));
+	if (!st->residues)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < st->residueCount; i++)
+	{
+		st->residues[i].type = bitsRead(st, 16);
+		if ((st->residues[i].type > 2) || !parseResidue(st, &st->residues[i]))
+		{
+			return false;
+		}
+	}
+
+	st->mappingCount = bitsRead(st, 6) + 1;
+	st->mappings = arenaAlloc(st, st->mappingCount * sizeof(vorbisMapping_t));
+	if (!st->mappings)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < st->mappingCount; i++)
+	{
+		if ((bitsRead(st, 16) != 0) || !parseMapping(st, &st->mappings[i]))
+		{
+			return false;
+		}
+	}
+
+	// Modes: block size flag, window and transform types (0), mapping
+	st->modeCount = bitsRead(st, 6) + 1;
+	st->modeBits = ilog(st->modeCount - 1);
+	st->modes = arenaAlloc(st, st->modeCount * sizeof(vorbisMode_t));
+	if (!st->modes)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < st->modeCount; i++)
+	{
+		st->modes[i].blockFlag = bitsRead(st, 1);
+		if ((bitsRead(st, 16) != 0) || (bitsRead(st, 16) != 0))
+		{
+			return false;
+		}
+		st->modes[i].mapping = bitsRead(st, 8);
+		if (st->modes[i].mapping >= st->mappingCount)
+		{
+			return false;
+		}
+	}
+
+	// Framing bit
+	return bitsRead(st, 1) && !bitsEnded(st);
+}
+
+
+static bool parseCodebook(vorbisStream_t * st, vorbisCodebook_t * book)
+{
+	if (bitsRead(st, 24) != VORBIS_CODEBOOK_SYNC)
+	{
+		return false;
+	}
+
+	book->dimensions = bitsRead(st, 16);
+	book->entries = bitsRead(st, 24);
+
+	if (!book->dimensions || !book->entries || (book->entries > VORBIS_MAX_ENTRIES) ||
+		(st->arenaUsed + book->entries > VORBIS_ARENA_SIZE))
+	{
+		return false;
+	}
+
+	// Codeword lengths at the top of the arena, the tree grows from the bottom
+	uint8_t * lengths = st->arena + VORBIS_ARENA_SIZE - book->entries;
+
+	if (bitsRead(st, 1))
+	{
+		// Ordered: runs of entries of each length, from the shortest one
+		uint32_t entry = 0;
+		uint32_t length = bitsRead(st, 5) + 1;
+
+		while ((entry < book->entries) && !bitsEnded(st))
+		{
+			uint32_t number = bitsRead(st, ilog(book->entries - entry));
+
+			if ((entry + number > book->entries) || (length > 32))
+			{
+				return false;
+			}
+			memset(&lengths[entry], length, number);
+			entry += number;
+			length++;
+		}
+	}
+	else
+	{
+		// One length per entry, sparse ones flag the unused entries
+		bool sparse = bitsRead(st, 1);
+
+		for (uint32_t i = 0; i < book->entries; i++)
+		{
+			lengths[i] = (!sparse || bitsRead(st, 1)) ? (bitsRead(st, 5) + 1) : 0;
+		}
+	}
+
+	if (bitsEnded(st) || !buildTree(st, book, lengths))
+	{
+		return false;
+	}
+
+	book->lookupType = bitsRead(st, 4);
+	book->values = NULL;
+	book->lookupValues = 0;
+
+	if (book->lookupType == 0)
+	{
+		return !bitsEnded(st);
+	}
+	if (book->lookupType > 2)
+	{
+		return false;
+	}
+
+	// Minimum and delta as the spec's 32 bit floats (21 bit mantissa, 10 bit exponent biased by 788, sign), to Q8
+	int32_t floats[2];
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		uint32_t x = bitsRead(st, 32);
+		int32_t mantissa = x & 0x1FFFFF;
+		int32_t exponent = (int32_t)((x >> 21) & 0x3FF) - 788 + VORBIS_RESIDUE_FRAC;
+
+		if (exponent >= 10)
+		{
+			mantissa = INT32_MAX;
+		}
+		else if (exponent >= 0)
+		{
+			mantissa <<= exponent;
+		}
+		else
+		{
+			mantissa = (exponent > -32) ? (mantissa >> -exponent) : 0;
+		}
+		floats[i] = (x & 0x80000000) ? -mantissa : mantissa;
+	}
+
+	uint32_t valueBits = bitsRead(st, 4) + 1;
+	book->sequenceP = bitsRead(st, 1);
+	book->minimum = floats[0];
+
+	if (book->lookupType == 1)
+	{
+		// Largest count whose dimensions-th power is not more than the entries
+		uint32_t count = 1;
+		for (;;)
+		{
+			uint64_t power = 1;
+			for (uint32_t d = 0; (d < book->dimensions) && (power <= book->entries); d++)
+			{
+				power *= count + 1;
+			}
+			if (power > book->entries)
+			{
+				break;
+			}
+			count++;
+		}
+		book->lookupValues = count;
+	}
+	else
+	{
+		book->lookupValues = book->entries * book->dimensions;
+	}
+
+	book->values = arenaAlloc(st, book->lookupValues * sizeof(int32_t));
+	if (!book->values)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < book->lookupValues; i++)
+	{
+		book->values[i] = (int32_t)bitsRead(st, valueBits) * floats[1];
+	}
+
+	return !bitsEnded(st);
+}
+
+
+static bool buildTree(vorbisStream_t * st, vorbisCodebook_t * book, const uint8_t * lengths)
+{
+	uint32_t marker[33] = { 0 };		// Next free codeword of each length
+	uint32_t limit = VORBIS_ARENA_SIZE - book->entries;
+	int16_t * tree = (int16_t *)(st->arena + st->arenaUsed);
+	uint32_t nodes = 1;
+	uint32_t used = 0;
+	uint32_t last = 0;
+
+	if (st->arenaUsed + 2 * sizeof(int16_t) > limit)
+	{
+		return false;
+	}
+	tree[0] = 0;
+	tree[1] = 0;
+
+	for (uint32_t i = 0; i < book->entries; i++)
+	{
+		if (lengths[i])
+		{
+			used++;
+			last = i;
+		}
+	}
+
+	if (used == 1)
+	{
+		// A single entry, whatever its codeword is it takes one bit
+		tree[0] = tree[1] = -(int16_t)last - 1;
+	}
+	else
+	{
+		for (uint32_t i = 0; i < book->entries; i++)
+		{
+			uint32_t length = lengths[i];
+			if (!length)
+			{
+				continue;
+			}
+
+			uint32_t code = marker[length];
+			if ((length < 32) && (code >> length))
+			{
+				// Overpopulated
+				return false;
+			}
+
+			// The next codeword of this length and the shorter ones
+			for (uint32_t j = length; j > 0; j--)
+			{
+				if (marker[j] & 1)
+				{
+					if (j == 1)
+					{
+						marker[1]++;
+					}
+					else
+					{
+						marker[j] = marker[j - 1] << 1;
+					}
+					break;
+				}
+				marker[j]++;
+			}
+
+			// The longer ones were hanging from the codeword just taken, they hang from the new one now
+			uint32_t taken = code;
+			for (uint32_t j = length + 1; j < 33; j++)
+			{
+				if ((marker[j] >> 1) != taken)
+				{
+					break;
+				}
+				taken = marker[j];
+				marker[j] = marker[j - 1] << 1;
+			}
+
+			// Into the tree, MSB (the first bit read) first
+			uint32_t node = 0;
+			for (uint32_t bit = length - 1; bit > 0; bit--)
+			{
+				int16_t * child = &tree[2 * node + ((code >> bit) & 1)];
+
+				if (*child < 0)
+				{
+					return false;
+				}
+				if (*child == 0)
+				{
+					if ((st->arenaUsed + (nodes + 1) * 2 * sizeof(int16_t) > limit) || (nodes > INT16_MAX))
+					{
+						return false;
+					}
+					tree[2 * nodes] = 0;
+					tree[2 * nodes + 1] = 0;
+					*child = nodes++;
+				}
+				node = *child;
+			}
+
+			int16_t * leaf = &tree[2 * node + (code & 1)];
+			if (*leaf)
+			{
+				return false;
+			}
+			*leaf = -(int16_t)i - 1;
+		}
+	}
+
+	book->tree = tree;
+	st->arenaUsed += nodes * 2 * sizeof(int16_t);
+	return true;
+}
+
+
+static bool parseFloor(vorbisStream_t * st, vorbisFloor_t * floor)
+{
+	int32_t maxClass = -1;
+
+	floor->partitions = bitsRead(st, 5);
+	for (uint32_t i = 0; i < floor->partitions; i++)
+	{
+		floor->partitionClass[i] = bitsRead(st, 4);
+		if (floor->partitionClass[i] > maxClass)
+		{
+			maxClass = floor->partitionClass[i];
+		}
+	}
+
+	// Per class: dimensions, subclass bits, master book if there are subclasses, then a book per subclass (-1 for none)
+	for (int32_t c = 0; c <= maxClass; c++)
+	{
+		floor->classDimensions[c] = bitsRead(st, 3) + 1;
+		floor->classSubclasses[c] = bitsRead(st, 2);
+
+		if (floor->classSubclasses[c])
+		{
+			floor->classMasterbook[c] = bitsRead(st, 8);
+			if (floor->classMasterbook[c] >= st->codebookCount)
+			{
+				return false;
+			}
+		}
+		for (uint32_t j = 0; j < (1U << floor->classSubclasses[c]); j++)
+		{
+			floor->subclassBooks[c][j] = (int16_t)bitsRead(st, 8) - 1;
+			if (floor->subclassBooks[c][j] >= st->codebookCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	floor->multiplier = bitsRead(st, 2) + 1;
+	uint32_t rangeBits = bitsRead(st, 4);
+
+	floor->x[0] = 0;
+	floor->x[1] = 1U << rangeBits;
+	floor->values = 2;
+
+	for (uint32_t i = 0; i < floor->partitions; i++)
+	{
+		for (uint32_t j = 0; j < floor->classDimensions[floor->partitionClass[i]]; j++)
+		{
+			if (floor->values >= VORBIS_FLOOR1_VALUES)
+			{
+				return false;
+			}
+			floor->x[floor->values++] = bitsRead(st, rangeBits);
+		}
+	}
+
+	// X order (insertion sort, 65 at most) and the neighbors of each value among the ones before it
+	for (uint32_t i = 0; i < floor->values; i++)
+	{
+		uint32_t j = i;
+		while ((j > 0) && (floor->x[floor->sorted[j - 1]] > floor->x[i]))
+		{
+			floor->sorted[j] = floor->sorted[j - 1];
+			j--;
+		}
+		floor->sorted[j] = i;
+	}
+	for (uint32_t i = 1; i < floor->values; i++)
+	{
+		if (floor->x[floor->sorted[i]] == floor->x[floor->sorted[i - 1]])
+		{
+			return false;
+		}
+	}
+	for (uint32_t i = 2; i < floor->values; i++)
+	{
+		uint32_t low = 0;
+		uint32_t high = 1;
+
+		for (uint32_t j = 0; j < i; j++)
+		{
+			if ((floor->x[j] < floor->x[i]) && (floor->x[j] > floor->x[low]))
+			{
+				low = j;
+			}
+			if ((floor->x[j] > floor->x[i]) && (floor->x[j] < floor->x[high]))
+			{
+				high = j;
+			}
+		}
+		floor->lowNeighbor[i] = low;
+		floor->highNeighbor[i] = high;
+	}
+
+	return !bitsEnded(st);
+}
+
+
+static bool parseResidue(vorbisStream_t * st, vorbisResidue_t * residue)
+{
+	uint8_t cascade[64];
+
+	residue->begin = bitsRead(st, 24);
+	residue->end = bitsRead(st, 24);
+	residue->partitionSize = bitsRead(st, 24) + 1;
+	residue->classifications = bitsRead(st, 6) + 1;
+	residue->classbook = bitsRead(st, 8);
+
+	if (residue->classbook >= st->codebookCount)
+	{
+		return false;
+	}
+
+	// The partitions of the longest residue vector must fit in partitionClasses
+	uint32_t end = (residue->end < VORBIS_MAX_CHANNELS * VORBIS_MAX_HALF) ? residue->end : (VORBIS_MAX_CHANNELS * VORBIS_MAX_HALF);
+	if ((end > residue->begin) && ((end - residue->begin) / residue->partitionSize > VORBIS_MAX_PARTITIONS))
+	{
+		return false;
+	}
+
+	// Which of the 8 passes have a book, per classification
+	for (uint32_t i = 0; i < residue->classifications; i++)
+	{
+		uint32_t low = bitsRead(st, 3);
+		uint32_t high = bitsRead(st, 1) ? bitsRead(st, 5) : 0;
+		cascade[i] = (high << 3) | low;
+	}
+
+	residue->books = arenaAlloc(st, residue->classifications * 8 * sizeof(int16_t));
+	if (!residue->books)
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < residue->classifications; i++)
+	{
+		for (uint32_t pass = 0; pass < 8; pass++)
+		{
+			int16_t book = -1;
+			if (cascade[i] & (1U << pass))
+			{
+				book = bitsRead(st, 8);
+				if ((book >= st->codebookCount) || !st->codebooks[book].values)
+				{
+					return false;
+				}
+			}
+			residue->books[i * 8 + pass] = book;
+		}
+	}
+
+	return !bitsEnded(st);
+}
+
+
+static bool parseMapping(vorbisStream_t * st, vorbisMapping_t * mapping)
+{
+	mapping->submaps = bitsRead(st, 1) ? (bitsRead(st, 4) + 1) : 1;
+	mapping->couplingSteps = 0;
+
+	if (bitsRead(st, 1))
+	{
+		uint32_t steps = bitsRead(st, 8) + 1;
+		uint32_t bits = ilog(st->channels - 1);
+
+		if (steps > VORBIS_MAX_COUPLING)
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < steps; i++)
+		{
+			mapping->magnitude[i] = bitsRead(st, bits);
+			mapping->angle[i] = bitsRead(st, bits);
+
+			if ((mapping->magnitude[i] == mapping->angle[i]) ||
+				(mapping->magnitude[i] >= st->channels) || (mapping->angle[i] >= st->channels))
+			{
+				return false;
+			}
+		}
+		mapping->couplingSteps = steps;
+	}
+
+	// Reserved
+	if (bitsRead(st, 2) != 0)
+	{
+		return false;
+	}
+
+	for (uint32_t ch = 0; ch < st->channels; ch++)
+	{
+		mapping->mux[ch] = (mapping->submaps > 1) ? bitsRead(st, 4) : 0;
+		if (mapping->mux[ch] >= mapping->submaps)
+		{
+			return false;
+		}
+	}
+
+	// Per submap: time configuration (unused), floor and residue
+	for (uint32_t i = 0; i < mapping->submaps; i++)
+	{
+		bitsRead(st, 8);
+		mapping->submapFloor[i] = bitsRead(st, 8);
+		mapping->submapResidue[i] = bitsRead(st, 8);
+
+		if ((mapping->submapFloor[i] >= st->floorCount) || (mapping->submapResidue[i] >= st->residueCount))
+		{
+			return false;
+		}
+	}
+
+	return !bitsEnded(st);
+}
+
+
+static bool checkHeader(vorbisStream_t * st, uint8_t type)
+{
+	static const char name[] = "vorbis";
+
+	if (bitsRead(st, 8) != type)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < sizeof(name) - 1; i++)
+	{
+		if (bitsRead(st, 8) != (uint8_t)name[i])
+		{
+			return false;
+		}
+	}
+	return !bitsEnded(st);
+}
+
+
+static void * arenaAlloc(vorbisStream_t * st, uint32_t bytes)
+{
+	bytes = (bytes + 3) & ~3U;
+
+	if (bytes > VORBIS_ARENA_SIZE - st->arenaUsed)
+	{
+		return NULL;
+	}
+
+	void * memory = st->arena + st->arenaUsed;
+	st->arenaUsed += bytes;
+	return memory;
+}
+
+
+static bool computeWindows(vorbisStream_t * st)
+{
+	for (uint8_t b = 0; b < 2; b++)
+	{
+		uint32_t length = st->blockSizes[b] / 2;
+
+		st->windows[b] = arenaAlloc(st, length * sizeof(int32_t));
+		if (!st->windows[b])
+		{
+			return false;
+		}
+
+		// sin(pi / 2 * sin^2((k + 0.5) / length * pi / 2)), the inner angle is right on the table
+		for (uint32_t k = 0; k < length; k++)
+		{
+			int32_t s = sineTable[(2 * k + 1) * (SINE_HALF_BLOCK / length)];
+			st->windows[b][k] = sineQuarter(MULT31(s, s));
+		}
+	}
+	return true;
+}
+
+
+static void findLastGranule(vorbisStream_t * st)
+{
+	uint8_t * buffer = (uint8_t *)spectrum;
+	uint32_t end = st->dataEnd;
+
+	st->totalSamples = 0;
+
+	// Backwards a buffer at a time, overlapping by a header so none is cut. Whole sectors from a sector on,
+	// so FatFs reads them straight into the buffer
+	while ((end > st->dataStart) && (st->dataEnd - end < VORBIS_TAIL_SEARCH))
+	{
+		uint32_t first = (end - st->dataStart > AUDIO_DECODER_SCRATCH_SIZE - FILE_SECTOR_SIZE) ?
+						 (end - AUDIO_DECODER_SCRATCH_SIZE + FILE_SECTOR_SIZE) : st->dataStart;
+		uint32_t start = first & ~(FILE_SECTOR_SIZE - 1);
+		uint32_t length = (end - start + FILE_SECTOR_SIZE - 1) & ~(FILE_SECTOR_SIZE - 1);
+		UINT bytesRead = 0;
+
+		f_lseek(&st->file, start);
+		if ((f_read(&st->file, buffer, length, &bytesRead) != FR_OK) || (bytesRead < end - start))
+		{
+			break;
+		}
+
+		for (int32_t i = (int32_t)(end - start) - OGG_HEADER_BYTES; i >= (int32_t)(first - start); i--)
+		{
+			const uint8_t * h = &buffer[i];
+			uint64_t granule = 0;
+
+			if ((memcmp(h, "OggS", 4) != 0) || h[4] ||
+				((h[14] | (h[15] << 8) | (h[16] << 16) | ((uint32_t)h[17] << 24)) != st->serial))
+			{
+				continue;
+			}
+			for (int8_t b = 7; b >= 0; b--)
+			{
+				granule = (granule << 8) | h[6 + b];
+			}
+			if (granule != OGG_NO_GRANULE)
+			{
+				st->totalSamples = granule;
+				end = st->dataStart;
+				break;
+			}
+		}
+
+		if (end > st->dataStart)
+		{
+			end = (first > st->dataStart) ? (first + OGG_HEADER_BYTES) : st->dataStart;
+		}
+	}
+
+	// Back to where the ring was reading
+	f_lseek(&st->file, st->readPosition);
+}
+
+
+static bool findPage(vorbisStream_t * st, uint32_t from, uint32_t limit, uint32_t * page, uint64_t * granule)
+{
+	uint8_t * buffer = (uint8_t *)spectrum;
+
+	while (from < limit)
+	{
+		// From the sector of from, so FatFs reads the chunk straight into the buffer
+		uint32_t sector = from & ~(FILE_SECTOR_SIZE - 1);
+		UINT bytesRead = 0;
+
+		f_lseek(&st->file, sector);
+		if ((f_read(&st->file, buffer, VORBIS_SEEK_CHUNK, &bytesRead) != FR_OK) ||
+			(bytesRead < from - sector + OGG_HEADER_BYTES))
+		{
+			return false;
+		}
+
+		uint32_t i = from - sector;
+		for (; (i + OGG_HEADER_BYTES <= bytesRead) && (sector + i < limit); i++)
+		{
+			const uint8_t * h = &buffer[i];
+
+			if ((memcmp(h, "OggS", 4) != 0) || h[4] ||
+				((h[14] | (h[15] << 8) | (h[16] << 16) | ((uint32_t)h[17] << 24)) != st->serial))
+			{
+				continue;
+			}
+
+			uint64_t value = 0;
+			for (int8_t b = 7; b >= 0; b--)
+			{
+				value = (value << 8) | h[6 + b];
+			}
+			if (value != OGG_NO_GRANULE)
+			{
+				*page = sector + i;
+				*granule = value;
+				return true;
+			}
+		}
+
+		if (bytesRead < VORBIS_SEEK_CHUNK)
+		{
+			return false;
+		}
+		from = sector + i;
+	}
+	return false;
+}
+
+
+static void seekToSample(vorbisStream_t * st, uint64_t target, uint64_t limit)
+{
+	uint32_t low = st->dataStart;
+	uint32_t high = st->dataEnd;
+	uint64_t lowGranule = 0;
+	uint32_t page;
+	uint64_t granule;
+
+	// The last page that ends before the limit: bisection, then the few pages left one by one
+	while (high - low > VORBIS_SEEK_STOP)
+	{
+		uint32_t middle = low + (high - low) / 2;
+
+		if (findPage(st, middle, high, &page, &granule) && (granule <= limit))
+		{
+			low = page;
+			lowGranule = granule;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	while (findPage(st, low + 1, st->dataEnd, &page, &granule) && (granule <= limit))
+	{
+		low = page;
+		lowGranule = granule;
+	}
+	if (!lowGranule)
+	{
+		// Nothing was output before it, from the start
+		low = st->dataStart;
+	}
+
+	// From there, the packet that ends in it primes the overlap and its granule position gives the sample number
+	seekAligned(st, low);
+	st->segmentCount = 0;
+	st->segmentIndex = 0;
+	st->segmentLeft = 0;
+	st->lastSegment = true;
+	st->lastPage = false;
+	st->resync = true;
+	st->previousHalf = 0;
+	st->seekTarget = target;
+	st->seekGranule = lowGranule;
+
+	if (low == st->dataStart)
+	{
+		st->sample = 0;
+		st->sampleKnown = true;
+		st->skipSamples = (uint32_t)target;
+	}
+	else
+	{
+		st->sampleKnown = false;
+		st->skipSamples = 0;
+	}
+}
+
+
+static uint32_t fillRing(vorbisStream_t * st)
+{
+	uint32_t totalBytesRead = 0;
+
+	while (!st->fileEnded && (st->readPosition < st->dataEnd))
+	{
+		// Whole sectors, up to the sector of the next byte (still in use) or the end of the ring
+		uint32_t ringIndex = st->readPosition & VORBIS_RING_MASK;
+		uint32_t bytesToRead = VORBIS_RING_SIZE - (st->readPosition - (st->position & ~(FILE_SECTOR_SIZE - 1)));
+
+		if (bytesToRead > VORBIS_RING_SIZE - ringIndex)
+		{
+			bytesToRead = VORBIS_RING_SIZE - ringIndex;
+		}
+
+		if (bytesToRead < FILE_SECTOR_SIZE)
+		{
+			break;
+		}
+
+		UINT bytesRead = 0;
+		if (f_read(&st->file, &st->ring[ringIndex], bytesToRead, &bytesRead) != FR_OK)
+		{
+			bytesRead = 0;
+		}
+
+		st->readPosition += bytesRead;
+		totalBytesRead += bytesRead;
+		st->fileEnded = (bytesRead < bytesToRead);
+	}
+
+	return totalBytesRead;
+}
+
+
+static void seekAligned(vorbisStream_t * st, uint32_t filePosition)
+{
+	uint32_t sectorStart = filePosition & ~(FILE_SECTOR_SIZE - 1);
+
+	f_lseek(&st->file, sectorStart);
+
+	st->readPosition = sectorStart;
+	st->position = filePosition;
+	st->fileEnded = false;
+}
+
+
+static int32_t ringByte(vorbisStream_t * st)
+{
+	if ((st->position >= st->readPosition) && (!fillRing(st) || (st->position >= st->readPosition)))
+	{
+		return -1;
+	}
+	return RING_BYTE(st, st->position++);
+}
+
+
+static void ringSkip(vorbisStream_t * st, uint32_t count)
+{
+	st->position += count;
+
+	if (st->position > st->readPosition)
+	{
+		seekAligned(st, st->position);
+	}
+}
+
+
+static bool readPageHeader(vorbisStream_t * st)
+{
+	uint8_t header[OGG_HEADER_BYTES];
+
+	if (st->lastPage)
+	{
+		return false;
+	}
+
+	for (uint32_t scanned = 0; ; scanned++)
+	{
+		uint32_t start = st->position;
+
+		if ((scanned >= VORBIS_SYNC_SEARCH) || (start + OGG_HEADER_BYTES > st->dataEnd))
+		{
+			return false;
+		}
+		if (st->readPosition < start + OGG_HEADER_BYTES)
+		{
+			fillRing(st);
+			if (st->readPosition < start + OGG_HEADER_BYTES)
+			{
+				return false;
+			}
+		}
+
+		for (uint32_t i = 0; i < OGG_HEADER_BYTES; i++)
+		{
+			header[i] = RING_BYTE(st, start + i);
+		}
+
+		// The page CRC is not checked, pages can be longer than the ring. Codewords and modes out of range drop a damaged packet
+		if ((memcmp(header, "OggS", 4) == 0) && (header[4] == 0))
+		{
+			break;
+		}
+
+		// Lost: the packet being read is gone, on to the next capture pattern
+		st->position = start + 1;
+		st->resync = true;
+	}
+
+	uint32_t serial = header[14] | (header[15] << 8) | (header[16] << 16) | ((uint32_t)header[17] << 24);
+	if (!st->serialKnown)
+	{
+		st->serial = serial;
+		st->serialKnown = true;
+	}
+	else if (serial != st->serial)
+	{
+		// A chained or multiplexed stream, ours ends here
+		return false;
+	}
+
+	st->pageGranule = 0;
+	for (int8_t b = 7; b >= 0; b--)
+	{
+		st->pageGranule = (st->pageGranule << 8) | header[6 + b];
+	}
+	st->lastPage = (header[5] & OGG_LAST_PAGE) != 0;
+	st->pageStart = st->position;
+	st->segmentCount = header[26];
+	st->segmentIndex = 0;
+	st->lastPacketSegment = -1;
+	st->position += OGG_HEADER_BYTES;
+
+	for (uint32_t i = 0; i < st->segmentCount; i++)
+	{
+		int32_t lacing = ringByte(st);
+		if (lacing < 0)
+		{
+			return false;
+		}
+		st->segments[i] = lacing;
+		if (lacing < 255)
+		{
+			st->lastPacketSegment = i;
+		}
+	}
+
+	if (st->resync)
+	{
+		// Whatever continues from the previous page was already lost
+		if (header[5] & OGG_CONTINUED)
+		{
+			while (st->segmentIndex < st->segmentCount)
+			{
+				uint8_t lacing = st->segments[st->segmentIndex++];
+				ringSkip(st, lacing);
+				if (lacing < 255)
+				{
+					st->resync = false;
+					break;
+				}
+			}
+		}
+		else
+		{
+			st->resync = false;
+		}
+	}
+
+	return true;
+}
+
+
+static bool nextSegment(vorbisStream_t * st)
+{
+	while (st->segmentIndex >= st->segmentCount)
+	{
+		if (!readPageHeader(st))
+		{
+			return false;
+		}
+	}
+
+	if (st->segmentIndex == st->lastPacketSegment)
+	{
+		// The packet ends here and it is the last one of the page
+		st->packetGranule = st->pageGranule;
+	}
+
+	uint8_t lacing = st->segments[st->segmentIndex++];
+	st->segmentLeft = lacing;
+	st->lastSegment = (lacing < 255);
+	return true;
+}
+
+
+static bool finishPacket(vorbisStream_t * st)
+{
+	while (!st->lastSegment || st->segmentLeft)
+	{
+		ringSkip(st, st->segmentLeft);
+		st->segmentLeft = 0;
+
+		if (!st->lastSegment && !nextSegment(st))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static bool beginPacket(vorbisStream_t * st)
+{
+	if (!finishPacket(st))
+	{
+		return false;
+	}
+
+	st->packetGranule = OGG_NO_GRANULE;
+	st->bitCache = 0;
+	st->bitCount = 0;
+	st->padBits = 0;
+
+	return nextSegment(st);
+}
+
+
+static int32_t packetByte(vorbisStream_t * st)
+{
+	while (!st->segmentLeft)
+	{
+		if (st->lastSegment || !nextSegment(st))
+		{
+			st->lastSegment = true;
+			return -1;
+		}
+	}
+
+	st->segmentLeft--;
+	return ringByte(st);
+}
+
+
+static void packetSkip(vorbisStream_t * st, uint32_t count)
+{
+	// What is in the cache first
+	while (count && (st->bitCount >= 8))
+	{
+		bitsRead(st, 8);
+		count--;
+	}
+
+	while (count)
+	{
+		if (!st->segmentLeft)
+		{
+			if (st->lastSegment || !nextSegment(st))
+			{
+				st->lastSegment = true;
+				st->padBits += 8;
+				return;
+			}
+			continue;
+		}
+
+		uint32_t bytes = (count < st->segmentLeft) ? count : st->segmentLeft;
+		ringSkip(st, bytes);
+		st->segmentLeft -= bytes;
+		count -= bytes;
+	}
+}
+
+
+static void bitsFill(vorbisStream_t * st)
+{
+	while (st->bitCount <= 24)
+	{
+		int32_t byte = packetByte(st);
+
+		if (byte < 0)
+		{
+			// Zeros past the end, bitsEnded tells if they were used
+			byte = 0;
+			st->padBits += 8;
+		}
+		st->bitCache |= (uint32_t)byte << st->bitCount;
+		st->bitCount += 8;
+	}
+}
+
+
+static uint32_t bitsRead(vorbisStream_t * st, uint32_t n)
+{
+	if (n > 24)
+	{
+		uint32_t low = bitsRead(st, 16);
+		return low | (bitsRead(st, n - 16) << 16);
+	}
+	if (!n)
+	{
+		return 0;
+	}
+
+	if (st->bitCount < n)
+	{
+		bitsFill(st);
+	}
+
+	uint32_t value = st->bitCache & ((1U << n) - 1);
+	st->bitCache >>= n;
+	st->bitCount -= n;
+	return value;
+}
+
+
+static inline bool bitsEnded(const vorbisStream_t * st)
+{
+	return st->padBits > st->bitCount;
+}
+
+
+static int32_t decodeEntry(vorbisStream_t * st, const vorbisCodebook_t * book)
+{
+	const int16_t * tree = book->tree;
+	int32_t node = 0;
+
+	do
+	{
+		if (!st->bitCount)
+		{
+			bitsFill(st);
+		}
+		node = tree[2 * node + (st->bitCache & 1)];
+		st->bitCache >>= 1;
+		st->bitCount--;
+	} while (node > 0);
+
+	if (!node || bitsEnded(st))
+	{
+		return -1;
+	}
+	return -node - 1;
+}
+
+
+static int32_t decodeAudioPacket(vorbisStream_t * st, short * out)
+{
+	bool floorUsed[VORBIS_MAX_CHANNELS];
+	bool skip[VORBIS_MAX_CHANNELS];
+
+	// Audio packets start with a 0, the mode number follows
+	if (bitsRead(st, 1))
+	{
+		return -1;
+	}
+	uint32_t modeNumber = bitsRead(st, st->modeBits);
+	if (bitsEnded(st) || (modeNumber >= st->modeCount))
+	{
+		return -1;
+	}
+
+	const vorbisMode_t * mode = &st->modes[modeNumber];
+	const vorbisMapping_t * mapping = &st->mappings[mode->mapping];
+	uint32_t half = st->blockSizes[mode->blockFlag] / 2;
+	bool previousLong = mode->blockFlag;
+	bool nextLong = mode->blockFlag;
+
+	if (mode->blockFlag)
+	{
+		previousLong = bitsRead(st, 1);
+		nextLong = bitsRead(st, 1);
+	}
+
+	// Floors. An unused one (or the packet ending) silences the channel
+	bool anyUsed = false;
+	for (uint32_t ch = 0; ch < st->channels; ch++)
+	{
+		const vorbisFloor_t * floor = &st->floors[mapping->submapFloor[mapping->mux[ch]]];
+
+		floorUsed[ch] = decodeFloor(st, floor, floorValues[ch]);
+		skip[ch] = !floorUsed[ch];
+		anyUsed |= floorUsed[ch];
+	}
+
+	// Coupled channels are decoded if either one is used
+	for (uint32_t i = 0; i < mapping->couplingSteps; i++)
+	{
+		if (!skip[mapping->magnitude[i]] || !skip[mapping->angle[i]])
+		{
+			skip[mapping->magnitude[i]] = false;
+			skip[mapping->angle[i]] = false;
+		}
+	}
+
+	// Residues, by submap
+	for (uint32_t ch = 0; ch < st->channels; ch++)
+	{
+		memset(spectrum[ch], 0, half * sizeof(int32_t));
+	}
+	for (uint32_t s = 0; s < mapping->submaps; s++)
+	{
+		int32_t * vectors[VORBIS_MAX_CHANNELS];
+		bool submapSkip[VORBIS_MAX_CHANNELS];
+		uint32_t count = 0;
+
+		for (uint32_t ch = 0; ch < st->channels; ch++)
+		{
+			if (mapping->mux[ch] == s)
+			{
+				vectors[count] = spectrum[ch];
+				submapSkip[count] = skip[ch];
+				count++;
+			}
+		}
+		if (count)
+		{
+			decodeResidue(st, &st->residues[mapping->submapResidue[s]], vectors, count, submapSkip, half);
+		}
+	}
+
+	// Inverse coupling, last step first
+	for (int32_t i = mapping->couplingSteps - 1; i >= 0; i--)
+	{
+		int32_t * magnitude = spectrum[mapping->magnitude[i]];
+		int32_t * angle = spectrum[mapping->angle[i]];
+
+		for (uint32_t j = 0; j < half; j++)
+		{
+			int32_t m = magnitude[j];
+			int32_t a = angle[j];
+
+			if (m > 0)
+			{
+				if (a > 0)
+				{
+					angle[j] = m - a;
+				}
+				else
+				{
+					angle[j] = m;
+					magnitude[j] = m + a;
+				}
+			}
+			else
+			{
+				if (a > 0)
+				{
+					angle[j] = m + a;
+				}
+				else
+				{
+					angle[j] = m;
+					magnitude[j] = m - a;
+				}
+			}
+		}
+	}
+
+	// Floor curves times the residues, then the mono mix: one IMDCT instead of one per channel
+	int32_t * u = spectrum[0];
+
+	for (uint32_t ch = 0; ch < st->channels; ch++)
+	{
+		if (floorUsed[ch])
+		{
+			applyFloor(&st->floors[mapping->submapFloor[mapping->mux[ch]]], floorValues[ch], spectrum[ch], half);
+		}
+		else
+		{
+			memset(spectrum[ch], 0, half * sizeof(int32_t));
+		}
+	}
+
+	if (st->channels == 2)
+	{
+		const int32_t * second = spectrum[1];
+
+		if (centerCancel)
+		{
+			// Halves rounded to even, for the same reason as the floor
+			for (uint32_t j = 0; j < half; j++)
+			{
+				int32_t difference = u[j] - second[j];
+				u[j] = (difference + ((difference >> 1) & 1)) >> 1;
+			}
+		}
+		else
+		{
+			for (uint32_t j = 0; j < half; j++)
+			{
+				u[j] += second[j];
+			}
+		}
+	}
+
+	if (anyUsed)
+	{
+		imdct(u, half);
+	}
+
+	// Window: long blocks next to short ones overlap them with the short slope, centered on their quarters
+	vorbisWindow_t w;
+	uint32_t shortQuarter = st->blockSizes[0] / 4;
+
+	w.half = half;
+	if (mode->blockFlag && !previousLong)
+	{
+		w.leftStart = half / 2 - shortQuarter;
+		w.leftEnd = half / 2 + shortQuarter;
+		w.leftSlope = st->windows[0];
+	}
+	else
+	{
+		w.leftStart = 0;
+		w.leftEnd = half;
+		w.leftSlope = st->windows[mode->blockFlag];
+	}
+	if (mode->blockFlag && !nextLong)
+	{
+		w.rightStart = half + half / 2 - shortQuarter;
+		w.rightEnd = half + half / 2 + shortQuarter;
+		w.rightSlope = st->windows[0];
+	}
+	else
+	{
+		w.rightStart = half;
+		w.rightEnd = 2 * half;
+		w.rightSlope = st->windows[mode->blockFlag];
+	}
+
+	// From the center of the last block to the center of this one: its saved half plus the first half of this one
+	int32_t frames = 0;
+
+	if (st->previousHalf)
+	{
+		int32_t offset = (int32_t)(half / 2) - (int32_t)(st->previousHalf / 2);
+		frames = st->previousHalf / 2 + half / 2;
+
+		for (int32_t t = 0; t < frames; t++)
+		{
+			int32_t acc = (t < (int32_t)st->previousHalf) ? st->overlap[t] : 0;
+			int32_t i = t + offset;
+
+			if ((i >= 0) && (i < (int32_t)half))
+			{
+				acc += windowedSample(u, i, &w);
+			}
+
+			acc = (acc + (1 << (VORBIS_PCM_SHIFT - 1))) >> VORBIS_PCM_SHIFT;
+			out[t] = (acc > INT16_MAX) ? INT16_MAX : ((acc < INT16_MIN) ? INT16_MIN : acc);
+		}
+	}
+
+	for (uint32_t j = 0; j < half; j++)
+	{
+		st->overlap[j] = windowedSample(u, half + j, &w);
+	}
+	st->previousHalf = half;
+
+	return frames;
+}
+
+
+static bool decodeFloor(vorbisStream_t * st, const vorbisFloor_t * floor, int16_t * y)
+{
+	if (!bitsRead(st, 1))
+	{
+		return false;
+	}
+
+	uint32_t bits = ilog(floorRanges[floor->multiplier - 1] - 1);
+	uint32_t offset = 2;
+
+	y[0] = bitsRead(st, bits);
+	y[1] = bitsRead(st, bits);
+
+	for (uint32_t i = 0; i < floor->partitions; i++)
+	{
+		uint32_t cls = floor->partitionClass[i];
+		uint32_t subclassBits = floor->classSubclasses[cls];
+		uint32_t subclassMask = (1U << subclassBits) - 1;
+		int32_t classValue = 0;
+
+		if (subclassBits)
+		{
+			classValue = decodeEntry(st, &st->codebooks[floor->classMasterbook[cls]]);
+			if (classValue < 0)
+			{
+				return false;
+			}
+		}
+
+		for (uint32_t j = 0; j < floor->classDimensions[cls]; j++)
+		{
+			int16_t book = floor->subclassBooks[cls][classValue & subclassMask];
+			classValue >>= subclassBits;
+
+			if (book >= 0)
+			{
+				int32_t value = decodeEntry(st, &st->codebooks[book]);
+				if (value < 0)
+				{
+					return false;
+				}
+				y[offset + j] = value;
+			}
+			else
+			{
+				y[offset + j] = 0;
+			}
+		}
+		offset += floor->classDimensions[cls];
+	}
+
+	return !bitsEnded(st);
+}
+
+
+static void applyFloor(const vorbisFloor_t * floor, const int16_t * y, int32_t * data, uint32_t half)
+{
+	int32_t finalY[VORBIS_FLOOR1_VALUES];
+	bool step2[VORBIS_FLOOR1_VALUES];
+	int32_t range = floorRanges[floor->multiplier - 1];
+
+	// Each value is coded as a difference from the line between its neighbors
+	finalY[0] = y[0];
+	finalY[1] = y[1];
+	step2[0] = true;
+	step2[1] = true;
+
+	for (uint32_t i = 2; i < floor->values; i++)
+	{
+		uint32_t low = floor->lowNeighbor[i];
+		uint32_t high = floor->highNeighbor[i];
+		int32_t dy = finalY[high] - finalY[low];
+		int32_t adx = floor->x[high] - floor->x[low];
+		int32_t offset = ((dy < 0) ? -dy : dy) * (floor->x[i] - floor->x[low]) / adx;
+		int32_t predicted = (dy < 0) ? (finalY[low] - offset) : (finalY[low] + offset);
+		int32_t highRoom = range - predicted;
+		int32_t lowRoom = predicted;
+		int32_t room = ((highRoom < lowRoom) ? highRoom : lowRoom) * 2;
+		int32_t value = y[i];
+
+		if (value)
+		{
+			step2[low] = true;
+			step2[high] = true;
+			step2[i] = true;
+
+			if (value >= room)
+			{
+				finalY[i] = (highRoom > lowRoom) ? (value - lowRoom + predicted) : (predicted - value + highRoom - 1);
+			}
+			else
+			{
+				finalY[i] = (value & 1) ? (predicted - (value + 1) / 2) : (predicted + value / 2);
+			}
+		}
+		else
+		{
+			step2[i] = false;
+			finalY[i] = predicted;
+		}
+	}
+
+	// Lines between the values that were coded, in X order
+	int32_t lx = 0;
+	int32_t ly = finalY[0] * floor->multiplier;
+	int32_t hx = 0;
+	int32_t hy = 0;
+
+	for (uint32_t i = 1; i < floor->values; i++)
+	{
+		uint32_t index = floor->sorted[i];
+
+		if (step2[index])
+		{
+			hy = finalY[index] * floor->multiplier;
+			hx = floor->x[index];
+			renderLine(lx, ly, hx, hy, data, half);
+			lx = hx;
+			ly = hy;
+		}
+	}
+	if ((uint32_t)hx < half)
+	{
+		renderLine(hx, hy, half, hy, data, half);
+	}
+}
+
+
+static void renderLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t * data, uint32_t half)
+{
+	int32_t dy = y1 - y0;
+	int32_t adx = x1 - x0;
+	int32_t base = dy / adx;
+	int32_t sy = (dy < 0) ? (base - 1) : (base + 1);
+	int32_t ady = ((dy < 0) ? -dy : dy) - ((base < 0) ? -base : base) * adx;
+	int32_t y = y0;
+	int32_t err = 0;
+	int32_t end = ((uint32_t)x1 < half) ? x1 : (int32_t)half;
+
+	for (int32_t x = x0; x < end; x++)
+	{
+		if (x > x0)
+		{
+			err += ady;
+			if (err >= adx)
+			{
+				err -= adx;
+				y += sy;
+			}
+			else
+			{
+				y += base;
+			}
+		}
+
+		// Residue (Q8) times the amplitude of the floor (Q31), to Q20. Rounded: the IMDCT adds up a truncation
+		// bias of every value into its first and last outputs, the center of the block
+		int32_t index = (y < 0) ? 0 : ((y > 255) ? 255 : y);
+		int64_t value = ((int64_t)data[x] * inverseDbTable[index] + (1LL << (VORBIS_FLOOR_SHIFT - 1))) >> VORBIS_FLOOR_SHIFT;
+		data[x] = (value > INT32_MAX) ? INT32_MAX : ((value < INT32_MIN) ? INT32_MIN : (int32_t)value);
+	}
+}
+
+
+static void decodeResidue(vorbisStream_t * st, const vorbisResidue_t * residue, int32_t ** vectors,
+							uint32_t count, const bool * skip, uint32_t half)
+{
+	// Type 2 is one vector with the channels interleaved
+	uint32_t interleave = 1;
+	uint32_t vectorCount = count;
+	bool typeTwoSkip = true;
+
+	if (residue->type == 2)
+	{
+		for (uint32_t ch = 0; ch < count; ch++)
+		{
+			typeTwoSkip &= skip[ch];
+		}
+		if (typeTwoSkip)
+		{
+			return;
+		}
+		interleave = count;
+		vectorCount = 1;
+	}
+
+	uint32_t size = half * interleave;
+	uint32_t begin = (residue->begin < size) ? residue->begin : size;
+	uint32_t end = (residue->end < size) ? residue->end : size;
+	uint32_t partitions = (end - begin) / residue->partitionSize;
+	const vorbisCodebook_t * classbook = &st->codebooks[residue->classbook];
+	uint32_t classwords = classbook->dimensions;
+
+	if (partitions > VORBIS_MAX_PARTITIONS)
+	{
+		partitions = VORBIS_MAX_PARTITIONS;
+	}
+
+	for (uint32_t pass = 0; pass < 8; pass++)
+	{
+		for (uint32_t p = 0; p < partitions; )
+		{
+			// The first pass reads the classification of the next classwords partitions of each vector
+			if (pass == 0)
+			{
+				for (uint32_t v = 0; v < vectorCount; v++)
+				{
+					if ((residue->type != 2) && skip[v])
+					{
+						continue;
+					}
+
+					int32_t value = decodeEntry(st, classbook);
+					if (value < 0)
+					{
+						// The packet ended: what was not decoded stays 0
+						return;
+					}
+					for (int32_t i = classwords - 1; i >= 0; i--)
+					{
+						if (p + i < partitions)
+						{
+							partitionClasses[v][p + i] = value % residue->classifications;
+						}
+						value /= residue->classifications;
+					}
+				}
+			}
+
+			for (uint32_t i = 0; (i < classwords) && (p < partitions); i++, p++)
+			{
+				for (uint32_t v = 0; v < vectorCount; v++)
+				{
+					if ((residue->type != 2) && skip[v])
+					{
+						continue;
+					}
+
+					int16_t book = residue->books[partitionClasses[v][p] * 8 + pass];
+					if ((book >= 0) &&
+						!decodePartition(st, &st->codebooks[book], (residue->type == 2) ? vectors : &vectors[v], interleave,
+										begin + p * residue->partitionSize, residue->partitionSize, residue->type == 0))
+					{
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+static bool decodePartition(vorbisStream_t * st, const vorbisCodebook_t * book, int32_t ** vectors,
+							uint32_t interleave, uint32_t offset, uint32_t size, bool stepped)
+{
+	uint32_t dimensions = book->dimensions;
+	uint32_t step = stepped ? (size / dimensions) : 1;
+	uint32_t vectorsIn = stepped ? step : ((size + dimensions - 1) / dimensions);
+
+	for (uint32_t i = 0; i < vectorsIn; i++)
+	{
+		int32_t entry = decodeEntry(st, book);
+		if (entry < 0)
+		{
+			return false;
+		}
+
+		// Values of the entry: digits of its number in base lookupValues (type 1) or a row of the table (type 2)
+		uint32_t divisor = 1;
+		int32_t last = 0;
+
+		for (uint32_t d = 0; d < dimensions; d++)
+		{
+			uint32_t index = (book->lookupType == 1) ? (((uint32_t)entry / divisor) % book->lookupValues) : (entry * dimensions + d);
+			int32_t value = book->values[index] + book->minimum + last;
+			uint32_t k = stepped ? (offset + i + d * step) : (offset + i * dimensions + d);
+
+			if (book->sequenceP)
+			{
+				last = value;
+			}
+			divisor *= book->lookupValues;
+
+			if (!stepped && (i * dimensions + d >= size))
+			{
+				break;
+			}
+			if (interleave == 2)
+			{
+				vectors[k & 1][k >> 1] += value;
+			}
+			else
+			{
+				vectors[0][k] += value;
+			}
+		}
+	}
+	return true;
+}
+
+
+static void imdct(int32_t * data, uint32_t half)
+{
+	// DCT-IV of half values through an FFT of half / 2 complex points:
+	// z[n] = (x[2n] + i x[half - 1 - 2n]) e^(-i pi (4n + 1) / (4 half)), FFT, then times e^(-i pi k / half):
+	// u[2k] is the real part and u[half - 1 - 2k] minus the imaginary part. In place, in pairs from both ends
+	uint32_t points = half / 2;
+	uint32_t step = SINE_HALF_BLOCK / half;
+
+	for (uint32_t n = 0; n < points / 2; n++)
+	{
+		uint32_t m = points - 1 - n;
+		int32_t nRe = data[2 * n];
+		int32_t nIm = data[half - 1 - 2 * n];
+		int32_t mRe = data[2 * m];
+		int32_t mIm = data[half - 1 - 2 * m];
+
+		uint32_t j = (4 * n + 1) * step;
+		int32_t s = sineTable[j];
+		int32_t c = sineTable[SINE_QUARTER - j];
+		data[2 * n] = DOT31(nRe, c, nIm, s);
+		data[2 * n + 1] = DOT31(nIm, c, -nRe, s);
+
+		j = (4 * m + 1) * step;
+		s = sineTable[j];
+		c = sineTable[SINE_QUARTER - j];
+		data[2 * m] = DOT31(mRe, c, mIm, s);
+		data[2 * m + 1] = DOT31(mIm, c, -mRe, s);
+	}
+
+	fft(data, points);
+
+	for (uint32_t k = 0; k < points / 2; k++)
+	{
+		uint32_t m = points - 1 - k;
+		int32_t kRe = data[2 * k];
+		int32_t kIm = data[2 * k + 1];
+		int32_t mRe = data[2 * m];
+		int32_t mIm = data[2 * m + 1];
+
+		uint32_t j = 4 * k * step;
+		int32_t s = sineTable[j];
+		int32_t c = sineTable[SINE_QUARTER - j];
+		data[2 * k] = DOT31(kRe, c, kIm, s);
+		data[half - 1 - 2 * k] = -DOT31(kIm, c, -kRe, s);
+
+		j = 4 * m * step;
+		s = sineTable[j];
+		c = sineTable[SINE_QUARTER - j];
+		data[2 * m] = DOT31(mRe, c, mIm, s);
+		data[half - 1 - 2 * m] = -DOT31(mIm, c, -mRe, s);
+	}
+}
+
+
+static void fft(int32_t * data, uint32_t points)
+{
+	// Bit reversed order
+	for (uint32_t i = 0, j = 0; i < points; i++)
+	{
+		if (i < j)
+		{
+			int32_t re = data[2 * i];
+			int32_t im = data[2 * i + 1];
+			data[2 * i] = data[2 * j];
+			data[2 * i + 1] = data[2 * j + 1];
+			data[2 * j] = re;
+			data[2 * j + 1] = im;
+		}
+
+		uint32_t bit = points >> 1;
+		while (j & bit)
+		{
+			j ^= bit;
+			bit >>= 1;
+		}
+		j |= bit;
+	}
+
+	// Radix-2 butterflies, twiddle e^(-2 pi i k / size): past pi / 2 from the other end of the table
+	for (uint32_t size = 2; size <= points; size <<= 1)
+	{
+		uint32_t halfSize = size / 2;
+		uint32_t tableStep = 4 * SINE_QUARTER / size;
+
+		for (uint32_t k = 0; k < halfSize; k++)
+		{
+			uint32_t j = k * tableStep;
+			int32_t s = (j <= SINE_QUARTER) ? sineTable[j] : sineTable[2 * SINE_QUARTER - j];
+			int32_t c = (j <= SINE_QUARTER) ? sineTable[SINE_QUARTER - j] : -sineTable[j - SINE_QUARTER];
+
+			for (uint32_t i = k; i < points; i += size)
+			{
+				int32_t * a = &data[2 * i];
+				int32_t * b = &data[2 * (i + halfSize)];
+				int32_t re = DOT31(b[0], c, b[1], s);
+				int32_t im = DOT31(b[1], c, -b[0], s);
+
+				b[0] = a[0] - re;
+				b[1] = a[1] - im;
+				a[0] += re;
+				a[1] += im;
+			}
+		}
+	}
+}
+
+
+static inline int32_t windowedSample(const int32_t * u, uint32_t i, const vorbisWindow_t * w)
+{
+	// The IMDCT output is the DCT-IV unfolded: its second half, then all of it reversed and negated, then its first half negated
+	uint32_t quarter = w->half / 2;
+	int32_t value;
+
+	if (i < quarter)
+	{
+		value = u[i + quarter];
+	}
+	else if (i < 3 * quarter)
+	{
+		value = -u[3 * quarter - 1 - i];
+	}
+	else
+	{
+		value = -u[i - 3 * quarter];
+	}
+
+	if (i < w->half)
+	{
+		if (i < w->leftStart)
+		{
+			return 0;
+		}
+		return (i < w->leftEnd) ? MULT31(value, w->leftSlope[i - w->leftStart]) : value;
+	}
+
+	if (i >= w->rightEnd)
+	{
+		return 0;
+	}
+	return (i < w->rightStart) ? value : MULT31(value, w->rightSlope[w->rightEnd - 1 - i]);
+}
+
+
+static int32_t sineQuarter(int32_t x)
+{
+	// SINE_QUARTER steps from 0 to pi / 2: the top bits index the table, the rest interpolate
+	uint32_t fractionBits = 31 - 11;
+	uint32_t index = (uint32_t)x >> fractionBits;
+	int32_t fraction = x & ((1 << fractionBits) - 1);
+
+	return sineTable[index] + (int32_t)(((int64_t)(sineTable[index + 1] - sineTable[index]) * fraction) >> fractionBits);
+}
+
+
+static inline uint32_t ilog(uint32_t value)
+{
+	return value ? (32 - __CLZ(value)) : 0;
+}
+
+
+static bool vorbisProbe(const uint8_t * header, uint32_t length)
+{
+	return (length >= 4) && (memcmp(header, "OggS", 4) == 0);
+}
+
+
+static bool vorbisGetChannels(decoder_stream_t id, uint8_t * channelCount)
+{
+	vorbisStream_t * st = (id == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+
+	// Always mixed to mono
+	*channelCount = 1;
+	return true;
+}
+
+
+static bool vorbisSeek(int32_t samples)
+{
+	vorbisStream_t * st = playing;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+
+	uint64_t current = st->sampleKnown ? (st->sample + st->skipSamples) : st->seekTarget;
+	int64_t target = (int64_t)current + samples;
+
+	if (target < 0)
+	{
+		target = 0;
+	}
+	if (st->totalSamples && ((uint64_t)target >= st->totalSamples))
+	{
+		// Past the end, the song is over
+		st->sample = st->totalSamples;
+		st->sampleKnown = true;
+		st->skipSamples = 0;
+		return false;
+	}
+
+	if ((samples > 0) && st->sampleKnown && (samples < VORBIS_SEEK_DECODE))
+	{
+		// Close ahead, decoding through is cheaper than finding the page
+		st->skipSamples += samples;
+		return true;
+	}
+
+	seekToSample(st, (uint64_t)target, (uint64_t)target);
+	return true;
+}
+
+
+static uint32_t vorbisGetRemainingMs(void)
+{
+	if (!playing || !playing->fileIsOpened || !playing->totalSamples)
+	{
+		return UINT32_MAX;
+	}
+
+	uint64_t current = playing->sampleKnown ? (playing->sample + playing->skipSamples) : playing->seekTarget;
+	uint64_t samples = (playing->totalSamples > current) ? (playing->totalSamples - current) : 0;
+	return (uint32_t)(samples * 1000U / playing->sampleRate);
+}
+
+
+static bool vorbisPromote(void)
+{
+	if (!incoming || !incoming->fileIsOpened)
+	{
+		return false;
+	}
+
+	// Its memory is free for the next crossfade (AudioDecoder_PromoteIncoming)
+	VorbisDecoder_Close(DECODER_PLAYING_STREAM);
+
+	playing = incoming;
+	incoming = NULL;
+
+	return true;
+}
+
+
+static bool vorbisGetTag(audio_tag_t tag, char ** value)
+{
+	if (!playing || !playing->fileIsOpened || (tag >= VORBIS_TAG_COUNT) || !playing->tags[tag][0])
+	{
+		return false;
+	}
+	*value = playing->tags[tag];
+	return true;
+}
+
+
+static void vorbisSetCenterCancel(bool enable)
+{
+	centerCancel = enable;
+}
@@ -0,0 +1,101 @@
+/***************************************************************************//**
+  @file     vorbis_decoder.h
+  @brief    Ogg Vorbis decoder, fixed point, pages streamed from FatFs, mono output
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/*******************************************************************************
+*							INCLUDE HEADER FILES
+******************************************************************************/
+
+#ifndef _VORBIS_DECODER_H_
+#define _VORBIS_DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_decoder.h"
+
+
+/*******************************************************************************
+*				  CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+******************************************************************************/
+
+// Compressed data kept buffered ahead of the decoder (KB, power of 2). Packets longer than it are read as they are decoded
+#ifndef VORBIS_READAHEAD_KB
+#define VORBIS_READAHEAD_KB		4
+#endif
+
+// Room for what the setup header decodes to (codebook trees, VQ values, floors, residues, mappings, modes)
+// and the two windows of the file, per stream. Files whose setup does not fit are not opened.
+// The whole stream has to fit in AUDIO_DECODER_STREAM_SIZE
+#ifndef VORBIS_ARENA_KB
+#define VORBIS_ARENA_KB			22
+#endif
+
+// Longest block played. libvorbis uses 256 and 2048 at 44.1 and 48 kHz, up to 2048 supported.
+// Each stream keeps half of it for the overlap (4 bytes per sample), the spectra are in the scratch of the decoder layer
+#ifndef VORBIS_MAX_BLOCKSIZE
+#define VORBIS_MAX_BLOCKSIZE	2048
+#endif
+
+
+/*******************************************************************************
+ *					VARIABLE PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+// Vorbis entry of the codec table (audio_decoder.c)
+extern const audio_codec_t vorbisCodec;
+
+
+/*******************************************************************************
+ *					FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief Initializes both Vorbis streams (playing and incoming).
+*/
+void VorbisDecoder_Init(void);
+
+
+/**
+ * @brief: Reads the three header packets, decoding the setup into the arena of the stream, and finds the length of the file.
+ * @param stream: playing or incoming.
+ * @param filename: file's path.
+ * @return: false if it can't be opened, it is not mono or stereo Vorbis with floor 1, or its setup does not fit.
+ */
+bool VorbisDecoder_LoadFile(decoder_stream_t stream, const char* filename);
+
+
+/**
+ * @brief: Decodes the next audio packet. Stereo is mixed to mono before the inverse MDCT, so only one is done:
+ *         L + R like the handler sums them for the DAC, or (L - R) / 2 with center cancel.
+ * @param stream: playing or incoming.
+ * @param decodedDataBuffer: output, mono.
+ * @param decodedBufferSize: size of the output in samples, at least half the long block size.
+ * @param numSamplesDecoded: here we store the number of samples.
+ * @param sampleRate: here we store the sample rate of the file.
+ * @return: DECODER_END_OF_FILE after the last packet, DECODER_OVERFLOW if the output is too small.
+ */
+decoder_result_t VorbisDecoder_DecodeFrame(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate);
+
+
+/**
+ * @brief: Background read into the read-ahead buffer of the open files, whole sectors only.
+ * @return: true if something was read.
+ */
+bool VorbisDecoder_ReadAhead(void);
+
+
+/**
+ * @brief: Closes the file of a stream.
+ * @param stream: playing or incoming.
+ */
+void VorbisDecoder_Close(decoder_stream_t stream);
+
+
+#endif /* _VORBIS_DECODER_H_ */
@@ -0,0 +1,1015 @@
+/*******************************************************************************
+  @file     wav_decoder.c
+  @brief    RIFF/WAVE reader: 8/16/24 bit PCM and IMA/MS ADPCM, mono or stereo
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+ /*******************************************************************************
+  *							INCLUDE HEADER FILES
+  ******************************************************************************/
+
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ff.h"
+#include "wav_decoder.h"
+
+ /*******************************************************************************
+ *					CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define FILE_SECTOR_SIZE		512		// FatFs sector, reads of whole aligned sectors go straight to our buffer
+
+#define WAV_RING_SIZE			(WAV_READAHEAD_KB * 1024U)	// Power of 2 and whole sectors
+#define WAV_RING_MASK			(WAV_RING_SIZE - 1)
+
+#define WAV_FRAME_SAMPLES		1152	// Per channel samples per call, same as an MP3 frame
+#define WAV_MAX_FRAME_BYTES		6		// 24 bit stereo
+
+#define WAV_MAX_CHUNKS			16		// Chunks looked at before giving up on finding "data"
+
+#define WAV_FORMAT_PCM			0x0001
+#define WAV_FORMAT_MS_ADPCM		0x0002
+#define WAV_FORMAT_IMA_ADPCM	0x0011
+#define WAV_FORMAT_EXTENSIBLE	0xFFFE
+
+#define WAV_FMT_MAX_BYTES		50		// fmt read: 16 common + cbSize + samples per block + 7 MS coefficient pairs
+
+#define WAV_ADPCM_MAX_BLOCK		(WAV_RING_SIZE / 2)		// A whole block has to fit in the ring
+#define WAV_ADPCM_STEP_FRAMES	8		// Most frames out of one step (a stereo IMA group)
+#define WAV_IMA_HEADER_BYTES	4		// Per channel: predictor, step index, reserved
+#define WAV_MS_HEADER_BYTES		7		// Per channel: predictor index, delta, sample 1, sample 2
+#define WAV_MS_COEFS			7		// Predictors of MS ADPCM, the standard ones unless the file says otherwise
+#define WAV_IMA_MAX_INDEX		88
+
+#define RING_BYTE(st, offset)	((st)->ring[(offset) & WAV_RING_MASK])
+#define RING_INT16(st, offset)	((int16_t)(RING_BYTE(st, offset) | (RING_BYTE(st, (offset) + 1) << 8)))
+
+// Per 1152 samples, estimates. 24 bit stereo PCM ~60k, stereo ADPCM ~30 per sample plus the ring reads.
+// MP3 is ~1M (mp3_decoder.c), measure both with AudioDecoder_GetCodecCycles
+#define WAV_WORST_CASE_CYCLES	120000
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+// Decoder state of one ADPCM channel
+typedef struct
+{
+	int32_t		sample1;			// Last output sample (the IMA predictor)
+	int32_t		sample2;			// The one before (MS only)
+	int32_t		step;				// IMA step index or MS delta
+	int32_t		coef1;				// MS predictor
+	int32_t		coef2;
+} adpcmChannel_t;
+
+// The ring index of a byte is its file offset & WAV_RING_MASK, so the reads are whole sectors
+// straight from FatFs (no window copy) and the samples are converted where they were read.
+// ADPCM is read the same way, one whole block (blockAlign bytes) in the ring before it is started.
+typedef struct
+{
+	FIL			file;
+	bool		fileIsOpened;
+	uint16_t	format;				// WAV_FORMAT_PCM, WAV_FORMAT_IMA_ADPCM or WAV_FORMAT_MS_ADPCM
+	uint8_t		channels;
+	uint8_t		bytesPerSample;		// 1, 2 or 3, 0 for ADPCM
+	uint8_t		frameBytes;			// bytesPerSample * channels, 0 for ADPCM
+	uint16_t	blockAlign;			// ADPCM block size in bytes
+	uint16_t	samplesPerBlock;	// ADPCM per channel samples of a whole block
+	uint32_t	blockStart;			// File offset of the ADPCM block being decoded
+	uint16_t	blockFramesLeft;	// Frames of that block not decoded yet, 0 between blocks
+	adpcmChannel_t adpcm[2];
+	int16_t		msCoefs[WAV_MS_COEFS][2];
+	uint32_t	sampleRate;
+	uint32_t	dataStart;			// File offset of the first sample
+	uint32_t	dataEnd;			// File offset after the last sample
+	uint32_t	position;			// File offset of the next sample to convert
+	uint32_t	readPosition;		// File offset of the next sector to read
+	bool		fileEnded;			// true once f_read returned less than asked for
+	uint8_t		lastChannels;		// Output channels of the last block (1 with center cancel)
+	uint8_t		ring[WAV_RING_SIZE] __attribute__((aligned(4)));
+} wavStream_t;
+
+_Static_assert(sizeof(wavStream_t) <= AUDIO_DECODER_STREAM_SIZE, "wavStream_t does not fit in the memory of a stream");
+
+/*******************************************************************************
+ *      FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief  Walks the RIFF chunks and fills the format and the data bounds of the stream.
+* @param  st: stream with the file open.
+* @returns  false if it is not a PCM format we can play.
+*/
+static bool parseHeader(wavStream_t * st);
+
+
+/*
+* @brief  Reads whole sectors into the free space of the ring.
+* @param  st: stream.
+* @returns  the number of bytes read.
+*/
+static uint32_t fillRing(wavStream_t * st);
+
+
+/*
+* @brief  Positions the file at the sector containing filePosition, the ring starts empty there.
+* @param  st: stream.
+* @param  filePosition: absolute position in the file, a sample boundary.
+*/
+static void seekAligned(wavStream_t * st, uint32_t filePosition);
+
+
+/*
+* @brief  Converts contiguous frames to 16 bit samples.
+* @param  st: stream, for the format.
+* @param  src: first byte of the first frame.
+* @param  frames: frames to convert.
+* @param  dst: output, st->lastChannels samples per frame.
+*/
+static void convertFrames(const wavStream_t * st, const uint8_t * src, uint32_t frames, short * dst);
+
+
+/*
+* @brief  Decodes whole ADPCM steps until frames is reached or the data ends.
+* @param  st: stream.
+* @param  dst: output, st->channels samples per frame.
+* @param  frames: room of the output in frames, steps give up to WAV_ADPCM_STEP_FRAMES frames.
+* @returns  frames decoded, 0 at the end of the data.
+*/
+static uint32_t decodeAdpcm(wavStream_t * st, short * dst, uint32_t frames);
+
+
+/*
+* @brief  Starts the ADPCM block at st->position: reads its header and outputs its first frames.
+* @param  st: stream, the block has to be in the ring or the file ended.
+* @param  dst: output, st->channels samples per frame.
+* @returns  frames output (1 IMA, 2 MS), 0 if there is no whole header left.
+*/
+static uint32_t startAdpcmBlock(wavStream_t * st, short * dst);
+
+
+/*
+* @brief  Decodes the next step of the current ADPCM block (one byte, or a group of 8 bytes for stereo IMA).
+* @param  st: stream.
+* @param  dst: output, st->channels samples per frame.
+* @returns  frames output.
+*/
+static uint32_t decodeAdpcmStep(wavStream_t * st, short * dst);
+
+
+/*
+* @brief  One IMA ADPCM sample.
+* @param  ch: channel state.
+* @param  nibble: 4 bit code.
+* @returns  the 16 bit sample.
+*/
+static inline short imaNibble(adpcmChannel_t * ch, uint8_t nibble);
+
+
+/*
+* @brief  One MS ADPCM sample.
+* @param  ch: channel state.
+* @param  nibble: 4 bit code, signed.
+* @returns  the 16 bit sample.
+*/
+static inline short msNibble(adpcmChannel_t * ch, uint8_t nibble);
+
+
+/*
+* @brief  Position of the playing stream in per channel samples (ADPCM, block index based).
+* @param  st: stream.
+* @returns  samples from the start of the data.
+*/
+static uint32_t adpcmFramePosition(const wavStream_t * st);
+
+
+/*
+* @brief  Codec table adapters, see audio_codec_t.
+*/
+static bool wavProbe(const uint8_t * header, uint32_t length);
+static bool wavGetChannels(decoder_stream_t id, uint8_t * channelCount);
+static bool wavSeek(int32_t samples);
+static uint32_t wavGetRemainingMs(void);
+static bool wavPromote(void);
+static void wavSetCenterCancel(bool enable);
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH GLOBAL SCOPE
+ *****************************************************************************/
+const audio_codec_t wavCodec =
+{
+	.name = "WAV",
+	.extension = ".wav",
+	.worstCaseCycles = WAV_WORST_CASE_CYCLES,
+
+	.init = WAVDecoder_Init,
+	.probe = wavProbe,
+	.open = WAVDecoder_LoadFile,
+	.decodeFrame = WAVDecoder_DecodeFrame,
+	.getChannels = wavGetChannels,
+	.seek = wavSeek,
+	.getRemainingMs = wavGetRemainingMs,
+	.promote = wavPromote,
+	.close = WAVDecoder_Close,
+
+	.readAhead = WAVDecoder_ReadAhead,
+	.setCenterCancel = wavSetCenterCancel,
+};
+
+
+/*****************************************************************************
+ *  					VARIABLES WITH LOCAL SCOPE
+ *****************************************************************************/
+// In the memory of the decoder layer, NULL while there is no file of ours on the stream
+static wavStream_t *	playing = NULL;
+static wavStream_t *	incoming = NULL;
+static bool				centerCancel;			// Stereo files are output as mono L-R
+
+static const int16_t imaStepTable[WAV_IMA_MAX_INDEX + 1] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t imaIndexTable[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static const int16_t msAdaptTable[16] =
+{
+	230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230
+};
+
+static const int16_t msStandardCoefs[WAV_MS_COEFS][2] =
+{
+	{ 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 }, { 240, 0 }, { 460, -208 }, { 392, -232 }
+};
+
+
+/*******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+void WAVDecoder_Init(void)
+{
+	playing = NULL;
+	incoming = NULL;
+	centerCancel = false;
+}
+
+
+bool WAVDecoder_LoadFile(decoder_stream_t stream, const char* filename)
+{
+	WAVDecoder_Close(stream);
+
+	// Another codec may have used the memory, nothing but the ring is read before it is set
+	wavStream_t * st = AudioDecoder_GetStreamMemory(stream);
+	memset(st, 0, offsetof(wavStream_t, ring));
+
+	if (f_open(&st->file, _T(filename), FA_READ) != FR_OK)
+	{
+		return false;
+	}
+
+	if (!parseHeader(st))
+	{
+		f_close(&st->file);
+		return false;
+	}
+
+	st->fileIsOpened = true;
+	st->lastChannels = st->channels;
+	st->blockFramesLeft = 0;
+	seekAligned(st, st->dataStart);
+	fillRing(st);
+
+	if (stream == DECODER_PLAYING_STREAM)
+	{
+		playing = st;
+	}
+	else
+	{
+		incoming = st;
+	}
+	return true;
+}
+
+
+decoder_result_t WAVDecoder_DecodeFrame	(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate)
+{
+	wavStream_t * st = (stream == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	*numSamplesDecoded = 0;
+	*sampleRate = 0;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return DECODER_NO_FILE;
+	}
+
+	st->lastChannels = (centerCancel && (st->channels == 2)) ? 1 : st->channels;
+
+	uint32_t frames = decodedBufferSize / st->lastChannels;
+	if (frames > WAV_FRAME_SAMPLES)
+	{
+		frames = WAV_FRAME_SAMPLES;
+	}
+
+	if (st->format != WAV_FORMAT_PCM)
+	{
+		// Decoded as stereo and folded afterwards with center cancel, so it has to fit as stereo
+		if (frames > decodedBufferSize / st->channels)
+		{
+			frames = decodedBufferSize / st->channels;
+		}
+
+		frames = decodeAdpcm(st, decodedDataBuffer, frames);
+		if (!frames)
+		{
+			return DECODER_END_OF_FILE;
+		}
+
+		if (st->lastChannels != st->channels)
+		{
+			for (uint32_t i = 0; i < frames; i++)
+			{
+				decodedDataBuffer[i] = (decodedDataBuffer[2 * i] - decodedDataBuffer[2 * i + 1]) / 2;
+			}
+		}
+
+		*numSamplesDecoded = frames * st->lastChannels;
+		*sampleRate = st->sampleRate;
+		return DECODER_WORKED;
+	}
+
+	// If the read-ahead ran dry, read now (after a seek the first sector is not read yet)
+	if ((st->readPosition < st->position + frames * st->frameBytes) && !st->fileEnded)
+	{
+		fillRing(st);
+	}
+
+	uint32_t available = (st->readPosition > st->position) ? (st->readPosition - st->position) : 0;
+	if (st->position + available > st->dataEnd)
+	{
+		available = st->dataEnd - st->position;
+	}
+	if (frames > available / st->frameBytes)
+	{
+		frames = available / st->frameBytes;
+	}
+
+	if (!frames)
+	{
+		return DECODER_END_OF_FILE;
+	}
+
+	*numSamplesDecoded = frames * st->lastChannels;
+	*sampleRate = st->sampleRate;
+
+	while (frames)
+	{
+		uint32_t ringIndex = st->position & WAV_RING_MASK;
+		uint32_t run = (WAV_RING_SIZE - ringIndex) / st->frameBytes;
+
+		if (run == 0)
+		{
+			// 3 and 6 byte frames can cross the end of the ring, put that one together
+			uint8_t frame[WAV_MAX_FRAME_BYTES];
+			for (uint8_t i = 0; i < st->frameBytes; i++)
+			{
+				frame[i] = st->ring[(ringIndex + i) & WAV_RING_MASK];
+			}
+			convertFrames(st, frame, 1, decodedDataBuffer);
+			run = 1;
+		}
+		else
+		{
+			if (run > frames)
+			{
+				run = frames;
+			}
+			convertFrames(st, &st->ring[ringIndex], run, decodedDataBuffer);
+		}
+
+		decodedDataBuffer += run * st->lastChannels;
+		st->position += run * st->frameBytes;
+		frames -= run;
+	}
+
+	return DECODER_WORKED;
+}
+
+
+bool WAVDecoder_ReadAhead(void)
+{
+	bool res = false;
+
+	if (playing && playing->fileIsOpened)
+	{
+		res = (fillRing(playing) != 0);
+	}
+	if (!res && incoming && incoming->fileIsOpened)
+	{
+		res = (fillRing(incoming) != 0);
+	}
+	return res;
+}
+
+
+void WAVDecoder_Close(decoder_stream_t stream)
+{
+	wavStream_t ** st = (stream == DECODER_PLAYING_STREAM) ? &playing : &incoming;
+
+	if (*st && (*st)->fileIsOpened)
+	{
+		f_close(&(*st)->file);
+		(*st)->fileIsOpened = false;
+	}
+
+	// The memory goes back to the decoder layer
+	*st = NULL;
+}
+
+
+/*******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ ******************************************************************************/
+static bool parseHeader(wavStream_t * st)
+{
+	uint8_t chunk[WAV_FMT_MAX_BYTES];
+	UINT bytesRead = 0;
+	uint32_t offset = 12;					// After "RIFF", size, "WAVE"
+	uint32_t fileSize = f_size(&st->file);
+	bool hasFormat = false;
+
+	st->dataStart = 0;
+
+	if ((f_read(&st->file, chunk, 12, &bytesRead) != FR_OK) || (bytesRead < 12) ||
+		(memcmp(chunk, "RIFF", 4) != 0) || (memcmp(&chunk[8], "WAVE", 4) != 0))
+	{
+		return false;
+	}
+
+	for (uint8_t i = 0; (i < WAV_MAX_CHUNKS) && (offset + 8 <= fileSize) && !st->dataStart; i++)
+	{
+		f_lseek(&st->file, offset);
+		if ((f_read(&st->file, chunk, 8, &bytesRead) != FR_OK) || (bytesRead < 8))
+		{
+			return false;
+		}
+
+		uint32_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			// Format, channels, rate, byte rate, block align, bits, then the extension:
+			// the subformat if extensible, samples per block (and MS coefficients) if ADPCM
+			if ((size < 16) || (f_read(&st->file, chunk, (size < WAV_FMT_MAX_BYTES) ? size : WAV_FMT_MAX_BYTES, &bytesRead) != FR_OK) || (bytesRead < 16))
+			{
+				return false;
+			}
+
+			uint16_t format = chunk[0] | (chunk[1] << 8);
+			uint16_t bits = chunk[14] | (chunk[15] << 8);
+
+			if ((format == WAV_FORMAT_EXTENSIBLE) && (bytesRead >= 26))
+			{
+				// The first two bytes of the subformat GUID are the format
+				format = chunk[24] | (chunk[25] << 8);
+			}
+
+			st->format = format;
+			st->channels = chunk[2] | (chunk[3] << 8);
+			st->sampleRate = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+			st->blockAlign = chunk[12] | (chunk[13] << 8);
+			st->bytesPerSample = (format == WAV_FORMAT_PCM) ? (bits / 8) : 0;
+			st->frameBytes = st->bytesPerSample * st->channels;
+
+			hasFormat = ((st->channels == 1) || (st->channels == 2)) && st->sampleRate;
+
+			if (format == WAV_FORMAT_PCM)
+			{
+				hasFormat = hasFormat && ((bits == 8) || (bits == 16) || (bits == 24));
+			}
+			else if ((format == WAV_FORMAT_IMA_ADPCM) || (format == WAV_FORMAT_MS_ADPCM))
+			{
+				uint16_t headerBytes = ((format == WAV_FORMAT_IMA_ADPCM) ? WAV_IMA_HEADER_BYTES : WAV_MS_HEADER_BYTES) * st->channels;
+
+				hasFormat = hasFormat && (bits == 4) && (st->blockAlign > headerBytes) && (st->blockAlign <= WAV_ADPCM_MAX_BLOCK);
+
+				// 0 if the file does not say, the block size then sets it
+				st->samplesPerBlock = (bytesRead >= 20) ? (chunk[18] | (chunk[19] << 8)) : 0;
+
+				// What a whole block holds: the header frames, then two samples per byte
+				uint16_t dataBytes = st->blockAlign - headerBytes;
+				uint16_t blockFrames = (format == WAV_FORMAT_IMA_ADPCM) ?
+										(1 + ((st->channels == 1) ? (dataBytes * 2) : ((dataBytes / 8) * 8))) :
+										(2 + (dataBytes * 2) / st->channels);
+				if (!st->samplesPerBlock || (st->samplesPerBlock > blockFrames))
+				{
+					st->samplesPerBlock = blockFrames;
+				}
+
+				memcpy(st->msCoefs, msStandardCoefs, sizeof(st->msCoefs));
+				if ((format == WAV_FORMAT_MS_ADPCM) && (bytesRead >= WAV_FMT_MAX_BYTES) && ((chunk[20] | (chunk[21] << 8)) >= WAV_MS_COEFS))
+				{
+					for (uint8_t c = 0; c < WAV_MS_COEFS; c++)
+					{
+						st->msCoefs[c][0] = (int16_t)(chunk[22 + 4 * c] | (chunk[23 + 4 * c] << 8));
+						st->msCoefs[c][1] = (int16_t)(chunk[24 + 4 * c] | (chunk[25 + 4 * c] << 8));
+					}
+				}
+			}
+			else
+			{
+				hasFormat = false;
+			}
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			st->dataStart = offset + 8;
+			st->dataEnd = ((size > fileSize - st->dataStart) ? fileSize : (st->dataStart + size));
+		}
+
+		// Chunks are padded to an even size
+		offset += 8 + size + (size & 1);
+	}
+
+	if (!hasFormat || !st->dataStart)
+	{
+		return false;
+	}
+
+	// Only whole frames, a short last ADPCM block is still decoded
+	if (st->format == WAV_FORMAT_PCM)
+	{
+		st->dataEnd -= (st->dataEnd - st->dataStart) % st->frameBytes;
+	}
+	return true;
+}
+
+
+static uint32_t fillRing(wavStream_t * st)
+{
+	uint32_t totalBytesRead = 0;
+
+	while (!st->fileEnded && (st->readPosition < st->dataEnd))
+	{
+		// Whole sectors, up to the sector of the next sample (still in use) or the end of the ring
+		uint32_t ringIndex = st->readPosition & WAV_RING_MASK;
+		uint32_t bytesToRead = WAV_RING_SIZE - (st->readPosition - (st->position & ~(FILE_SECTOR_SIZE - 1)));
+
+		if (bytesToRead > WAV_RING_SIZE - ringIndex)
+		{
+			bytesToRead = WAV_RING_SIZE - ringIndex;
+		}
+
+		if (bytesToRead < FILE_SECTOR_SIZE)
+		{
+			break;
+		}
+
+		UINT bytesRead = 0;
+		if (f_read(&st->file, &st->ring[ringIndex], bytesToRead, &bytesRead) != FR_OK)
+		{
+			bytesRead = 0;
+		}
+
+		st->readPosition += bytesRead;
+		totalBytesRead += bytesRead;
+		st->fileEnded = (bytesRead < bytesToRead);
+	}
+
+	return totalBytesRead;
+}
+
+
+static void seekAligned(wavStream_t * st, uint32_t filePosition)
+{
+	uint32_t sectorStart = filePosition & ~(FILE_SECTOR_SIZE - 1);
+
+	f_lseek(&st->file, sectorStart);
+
+	st->readPosition = sectorStart;
+	st->position = filePosition;
+	st->fileEnded = false;
+}
+
+
+static void convertFrames(const wavStream_t * st, const uint8_t * src, uint32_t frames, short * dst)
+{
+	uint32_t samples = frames * st->channels;
+
+	if (st->lastChannels != st->channels)
+	{
+		// Center cancel: (L - R) / 2, from the top 16 bits of each sample
+		for (uint32_t i = 0; i < frames; i++, src += st->frameBytes)
+		{
+			const uint8_t * r = src + st->bytesPerSample;
+			int32_t left = (st->bytesPerSample == 1) ? ((src[0] - 128) << 8) : (int16_t)(src[st->bytesPerSample - 2] | (src[st->bytesPerSample - 1] << 8));
+			int32_t right = (st->bytesPerSample == 1) ? ((r[0] - 128) << 8) : (int16_t)(r[st->bytesPerSample - 2] | (r[st->bytesPerSample - 1] << 8));
+			dst[i] = (left - right) / 2;
+		}
+		return;
+	}
+
+	switch (st->bytesPerSample)
+	{
+		case 2:
+			// Already what the handler wants, word copies
+			memcpy(dst, src, samples * 2);
+			break;
+
+		case 1:
+			// Unsigned 8 bit
+			for (uint32_t i = 0; i < samples; i++)
+			{
+				dst[i] = (src[i] - 128) << 8;
+			}
+			break;
+
+		case 3:
+			// The top 16 bits, the DAC has 12
+			for (uint32_t i = 0; i < samples; i++, src += 3)
+			{
+				dst[i] = (int16_t)(src[1] | (src[2] << 8));
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+static uint32_t decodeAdpcm(wavStream_t * st, short * dst, uint32_t frames)
+{
+	uint32_t decoded = 0;
+
+	while (frames - decoded >= WAV_ADPCM_STEP_FRAMES)
+	{
+		short * out = dst + decoded * st->channels;
+		uint32_t stepFrames = st->blockFramesLeft ? decodeAdpcmStep(st, out) : startAdpcmBlock(st, out);
+
+		if (!stepFrames)
+		{
+			break;
+		}
+		decoded += stepFrames;
+	}
+
+	return decoded;
+}
+
+
+static uint32_t startAdpcmBlock(wavStream_t * st, short * dst)
+{
+	uint8_t channels = st->channels;
+	bool ima = (st->format == WAV_FORMAT_IMA_ADPCM);
+	uint32_t headerBytes = (ima ? WAV_IMA_HEADER_BYTES : WAV_MS_HEADER_BYTES) * channels;
+	uint32_t headerFrames = ima ? 1 : 2;
+	uint32_t p = st->position;
+
+	// Block-aligned: the whole block is in the ring before it is started, the steps do not check
+	if ((st->readPosition < p + st->blockAlign) && !st->fileEnded)
+	{
+		fillRing(st);
+	}
+
+	uint32_t end = (st->readPosition < st->dataEnd) ? st->readPosition : st->dataEnd;
+	uint32_t blockBytes = (end > p) ? (end - p) : 0;
+	if (blockBytes > st->blockAlign)
+	{
+		blockBytes = st->blockAlign;
+	}
+	if (blockBytes <= headerBytes)
+	{
+		return 0;
+	}
+
+	uint32_t dataBytes = blockBytes - headerBytes;
+	uint32_t blockFrames;
+
+	if (ima)
+	{
+		blockFrames = 1 + ((channels == 1) ? (dataBytes * 2) : ((dataBytes / 8) * 8));
+
+		for (uint8_t c = 0; c < channels; c++)
+		{
+			adpcmChannel_t * ch = &st->adpcm[c];
+
+			ch->sample1 = RING_INT16(st, p + 4 * c);
+			ch->step = RING_BYTE(st, p + 4 * c + 2);
+			if (ch->step > WAV_IMA_MAX_INDEX)
+			{
+				ch->step = WAV_IMA_MAX_INDEX;
+			}
+			dst[c] = ch->sample1;
+		}
+	}
+	else
+	{
+		blockFrames = 2 + (dataBytes * 2) / channels;
+
+		// Predictor indexes, then deltas, then the second samples, then the first ones
+		for (uint8_t c = 0; c < channels; c++)
+		{
+			adpcmChannel_t * ch = &st->adpcm[c];
+			uint8_t predictor = RING_BYTE(st, p + c);
+
+			if (predictor >= WAV_MS_COEFS)
+			{
+				predictor = 0;
+			}
+			ch->coef1 = st->msCoefs[predictor][0];
+			ch->coef2 = st->msCoefs[predictor][1];
+			ch->step = RING_INT16(st, p + channels + 2 * c);
+			ch->sample1 = RING_INT16(st, p + 3 * channels + 2 * c);
+			ch->sample2 = RING_INT16(st, p + 5 * channels + 2 * c);
+
+			// The older one goes out first
+			dst[c] = ch->sample2;
+			dst[channels + c] = ch->sample1;
+		}
+	}
+
+	if (blockFrames > st->samplesPerBlock)
+	{
+		blockFrames = st->samplesPerBlock;
+	}
+
+	st->blockStart = p;
+	st->position = p + headerBytes;
+	st->blockFramesLeft = blockFrames - headerFrames;
+
+	if (!st->blockFramesLeft)
+	{
+		st->position = st->blockStart + st->blockAlign;
+	}
+
+	return headerFrames;
+}
+
+
+static uint32_t decodeAdpcmStep(wavStream_t * st, short * dst)
+{
+	uint32_t p = st->position;
+	uint32_t frames;
+
+	if (st->format == WAV_FORMAT_IMA_ADPCM)
+	{
+		if (st->channels == 1)
+		{
+			// Low nibble first
+			uint8_t code = RING_BYTE(st, p);
+			dst[0] = imaNibble(&st->adpcm[0], code & 0x0F);
+			dst[1] = imaNibble(&st->adpcm[0], code >> 4);
+			frames = 2;
+			st->position += 1;
+		}
+		else
+		{
+			// 4 bytes (8 samples) of the left channel, then 4 of the right one
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				adpcmChannel_t * ch = &st->adpcm[c];
+				for (uint8_t i = 0; i < 4; i++)
+				{
+					uint8_t code = RING_BYTE(st, p + 4 * c + i);
+					dst[4 * i + c] = imaNibble(ch, code & 0x0F);
+					dst[4 * i + 2 + c] = imaNibble(ch, code >> 4);
+				}
+			}
+			frames = 8;
+			st->position += 8;
+		}
+	}
+	else
+	{
+		// High nibble first, left and right if stereo
+		uint8_t code = RING_BYTE(st, p);
+		dst[0] = msNibble(&st->adpcm[0], code >> 4);
+		dst[1] = msNibble(&st->adpcm[st->channels - 1], code & 0x0F);
+		frames = (st->channels == 1) ? 2 : 1;
+		st->position += 1;
+	}
+
+	// samplesPerBlock may end the block in the middle of a step
+	if (frames > st->blockFramesLeft)
+	{
+		frames = st->blockFramesLeft;
+	}
+	st->blockFramesLeft -= frames;
+
+	if (!st->blockFramesLeft)
+	{
+		// Whatever padding is left, the next block starts blockAlign after this one
+		st->position = st->blockStart + st->blockAlign;
+	}
+
+	return frames;
+}
+
+
+static inline short imaNibble(adpcmChannel_t * ch, uint8_t nibble)
+{
+	int32_t step = imaStepTable[ch->step];
+	int32_t diff = step >> 3;
+
+	if (nibble & 1)
+	{
+		diff += step >> 2;
+	}
+	if (nibble & 2)
+	{
+		diff += step >> 1;
+	}
+	if (nibble & 4)
+	{
+		diff += step;
+	}
+
+	int32_t sample = ch->sample1 + ((nibble & 8) ? -diff : diff);
+	if (sample > INT16_MAX)
+	{
+		sample = INT16_MAX;
+	}
+	else if (sample < INT16_MIN)
+	{
+		sample = INT16_MIN;
+	}
+	ch->sample1 = sample;
+
+	ch->step += imaIndexTable[nibble & 7];
+	if (ch->step < 0)
+	{
+		ch->step = 0;
+	}
+	else if (ch->step > WAV_IMA_MAX_INDEX)
+	{
+		ch->step = WAV_IMA_MAX_INDEX;
+	}
+
+	return (short)sample;
+}
+
+
+static inline short msNibble(adpcmChannel_t * ch, uint8_t nibble)
+{
+	int32_t code = (nibble & 8) ? ((int32_t)nibble - 16) : nibble;
+	int32_t sample = ((ch->sample1 * ch->coef1 + ch->sample2 * ch->coef2) >> 8) + code * ch->step;
+
+	if (sample > INT16_MAX)
+	{
+		sample = INT16_MAX;
+	}
+	else if (sample < INT16_MIN)
+	{
+		sample = INT16_MIN;
+	}
+	ch->sample2 = ch->sample1;
+	ch->sample1 = sample;
+
+	ch->step = (msAdaptTable[nibble] * ch->step) >> 8;
+	if (ch->step < 16)
+	{
+		ch->step = 16;
+	}
+
+	return (short)sample;
+}
+
+
+static uint32_t adpcmFramePosition(const wavStream_t * st)
+{
+	// Between blocks position is the start of the next one
+	uint32_t blockOffset = (st->blockFramesLeft ? st->blockStart : st->position) - st->dataStart;
+	uint32_t inBlock = st->blockFramesLeft ? (st->samplesPerBlock - st->blockFramesLeft) : 0;
+
+	return (blockOffset / st->blockAlign) * st->samplesPerBlock + inBlock;
+}
+
+
+static bool wavProbe(const uint8_t * header, uint32_t length)
+{
+	return (length >= 12) && (memcmp(header, "RIFF", 4) == 0) && (memcmp(&header[8], "WAVE", 4) == 0);
+}
+
+
+static bool wavGetChannels(decoder_stream_t id, uint8_t * channelCount)
+{
+	wavStream_t * st = (id == DECODER_PLAYING_STREAM) ? playing : incoming;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+	*channelCount = st->lastChannels;
+	return true;
+}
+
+
+static bool wavSeek(int32_t samples)
+{
+	wavStream_t * st = playing;
+
+	if (!st || !st->fileIsOpened)
+	{
+		return false;
+	}
+
+	int64_t target;
+
+	if (st->format == WAV_FORMAT_PCM)
+	{
+		target = (int64_t)st->position + (int64_t)samples * st->frameBytes;
+	}
+	else
+	{
+		// By block index, the ADPCM state is only known at the start of a block
+		int64_t frame = (int64_t)adpcmFramePosition(st) + samples;
+		if (frame < 0)
+		{
+			frame = 0;
+		}
+		target = st->dataStart + (frame / st->samplesPerBlock) * st->blockAlign;
+		st->blockFramesLeft = 0;
+	}
+
+	if (target >= st->dataEnd)
+	{
+		// Past the end, the song is over
+		st->position = st->dataEnd;
+		return false;
+	}
+	if (target < st->dataStart)
+	{
+		target = st->dataStart;
+	}
+
+	if ((target >= st->position) && (target < st->readPosition))
+	{
+		// Still in the ring
+		st->position = (uint32_t)target;
+	}
+	else
+	{
+		seekAligned(st, (uint32_t)target);
+	}
+	return true;
+}
+
+
+static uint32_t wavGetRemainingMs(void)
+{
+	if (!playing || !playing->fileIsOpened)
+	{
+		return UINT32_MAX;
+	}
+
+	uint64_t frames;
+
+	if (playing->format == WAV_FORMAT_PCM)
+	{
+		frames = (playing->dataEnd - playing->position) / playing->frameBytes;
+	}
+	else
+	{
+		uint32_t blocks = (playing->dataEnd - playing->dataStart + playing->blockAlign - 1) / playing->blockAlign;
+		uint32_t decoded = adpcmFramePosition(playing);
+		uint32_t total = blocks * playing->samplesPerBlock;
+
+		frames = (total > decoded) ? (total - decoded) : 0;
+	}
+	return (uint32_t)(frames * 1000U / playing->sampleRate);
+}
+
+
+static bool wavPromote(void)
+{
+	if (!incoming || !incoming->fileIsOpened)
+	{
+		return false;
+	}
+
+	// Its memory is free for the next crossfade (AudioDecoder_PromoteIncoming)
+	WAVDecoder_Close(DECODER_PLAYING_STREAM);
+
+	playing = incoming;
+	incoming = NULL;
+
+	return true;
+}
+
+
+static void wavSetCenterCancel(bool enable)
+{
+	centerCancel = enable;
+}
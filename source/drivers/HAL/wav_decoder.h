@@ -0,0 +1,89 @@
+/***************************************************************************//**
+  @file     wav_decoder.h
+  @brief    RIFF/WAVE reader: 8/16/24 bit PCM and IMA/MS ADPCM, mono or stereo
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/*******************************************************************************
+*							INCLUDE HEADER FILES
+******************************************************************************/
+
+#ifndef _WAV_DECODER_H_
+#define _WAV_DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_decoder.h"
+
+
+/*******************************************************************************
+*				  CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+******************************************************************************/
+
+// Data kept buffered ahead of the output (KB, power of 2). 16 bit stereo at 44.1 kHz uses ~5.7 KB per ~33 ms,
+// ADPCM a quarter of that. ADPCM blocks of up to half of it are played
+#ifndef WAV_READAHEAD_KB
+#define WAV_READAHEAD_KB	8
+#endif
+
+
+/*******************************************************************************
+ *					VARIABLE PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+// WAV entry of the codec table (audio_decoder.c)
+extern const audio_codec_t wavCodec;
+
+
+/*******************************************************************************
+ *					FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/*
+* @brief Initializes both WAV streams (playing and incoming).
+*/
+void WAVDecoder_Init(void);
+
+
+/**
+ * @brief: Parses the RIFF header of the file and positions it at the start of the data.
+ * @param stream: playing or incoming.
+ * @param filename: file's path.
+ * @return: false if it can't be opened or it is not 8/16/24 bit PCM or IMA/MS ADPCM, mono or stereo.
+ */
+bool WAVDecoder_LoadFile(decoder_stream_t stream, const char* filename);
+
+
+/**
+ * @brief: Converts the next block of PCM (up to 1152 samples per channel) to 16 bits, or decodes
+ *         the next ADPCM samples (whole steps, up to 7 less than that).
+ * @param stream: playing or incoming.
+ * @param decodedDataBuffer: output, interleaved if stereo.
+ * @param decodedBufferSize: size of the output in samples.
+ * @param numSamplesDecoded: here we store the number of samples (all channels).
+ * @param sampleRate: here we store the sample rate of the file.
+ * @return: DECODER_END_OF_FILE after the last sample.
+ */
+decoder_result_t WAVDecoder_DecodeFrame	(decoder_stream_t stream,
+										short* decodedDataBuffer,
+										uint32_t decodedBufferSize,
+										uint32_t* numSamplesDecoded,
+										int* sampleRate);
+
+
+/**
+ * @brief: Background read into the read-ahead buffer of the open files, whole sectors only.
+ * @return: true if something was read.
+ */
+bool WAVDecoder_ReadAhead(void);
+
+
+/**
+ * @brief: Closes the file of a stream.
+ * @param stream: playing or incoming.
+ */
+void WAVDecoder_Close(decoder_stream_t stream);
+
+
+#endif /* _WAV_DECODER_H_ */
@@ -23,8 +23,23 @@
  *
  *
  */
+#include <math.h>
+#include <string.h>
 #include "math_helper.h"
 #include "equalizer.h"
+#include "fsl_device_registers.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* Rate coeffTable was designed for */
+#define TABLE_RATE (44100U)
+
+/* The coefficients are scaled down by 4 (Q2.29), the biquads shift the result back */
+#define POST_SHIFT (2)
+#define COEF_SCALE ((float32_t)(1UL << (31 - POST_SHIFT)))
 
 
 /*******************************************************************************
@@ -52,8 +67,23 @@ static arm_biquad_casd_df1_inst_q31 * High_Filters [6] = {&S3, &S4, &S5, &S6, &S
 
 static q63_t biquadStateBandQ63 [2][4 * 2];
 static q31_t biquadStateBandQ31 [6][4 * 2];
+/* ----------------------------------------------------------------------
+** Block of EQ_Apply, converted to Q31 and filtered in place
+** ------------------------------------------------------------------- */
+static q31_t blockQ31[BLOCKSIZE];
+
 static int32_t bandGains[NUMBER_OF_BANDS]={DEFAULT_GAIN, DEFAULT_GAIN, DEFAULT_GAIN, DEFAULT_GAIN, DEFAULT_GAIN, DEFAULT_GAIN, DEFAULT_GAIN, DEFAULT_GAIN, };
 
+/* ----------------------------------------------------------------------
+** Coefficients the filters run with: the ones of coeffTable for the gain
+** of each band, moved to the current rate
+** ------------------------------------------------------------------- */
+static q31_t bandCoeffs[NUMBER_OF_BANDS][COEF_PER_FILTER];
+
+static const float32_t bandCenters[NUMBER_OF_BANDS] = {80, 160, 320, 640, 1280, 2500, 5000, 10000};
+
+static uint32_t sampleRate = TABLE_RATE;
+
 
 /* ----------------------------------------------------------------------
 ** Entire coefficient table.  There are 10 coefficients per 4th order Biquad
@@ -246,6 +276,17 @@ static const q31_t coeffTable[NUMBER_OF_BANDS * COEF_PER_FILTER * GAIN_LEVELS] =
 		536870912,375814044,204883326,-186040984,-268643972,536870912,-540252661,244102159,400006857,-289423789,
 
 };
+
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static void loadBand(uint32_t band);
+static void warpStage(const q31_t * in, q31_t * out, float32_t alpha);
+static void warpPolynomial(const float32_t * in, float32_t * out, float32_t alpha);
+
+
 /*******************************************************************************
  *******************************************************************************
                         GLOBAL FUNCTION DEFINITIONS
@@ -258,39 +299,13 @@ static const q31_t coeffTable[NUMBER_OF_BANDS * COEF_PER_FILTER * GAIN_LEVELS] =
  */
 void EQ_Init(void)
 {
-	// Inicializar los filtros BIQUAD
-
-        arm_biquad_cas_df1_32x64_init_q31(Low_Filters[0], NUMBER_OF_STAGES,
-            (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*0 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-            &biquadStateBandQ63[0][0], 2);
-
-        arm_biquad_cas_df1_32x64_init_q31(Low_Filters[1], NUMBER_OF_STAGES,
-            (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*1 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-            &biquadStateBandQ63[1][0], 2);
-
-         arm_biquad_cascade_df1_init_q31(High_Filters[0], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*2 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-          &biquadStateBandQ31[0][0], 2);
-
-        arm_biquad_cascade_df1_init_q31(High_Filters[1], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*3 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-          &biquadStateBandQ31[1][0], 2);
+	// Inicializar los filtros BIQUAD, a la frecuencia de la tabla
+	sampleRate = TABLE_RATE;
 
-         arm_biquad_cascade_df1_init_q31(High_Filters[2], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*4 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-          &biquadStateBandQ31[2][0], 2);
-
-        arm_biquad_cascade_df1_init_q31(High_Filters[3], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*5 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-          &biquadStateBandQ31[3][0], 2);
-
-         arm_biquad_cascade_df1_init_q31(High_Filters[4], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*6 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-          &biquadStateBandQ31[4][0], 2);
-
-        arm_biquad_cascade_df1_init_q31(High_Filters[5], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*7 + COEF_PER_FILTER*(DEFAULT_GAIN + MAX_GAIN)],
-          &biquadStateBandQ31[5][0], 2);
+	for (uint32_t band = 0; band < NUMBER_OF_BANDS; band++)
+	{
+		loadBand(band);
+	}
 }
 
 
@@ -301,19 +316,28 @@ void EQ_Init(void)
  */
 void EQ_Set_Band_Gain (int32_t band, int32_t gain)
 {
-    if(band < 3 )
-    {
-         arm_biquad_cas_df1_32x64_init_q31(Low_Filters[band - 1], NUMBER_OF_STAGES,
-            (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*(band-1) + COEF_PER_FILTER*(gain + MAX_GAIN)],
-            &biquadStateBandQ63[band - 1][0], 2);
-    }
-    else
-    {
-         arm_biquad_cascade_df1_init_q31(High_Filters[band - 3], NUMBER_OF_STAGES,
-          (q31_t *) &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*(band-1) + COEF_PER_FILTER*(gain + MAX_GAIN)],
-          &biquadStateBandQ31[band - 3][0], 2);
-    }
 	bandGains[band-1] = gain;
+	loadBand(band - 1);
+}
+
+
+/**
+ * @brief Moves the bands to the rate of the samples, each one stays at the same frequency in Hz.
+ * @param rate sample rate of the data given to EQ_Apply / EQ_ApplyQ31
+ */
+void EQ_SetSampleRate(uint32_t rate)
+{
+	if ((rate == 0) || (rate == sampleRate))
+	{
+		return;
+	}
+
+	sampleRate = rate;
+
+	for (uint32_t band = 0; band < NUMBER_OF_BANDS; band++)
+	{
+		loadBand(band);
+	}
 }
 
 
@@ -327,6 +351,22 @@ int32_t EQ_Get_Band_Gain (int32_t band)
 	return bandGains[band-1];
 }
 
+/**
+ * @brief tells if every band is at 0 dB, EQ_Apply would leave the signal as it is.
+ * @return true if the equalizer is flat
+ */
+bool EQ_IsFlat (void)
+{
+	for (uint8_t band = 0; band < NUMBER_OF_BANDS; band++)
+	{
+		if (bandGains[band] != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 /**
  * @brief Applies the filter to the data in inputF32 and stores the result in outputF32
  * @param inputF32  pointer to an array of size FRAME_SIZE with input data
@@ -335,13 +375,6 @@ int32_t EQ_Get_Band_Gain (int32_t band)
 void EQ_Apply(float32_t* inputF32, float32_t * outputF32)
 {
     
-    /* ----------------------------------------------------------------------
-    ** Q31 input and output buffers
-    ** ------------------------------------------------------------------- */
-
-    q31_t inputQ31[BLOCKSIZE];
-    q31_t outputQ31[BLOCKSIZE];
-
     for(int i=0; i < NUMBER_OF_BLOCKS; i++)
     {
 
@@ -349,34 +382,34 @@ void EQ_Apply(float32_t* inputF32, float32_t * outputF32)
     ** Convert block of input data from float to Q31
     ** ------------------------------------------------------------------- */
 
-    arm_float_to_q31(inputF32 + (i*BLOCKSIZE), inputQ31, BLOCKSIZE);
+    arm_float_to_q31(inputF32 + (i*BLOCKSIZE), blockQ31, BLOCKSIZE);
 
     /* ----------------------------------------------------------------------
     ** Scale down by 1/8.  This provides additional headroom so that the
     ** graphic EQ can apply gain.
     ** ------------------------------------------------------------------- */
 
-    arm_scale_q31(inputQ31, 0x7FFFFFFF, -3, inputQ31, BLOCKSIZE);
+    arm_scale_q31(blockQ31, 0x7FFFFFFF, -3, blockQ31, BLOCKSIZE);
 
     /* ----------------------------------------------------------------------
     ** Call the Q31 Biquad Cascade DF1 32x64 process function for band1, band2
     ** ------------------------------------------------------------------- */
-    arm_biquad_cas_df1_32x64_q31(&S1, inputQ31, outputQ31, BLOCKSIZE);
-    arm_biquad_cas_df1_32x64_q31(&S2, outputQ31, outputQ31, BLOCKSIZE);
+    arm_biquad_cas_df1_32x64_q31(&S1, blockQ31, blockQ31, BLOCKSIZE);
+    arm_biquad_cas_df1_32x64_q31(&S2, blockQ31, blockQ31, BLOCKSIZE);
     /* ----------------------------------------------------------------------
     ** Call the Q31 Biquad Cascade DF1 process function for band3, band4, band5, band6, band7, band8
     ** ------------------------------------------------------------------- */
-    arm_biquad_cascade_df1_fast_q31(&S3, outputQ31, outputQ31, BLOCKSIZE);
-    arm_biquad_cascade_df1_fast_q31(&S4, outputQ31, outputQ31, BLOCKSIZE);
-    arm_biquad_cascade_df1_fast_q31(&S5, outputQ31, outputQ31, BLOCKSIZE);
-    arm_biquad_cascade_df1_fast_q31(&S6, outputQ31, outputQ31, BLOCKSIZE);
-    arm_biquad_cascade_df1_fast_q31(&S7, outputQ31, outputQ31, BLOCKSIZE);
-    arm_biquad_cascade_df1_fast_q31(&S8, outputQ31, outputQ31, BLOCKSIZE);
+    arm_biquad_cascade_df1_fast_q31(&S3, blockQ31, blockQ31, BLOCKSIZE);
+    arm_biquad_cascade_df1_fast_q31(&S4, blockQ31, blockQ31, BLOCKSIZE);
+    arm_biquad_cascade_df1_fast_q31(&S5, blockQ31, blockQ31, BLOCKSIZE);
+    arm_biquad_cascade_df1_fast_q31(&S6, blockQ31, blockQ31, BLOCKSIZE);
+    arm_biquad_cascade_df1_fast_q31(&S7, blockQ31, blockQ31, BLOCKSIZE);
+    arm_biquad_cascade_df1_fast_q31(&S8, blockQ31, blockQ31, BLOCKSIZE);
     /* ----------------------------------------------------------------------
     ** Convert Q31 result back to float
     ** ------------------------------------------------------------------- */
 
-    arm_q31_to_float(outputQ31, outputF32 + (i * BLOCKSIZE), BLOCKSIZE);
+    arm_q31_to_float(blockQ31, outputF32 + (i * BLOCKSIZE), BLOCKSIZE);
 
     /* ----------------------------------------------------------------------
     ** Scale back up
@@ -385,3 +418,158 @@ void EQ_Apply(float32_t* inputF32, float32_t * outputF32)
     arm_scale_f32(outputF32 + (i * BLOCKSIZE), 8.0f, outputF32 + (i * BLOCKSIZE), BLOCKSIZE);
   };
 }
+
+
+/**
+ * @brief Applies the filter to Q31 samples in place, without going through float
+ * @param data pointer to an array of size FRAME_SIZE, with EQ_HEADROOM_BITS of headroom
+ */
+void EQ_ApplyQ31(q31_t * data)
+{
+    /* ----------------------------------------------------------------------
+    ** The same filters as EQ_Apply, on the whole frame. The samples already
+    ** have the headroom, there is nothing to convert or scale
+    ** ------------------------------------------------------------------- */
+    arm_biquad_cas_df1_32x64_q31(&S1, data, data, FRAME_SIZE);
+    arm_biquad_cas_df1_32x64_q31(&S2, data, data, FRAME_SIZE);
+
+    arm_biquad_cascade_df1_fast_q31(&S3, data, data, FRAME_SIZE);
+    arm_biquad_cascade_df1_fast_q31(&S4, data, data, FRAME_SIZE);
+    arm_biquad_cascade_df1_fast_q31(&S5, data, data, FRAME_SIZE);
+    arm_biquad_cascade_df1_fast_q31(&S6, data, data, FRAME_SIZE);
+    arm_biquad_cascade_df1_fast_q31(&S7, data, data, FRAME_SIZE);
+    arm_biquad_cascade_df1_fast_q31(&S8, data, data, FRAME_SIZE);
+}
+
+/**
+ * @brief Runs a frame through the float chain (EQ_Apply) and the Q31 one (EQ_ApplyQ31) from the same
+ *        filter state, and measures both. The Q31 result is kept, as if EQ_ApplyQ31 had been called
+ * @param data pointer to an array of size FRAME_SIZE, with EQ_HEADROOM_BITS of headroom //!(will be overwritten)
+ * @param reference scratch of FRAME_SIZE floats, the float chain
+ * @param test scratch of FRAME_SIZE floats, the Q31 chain
+ * @param floatCycles here we store the cycles of the float chain, conversions included
+ * @param fixedCycles here we store the cycles of the Q31 chain
+ * @return SNR of the Q31 chain against the float one, in dB (arm_snr_f32)
+ */
+float EQ_CompareChains(q31_t * data, float32_t * reference, float32_t * test,
+                       uint32_t * floatCycles, uint32_t * fixedCycles)
+{
+    q63_t savedQ63[2][4 * 2];
+    q31_t savedQ31[6][4 * 2];
+    uint32_t start;
+
+    for (uint32_t i = 0; i < FRAME_SIZE; i++)
+    {
+        reference[i] = data[i] * EQ_Q31_TO_FLOAT;
+    }
+
+    memcpy(savedQ63, biquadStateBandQ63, sizeof(savedQ63));
+    memcpy(savedQ31, biquadStateBandQ31, sizeof(savedQ31));
+
+    start = DWT->CYCCNT;
+    EQ_Apply(reference, reference);
+    *floatCycles = DWT->CYCCNT - start;
+
+    // Both chains start from the same state
+    memcpy(biquadStateBandQ63, savedQ63, sizeof(savedQ63));
+    memcpy(biquadStateBandQ31, savedQ31, sizeof(savedQ31));
+
+    start = DWT->CYCCNT;
+    EQ_ApplyQ31(data);
+    *fixedCycles = DWT->CYCCNT - start;
+
+    for (uint32_t i = 0; i < FRAME_SIZE; i++)
+    {
+        test[i] = data[i] * EQ_Q31_TO_FLOAT;
+    }
+
+    return arm_snr_f32(reference, test, FRAME_SIZE);
+}
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+/**
+ * @brief Loads the coefficients of the gain of a band, at the current rate, and restarts its filter.
+ * @param band between 0 and NUMBER_OF_BANDS - 1
+ */
+static void loadBand(uint32_t band)
+{
+	const q31_t * table = &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*band + COEF_PER_FILTER*(bandGains[band] + MAX_GAIN)];
+	float32_t center = bandCenters[band];
+
+	if (2 * center >= sampleRate)
+	{
+		// Over the Nyquist frequency, the band is left flat
+		table = &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*band + COEF_PER_FILTER*MAX_GAIN];
+	}
+
+	if (sampleRate == TABLE_RATE)
+	{
+		memcpy(bandCoeffs[band], table, sizeof(bandCoeffs[band]));
+	}
+	else
+	{
+		// The allpass z^-1 -> (z^-1 - alpha) / (1 - alpha z^-1) takes the center at the table rate to the same Hz at this one.
+		// Only the center is exact: at 48 kHz the 10 kHz band is up to ~1.1 dB off at its edges, the rest within 0.25 dB
+		float32_t theta = 2.0f * PI * center / TABLE_RATE;
+		float32_t omega = 2.0f * PI * center / sampleRate;
+		float32_t alpha = sinf((theta - omega) / 2.0f) / sinf((theta + omega) / 2.0f);
+
+		for (uint32_t stage = 0; stage < NUMBER_OF_STAGES; stage++)
+		{
+			warpStage(&table[stage * 5], &bandCoeffs[band][stage * 5], alpha);
+		}
+	}
+
+	if (band < 2)
+	{
+		arm_biquad_cas_df1_32x64_init_q31(Low_Filters[band], NUMBER_OF_STAGES, bandCoeffs[band],
+			&biquadStateBandQ63[band][0], POST_SHIFT);
+	}
+	else
+	{
+		arm_biquad_cascade_df1_init_q31(High_Filters[band - 2], NUMBER_OF_STAGES, bandCoeffs[band],
+			&biquadStateBandQ31[band - 2][0], POST_SHIFT);
+	}
+}
+
+
+/**
+ * @brief Moves one biquad, {b0, b1, b2, a1, a2} of CMSIS, with the allpass transform.
+ */
+static void warpStage(const q31_t * in, q31_t * out, float32_t alpha)
+{
+	// CMSIS adds a1 y[n-1] + a2 y[n-2], the denominator is 1 - a1 z^-1 - a2 z^-2
+	float32_t numerator[3] = {in[0] / COEF_SCALE, in[1] / COEF_SCALE, in[2] / COEF_SCALE};
+	float32_t denominator[3] = {1.0f, -in[3] / COEF_SCALE, -in[4] / COEF_SCALE};
+	float32_t b[3];
+	float32_t a[3];
+
+	warpPolynomial(numerator, b, alpha);
+	warpPolynomial(denominator, a, alpha);
+
+	// Back to a0 = 1. They stay under 2, well within the range of Q2.29
+	out[0] = (q31_t)lrintf(b[0] / a[0] * COEF_SCALE);
+	out[1] = (q31_t)lrintf(b[1] / a[0] * COEF_SCALE);
+	out[2] = (q31_t)lrintf(b[2] / a[0] * COEF_SCALE);
+	out[3] = (q31_t)lrintf(-a[1] / a[0] * COEF_SCALE);
+	out[4] = (q31_t)lrintf(-a[2] / a[0] * COEF_SCALE);
+}
+
+
+/**
+ * @brief p0 + p1 z^-1 + p2 z^-2 with z^-1 = (z^-1 - alpha) / (1 - alpha z^-1), times (1 - alpha z^-1)^2.
+ */
+static void warpPolynomial(const float32_t * in, float32_t * out, float32_t alpha)
+{
+	float32_t squared = alpha * alpha;
+
+	out[0] = in[0] - alpha * in[1] + squared * in[2];
+	out[1] = -2.0f * alpha * in[0] + (1.0f + squared) * in[1] - 2.0f * alpha * in[2];
+	out[2] = squared * in[0] - alpha * in[1] + in[2];
+}
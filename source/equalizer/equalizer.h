@@ -9,6 +9,7 @@
 /*******************************************************************************
  * INCLUDE HEADER FILES
  ******************************************************************************/
+#include <stdbool.h>
 #include "arm_math.h"
 /*******************************************************************************
  * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
@@ -38,6 +39,11 @@
 /*Filter gain on init*/
 #define DEFAULT_GAIN (0)
 
+/* Bits of headroom of the Q31 samples of EQ_ApplyQ31, for the gain of the bands. 1.0 of EQ_Apply is 2^28 */
+#define EQ_HEADROOM_BITS (3)
+
+#define EQ_Q31_TO_FLOAT (1.0f / (1 << (31 - EQ_HEADROOM_BITS)))
+
 /*******************************************************************************
  * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
  ******************************************************************************/
@@ -55,6 +61,14 @@ void EQ_Init(void);
  */
 void EQ_Set_Band_Gain (int32_t band, int32_t gain);
 
+/**
+ * @brief Moves the bands to the rate of the samples, each one stays at the same frequency in Hz.
+ *        The coefficient table is designed at 44.1 kHz, the rate after EQ_Init.
+ *        The filters start again from silence when the rate changes.
+ * @param rate sample rate of the data given to EQ_Apply / EQ_ApplyQ31
+ */
+void EQ_SetSampleRate(uint32_t rate);
+
 /**
  * @brief returns equalizer filter gains.
  * @return gain  number in dB 
@@ -62,6 +76,12 @@ void EQ_Set_Band_Gain (int32_t band, int32_t gain);
  */
 int32_t EQ_Get_Band_Gain (int32_t band);
 
+/**
+ * @brief tells if every band is at 0 dB, EQ_Apply would leave the signal as it is.
+ * @return true if the equalizer is flat
+ */
+bool EQ_IsFlat (void);
+
 /**
  * @brief Applies the filter to the data in inputF32 and stores the result in outputF32
  * @param inputF32  pointer to an array of size FRAME_SIZE with input data
@@ -69,4 +89,23 @@ int32_t EQ_Get_Band_Gain (int32_t band);
  */
 void EQ_Apply(float32_t* inputF32, float32_t * outputF32);
 
+/**
+ * @brief Applies the filter to Q31 samples in place, without going through float
+ * @param data pointer to an array of size FRAME_SIZE, with EQ_HEADROOM_BITS of headroom
+ */
+void EQ_ApplyQ31(q31_t * data);
+
+/**
+ * @brief Runs a frame through the float chain (EQ_Apply) and the Q31 one (EQ_ApplyQ31) from the same
+ *        filter state, and measures both. The Q31 result is kept, as if EQ_ApplyQ31 had been called
+ * @param data pointer to an array of size FRAME_SIZE, with EQ_HEADROOM_BITS of headroom //!(will be overwritten)
+ * @param reference scratch of FRAME_SIZE floats, the float chain
+ * @param test scratch of FRAME_SIZE floats, the Q31 chain
+ * @param floatCycles here we store the cycles of the float chain, conversions included
+ * @param fixedCycles here we store the cycles of the Q31 chain
+ * @return SNR of the Q31 chain against the float one, in dB (arm_snr_f32)
+ */
+float EQ_CompareChains(q31_t * data, float32_t * reference, float32_t * test,
+                       uint32_t * floatCycles, uint32_t * fixedCycles);
+
 #endif
@@ -0,0 +1,152 @@
+/*******************************************************************************
+  @file     limiter.c
+  @brief    Look-ahead peak limiter, Q31 mono, between the EQ and the output stage
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * The samples go out through a delay line as long as the look-ahead. The highest magnitude of the window
+ * that is in the delay line (the new sample included) is tracked with a monotonic deque: each sample goes
+ * in once and out once, O(1) per sample whatever the length. The gain that window needs is threshold / max,
+ * the gain gets there in a straight line before the peak leaves the delay line, so no sample is let out
+ * above the threshold. Once the peak is gone the gain goes back up exponentially, at the release rate.
+ */
+#include <math.h>
+#include <string.h>
+#include "limiter.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define RING_MASK (LIMITER_MAX_LOOKAHEAD - 1)
+
+#define UNITY_GAIN (0x7FFFFFFF)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static q31_t delayLine[LIMITER_MAX_LOOKAHEAD];
+static uint32_t lookahead = 0;				// Samples
+static uint32_t position = 0;				// Of the new sample, free running
+
+/* The deque: magnitudes that can still be the max of the window, decreasing from head to tail */
+static q31_t peakValues[LIMITER_MAX_LOOKAHEAD];
+static uint32_t peakPositions[LIMITER_MAX_LOOKAHEAD];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+
+static q31_t gain = UNITY_GAIN;
+static q31_t target = UNITY_GAIN;			// Of the current max
+static q31_t attackStep = 0;				// Per sample, while the gain goes down to the target
+static q31_t releaseCoefficient = 0;		// Fraction of the way up to the target, per sample
+static q31_t lastPeak = -1;					// The target is only divided again when the max changes
+static q31_t lastThreshold = -1;
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+void Limiter_Init(uint32_t sampleRate, uint32_t attackUs, uint32_t releaseMs)
+{
+	lookahead = (uint32_t)(((uint64_t)sampleRate * attackUs) / 1000000U);
+	lookahead = (lookahead > RING_MASK) ? RING_MASK : lookahead;
+
+	// 1 - e^(-1 / (release * rate)): 63% of the way up after releaseMs
+	float samples = (releaseMs ? releaseMs : 1) * (sampleRate / 1000.0f);
+	releaseCoefficient = (q31_t)((1.0f - expf(-1.0f / samples)) * 2147483648.0f);
+
+	Limiter_Clear();
+}
+
+
+void Limiter_Clear(void)
+{
+	memset(delayLine, 0, sizeof(delayLine));
+	position = 0;
+	head = 0;
+	tail = 0;
+	gain = UNITY_GAIN;
+	target = UNITY_GAIN;
+	attackStep = 0;
+	lastPeak = -1;
+}
+
+
+void Limiter_Process(q31_t * data, uint32_t length, q31_t threshold)
+{
+	if (threshold != lastThreshold)
+	{
+		// The volume changed, the target of the same max too
+		lastThreshold = threshold;
+		lastPeak = -1;
+	}
+
+	for (uint32_t index = 0; index < length; index++)
+	{
+		q31_t sample = data[index];
+
+		// |x|, one less for negatives so -2^31 does not overflow
+		q31_t magnitude = sample ^ (sample >> 31);
+
+		// 1 - The head leaves the window with the sample going out now, there is room for the new one
+		if ((tail != head) && (position - peakPositions[head & RING_MASK] > lookahead))
+		{
+			head++;
+		}
+
+		// 2 - Into the deque, the ones it hides can never be the max again
+		while ((tail != head) && (peakValues[(tail - 1) & RING_MASK] <= magnitude))
+		{
+			tail--;
+		}
+		peakValues[tail & RING_MASK] = magnitude;
+		peakPositions[tail & RING_MASK] = position;
+		tail++;
+
+		q31_t peak = peakValues[head & RING_MASK];
+
+		if (peak != lastPeak)
+		{
+			lastPeak = peak;
+			q31_t needed = (peak > threshold) ? (q31_t)(((q63_t)threshold << 31) / peak) : UNITY_GAIN;
+
+			if (needed < gain)
+			{
+				// Down by the time this peak is out, lookahead + 1 steps. A steeper ramp still going on is kept
+				q31_t step = (gain - needed) / (q31_t)(lookahead + 1) + 1;
+				attackStep = (step > attackStep) ? step : attackStep;
+			}
+			target = needed;
+		}
+
+		// 3 - The gain, always on the safe side of the target on the way down
+		if (gain > target)
+		{
+			gain = (gain - target > attackStep) ? (gain - attackStep) : target;
+		}
+		else
+		{
+			attackStep = 0;
+			gain += (q31_t)(((q63_t)(target - gain) * releaseCoefficient) >> 31);
+		}
+
+		// 4 - Through the delay line, the sample going out gets the gain
+		delayLine[position & RING_MASK] = sample;
+		q31_t delayed = delayLine[(position - lookahead) & RING_MASK];
+		position++;
+
+		data[index] = (q31_t)(((q63_t)delayed * gain) >> 31);
+	}
+}
+
+
+q31_t Limiter_GetGain(void)
+{
+	return gain;
+}
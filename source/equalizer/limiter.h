@@ -0,0 +1,57 @@
+/*******************************************************************************
+  @file     limiter.h
+  @brief    Look-ahead peak limiter, Q31 mono, between the EQ and the output stage
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+#ifndef LIMITER_H
+#define LIMITER_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+#include <stdint.h>
+#include "arm_math.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* Longest look-ahead in samples, a power of two. 5.3 ms at 48 kHz */
+#define LIMITER_MAX_LOOKAHEAD (256)
+
+#define LIMITER_DEFAULT_ATTACK_US (2000)
+#define LIMITER_DEFAULT_RELEASE_MS (100)
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief Sets the times of the limiter and starts it from silence, at unity gain.
+ * @param sampleRate rate of the samples given to Limiter_Process
+ * @param attackUs look-ahead, the gain reaches the level of a peak in this time. Also the delay it adds
+ * @param releaseMs time constant of the gain going back up after a peak
+ */
+void Limiter_Init(uint32_t sampleRate, uint32_t attackUs, uint32_t releaseMs);
+
+/**
+ * @brief Clears the delay line, the next samples start from silence. The times are kept.
+ */
+void Limiter_Clear(void);
+
+/**
+ * @brief Limits the samples in place, delayed by the look-ahead. O(1) per sample; its cycles on the K64F are
+ * not measured yet, mp3Handler_getLimiterCycles reports them.
+ * @param data mono Q31 samples
+ * @param length samples
+ * @param threshold highest magnitude let out, INT32_MAX lets everything through (only delayed)
+ */
+void Limiter_Process(q31_t * data, uint32_t length, q31_t threshold);
+
+/**
+ * @brief Gain applied to the last sample.
+ * @return Q31, 0x7FFFFFFF when nothing is being limited
+ */
+q31_t Limiter_GetGain(void);
+
+#endif
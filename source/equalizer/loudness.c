@@ -0,0 +1,247 @@
+/*******************************************************************************
+  @file     loudness.c
+  @brief    Integrated loudness (EBU R128 / ITU-R BS.1770) of a song, while it plays
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * The samples go through the K-weighting of BS.1770 (a +4 dB shelf above ~1.7 kHz and a 38 Hz high-pass),
+ * two biquads run by the same CMSIS engine as the low bands of the equalizer. Their energy is added in 100 ms
+ * hops and every four hops make a 400 ms block, 75% overlapped. Only a histogram of the block levels is kept
+ * (0.1 LU bins), the two gates are applied to it at the end, so the memory does not grow with the song.
+ */
+#include <math.h>
+#include <string.h>
+#include "loudness.h"
+#include "equalizer.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* Both K-weighting stages, their coefficients are below 4 */
+#define K_STAGES (2)
+#define K_POST_SHIFT (2)
+
+/* Samples filtered at a time */
+#define CHUNK_SIZE (64)
+
+/* Hops of 100 ms in a 400 ms block */
+#define BLOCK_HOPS (4)
+
+/* Block levels kept, from the absolute gate up */
+#define ABSOLUTE_GATE_LUFS (-70.0f)
+#define RELATIVE_GATE_LU (-10.0f)
+#define BIN_LU (0.1f)
+#define HISTOGRAM_BINS (800)
+
+/* BS.1770: L = -0.691 + 10 log10(mean square) */
+#define LOUDNESS_OFFSET (-0.691f)
+
+/* arm_power_q31 adds squares in 2.48, full scale of the handler is 2^28: 1.0 squared is 2^48 / 2^6 */
+#define POWER_FULL_SCALE (281474976710656.0f / 64.0f)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static arm_biquad_cas_df1_32x64_ins_q31 kWeighting;
+static q31_t kCoefficients[5 * K_STAGES];
+static q63_t kState[4 * K_STAGES];
+static q31_t weighted[CHUNK_SIZE];
+
+static uint32_t hopLength;				// Samples in 100 ms
+static uint32_t hopSamples;				// Samples in the current hop so far
+static q63_t hopEnergy;					// Of the current hop
+static q63_t hops[BLOCK_HOPS];			// Of the last four hops, a ring
+static uint32_t hopCount;
+
+static uint16_t histogram[HISTOGRAM_BINS];
+static uint32_t blocks;					// Above the absolute gate
+static q31_t peak;
+
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static void setStage(q31_t * coefficients, double b0, double b1, double b2, double a1, double a2);
+static void addBlock(void);
+static float binEnergy(uint32_t bin);
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+void Loudness_Start(uint32_t sampleRate)
+{
+	// Shelf, the analog prototype of BS.1770 through the bilinear transform at this rate
+	double k = tan(PI * 1681.974450955533 / sampleRate);
+	double q = 0.7071752369554196;
+	double vh = pow(10.0, 3.999843853973347 / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+
+	setStage(&kCoefficients[0], (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+			 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0);
+
+	// High-pass, unity gain in the pass band
+	k = tan(PI * 38.13547087602444 / sampleRate);
+	q = 0.5003270373238773;
+	a0 = 1.0 + k / q + k * k;
+
+	setStage(&kCoefficients[5], 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0);
+
+	arm_biquad_cas_df1_32x64_init_q31(&kWeighting, K_STAGES, kCoefficients, kState, K_POST_SHIFT);
+
+	hopLength = sampleRate / 10;
+	hopSamples = 0;
+	hopEnergy = 0;
+	hopCount = 0;
+	memset(hops, 0, sizeof(hops));
+	memset(histogram, 0, sizeof(histogram));
+	blocks = 0;
+	peak = 0;
+}
+
+
+void Loudness_Process(const q31_t * data, uint32_t length)
+{
+	while (length)
+	{
+		// Never across the end of a hop
+		uint32_t chunk = hopLength - hopSamples;
+		chunk = (chunk > CHUNK_SIZE) ? CHUNK_SIZE : chunk;
+		chunk = (chunk > length) ? length : chunk;
+
+		for (uint32_t i = 0; i < chunk; i++)
+		{
+			q31_t magnitude = (data[i] < 0) ? -data[i] : data[i];
+			if (magnitude > peak)
+			{
+				peak = magnitude;
+			}
+		}
+
+		arm_biquad_cas_df1_32x64_q31(&kWeighting, (q31_t *)data, weighted, chunk);
+
+		q63_t energy;
+		arm_power_q31(weighted, chunk, &energy);
+		hopEnergy += energy;
+		hopSamples += chunk;
+
+		if (hopSamples == hopLength)
+		{
+			hops[hopCount % BLOCK_HOPS] = hopEnergy;
+			hopCount++;
+			hopEnergy = 0;
+			hopSamples = 0;
+
+			if (hopCount >= BLOCK_HOPS)
+			{
+				addBlock();
+			}
+		}
+
+		data += chunk;
+		length -= chunk;
+	}
+}
+
+
+bool Loudness_GetResult(float * lufs, float * peakOut)
+{
+	float energy = 0;
+	uint32_t bin;
+
+	*peakOut = peak * EQ_Q31_TO_FLOAT;
+
+	if (!blocks)
+	{
+		return false;
+	}
+
+	// Ungated by the relative gate first, it sets where that gate is
+	for (bin = 0; bin < HISTOGRAM_BINS; bin++)
+	{
+		energy += histogram[bin] * binEnergy(bin);
+	}
+
+	float gate = LOUDNESS_OFFSET + 10.0f * log10f(energy / blocks) + RELATIVE_GATE_LU;
+	int32_t first = (int32_t)((gate - ABSOLUTE_GATE_LUFS) / BIN_LU);
+	uint32_t count = 0;
+
+	energy = 0;
+	for (bin = (first > 0) ? first : 0; bin < HISTOGRAM_BINS; bin++)
+	{
+		energy += histogram[bin] * binEnergy(bin);
+		count += histogram[bin];
+	}
+
+	if (!count)
+	{
+		return false;
+	}
+
+	*lufs = LOUDNESS_OFFSET + 10.0f * log10f(energy / count);
+	return true;
+}
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static void setStage(q31_t * coefficients, double b0, double b1, double b2, double a1, double a2)
+{
+	// CMSIS adds the feedback terms, the signs of a1 and a2 are flipped
+	const double scale = 2147483648.0 / (1 << K_POST_SHIFT);
+
+	coefficients[0] = (q31_t)lround(b0 * scale);
+	coefficients[1] = (q31_t)lround(b1 * scale);
+	coefficients[2] = (q31_t)lround(b2 * scale);
+	coefficients[3] = (q31_t)lround(-a1 * scale);
+	coefficients[4] = (q31_t)lround(-a2 * scale);
+}
+
+
+static void addBlock(void)
+{
+	q63_t energy = hops[0] + hops[1] + hops[2] + hops[3];
+	float meanSquare = (float)energy / (POWER_FULL_SCALE * BLOCK_HOPS * hopLength);
+
+	if (meanSquare <= 0)
+	{
+		return;
+	}
+
+	float level = LOUDNESS_OFFSET + 10.0f * log10f(meanSquare);
+
+	if (level < ABSOLUTE_GATE_LUFS)
+	{
+		return;
+	}
+
+	uint32_t bin = (uint32_t)((level - ABSOLUTE_GATE_LUFS) / BIN_LU);
+	if (bin >= HISTOGRAM_BINS)
+	{
+		bin = HISTOGRAM_BINS - 1;
+	}
+
+	// A song of almost two hours fills a bin, it stays there
+	if (histogram[bin] < UINT16_MAX)
+	{
+		histogram[bin]++;
+		blocks++;
+	}
+}
+
+
+static float binEnergy(uint32_t bin)
+{
+	// Mean square of the middle of the bin
+	float level = ABSOLUTE_GATE_LUFS + (bin + 0.5f) * BIN_LU;
+	return powf(10.0f, (level - LOUDNESS_OFFSET) / 10.0f);
+}
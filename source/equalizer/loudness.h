@@ -0,0 +1,48 @@
+/*******************************************************************************
+  @file     loudness.h
+  @brief    Integrated loudness (EBU R128 / ITU-R BS.1770) of a song, while it plays
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include "arm_math.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* ReplayGain 2.0 reference level, a song measured at it plays with a gain of 0 dB */
+#define LOUDNESS_TARGET_LUFS (-18.0f)
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief Starts measuring a song: K-weighting filters for the rate, no blocks yet.
+ * @param sampleRate rate of the samples given to Loudness_Process
+ */
+void Loudness_Start(uint32_t sampleRate);
+
+/**
+ * @brief Adds samples of the song, K-weighted into 400 ms blocks every 100 ms.
+ * @param data mono Q31 with EQ_HEADROOM_BITS of headroom, as the handler mixes it (not modified)
+ * @param length samples
+ */
+void Loudness_Process(const q31_t * data, uint32_t length);
+
+/**
+ * @brief Integrated loudness of what was given so far, gated at -70 LUFS and 10 LU below the ungated level.
+ * @param lufs here we store the loudness
+ * @param peak here we store the highest sample, 1.0 is full scale
+ * @return false if no block was above the gates yet
+ */
+bool Loudness_GetResult(float * lufs, float * peak);
+
+#endif
@@ -0,0 +1,334 @@
+/*******************************************************************************
+  @file     resampler.c
+  @brief    Polyphase resampler, Q31 mono, to a fixed output rate
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Each output sample falls between two input samples, at a fraction of the way. The fraction picks two
+ * neighbouring phases of a Kaiser windowed sinc (beta 7.9, cut at half the input rate), both are run over
+ * RESAMPLER_TAPS input samples and the results are blended linearly. Up to the output rate the same filter
+ * removes the images of every rate: flat to ~0.42 of the input rate, ~80 dB down from ~0.58 of it.
+ *
+ * Above the output rate (88.2 and 96 kHz files) the cut has to be at half the output rate instead. The same
+ * sinc is stretched by inRate/outRate: every input sample under it takes its own coefficient, interpolated
+ * from the table, and the sum is scaled back by outRate/inRate. Up to RESAMPLER_MAX_DECIMATION times the
+ * output rate it is flat to ~0.42 and ~78 dB down from ~0.58 of the output rate (tests/host/resampler_test.c),
+ * faster inputs would need more history and only get the filter stretched that much.
+ *
+ * The position is kept as an exact fraction of the output rate, nothing drifts however long the song.
+ */
+#include <string.h>
+#include "resampler.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* Phases of the filter between two input samples, the ones in between are interpolated */
+#define PHASE_BITS (6)
+#define PHASES (1 << PHASE_BITS)
+
+/* Coefficients are Q14, every phase adds up to exactly 1 */
+#define COEFFICIENT_BITS (14)
+
+/* Position in the table, in 1/PHASES of an input sample, Q16 */
+#define TABLE_STEP_BITS (PHASE_BITS + 16)
+
+/* The sinc is 0 from RESAMPLER_TAPS/2 samples away */
+#define TABLE_EDGE (RESAMPLER_TAPS/2 * PHASES)
+
+/* Bits of the blend between two phases when stretched, at most 64 taps of Q31 by Q22 fit in the accumulator */
+#define BLEND_BITS (8)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/* ----------------------------------------------------------------------
+** Phase p is the filter for an output p/PHASES of the way from input
+** sample RESAMPLER_TAPS/2 - 1 to the next one. The last row is the first
+** one moved by a sample, to interpolate past the last phase
+** ------------------------------------------------------------------- */
+static const int16_t coefficients[PHASES + 1][RESAMPLER_TAPS] = {
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16384, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, -1, 2, -3, 5, -8, 12, -17, 25, -35, 50, -74, 120, -248, 16376, 256, -122, 75, -51, 36, -25, 18, -12, 8, -5, 3, -2, 1, 0, 0, 0},
+	{0, 1, -2, 4, -6, 10, -16, 24, -34, 49, -70, 100, -148, 237, -488, 16357, 521, -245, 151, -102, 71, -50, 35, -24, 16, -10, 6, -4, 2, -1, 0, 0},
+	{0, 1, -3, 5, -9, 15, -23, 35, -51, 73, -104, 149, -219, 352, -719, 16323, 792, -371, 228, -154, 108, -76, 53, -36, 24, -16, 10, -6, 3, -1, 1, 0},
+	{-1, 2, -4, 7, -12, 20, -31, 46, -68, 97, -138, 197, -290, 464, -942, 16277, 1072, -497, 306, -206, 144, -101, 71, -49, 33, -21, 13, -8, 4, -2, 1, 0},
+	{-1, 2, -5, 9, -15, 25, -38, 57, -84, 120, -170, 244, -359, 573, -1156, 16217, 1358, -625, 383, -258, 180, -127, 89, -61, 41, -26, 16, -9, 5, -2, 1, 0},
+	{-1, 2, -5, 10, -18, 29, -45, 68, -100, 143, -203, 289, -426, 679, -1360, 16146, 1651, -754, 461, -310, 216, -152, 107, -73, 49, -32, 20, -11, 6, -3, 1, 0},
+	{-1, 3, -6, 12, -21, 34, -52, 79, -115, 165, -234, 334, -491, 781, -1556, 16060, 1950, -882, 538, -362, 252, -178, 125, -86, 57, -37, 23, -13, 7, -3, 1, 0},
+	{-1, 3, -7, 13, -23, 38, -59, 89, -130, 186, -264, 377, -554, 880, -1742, 15963, 2256, -1012, 616, -414, 288, -203, 142, -98, 66, -43, 26, -15, 8, -4, 2, 0},
+	{-1, 4, -8, 15, -26, 42, -66, 99, -144, 207, -294, 419, -615, 975, -1919, 15850, 2567, -1141, 693, -465, 324, -228, 160, -110, 74, -48, 30, -17, 9, -4, 2, 0},
+	{-1, 4, -8, 16, -28, 46, -72, 108, -158, 227, -322, 459, -674, 1066, -2086, 15728, 2884, -1269, 769, -515, 359, -253, 177, -122, 82, -53, 33, -19, 10, -5, 2, -1},
+	{-2, 4, -9, 17, -30, 50, -78, 117, -171, 246, -349, 498, -730, 1153, -2243, 15593, 3206, -1397, 844, -565, 394, -277, 194, -134, 90, -58, 36, -21, 11, -6, 2, -1},
+	{-2, 4, -10, 18, -32, 53, -84, 126, -184, 264, -375, 535, -784, 1236, -2391, 15449, 3532, -1524, 918, -615, 428, -301, 211, -146, 98, -63, 39, -23, 12, -6, 2, -1},
+	{-2, 5, -10, 20, -35, 57, -89, 134, -196, 282, -400, 571, -835, 1314, -2529, 15285, 3863, -1650, 992, -663, 461, -325, 228, -157, 106, -69, 43, -25, 13, -7, 3, -1},
+	{-2, 5, -11, 21, -36, 60, -94, 142, -208, 298, -424, 604, -884, 1389, -2657, 15114, 4198, -1774, 1063, -710, 494, -348, 244, -168, 113, -74, 46, -27, 15, -7, 3, -1},
+	{-2, 5, -11, 22, -38, 63, -99, 149, -219, 314, -446, 636, -930, 1458, -2776, 14931, 4536, -1896, 1133, -756, 526, -370, 260, -179, 121, -78, 49, -29, 16, -8, 3, -1},
+	{-2, 5, -12, 23, -40, 66, -104, 156, -229, 329, -467, 666, -973, 1523, -2884, 14737, 4877, -2016, 1202, -801, 557, -392, 275, -190, 128, -83, 52, -30, 17, -8, 3, -1},
+	{-2, 5, -12, 24, -42, 69, -108, 163, -239, 343, -487, 694, -1013, 1583, -2983, 14532, 5221, -2133, 1268, -844, 587, -413, 290, -200, 135, -88, 55, -32, 17, -9, 4, -1},
+	{-2, 6, -13, 24, -43, 71, -112, 169, -248, 356, -505, 720, -1050, 1639, -3073, 14319, 5567, -2248, 1332, -886, 616, -433, 304, -210, 141, -92, 57, -34, 18, -9, 4, -1},
+	{-2, 6, -13, 25, -44, 73, -115, 174, -256, 367, -522, 744, -1085, 1690, -3153, 14092, 5915, -2359, 1394, -926, 643, -453, 318, -219, 148, -96, 60, -35, 19, -9, 4, -1},
+	{-2, 6, -13, 26, -45, 75, -119, 179, -263, 378, -537, 765, -1116, 1735, -3223, 13857, 6265, -2466, 1453, -964, 670, -471, 331, -229, 154, -101, 63, -37, 20, -10, 4, -1},
+	{-2, 6, -13, 26, -47, 77, -121, 184, -270, 388, -551, 785, -1144, 1776, -3283, 13613, 6615, -2570, 1509, -1001, 694, -489, 343, -237, 160, -104, 65, -39, 21, -10, 4, -1},
+	{-2, 6, -14, 27, -47, 79, -124, 188, -276, 397, -564, 803, -1169, 1812, -3335, 13355, 6965, -2669, 1563, -1035, 718, -505, 355, -245, 166, -108, 68, -40, 22, -11, 5, -1},
+	{-2, 6, -14, 27, -48, 80, -126, 191, -281, 404, -575, 818, -1191, 1843, -3377, 13094, 7316, -2764, 1614, -1067, 740, -521, 366, -253, 171, -112, 70, -41, 23, -11, 5, -1},
+	{-2, 6, -14, 27, -49, 81, -128, 194, -286, 411, -584, 832, -1209, 1870, -3410, 12822, 7666, -2854, 1661, -1097, 761, -535, 376, -260, 176, -115, 72, -43, 23, -12, 5, -1},
+	{-2, 6, -14, 28, -49, 82, -130, 197, -289, 417, -592, 843, -1225, 1891, -3434, 12544, 8015, -2939, 1705, -1125, 779, -549, 385, -267, 180, -118, 74, -44, 24, -12, 5, -2},
+	{-2, 6, -14, 28, -50, 83, -131, 199, -292, 421, -599, 852, -1237, 1907, -3449, 12256, 8363, -3019, 1745, -1150, 797, -561, 394, -273, 184, -121, 76, -45, 25, -12, 5, -2},
+	{-2, 6, -14, 28, -50, 83, -132, 200, -295, 424, -604, 859, -1247, 1919, -3456, 11964, 8709, -3092, 1782, -1173, 812, -571, 401, -278, 188, -123, 77, -46, 25, -13, 5, -2},
+	{-2, 6, -14, 28, -50, 84, -132, 201, -296, 427, -607, 863, -1253, 1925, -3454, 11659, 9052, -3160, 1815, -1193, 826, -581, 408, -283, 191, -125, 79, -47, 26, -13, 6, -2},
+	{-2, 6, -14, 28, -50, 84, -133, 202, -297, 428, -609, 866, -1256, 1927, -3444, 11353, 9393, -3222, 1844, -1211, 837, -589, 414, -287, 194, -127, 80, -48, 26, -13, 6, -2},
+	{-2, 6, -14, 28, -50, 84, -133, 202, -297, 428, -609, 866, -1256, 1925, -3425, 11035, 9730, -3277, 1869, -1225, 847, -596, 419, -290, 197, -129, 81, -48, 27, -13, 6, -2},
+	{-2, 6, -14, 28, -50, 83, -132, 201, -296, 427, -608, 865, -1252, 1917, -3399, 10716, 10064, -3325, 1889, -1237, 855, -601, 423, -293, 199, -130, 82, -49, 27, -14, 6, -2},
+	{-2, 6, -14, 27, -49, 83, -131, 200, -295, 425, -605, 861, -1246, 1905, -3366, 10393, 10393, -3366, 1905, -1246, 861, -605, 425, -295, 200, -131, 83, -49, 27, -14, 6, -2},
+	{-2, 6, -14, 27, -49, 82, -130, 199, -293, 423, -601, 855, -1237, 1889, -3325, 10064, 10716, -3399, 1917, -1252, 865, -608, 427, -296, 201, -132, 83, -50, 28, -14, 6, -2},
+	{-2, 6, -13, 27, -48, 81, -129, 197, -290, 419, -596, 847, -1225, 1869, -3277, 9730, 11035, -3425, 1925, -1256, 866, -609, 428, -297, 202, -133, 84, -50, 28, -14, 6, -2},
+	{-2, 6, -13, 26, -48, 80, -127, 194, -287, 414, -589, 837, -1211, 1844, -3222, 9393, 11353, -3444, 1927, -1256, 866, -609, 428, -297, 202, -133, 84, -50, 28, -14, 6, -2},
+	{-2, 6, -13, 26, -47, 79, -125, 191, -283, 408, -581, 826, -1193, 1815, -3160, 9052, 11659, -3454, 1925, -1253, 863, -607, 427, -296, 201, -132, 84, -50, 28, -14, 6, -2},
+	{-2, 5, -13, 25, -46, 77, -123, 188, -278, 401, -571, 812, -1173, 1782, -3092, 8709, 11964, -3456, 1919, -1247, 859, -604, 424, -295, 200, -132, 83, -50, 28, -14, 6, -2},
+	{-2, 5, -12, 25, -45, 76, -121, 184, -273, 394, -561, 797, -1150, 1745, -3019, 8363, 12256, -3449, 1907, -1237, 852, -599, 421, -292, 199, -131, 83, -50, 28, -14, 6, -2},
+	{-2, 5, -12, 24, -44, 74, -118, 180, -267, 385, -549, 779, -1125, 1705, -2939, 8015, 12544, -3434, 1891, -1225, 843, -592, 417, -289, 197, -130, 82, -49, 28, -14, 6, -2},
+	{-1, 5, -12, 23, -43, 72, -115, 176, -260, 376, -535, 761, -1097, 1661, -2854, 7666, 12822, -3410, 1870, -1209, 832, -584, 411, -286, 194, -128, 81, -49, 27, -14, 6, -2},
+	{-1, 5, -11, 23, -41, 70, -112, 171, -253, 366, -521, 740, -1067, 1614, -2764, 7316, 13094, -3377, 1843, -1191, 818, -575, 404, -281, 191, -126, 80, -48, 27, -14, 6, -2},
+	{-1, 5, -11, 22, -40, 68, -108, 166, -245, 355, -505, 718, -1035, 1563, -2669, 6965, 13355, -3335, 1812, -1169, 803, -564, 397, -276, 188, -124, 79, -47, 27, -14, 6, -2},
+	{-1, 4, -10, 21, -39, 65, -104, 160, -237, 343, -489, 694, -1001, 1509, -2570, 6615, 13613, -3283, 1776, -1144, 785, -551, 388, -270, 184, -121, 77, -47, 26, -13, 6, -2},
+	{-1, 4, -10, 20, -37, 63, -101, 154, -229, 331, -471, 670, -964, 1453, -2466, 6265, 13857, -3223, 1735, -1116, 765, -537, 378, -263, 179, -119, 75, -45, 26, -13, 6, -2},
+	{-1, 4, -9, 19, -35, 60, -96, 148, -219, 318, -453, 643, -926, 1394, -2359, 5915, 14092, -3153, 1690, -1085, 744, -522, 367, -256, 174, -115, 73, -44, 25, -13, 6, -2},
+	{-1, 4, -9, 18, -34, 57, -92, 141, -210, 304, -433, 616, -886, 1332, -2248, 5567, 14319, -3073, 1639, -1050, 720, -505, 356, -248, 169, -112, 71, -43, 24, -13, 6, -2},
+	{-1, 4, -9, 17, -32, 55, -88, 135, -200, 290, -413, 587, -844, 1268, -2133, 5221, 14532, -2983, 1583, -1013, 694, -487, 343, -239, 163, -108, 69, -42, 24, -12, 5, -2},
+	{-1, 3, -8, 17, -30, 52, -83, 128, -190, 275, -392, 557, -801, 1202, -2016, 4877, 14737, -2884, 1523, -973, 666, -467, 329, -229, 156, -104, 66, -40, 23, -12, 5, -2},
+	{-1, 3, -8, 16, -29, 49, -78, 121, -179, 260, -370, 526, -756, 1133, -1896, 4536, 14931, -2776, 1458, -930, 636, -446, 314, -219, 149, -99, 63, -38, 22, -11, 5, -2},
+	{-1, 3, -7, 15, -27, 46, -74, 113, -168, 244, -348, 494, -710, 1063, -1774, 4198, 15114, -2657, 1389, -884, 604, -424, 298, -208, 142, -94, 60, -36, 21, -11, 5, -2},
+	{-1, 3, -7, 13, -25, 43, -69, 106, -157, 228, -325, 461, -663, 992, -1650, 3863, 15285, -2529, 1314, -835, 571, -400, 282, -196, 134, -89, 57, -35, 20, -10, 5, -2},
+	{-1, 2, -6, 12, -23, 39, -63, 98, -146, 211, -301, 428, -615, 918, -1524, 3532, 15449, -2391, 1236, -784, 535, -375, 264, -184, 126, -84, 53, -32, 18, -10, 4, -2},
+	{-1, 2, -6, 11, -21, 36, -58, 90, -134, 194, -277, 394, -565, 844, -1397, 3206, 15593, -2243, 1153, -730, 498, -349, 246, -171, 117, -78, 50, -30, 17, -9, 4, -2},
+	{-1, 2, -5, 10, -19, 33, -53, 82, -122, 177, -253, 359, -515, 769, -1269, 2884, 15728, -2086, 1066, -674, 459, -322, 227, -158, 108, -72, 46, -28, 16, -8, 4, -1},
+	{0, 2, -4, 9, -17, 30, -48, 74, -110, 160, -228, 324, -465, 693, -1141, 2567, 15850, -1919, 975, -615, 419, -294, 207, -144, 99, -66, 42, -26, 15, -8, 4, -1},
+	{0, 2, -4, 8, -15, 26, -43, 66, -98, 142, -203, 288, -414, 616, -1012, 2256, 15963, -1742, 880, -554, 377, -264, 186, -130, 89, -59, 38, -23, 13, -7, 3, -1},
+	{0, 1, -3, 7, -13, 23, -37, 57, -86, 125, -178, 252, -362, 538, -882, 1950, 16060, -1556, 781, -491, 334, -234, 165, -115, 79, -52, 34, -21, 12, -6, 3, -1},
+	{0, 1, -3, 6, -11, 20, -32, 49, -73, 107, -152, 216, -310, 461, -754, 1651, 16146, -1360, 679, -426, 289, -203, 143, -100, 68, -45, 29, -18, 10, -5, 2, -1},
+	{0, 1, -2, 5, -9, 16, -26, 41, -61, 89, -127, 180, -258, 383, -625, 1358, 16217, -1156, 573, -359, 244, -170, 120, -84, 57, -38, 25, -15, 9, -5, 2, -1},
+	{0, 1, -2, 4, -8, 13, -21, 33, -49, 71, -101, 144, -206, 306, -497, 1072, 16277, -942, 464, -290, 197, -138, 97, -68, 46, -31, 20, -12, 7, -4, 2, -1},
+	{0, 1, -1, 3, -6, 10, -16, 24, -36, 53, -76, 108, -154, 228, -371, 792, 16323, -719, 352, -219, 149, -104, 73, -51, 35, -23, 15, -9, 5, -3, 1, 0},
+	{0, 0, -1, 2, -4, 6, -10, 16, -24, 35, -50, 71, -102, 151, -245, 521, 16357, -488, 237, -148, 100, -70, 49, -34, 24, -16, 10, -6, 4, -2, 1, 0},
+	{0, 0, 0, 1, -2, 3, -5, 8, -12, 18, -25, 36, -51, 75, -122, 256, 16376, -248, 120, -74, 50, -35, 25, -17, 12, -8, 5, -3, 2, -1, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16384, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+};
+
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES FOR PRIVATE FUNCTIONS WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief Resampler_Process above the output rate, with the filter stretched.
+ */
+static uint32_t decimate(resampler_t * resampler, const q31_t * block, uint32_t length,
+						 q31_t * output, uint32_t outputLength);
+
+/**
+ * @brief Coefficient of the filter for an input sample m/PHASES samples after the output, Q14.
+ * @param m between -TABLE_EDGE and TABLE_EDGE
+ */
+static inline int32_t coefficientAt(int32_t m);
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+void Resampler_Init(resampler_t * resampler, q31_t * block, uint32_t outRate)
+{
+	memset(block - RESAMPLER_HISTORY, 0, RESAMPLER_HISTORY * sizeof(q31_t));
+
+	resampler->inRate = outRate;
+	resampler->outRate = outRate;
+	resampler->reciprocal = UINT32_MAX / outRate;
+	resampler->position = 0;
+	resampler->index = 0;
+	resampler->step = 1 << TABLE_STEP_BITS;
+	resampler->gain = 1 << 15;
+}
+
+
+void Resampler_SetInputRate(resampler_t * resampler, uint32_t inRate)
+{
+	// The position is in units of the output rate, it stays valid
+	resampler->inRate = inRate;
+
+	if (inRate > resampler->outRate)
+	{
+		// The sinc stretched by inRate/outRate, as far as the history reaches
+		uint32_t step = (uint32_t)(((uint64_t)resampler->outRate << TABLE_STEP_BITS) / inRate);
+		if (step < (1U << TABLE_STEP_BITS) / RESAMPLER_MAX_DECIMATION)
+		{
+			step = (1U << TABLE_STEP_BITS) / RESAMPLER_MAX_DECIMATION;
+		}
+
+		resampler->step = (int32_t)step;
+		resampler->gain = (int32_t)(step >> (TABLE_STEP_BITS - 15));
+	}
+}
+
+
+uint32_t Resampler_Process(resampler_t * resampler, const q31_t * block, uint32_t length,
+						   q31_t * output, uint32_t outputLength)
+{
+	if (resampler->inRate > resampler->outRate)
+	{
+		return decimate(resampler, block, length, output, outputLength);
+	}
+
+	uint32_t written = 0;
+	int32_t index = resampler->index;
+	uint32_t position = resampler->position;
+
+	// The filter reaches RESAMPLER_TAPS/2 samples past the index
+	while ((written < outputLength) && (index + RESAMPLER_TAPS/2 < (int32_t)length))
+	{
+		if (position == 0)
+		{
+			// Right on an input sample, phase 0 is a delta
+			output[written] = block[index];
+		}
+		else
+		{
+			uint32_t fraction = position * resampler->reciprocal;
+			uint32_t phase = fraction >> (32 - PHASE_BITS);
+			int32_t blend = (fraction >> (32 - PHASE_BITS - 15)) & 0x7FFF;
+
+			const q31_t * x = &block[index - (RESAMPLER_TAPS/2 - 1)];
+			const int16_t * h0 = coefficients[phase];
+			const int16_t * h1 = coefficients[phase + 1];
+			q63_t acc0 = 0;
+			q63_t acc1 = 0;
+
+			for (uint32_t k = 0; k < RESAMPLER_TAPS; k++)
+			{
+				acc0 += (q63_t)x[k] * h0[k];
+				acc1 += (q63_t)x[k] * h1[k];
+			}
+
+			// Linear between the two phases, blend in Q15
+			acc0 += ((acc1 - acc0) * blend) >> 15;
+
+			output[written] = clip_q63_to_q31(acc0 >> COEFFICIENT_BITS);
+		}
+
+		written++;
+
+		// Next output, inRate/outRate of an input sample later
+		position += resampler->inRate;
+		while (position >= resampler->outRate)
+		{
+			position -= resampler->outRate;
+			index++;
+		}
+	}
+
+	resampler->index = index;
+	resampler->position = position;
+
+	return written;
+}
+
+
+void Resampler_NextBlock(resampler_t * resampler, q31_t * block, uint32_t length)
+{
+	// The filter still needs the last samples of this block
+	if (length >= RESAMPLER_HISTORY)
+	{
+		memcpy(block - RESAMPLER_HISTORY, block + length - RESAMPLER_HISTORY, RESAMPLER_HISTORY * sizeof(q31_t));
+	}
+	else
+	{
+		memmove(block - RESAMPLER_HISTORY, block - RESAMPLER_HISTORY + length, (RESAMPLER_HISTORY - length) * sizeof(q31_t));
+		memmove(block - length, block, length * sizeof(q31_t));
+	}
+
+	resampler->index -= length;
+}
+
+
+uint32_t Resampler_Flush(q31_t * block)
+{
+	memset(block, 0, RESAMPLER_REACH * sizeof(q31_t));
+
+	return RESAMPLER_REACH;
+}
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+static uint32_t decimate(resampler_t * resampler, const q31_t * block, uint32_t length,
+						 q31_t * output, uint32_t outputLength)
+{
+	uint32_t written = 0;
+	int32_t index = resampler->index;
+	uint32_t position = resampler->position;
+	int32_t step = resampler->step;
+
+	// Stretched, the filter reaches up to RESAMPLER_REACH samples past the index
+	while ((written < outputLength) && (index + RESAMPLER_REACH < (int32_t)length))
+	{
+		// Where the output falls in the table, from the input sample at the index
+		uint32_t fraction = position * resampler->reciprocal;
+		int32_t offset = (int32_t)(((uint64_t)fraction * (uint32_t)step) >> 32);
+
+		const q31_t * x = &block[index];
+		q63_t acc = 0;
+
+		for (int32_t k = 1 - RESAMPLER_REACH; k <= RESAMPLER_REACH; k++)
+		{
+			int32_t place = k * step - offset;
+			int32_t m = place >> 16;
+
+			if ((m > -TABLE_EDGE) && (m < TABLE_EDGE))
+			{
+				// Linear between two neighbouring phases, kept BLEND_BITS below Q14 so it is not rounded on every tap
+				int32_t h0 = coefficientAt(m);
+				int32_t h1 = coefficientAt(m + 1);
+				int32_t blend = (place & 0xFFFF) >> (16 - BLEND_BITS);
+
+				acc += (q63_t)x[k] * ((h0 << BLEND_BITS) + (h1 - h0) * blend);
+			}
+		}
+
+		// The stretched filter adds up to inRate/outRate
+		output[written] = clip_q63_to_q31(((acc >> (COEFFICIENT_BITS + BLEND_BITS)) * resampler->gain) >> 15);
+		written++;
+
+		// Next output, more than an input sample later
+		position += resampler->inRate;
+		while (position >= resampler->outRate)
+		{
+			position -= resampler->outRate;
+			index++;
+		}
+	}
+
+	resampler->index = index;
+	resampler->position = position;
+
+	return written;
+}
+
+
+static inline int32_t coefficientAt(int32_t m)
+{
+	// Row p, column k of the table is the input sample k - (RESAMPLER_TAPS/2 - 1) - p/PHASES from the output
+	int32_t p = (-m) & (PHASES - 1);
+	int32_t k = (RESAMPLER_TAPS/2 - 1) + ((m + p) >> PHASE_BITS);
+
+	return coefficients[p][k];
+}
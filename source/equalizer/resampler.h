@@ -0,0 +1,93 @@
+/*******************************************************************************
+  @file     resampler.h
+  @brief    Polyphase resampler, Q31 mono, to a fixed output rate
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+#include <stdint.h>
+#include "arm_math.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* Input samples under the filter, for each output sample */
+#define RESAMPLER_TAPS (32)
+
+/* Inputs up to this many times the output rate are band-limited to it, faster ones only to this fraction of theirs */
+#define RESAMPLER_MAX_DECIMATION (2)
+
+/* Input samples the filter reads past an output, at most. Also the silence Resampler_Flush puts after a song */
+#define RESAMPLER_REACH (RESAMPLER_TAPS/2 * RESAMPLER_MAX_DECIMATION)
+
+/* Samples of the previous block kept right before the current one, the block must have room for them */
+#define RESAMPLER_HISTORY (2 * RESAMPLER_REACH)
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	uint32_t inRate;
+	uint32_t outRate;
+	uint32_t reciprocal;	// 2^32 / outRate, turns the position between two samples into a fraction
+	uint32_t position;		// Between input samples index and index + 1, in 1/outRate of a sample
+	int32_t index;			// Input sample of the next output, in the current block (negative: in the history)
+	int32_t step;			// Above the output rate: filter phases per input sample, Q16 of 1/64 of a sample
+	int32_t gain;			// Above the output rate: the filter is that much wider, Q15
+} resampler_t;
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief Starts a stream, from silence.
+ * @param resampler state of the stream
+ * @param block where the blocks of the stream go, its history is cleared
+ * @param outRate output sample rate
+ */
+void Resampler_Init(resampler_t * resampler, q31_t * block, uint32_t outRate);
+
+/**
+ * @brief Changes the input rate, the position is kept. Above the output rate the filter is widened to cut at
+ * half the output rate (aliases ~78 dB down on the host test, up to RESAMPLER_MAX_DECIMATION times it).
+ * @param resampler state of the stream
+ * @param inRate input sample rate
+ */
+void Resampler_SetInputRate(resampler_t * resampler, uint32_t inRate);
+
+/**
+ * @brief Interpolates output samples until the output is full or the block can't give another one.
+ * @param resampler state of the stream
+ * @param block input, RESAMPLER_HISTORY samples before it hold the end of the previous block
+ * @param length samples in the block
+ * @param output here we store the samples
+ * @param outputLength room in the output
+ * @return samples written, fewer than outputLength if the block ran out (Resampler_NextBlock)
+ */
+uint32_t Resampler_Process(resampler_t * resampler, const q31_t * block, uint32_t length,
+						   q31_t * output, uint32_t outputLength);
+
+/**
+ * @brief Moves the end of the block to its history, before the next block is written in its place.
+ * @param resampler state of the stream
+ * @param block the same block Resampler_Process ran out of
+ * @param length samples in the block
+ */
+void Resampler_NextBlock(resampler_t * resampler, q31_t * block, uint32_t length);
+
+/**
+ * @brief Ends a stream: silence after its last block, so the filter gives out the samples it still holds.
+ * @param block the block, after Resampler_NextBlock, with room for RESAMPLER_REACH samples
+ * @return samples written in the block, to be processed like a decoded one
+ */
+uint32_t Resampler_Flush(q31_t * block);
+
+#endif
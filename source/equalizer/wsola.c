@@ -0,0 +1,260 @@
+/*******************************************************************************
+  @file     wsola.c
+  @brief    Tempo change without a pitch change (WSOLA), Q31 mono
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * The output is made of segments of two hops of the input, each one overlapped with the last by a hop under
+ * a Hann window (the two halves add up to 1). The tempo sets where the next segment should start in the
+ * input, tempo / 100 hops after the last one. Instead of taking it from exactly there, the start within
+ * +-WSOLA_SEEK that looks most like what followed the last segment is used, so the overlap adds two waves in
+ * phase and the pitch stays the same.
+ *
+ * The search is a normalized cross-correlation: first on a signal decimated by 4 (sums of 4 samples in Q15,
+ * two products per SMLALD), then at the full rate around the best lag of the first one.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "wsola.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define WINDOW (2 * WSOLA_HOP)
+
+/* The search region and window of the next segment, and room for a chunk more */
+#define INPUT_SIZE (2 * WSOLA_SEEK + WINDOW + WSOLA_INPUT_CHUNK)
+
+/* Decimated: what followed the last segment, where the next one may start, the lags between them */
+#define DECIMATION_BITS (2)
+#define TEMPLATE_LENGTH (WSOLA_HOP / WSOLA_DECIMATION)
+#define REGION_LENGTH ((2 * WSOLA_SEEK + WSOLA_HOP) / WSOLA_DECIMATION)
+#define LAGS (REGION_LENGTH - TEMPLATE_LENGTH + 1)
+
+/* Samples >> 4 at the full rate, 576 products of 2^24 * 2^24 fit in 64 bits */
+#define REFINE_SHIFT (4)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static q31_t input[INPUT_SIZE];
+static uint32_t inputLength = 0;
+static uint32_t givenLength = 0;			// Up to the silence added after the end of the input
+static uint32_t nominal = 0;				// Q16, where the tempo puts the next segment, in input
+static uint32_t step = 0;					// Q16, input of a hop
+
+static q31_t tail[WSOLA_HOP];				// Second half of the last segment, as it was in the input
+static q31_t fade[WSOLA_HOP];				// Rising half of the window, Q31
+static bool fadeReady = false;
+
+static q15_t templateDecimated[TEMPLATE_LENGTH];
+static q15_t regionDecimated[REGION_LENGTH];
+
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static uint32_t findSegment(uint32_t start);
+static void decimate(const q31_t * samples, q15_t * decimated, uint32_t length);
+static q63_t correlate(q15_t * a, q15_t * b, uint32_t length);
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        GLOBAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+void Wsola_Start(uint8_t tempo)
+{
+	if (!fadeReady)
+	{
+		// sin^2, the falling half is 1 minus it
+		for (uint32_t index = 0; index < WSOLA_HOP; index++)
+		{
+			float s = sinf(PI * (index + 0.5f) / WINDOW);
+			fade[index] = (q31_t)fminf(s * s * 2147483648.0f, 2147483647.0f);
+		}
+		fadeReady = true;
+	}
+
+	Wsola_SetTempo(tempo);
+
+	// Silence before the first segment, for the search
+	memset(input, 0, WSOLA_SEEK * sizeof(q31_t));
+	inputLength = WSOLA_SEEK;
+	givenLength = WSOLA_SEEK;
+	nominal = WSOLA_SEEK << 16;
+
+	memset(tail, 0, sizeof(tail));
+}
+
+
+void Wsola_SetTempo(uint8_t tempo)
+{
+	tempo = (tempo < WSOLA_MIN_TEMPO) ? WSOLA_MIN_TEMPO : tempo;
+	tempo = (tempo > WSOLA_MAX_TEMPO) ? WSOLA_MAX_TEMPO : tempo;
+	step = (uint32_t)((((uint64_t)WSOLA_HOP * tempo) << 16) / 100U);
+}
+
+
+uint32_t Wsola_Needed(void)
+{
+	uint32_t required = (nominal >> 16) + WSOLA_SEEK + WINDOW;
+
+	return (required > inputLength) ? (required - inputLength) : 0;
+}
+
+
+q31_t * Wsola_AcquireInput(void)
+{
+	return &input[inputLength];
+}
+
+
+void Wsola_CommitInput(uint32_t length)
+{
+	inputLength += (length > INPUT_SIZE - inputLength) ? (INPUT_SIZE - inputLength) : length;
+	givenLength = inputLength;
+}
+
+
+uint32_t Wsola_Hop(q31_t * output)
+{
+	uint32_t start = nominal >> 16;
+	uint32_t required = start + WSOLA_SEEK + WINDOW;
+	bool given = (start < givenLength);
+
+	if (inputLength < required)
+	{
+		// End of the song, or a broken frame
+		memset(&input[inputLength], 0, (required - inputLength) * sizeof(q31_t));
+		inputLength = required;
+	}
+
+	q31_t * segment = &input[findSegment(start)];
+
+	// The first half over the end of the last segment, tail + (segment - tail) * fade
+	for (uint32_t index = 0; index < WSOLA_HOP; index++)
+	{
+		output[index] = tail[index] + (q31_t)(((q63_t)(segment[index] - tail[index]) * fade[index]) >> 31);
+	}
+
+	memcpy(tail, &segment[WSOLA_HOP], sizeof(tail));
+
+	// Only the search region of the next segment is kept
+	nominal += step;
+	uint32_t discard = (nominal >> 16) - WSOLA_SEEK;
+
+	memmove(input, &input[discard], (inputLength - discard) * sizeof(q31_t));
+	inputLength -= discard;
+	givenLength = (givenLength > discard) ? (givenLength - discard) : 0;
+	nominal -= discard << 16;
+
+	return given ? WSOLA_HOP : 0;
+}
+
+
+/*******************************************************************************
+ *******************************************************************************
+                        LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+static uint32_t findSegment(uint32_t start)
+{
+	uint32_t first = start - WSOLA_SEEK;
+
+	// 1 - Every lag of the decimated signals, scaled by the energy under the template so loud parts don't win
+	decimate(tail, templateDecimated, TEMPLATE_LENGTH);
+	decimate(&input[first], regionDecimated, REGION_LENGTH);
+
+	q63_t energy = correlate(regionDecimated, regionDecimated, TEMPLATE_LENGTH);
+	uint32_t best = LAGS / 2;
+	float bestScore = 0;
+
+	for (uint32_t lag = 0; lag < LAGS; lag++)
+	{
+		q63_t product = correlate(templateDecimated, &regionDecimated[lag], TEMPLATE_LENGTH);
+		float score = product / sqrtf((float)energy + 1.0f);
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = lag;
+		}
+
+		if (lag + 1 < LAGS)
+		{
+			// The window slides by one
+			q31_t out = regionDecimated[lag];
+			q31_t in = regionDecimated[lag + TEMPLATE_LENGTH];
+			energy += in * in - out * out;
+		}
+	}
+
+	// 2 - At the full rate, between the decimated lags next to the best one
+	int32_t coarse = (int32_t)(first + best * WSOLA_DECIMATION);
+	int32_t low = coarse - (WSOLA_DECIMATION - 1);
+	int32_t high = coarse + (WSOLA_DECIMATION - 1);
+	low = (low < (int32_t)first) ? (int32_t)first : low;
+	high = (high > (int32_t)(start + WSOLA_SEEK)) ? (int32_t)(start + WSOLA_SEEK) : high;
+
+	int32_t position = coarse;
+	q63_t bestProduct = INT64_MIN;
+
+	for (int32_t candidate = low; candidate <= high; candidate++)
+	{
+		q63_t product = 0;
+		const q31_t * samples = &input[candidate];
+
+		for (uint32_t index = 0; index < WSOLA_HOP; index++)
+		{
+			product += (q63_t)(tail[index] >> REFINE_SHIFT) * (samples[index] >> REFINE_SHIFT);
+		}
+
+		if (product > bestProduct)
+		{
+			bestProduct = product;
+			position = candidate;
+		}
+	}
+
+	return (uint32_t)position;
+}
+
+
+static void decimate(const q31_t * samples, q15_t * decimated, uint32_t length)
+{
+	for (uint32_t index = 0; index < length; index++)
+	{
+		// A boxcar is enough of a low-pass to compare waves. 2^29 at most, like the mono sum of the handler
+		q31_t sum = 0;
+		for (uint32_t i = 0; i < WSOLA_DECIMATION; i++)
+		{
+			sum += *samples++ >> DECIMATION_BITS;
+		}
+
+		decimated[index] = (q15_t)(sum >> 15);
+	}
+}
+
+
+static q63_t correlate(q15_t * a, q15_t * b, uint32_t length)
+{
+	q63_t sum = 0;
+
+	// Two products per instruction, the lags of b are not word aligned and don't need to be
+	for (uint32_t pairs = length / 2; pairs > 0; pairs--)
+	{
+		sum = __SMLALD(read_q15x2_ia(&a), read_q15x2_ia(&b), sum);
+	}
+
+	return sum;
+}
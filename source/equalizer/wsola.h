@@ -0,0 +1,76 @@
+/*******************************************************************************
+  @file     wsola.h
+  @brief    Tempo change without a pitch change (WSOLA), Q31 mono
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+#ifndef WSOLA_H
+#define WSOLA_H
+
+/*******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+#include <stdint.h>
+#include "arm_math.h"
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+/* Samples out of each step, half of the window. 12 ms at 48 kHz */
+#define WSOLA_HOP (576)
+
+/* Segments are looked for this far around where the tempo puts them, covers a pitch period down to ~95 Hz */
+#define WSOLA_SEEK (256)
+
+/* The search runs on one sample of each 4, then around the best one at the full rate */
+#define WSOLA_DECIMATION (4)
+
+/* Most samples written at a time after Wsola_AcquireInput, a whole buffer of the handler */
+#define WSOLA_INPUT_CHUNK (1152)
+
+#define WSOLA_MIN_TEMPO (50)
+#define WSOLA_MAX_TEMPO (200)
+
+/*******************************************************************************
+ * FUNCTION PROTOTYPES WITH GLOBAL SCOPE
+ ******************************************************************************/
+
+/**
+ * @brief Starts a stream from silence, its input is cleared.
+ * @param tempo percent of the normal speed, WSOLA_MIN_TEMPO to WSOLA_MAX_TEMPO
+ */
+void Wsola_Start(uint8_t tempo);
+
+/**
+ * @brief Changes the tempo from the next segment on, the input is kept.
+ * @param tempo percent of the normal speed, WSOLA_MIN_TEMPO to WSOLA_MAX_TEMPO
+ */
+void Wsola_SetTempo(uint8_t tempo);
+
+/**
+ * @brief Samples that have to be added before the next Wsola_Hop.
+ * @return 0 if it can run
+ */
+uint32_t Wsola_Needed(void);
+
+/**
+ * @brief Where the next input samples go.
+ * @return room for WSOLA_INPUT_CHUNK samples
+ */
+q31_t * Wsola_AcquireInput(void);
+
+/**
+ * @brief Adds the samples written after Wsola_AcquireInput.
+ * @param length samples, up to WSOLA_INPUT_CHUNK
+ */
+void Wsola_CommitInput(uint32_t length);
+
+/**
+ * @brief Picks the segment that best continues the last one and overlaps them. Missing input is taken as silence.
+ * Checked on the PC only (tests/host/wsola_test.c), its cycles on the board come from mp3Handler_getStretchCycles.
+ * @param output here we store WSOLA_HOP samples
+ * @return WSOLA_HOP if the segment started in the input given, 0 if it was all silence
+ */
+uint32_t Wsola_Hop(q31_t * output);
+
+#endif
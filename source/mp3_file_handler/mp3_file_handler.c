@@ -11,6 +11,7 @@
 #include <stdlib.h>
 
 #include "ff.h"
+#include "audio_decoder.h"
 
 #define DIRECTORY_ARRAY_SIZE 	20
 #define FILE_ARRAY_SIZE 		50
@@ -63,15 +64,8 @@ void mp3Files_Init(void)
 
 bool mp3Files_isMp3File(char *path)
 {
-	char *extension;
-	if ((extension = strrchr(path, '.')) != NULL)
-	{
-		if (strcmp(extension, ".mp3") == 0)
-		{
-			return true;
-		}
-	}
-	return false;
+	// Any format a codec plays, the decoder tells them apart by their first bytes
+	return AudioDecoder_IsSupportedFile(path);
 }
 
 
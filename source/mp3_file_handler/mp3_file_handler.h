@@ -40,9 +40,9 @@ void mp3Files_Init(void);
 
 
 /*
- * @brief Detects if a file's path corresponds to a .mp3 file.
+ * @brief Detects if a file can be played (.mp3 or the extension of any other codec).
  * @param path: complete file's path.
- * @return Flag that is true if the file extension is MP3
+ * @return Flag that is true if some codec plays the file
  * */
 bool mp3Files_isMp3File(char *path);
 
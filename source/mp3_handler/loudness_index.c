@@ -0,0 +1,154 @@
+/***************************************************************************/ /**
+  @file     loudness_index.c
+  @brief    Loudness of the songs already measured, kept in a file on the SD card
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+/******************************************************************************
+ * INCLUDE HEADER FILES
+ ******************************************************************************/
+#include <math.h>
+#include "loudness_index.h"
+#include "ff.h"
+
+
+/******************************************************************************
+ * TYPEDEFS
+ ******************************************************************************/
+
+// One entry of the file, in the byte order of the K64
+typedef struct
+{
+	uint32_t key;
+	int16_t lufs;				// 0.01 LU
+	uint16_t peak;				// Q12, up to the headroom of the EQ
+} index_entry_t;
+
+
+/******************************************************************************
+ * DEFINES
+ ******************************************************************************/
+
+#define ENTRIES_PER_READ	(64U)		// One sector
+#define LUFS_SCALE			(100.0f)
+#define PEAK_SCALE			(4096.0f)
+
+#define FNV_OFFSET			(2166136261U)
+#define FNV_PRIME			(16777619U)
+
+
+/*******************************************************************************
+ * LOCAL VARIABLES
+ ******************************************************************************/
+
+static FIL indexFile;
+static index_entry_t entries[ENTRIES_PER_READ];
+
+
+static int32_t findEntry(uint32_t key, index_entry_t * found, uint32_t * count);
+
+
+/******************************************************************************
+
+ ******************************************************************************/
+uint32_t LoudnessIndex_Key(const char * path)
+{
+	uint32_t hash = FNV_OFFSET;
+
+	while (*path)
+	{
+		hash = (hash ^ (uint8_t)*path++) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+
+bool LoudnessIndex_Find(uint32_t key, float * lufs, float * peak)
+{
+	index_entry_t entry;
+	uint32_t count;
+
+	if (f_open(&indexFile, LOUDNESS_INDEX_PATH, FA_READ) != FR_OK)
+	{
+		return false;
+	}
+
+	int32_t position = findEntry(key, &entry, &count);
+	f_close(&indexFile);
+
+	if (position < 0)
+	{
+		return false;
+	}
+
+	*lufs = entry.lufs / LUFS_SCALE;
+	*peak = entry.peak / PEAK_SCALE;
+	return true;
+}
+
+
+bool LoudnessIndex_Store(uint32_t key, float lufs, float peak)
+{
+	index_entry_t entry;
+	uint32_t count;
+	UINT bytesWritten = 0;
+
+	if (f_open(&indexFile, LOUDNESS_INDEX_PATH, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK)
+	{
+		return false;
+	}
+
+	// Measured again, in the same place. If not, at the end
+	int32_t position = findEntry(key, &entry, &count);
+
+	if ((position < 0) && (count >= LOUDNESS_INDEX_MAX_SONGS))
+	{
+		f_close(&indexFile);
+		return false;
+	}
+
+	entry.key = key;
+	entry.lufs = (int16_t)lroundf(lufs * LUFS_SCALE);
+	entry.peak = (peak * PEAK_SCALE < UINT16_MAX) ? (uint16_t)lroundf(peak * PEAK_SCALE) : UINT16_MAX;
+
+	bool ok = (f_lseek(&indexFile, ((position < 0) ? count : (uint32_t)position) * sizeof(index_entry_t)) == FR_OK) &&
+			  (f_write(&indexFile, &entry, sizeof(entry), &bytesWritten) == FR_OK) && (bytesWritten == sizeof(entry));
+
+	// The directory entry is only written by the close
+	return (f_close(&indexFile) == FR_OK) && ok;
+}
+
+
+/*******************************************************************************
+ *******************************************************************************
+						LOCAL FUNCTION DEFINITIONS
+ *******************************************************************************
+ ******************************************************************************/
+
+static int32_t findEntry(uint32_t key, index_entry_t * found, uint32_t * count)
+{
+	UINT bytesRead = 0;
+	uint32_t index = 0;
+
+	// A sector at a time, from the start
+	while ((f_read(&indexFile, entries, sizeof(entries), &bytesRead) == FR_OK) && (bytesRead >= sizeof(index_entry_t)))
+	{
+		uint32_t read = bytesRead / sizeof(index_entry_t);
+
+		for (uint32_t i = 0; i < read; i++)
+		{
+			if (entries[i].key == key)
+			{
+				*found = entries[i];
+				*count = index + i;
+				return (int32_t)(index + i);
+			}
+		}
+
+		index += read;
+	}
+
+	*count = index;
+	return -1;
+}
@@ -0,0 +1,45 @@
+/***************************************************************************/ /**
+  @file     loudness_index.h
+  @brief	Loudness of the songs already measured, kept in a file on the SD card
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+#ifndef _LOUDNESS_INDEX_H_
+#define _LOUDNESS_INDEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// In the root of the card, 8 bytes per song
+#define LOUDNESS_INDEX_PATH			"/loudness.idx"
+
+#ifndef LOUDNESS_INDEX_MAX_SONGS
+#define LOUDNESS_INDEX_MAX_SONGS	4096
+#endif
+
+/**
+ * @brief Key of a song in the index.
+ * @param path: file's path.
+ * @return hash of the path (FNV-1a).
+ */
+uint32_t LoudnessIndex_Key(const char * path);
+
+/**
+ * @brief Looks for a song in the index.
+ * @param key: LoudnessIndex_Key of its path.
+ * @param lufs: here we store its integrated loudness.
+ * @param peak: here we store its highest sample, 1.0 is full scale.
+ * @return false if the song was never measured (or there is no index).
+ */
+bool LoudnessIndex_Find(uint32_t key, float * lufs, float * peak);
+
+/**
+ * @brief Adds a song to the index, or replaces its entry. Writes the card, call it when there is spare time.
+ * @param key: LoudnessIndex_Key of its path.
+ * @param lufs: integrated loudness.
+ * @param peak: highest sample.
+ * @return false if the card could not be written or the index is full.
+ */
+bool LoudnessIndex_Store(uint32_t key, float lufs, float peak);
+
+#endif /* _LOUDNESS_INDEX_H_ */
@@ -9,19 +9,135 @@
  ******************************************************************************/
 #include <stdint.h>
 #include <stdlib.h>
+#include <math.h>
 #include <vumeter/vumeter.h>
 #include "mp3_handler.h"
 #include "../mp3_file_handler/mp3_file_handler.h"
 #include "memory_handler.h"
 #include "AudioPlayer.h"
 #include "equalizer.h"
-#include "../drivers/HAL/mp3_decoder.h"
+#include "resampler.h"
+#include "loudness.h"
+#include "limiter.h"
+#include "wsola.h"
+#include "loudness_index.h"
+#include "../drivers/HAL/audio_decoder.h"
 #include "fsl_common.h"
 #include "EventQueue/queue.h"
 #include "board.h"
+#include "arm_math.h"
+
+
+/******************************************************************************
+ * TYPEDEFS
+ ******************************************************************************/
+
+// Mono samples of the DSP chain. Q31 with the headroom of the EQ, then floats for the vumeter in the same place
+typedef union
+{
+	q31_t q31[AUDIO_PLAYER_BUFF_SIZE];
+	float32_t f32[AUDIO_PLAYER_BUFF_SIZE];
+} dsp_frame_t;
+
+#if AUDIO_PLAYER_FIXED_RATE
+// Input of the resampler of a song: the end of the previous frame, then the decoder output turned mono in place
+typedef union
+{
+	q31_t samples[RESAMPLER_HISTORY + AUDIO_PLAYER_BUFF_SIZE];
+
+	struct
+	{
+		q31_t history[RESAMPLER_HISTORY];
+		short pcm[2*AUDIO_PLAYER_BUFF_SIZE];
+	} decoded;
+
+	float32_t scratch[AUDIO_PLAYER_BUFF_SIZE];			// EQ_CompareChains, only of the stream that is not fading in
+} stream_buffer_t;
+
+// A song on its way to the DAC rate
+typedef struct
+{
+	resampler_t resampler;
+	stream_buffer_t * buffer;
+	uint32_t length;				// Samples of the last frame, after the history
+	bool ended;						// The decoder reached the end of the file
+	bool flushed;					// And the resampler gave out the end of it, nothing more comes
+	decoder_stream_t stream;
+} resampled_stream_t;
+#endif
+
+// Scratch memory of a refill, static instead of on the stack. The members of each union are never live at the same time
+typedef struct
+{
+#if AUDIO_PLAYER_FIXED_RATE
+	stream_buffer_t streams[2];							// Kept between refills, the frames outlast a buffer
+
+	union
+	{
+		q31_t q31[AUDIO_PLAYER_BUFF_SIZE];				// Song fading in at the DAC rate, until the mix is in frame
+		float32_t reference[AUDIO_PLAYER_BUFF_SIZE];	// EQ_CompareChains: the float chain
+	} mix;
+#else
+	union
+	{
+		short pcm[2*AUDIO_PLAYER_BUFF_SIZE];			// Decoder output, until the mono sum is in frame
+		float32_t reference[AUDIO_PLAYER_BUFF_SIZE];	// EQ_CompareChains: the float chain
+	} decoded;
+
+	union
+	{
+		short pcm[2*AUDIO_PLAYER_BUFF_SIZE];			// Song fading in, until the mix is in frame
+		float32_t test[AUDIO_PLAYER_BUFF_SIZE];			// EQ_CompareChains: the Q31 chain, as floats
+	} incoming;
+#endif
+
+	dsp_frame_t frame;									// The mono chain, then the vumeter until VU_FFT
+} dsp_arena_t;
+
+// Song whose loudness is being measured
+typedef enum
+{
+	MEASURE_NONE,
+	MEASURE_PLAYING,
+	MEASURE_INCOMING		// During the fade, it is the playing one after it
+} measure_t;
+
+// A loudness to be written to the index
+typedef struct
+{
+	uint32_t key;
+	float lufs;
+	float peak;
+} loudness_store_t;
 
 
 static void loadPlayingSong(void);
+static void preOpenNeighbours(void);
+static void startCrossfade(void);
+static void fadeGains(uint32_t samples, q31_t * gainOut, q31_t * gainIn, q31_t * stepOut, q31_t * stepIn);
+static void finishCrossfade(void);
+static void cancelCrossfade(void);
+static int32_t gainFromLoudness(float lufs, float peak);
+static int32_t mixRatio(void);
+static void finishMeasure(void);
+static void queueStore(uint32_t key, float lufs, float peak);
+static int32_t outputGain(void);
+static void limit(q31_t * data, uint32_t length);
+static void outputQ31(dsp_frame_t * frame, uint16_t * dacBuffer);
+static inline int32_t quantize(q31_t sample, int32_t gain, uint32_t * seed, int32_t * error, uint32_t ditherWeights, int32_t shapingMask);
+#if AUDIO_PLAYER_FIXED_RATE
+static void refillResampled(uint16_t * dacBuffer);
+static uint32_t resampleStream(resampled_stream_t * stream, q31_t * output);
+static uint32_t stretchStream(resampled_stream_t * stream, q31_t * output);
+static decoder_result_t decodeBlock(resampled_stream_t * stream);
+static void resetStream(resampled_stream_t * stream);
+static void mixResampled(void);
+#else
+static void refillFrame(uint16_t * dacBuffer);
+static uint32_t mixCrossfade(uint8_t outChannels, q31_t * mix, uint32_t samples);
+static void outputDirect(uint8_t numOfChannels, uint16_t * dacBuffer, float * vuBuffer);
+#endif
+static void paintStack(void);
 
 
 /******************************************************************************
@@ -33,9 +149,41 @@ static void loadPlayingSong(void);
 
 #define EPSILON 	1.19e-07
 
+#define SCRUB_MIN_SPEED		(4U)
+#define SCRUB_MAX_SPEED		(16U)
+#define SCRUB_SNIPPETS_PER_SEC	(10U)		// 100 ms of audio from each position
+
+#define CROSSFADE_MAX_SECONDS	(10U)
+#define QUARTER_TURN_Q31		(0x20000000)	// pi/2 for arm_sin_q31/arm_cos_q31 (2^31 is a full turn)
+#define STACK_PAINT				(0xC5C5C5C5U)		// Words of the stack never written keep it
+
+#define DSP_ARENA_ALIGN			(32U)				// Cache line
+#define DAC_ZERO_X2				((DAC_ZERO_VOLT_VALUE << 16) | DAC_ZERO_VOLT_VALUE)	// Both halves of a packed pair
+#define MONO_TO_DSP_SHIFT		(16 - EQ_HEADROOM_BITS)	// L+R (or mono) << 13, 1.0 of the float path is 2^28
+
+#define TRACK_GAIN_UNITY		(16384)				// Q14, 0 dB of the loudness normalization
+#define TRACK_GAIN_MAX_DB		(6.0f)				// Quiet songs, Q14 stays below 2.0
+#define TRACK_GAIN_MIN_DB		(-24.0f)
+#define STORE_QUEUE_SIZE		(4U)				// Loudness records waiting for the SD, one per song ended or tagged
+#define STORE_MIN_FILL			(AUDIO_PLAYER_LOW_WATERMARK + 1)	// Slots queued to write one, a slow write can use up one
+
+#define DAC_CEILING_STEPS		(2044)				// Limiter threshold, the dither and its shaping add up to 3 steps to 2047
+
+#if AUDIO_PLAYER_FIXED_RATE
+#define MIX_RATE				(AUDIO_PLAYER_FIXED_RATE)	// The fade is counted in samples of the DAC
+#else
+#define MIX_RATE				(sampleRate)
+#endif
+
 /*******************************************************************************
  * LOCAL VARIABLES
  ******************************************************************************/
+
+// Linker script: the stack starts at the top of SRAM_UPPER and can grow down to the end of the heap
+extern uint32_t _pvHeapLimit;
+extern uint32_t _vStackTop;
+
+static bool stackPainted = false;
 static bool playing = false;
 static bool init = false;
 static uint32_t sampleRate = 44100;
@@ -44,13 +192,84 @@ static MP3Object_t currObject;
 
 static MP3Object_t playingSongFile;
 
-SDK_ALIGN(static uint16_t processedAudioBuffer[BUFFER_SIZE] , SD_BUFFER_ALIGN_SIZE);
-SDK_ALIGN(static short decoder_buffer[2*BUFFER_SIZE], SD_BUFFER_ALIGN_SIZE);
+// The K64 does not cache the SRAM, the alignment holds for parts that do
+SDK_ALIGN(static dsp_arena_t arena, DSP_ARENA_ALIGN);
 
-static uint8_t vol = 15;
-static char vol2send = 15 + 40;
+static uint8_t vol = 30;					// -10 dB
+static char vol2send = 30 + 40;
 
-static uint32_t nextBufferSize = BUFFER_SIZE;
+// 1 dB per step, MAX_VOLUME is 0 dB and 0 is mute. Q15 of the DAC_ZERO_VOLT_VALUE swing, << EQ_HEADROOM_BITS + 1
+static const int32_t volumeGain[MAX_VOLUME + 1] =
+{
+	    0,   368,   413,   463,   519,   583,   654,   734,
+	  823,   924,  1036,  1163,  1305,  1464,  1642,  1843,
+	 2068,  2320,  2603,  2920,  3277,  3677,  4125,  4629,
+	 5193,  5827,  6538,  7336,  8231,  9235, 10362, 11627,
+	13045, 14637, 16423, 18427, 20675, 23198, 26029, 29205,
+	32768,
+};
+
+static mp3Dither_t dither = MP3_DITHER_SHAPED;
+static uint32_t ditherSeed = 0x2545F491;	// xorshift32, never 0
+static int32_t shapingError = 0;			// Quantization error of the last sample, Q16 of a DAC step
+static uint32_t maxOutputCycles = 0;
+
+static uint32_t limiterAttackUs = LIMITER_DEFAULT_ATTACK_US;
+static uint32_t limiterReleaseMs = LIMITER_DEFAULT_RELEASE_MS;
+static uint32_t limiterRate = 0;			// Rate Limiter_Init was given, 0 to set it again
+static uint32_t maxLimiterCycles = 0;
+
+static uint8_t tempo = MP3_TEMPO_NORMAL;	// Percent, the playing song goes through WSOLA when it is not normal
+static uint32_t maxStretchCycles = 0;
+
+static int32_t trackGain = TRACK_GAIN_UNITY;		// Loudness of the playing song to the target, Q14
+static int32_t incomingGain = TRACK_GAIN_UNITY;		// Of the song fading in
+static measure_t measuring = MEASURE_NONE;			// Song going through Loudness_Process, never both
+static uint32_t measureKey = 0;
+
+static loudness_store_t storeQueue[STORE_QUEUE_SIZE];	// Written by mp3Handler_readAhead, not in a refill
+static uint8_t storeFirst = 0;
+static uint8_t storeCount = 0;
+
+static bool lookupPending = false;					// The next song in the index, also by mp3Handler_readAhead
+static uint32_t nextKey = 0;
+static int32_t nextGain = TRACK_GAIN_UNITY;
+static bool nextKnown = false;
+
+static bool songEnded = false;			// NEXT_SONG_EV was pushed for the playing song, only once per song
+
+static uint8_t scrubSpeed = 0;			// 0 when not scrubbing
+static uint32_t scrubSamples = 0;		// Samples played from the current snippet
+
+static uint8_t crossfadeSeconds = 0;	// 0 when crossfading is off
+static bool crossfading = false;		// true while the next song is fading in
+static bool fadeStarted = false;		// true once this song tried to fade out, only once per song
+static uint32_t fadeSamples = 0;		// Samples mixed since the fade started
+static uint32_t fadeLength = 0;			// Samples the fade lasts
+static MP3Object_t incomingSongFile;	// Song fading in
+
+static uint32_t maxBufferCycles = 0;	// Worst buffer without crossfade (DWT cycles)
+static uint32_t maxCrossfadeCycles = 0;	// Worst buffer while crossfading, two decodes and the mix
+
+static bool compareRequested = false;	// The next buffer through the EQ runs the float chain too
+static bool compared = false;
+static float chainSnr = 0;				// Q31 chain against the float one, dB
+static uint32_t floatChainCycles = 0;
+static uint32_t fixedChainCycles = 0;
+
+#if AUDIO_PLAYER_FIXED_RATE
+static resampled_stream_t playingStream = {
+	.resampler = {AUDIO_PLAYER_FIXED_RATE, AUDIO_PLAYER_FIXED_RATE, UINT32_MAX / AUDIO_PLAYER_FIXED_RATE, 0, 0},
+	.buffer = &arena.streams[0],
+	.stream = DECODER_PLAYING_STREAM
+};
+
+static resampled_stream_t incomingStream = {
+	.resampler = {AUDIO_PLAYER_FIXED_RATE, AUDIO_PLAYER_FIXED_RATE, UINT32_MAX / AUDIO_PLAYER_FIXED_RATE, 0, 0},
+	.buffer = &arena.streams[1],
+	.stream = DECODER_INCOMING_STREAM
+};
+#endif
 /******************************************************************************
 
  ******************************************************************************/
@@ -67,6 +286,17 @@ void mp3Handler_init(void)
 		// Search for the first object
 		currObject = mp3Files_GetFirstObject();
 
+		// Cycle counter, measures the time spent on each buffer. Only enabled, never reset:
+		// the measurements going on keep their time base
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+		// Once, mp3Handler_getStackHighWater measures from here
+		if (!stackPainted)
+		{
+			paintStack();
+			stackPainted = true;
+		}
 	}
 }
 
@@ -131,78 +361,33 @@ void mp3Handler_updateAudioPlayerBackBuffer(void)
 
 	//gpioWrite(TP, true);
 
-	uint32_t numOfSamples = 0;
-	uint8_t numOfChannels = 1;
-	float effects_in[BUFFER_SIZE];
-	float effects_out[BUFFER_SIZE];
-
-	// Update with the previous processed audio
-	AudioPlayer_UpdateBackBuffer(processedAudioBuffer, sampleRate, nextBufferSize);
-
-	// Clean buffers to rewrite
-	memset(processedAudioBuffer, 0, sizeof(processedAudioBuffer));
-	memset(decoder_buffer, 0, sizeof(decoder_buffer));
+	// A free slot of the DAC queue, the samples are written straight into it
+	uint16_t * dacBuffer = AudioPlayer_AcquireBuffer();
 
-	// Fetch the new frame
-	decoder_result_t res = MP3Decoder_DecodeFrame(decoder_buffer, 2*BUFFER_SIZE, &numOfSamples, &sampleRate);
-
-	// Get the number of channels in the frame
-	MP3Decoder_GetLastFrameNumOfChannels(&numOfChannels);
-
-	// 1 - Scale from int16 to float[-1;1]
-	float coef = 1.0/32768.0;
-	uint32_t index;
-
-	if(numOfChannels == 1)
-	{
-		for (index = 0; index < BUFFER_SIZE; index++)
-		{
-			effects_in[index] = decoder_buffer[index] * coef;
-		}
-	}
-	else
+	if (dacBuffer == NULL)
 	{
-		// If stereo, sum L + R
-		for (index = 0; index < BUFFER_SIZE; index++)
-		{
-			effects_in[index] = (decoder_buffer[index * 2] + decoder_buffer[index * 2 + 1]) * coef;
-		}
+		return;
 	}
 
-	// 2 - Apply audio effects
-	EQ_Apply(effects_in, effects_out);
-
-
-	// 3 - apply volume and
-	// 4 - Scale to 12 bits, to fit in the DAC
-	coef = (vol * 1.0) / MAX_VOLUME;
+	uint32_t startCycles = DWT->CYCCNT;
+	bool mixed = crossfading;
 
-	for (index = 0; index < BUFFER_SIZE; index++)
-	{
-		processedAudioBuffer[index] = (effects_out[index] * coef + 1) * DAC_ZERO_VOLT_VALUE;
-	}
+#if AUDIO_PLAYER_FIXED_RATE
+	refillResampled(dacBuffer);
+#else
+	refillFrame(dacBuffer);
+#endif
 
-	if (res == DECODER_END_OF_FILE)
+	uint32_t cycles = DWT->CYCCNT - startCycles;
+	if (mixed && (cycles > maxCrossfadeCycles))
 	{
-		// Complete the rest of the buffer with 0V
-
-		for (uint32_t index = (numOfSamples / numOfChannels); index < BUFFER_SIZE ; index++)
-		{
-			processedAudioBuffer[index] = DAC_ZERO_VOLT_VALUE;
-		}
-
-		nextBufferSize = BUFFER_SIZE;
-		push_Queue_Element(NEXT_SONG_EV);
-
+		maxCrossfadeCycles = cycles;
 	}
-	else
+	else if (!mixed && (cycles > maxBufferCycles))
 	{
-		nextBufferSize = (numOfSamples / numOfChannels);
+		maxBufferCycles = cycles;
 	}
 
-	// Compute FFT and set the vumeter
-	VU_FFT(effects_out, sampleRate, 80, 10000);
-
 	//gpioWrite(TP, false);
 }
 
@@ -219,7 +404,7 @@ void mp3Handler_deinit(void)
 {
 	mp3Handler_stop();
 
-	MP3Decoder_shutDown();
+	AudioDecoder_ShutDown();
 
 	mh_SD_disconnect();
 
@@ -245,6 +430,42 @@ void mp3Handler_updateAll(void)
 }
 
 
+void mp3Handler_readAhead(void)
+{
+	// The loudness index goes through the SD too, only when the DAC queue has room to wait for it (or plays the
+	// silence after the song). A write can take a whole slot, it also waits for one over the low watermark
+	bool queueIdle = songEnded || !AudioPlayer_NeedsRefill();
+	bool storeReady = storeCount && (songEnded || (AudioPlayer_GetFill() >= STORE_MIN_FILL));
+
+	if ((storeReady || lookupPending) && queueIdle)
+	{
+		if (storeReady)
+		{
+			// One record per call, oldest first
+			loudness_store_t * record = &storeQueue[storeFirst];
+			LoudnessIndex_Store(record->key, record->lufs, record->peak);
+			storeFirst = (storeFirst + 1) % STORE_QUEUE_SIZE;
+			storeCount--;
+		}
+		else
+		{
+			float lufs, peak;
+			lookupPending = false;
+			nextKnown = LoudnessIndex_Find(nextKey, &lufs, &peak);
+			nextGain = nextKnown ? gainFromLoudness(lufs, peak) : TRACK_GAIN_UNITY;
+		}
+		return;
+	}
+
+	// Only worth it while the decoder is consuming the file
+	if (playing)
+	{
+		// The playing song first, the next and previous ones only when its FIFO is full
+		AudioDecoder_Background();
+	}
+}
+
+
 void mp3Handler_playNextSong(void)
 {
 	mp3Handler_nextMP3File();
@@ -291,7 +512,19 @@ void mp3Handler_toggle(void)
 
 void mp3Handler_stop(void)
 {
-	MP3Decoder_LoadFile(currObject.path);
+	cancelCrossfade();
+	measuring = MEASURE_NONE;
+	songEnded = false;
+	AudioDecoder_LoadFile(currObject.path);
+#if AUDIO_PLAYER_FIXED_RATE
+	resetStream(&playingStream);
+
+	if (tempo != MP3_TEMPO_NORMAL)
+	{
+		Wsola_Start(tempo);
+	}
+#endif
+	Limiter_Clear();
 	AudioPlayer_Play();
 	AudioPlayer_Stop();
 	playing = false;
@@ -301,7 +534,7 @@ void mp3Handler_stop(void)
 char * mp3Handler_getTitle(void)
 {
 	char * ret;
-	if(!MP3Decoder_getFileTitle(&ret))
+	if(!AudioDecoder_GetTag(AUDIO_TAG_TITLE, &ret))
 	{
 		ret = mp3Files_GetObjectName(playingSongFile);
 	}
@@ -312,7 +545,7 @@ char * mp3Handler_getTitle(void)
 char * mp3Handler_getArtist(void)
 {
 	char * ret;
-	if(!MP3Decoder_getFileArtist(&ret))
+	if(!AudioDecoder_GetTag(AUDIO_TAG_ARTIST, &ret))
 	{
 		ret = "-";
 	}
@@ -323,7 +556,7 @@ char * mp3Handler_getArtist(void)
 char * mp3Handler_getAlbum(void)
 {
 	char * ret;
-	if(!MP3Decoder_getFileAlbum(&ret))
+	if(!AudioDecoder_GetTag(AUDIO_TAG_ALBUM, &ret))
 	{
 		ret = "-";
 	}
@@ -334,7 +567,7 @@ char * mp3Handler_getAlbum(void)
 char* mp3Handler_getYear(void)
 {
 	char * ret;
-	if(!MP3Decoder_getFileYear(&ret))
+	if(!AudioDecoder_GetTag(AUDIO_TAG_YEAR, &ret))
 	{
 		ret = "-";
 	}
@@ -370,23 +603,1107 @@ void mp3Handler_setVolume(char value)
 	}
 }
 
+void mp3Handler_toggleKaraoke(void)
+{
+	// Helix does the removal before the IMDCT, frames come out as mono
+	AudioDecoder_SetCenterCancel(!AudioDecoder_GetCenterCancel());
+}
+
+
+bool mp3Handler_getKaraoke(void)
+{
+	return AudioDecoder_GetCenterCancel();
+}
+
+void mp3Handler_startScrub(void)
+{
+	// The skips would move the outgoing song only, play it alone
+	cancelCrossfade();
+
+	scrubSpeed = SCRUB_MIN_SPEED;
+	scrubSamples = 0;
+
+	// The skipped parts would be missing from the measurement
+	measuring = MEASURE_NONE;
+
+	// Scrubbing is heard, resume if paused
+	if (!playing)
+	{
+		mp3Handler_play();
+	}
+}
+
+
+void mp3Handler_stopScrub(void)
+{
+	scrubSpeed = 0;
+
+	// The scrub may have reached the end of the song, it can still fade out
+	fadeStarted = false;
+}
+
+
+void mp3Handler_scrubFaster(void)
+{
+	if (scrubSpeed && (scrubSpeed < SCRUB_MAX_SPEED))
+	{
+		scrubSpeed *= 2;
+	}
+}
+
+
+void mp3Handler_scrubSlower(void)
+{
+	if (scrubSpeed > SCRUB_MIN_SPEED)
+	{
+		scrubSpeed /= 2;
+	}
+}
+
+
+uint8_t mp3Handler_getScrubSpeed(void)
+{
+	return scrubSpeed;
+}
+
+
+void mp3Handler_setCrossfade(uint8_t seconds)
+{
+	crossfadeSeconds = (seconds > CROSSFADE_MAX_SECONDS) ? CROSSFADE_MAX_SECONDS : seconds;
+
+	if (!crossfadeSeconds)
+	{
+		cancelCrossfade();
+	}
+}
+
+
+uint8_t mp3Handler_getCrossfade(void)
+{
+	return crossfadeSeconds;
+}
+
+
+void mp3Handler_setTempo(uint8_t percent)
+{
+#if AUDIO_PLAYER_FIXED_RATE
+	percent = (percent < WSOLA_MIN_TEMPO) ? WSOLA_MIN_TEMPO : percent;
+	percent = (percent > WSOLA_MAX_TEMPO) ? WSOLA_MAX_TEMPO : percent;
+
+	if (percent != MP3_TEMPO_NORMAL)
+	{
+		// The incoming song would not be stretched, it plays after this one instead
+		cancelCrossfade();
+
+		if (tempo == MP3_TEMPO_NORMAL)
+		{
+			Wsola_Start(percent);
+		}
+		else
+		{
+			// Between two speeds the input already read is kept, no gap
+			Wsola_SetTempo(percent);
+		}
+	}
+
+	tempo = percent;
+#endif
+}
+
+
+uint8_t mp3Handler_getTempo(void)
+{
+	return tempo;
+}
+
+
+uint32_t mp3Handler_getStretchCycles(void)
+{
+	return maxStretchCycles;
+}
+
+
+uint32_t mp3Handler_getMaxBufferCycles(bool crossfade)
+{
+	return crossfade ? maxCrossfadeCycles : maxBufferCycles;
+}
+
+
+uint32_t mp3Handler_getStackHighWater(void)
+{
+	uint32_t * word = &_pvHeapLimit;
+
+	// The deepest word that is not paint any more
+	while ((word < &_vStackTop) && (*word == STACK_PAINT))
+	{
+		word++;
+	}
+
+	return (uint32_t)&_vStackTop - (uint32_t)word;
+}
+
+
+void mp3Handler_compareDspChains(void)
+{
+	compareRequested = true;
+}
+
+
+bool mp3Handler_getDspComparison(float * snr, uint32_t * floatCycles, uint32_t * fixedCycles)
+{
+	*snr = chainSnr;
+	*floatCycles = floatChainCycles;
+	*fixedCycles = fixedChainCycles;
+	return compared;
+}
+
+
+void mp3Handler_setDither(mp3Dither_t value)
+{
+	dither = value;
+	shapingError = 0;
+}
+
+
+mp3Dither_t mp3Handler_getDither(void)
+{
+	return dither;
+}
+
+
+uint32_t mp3Handler_getOutputCycles(void)
+{
+	return maxOutputCycles;
+}
+
+
+void mp3Handler_setLimiter(uint32_t attackUs, uint32_t releaseMs)
+{
+	limiterAttackUs = attackUs;
+	limiterReleaseMs = releaseMs;
+
+	// Set with the next buffer, the look-ahead is in samples of its rate
+	limiterRate = 0;
+}
+
+
+uint32_t mp3Handler_getLimiterCycles(void)
+{
+	return maxLimiterCycles;
+}
+
+
+bool mp3Handler_songEnded(void)
+{
+	return songEnded;
+}
+
+
 static void loadPlayingSong(void)
 {
-	MP3Decoder_LoadFile(playingSongFile.path);
+	// NEXT/PREV/select during a fade, the new song plays alone
+	cancelCrossfade();
+	fadeStarted = false;
+	songEnded = false;
+
+	AudioDecoder_LoadFile(playingSongFile.path);
+
+	// A new song always starts at normal speed
+	scrubSpeed = 0;
+
+	// Its gain from the tags, from the index if it has none, measured while it plays if it is in neither
+	char * tag;
+	char * end;
+	uint32_t key = LoudnessIndex_Key(playingSongFile.path);
+	float lufs = 0;
+	float peak = 0;
+	bool known = false;
+
+	measuring = MEASURE_NONE;
+
+	if (AudioDecoder_GetTag(AUDIO_TAG_REPLAYGAIN_GAIN, &tag))
+	{
+		// "-6.54 dB", the gain that takes the song to LOUDNESS_TARGET_LUFS
+		float gainDb = strtof(tag, &end);
+		known = (end != tag);
+		lufs = LOUDNESS_TARGET_LUFS - gainDb;
+
+		if (known && AudioDecoder_GetTag(AUDIO_TAG_REPLAYGAIN_PEAK, &tag))
+		{
+			peak = strtof(tag, &end);
+		}
 
-	// First two buffers in 0V, no sound
-	int i;
-	for(i = 0; i < BUFFER_SIZE; i++)
+		// So it is known when it fades in, the decoder has no tags of that song
+		float indexLufs, indexPeak;
+		if (known && !LoudnessIndex_Find(key, &indexLufs, &indexPeak))
+		{
+			queueStore(key, lufs, peak);
+		}
+	}
+
+	if (!known)
+	{
+		known = LoudnessIndex_Find(key, &lufs, &peak);
+	}
+
+	trackGain = known ? gainFromLoudness(lufs, peak) : TRACK_GAIN_UNITY;
+
+#if AUDIO_PLAYER_FIXED_RATE
+	if (!known)
 	{
-		processedAudioBuffer[i] = DAC_ZERO_VOLT_VALUE;
+		// Always at the DAC rate, whatever the song's is
+		Loudness_Start(AUDIO_PLAYER_FIXED_RATE);
+		measuring = MEASURE_PLAYING;
+		measureKey = key;
 	}
+#endif
 
 	sampleRate = 44100;
 
-	// Set a default sampleRate for first buffers
-	AudioPlayer_LoadSong(processedAudioBuffer, sampleRate, BUFFER_SIZE);
+#if AUDIO_PLAYER_FIXED_RATE
+	// From silence, nothing of the last song is left in the filter
+	resetStream(&playingStream);
+
+	if (tempo != MP3_TEMPO_NORMAL)
+	{
+		Wsola_Start(tempo);
+	}
+#endif
+	Limiter_Clear();
+
+	// First buffer in 0V, no sound, at a default sampleRate. The first frame is queued after it, the main loop refills the rest
+	AudioPlayer_LoadSong(sampleRate);
 
-	nextBufferSize = BUFFER_SIZE;
 	mp3Handler_updateAudioPlayerBackBuffer();
+
+	preOpenNeighbours();
+}
+
+
+static void preOpenNeighbours(void)
+{
+	// Get the neighbours ready, so NEXT/PREV don't wait for the SD
+	MP3Object_t neighbour = mp3Files_GetNextMP3File(playingSongFile);
+	if ((neighbour.object_type == MP3_FILE) && (neighbour.index != playingSongFile.index))
+	{
+		AudioDecoder_PreOpen(0, neighbour.path);
+	}
+
+	// Its gain is looked up ahead, the fade starts inside a refill
+	nextKey = LoudnessIndex_Key(neighbour.path);
+	nextKnown = false;
+	lookupPending = (neighbour.object_type == MP3_FILE);
+
+	MP3Object_t next = neighbour;
+	neighbour = mp3Files_GetPreviousMP3File(playingSongFile);
+	if ((neighbour.object_type == MP3_FILE) && (neighbour.index != playingSongFile.index) && (neighbour.index != next.index))
+	{
+		AudioDecoder_PreOpen(1, neighbour.path);
+	}
+}
+
+
+static void startCrossfade(void)
+{
+	// Whatever happens, one try per song. The end of the song is left out of its measurement
+	fadeStarted = true;
+	finishMeasure();
+
+	incomingSongFile = mp3Files_GetNextMP3File(playingSongFile);
+
+	if ((incomingSongFile.object_type != MP3_FILE) || (incomingSongFile.index == playingSongFile.index))
+	{
+		return;
+	}
+
+	// Usually pre-opened, the first frames are already in RAM
+	if (AudioDecoder_LoadIncomingFile(incomingSongFile.path))
+	{
+		// Ends with the outgoing song, shorter than asked for if the song is
+		fadeLength = AudioDecoder_GetRemainingMs() * MIX_RATE / 1000U;
+		fadeSamples = 0;
+		crossfading = (fadeLength != 0);
+
+		uint32_t key = LoudnessIndex_Key(incomingSongFile.path);
+		bool known = !lookupPending && nextKnown && (key == nextKey);
+		incomingGain = known ? nextGain : TRACK_GAIN_UNITY;
+
+#if AUDIO_PLAYER_FIXED_RATE
+		if (crossfading && !known)
+		{
+			// From its first sample, before the fade gain
+			Loudness_Start(AUDIO_PLAYER_FIXED_RATE);
+			measuring = MEASURE_INCOMING;
+			measureKey = key;
+		}
+#endif
+
+		if (!crossfading)
+		{
+			AudioDecoder_CloseIncoming();
+		}
+#if AUDIO_PLAYER_FIXED_RATE
+		else
+		{
+			resetStream(&incomingStream);
+		}
+#endif
+	}
 }
 
+
+#if !AUDIO_PLAYER_FIXED_RATE
+static uint32_t mixCrossfade(uint8_t outChannels, q31_t * mix, uint32_t samples)
+{
+	uint32_t numOfSamples = 0;
+	uint8_t inChannels = 1;
+	int inSampleRate = 0;
+
+	decoder_result_t res = AudioDecoder_DecodeIncomingFrame(arena.incoming.pcm, 2*BUFFER_SIZE, &numOfSamples, &inSampleRate);
+	AudioDecoder_GetIncomingChannels(&inChannels);
+
+	uint32_t inSamples = numOfSamples / inChannels;
+
+	if ((res != DECODER_WORKED) || (inSampleRate != sampleRate) || (samples && (inSamples != samples)))
+	{
+		// Can't mix them sample by sample (or the next song is broken), no fade this time
+		cancelCrossfade();
+
+		for (uint32_t index = 0; index < BUFFER_SIZE; index++)
+		{
+			mix[index] = ((outChannels == 1) ? arena.decoded.pcm[index] :
+						 (arena.decoded.pcm[index * 2] + arena.decoded.pcm[index * 2 + 1])) << MONO_TO_DSP_SHIFT;
+		}
+		return 0;
+	}
+
+	q31_t gainOut, gainIn, stepOut, stepIn;
+	fadeGains(inSamples, &gainOut, &gainIn, &stepOut, &stepIn);
+	int32_t ratio = mixRatio();
+
+	for (uint32_t index = 0; index < inSamples; index++)
+	{
+		// Both songs as mono Q31, (L+R) << 15 keeps the full 17 bits of the sum
+		q31_t a = (outChannels == 1) ? (arena.decoded.pcm[index] << 15) :
+				  ((arena.decoded.pcm[index * 2] + arena.decoded.pcm[index * 2 + 1]) << 15);
+		q31_t b = (inChannels == 1) ? (arena.incoming.pcm[index] << 15) :
+				  ((arena.incoming.pcm[index * 2] + arena.incoming.pcm[index * 2 + 1]) << 15);
+
+		// The output stage applies the gain of the outgoing song, the incoming one is set relative to it
+		b = clip_q63_to_q31(((q63_t)b * ratio) >> 14);
+
+		// Down to the headroom of the EQ
+		mix[index] = clip_q63_to_q31(((q63_t)a * gainOut + (q63_t)b * gainIn) >> 31) >> (15 - MONO_TO_DSP_SHIFT);
+
+		gainOut += stepOut;
+		gainIn += stepIn;
+	}
+
+	for (uint32_t index = inSamples; index < BUFFER_SIZE; index++)
+	{
+		mix[index] = 0;
+	}
+
+	return inSamples;
+}
+#endif
+
+
+static void fadeGains(uint32_t samples, q31_t * gainOut, q31_t * gainIn, q31_t * stepOut, q31_t * stepIn)
+{
+	// Equal power: cos/sin of a quarter turn, from the gains at both ends of this buffer
+	uint32_t fadeEnd = fadeSamples + samples;
+	if (fadeEnd > fadeLength)
+	{
+		fadeEnd = fadeLength;
+	}
+
+	q31_t phaseStart = (q31_t)(((uint64_t)fadeSamples * QUARTER_TURN_Q31) / fadeLength);
+	q31_t phaseEnd = (q31_t)(((uint64_t)fadeEnd * QUARTER_TURN_Q31) / fadeLength);
+
+	*gainOut = arm_cos_q31(phaseStart);
+	*gainIn = arm_sin_q31(phaseStart);
+
+	// The gains move less than 3% of the curve per buffer, linear steps in between are enough
+	*stepOut = (arm_cos_q31(phaseEnd) - *gainOut) / (int32_t)samples;
+	*stepIn = (arm_sin_q31(phaseEnd) - *gainIn) / (int32_t)samples;
+
+	fadeSamples = fadeEnd;
+}
+
+
+static void finishCrossfade(void)
+{
+	crossfading = false;
+	fadeStarted = false;
+	songEnded = false;
+
+	// The incoming song is the playing one from now on
+	AudioDecoder_PromoteIncoming();
+	playingSongFile = incomingSongFile;
+
+#if AUDIO_PLAYER_FIXED_RATE
+	// Its frames and resampler carry on, the decoder streams keep their roles
+	resampled_stream_t outgoing = playingStream;
+	playingStream = incomingStream;
+	playingStream.stream = DECODER_PLAYING_STREAM;
+	incomingStream = outgoing;
+	incomingStream.stream = DECODER_INCOMING_STREAM;
+	sampleRate = playingStream.resampler.inRate;
+#endif
+
+	// Its samples were already scaled to this in the mix, no jump at the switch
+	trackGain = incomingGain;
+	if (measuring == MEASURE_INCOMING)
+	{
+		measuring = MEASURE_PLAYING;
+	}
+
+	preOpenNeighbours();
+	push_Queue_Element(SONG_CHANGED_EV);
+}
+
+
+static void cancelCrossfade(void)
+{
+	if (crossfading)
+	{
+		crossfading = false;
+		AudioDecoder_CloseIncoming();
+
+		if (measuring == MEASURE_INCOMING)
+		{
+			measuring = MEASURE_NONE;
+		}
+	}
+}
+
+
+static int32_t gainFromLoudness(float lufs, float peak)
+{
+	float gainDb = LOUDNESS_TARGET_LUFS - lufs;
+
+	gainDb = (gainDb > TRACK_GAIN_MAX_DB) ? TRACK_GAIN_MAX_DB : gainDb;
+	gainDb = (gainDb < TRACK_GAIN_MIN_DB) ? TRACK_GAIN_MIN_DB : gainDb;
+
+	float gain = powf(10.0f, gainDb / 20.0f);
+
+	// A boost stops where the peak reaches full scale, a song that already does is left as it is
+	if ((gain > 1.0f) && (peak > 0) && (gain * peak > 1.0f))
+	{
+		gain = (peak < 1.0f) ? 1.0f / peak : 1.0f;
+	}
+
+	return (int32_t)(gain * TRACK_GAIN_UNITY + 0.5f);
+}
+
+
+static int32_t mixRatio(void)
+{
+	// Q14, at most 2.0 / 2^-4 so the product with a sample fits in 64 bits
+	return (int32_t)(((int64_t)incomingGain * TRACK_GAIN_UNITY) / trackGain);
+}
+
+
+static void finishMeasure(void)
+{
+	float lufs, peak;
+
+	// Stored once the refill is over, the SD could delay it
+	if ((measuring == MEASURE_PLAYING) && Loudness_GetResult(&lufs, &peak))
+	{
+		queueStore(measureKey, lufs, peak);
+	}
+
+	measuring = MEASURE_NONE;
+}
+
+
+static void queueStore(uint32_t key, float lufs, float peak)
+{
+	// Full only if the SD has been busy for several songs. The song is measured again the next time it plays
+	if (storeCount >= STORE_QUEUE_SIZE)
+	{
+		return;
+	}
+
+	loudness_store_t * record = &storeQueue[(storeFirst + storeCount) % STORE_QUEUE_SIZE];
+	record->key = key;
+	record->lufs = lufs;
+	record->peak = peak;
+	storeCount++;
+}
+
+
+#if !AUDIO_PLAYER_FIXED_RATE
+static void outputDirect(uint8_t numOfChannels, uint16_t * dacBuffer, float * vuBuffer)
+{
+	// Same scale as outputQ31, DAC_ZERO * (1 + (L+R)/32768 * volume), with the gain in Q16
+	int32_t gain = outputGain() >> EQ_HEADROOM_BITS;
+	float coef = 1.0/32768.0;
+	q15_t * pcm = arena.decoded.pcm;
+	int32_t sum;
+
+	for (uint32_t index = 0; index < BUFFER_SIZE; index++)
+	{
+		if (numOfChannels == 1)
+		{
+			sum = *pcm++;
+		}
+		else
+		{
+			// L + R of both 16 bit halves in one instruction
+			sum = __SMUAD(read_q15x2_ia(&pcm), 0x00010001);
+		}
+
+		// Saturated to the 12 bits of the DAC
+		dacBuffer[index] = __USAT(DAC_ZERO_VOLT_VALUE + ((sum * gain) >> 16), 12);
+
+		// The vumeter still needs the float samples
+		vuBuffer[index] = sum * coef;
+	}
+}
+#endif
+
+
+static void outputQ31(dsp_frame_t * frame, uint16_t * dacBuffer)
+{
+	uint32_t startCycles = DWT->CYCCNT;
+
+	// DAC_ZERO * (1 + x * volume) with x = 1.0 at 2^28: the product >> 32 is in DAC steps, >> 16 keeps 16 bits below them
+	int32_t gain = outputGain();
+	uint32_t ditherWeights = (dither != MP3_DITHER_OFF) ? 0x00010001 : 0;
+	int32_t shapingMask = (dither == MP3_DITHER_SHAPED) ? -1 : 0;
+	uint32_t seed = ditherSeed;
+	int32_t error = shapingError;
+	q15_t * dac = (q15_t *)dacBuffer;
+
+	for (uint32_t index = 0; index < BUFFER_SIZE; index += 2)
+	{
+		q31_t first = frame->q31[index];
+		q31_t second = frame->q31[index + 1];
+
+		int32_t low = quantize(first, gain, &seed, &error, ditherWeights, shapingMask);
+		int32_t high = quantize(second, gain, &seed, &error, ditherWeights, shapingMask);
+
+		// Both 12 bit samples in one word, the offset of the DAC added to the two halves at once
+		write_q15x2_ia(&dac, (q31_t)__QADD16(__PKHBT(low, high, 16), DAC_ZERO_X2));
+
+		// The vumeter still needs the float samples, they take the place of these
+		frame->f32[index] = first * EQ_Q31_TO_FLOAT;
+		frame->f32[index + 1] = second * EQ_Q31_TO_FLOAT;
+	}
+
+	ditherSeed = seed;
+	shapingError = error;
+
+	uint32_t cycles = DWT->CYCCNT - startCycles;
+	if (cycles > maxOutputCycles)
+	{
+		maxOutputCycles = cycles;
+	}
+}
+
+
+static int32_t outputGain(void)
+{
+	// The loudness of the song is one more gain on the same multiply, up to 2.0 of it
+	return (volumeGain[vol] * trackGain) >> 14;
+}
+
+
+static void limit(q31_t * data, uint32_t length)
+{
+	uint32_t startCycles = DWT->CYCCNT;
+
+	if (limiterRate != MIX_RATE)
+	{
+		limiterRate = MIX_RATE;
+		Limiter_Init(limiterRate, limiterAttackUs, limiterReleaseMs);
+	}
+
+	// The sample that reaches DAC_CEILING_STEPS at this volume. At low volumes nothing can, it is only delayed
+	int32_t gain = outputGain();
+	q63_t threshold = gain ? (((q63_t)DAC_CEILING_STEPS << 32) / gain) : INT32_MAX;
+
+	Limiter_Process(data, length, (threshold > INT32_MAX) ? INT32_MAX : (q31_t)threshold);
+
+	uint32_t cycles = DWT->CYCCNT - startCycles;
+	if (cycles > maxLimiterCycles)
+	{
+		maxLimiterCycles = cycles;
+	}
+}
+
+
+static inline int32_t quantize(q31_t sample, int32_t gain, uint32_t * seed, int32_t * error, uint32_t ditherWeights, int32_t shapingMask)
+{
+	// Volume, in DAC steps with 16 fractional bits. Saturated, a boosted song can go past them
+	int32_t value = clip_q63_to_q31(((q63_t)sample * gain) >> 16);
+
+	// Two uniform halves of one random word, added by SMUAD: triangular, +-1 step
+	uint32_t random = *seed;
+	random ^= random << 13;
+	random ^= random >> 17;
+	random ^= random << 5;
+	*seed = random;
+
+	int32_t target = value - (*error & shapingMask);
+	int32_t step = (target + (int32_t)__SMUAD(random, ditherWeights) + 0x8000) >> 16;
+
+	// Without the saturation, so it stays within two steps
+	*error = (step << 16) - target;
+
+	// Signed 12 bits, around DAC_ZERO_VOLT_VALUE
+	return __SSAT(step, 12);
+}
+
+
+static void paintStack(void)
+{
+	// Below the frames in use, interrupts off so none of them is painted over
+	uint32_t irq = DisableGlobalIRQ();
+	uint32_t * word = &_pvHeapLimit;
+	uint32_t * end = (uint32_t *)__get_MSP() - 64;
+
+	while (word < end)
+	{
+		*word++ = STACK_PAINT;
+	}
+
+	EnableGlobalIRQ(irq);
+}
+
+
+#if !AUDIO_PLAYER_FIXED_RATE
+static void refillFrame(uint16_t * dacBuffer)
+{
+	uint32_t numOfSamples = 0;
+	uint8_t numOfChannels = 1;
+	uint32_t bufferSize;
+	bool mixed = crossfading;
+	uint32_t mixedSamples = 0;
+
+	// Fetch the new frame
+	decoder_result_t res = AudioDecoder_DecodeFrame(arena.decoded.pcm, 2*BUFFER_SIZE, &numOfSamples, &sampleRate);
+
+	// Get the number of channels in the frame
+	AudioDecoder_GetChannels(&numOfChannels);
+
+	// The whole frame is read below, only the part the decoder did not write is cleared (short frames and errors)
+	uint32_t decodedSamples = ((res == DECODER_WORKED) || (res == DECODER_END_OF_FILE)) ? numOfSamples : 0;
+	uint32_t frameSamples = (numOfChannels == 1) ? BUFFER_SIZE : 2*BUFFER_SIZE;
+
+	if (decodedSamples < frameSamples)
+	{
+		memset(&arena.decoded.pcm[decodedSamples], 0, (frameSamples - decodedSamples) * sizeof(short));
+	}
+
+	if (crossfading)
+	{
+		if ((res != DECODER_WORKED) && (res != DECODER_END_OF_FILE))
+		{
+			numOfSamples = 0;
+		}
+
+		// The outgoing song may end a bit earlier than estimated, its samples are 0 from there
+		mixedSamples = mixCrossfade(numOfChannels, arena.frame.q31, numOfSamples / numOfChannels);
+	}
+
+	if (!mixed && EQ_IsFlat())
+	{
+		// The EQ would not change anything, straight from the decoder to the DAC. Its delay line would go stale
+		Limiter_Clear();
+		outputDirect(numOfChannels, dacBuffer, arena.frame.f32);
+	}
+	else
+	{
+		// 1 - Mono Q31 with the headroom of the EQ, no float on the way
+		uint32_t index;
+
+		if (mixed)
+		{
+			// Already in frame
+		}
+		else if(numOfChannels == 1)
+		{
+			for (index = 0; index < BUFFER_SIZE; index++)
+			{
+				arena.frame.q31[index] = arena.decoded.pcm[index] << MONO_TO_DSP_SHIFT;
+			}
+		}
+		else
+		{
+			// If stereo, sum L + R
+			for (index = 0; index < BUFFER_SIZE; index++)
+			{
+				arena.frame.q31[index] = (arena.decoded.pcm[index * 2] + arena.decoded.pcm[index * 2 + 1]) << MONO_TO_DSP_SHIFT;
+			}
+		}
+
+		// 2 - Apply audio effects, the biquads take the Q31 samples as they are. The bands follow the rate of the song
+		EQ_SetSampleRate(MIX_RATE);
+
+		if (compareRequested)
+		{
+			// Once, the float chain as a reference. The decoded and incoming PCM are not needed any more
+			chainSnr = EQ_CompareChains(arena.frame.q31, arena.decoded.reference, arena.incoming.test,
+										&floatChainCycles, &fixedChainCycles);
+			compareRequested = false;
+			compared = true;
+		}
+		else if (!EQ_IsFlat())
+		{
+			EQ_ApplyQ31(arena.frame.q31);
+		}
+
+		// 3 - The peaks the EQ and the volume would clip, only the samples that are played
+		limit(arena.frame.q31, crossfading ? mixedSamples : decodedSamples / numOfChannels);
+
+		// 4 - Volume and the DAC offset, in one saturating pass
+		outputQ31(&arena.frame, dacBuffer);
+	}
+
+	if (scrubSpeed && (res == DECODER_WORKED))
+	{
+		scrubSamples += numOfSamples / numOfChannels;
+
+		if (scrubSamples >= sampleRate / SCRUB_SNIPPETS_PER_SEC)
+		{
+			// Jump ahead so the snippets move through the song scrubSpeed times faster,
+			// the next decode resyncs and primes the reservoir in the same call
+			AudioDecoder_Seek((scrubSpeed - 1) * scrubSamples);
+			scrubSamples = 0;
+		}
+	}
+
+	if (crossfading)
+	{
+		// The mix lasts what the incoming song gave
+		bufferSize = mixedSamples;
+
+		if ((res != DECODER_WORKED) || (fadeSamples >= fadeLength))
+		{
+			// The outgoing song is over, its decoder stops here
+			finishCrossfade();
+		}
+	}
+	else if (res == DECODER_END_OF_FILE)
+	{
+		// Complete the rest of the buffer with 0V
+
+		for (uint32_t index = (numOfSamples / numOfChannels); index < BUFFER_SIZE ; index++)
+		{
+			dacBuffer[index] = DAC_ZERO_VOLT_VALUE;
+		}
+
+		bufferSize = BUFFER_SIZE;
+
+		// The same for every buffer until the FSM loads the next song, one event for all of them
+		if (!songEnded)
+		{
+			songEnded = true;
+			push_Queue_Element(NEXT_SONG_EV);
+		}
+
+	}
+	else
+	{
+		bufferSize = (numOfSamples / numOfChannels);
+
+		// Close enough to the end, the next song starts fading in with the next buffer
+		if (crossfadeSeconds && !scrubSpeed && !fadeStarted && (AudioDecoder_GetRemainingMs() <= crossfadeSeconds * 1000U))
+		{
+			startCrossfade();
+		}
+	}
+
+	// Ready, the DMA plays it after the ones already queued
+	AudioPlayer_CommitBuffer(sampleRate, bufferSize);
+
+	if (songEnded)
+	{
+		// The main loop stops refilling until the next song, the silence after it is expected
+		AudioPlayer_SongEnded();
+	}
+
+	// Compute FFT and set the vumeter
+	VU_FFT(arena.frame.f32, sampleRate, 80, 10000);
+}
+#endif
+
+
+#if AUDIO_PLAYER_FIXED_RATE
+static void refillResampled(uint16_t * dacBuffer)
+{
+	uint32_t index;
+
+	// 1 - The playing song at the DAC rate (and tempo), mono Q31 with the headroom of the EQ. Silence after its end
+	uint32_t written = (tempo == MP3_TEMPO_NORMAL) ? resampleStream(&playingStream, arena.frame.q31) :
+												   stretchStream(&playingStream, arena.frame.q31);
+
+	for (index = written; index < BUFFER_SIZE; index++)
+	{
+		arena.frame.q31[index] = 0;
+	}
+
+	// Its loudness, as it is played and before the fade
+	if (measuring == MEASURE_PLAYING)
+	{
+		Loudness_Process(arena.frame.q31, written);
+	}
+
+	// 2 - Both songs are at the same rate now, any two can be mixed
+	if (crossfading)
+	{
+		mixResampled();
+	}
+
+	// 3 - Apply audio effects. The incoming stream is free when there is no fade, the comparison uses it
+	EQ_SetSampleRate(MIX_RATE);
+
+	if (compareRequested && !crossfading)
+	{
+		chainSnr = EQ_CompareChains(arena.frame.q31, arena.mix.reference, incomingStream.buffer->scratch,
+									&floatChainCycles, &fixedChainCycles);
+		compareRequested = false;
+		compared = true;
+	}
+	else if (!EQ_IsFlat())
+	{
+		EQ_ApplyQ31(arena.frame.q31);
+	}
+
+	// 4 - The peaks the EQ and the volume would clip, a few ms late
+	limit(arena.frame.q31, BUFFER_SIZE);
+
+	// 5 - Volume and the DAC offset, in one saturating pass
+	outputQ31(&arena.frame, dacBuffer);
+
+	if (crossfading)
+	{
+		if (playingStream.ended || (fadeSamples >= fadeLength))
+		{
+			// The outgoing song is over, the incoming one goes on from where the mix left it
+			finishCrossfade();
+		}
+	}
+	else if (playingStream.flushed && (written < BUFFER_SIZE))
+	{
+		// The buffers after it are silence until the FSM loads the next song, one event for all of them
+		if (!songEnded)
+		{
+			songEnded = true;
+			finishMeasure();
+			push_Queue_Element(NEXT_SONG_EV);
+		}
+	}
+	else if (crossfadeSeconds && !scrubSpeed && (tempo == MP3_TEMPO_NORMAL) && !fadeStarted &&
+			 (AudioDecoder_GetRemainingMs() <= crossfadeSeconds * 1000U))
+	{
+		// Close enough to the end, the next song starts fading in with the next buffer
+		startCrossfade();
+	}
+
+	// Always a full buffer, the DMA plays it after the ones already queued
+	AudioPlayer_CommitBuffer(AUDIO_PLAYER_FIXED_RATE, BUFFER_SIZE);
+
+	if (songEnded)
+	{
+		// The main loop stops refilling until the next song, the silence after it is expected
+		AudioPlayer_SongEnded();
+	}
+
+	// Compute FFT and set the vumeter
+	VU_FFT(arena.frame.f32, AUDIO_PLAYER_FIXED_RATE, 80, 10000);
+}
+
+
+static uint32_t resampleStream(resampled_stream_t * stream, q31_t * output)
+{
+	q31_t * block = &stream->buffer->samples[RESAMPLER_HISTORY];
+	uint32_t written = Resampler_Process(&stream->resampler, block, stream->length, output, BUFFER_SIZE);
+
+	while ((written < BUFFER_SIZE) && !stream->flushed)
+	{
+		// The frame ran out, its end is the history of the next one
+		Resampler_NextBlock(&stream->resampler, block, stream->length);
+
+		decoder_result_t res = DECODER_WORKED;
+
+		if (stream->ended)
+		{
+			// The filter still holds the last samples of the song, silence after them pushes them out
+			stream->length = Resampler_Flush(block);
+			stream->flushed = true;
+		}
+		else
+		{
+			res = decodeBlock(stream);
+		}
+
+		written += Resampler_Process(&stream->resampler, block, stream->length, &output[written], BUFFER_SIZE - written);
+
+		if ((res != DECODER_WORKED) && (res != DECODER_END_OF_FILE))
+		{
+			// Broken frame, the rest of this buffer is silence and the next one tries again
+			break;
+		}
+	}
+
+	return written;
+}
+
+
+static uint32_t stretchStream(resampled_stream_t * stream, q31_t * output)
+{
+	uint32_t written = 0;
+	uint32_t cycles = 0;
+	bool more = true;
+
+	for (uint32_t index = 0; index < BUFFER_SIZE; index += WSOLA_HOP)
+	{
+		// As much of the song as the tempo reads, the decoder is asked for more or fewer frames per buffer
+		while (more && Wsola_Needed())
+		{
+			uint32_t got = resampleStream(stream, Wsola_AcquireInput());
+			Wsola_CommitInput(got);
+
+			// Short only at its end (or a broken frame), Wsola_Hop takes the rest as silence
+			more = (got == BUFFER_SIZE);
+		}
+
+		uint32_t startCycles = DWT->CYCCNT;
+		written += Wsola_Hop(&output[index]);
+		cycles += DWT->CYCCNT - startCycles;
+	}
+
+	if (cycles > maxStretchCycles)
+	{
+		maxStretchCycles = cycles;
+	}
+
+	return written;
+}
+
+
+static decoder_result_t decodeBlock(resampled_stream_t * stream)
+{
+	uint32_t numOfSamples = 0;
+	uint8_t numOfChannels = 1;
+	int inSampleRate = 0;
+	decoder_result_t res;
+	short * pcm = stream->buffer->decoded.pcm;
+	q31_t * block = &stream->buffer->samples[RESAMPLER_HISTORY];
+
+	if (stream->stream == DECODER_PLAYING_STREAM)
+	{
+		res = AudioDecoder_DecodeFrame(pcm, 2*BUFFER_SIZE, &numOfSamples, &inSampleRate);
+		AudioDecoder_GetChannels(&numOfChannels);
+	}
+	else
+	{
+		res = AudioDecoder_DecodeIncomingFrame(pcm, 2*BUFFER_SIZE, &numOfSamples, &inSampleRate);
+		AudioDecoder_GetIncomingChannels(&numOfChannels);
+	}
+
+	uint32_t length = ((res == DECODER_WORKED) || (res == DECODER_END_OF_FILE)) ? numOfSamples / numOfChannels : 0;
+
+	// Mono Q31 in the place of the PCM. Each sample lands on or after the words it came from:
+	// backwards for mono (one short per word), forwards for stereo (the two shorts of the same word)
+	if (numOfChannels == 1)
+	{
+		for (uint32_t index = length; index > 0; index--)
+		{
+			block[index - 1] = pcm[index - 1] << MONO_TO_DSP_SHIFT;
+		}
+	}
+	else
+	{
+		for (uint32_t index = 0; index < length; index++)
+		{
+			block[index] = (pcm[index * 2] + pcm[index * 2 + 1]) << MONO_TO_DSP_SHIFT;
+		}
+	}
+
+	stream->length = length;
+	stream->ended = (res == DECODER_END_OF_FILE);
+
+	if (length && (inSampleRate > 0))
+	{
+		Resampler_SetInputRate(&stream->resampler, (uint32_t)inSampleRate);
+	}
+
+	if (stream->stream == DECODER_PLAYING_STREAM)
+	{
+		if (length && (inSampleRate > 0))
+		{
+			sampleRate = (uint32_t)inSampleRate;
+		}
+
+		if (scrubSpeed && (res == DECODER_WORKED))
+		{
+			scrubSamples += length;
+
+			if (scrubSamples >= sampleRate / SCRUB_SNIPPETS_PER_SEC)
+			{
+				// Jump ahead so the snippets move through the song scrubSpeed times faster,
+				// the next decode resyncs and primes the reservoir in the same call
+				AudioDecoder_Seek((scrubSpeed - 1) * scrubSamples);
+				scrubSamples = 0;
+			}
+		}
+	}
+
+	return res;
+}
+
+
+static void resetStream(resampled_stream_t * stream)
+{
+	Resampler_Init(&stream->resampler, &stream->buffer->samples[RESAMPLER_HISTORY], AUDIO_PLAYER_FIXED_RATE);
+	stream->length = 0;
+	stream->ended = false;
+	stream->flushed = false;
+}
+
+
+static void mixResampled(void)
+{
+	uint32_t inSamples = resampleStream(&incomingStream, arena.mix.q31);
+
+	if (inSamples == 0)
+	{
+		// The next song is broken, no fade this time
+		cancelCrossfade();
+		return;
+	}
+
+	for (uint32_t index = inSamples; index < BUFFER_SIZE; index++)
+	{
+		arena.mix.q31[index] = 0;
+	}
+
+	if (measuring == MEASURE_INCOMING)
+	{
+		Loudness_Process(arena.mix.q31, inSamples);
+	}
+
+	q31_t gainOut, gainIn, stepOut, stepIn;
+	fadeGains(BUFFER_SIZE, &gainOut, &gainIn, &stepOut, &stepIn);
+	int32_t ratio = mixRatio();
+
+	for (uint32_t index = 0; index < BUFFER_SIZE; index++)
+	{
+		// The output stage applies the gain of the outgoing song, the incoming one is set relative to it
+		q31_t incoming = clip_q63_to_q31(((q63_t)arena.mix.q31[index] * ratio) >> 14);
+
+		// Both at the headroom of the EQ, the sum of two gains of at most 1 stays in it
+		arena.frame.q31[index] = clip_q63_to_q31(((q63_t)arena.frame.q31[index] * gainOut +
+												  (q63_t)incoming * gainIn) >> 31);
+
+		gainOut += stepOut;
+		gainIn += stepIn;
+	}
+}
+#endif
@@ -8,6 +8,17 @@
 #define _MP3_HANDLER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// Last step to the 12 bits of the DAC
+typedef enum
+{
+	MP3_DITHER_OFF,			// Rounded
+	MP3_DITHER_TPDF,		// Triangular dither of +-1 LSB, the error no longer follows the song
+	MP3_DITHER_SHAPED		// TPDF with the error fed back (1 - z^-1), moved up the spectrum
+} mp3Dither_t;
+
+#define MP3_TEMPO_NORMAL	(100U)
 
 /**
  * @brief Initializes the mp3 Handler
@@ -107,6 +118,11 @@ char * mp3Handler_getYear(void);
  */
 void mp3Handler_updateAll(void);
 
+/**
+ *  @brief Reads some more of the playing song ahead of the decoder. Call it when there is spare time.
+ */
+void mp3Handler_readAhead(void);
+
 /**
  *  @brief Draws Display.
  */
@@ -148,5 +164,144 @@ char mp3Handler_getVolume(void);
  */
 void mp3Handler_setVolume(char value);
 
+/**
+ *  @brief Turns the vocal remover (center-channel removal) on or off.
+ */
+void mp3Handler_toggleKaraoke(void);
+
+/**
+ *  @brief Gets the vocal remover state.
+ *  @return true if the center channel is being removed.
+ */
+bool mp3Handler_getKaraoke(void);
+
+/**
+ *  @brief Starts the scrub preview: 100 ms snippets from positions moving 4x faster than normal.
+ */
+void mp3Handler_startScrub(void);
+
+/**
+ *  @brief Goes back to normal playback from the current scrub position.
+ */
+void mp3Handler_stopScrub(void);
+
+/**
+ *  @brief Doubles the scrub speed, up to 16x.
+ */
+void mp3Handler_scrubFaster(void);
+
+/**
+ *  @brief Halves the scrub speed, down to 4x.
+ */
+void mp3Handler_scrubSlower(void);
+
+/**
+ *  @brief Gets the scrub speed.
+ *  @return times faster than normal playback, 0 if not scrubbing.
+ */
+uint8_t mp3Handler_getScrubSpeed(void);
+
+/**
+ *  @brief Sets the crossfade between consecutive songs: the next one fades in (equal power)
+ *         during the last seconds of the playing one, decoded at the same time.
+ *  @param seconds: fade length, 1 to 10, 0 turns it off.
+ */
+void mp3Handler_setCrossfade(uint8_t seconds);
+
+/**
+ *  @brief Gets the crossfade length.
+ *  @return seconds, 0 if off.
+ */
+uint8_t mp3Handler_getCrossfade(void);
+
+/**
+ *  @brief Sets the speed, the pitch stays the same (WSOLA). There is no crossfade away from the normal speed.
+ *         Only with AUDIO_PLAYER_FIXED_RATE.
+ *  @param percent: MP3_TEMPO_NORMAL is the song as it is, 50 to 200.
+ */
+void mp3Handler_setTempo(uint8_t percent);
+
+/**
+ *  @brief Gets the speed.
+ *  @return percent of the normal one.
+ */
+uint8_t mp3Handler_getTempo(void);
+
+/**
+ *  @brief Gets the worst buffer of the tempo change, the search and overlap only (not the extra decoding).
+ *  @return CPU cycles.
+ */
+uint32_t mp3Handler_getStretchCycles(void);
+
+/**
+ *  @brief Gets the worst time spent filling a buffer (decode, mix, EQ, DAC conversion and FFT).
+ *         The budget is 1152 samples at 44.1 kHz, 26.12 ms or ~3.13 M cycles at 120 MHz.
+ *         What a crossfade (a second decoder) costs on the board comes from here, it was never measured.
+ *  @param crossfade: true for the buffers with two decoders running.
+ *  @return CPU cycles.
+ */
+uint32_t mp3Handler_getMaxBufferCycles(bool crossfade);
+
+/**
+ *  @brief Gets the deepest the stack has been since mp3Handler_init.
+ *  @return bytes.
+ */
+uint32_t mp3Handler_getStackHighWater(void);
+
+/**
+ *  @brief Runs the float EQ chain next to the Q31 one on the next buffer that goes through the EQ,
+ *         to compare them (mp3Handler_getDspComparison).
+ */
+void mp3Handler_compareDspChains(void);
+
+/**
+ *  @brief Gets the last comparison of the DSP chains. No SNR or cycle count of the Q31 chain has been
+ *         taken on the board yet, this is where they come from.
+ *  @param snr: here we store the SNR of the Q31 chain against the float one, dB.
+ *  @param floatCycles: here we store the CPU cycles of the float chain for one buffer.
+ *  @param fixedCycles: here we store the CPU cycles of the Q31 chain for one buffer.
+ *  @return false if no buffer was compared yet.
+ */
+bool mp3Handler_getDspComparison(float * snr, uint32_t * floatCycles, uint32_t * fixedCycles);
+
+/**
+ *  @brief Sets how the output is quantized to the DAC. The noise of each mode was only compared in a
+ *         host simulation of the output stage, not on the DAC.
+ *  @param dither: MP3_DITHER_SHAPED unless changed.
+ */
+void mp3Handler_setDither(mp3Dither_t dither);
+
+/**
+ *  @brief Gets how the output is quantized to the DAC.
+ *  @return the dither.
+ */
+mp3Dither_t mp3Handler_getDither(void);
+
+/**
+ *  @brief Gets the worst buffer of the output stage (volume, dither, 12 bits, vumeter samples).
+ *         Its cost was estimated from the instruction count, this is the measured one.
+ *  @return CPU cycles.
+ */
+uint32_t mp3Handler_getOutputCycles(void);
+
+/**
+ *  @brief Sets the times of the limiter after the EQ, it keeps the peaks below the top of the DAC at any volume.
+ *  @param attackUs: look-ahead, also the delay it adds. Up to LIMITER_MAX_LOOKAHEAD samples.
+ *  @param releaseMs: time the gain takes to come back after a peak.
+ */
+void mp3Handler_setLimiter(uint32_t attackUs, uint32_t releaseMs);
+
+/**
+ *  @brief Gets the worst buffer of the limiter.
+ *  @return CPU cycles.
+ */
+uint32_t mp3Handler_getLimiterCycles(void);
+
+/**
+ *  @brief Tells if the playing song reached its end and NEXT_SONG_EV was pushed for it.
+ *  @return true until another song is loaded.
+ */
+bool mp3Handler_songEnded(void);
+
 
 #endif /* _MP3_HANDLER_H_ */
@@ -0,0 +1,2155 @@
+/*******************************************************************************
+  @file     aac_test.c
+  @brief    Host check of the AAC decoder against files encoded here and a double-precision decode
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -include tests/host/sdk_host.h -Icomponent/fatfs -Isource/drivers/HAL -Isource/drivers/SDK -Itests/host \
+ *       tests/host/aac_test.c tests/host/decoder_host.c -lm -o aac_test
+ *   ./aac_test
+ *
+ * Add -DAAC_READAHEAD_KB=1 to run it with chunks longer than the read-ahead ring.
+ *
+ * aac_decoder.c is built into the test: the encoder here takes its Huffman codes from the decoder's trees and
+ * its scalefactor bands from the decoder's tables. They are checked first: every tree must be a complete
+ * prefix code with one codeword per entry of its book, every band table must grow up to 1024 or 128.
+ *
+ * The encoder is no good for music, it is made to reach what AAC-LC and MP4 can hold: the four window
+ * sequences with both shapes and grouped short windows, every section codebook (escapes, noise and both
+ * intensity ones), pulses, TNS, mid/side per band and on all of them, channel pairs with and without a
+ * common window, fill and data elements; in the container moov before or after mdat, stco and co64, a fixed
+ * sample size, chunks with junk between them, QuickTime sample entries, HE-AAC and explicit rate configs,
+ * edit lists and a video track before the sound one. The spectra it wrote are decoded back here in double
+ * precision, the way the specification does it. The decoder must be within MAX_DIFFERENCE of that decode,
+ * at 16 bits:
+ * - Stereo and mono, from 8 to 48 kHz.
+ * - Center cancel, (L - R) / 2.
+ * - Forward and backward seeks, which land on the exact sample. Not on the files with noise bands: the
+ *   noise of a frame depends on every frame decoded before it.
+ * - The tags of the ilst box and the length of the song, after the edit list.
+ * The decoder keeps the spectrum with 5 bits under the output LSB: TNS filters and intensity bands louder
+ * than the left channel multiply its rounding. The files keep their filters under 6 dB of gain and their
+ * intensity bands up to 6 dB over the left, but the "strong" one: filters as random indices give them, up
+ * to 40 dB, and intensity up to 12 dB over. It is held to MAX_DIFFERENCE_STRONG instead.
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "decoder_host.h"
+#include "aac_decoder.c"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define OUTPUT_SIZE			(2304U)
+#define READ_AHEAD_EVERY	(2)
+#define MAX_DIFFERENCE		(3)				// 16 bit LSB: the rounding of the IMDCT, of the output and of the reference
+#define MAX_DIFFERENCE_STRONG	(32)
+
+#define LEVEL				(40000.0)		// Of the dequantized values of a long window, in 16 bit LSB
+#define SHORT_LEVEL			(LEVEL / 8)
+#define MAX_QUANTIZED		(POW43_MAX - 15)	// Room for a pulse on top
+#define MAX_CHANNEL_BYTES	(AAC_MAX_FRAME_BYTES / AAC_MAX_CHANNELS)	// Longer frames are made again
+#define MAX_JUNK			(700)			// Bytes before each chunk
+#define MOVIE_TIMESCALE		(600U)
+#define SF_ENTRIES			(121)
+#define MAX_BOOK_ENTRIES	(289)
+#define MAX_CODEWORD		(19)			// What decodeCodeword can peek
+#define MAX_TNS_GAIN		(2.0)			// Of the TNS filters, but on the strong file
+#define MIN_POSITION		(-8)			// Intensity: the right channel up to 6 dB over the left
+#define MIN_POSITION_STRONG	(-16)			// And up to 12 dB on the strong file
+#define STRONG_TNS_SPREAD	(1.2)			// Standard deviation of its TNS indices, at 3 bits
+#define GAIN_POINTS			(512)
+
+// Options of a file
+#define USE_MS				(1U << 0)
+#define USE_INTENSITY		(1U << 1)
+#define USE_TNS				(1U << 2)
+#define USE_PULSES			(1U << 3)
+#define USE_NOISE			(1U << 4)
+#define USE_EXTRA			(1U << 5)		// Fill and data elements
+#define UNCOMMON_WINDOWS	(1U << 6)		// Channel pairs without a common window
+#define STRONG				(1U << 7)
+#define USE_TAGS			(1U << 8)
+#define MOOV_LAST			(1U << 9)
+#define CO64				(1U << 10)
+#define QUICKTIME			(1U << 11)
+#define FIXED_SIZE			(1U << 12)
+#define HE_AAC_CONFIG		(1U << 13)		// Object type 5 with the extension rate, the core is still LC
+#define EXPLICIT_RATE		(1U << 14)
+#define EMPTY_EDIT			(1U << 15)		// An elst version 1 whose first entry is empty
+#define ES_FLAGS			(1U << 16)		// ES_Descriptor with a dependency, a URL and an OCR stream
+
+#define TITLE				"T\xC3\xADtulo de prueba"
+#define ARTIST				"Grupo 5"
+#define YEAR				"2021"
+#define TRACK				"12"
+#define ALBUM_LENGTH		(80)			// Of 'A', the decoder keeps AAC_TAG_SIZE - 1
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	const char * name;
+	uint8_t rateIndex;
+	uint8_t channels;
+	uint32_t frames;
+	uint32_t options;
+	uint32_t editStart;				// Samples before the song, with editLength
+	uint32_t editLength;			// Samples of the song, 0 without an edit list
+	uint32_t mediaTimescale;		// Of mdhd, 0 for the sample rate
+	uint32_t seed;
+} aac_file_t;
+
+typedef struct
+{
+	bool centerCancel;
+	int32_t seek;					// Samples, every seekEvery calls. 0 to play straight through
+	uint32_t seekEvery;
+} aac_run_t;
+
+typedef struct
+{
+	uint8_t * data;
+	uint32_t capacity;
+	uint32_t bits;
+} bit_writer_t;
+
+typedef struct
+{
+	uint8_t * data;
+	uint32_t capacity;
+	uint32_t size;
+} byte_buffer_t;
+
+typedef struct
+{
+	uint32_t code;
+	uint8_t length;					// 0 if the tree does not have the entry
+} codeword_t;
+
+typedef struct
+{
+	uint8_t length;					// Bands
+	uint8_t order;
+	bool downward;
+	bool compress;
+	int8_t coefficients[AAC_TNS_MAX_ORDER];
+} tns_filter_t;
+
+typedef struct
+{
+	uint8_t filters;
+	uint8_t resolution;				// 0 for 3 bit coefficients, 1 for 4 bits
+	tns_filter_t filter[AAC_TNS_MAX_FILTERS];
+} tns_window_t;
+
+// One channel of a frame, as written and as it must be decoded
+typedef struct
+{
+	aacIcsInfo_t info;
+	uint8_t grouping;
+	uint8_t globalGain;
+	uint8_t books[AAC_SHORT_WINDOWS][AAC_MAX_SFB];
+	int16_t scalefactors[AAC_SHORT_WINDOWS][AAC_MAX_SFB];	// Intensity positions and noise energies too
+	int32_t quantized[AAC_LONG_HALF];
+	uint8_t pulseCount;				// 0 for none
+	uint8_t pulseStart;
+	uint8_t pulseOffsets[AAC_MAX_PULSES];
+	uint8_t pulseAmplitudes[AAC_MAX_PULSES];
+	bool tns;
+	tns_window_t tnsWindows[AAC_SHORT_WINDOWS];
+	double values[AAC_LONG_HALF];	// Dequantized, in 16 bit LSB
+} coded_channel_t;
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static const aac_file_t files[] =
+{
+	{"stereo 44.1",   4, 2, 300, USE_MS | USE_INTENSITY | USE_TNS | USE_PULSES | USE_EXTRA | UNCOMMON_WINDOWS | USE_TAGS,
+		2112, 300 * AAC_FRAME_LENGTH - 2112 - 500, 0, 11},
+	{"mono 32",       5, 1, 200, USE_TNS | USE_PULSES | USE_NOISE | MOOV_LAST | CO64 | QUICKTIME | USE_TAGS, 0, 0, 0, 12},
+	{"stereo 22.05",  7, 2, 150, USE_MS | USE_TNS | USE_NOISE | HE_AAC_CONFIG | FIXED_SIZE, 0, 0, 0, 13},
+	{"mono 8",       11, 1, 100, USE_TNS | USE_PULSES | EXPLICIT_RATE | EMPTY_EDIT, 1024, 90000, 0, 14},
+	{"stereo 48",     3, 2, 160, USE_MS | USE_INTENSITY | UNCOMMON_WINDOWS | ES_FLAGS, 2048, 160000, 90000, 15},
+	{"strong 16",     8, 2, 140, USE_MS | USE_INTENSITY | USE_TNS | UNCOMMON_WINDOWS | STRONG, 0, 0, 0, 16},
+};
+
+static const aac_run_t runs[] =
+{
+	{false,     0,  1},
+	{true,      0,  1},
+	{false,  3000,  3},
+	{false, 20000,  4},
+	{false, -9000, 16},
+	{false,  1152,  1},
+};
+
+// Largest magnitude of each spectral codebook, without escapes
+static const uint8_t largestValue[ESC_HCB + 1] = { 0, 1, 1, 2, 2, 4, 4, 7, 7, 12, 12, 16 };
+
+// Books of the sections, the lower half of the bands can have the larger ones
+static const uint8_t lowBooks[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 11 };
+static const uint8_t sectionRuns[] = { 1, 1, 2, 3, 5, 8, 40 };
+
+static uint32_t randomState;
+static uint32_t referenceNoise;		// The decoder's PNS generator, run along with it
+
+static codeword_t scalefactorCodes[SF_ENTRIES];
+static codeword_t spectralCodes[ESC_HCB + 1][MAX_BOOK_ENTRIES];
+
+static double referenceWindows[2][2][2 * AAC_LONG_HALF];	// [long][shape], whole windows
+static double * cosines[2];			// Of the short and the long inverse MDCT, [n][k]
+static double referenceOverlap[AAC_MAX_CHANNELS][AAC_LONG_HALF];
+static uint8_t previousShapes[AAC_MAX_CHANNELS];
+static coded_channel_t coded[AAC_MAX_CHANNELS];
+
+static int16_t * reference;			// What the decoder must give, the mix of the channels
+static int16_t * referenceCancel;	// And with center cancel
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+static uint32_t nextRandom(void)
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+
+static uint32_t randomBelow(uint32_t limit)
+{
+	return nextRandom() % limit;
+}
+
+
+// True with a chance of percent in 100
+static bool chance(uint32_t percent)
+{
+	return randomBelow(100) < percent;
+}
+
+
+static int32_t randomBetween(int32_t low, int32_t high)
+{
+	return low + (int32_t)randomBelow(high - low + 1);
+}
+
+
+// In [0, 1)
+static double randomUnit(void)
+{
+	return (nextRandom() >> 8) / 16777216.0;
+}
+
+
+// Normal, by Box-Muller
+static double randomNormal(void)
+{
+	return sqrt(-2 * log(1 - randomUnit())) * cos(2 * M_PI * randomUnit());
+}
+
+
+static int32_t clamp(int32_t value, int32_t low, int32_t high)
+{
+	return (value < low) ? low : ((value > high) ? high : value);
+}
+
+
+// AAC packs its bits MSB first
+static void putBits(bit_writer_t * w, uint32_t value, uint8_t count)
+{
+	for (int32_t i = count - 1; i >= 0; i--)
+	{
+		if ((w->bits >> 3) >= w->capacity)
+		{
+			uint32_t capacity = 2 * w->capacity + 1024;
+			w->data = realloc(w->data, capacity);
+			memset(&w->data[w->capacity], 0, capacity - w->capacity);
+			w->capacity = capacity;
+		}
+		if ((value >> i) & 1)
+		{
+			w->data[w->bits >> 3] |= 0x80 >> (w->bits & 7);
+		}
+		w->bits++;
+	}
+}
+
+
+static void alignBits(bit_writer_t * w)
+{
+	while (w->bits & 7)
+	{
+		putBits(w, 0, 1);
+	}
+}
+
+
+static void putCodeword(bit_writer_t * w, const codeword_t * codeword)
+{
+	putBits(w, codeword->code, codeword->length);
+}
+
+
+static void putBytes(byte_buffer_t * b, const void * data, uint32_t count)
+{
+	if (b->size + count > b->capacity)
+	{
+		b->capacity = 2 * (b->size + count) + 1024;
+		b->data = realloc(b->data, b->capacity);
+	}
+	if (data)
+	{
+		memcpy(&b->data[b->size], data, count);
+	}
+	else
+	{
+		memset(&b->data[b->size], 0, count);
+	}
+	b->size += count;
+}
+
+
+// Big endian, like every number in MP4
+static void putNumber(byte_buffer_t * b, uint64_t value, uint8_t bytes)
+{
+	uint8_t data[8];
+
+	for (uint8_t i = 0; i < bytes; i++)
+	{
+		data[i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+	}
+	putBytes(b, data, bytes);
+}
+
+
+// Returns where the box starts, for endBox
+static uint32_t beginBox(byte_buffer_t * b, const char * type)
+{
+	uint32_t start = b->size;
+
+	putNumber(b, 0, 4);
+	putBytes(b, type, 4);
+	return start;
+}
+
+
+static uint32_t beginFullBox(byte_buffer_t * b, const char * type, uint8_t version, uint32_t flags)
+{
+	uint32_t start = beginBox(b, type);
+
+	putNumber(b, ((uint32_t)version << 24) | flags, 4);
+	return start;
+}
+
+
+static void endBox(byte_buffer_t * b, uint32_t start)
+{
+	uint32_t size = b->size - start;
+
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		b->data[start + i] = (uint8_t)(size >> (24 - 8 * i));
+	}
+}
+
+
+// Descriptors of esds with their size in four bytes, as most encoders write them. Returns where the contents start
+static uint32_t beginDescriptor(byte_buffer_t * b, uint8_t tag)
+{
+	putNumber(b, tag, 1);
+	putBytes(b, "\x80\x80\x80", 3);
+	putNumber(b, 0, 1);
+	return b->size;
+}
+
+
+static void endDescriptor(byte_buffer_t * b, uint32_t start)
+{
+	b->data[start - 1] = (uint8_t)(b->size - start);
+}
+
+
+static void checkTable(int ok, const char * table, const char * what, long value)
+{
+	printf("%-5s %-31s: %-24s %ld\n", ok ? "ok" : "FAIL", table, what, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+/*
+ * Codewords of a tree of the decoder: two children per node, a node index if > 0, -(entry + 1) if not.
+ * Returns the longest one, 0 unless every node is reached once and every entry once, which makes it a complete
+ * prefix code of the entries.
+ */
+static uint8_t readTree(const int16_t * tree, uint32_t entries, codeword_t * codes)
+{
+	struct { uint16_t node; uint32_t code; uint8_t length; } stack[MAX_BOOK_ENTRIES];
+	bool reached[MAX_BOOK_ENTRIES] = { false };
+	uint32_t depth = 0;
+	uint32_t found = 0;
+	uint32_t nodes = 1;
+	uint8_t longest = 0;
+
+	memset(codes, 0, entries * sizeof(codeword_t));
+	stack[depth].node = 0;
+	stack[depth].code = 0;
+	stack[depth++].length = 0;
+	reached[0] = true;
+
+	while (depth)
+	{
+		depth--;
+		uint16_t node = stack[depth].node;
+		uint32_t code = stack[depth].code;
+		uint8_t length = stack[depth].length + 1;
+
+		if (length > MAX_CODEWORD)
+		{
+			return 0;
+		}
+		for (uint32_t bit = 0; bit < 2; bit++)
+		{
+			int32_t child = tree[2 * node + bit];
+
+			if (child > 0)
+			{
+				// A tree of n entries has n - 1 nodes
+				if (((uint32_t)child >= entries - 1) || reached[child])
+				{
+					return 0;
+				}
+				reached[child] = true;
+				nodes++;
+				stack[depth].node = child;
+				stack[depth].code = (code << 1) | bit;
+				stack[depth++].length = length;
+			}
+			else
+			{
+				uint32_t entry = -child - 1;
+				if ((entry >= entries) || codes[entry].length)
+				{
+					return 0;
+				}
+				codes[entry].code = (code << 1) | bit;
+				codes[entry].length = length;
+				found++;
+				longest = (length > longest) ? length : longest;
+			}
+		}
+	}
+
+	return ((found == entries) && (nodes == entries - 1)) ? longest : 0;
+}
+
+
+static void checkTables(void)
+{
+	char name[32];
+
+	uint8_t longest = readTree(scalefactorTree, SF_ENTRIES, scalefactorCodes);
+	checkTable((longest != 0) && (sizeof(scalefactorTree) == 2 * (SF_ENTRIES - 1) * sizeof(int16_t)),
+			   "scalefactor tree", "longest codeword", longest);
+
+	for (uint8_t book = 1; book <= ESC_HCB; book++)
+	{
+		uint32_t entries = bookModulo[book] * bookModulo[book];
+		if (bookDimension[book] == 4)
+		{
+			entries *= entries;
+		}
+
+		sprintf(name, "spectral tree %u", book);
+		longest = readTree(spectralTrees[book], entries, spectralCodes[book]);
+		checkTable(longest != 0, name, "longest codeword", longest);
+	}
+
+	for (uint32_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+	{
+		const aacRate_t * rate = &rates[r];
+		bool ok = (rate->longBands <= AAC_MAX_SFB) && (rate->tnsLongBands <= rate->longBands) &&
+				  (rate->tnsShortBands <= rate->shortBands) && (rate->longOffsets[0] == 0) &&
+				  (rate->shortOffsets[0] == 0) && (rate->longOffsets[rate->longBands] == AAC_LONG_HALF) &&
+				  (rate->shortOffsets[rate->shortBands] == AAC_SHORT_HALF);
+
+		for (uint8_t sfb = 0; sfb < rate->longBands; sfb++)
+		{
+			ok = ok && (rate->longOffsets[sfb] < rate->longOffsets[sfb + 1]);
+		}
+		for (uint8_t sfb = 0; sfb < rate->shortBands; sfb++)
+		{
+			ok = ok && (rate->shortOffsets[sfb] < rate->shortOffsets[sfb + 1]);
+		}
+
+		sprintf(name, "bands at %lu Hz", (unsigned long)rate->sampleRate);
+		checkTable(ok, name, "long bands", rate->longBands);
+	}
+}
+
+
+static double besselI0(double x)
+{
+	double sum = 1;
+	double term = 1;
+
+	for (uint32_t k = 1; k < 60; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+
+static void makeWindows(void)
+{
+	for (uint8_t isLong = 0; isLong < 2; isLong++)
+	{
+		uint32_t n = 2 * (isLong ? AAC_LONG_HALF : AAC_SHORT_HALF);
+		double alpha = isLong ? 4 : 6;
+		double kaiser[AAC_LONG_HALF + 1];
+		double total = 0;
+		double sum = 0;
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			referenceWindows[isLong][SINE_WINDOW][i] = sin(M_PI / n * (i + 0.5));
+		}
+
+		// Kaiser-Bessel derived: the running sum of a Kaiser window of n / 2 + 1 points
+		for (uint32_t i = 0; i <= n / 2; i++)
+		{
+			double r = (i - n / 4.0) / (n / 4.0);
+			kaiser[i] = besselI0(M_PI * alpha * sqrt(fmax(0, 1 - r * r)));
+			total += kaiser[i];
+		}
+		for (uint32_t i = 0; i < n / 2; i++)
+		{
+			sum += kaiser[i];
+			referenceWindows[isLong][KBD_WINDOW][i] = sqrt(sum / total);
+			referenceWindows[isLong][KBD_WINDOW][n - 1 - i] = referenceWindows[isLong][KBD_WINDOW][i];
+		}
+	}
+}
+
+
+static void makeCosines(void)
+{
+	for (uint8_t size = 0; size < 2; size++)
+	{
+		uint32_t half = size ? AAC_LONG_HALF : AAC_SHORT_HALF;
+
+		cosines[size] = malloc(2 * half * half * sizeof(double));
+		for (uint32_t n = 0; n < 2 * half; n++)
+		{
+			for (uint32_t k = 0; k < half; k++)
+			{
+				cosines[size][n * half + k] = cos(M_PI / half * (n + 0.5 + half / 2.0) * (k + 0.5));
+			}
+		}
+	}
+}
+
+
+// With the 2 / N of the specification
+static void inverseMdct(const double * in, double * out, uint32_t half)
+{
+	const double * c = cosines[half == AAC_LONG_HALF];
+
+	for (uint32_t n = 0; n < 2 * half; n++)
+	{
+		double sum = 0;
+		for (uint32_t k = 0; k < half; k++)
+		{
+			sum += in[k] * c[n * half + k];
+		}
+		out[n] = sum / half;
+	}
+}
+
+
+static int16_t toPcm(double value)
+{
+	double sample = floor(value + 0.5);
+	return (sample < -32768) ? -32768 : ((sample > 32767) ? 32767 : (int16_t)sample);
+}
+
+
+static uint8_t nextSequence(uint8_t previous)
+{
+	if (previous == LONG_START_SEQUENCE)
+	{
+		return EIGHT_SHORT_SEQUENCE;
+	}
+	if (previous == EIGHT_SHORT_SEQUENCE)
+	{
+		return chance(50) ? EIGHT_SHORT_SEQUENCE : LONG_STOP_SEQUENCE;
+	}
+	return chance(33) ? LONG_START_SEQUENCE : ONLY_LONG_SEQUENCE;
+}
+
+
+static void makeInfo(const aacRate_t * rate, uint8_t sequence, coded_channel_t * c)
+{
+	aacIcsInfo_t * info = &c->info;
+
+	info->windowSequence = sequence;
+	info->windowShape = randomBelow(2);
+	info->groups = 1;
+	info->groupLength[0] = 1;
+	c->grouping = 0;
+
+	if (sequence == EIGHT_SHORT_SEQUENCE)
+	{
+		info->bands = rate->shortBands;
+		info->swbOffset = rate->shortOffsets;
+		info->maxSfb = chance(67) ? info->bands : randomBelow(info->bands + 1);
+
+		// A 1 puts the next window in the group of the one before
+		c->grouping = randomBelow(128);
+		for (int32_t bit = 6; bit >= 0; bit--)
+		{
+			if ((c->grouping >> bit) & 1)
+			{
+				info->groupLength[info->groups - 1]++;
+			}
+			else
+			{
+				info->groupLength[info->groups++] = 1;
+			}
+		}
+	}
+	else
+	{
+		uint32_t pick = randomBelow(3);
+
+		info->bands = rate->longBands;
+		info->swbOffset = rate->longOffsets;
+		info->maxSfb = info->bands;
+		if (pick == 1)
+		{
+			info->maxSfb = randomBetween(2 * info->bands / 3, info->bands);
+		}
+		else if (pick == 2)
+		{
+			info->maxSfb = randomBelow(info->bands + 1);
+		}
+	}
+}
+
+
+static bool isSpectral(uint8_t book)
+{
+	return (book != ZERO_HCB) && (book <= ESC_HCB);
+}
+
+
+// sin(c / ((2^(bits - 1) -+ 1 / 2) / (pi / 2))) as in the specification
+static double tnsParcor(uint8_t bits, int32_t index)
+{
+	double steps = (1 << (bits - 1)) + ((index >= 0) ? -0.5 : 0.5);
+	return sin(index / (steps / (M_PI / 2)));
+}
+
+
+// Step up from the reflection coefficients to the all-pole filter 1 / (1 + a[1] z^-1 + ...)
+static void stepUp(const tns_filter_t * filter, uint8_t resolution, double * a)
+{
+	a[0] = 1;
+	for (uint32_t m = 1; m <= filter->order; m++)
+	{
+		double parcor = tnsParcor(resolution + 3, filter->coefficients[m - 1]);
+		double previous[AAC_TNS_MAX_ORDER + 1];
+
+		memcpy(previous, a, m * sizeof(double));
+		for (uint32_t i = 1; i < m; i++)
+		{
+			a[i] = previous[i] + parcor * previous[m - i];
+		}
+		a[m] = parcor;
+	}
+}
+
+
+// Largest gain of the filter at any frequency, the spectrum taken as a signal
+static double tnsGain(const tns_filter_t * filter, uint8_t resolution)
+{
+	double a[AAC_TNS_MAX_ORDER + 1];
+	double largest = 0;
+
+	stepUp(filter, resolution, a);
+	for (uint32_t point = 0; point < GAIN_POINTS; point++)
+	{
+		double re = 0;
+		double im = 0;
+		for (uint32_t i = 0; i <= filter->order; i++)
+		{
+			re += a[i] * cos(M_PI * point * i / GAIN_POINTS);
+			im -= a[i] * sin(M_PI * point * i / GAIN_POINTS);
+		}
+
+		double gain = 1 / sqrt(re * re + im * im);
+		largest = (gain > largest) ? gain : largest;
+	}
+	return largest;
+}
+
+
+/*
+ * The filters of the strong file are any the indices give, mostly small ones. The others get random indices too,
+ * taken down one step at a time until the filter is under MAX_TNS_GAIN.
+ */
+static void makeTns(const aac_file_t * file, coded_channel_t * c)
+{
+	bool eightShort = (c->info.windowSequence == EIGHT_SHORT_SEQUENCE);
+
+	for (uint32_t w = 0; w < (eightShort ? AAC_SHORT_WINDOWS : 1); w++)
+	{
+		tns_window_t * t = &c->tnsWindows[w];
+
+		t->filters = randomBelow(eightShort ? 2 : 4);
+		t->resolution = t->filters ? randomBelow(2) : 0;
+
+		for (uint32_t f = 0; f < t->filters; f++)
+		{
+			tns_filter_t * filter = &t->filter[f];
+			filter->length = randomBelow(eightShort ? 16 : 64);
+			filter->order = randomBelow(eightShort ? 8 : AAC_TNS_MAX_ORDER + 1);
+			filter->downward = randomBelow(2);
+			filter->compress = randomBelow(2);
+
+			int32_t high = (1 << (t->resolution + 2 - filter->compress)) - 1;
+			for (uint32_t i = 0; i < filter->order; i++)
+			{
+				int32_t index = (file->options & STRONG) ?
+								(int32_t)(randomNormal() * STRONG_TNS_SPREAD * (1 << t->resolution)) :
+								randomBetween(-high - 1, high);
+				filter->coefficients[i] = clamp(index, -high - 1, high);
+			}
+			while (!(file->options & STRONG) && (tnsGain(filter, t->resolution) > MAX_TNS_GAIN))
+			{
+				int8_t * index = &filter->coefficients[randomBelow(filter->order)];
+				*index -= (*index > 0) - (*index < 0);
+			}
+		}
+	}
+}
+
+
+static void makePulses(coded_channel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint8_t codedBands[AAC_MAX_SFB];
+	uint8_t count = 0;
+
+	for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+	{
+		if (isSpectral(c->books[0][sfb]))
+		{
+			codedBands[count++] = sfb;
+		}
+	}
+	if (!count)
+	{
+		return;
+	}
+
+	// Each pulse is an offset from the one before, they must all land in bands with values
+	uint8_t start = codedBands[randomBelow(count)];
+	uint8_t pulses = 1 + randomBelow(AAC_MAX_PULSES);
+	uint32_t k = info->swbOffset[start];
+
+	for (uint8_t i = 0; i < pulses; i++)
+	{
+		c->pulseOffsets[i] = randomBelow(32);
+		c->pulseAmplitudes[i] = 1 + randomBelow(15);
+		k += c->pulseOffsets[i];
+		if (k >= info->swbOffset[info->maxSfb])
+		{
+			return;
+		}
+
+		uint8_t band = start;
+		while (info->swbOffset[band + 1] <= k)
+		{
+			band++;
+		}
+		if (!isSpectral(c->books[0][band]))
+		{
+			return;
+		}
+	}
+
+	c->pulseStart = start;
+	c->pulseCount = pulses;
+}
+
+
+/*
+ * Sections, values, scalefactors, pulses and TNS of a channel with its info made. level is what the dequantized
+ * values reach.
+ */
+static void makeChannel(const aac_file_t * file, coded_channel_t * c, double level, bool intensity)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint32_t windowSize = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? AAC_SHORT_HALF : 0;
+	uint8_t bands = info->maxSfb;
+	uint32_t window;
+
+	memset(c->books, 0, sizeof(c->books));
+	memset(c->scalefactors, 0, sizeof(c->scalefactors));
+	memset(c->quantized, 0, sizeof(c->quantized));
+	c->pulseCount = 0;
+	c->tns = false;
+
+	// Runs of the same book
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		uint32_t sfb = 0;
+		while (sfb < bands)
+		{
+			uint32_t r = randomBelow(100);
+			uint8_t book;
+
+			if (intensity && (r < 25))
+			{
+				book = chance(50) ? INTENSITY_HCB : INTENSITY_HCB2;
+			}
+			else if ((file->options & USE_NOISE) && (r < 35))
+			{
+				book = NOISE_HCB;
+			}
+			else if (r < 45)
+			{
+				book = ZERO_HCB;
+			}
+			else
+			{
+				book = (sfb < bands / 2U) ? lowBooks[randomBelow(sizeof(lowBooks))] : 1 + randomBelow(8);
+			}
+
+			uint32_t run = sectionRuns[randomBelow(sizeof(sectionRuns))];
+			for (uint32_t k = sfb; (k < bands) && (k < sfb + run); k++)
+			{
+				c->books[g][k] = book;
+			}
+			sfb += run;
+		}
+	}
+
+	// Values, mostly small ones on the escape book
+	window = 0;
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < bands; sfb++)
+		{
+			uint8_t book = c->books[g][sfb];
+			if (!isSpectral(book))
+			{
+				continue;
+			}
+
+			for (uint32_t w = 0; w < info->groupLength[g]; w++)
+			{
+				for (uint32_t k = info->swbOffset[sfb]; k < info->swbOffset[sfb + 1]; k++)
+				{
+					int32_t value;
+					if (book == ESC_HCB)
+					{
+						uint32_t r = randomBelow(100);
+						value = (r < 80) ? randomBetween(0, 15) : ((r < 97) ? randomBetween(16, 300) :
+																			randomBetween(300, MAX_QUANTIZED));
+					}
+					else
+					{
+						value = randomBetween(0, largestValue[book]);
+					}
+					c->quantized[(window + w) * windowSize + k] = chance(50) ? -value : value;
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+
+	// Scalefactors for a random level per band, each within 60 of the one before
+	int32_t previous = -1;
+	window = 0;
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < bands; sfb++)
+		{
+			if (!isSpectral(c->books[g][sfb]))
+			{
+				continue;
+			}
+
+			int32_t largest = 1;
+			for (uint32_t w = 0; w < info->groupLength[g]; w++)
+			{
+				for (uint32_t k = info->swbOffset[sfb]; k < info->swbOffset[sfb + 1]; k++)
+				{
+					int32_t value = abs(c->quantized[(window + w) * windowSize + k]);
+					largest = (value > largest) ? value : largest;
+				}
+			}
+
+			double target = level * (0.05 + 0.95 * randomUnit()) * ((sfb > bands / 2) ? 0.3 : 1);
+			int32_t sf = SF_OFFSET + (int32_t)lround(4 * log2(target / pow(largest, 4.0 / 3)));
+			if (previous >= 0)
+			{
+				sf = clamp(sf, previous - SF_DIFF_OFFSET, previous + SF_DIFF_OFFSET);
+			}
+			sf = clamp(sf, 0, 255);
+
+			if (previous < 0)
+			{
+				c->globalGain = sf;
+			}
+			c->scalefactors[g][sfb] = sf;
+			previous = sf;
+		}
+		window += info->groupLength[g];
+	}
+	if (previous < 0)
+	{
+		c->globalGain = randomBetween(90, 160);
+	}
+
+	// Intensity positions and noise energies, each within 60 of the one before too
+	int32_t position = 0;
+	int32_t energy = 0;
+	bool firstNoise = true;
+	int32_t lowestPosition = (file->options & STRONG) ? MIN_POSITION_STRONG : MIN_POSITION;
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < bands; sfb++)
+		{
+			uint8_t book = c->books[g][sfb];
+
+			if ((book == INTENSITY_HCB) || (book == INTENSITY_HCB2))
+			{
+				position = clamp(position + randomBetween(-12, 12), lowestPosition, 40);
+				c->scalefactors[g][sfb] = position;
+			}
+			else if (book == NOISE_HCB)
+			{
+				int32_t base = c->globalGain - NOISE_OFFSET;
+				int32_t wanted = (int32_t)lround(4 * log2(level * 0.2 * (0.3 + 0.7 * randomUnit()) * 8));
+
+				// The first one is sent in 9 bits from the global gain
+				energy = firstNoise ? clamp(wanted, base - NOISE_PCM_OFFSET, base + NOISE_PCM_OFFSET - 1) :
+									  clamp(wanted, energy - SF_DIFF_OFFSET, energy + SF_DIFF_OFFSET);
+				firstNoise = false;
+				c->scalefactors[g][sfb] = energy;
+			}
+		}
+	}
+
+	if ((file->options & USE_PULSES) && (info->windowSequence != EIGHT_SHORT_SEQUENCE) && chance(40))
+	{
+		makePulses(c);
+	}
+
+	if ((file->options & USE_TNS) && chance(50))
+	{
+		c->tns = true;
+		makeTns(file, c);
+	}
+}
+
+
+static void putInfo(bit_writer_t * w, const coded_channel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+
+	putBits(w, 0, 1);
+	putBits(w, info->windowSequence, 2);
+	putBits(w, info->windowShape, 1);
+	if (info->windowSequence == EIGHT_SHORT_SEQUENCE)
+	{
+		putBits(w, info->maxSfb, 4);
+		putBits(w, c->grouping, 7);
+	}
+	else
+	{
+		putBits(w, info->maxSfb, 6);
+		putBits(w, 0, 1);
+	}
+}
+
+
+static void putSpectralData(bit_writer_t * w, const coded_channel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint32_t windowSize = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? AAC_SHORT_HALF : 0;
+	uint32_t window = 0;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint8_t book = c->books[g][sfb];
+			if (!isSpectral(book))
+			{
+				continue;
+			}
+
+			uint32_t dimension = bookDimension[book];
+			for (uint32_t w2 = 0; w2 < info->groupLength[g]; w2++)
+			{
+				const int32_t * data = &c->quantized[(window + w2) * windowSize];
+
+				for (uint32_t k = info->swbOffset[sfb]; k < info->swbOffset[sfb + 1]; k += dimension)
+				{
+					uint32_t entry = 0;
+					for (uint32_t i = 0; i < dimension; i++)
+					{
+						int32_t value = bookMinimum[book] ? data[k + i] - bookMinimum[book] : abs(data[k + i]);
+						entry = entry * bookModulo[book] + ((value > 16) ? 16 : value);
+					}
+					putCodeword(w, &spectralCodes[book][entry]);
+
+					if (bookMinimum[book])
+					{
+						continue;
+					}
+
+					// Unsigned books: a sign bit per value that is not 0, then the escapes
+					for (uint32_t i = 0; i < dimension; i++)
+					{
+						if (data[k + i])
+						{
+							putBits(w, data[k + i] < 0, 1);
+						}
+					}
+					if (book != ESC_HCB)
+					{
+						continue;
+					}
+					for (uint32_t i = 0; i < dimension; i++)
+					{
+						uint32_t value = abs(data[k + i]);
+						if (value < 16)
+						{
+							continue;
+						}
+
+						// N ones and a zero, then value - 2^(N + 4) in N + 4 bits
+						uint32_t n = 0;
+						while (value >> (n + 5))
+						{
+							n++;
+						}
+						putBits(w, (1U << (n + 1)) - 2, n + 1);
+						putBits(w, value - (1U << (n + 4)), n + 4);
+					}
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+}
+
+
+static void putChannel(bit_writer_t * w, const coded_channel_t * c, bool commonWindow)
+{
+	const aacIcsInfo_t * info = &c->info;
+	bool eightShort = (info->windowSequence == EIGHT_SHORT_SEQUENCE);
+	uint8_t lengthBits = eightShort ? 3 : 5;
+	uint32_t escape = (1U << lengthBits) - 1;
+
+	putBits(w, c->globalGain, 8);
+	if (!commonWindow)
+	{
+		putInfo(w, c);
+	}
+
+	// Sections
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		uint32_t sfb = 0;
+		while (sfb < info->maxSfb)
+		{
+			uint32_t length = 1;
+			while ((sfb + length < info->maxSfb) && (c->books[g][sfb + length] == c->books[g][sfb]))
+			{
+				length++;
+			}
+
+			putBits(w, c->books[g][sfb], 4);
+			for (uint32_t left = length; ; left -= escape)
+			{
+				if (left < escape)
+				{
+					putBits(w, left, lengthBits);
+					break;
+				}
+				putBits(w, escape, lengthBits);
+			}
+			sfb += length;
+		}
+	}
+
+	// Scalefactors, intensity positions and noise energies, each from the one before of its kind
+	int32_t lastScalefactor = c->globalGain;
+	int32_t lastPosition = 0;
+	int32_t lastEnergy = c->globalGain - NOISE_OFFSET;
+	bool firstNoise = true;
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint8_t book = c->books[g][sfb];
+			int32_t value = c->scalefactors[g][sfb];
+
+			if (book == ZERO_HCB)
+			{
+				continue;
+			}
+			if ((book == INTENSITY_HCB) || (book == INTENSITY_HCB2))
+			{
+				putCodeword(w, &scalefactorCodes[value - lastPosition + SF_DIFF_OFFSET]);
+				lastPosition = value;
+			}
+			else if (book == NOISE_HCB)
+			{
+				if (firstNoise)
+				{
+					putBits(w, value - lastEnergy + NOISE_PCM_OFFSET, 9);
+					firstNoise = false;
+				}
+				else
+				{
+					putCodeword(w, &scalefactorCodes[value - lastEnergy + SF_DIFF_OFFSET]);
+				}
+				lastEnergy = value;
+			}
+			else
+			{
+				putCodeword(w, &scalefactorCodes[value - lastScalefactor + SF_DIFF_OFFSET]);
+				lastScalefactor = value;
+			}
+		}
+	}
+
+	putBits(w, c->pulseCount != 0, 1);
+	if (c->pulseCount)
+	{
+		putBits(w, c->pulseCount - 1, 2);
+		putBits(w, c->pulseStart, 6);
+		for (uint8_t i = 0; i < c->pulseCount; i++)
+		{
+			putBits(w, c->pulseOffsets[i], 5);
+			putBits(w, c->pulseAmplitudes[i], 4);
+		}
+	}
+
+	putBits(w, c->tns, 1);
+	if (c->tns)
+	{
+		for (uint32_t win = 0; win < (eightShort ? AAC_SHORT_WINDOWS : 1); win++)
+		{
+			const tns_window_t * t = &c->tnsWindows[win];
+
+			putBits(w, t->filters, eightShort ? 1 : 2);
+			if (t->filters)
+			{
+				putBits(w, t->resolution, 1);
+			}
+			for (uint32_t f = 0; f < t->filters; f++)
+			{
+				const tns_filter_t * filter = &t->filter[f];
+				putBits(w, filter->length, eightShort ? 4 : 6);
+				putBits(w, filter->order, eightShort ? 3 : 5);
+				if (!filter->order)
+				{
+					continue;
+				}
+
+				uint8_t bits = t->resolution + 3 - filter->compress;
+				putBits(w, filter->downward, 1);
+				putBits(w, filter->compress, 1);
+				for (uint32_t i = 0; i < filter->order; i++)
+				{
+					putBits(w, (uint32_t)filter->coefficients[i] & ((1U << bits) - 1), bits);
+				}
+			}
+		}
+	}
+
+	// No gain control
+	putBits(w, 0, 1);
+
+	putSpectralData(w, c);
+}
+
+
+static int32_t nextNoise(void)
+{
+	referenceNoise = referenceNoise * 1664525U + 1013904223U;
+	return (int32_t)referenceNoise >> 16;
+}
+
+
+// The values of a channel, the noise from the decoder's generator in the order the decoder makes it
+static void dequantizeChannel(coded_channel_t * c)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint32_t windowSize = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? AAC_SHORT_HALF : 0;
+	int32_t quantized[AAC_LONG_HALF];
+	uint32_t window = 0;
+
+	memcpy(quantized, c->quantized, sizeof(quantized));
+	uint32_t k = c->pulseCount ? info->swbOffset[c->pulseStart] : 0;
+	for (uint8_t i = 0; i < c->pulseCount; i++)
+	{
+		k += c->pulseOffsets[i];
+		quantized[k] += (quantized[k] > 0) ? c->pulseAmplitudes[i] : -c->pulseAmplitudes[i];
+	}
+
+	memset(c->values, 0, sizeof(c->values));
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint8_t book = c->books[g][sfb];
+			uint32_t start = info->swbOffset[sfb];
+			uint32_t end = info->swbOffset[sfb + 1];
+			int32_t sf = c->scalefactors[g][sfb];
+
+			for (uint32_t w = 0; w < info->groupLength[g]; w++)
+			{
+				double * values = &c->values[(window + w) * windowSize];
+				const int32_t * q = &quantized[(window + w) * windowSize];
+
+				if (book == NOISE_HCB)
+				{
+					// Scaled to the energy of the band, by the integer square root of the sum of the squares
+					int32_t noise[AAC_LONG_HALF];
+					uint64_t energy = 0;
+					for (uint32_t i = start; i < end; i++)
+					{
+						noise[i] = nextNoise();
+						energy += (int64_t)noise[i] * noise[i];
+					}
+					uint64_t root = (uint64_t)sqrt((double)energy);
+					while (root * root > energy)
+					{
+						root--;
+					}
+					while ((root + 1) * (root + 1) <= energy)
+					{
+						root++;
+					}
+					for (uint32_t i = start; root && (i < end); i++)
+					{
+						values[i] = (double)noise[i] / root * pow(2, sf / 4.0);
+					}
+				}
+				else if (isSpectral(book))
+				{
+					for (uint32_t i = start; i < end; i++)
+					{
+						double magnitude = pow(abs(q[i]), 4.0 / 3) * pow(2, (sf - SF_OFFSET) / 4.0);
+						values[i] = (q[i] < 0) ? -magnitude : magnitude;
+					}
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+}
+
+
+// Intensity and mid/side of a channel pair with a common window. mask is ms_mask_present
+static void stereoChannels(coded_channel_t * left, coded_channel_t * right, uint8_t mask,
+						   uint8_t used[AAC_SHORT_WINDOWS][AAC_MAX_SFB])
+{
+	const aacIcsInfo_t * info = &left->info;
+	uint32_t windowSize = (info->windowSequence == EIGHT_SHORT_SEQUENCE) ? AAC_SHORT_HALF : 0;
+	uint32_t window = 0;
+
+	for (uint8_t g = 0; g < info->groups; g++)
+	{
+		for (uint8_t sfb = 0; sfb < info->maxSfb; sfb++)
+		{
+			uint8_t leftBook = left->books[g][sfb];
+			uint8_t rightBook = right->books[g][sfb];
+			bool ms = (mask == 2) || ((mask == 1) && used[g][sfb]);
+
+			for (uint32_t w = 0; w < info->groupLength[g]; w++)
+			{
+				double * l = &left->values[(window + w) * windowSize];
+				double * r = &right->values[(window + w) * windowSize];
+
+				for (uint32_t k = info->swbOffset[sfb]; k < info->swbOffset[sfb + 1]; k++)
+				{
+					if ((rightBook == INTENSITY_HCB) || (rightBook == INTENSITY_HCB2))
+					{
+						// The mask flips the sign of intensity bands
+						double sign = ((rightBook == INTENSITY_HCB) != ((mask == 1) && used[g][sfb])) ? 1 : -1;
+						r[k] = sign * l[k] * pow(2, -right->scalefactors[g][sfb] / 4.0);
+					}
+					else if (ms && (leftBook < NOISE_HCB) && (rightBook < NOISE_HCB))
+					{
+						double mid = l[k];
+						double side = r[k];
+						l[k] = mid + side;
+						r[k] = mid - side;
+					}
+				}
+			}
+		}
+		window += info->groupLength[g];
+	}
+}
+
+
+static void filterChannel(coded_channel_t * c, const aacRate_t * rate)
+{
+	const aacIcsInfo_t * info = &c->info;
+	bool eightShort = (info->windowSequence == EIGHT_SHORT_SEQUENCE);
+	uint8_t maxBand = eightShort ? rate->tnsShortBands : rate->tnsLongBands;
+
+	if (!c->tns)
+	{
+		return;
+	}
+	maxBand = (info->maxSfb < maxBand) ? info->maxSfb : maxBand;
+
+	for (uint32_t win = 0; win < (eightShort ? AAC_SHORT_WINDOWS : 1); win++)
+	{
+		const tns_window_t * t = &c->tnsWindows[win];
+		double * x = &c->values[win * AAC_SHORT_HALF];
+		int32_t top = info->bands;
+
+		for (uint32_t f = 0; f < t->filters; f++)
+		{
+			const tns_filter_t * filter = &t->filter[f];
+			int32_t bottom = (top - filter->length > 0) ? top - filter->length : 0;
+			uint32_t order = filter->order;
+
+			if (order)
+			{
+				double a[AAC_TNS_MAX_ORDER + 1];
+				stepUp(filter, t->resolution, a);
+
+				uint32_t start = info->swbOffset[(bottom < maxBand) ? bottom : maxBand];
+				uint32_t end = info->swbOffset[(top < maxBand) ? top : maxBand];
+				double y[AAC_LONG_HALF];
+				for (uint32_t n = 0; n < end - start; n++)
+				{
+					uint32_t k = filter->downward ? end - 1 - n : start + n;
+					double value = x[k];
+					for (uint32_t i = 1; (i <= order) && (i <= n); i++)
+					{
+						value -= a[i] * y[n - i];
+					}
+					y[n] = value;
+					x[k] = value;
+				}
+			}
+			top = bottom;
+		}
+	}
+}
+
+
+/*
+ * Window and overlap of a channel as the specification does them, added to the mixes. cancelGain is the gain of
+ * the channel with center cancel on.
+ */
+static void synthesizeChannel(const coded_channel_t * c, uint8_t ch, double * mix, double * mixCancel,
+							  double cancelGain)
+{
+	const aacIcsInfo_t * info = &c->info;
+	uint8_t shape = info->windowShape;
+	uint8_t previous = previousShapes[ch];
+	double x[2 * AAC_LONG_HALF];
+	double y[2 * AAC_LONG_HALF] = { 0 };
+
+	if (info->windowSequence == EIGHT_SHORT_SEQUENCE)
+	{
+		for (uint32_t w = 0; w < AAC_SHORT_WINDOWS; w++)
+		{
+			inverseMdct(&c->values[w * AAC_SHORT_HALF], x, AAC_SHORT_HALF);
+			for (uint32_t n = 0; n < 2 * AAC_SHORT_HALF; n++)
+			{
+				double window = referenceWindows[0][((n < AAC_SHORT_HALF) && !w) ? previous : shape][n];
+				y[AAC_SHORT_START + w * AAC_SHORT_HALF + n] += x[n] * window;
+			}
+		}
+	}
+	else
+	{
+		inverseMdct(c->values, x, AAC_LONG_HALF);
+		for (uint32_t n = 0; n < 2 * AAC_LONG_HALF; n++)
+		{
+			double window;
+
+			if ((n < AAC_LONG_HALF) && (info->windowSequence == LONG_STOP_SEQUENCE))
+			{
+				window = (n < AAC_SHORT_START) ? 0 : ((n < AAC_SHORT_START + AAC_SHORT_HALF) ?
+						 referenceWindows[0][previous][n - AAC_SHORT_START] : 1);
+			}
+			else if (n < AAC_LONG_HALF)
+			{
+				window = referenceWindows[1][previous][n];
+			}
+			else if (info->windowSequence == LONG_START_SEQUENCE)
+			{
+				uint32_t i = n - AAC_LONG_HALF;
+				window = (i < AAC_SHORT_START) ? 1 : ((i < AAC_SHORT_START + AAC_SHORT_HALF) ?
+						 referenceWindows[0][shape][i - AAC_SHORT_START + AAC_SHORT_HALF] : 0);
+			}
+			else
+			{
+				window = referenceWindows[1][shape][n];
+			}
+			y[n] = x[n] * window;
+		}
+	}
+	previousShapes[ch] = shape;
+
+	for (uint32_t n = 0; n < AAC_LONG_HALF; n++)
+	{
+		double value = referenceOverlap[ch][n] + y[n];
+		mix[n] += value;
+		mixCancel[n] += cancelGain * value;
+		referenceOverlap[ch][n] = y[AAC_LONG_HALF + n];
+	}
+}
+
+
+/*
+ * A raw data block: a single channel or a channel pair element, sometimes fill and data elements after it. The
+ * values the decoder must get are left in coded[].
+ */
+static void encodeFrame(const aac_file_t * file, const aacRate_t * rate, uint8_t * sequences, bit_writer_t * w)
+{
+	if (file->channels == 1)
+	{
+		sequences[0] = nextSequence(sequences[0]);
+		makeInfo(rate, sequences[0], &coded[0]);
+		makeChannel(file, &coded[0], (sequences[0] == EIGHT_SHORT_SEQUENCE) ? SHORT_LEVEL : LEVEL, false);
+
+		putBits(w, ID_SCE, 3);
+		putBits(w, randomBelow(16), 4);
+		putChannel(w, &coded[0], false);
+
+		dequantizeChannel(&coded[0]);
+		filterChannel(&coded[0], rate);
+	}
+	else
+	{
+		bool common = !(file->options & UNCOMMON_WINDOWS) || chance(75);
+		uint8_t used[AAC_SHORT_WINDOWS][AAC_MAX_SFB] = { { 0 } };
+		uint8_t mask = 0;
+
+		sequences[0] = nextSequence(sequences[0]);
+		sequences[1] = common ? sequences[0] : nextSequence(sequences[1]);
+		makeInfo(rate, sequences[0], &coded[0]);
+		if (common)
+		{
+			coded[1].info = coded[0].info;
+			coded[1].grouping = coded[0].grouping;
+		}
+		else
+		{
+			makeInfo(rate, sequences[1], &coded[1]);
+		}
+		makeChannel(file, &coded[0], (sequences[0] == EIGHT_SHORT_SEQUENCE) ? SHORT_LEVEL : LEVEL, false);
+		makeChannel(file, &coded[1], (sequences[1] == EIGHT_SHORT_SEQUENCE) ? SHORT_LEVEL : LEVEL,
+					common && (file->options & USE_INTENSITY));
+
+		putBits(w, ID_CPE, 3);
+		putBits(w, randomBelow(16), 4);
+		putBits(w, common, 1);
+		if (common)
+		{
+			static const uint8_t masks[] = { 0, 1, 1, 2 };
+
+			putInfo(w, &coded[0]);
+			mask = (file->options & USE_MS) ? masks[randomBelow(sizeof(masks))] : 0;
+
+			// Mid/side noise is correlated noise, which the decoder does not make: per band, never on two noise ones
+			mask = ((mask == 2) && (file->options & USE_NOISE)) ? 1 : mask;
+			putBits(w, mask, 2);
+			for (uint8_t g = 0; (mask == 1) && (g < coded[0].info.groups); g++)
+			{
+				for (uint8_t sfb = 0; sfb < coded[0].info.maxSfb; sfb++)
+				{
+					used[g][sfb] = randomBelow(2);
+					if ((coded[0].books[g][sfb] == NOISE_HCB) && (coded[1].books[g][sfb] == NOISE_HCB))
+					{
+						used[g][sfb] = 0;
+					}
+					putBits(w, used[g][sfb], 1);
+				}
+			}
+		}
+		putChannel(w, &coded[0], common);
+		putChannel(w, &coded[1], common);
+
+		dequantizeChannel(&coded[0]);
+		dequantizeChannel(&coded[1]);
+		if (common)
+		{
+			stereoChannels(&coded[0], &coded[1], mask, used);
+		}
+		filterChannel(&coded[0], rate);
+		filterChannel(&coded[1], rate);
+	}
+
+	if ((file->options & USE_EXTRA) && chance(30))
+	{
+		static const uint32_t counts[] = { 3, 14, 15, 40 };
+		uint32_t count = counts[randomBelow(4)];
+
+		putBits(w, ID_FIL, 3);
+		putBits(w, (count < 15) ? count : 15, 4);
+		if (count >= 15)
+		{
+			putBits(w, count - 14, 8);
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			putBits(w, randomBelow(256), 8);
+		}
+	}
+
+	if ((file->options & USE_EXTRA) && chance(30))
+	{
+		static const uint32_t counts[] = { 0, 5, 255, 300 };
+		uint32_t count = counts[randomBelow(4)];
+		bool align = randomBelow(2);
+
+		putBits(w, ID_DSE, 3);
+		putBits(w, 0, 4);
+		putBits(w, align, 1);
+		putBits(w, (count < 255) ? count : 255, 8);
+		if (count >= 255)
+		{
+			putBits(w, count - 255, 8);
+		}
+		if (align)
+		{
+			alignBits(w);
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			putBits(w, randomBelow(256), 8);
+		}
+	}
+
+	putBits(w, ID_END, 3);
+	alignBits(w);
+}
+
+
+static void putAudioSpecificConfig(byte_buffer_t * b, const aac_file_t * file, const aacRate_t * rate)
+{
+	bit_writer_t w = { 0 };
+
+	putBits(&w, (file->options & HE_AAC_CONFIG) ? AAC_OBJECT_SBR : AAC_OBJECT_LC, 5);
+	if (file->options & EXPLICIT_RATE)
+	{
+		putBits(&w, 15, 4);
+		putBits(&w, rate->sampleRate, 24);
+	}
+	else
+	{
+		putBits(&w, file->rateIndex, 4);
+	}
+	putBits(&w, file->channels, 4);
+	if (file->options & HE_AAC_CONFIG)
+	{
+		// The rate of the SBR output, twice the core's, then the core object
+		putBits(&w, (file->rateIndex > 3) ? file->rateIndex - 3 : 3, 4);
+		putBits(&w, AAC_OBJECT_LC, 5);
+	}
+
+	// GASpecificConfig: 1024 samples, no core coder, no extension
+	putBits(&w, 0, 3);
+	alignBits(&w);
+
+	putBytes(b, w.data, w.bits >> 3);
+	free(w.data);
+}
+
+
+static void putEsds(byte_buffer_t * b, const aac_file_t * file, const aacRate_t * rate)
+{
+	uint32_t esds = beginFullBox(b, "esds", 0, 0);
+	uint32_t es = beginDescriptor(b, 3);
+
+	putNumber(b, 1, 2);
+	putNumber(b, (file->options & ES_FLAGS) ? 0xE0 : 0, 1);
+	if (file->options & ES_FLAGS)
+	{
+		putNumber(b, 7, 2);
+		putNumber(b, 5, 1);
+		putBytes(b, "abcde", 5);
+		putNumber(b, 9, 2);
+	}
+
+	uint32_t config = beginDescriptor(b, 4);
+	putNumber(b, 0x40, 1);				// MPEG-4 audio
+	putNumber(b, 0x15, 1);
+	putNumber(b, 0x1800, 3);
+	putNumber(b, 128000, 4);
+	putNumber(b, 128000, 4);
+	uint32_t specific = beginDescriptor(b, 5);
+	putAudioSpecificConfig(b, file, rate);
+	endDescriptor(b, specific);
+	endDescriptor(b, config);
+
+	uint32_t sl = beginDescriptor(b, 6);
+	putNumber(b, 2, 1);
+	endDescriptor(b, sl);
+
+	endDescriptor(b, es);
+	endBox(b, esds);
+}
+
+
+static void putHandler(byte_buffer_t * b, const char * type, const char * name)
+{
+	uint32_t hdlr = beginFullBox(b, "hdlr", 0, 0);
+
+	putNumber(b, 0, 4);
+	putBytes(b, type, 4);
+	putBytes(b, NULL, 12);
+	putBytes(b, name, strlen(name) + 1);
+	endBox(b, hdlr);
+}
+
+
+static void putMediaHeader(byte_buffer_t * b, uint32_t timescale, uint32_t duration)
+{
+	uint32_t mdhd = beginFullBox(b, "mdhd", 0, 0);
+
+	putNumber(b, 0, 4);
+	putNumber(b, 0, 4);
+	putNumber(b, timescale, 4);
+	putNumber(b, duration, 4);
+	putNumber(b, 0, 4);
+	endBox(b, mdhd);
+}
+
+
+static void putItem(byte_buffer_t * b, const char * type, uint32_t dataType, const void * value, uint32_t length)
+{
+	uint32_t item = beginBox(b, type);
+	uint32_t data = beginBox(b, "data");
+
+	putNumber(b, dataType, 4);
+	putNumber(b, 0, 4);
+	putBytes(b, value, length);
+	endBox(b, data);
+	endBox(b, item);
+}
+
+
+static void putTags(byte_buffer_t * b, const aac_file_t * file)
+{
+	static const uint8_t track[] = { 0, 0, 0, 12, 0, 15, 0, 0 };
+	char album[ALBUM_LENGTH];
+
+	// QuickTime's meta is a plain box, MP4's a full one
+	uint32_t udta = beginBox(b, "udta");
+	uint32_t meta = (file->options & QUICKTIME) ? beginBox(b, "meta") : beginFullBox(b, "meta", 0, 0);
+	uint32_t hdlr = beginFullBox(b, "hdlr", 0, 0);
+	putNumber(b, 0, 4);
+	putBytes(b, "mdirappl", 8);
+	putBytes(b, NULL, 9);
+	endBox(b, hdlr);
+
+	memset(album, 'A', sizeof(album));
+	uint32_t ilst = beginBox(b, "ilst");
+	putItem(b, "\251nam", 1, TITLE, strlen(TITLE));
+	putItem(b, "\251ART", 1, ARTIST, strlen(ARTIST));
+	putItem(b, "cpil", 21, "", 1);
+	putItem(b, "\251alb", 1, album, sizeof(album));
+	putItem(b, "\251day", 1, YEAR, strlen(YEAR));
+	putItem(b, "trkn", 0, track, sizeof(track));
+	endBox(b, ilst);
+
+	endBox(b, meta);
+	endBox(b, udta);
+}
+
+
+/*
+ * The moov box. The chunks start at chunkOffsets from mdatStart, the file offset of the contents of mdat.
+ */
+static void putMovie(byte_buffer_t * b, const aac_file_t * file, const uint32_t * sizes, uint32_t fixedSize,
+					 const uint32_t * chunkOffsets, const uint32_t * chunkFrames, uint32_t chunkCount, uint32_t mdatStart)
+{
+	const aacRate_t * rate = &rates[file->rateIndex - AAC_FIRST_RATE_INDEX];
+	uint32_t timescale = file->mediaTimescale ? file->mediaTimescale : rate->sampleRate;
+	uint32_t duration = (uint64_t)file->frames * AAC_FRAME_LENGTH * timescale / rate->sampleRate;
+	uint32_t moov = beginBox(b, "moov");
+
+	uint32_t mvhd = beginFullBox(b, "mvhd", 0, 0);
+	putNumber(b, 0, 4);
+	putNumber(b, 0, 4);
+	putNumber(b, MOVIE_TIMESCALE, 4);
+	putNumber(b, 1000, 4);
+	putBytes(b, NULL, 80);
+	endBox(b, mvhd);
+
+	// A video track first, to be left out
+	uint32_t trak = beginBox(b, "trak");
+	uint32_t tkhd = beginFullBox(b, "tkhd", 0, 7);
+	putBytes(b, NULL, 80);
+	endBox(b, tkhd);
+	uint32_t mdia = beginBox(b, "mdia");
+	putMediaHeader(b, timescale, duration);
+	putHandler(b, "vide", "");
+	endBox(b, mdia);
+	endBox(b, trak);
+
+	trak = beginBox(b, "trak");
+	tkhd = beginFullBox(b, "tkhd", 0, 7);
+	putBytes(b, NULL, 80);
+	endBox(b, tkhd);
+
+	if (file->editLength)
+	{
+		uint32_t edts = beginBox(b, "edts");
+		uint64_t length = (uint64_t)file->editLength * MOVIE_TIMESCALE / rate->sampleRate;
+		uint64_t start = (uint64_t)file->editStart * timescale / rate->sampleRate;
+		uint32_t elst = beginFullBox(b, "elst", (file->options & EMPTY_EDIT) ? 1 : 0, 0);
+
+		if (file->options & EMPTY_EDIT)
+		{
+			putNumber(b, 2, 4);
+			putNumber(b, 30, 8);
+			putNumber(b, (uint64_t)-1, 8);
+			putNumber(b, 0x10000, 4);
+			putNumber(b, length, 8);
+			putNumber(b, start, 8);
+		}
+		else
+		{
+			putNumber(b, 1, 4);
+			putNumber(b, length, 4);
+			putNumber(b, start, 4);
+		}
+		putNumber(b, 0x10000, 4);
+		endBox(b, elst);
+		endBox(b, edts);
+	}
+
+	mdia = beginBox(b, "mdia");
+	putMediaHeader(b, timescale, duration);
+	putHandler(b, "soun", "snd");
+	uint32_t minf = beginBox(b, "minf");
+	uint32_t smhd = beginFullBox(b, "smhd", 0, 0);
+	putNumber(b, 0, 4);
+	endBox(b, smhd);
+	uint32_t dinf = beginBox(b, "dinf");
+	uint32_t dref = beginFullBox(b, "dref", 0, 0);
+	putNumber(b, 0, 4);
+	endBox(b, dref);
+	endBox(b, dinf);
+
+	uint32_t stbl = beginBox(b, "stbl");
+	uint32_t stsd = beginFullBox(b, "stsd", 0, 0);
+	putNumber(b, 1, 4);
+	uint32_t mp4a = beginBox(b, "mp4a");
+	putBytes(b, NULL, 6);
+	putNumber(b, 1, 2);					// Data reference
+	putNumber(b, (file->options & QUICKTIME) ? 1 : 0, 2);
+	putNumber(b, 0, 2);
+	putNumber(b, 0, 4);
+	putNumber(b, file->channels, 2);
+	putNumber(b, 16, 2);
+	putNumber(b, 0, 2);
+	putNumber(b, 0, 2);
+	putNumber(b, (rate->sampleRate & 0xFFFF) << 16, 4);
+	if (file->options & QUICKTIME)
+	{
+		// Version 1 sound description, the esds inside a wave box
+		putBytes(b, NULL, 16);
+		uint32_t wave = beginBox(b, "wave");
+		uint32_t frma = beginBox(b, "frma");
+		putBytes(b, "mp4a", 4);
+		endBox(b, frma);
+		putEsds(b, file, rate);
+		endBox(b, beginBox(b, "\0\0\0\0"));
+		endBox(b, wave);
+	}
+	else
+	{
+		putEsds(b, file, rate);
+	}
+	endBox(b, mp4a);
+	endBox(b, stsd);
+
+	uint32_t stts = beginFullBox(b, "stts", 0, 0);
+	putNumber(b, 1, 4);
+	putNumber(b, file->frames, 4);
+	putNumber(b, AAC_FRAME_LENGTH, 4);
+	endBox(b, stts);
+
+	// A run per change in frames per chunk
+	uint32_t stsc = beginFullBox(b, "stsc", 0, 0);
+	uint32_t countAt = b->size;
+	uint32_t runCount = 0;
+	putNumber(b, 0, 4);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		if (!chunk || (chunkFrames[chunk] != chunkFrames[chunk - 1]))
+		{
+			putNumber(b, chunk + 1, 4);
+			putNumber(b, chunkFrames[chunk], 4);
+			putNumber(b, 1, 4);
+			runCount++;
+		}
+	}
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		b->data[countAt + i] = (uint8_t)(runCount >> (24 - 8 * i));
+	}
+	endBox(b, stsc);
+
+	uint32_t stsz = beginFullBox(b, "stsz", 0, 0);
+	putNumber(b, fixedSize, 4);
+	putNumber(b, file->frames, 4);
+	for (uint32_t f = 0; !fixedSize && (f < file->frames); f++)
+	{
+		putNumber(b, sizes[f], 4);
+	}
+	endBox(b, stsz);
+
+	uint32_t stco = beginFullBox(b, (file->options & CO64) ? "co64" : "stco", 0, 0);
+	putNumber(b, chunkCount, 4);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		putNumber(b, mdatStart + chunkOffsets[chunk], (file->options & CO64) ? 8 : 4);
+	}
+	endBox(b, stco);
+
+	endBox(b, stbl);
+	endBox(b, minf);
+	endBox(b, mdia);
+	endBox(b, trak);
+
+	if (file->options & USE_TAGS)
+	{
+		putTags(b, file);
+	}
+	endBox(b, moov);
+}
+
+
+/*
+ * Encodes the file into *out, returns its size. Leaves what the decoder must give in reference and referenceCancel.
+ */
+static uint32_t encode(const aac_file_t * file, uint8_t ** out)
+{
+	const aacRate_t * rate = &rates[file->rateIndex - AAC_FIRST_RATE_INDEX];
+	uint32_t samples = file->frames * AAC_FRAME_LENGTH;
+	byte_buffer_t frames = { 0 };
+	uint32_t * sizes = malloc(file->frames * sizeof(uint32_t));
+	double * mix = calloc(samples, sizeof(double));
+	double * mixCancel = calloc(samples, sizeof(double));
+	uint8_t sequences[AAC_MAX_CHANNELS] = { ONLY_LONG_SEQUENCE, ONLY_LONG_SEQUENCE };
+	uint32_t fixedSize = 0;
+
+	referenceNoise = 1;
+	memset(referenceOverlap, 0, sizeof(referenceOverlap));
+	memset(previousShapes, 0, sizeof(previousShapes));
+
+	for (uint32_t f = 0; f < file->frames; f++)
+	{
+		bit_writer_t w = { 0 };
+
+		// Frames longer than the decoder takes are made again, from the same noise and window sequences
+		while (true)
+		{
+			uint32_t savedNoise = referenceNoise;
+			uint8_t savedSequences[AAC_MAX_CHANNELS] = { sequences[0], sequences[1] };
+
+			encodeFrame(file, rate, sequences, &w);
+			if ((w.bits >> 3) <= MAX_CHANNEL_BYTES * file->channels)
+			{
+				break;
+			}
+
+			free(w.data);
+			memset(&w, 0, sizeof(w));
+			referenceNoise = savedNoise;
+			sequences[0] = savedSequences[0];
+			sequences[1] = savedSequences[1];
+		}
+
+		for (uint8_t ch = 0; ch < file->channels; ch++)
+		{
+			double cancelGain = (file->channels == 2) ? (ch ? -0.5 : 0.5) : 1;
+			synthesizeChannel(&coded[ch], ch, &mix[f * AAC_FRAME_LENGTH], &mixCancel[f * AAC_FRAME_LENGTH],
+							  cancelGain);
+		}
+
+		sizes[f] = w.bits >> 3;
+		fixedSize = (sizes[f] > fixedSize) ? sizes[f] : fixedSize;
+		putBytes(&frames, w.data, sizes[f]);
+		free(w.data);
+	}
+	fixedSize = (file->options & FIXED_SIZE) ? fixedSize : 0;
+
+	reference = malloc(samples * sizeof(int16_t));
+	referenceCancel = malloc(samples * sizeof(int16_t));
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		reference[i] = toPcm(mix[i]);
+		referenceCancel[i] = toPcm(mixCancel[i]);
+	}
+	free(mix);
+	free(mixCancel);
+
+	// Chunks of 5 frames, then 3 and from the 20th chunk on 7, with junk before each one
+	byte_buffer_t mdat = { 0 };
+	uint32_t * chunkOffsets = malloc(file->frames * sizeof(uint32_t));
+	uint32_t * chunkFrames = malloc(file->frames * sizeof(uint32_t));
+	uint32_t chunkCount = 0;
+	uint32_t frameOffset = 0;
+	for (uint32_t f = 0; f < file->frames; chunkCount++)
+	{
+		uint32_t count = (chunkCount == 0) ? 5 : ((chunkCount < 20) ? 3 : 7);
+		count = (count < file->frames - f) ? count : file->frames - f;
+
+		uint32_t junk = randomBelow(MAX_JUNK + 1);
+		for (uint32_t i = 0; i < junk; i++)
+		{
+			putNumber(&mdat, randomBelow(256), 1);
+		}
+
+		chunkOffsets[chunkCount] = mdat.size;
+		chunkFrames[chunkCount] = count;
+		for (uint32_t i = 0; i < count; i++, f++)
+		{
+			putBytes(&mdat, &frames.data[frameOffset], sizes[f]);
+			putBytes(&mdat, NULL, fixedSize ? fixedSize - sizes[f] : 0);
+			frameOffset += sizes[f];
+		}
+	}
+
+	byte_buffer_t b = { 0 };
+	uint32_t ftyp = beginBox(&b, "ftyp");
+	putBytes(&b, "M4A ", 4);
+	putNumber(&b, 0, 4);
+	putBytes(&b, "M4A mp42isom", 12);
+	endBox(&b, ftyp);
+
+	if (file->options & MOOV_LAST)
+	{
+		uint32_t box = beginBox(&b, "free");
+		putBytes(&b, NULL, 33);
+		endBox(&b, box);
+
+		box = beginBox(&b, "mdat");
+		uint32_t mdatStart = b.size;
+		putBytes(&b, mdat.data, mdat.size);
+		endBox(&b, box);
+
+		putMovie(&b, file, sizes, fixedSize, chunkOffsets, chunkFrames, chunkCount, mdatStart);
+	}
+	else
+	{
+		// The size of moov does not depend on where mdat is
+		byte_buffer_t probe = { 0 };
+		putMovie(&probe, file, sizes, fixedSize, chunkOffsets, chunkFrames, chunkCount, 0);
+		uint32_t mdatStart = b.size + probe.size + 41 + 8;
+		free(probe.data);
+
+		putMovie(&b, file, sizes, fixedSize, chunkOffsets, chunkFrames, chunkCount, mdatStart);
+
+		uint32_t box = beginBox(&b, "free");
+		putBytes(&b, NULL, 33);
+		endBox(&b, box);
+
+		box = beginBox(&b, "mdat");
+		putBytes(&b, mdat.data, mdat.size);
+		endBox(&b, box);
+	}
+
+	free(frames.data);
+	free(mdat.data);
+	free(sizes);
+	free(chunkOffsets);
+	free(chunkFrames);
+
+	*out = b.data;
+	return b.size;
+}
+
+
+// Samples the decoder must give: after the edit list, whose length is in the movie timescale
+static uint32_t songSamples(const aac_file_t * file)
+{
+	const aacRate_t * rate = &rates[file->rateIndex - AAC_FIRST_RATE_INDEX];
+	uint32_t samples = file->frames * AAC_FRAME_LENGTH - file->editStart;
+
+	if (file->editLength)
+	{
+		uint64_t length = (uint64_t)file->editLength * MOVIE_TIMESCALE / rate->sampleRate;
+		length = length * rate->sampleRate / MOVIE_TIMESCALE;
+		samples = (length < samples) ? length : samples;
+	}
+	return samples;
+}
+
+
+static void check(int ok, const aac_file_t * file, const aac_run_t * run, const char * what, long value)
+{
+	printf("%-5s %-13s cc %u seek %6d: %-24s %ld\n", ok ? "ok" : "FAIL", file->name,
+		   run->centerCancel, run->seek, what, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+static void checkTag(const aac_file_t * file, const aac_run_t * run, audio_tag_t tag, const char * expected,
+					 const char * what)
+{
+	char * value;
+	check(aacCodec.getTag(tag, &value) && !strcmp(value, expected), file, run, what, 0);
+}
+
+
+static void play(const aac_file_t * file, const aac_run_t * run, const uint8_t * data, uint32_t size)
+{
+	const int16_t * expected = (run->centerCancel ? referenceCancel : reference) + file->editStart;
+	const aacRate_t * rate = &rates[file->rateIndex - AAC_FIRST_RATE_INDEX];
+	uint32_t songLength = songSamples(file);
+	short output[OUTPUT_SIZE];
+	uint32_t samples;
+	int sampleRate;
+	uint32_t frame = 0;
+	uint32_t calls = 0;
+	long largest = 0;
+
+	DecoderHost_SetFile(data, size);
+	AacDecoder_Init();
+	aacCodec.setCenterCancel(run->centerCancel);
+
+	// The reference noise started from the decoder's first state
+	noiseState = 1;
+
+	if (!AacDecoder_LoadFile(DECODER_PLAYING_STREAM, "test.m4a"))
+	{
+		check(0, file, run, "opened", 0);
+		return;
+	}
+
+	if (!run->centerCancel && !run->seek && (file->options & USE_TAGS))
+	{
+		char album[AAC_TAG_SIZE];
+		memset(album, 'A', sizeof(album) - 1);
+		album[sizeof(album) - 1] = '\0';
+
+		checkTag(file, run, AUDIO_TAG_TITLE, TITLE, "title");
+		checkTag(file, run, AUDIO_TAG_ARTIST, ARTIST, "artist");
+		checkTag(file, run, AUDIO_TAG_ALBUM, album, "album, cut");
+		checkTag(file, run, AUDIO_TAG_YEAR, YEAR, "year");
+		checkTag(file, run, AUDIO_TAG_TRACK_NUM, TRACK, "track");
+	}
+	if (!run->centerCancel && !run->seek)
+	{
+		uint32_t expectedMs = (uint32_t)((uint64_t)songLength * 1000 / rate->sampleRate);
+		check(aacCodec.getRemainingMs() == expectedMs, file, run, "length, ms", aacCodec.getRemainingMs());
+	}
+
+	while (AacDecoder_DecodeFrame(DECODER_PLAYING_STREAM, output, OUTPUT_SIZE, &samples, &sampleRate) == DECODER_WORKED)
+	{
+		for (uint32_t i = 0; i < samples; i++, frame++)
+		{
+			long difference = (frame < songLength) ? labs((long)output[i] - expected[frame]) : 0;
+			largest = (difference > largest) ? difference : largest;
+		}
+
+		calls++;
+		if (calls % READ_AHEAD_EVERY == 0)
+		{
+			AacDecoder_ReadAhead();
+		}
+		if (run->seek && (calls % run->seekEvery == 0) && ((int64_t)frame + run->seek < songLength))
+		{
+			int64_t target = (int64_t)frame + run->seek;
+			if (!aacCodec.seek(run->seek))
+			{
+				check(0, file, run, "seek", (long)target);
+				break;
+			}
+			frame = (target < 0) ? 0 : (uint32_t)target;
+		}
+	}
+
+	long allowed = (file->options & STRONG) ? MAX_DIFFERENCE_STRONG : MAX_DIFFERENCE;
+	check(largest <= allowed, file, run, "largest difference, LSB", largest);
+	check(frame == songLength, file, run, "samples, to the end", frame);
+	check(DecoderHost_UnalignedReads() == 0, file, run, "reads through the window", DecoderHost_UnalignedReads());
+
+	AacDecoder_Close(DECODER_PLAYING_STREAM);
+}
+
+
+int main(void)
+{
+	checkTables();
+	makeWindows();
+	makeCosines();
+
+	for (uint32_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+	{
+		const aac_file_t * file = &files[f];
+		uint8_t * data;
+
+		randomState = file->seed;
+		uint32_t size = encode(file, &data);
+
+		for (uint32_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+		{
+			// The noise of a frame comes from every one decoded before it
+			if (!runs[r].seek || !(file->options & USE_NOISE))
+			{
+				play(file, &runs[r], data, size);
+			}
+		}
+
+		free(data);
+		free(reference);
+		free(referenceCancel);
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,538 @@
+/*******************************************************************************
+  @file     adpcm_test.c
+  @brief    Host check of the IMA and MS ADPCM decoding of the WAV codec against an encoder
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -Icomponent/fatfs -Isource/drivers/HAL -Itests/host tests/host/adpcm_test.c tests/host/decoder_host.c \
+ *       source/drivers/HAL/wav_decoder.c -lm -o adpcm_test
+ *   ./adpcm_test
+ *
+ * Two tones are encoded here, block by block, into IMA (0x0011) and MS (0x0002) ADPCM files. The encoder
+ * keeps what a decoder must rebuild from each code, and the WAV codec has to give exactly that back:
+ * - Mono and stereo, a short last block, blocks up to 2 KB.
+ * - MS with the coefficients in the fmt chunk (not the standard ones) and without them.
+ * - Center cancel, (L - R) / 2.
+ * - Seeks, which land on the start of the block the target is in.
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wav_decoder.h"
+#include "decoder_host.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define RATE			(22050U)
+#define OUTPUT_SIZE		(2304U)
+#define READ_AHEAD_EVERY	(3)
+#define SEEK_EVERY		(5)
+
+#define FORMAT_MS		(0x0002)
+#define FORMAT_IMA		(0x0011)
+
+#define IMA_HEADER		(4)			// Bytes per channel at the start of a block
+#define MS_HEADER		(7)
+#define MS_COEFS		(7)
+#define MS_MIN_DELTA	(16)
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	uint16_t format;
+	uint8_t channels;
+	uint16_t blockAlign;
+	uint32_t blocks;
+	uint32_t lastBytes;				// A last, shorter block of this many bytes, 0 for none
+	bool coefficients;				// MS: the fmt chunk has its own coefficients
+	bool centerCancel;
+	int32_t seek;
+} adpcm_case_t;
+
+typedef struct
+{
+	int32_t predicted;
+	int32_t index;
+} ima_state_t;
+
+typedef struct
+{
+	int32_t sample1;
+	int32_t sample2;
+	int32_t delta;
+	int32_t coef1;
+	int32_t coef2;
+} ms_state_t;
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static const adpcm_case_t cases[] =
+{
+	{FORMAT_IMA, 1,  512, 300,   0, false, false,     0},
+	{FORMAT_IMA, 2, 1024, 300, 300, false, false,     0},
+	{FORMAT_IMA, 2, 2048, 100,   0, false, true,      0},
+	{FORMAT_IMA, 1, 1024, 200,   0, false, false,  5000},
+	{FORMAT_IMA, 2,  512, 400,   0, false, false,  -700},
+	{FORMAT_MS,  1,  512, 300,   0, true,  false,     0},
+	{FORMAT_MS,  2, 1024, 300, 333, true,  false,     0},
+	{FORMAT_MS,  2, 2048, 100,   0, false, true,      0},
+	{FORMAT_MS,  1,  256, 500,   0, false, false,  3000},
+	{FORMAT_MS,  2,  512, 400, 100, true,  false,  -900},
+};
+
+static const int32_t imaSteps[89] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+	107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724,
+	796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026,
+	4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+	20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int32_t imaIndexSteps[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int32_t msAdapt[16] = {230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230};
+
+static const int32_t msStandardCoefs[MS_COEFS][2] =
+{
+	{256, 0}, {512, -256}, {0, 0}, {192, 64}, {240, 0}, {460, -208}, {392, -232}
+};
+
+// Written in the fmt chunk: not the standard ones, so using those instead would show
+static const int32_t msFileCoefs[MS_COEFS][2] =
+{
+	{256, 0}, {448, -192}, {128, 0}, {320, -64}, {200, 32}, {480, -224}, {384, -160}
+};
+
+static uint8_t * file;
+static uint32_t fileSize;
+static int16_t * reference;			// What the decoder must give back, interleaved
+static uint32_t referenceFrames;
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+static void write16(uint8_t * p, int32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+
+static void write32(uint8_t * p, uint32_t value)
+{
+	write16(p, value);
+	write16(&p[2], value >> 16);
+}
+
+
+static int32_t clamp16(int32_t value)
+{
+	return (value > 32767) ? 32767 : ((value < -32768) ? -32768 : value);
+}
+
+
+static int32_t signal(uint32_t frame, uint8_t channel)
+{
+	return (int32_t)(12000 * sin(frame * 0.03 * (channel + 1)) + 3000 * sin(frame * 0.7));
+}
+
+
+static uint32_t samplesPerBlock(const adpcm_case_t * test)
+{
+	if (test->format == FORMAT_IMA)
+	{
+		uint32_t dataBytes = test->blockAlign - IMA_HEADER * test->channels;
+		return 1 + ((test->channels == 1) ? (dataBytes * 2) : ((dataBytes / 8) * 8));
+	}
+
+	return 2 + (test->blockAlign - MS_HEADER * test->channels) * 2 / test->channels;
+}
+
+
+/*
+ * IMA code of a sample. The state ends as a decoder's after the code.
+ */
+static uint8_t imaEncode(ima_state_t * state, int32_t sample)
+{
+	int32_t step = imaSteps[state->index];
+	int32_t difference = sample - state->predicted;
+	int32_t decoded = step >> 3;
+	uint8_t code = 0;
+
+	if (difference < 0)
+	{
+		code = 8;
+		difference = -difference;
+	}
+	for (uint8_t bit = 4; bit; bit >>= 1, step >>= 1)
+	{
+		if (difference >= step)
+		{
+			code |= bit;
+			difference -= step;
+			decoded += step;
+		}
+	}
+
+	state->predicted = clamp16(state->predicted + ((code & 8) ? -decoded : decoded));
+	state->index += imaIndexSteps[code & 7];
+	state->index = (state->index < 0) ? 0 : ((state->index > 88) ? 88 : state->index);
+
+	return code;
+}
+
+
+/*
+ * MS code of a sample. The state ends as a decoder's after the code.
+ */
+static uint8_t msEncode(ms_state_t * state, int32_t sample)
+{
+	int32_t predicted = (state->sample1 * state->coef1 + state->sample2 * state->coef2) >> 8;
+	int32_t error = sample - predicted;
+	int32_t code = (error >= 0) ? ((error + state->delta / 2) / state->delta) : ((error - state->delta / 2) / state->delta);
+
+	code = (code > 7) ? 7 : ((code < -8) ? -8 : code);
+
+	state->sample2 = state->sample1;
+	state->sample1 = clamp16(predicted + code * state->delta);
+	state->delta = (msAdapt[code & 15] * state->delta) >> 8;
+	state->delta = (state->delta < MS_MIN_DELTA) ? MS_MIN_DELTA : state->delta;
+
+	return code & 15;
+}
+
+
+static void keep(int32_t sample)
+{
+	reference[referenceFrames++] = (int16_t)sample;
+}
+
+
+/*
+ * One IMA block of bytes at block, from frame on. Returns the frames in it.
+ */
+static uint32_t imaBlock(const adpcm_case_t * test, uint8_t * block, uint32_t bytes, uint32_t frame, ima_state_t * state)
+{
+	uint8_t channels = test->channels;
+	uint32_t dataBytes = bytes - IMA_HEADER * channels;
+	uint8_t * data = &block[IMA_HEADER * channels];
+	uint32_t first = frame;
+
+	// The first frame is in the header
+	for (uint8_t c = 0; c < channels; c++)
+	{
+		state[c].predicted = clamp16(signal(frame, c));
+		write16(&block[IMA_HEADER * c], state[c].predicted);
+		block[IMA_HEADER * c + 2] = state[c].index;
+		keep(state[c].predicted);
+	}
+	frame++;
+
+	if (channels == 1)
+	{
+		for (uint32_t i = 0; i < dataBytes; i++, frame += 2)
+		{
+			uint8_t low = imaEncode(&state[0], signal(frame, 0));
+			keep(state[0].predicted);
+			uint8_t high = imaEncode(&state[0], signal(frame + 1, 0));
+			keep(state[0].predicted);
+			*data++ = low | (high << 4);
+		}
+	}
+	else
+	{
+		// 4 bytes (8 samples) of the left channel, then 4 of the right
+		for (uint32_t group = 0; group < dataBytes / 8; group++, frame += 8)
+		{
+			int16_t decoded[8][2];
+
+			for (uint8_t c = 0; c < 2; c++)
+			{
+				for (uint8_t i = 0; i < 4; i++)
+				{
+					uint8_t low = imaEncode(&state[c], signal(frame + 2 * i, c));
+					decoded[2 * i][c] = state[c].predicted;
+					uint8_t high = imaEncode(&state[c], signal(frame + 2 * i + 1, c));
+					decoded[2 * i + 1][c] = state[c].predicted;
+					data[4 * c + i] = low | (high << 4);
+				}
+			}
+			data += 8;
+
+			for (uint8_t i = 0; i < 8; i++)
+			{
+				keep(decoded[i][0]);
+				keep(decoded[i][1]);
+			}
+		}
+	}
+
+	return frame - first;
+}
+
+
+/*
+ * One MS block, using predictor (index) for the first channel and the next one for the second.
+ */
+static uint32_t msBlock(const adpcm_case_t * test, uint8_t * block, uint32_t bytes, uint32_t frame, uint8_t predictor)
+{
+	const int32_t (*coefs)[2] = test->coefficients ? msFileCoefs : msStandardCoefs;
+	uint8_t channels = test->channels;
+	uint32_t dataBytes = bytes - MS_HEADER * channels;
+	uint8_t * data = &block[MS_HEADER * channels];
+	uint32_t first = frame;
+	ms_state_t state[2];
+
+	// The first two frames are in the header, the older one first
+	for (uint8_t c = 0; c < channels; c++)
+	{
+		uint8_t index = (predictor + c) % MS_COEFS;
+
+		state[c].coef1 = coefs[index][0];
+		state[c].coef2 = coefs[index][1];
+		state[c].delta = 20;
+		state[c].sample2 = clamp16(signal(frame, c));
+		state[c].sample1 = clamp16(signal(frame + 1, c));
+
+		block[c] = index;
+		write16(&block[channels + 2 * c], state[c].delta);
+		write16(&block[3 * channels + 2 * c], state[c].sample1);
+		write16(&block[5 * channels + 2 * c], state[c].sample2);
+	}
+	for (uint8_t c = 0; c < channels; c++)
+	{
+		keep(state[c].sample2);
+	}
+	for (uint8_t c = 0; c < channels; c++)
+	{
+		keep(state[c].sample1);
+	}
+	frame += 2;
+
+	// Two codes per byte, the high nibble first: two frames of mono, one of stereo
+	for (uint32_t i = 0; i < dataBytes; i++)
+	{
+		uint8_t high, low;
+
+		if (channels == 1)
+		{
+			high = msEncode(&state[0], signal(frame++, 0));
+			keep(state[0].sample1);
+			low = msEncode(&state[0], signal(frame++, 0));
+			keep(state[0].sample1);
+		}
+		else
+		{
+			high = msEncode(&state[0], signal(frame, 0));
+			low = msEncode(&state[1], signal(frame, 1));
+			keep(state[0].sample1);
+			keep(state[1].sample1);
+			frame++;
+		}
+		*data++ = (high << 4) | low;
+	}
+
+	return frame - first;
+}
+
+
+/*
+ * The file of the case, and the reference.
+ */
+static void build(const adpcm_case_t * test)
+{
+	uint8_t channels = test->channels;
+	uint32_t fmtBytes = ((test->format == FORMAT_MS) && test->coefficients) ? (20 + 2 + 4 * MS_COEFS) : 20;
+	uint32_t dataBytes = test->blocks * test->blockAlign + test->lastBytes;
+	uint32_t blockFrames = samplesPerBlock(test);
+	uint8_t * p;
+
+	fileSize = 12 + 8 + fmtBytes + 8 + dataBytes;
+	file = calloc(fileSize, 1);
+	reference = calloc((test->blocks + 1) * blockFrames * channels, sizeof(int16_t));
+	referenceFrames = 0;
+
+	p = file;
+	memcpy(p, "RIFF", 4);
+	write32(&p[4], fileSize - 8);
+	memcpy(&p[8], "WAVE", 4);
+	p += 12;
+
+	memcpy(p, "fmt ", 4);
+	write32(&p[4], fmtBytes);
+	write16(&p[8], test->format);
+	write16(&p[10], channels);
+	write32(&p[12], RATE);
+	write32(&p[16], RATE * test->blockAlign / blockFrames);
+	write16(&p[20], test->blockAlign);
+	write16(&p[22], 4);
+	write16(&p[24], fmtBytes - 18);
+	write16(&p[26], blockFrames);
+	if (fmtBytes > 20)
+	{
+		write16(&p[28], MS_COEFS);
+		for (uint8_t c = 0; c < MS_COEFS; c++)
+		{
+			write16(&p[30 + 4 * c], msFileCoefs[c][0]);
+			write16(&p[32 + 4 * c], msFileCoefs[c][1]);
+		}
+	}
+	p += 8 + fmtBytes;
+
+	memcpy(p, "data", 4);
+	write32(&p[4], dataBytes);
+	p += 8;
+
+	// IMA carries its step index from block to block
+	ima_state_t ima[2] = {{0, 0}, {0, 0}};
+	uint32_t frame = 0;
+
+	for (uint32_t b = 0; b <= test->blocks; b++)
+	{
+		uint32_t bytes = (b < test->blocks) ? test->blockAlign : test->lastBytes;
+		uint8_t * block = &p[b * test->blockAlign];
+
+		if (bytes == 0)
+		{
+			break;
+		}
+
+		frame += (test->format == FORMAT_IMA) ? imaBlock(test, block, bytes, frame, ima) : msBlock(test, block, bytes, frame, b);
+	}
+	referenceFrames /= channels;
+}
+
+
+static void check(int ok, const adpcm_case_t * test, const char * what, double value)
+{
+	printf("%-5s %s %u ch %4u bytes%s cc %u seek %5d: %-24s %.1f\n", ok ? "ok" : "FAIL",
+		   (test->format == FORMAT_IMA) ? "IMA" : "MS ", test->channels, test->blockAlign,
+		   test->lastBytes ? " +short" : "       ", test->centerCancel, test->seek, what, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+static void run(const adpcm_case_t * test)
+{
+	uint32_t blockFrames = samplesPerBlock(test);
+	short output[OUTPUT_SIZE];
+	uint32_t samples;
+	int rate;
+	uint32_t frame = 0;
+	uint32_t calls = 0;
+	long wrong = 0;
+
+	build(test);
+
+	// How far the encoder is from the tones, to see the files are not just noise
+	double energy = 0, error = 0;
+	for (uint32_t i = 0; i < referenceFrames * test->channels; i++)
+	{
+		double x = signal(i / test->channels, i % test->channels);
+		energy += x * x;
+		error += (x - reference[i]) * (x - reference[i]);
+	}
+	check(10 * log10(energy / error) > 20, test, "encoder SNR, dB", 10 * log10(energy / error));
+
+	DecoderHost_SetFile(file, fileSize);
+	WAVDecoder_Init();
+	wavCodec.setCenterCancel(test->centerCancel);
+
+	if (!WAVDecoder_LoadFile(DECODER_PLAYING_STREAM, "test.wav"))
+	{
+		check(0, test, "opened", 0);
+	}
+	else
+	{
+		// Counted in whole blocks, a short last one counts as whole
+		uint32_t expectedMs = (uint32_t)((uint64_t)referenceFrames * 1000 / RATE);
+		uint32_t blockMs = blockFrames * 1000 / RATE + 1;
+		uint32_t remaining = wavCodec.getRemainingMs();
+		check((remaining + 1 >= expectedMs) && (remaining <= expectedMs + blockMs), test, "length, ms", remaining);
+
+		while (WAVDecoder_DecodeFrame(DECODER_PLAYING_STREAM, output, OUTPUT_SIZE, &samples, &rate) == DECODER_WORKED)
+		{
+			uint8_t channels;
+			wavCodec.getChannels(DECODER_PLAYING_STREAM, &channels);
+
+			for (uint32_t i = 0; i < samples / channels; i++, frame++)
+			{
+				for (uint8_t c = 0; c < channels; c++)
+				{
+					int32_t expected = 0;
+
+					if (frame < referenceFrames)
+					{
+						expected = reference[frame * test->channels + c];
+						if ((channels == 1) && (test->channels == 2))
+						{
+							expected = (reference[frame * 2] - reference[frame * 2 + 1]) / 2;
+						}
+					}
+
+					if ((frame >= referenceFrames) || (output[i * channels + c] != expected))
+					{
+						wrong++;
+					}
+				}
+			}
+
+			calls++;
+			if (calls % READ_AHEAD_EVERY == 0)
+			{
+				WAVDecoder_ReadAhead();
+			}
+
+			// To the start of the block of the target
+			if (test->seek && (calls % SEEK_EVERY == 0) && ((int64_t)frame + test->seek < referenceFrames))
+			{
+				int64_t target = (int64_t)frame + test->seek;
+				wavCodec.seek(test->seek);
+				frame = ((target < 0) ? 0 : (uint32_t)target) / blockFrames * blockFrames;
+			}
+		}
+
+		check(wrong == 0, test, "samples off", wrong);
+		check(frame == referenceFrames, test, "frames, to the end", frame);
+		check(DecoderHost_UnalignedReads() == 0, test, "reads through the window", DecoderHost_UnalignedReads());
+
+		WAVDecoder_Close(DECODER_PLAYING_STREAM);
+	}
+
+	free(file);
+	free(reference);
+}
+
+
+int main(void)
+{
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		run(&cases[i]);
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+/*******************************************************************************
+  @file     center_cancel_test.c
+  @brief    Host check of helix's center-channel removal when the block types differ
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -include tests/host/helix_host.h -Icomponent/helix -Icomponent/helix/pub -Icomponent/helix/real \
+ *       tests/host/center_cancel_test.c component/helix/real/imdct.c component/helix/real/stproc.c \
+ *       component/helix/mp3tabs.c component/helix/real/trigtabs_fixpt.c -lm -o center_cancel_test
+ *   ./center_cancel_test
+ *
+ * Random stereo spectra, with the block type and mixed flag of each channel picked at random per
+ * granule, go through the same steps as Dequantize() and MP3Decode() with center-channel removal on:
+ * CenterCancelProc(), IMDCT() of channel 0 and CenterCancelIMDCT(). The reference is a second decoder
+ * that always transforms L/2 and R/2 apart and subtracts them. Both must agree to the rounding of the
+ * fixed point IMDCT, on the granules where the types differ and on the ones right after them.
+ * Exits with 1 if they do not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "coder.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define GRANULES		(4000)
+#define AMPLITUDE		(1 << 22)		// Dequantized spectra, well inside the guard bits helix expects
+#define MIN_SNR_DB		(90.0)
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	MP3DecInfo info;
+	FrameHeader fh;
+	SideInfo si;
+	HuffmanInfo hi;
+	IMDCTInfo mi;
+} decoder_t;
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static decoder_t reference;
+static decoder_t tested;
+
+static int left[MAX_NSAMP];
+static int right[MAX_NSAMP];
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+static void initDecoder(decoder_t * dec)
+{
+	memset(dec, 0, sizeof(*dec));
+
+	dec->info.FrameHeaderPS = &dec->fh;
+	dec->info.SideInfoPS = &dec->si;
+	dec->info.HuffmanInfoPS = &dec->hi;
+	dec->info.IMDCTInfoPS = &dec->mi;
+	dec->info.nChans = 2;
+	dec->info.centerCancel = 1;
+
+	dec->fh.ver = MPEG1;
+	dec->fh.sfBand = &sfBandTable[MPEG1][0];
+}
+
+
+static void setChannel(decoder_t * dec, int ch, const int * x, int shift)
+{
+	int i, mOut = 0;
+
+	for (i = 0; i < MAX_NSAMP; i++)
+	{
+		dec->hi.huffDecBuf[ch][i] = x[i] >> shift;
+		mOut |= FASTABS(dec->hi.huffDecBuf[ch][i]);
+	}
+
+	dec->hi.nonZeroBound[ch] = MAX_NSAMP;
+	dec->hi.gb[ch] = CLZ(mOut) - 1;
+}
+
+
+static void setBlock(decoder_t * dec, int gr, int ch, int blockType, int mixedBlock)
+{
+	dec->si.sis[gr][ch].blockType = blockType;
+	dec->si.sis[gr][ch].mixedBlock = mixedBlock;
+}
+
+
+int main(void)
+{
+	double signal = 0;
+	double error = 0;
+	double splitError = 0;
+	double afterError = 0;
+	int splits = 0;
+	int afters = 0;
+	int wasSplit = 0;
+
+	initDecoder(&reference);
+	initDecoder(&tested);
+	srand(1);
+
+	for (int n = 0; n < GRANULES; n++)
+	{
+		int gr = n & 1;
+		int types[2], mixed[2], mOut[2];
+
+		// Mostly the same block type in both channels, like real files, with runs where they differ
+		types[0] = rand() % 4;
+		mixed[0] = (types[0] == 2) && (rand() % 4 == 0);
+		types[1] = types[0];
+		mixed[1] = mixed[0];
+		if (rand() % 3 == 0)
+		{
+			types[1] = rand() % 4;
+			mixed[1] = (types[1] == 2) && (rand() % 4 == 0);
+		}
+		int blocksMatch = (types[0] == types[1]) && (mixed[0] == mixed[1]);
+
+		// A centered part (the vocals) and a different part in each channel
+		for (int i = 0; i < MAX_NSAMP; i++)
+		{
+			int center = (rand() % (2 * AMPLITUDE)) - AMPLITUDE;
+			left[i] = center + (rand() % AMPLITUDE) - AMPLITUDE / 2;
+			right[i] = center + (rand() % AMPLITUDE) - AMPLITUDE / 2;
+		}
+
+		for (int ch = 0; ch < 2; ch++)
+		{
+			setBlock(&reference, gr, ch, types[ch], mixed[ch]);
+			setBlock(&tested, gr, ch, types[ch], mixed[ch]);
+		}
+
+		// The reference: L/2 and R/2 always apart
+		setChannel(&reference, 0, left, 1);
+		setChannel(&reference, 1, right, 1);
+		IMDCT(&reference.info, gr, 0);
+		IMDCT(&reference.info, gr, 1);
+
+		// What Dequantize() and MP3Decode() do with center-channel removal on
+		setChannel(&tested, 0, left, 0);
+		setChannel(&tested, 1, right, 0);
+		mOut[0] = mOut[1] = 0;
+		CenterCancelProc(tested.hi.huffDecBuf, MAX_NSAMP, 0, blocksMatch, mOut);
+		tested.hi.gb[0] = CLZ(mOut[0]) - 1;
+		tested.hi.gb[1] = CLZ(mOut[1]) - 1;
+		tested.info.centerSplit = !blocksMatch;
+		IMDCT(&tested.info, gr, 0);
+		if (CenterCancelIMDCT(&tested.info, gr) < 0)
+		{
+			printf("FAIL  CenterCancelIMDCT() returned an error\n");
+			return 1;
+		}
+
+		double granuleSignal = 0;
+		double granuleError = 0;
+		for (int b = 0; b < BLOCK_SIZE; b++)
+		{
+			for (int i = 0; i < NBANDS; i++)
+			{
+				double exact = (double)reference.mi.outBuf[0][b][i] - reference.mi.outBuf[1][b][i];
+				double diff = tested.mi.outBuf[0][b][i] - exact;
+				granuleSignal += exact * exact;
+				granuleError += diff * diff;
+			}
+		}
+
+		signal += granuleSignal;
+		error += granuleError;
+		if (!blocksMatch)
+		{
+			splitError += granuleError / granuleSignal;
+			splits++;
+		}
+		else if (wasSplit)
+		{
+			afterError += granuleError / granuleSignal;
+			afters++;
+		}
+		wasSplit = !blocksMatch;
+	}
+
+	double snr = -10 * log10(error / signal);
+	double splitSnr = -10 * log10(splitError / splits);
+	double afterSnr = -10 * log10(afterError / afters);
+	int ok = (snr >= MIN_SNR_DB) && (splitSnr >= MIN_SNR_DB) && (afterSnr >= MIN_SNR_DB);
+
+	printf("%-5s SNR against L/2 - R/2 apart: %.1f dB overall, %.1f dB on %d split granules, "
+		   "%.1f dB on the %d right after one\n", ok ? "ok" : "FAIL", snr, splitSnr, splits, afterSnr, afters);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+/*******************************************************************************
+  @file     decoder_host.c
+  @brief    A file in memory in place of FatFs and the stream memory of audio_decoder, to run a codec on the PC
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ff.h"
+#include "audio_decoder.h"
+#include "decoder_host.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define SECTOR_SIZE		(512U)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static const uint8_t * fileData;
+static uint32_t fileSize;
+static uint32_t unalignedReads;
+
+static uint64_t streamMemory[2][AUDIO_DECODER_STREAM_SIZE / sizeof(uint64_t)];
+static uint64_t scratch[AUDIO_DECODER_SCRATCH_SIZE / sizeof(uint64_t)];
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+void DecoderHost_SetFile(const uint8_t * data, uint32_t size)
+{
+	fileData = data;
+	fileSize = size;
+	unalignedReads = 0;
+}
+
+
+uint8_t * DecoderHost_ReadFile(const char * path, uint32_t * size)
+{
+	FILE * file = fopen(path, "rb");
+	uint8_t * data = NULL;
+
+	if (file != NULL)
+	{
+		fseek(file, 0, SEEK_END);
+		*size = (uint32_t)ftell(file);
+		rewind(file);
+
+		data = malloc(*size ? *size : 1);
+		if ((data != NULL) && (fread(data, 1, *size, file) != *size))
+		{
+			free(data);
+			data = NULL;
+		}
+		fclose(file);
+	}
+
+	return data;
+}
+
+
+uint32_t DecoderHost_UnalignedReads(void)
+{
+	return unalignedReads;
+}
+
+
+FRESULT f_open(FIL * fp, const TCHAR * path, BYTE mode)
+{
+	memset(fp, 0, sizeof(*fp));
+	fp->obj.objsize = fileSize;
+	return (fileData != NULL) ? FR_OK : FR_NO_FILE;
+}
+
+
+FRESULT f_close(FIL * fp)
+{
+	return FR_OK;
+}
+
+
+FRESULT f_lseek(FIL * fp, FSIZE_t ofs)
+{
+	fp->fptr = ofs;
+	return FR_OK;
+}
+
+
+FRESULT f_read(FIL * fp, void * buff, UINT btr, UINT * br)
+{
+	uint32_t left = (fp->fptr < fileSize) ? (uint32_t)(fileSize - fp->fptr) : 0;
+	uint32_t count = (btr < left) ? btr : left;
+
+	if ((btr >= SECTOR_SIZE) && ((fp->fptr % SECTOR_SIZE) || (btr % SECTOR_SIZE) || ((uintptr_t)buff & 3)))
+	{
+		unalignedReads++;
+	}
+
+	if (count)
+	{
+		memcpy(buff, &fileData[fp->fptr], count);
+	}
+	fp->fptr += count;
+	*br = count;
+
+	return FR_OK;
+}
+
+
+void * AudioDecoder_GetStreamMemory(decoder_stream_t stream)
+{
+	return streamMemory[stream];
+}
+
+
+void * AudioDecoder_GetScratch(void)
+{
+	return scratch;
+}
@@ -0,0 +1,39 @@
+/*******************************************************************************
+  @file     decoder_host.h
+  @brief    A file in memory in place of FatFs and the stream memory of audio_decoder, to run a codec on the PC
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Built with the codec and its test (tests/host/decoder_host.c). Whatever name the codec opens,
+ * it gets the file given to DecoderHost_SetFile.
+ */
+#ifndef DECODER_HOST_H
+#define DECODER_HOST_H
+
+#include <stdint.h>
+
+
+/**
+ * @brief: The file every f_open opens from now on. It is not copied.
+ * @param data: its bytes.
+ * @param size: its length in bytes.
+ */
+void DecoderHost_SetFile(const uint8_t * data, uint32_t size);
+
+
+/**
+ * @brief: Reads a whole file of the PC, for the tests that take their inputs from disk.
+ * @param path: the file.
+ * @param size: here we store its length in bytes.
+ * @return: the bytes (malloc'd), NULL if it can't be read.
+ */
+uint8_t * DecoderHost_ReadFile(const char * path, uint32_t * size);
+
+
+/**
+ * @brief: Reads of a sector or more since DecoderHost_SetFile that did not start on a sector, were not
+ * whole sectors or went to a buffer that was not word aligned: FatFs would copy those through its window.
+ */
+uint32_t DecoderHost_UnalignedReads(void);
+
+#endif
@@ -0,0 +1,113 @@
+/*******************************************************************************
+  @file     eq_warp_test.c
+  @brief    Host check of EQ_SetSampleRate: the bands keep their response in Hz at 48 kHz
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -ffunction-sections -Wl,--gc-sections -DCPU_MK64FN1M0VLL12 -DARM_MATH_CM4 -D__FPU_PRESENT=1 \
+ *       -I. -ICMSIS -Idevice -Isource/equalizer tests/host/eq_warp_test.c -lm -o eq_warp_test
+ *   ./eq_warp_test
+ *
+ * equalizer.c is built into the test, the CMSIS-DSP sources are not in the tree: only the two biquad inits
+ * loadBand calls are given here, the filters are never run (--gc-sections drops what would run them).
+ *
+ * For every band and gain, the response of the coefficients moved to 48 kHz is compared in dB with the one
+ * of coeffTable at 44.1 kHz, from 20 Hz to 20 kHz. The table used as is at 48 kHz is shown for reference,
+ * every band ~9% higher. Exits with 1 if a moved band is further than MAX_ERROR_DB from the table anywhere
+ * (MAX_ERROR_TOP_DB for the top band: the allpass keeps the center where it was, not the width, and near
+ * the Nyquist frequency of the table its bands are squeezed).
+ */
+
+#include <stdio.h>
+#include <complex.h>
+#include "equalizer.c"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define TEST_RATE			(48000U)
+#define POINTS				(400)			// Log spaced, 20 Hz to 20 kHz
+#define MAX_ERROR_DB		(0.5)
+#define MAX_ERROR_TOP_DB	(1.2)
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+void arm_biquad_cas_df1_32x64_init_q31(arm_biquad_cas_df1_32x64_ins_q31 * S, uint8_t numStages,
+									   const q31_t * pCoeffs, q63_t * pState, uint8_t postShift)
+{
+}
+
+
+void arm_biquad_cascade_df1_init_q31(arm_biquad_casd_df1_inst_q31 * S, uint8_t numStages,
+									 const q31_t * pCoeffs, q31_t * pState, int8_t postShift)
+{
+}
+
+
+/*
+ * Gain of a cascade of CMSIS biquads {b0, b1, b2, a1, a2} in Q2.29 at frequency, dB.
+ */
+static double responseDb(const q31_t * coeffs, double frequency, double rate)
+{
+	double complex z1 = cexp(-2 * I * M_PI * frequency / rate);
+	double complex h = 1;
+
+	for (uint32_t stage = 0; stage < NUMBER_OF_STAGES; stage++)
+	{
+		const q31_t * c = &coeffs[stage * 5];
+		double complex b = (c[0] + c[1] * z1 + c[2] * z1 * z1) / COEF_SCALE;
+		double complex a = 1 - (c[3] * z1 + c[4] * z1 * z1) / COEF_SCALE;
+		h *= b / a;
+	}
+
+	return 20 * log10(cabs(h));
+}
+
+
+int main(void)
+{
+	int failures = 0;
+
+	EQ_Init();
+
+	printf("band  center  moved to 48 kHz, worst dB  table as is at 48 kHz, worst dB\n");
+
+	for (uint32_t band = 0; band < NUMBER_OF_BANDS; band++)
+	{
+		double worstMoved = 0;
+		double worstAsIs = 0;
+
+		for (int32_t gain = -MAX_GAIN; gain <= MAX_GAIN; gain++)
+		{
+			EQ_SetSampleRate(TABLE_RATE);
+			EQ_Set_Band_Gain(band + 1, gain);
+			EQ_SetSampleRate(TEST_RATE);
+
+			const q31_t * table = &coeffTable[COEF_PER_FILTER*GAIN_LEVELS*band + COEF_PER_FILTER*(gain + MAX_GAIN)];
+
+			for (uint32_t point = 0; point < POINTS; point++)
+			{
+				double frequency = 20 * pow(1000, (double)point / (POINTS - 1));
+				double reference = responseDb(table, frequency, TABLE_RATE);
+				double moved = fabs(responseDb(bandCoeffs[band], frequency, TEST_RATE) - reference);
+				double asIs = fabs(responseDb(table, frequency, TEST_RATE) - reference);
+
+				worstMoved = (moved > worstMoved) ? moved : worstMoved;
+				worstAsIs = (asIs > worstAsIs) ? asIs : worstAsIs;
+			}
+		}
+
+		int ok = (worstMoved <= ((band == NUMBER_OF_BANDS - 1) ? MAX_ERROR_TOP_DB : MAX_ERROR_DB));
+		printf("%-5s %4u %6.0f  %24.3f  %31.3f\n", ok ? "ok" : "FAIL", band + 1, bandCenters[band], worstMoved, worstAsIs);
+		failures += !ok;
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,913 @@
+/*******************************************************************************
+  @file     flac_test.c
+  @brief    Host check of the FLAC decoder against files encoded here
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -include tests/host/sdk_host.h -Icomponent/fatfs -Isource/drivers/HAL -Isource/drivers/SDK -Itests/host \
+ *       tests/host/flac_test.c tests/host/decoder_host.c source/drivers/HAL/flac_decoder.c -lm -o flac_test
+ *   ./flac_test
+ *
+ * Add -DFLAC_READAHEAD_KB=2 to run it with frames longer than the read-ahead ring.
+ *
+ * The encoder here picks at random, frame by frame and subframe by subframe, among what a FLAC file can
+ * hold: constant, verbatim, fixed orders 0 to 4 and LPC orders 1 to 32 with any precision and shift,
+ * wasted bits, both Rice parameter sizes, partition orders 0 to 4, escaped partitions, the four stereo
+ * modes, block sizes and rates in the header or coded, fixed and variable block sizes. FLAC is lossless,
+ * so the decoder must give back the signal as it was, at 16 bits:
+ * - 8, 16 and 24 bit, mono and stereo, with and without a SEEKTABLE.
+ * - Center cancel, (L - R) / 2.
+ * - Forward and backward seeks, which land on the exact sample.
+ * - The tags of the VORBIS_COMMENT block and the length of the song.
+ * - A file with damaged bytes: the decoder skips what it can't use and gets to its end.
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "flac_decoder.h"
+#include "decoder_host.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define RATE			(44100U)
+#define OUTPUT_SIZE		(2304U)
+#define READ_AHEAD_EVERY	(2)
+
+#define SEEK_POINT_EVERY	(3)			// Frames between the points of the SEEKTABLE
+#define PADDING_BYTES		(100)
+#define DAMAGED_RUNS		(6)			// Runs of random bytes written over the damaged file
+#define DAMAGED_RUN_BYTES	(40)
+
+#define TITLE			"Some Song Title"
+#define YEAR			"1999"
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	const char * name;
+	uint8_t channels;
+	uint8_t bits;
+	uint32_t samples;				// Per channel
+	uint16_t blockSize;				// 0 for variable block sizes
+	bool seekTable;
+	uint32_t seed;
+} flac_file_t;
+
+typedef struct
+{
+	bool centerCancel;
+	int32_t seek;					// Samples, every seekEvery calls. 0 to play straight through
+	uint32_t seekEvery;
+} flac_run_t;
+
+typedef struct
+{
+	uint8_t * data;
+	uint32_t capacity;
+	uint32_t bits;
+} bit_writer_t;
+
+typedef enum
+{
+	KIND_VERBATIM,
+	KIND_FIXED,
+	KIND_LPC
+} subframe_kind_t;
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static const flac_file_t files[] =
+{
+	{"16 bit stereo", 2, 16, 60000, 4096, true,  1},
+	{"24 bit mono",   1, 24, 40000, 4096, true,  2},
+	{"8 bit stereo",  2,  8, 30000, 1152, true,  3},
+	{"16 bit var.",   2, 16, 50000,    0, true,  4},
+	{"16 bit no tbl", 2, 16, 50000, 2048, false, 5},
+};
+
+static const flac_run_t runs[] =
+{
+	{false,     0,  1},
+	{true,      0,  1},
+	{false,  3000,  3},
+	{false, 20000,  4},
+	{false, -9000, 16},
+	{false,  1152,  1},
+};
+
+// Orders picked for the subframes, next to their kind
+static const struct { subframe_kind_t kind; uint8_t order; } subframeKinds[] =
+{
+	{KIND_VERBATIM, 0}, {KIND_FIXED, 0}, {KIND_FIXED, 1}, {KIND_FIXED, 2}, {KIND_FIXED, 3}, {KIND_FIXED, 4},
+	{KIND_LPC, 1}, {KIND_LPC, 2}, {KIND_LPC, 3}, {KIND_LPC, 5}, {KIND_LPC, 8}, {KIND_LPC, 10}, {KIND_LPC, 12},
+	{KIND_LPC, 16}, {KIND_LPC, 32}
+};
+
+static const int32_t fixedCoefs[5][4] = {{0}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}};
+
+static const uint16_t blockSizeCodes[16] = {0, 192, 576, 1152, 2304, 4608, 0, 0, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768};
+static const uint16_t variableSizes[] = {576, 1152, 2048, 4096, 4608, 1000, 4607};
+
+static uint32_t randomState;
+
+static int32_t * left;
+static int32_t * right;
+static int16_t * reference;			// What the decoder must give back, interleaved
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+static uint32_t nextRandom(void)
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+
+static uint32_t randomBelow(uint32_t limit)
+{
+	return nextRandom() % limit;
+}
+
+
+// True with a chance of percent in 100
+static bool chance(uint32_t percent)
+{
+	return randomBelow(100) < percent;
+}
+
+
+static void putBits(bit_writer_t * w, uint32_t value, uint8_t count)
+{
+	while (count--)
+	{
+		if ((w->bits >> 3) >= w->capacity)
+		{
+			uint32_t capacity = 2 * w->capacity + 4096;
+			w->data = realloc(w->data, capacity);
+			memset(&w->data[w->capacity], 0, capacity - w->capacity);
+			w->capacity = capacity;
+		}
+		if ((value >> count) & 1)
+		{
+			w->data[w->bits >> 3] |= 0x80 >> (w->bits & 7);
+		}
+		w->bits++;
+	}
+}
+
+
+static void putSigned(bit_writer_t * w, int32_t value, uint8_t count)
+{
+	putBits(w, (count < 32) ? ((uint32_t)value & ((1U << count) - 1)) : (uint32_t)value, count);
+}
+
+
+static void putUnary(bit_writer_t * w, uint32_t zeros)
+{
+	for (; zeros >= 32; zeros -= 32)
+	{
+		putBits(w, 0, 32);
+	}
+	putBits(w, 1, zeros + 1);
+}
+
+
+static void alignByte(bit_writer_t * w)
+{
+	putBits(w, 0, (8 - (w->bits & 7)) & 7);
+}
+
+
+static void putBytes(bit_writer_t * w, const void * bytes, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		putBits(w, ((const uint8_t *)bytes)[i], 8);
+	}
+}
+
+
+static void putLittle32(bit_writer_t * w, uint32_t value)
+{
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		putBits(w, (value >> (8 * i)) & 0xFF, 8);
+	}
+}
+
+
+// The "UTF-8" numbers of the frame headers
+static void putUtf8(bit_writer_t * w, uint32_t number)
+{
+	if (number < 0x80)
+	{
+		putBits(w, number, 8);
+		return;
+	}
+
+	uint8_t bytes = 2;
+	while (number >= (1U << (5 * bytes + 1)))
+	{
+		bytes++;
+	}
+
+	putBits(w, ((0xFF << (8 - bytes)) & 0xFF) | (number >> (6 * (bytes - 1))), 8);
+	for (uint8_t i = bytes - 1; i--; )
+	{
+		putBits(w, 0x80 | ((number >> (6 * i)) & 0x3F), 8);
+	}
+}
+
+
+static uint8_t crc8(const uint8_t * data, uint32_t length)
+{
+	uint8_t crc = 0;
+
+	while (length--)
+	{
+		crc ^= *data++;
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+
+static uint16_t crc16(const uint8_t * data, uint32_t length)
+{
+	uint16_t crc = 0;
+
+	while (length--)
+	{
+		crc ^= *data++ << 8;
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x8005) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+
+static uint8_t bitLength(uint32_t value)
+{
+	return value ? (32 - __builtin_clz(value)) : 0;
+}
+
+
+/*
+ * One Rice partition of count residuals, or an escaped one now and then.
+ */
+static void putPartition(bit_writer_t * w, const int32_t * residual, uint32_t count, bool wide)
+{
+	uint8_t parameterBits = wide ? 5 : 4;
+	uint32_t escape = wide ? 31 : 15;
+
+	if (chance(10))
+	{
+		uint32_t largest = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t magnitude = (residual[i] < 0) ? -residual[i] : residual[i];
+			largest = (magnitude > largest) ? magnitude : largest;
+		}
+
+		// 0 bits if they are all 0
+		uint8_t bits = largest ? (bitLength(largest) + 1) : 0;
+		putBits(w, escape, parameterBits);
+		putBits(w, bits, 5);
+		for (uint32_t i = 0; bits && (i < count); i++)
+		{
+			putSigned(w, residual[i], bits);
+		}
+		return;
+	}
+
+	double mean = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		mean += (residual[i] < 0) ? -residual[i] : residual[i];
+	}
+	mean /= count ? count : 1;
+
+	uint32_t parameter = (uint32_t)log2(mean + 1);
+	parameter = (parameter > escape - 1) ? (escape - 1) : parameter;
+	putBits(w, parameter, parameterBits);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t folded = (residual[i] >= 0) ? ((uint32_t)residual[i] << 1) : (((uint32_t)-residual[i] << 1) - 1);
+		putUnary(w, folded >> parameter);
+		putBits(w, folded & ((1U << parameter) - 1), parameter);
+	}
+}
+
+
+static void putResidual(bit_writer_t * w, const int32_t * residual, uint32_t blockSize, uint8_t order)
+{
+	bool wide = chance(50);
+	uint8_t orders[5];
+	uint8_t count = 0;
+
+	for (uint8_t p = 0; p <= 4; p++)
+	{
+		if ((blockSize % (1U << p) == 0) && ((blockSize >> p) >= order))
+		{
+			orders[count++] = p;
+		}
+	}
+	uint8_t partitionOrder = orders[randomBelow(count)];
+
+	putBits(w, wide ? 1 : 0, 2);
+	putBits(w, partitionOrder, 4);
+
+	// The warm-up samples are not in the first partition
+	uint32_t partitionSize = blockSize >> partitionOrder;
+	for (uint32_t p = 0; p < (1U << partitionOrder); p++)
+	{
+		uint32_t count = partitionSize - (p ? 0 : order);
+		putPartition(w, residual, count, wide);
+		residual += count;
+	}
+}
+
+
+static void putSubframeAs(bit_writer_t * w, const int32_t * samples, uint32_t blockSize, uint8_t bits,
+						 subframe_kind_t kind, uint8_t order)
+{
+	int32_t * x = malloc(blockSize * sizeof(int32_t));
+	int32_t * residual = malloc(blockSize * sizeof(int32_t));
+	bool constant = true;
+	bool allEven = true;
+	bool anyNonZero = false;
+
+	for (uint32_t i = 0; i < blockSize; i++)
+	{
+		constant = constant && (samples[i] == samples[0]);
+		allEven = allEven && (samples[i] % 4 == 0);
+		anyNonZero = anyNonZero || samples[i];
+	}
+
+	if (constant && (kind != KIND_VERBATIM))
+	{
+		putBits(w, 0, 8);
+		putSigned(w, samples[0], bits);
+		free(x);
+		free(residual);
+		return;
+	}
+
+	// Wasted bits, 2 or more
+	uint8_t wasted = 0;
+	if (allEven && anyNonZero)
+	{
+		bool more = true;
+		for (wasted = 2; more && (wasted < bits - 2); )
+		{
+			for (uint32_t i = 0; more && (i < blockSize); i++)
+			{
+				more = (samples[i] % (1 << (wasted + 1)) == 0);
+			}
+			wasted += more;
+		}
+	}
+	for (uint32_t i = 0; i < blockSize; i++)
+	{
+		x[i] = samples[i] >> wasted;
+	}
+	bits -= wasted;
+
+	uint8_t type = (kind == KIND_VERBATIM) ? 1 : ((kind == KIND_FIXED) ? (8 + order) : (31 + order));
+	putBits(w, 0, 1);
+	putBits(w, type, 6);
+	putBits(w, wasted ? 1 : 0, 1);
+	if (wasted)
+	{
+		putUnary(w, wasted - 1);
+	}
+
+	if (kind == KIND_VERBATIM)
+	{
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			putSigned(w, x[i], bits);
+		}
+	}
+	else
+	{
+		int32_t coefs[32];
+		uint8_t shift = 0;
+
+		for (uint8_t i = 0; i < order; i++)
+		{
+			putSigned(w, x[i], bits);
+		}
+
+		if (kind == KIND_FIXED)
+		{
+			memcpy(coefs, fixedCoefs[order], sizeof(fixedCoefs[order]));
+		}
+		else
+		{
+			// Close to the second order predictor, so the residuals stay small
+			uint8_t precision = 12 + randomBelow(4);
+			int32_t limit = 1 << (precision - 1);
+			shift = 9 + randomBelow(3);
+
+			for (uint8_t j = 0; j < order; j++)
+			{
+				double base = (j == 0) ? 2 : ((j == 1) ? -1 : 0);
+				double jitter = ((double)randomBelow(10001) / 10000 - 0.5) * 0.1;
+				int32_t coef = (int32_t)lround((base + jitter) * (1 << shift));
+				coefs[j] = (coef < -limit) ? -limit : ((coef > limit - 1) ? (limit - 1) : coef);
+			}
+
+			putBits(w, precision - 1, 4);
+			putSigned(w, shift, 5);
+			for (uint8_t j = 0; j < order; j++)
+			{
+				putSigned(w, coefs[j], precision);
+			}
+		}
+
+		for (uint32_t i = order; i < blockSize; i++)
+		{
+			int64_t sum = 0;
+			for (uint8_t j = 0; j < order; j++)
+			{
+				sum += (int64_t)coefs[j] * x[i - j - 1];
+			}
+			residual[i - order] = x[i] - (int32_t)(sum >> shift);
+		}
+		putResidual(w, residual, blockSize, order);
+	}
+
+	free(x);
+	free(residual);
+}
+
+
+/*
+ * A subframe of a kind picked at random. Like a real encoder, verbatim if that would be smaller:
+ * a predictor far off the signal can take more than the samples themselves.
+ */
+static void putSubframe(bit_writer_t * w, const int32_t * samples, uint32_t blockSize, uint8_t bits)
+{
+	uint32_t pick = randomBelow(sizeof(subframeKinds) / sizeof(subframeKinds[0]));
+	uint8_t order = (subframeKinds[pick].order < blockSize) ? subframeKinds[pick].order : blockSize;
+	bit_writer_t trial = {0};
+
+	putSubframeAs(&trial, samples, blockSize, bits, subframeKinds[pick].kind, order);
+
+	if (trial.bits > 8 + blockSize * bits)
+	{
+		putSubframeAs(w, samples, blockSize, bits, KIND_VERBATIM, 0);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < trial.bits; i += 8)
+		{
+			uint8_t count = (trial.bits - i < 8) ? (trial.bits - i) : 8;
+			putBits(w, trial.data[i >> 3] >> (8 - count), count);
+		}
+	}
+	free(trial.data);
+}
+
+
+/*
+ * The signal of the file: two tones and some noise, a stretch of a constant and one with wasted bits.
+ */
+static void makeSignal(const flac_file_t * file)
+{
+	int32_t limit = 1 << (file->bits - 1);
+
+	left = malloc(file->samples * sizeof(int32_t));
+	right = malloc(file->samples * sizeof(int32_t));
+	reference = malloc(file->samples * file->channels * sizeof(int16_t));
+
+	for (uint32_t i = 0; i < file->samples; i++)
+	{
+		int32_t a, b;
+
+		if (file->bits >= 16)
+		{
+			a = (int32_t)((0.6 * sin(i * 0.01) + 0.3 * sin(i * 0.37)) * limit) + ((int32_t)randomBelow(101) - 50) * (1 << (file->bits - 16));
+		}
+		else
+		{
+			a = (int32_t)(0.7 * sin(i * 0.02) * limit);
+		}
+		b = (int32_t)(0.5 * sin(i * 0.013 + 1) * limit) + (int32_t)randomBelow(61) - 30;
+
+		if ((i >= 20000) && (i < 24000))
+		{
+			a = b = (file->bits >= 16) ? 1234 : 12;
+		}
+		if ((i >= 30000) && (i < 34000))
+		{
+			a = (a >> 3) * 8;
+			b = (b >> 4) * 16;
+		}
+
+		left[i] = (a < -limit) ? -limit : ((a > limit - 1) ? (limit - 1) : a);
+		right[i] = (b < -limit) ? -limit : ((b > limit - 1) ? (limit - 1) : b);
+
+		int32_t l = (file->bits >= 16) ? (left[i] >> (file->bits - 16)) : (left[i] * (1 << (16 - file->bits)));
+		int32_t r = (file->bits >= 16) ? (right[i] >> (file->bits - 16)) : (right[i] * (1 << (16 - file->bits)));
+		if (file->channels == 1)
+		{
+			reference[i] = l;
+		}
+		else
+		{
+			reference[2 * i] = l;
+			reference[2 * i + 1] = r;
+		}
+	}
+}
+
+
+static void putMetadataHeader(bit_writer_t * w, uint8_t type, bool last, uint32_t length)
+{
+	putBits(w, last ? 1 : 0, 1);
+	putBits(w, type, 7);
+	putBits(w, length, 24);
+}
+
+
+/*
+ * The FLAC file of the signal. Returns its length.
+ */
+static uint32_t encode(const flac_file_t * file, uint8_t ** out)
+{
+	bit_writer_t frames = {0};
+	bit_writer_t w = {0};
+	uint32_t seekSamples[64], seekOffsets[64], seekFrames[64];
+	uint32_t seekCount = 0;
+	uint32_t minFrame = UINT32_MAX, maxFrame = 0;
+	uint32_t position = 0;
+	int32_t * side = malloc(65536 * sizeof(int32_t));
+	int32_t * mid = malloc(65536 * sizeof(int32_t));
+
+	for (uint32_t frame = 0; position < file->samples; frame++)
+	{
+		uint32_t blockSize = file->blockSize ? file->blockSize : variableSizes[randomBelow(sizeof(variableSizes) / sizeof(variableSizes[0]))];
+		uint32_t start = frames.bits >> 3;
+
+		blockSize = (blockSize > file->samples - position) ? (file->samples - position) : blockSize;
+
+		if ((frame % SEEK_POINT_EVERY == 0) && (seekCount < 64))
+		{
+			seekSamples[seekCount] = position;
+			seekOffsets[seekCount] = start;
+			seekFrames[seekCount++] = blockSize;
+		}
+
+		// Header
+		uint8_t sizeCode = 0;
+		for (uint8_t c = 1; c < 16; c++)
+		{
+			if ((blockSizeCodes[c] == blockSize) && chance(70))
+			{
+				sizeCode = c;
+			}
+		}
+		if (!sizeCode)
+		{
+			sizeCode = (blockSize <= 256) ? 6 : 7;
+		}
+		bool rateInHeader = chance(20);
+		uint8_t assignment = (file->channels == 1) ? 0 : ((uint8_t[]){1, 8, 9, 10})[randomBelow(4)];
+		uint8_t bitsCode = (file->bits == 8) ? 1 : ((file->bits == 16) ? 4 : 6);
+		if (chance(20))
+		{
+			bitsCode = 0;		// From STREAMINFO
+		}
+
+		putBits(&frames, 0xFFF8 | (file->blockSize ? 0 : 1), 16);
+		putBits(&frames, sizeCode, 4);
+		putBits(&frames, rateInHeader ? 13 : 9, 4);
+		putBits(&frames, assignment, 4);
+		putBits(&frames, bitsCode, 3);
+		putBits(&frames, 0, 1);
+		putUtf8(&frames, file->blockSize ? frame : position);
+		if (sizeCode == 6)
+		{
+			putBits(&frames, blockSize - 1, 8);
+		}
+		else if (sizeCode == 7)
+		{
+			putBits(&frames, blockSize - 1, 16);
+		}
+		if (rateInHeader)
+		{
+			putBits(&frames, RATE, 16);
+		}
+		putBits(&frames, crc8(&frames.data[start], (frames.bits >> 3) - start), 8);
+
+		// Subframes, the side channel has one bit more
+		const int32_t * l = &left[position];
+		const int32_t * r = &right[position];
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			side[i] = l[i] - r[i];
+			mid[i] = (l[i] + r[i]) >> 1;
+		}
+
+		switch (assignment)
+		{
+			case 0:
+				putSubframe(&frames, l, blockSize, file->bits);
+				break;
+			case 1:
+				putSubframe(&frames, l, blockSize, file->bits);
+				putSubframe(&frames, r, blockSize, file->bits);
+				break;
+			case 8:
+				putSubframe(&frames, l, blockSize, file->bits);
+				putSubframe(&frames, side, blockSize, file->bits + 1);
+				break;
+			case 9:
+				putSubframe(&frames, side, blockSize, file->bits + 1);
+				putSubframe(&frames, r, blockSize, file->bits);
+				break;
+			default:
+				putSubframe(&frames, mid, blockSize, file->bits);
+				putSubframe(&frames, side, blockSize, file->bits + 1);
+				break;
+		}
+
+		alignByte(&frames);
+		putBits(&frames, crc16(&frames.data[start], (frames.bits >> 3) - start), 16);
+
+		uint32_t length = (frames.bits >> 3) - start;
+		minFrame = (length < minFrame) ? length : minFrame;
+		maxFrame = (length > maxFrame) ? length : maxFrame;
+		position += blockSize;
+	}
+
+	putBytes(&w, "fLaC", 4);
+
+	// STREAMINFO
+	putMetadataHeader(&w, 0, false, 34);
+	putBits(&w, file->blockSize ? file->blockSize : 576, 16);
+	putBits(&w, file->blockSize ? file->blockSize : 4608, 16);
+	putBits(&w, minFrame, 24);
+	putBits(&w, maxFrame, 24);
+	putBits(&w, RATE, 20);
+	putBits(&w, file->channels - 1, 3);
+	putBits(&w, file->bits - 1, 5);
+	putBits(&w, 0, 4);
+	putBits(&w, file->samples, 32);
+	putBits(&w, 0, 32);
+	putBits(&w, 0, 32);
+	putBits(&w, 0, 32);
+	putBits(&w, 0, 32);
+
+	// VORBIS_COMMENT, the names in any case
+	static const char * const comments[] =
+	{
+		"title=" TITLE, "ARTIST=An Artist With A Very Long Name That Goes On And On Forever And Ever",
+		"Album=Alb", "DATE=" YEAR, "TRACKNUMBER=7", "COMMENT=x"
+	};
+	uint32_t commentBytes = 4 + 4 + 4;
+	for (uint32_t i = 0; i < sizeof(comments) / sizeof(comments[0]); i++)
+	{
+		commentBytes += 4 + strlen(comments[i]);
+	}
+	putMetadataHeader(&w, 4, false, commentBytes);
+	putLittle32(&w, 4);
+	putBytes(&w, "test", 4);
+	putLittle32(&w, sizeof(comments) / sizeof(comments[0]));
+	for (uint32_t i = 0; i < sizeof(comments) / sizeof(comments[0]); i++)
+	{
+		putLittle32(&w, strlen(comments[i]));
+		putBytes(&w, comments[i], strlen(comments[i]));
+	}
+
+	// SEEKTABLE, with a placeholder point at the end
+	if (file->seekTable)
+	{
+		putMetadataHeader(&w, 3, false, 18 * (seekCount + 1));
+		for (uint32_t i = 0; i < seekCount; i++)
+		{
+			putBits(&w, 0, 32);
+			putBits(&w, seekSamples[i], 32);
+			putBits(&w, 0, 32);
+			putBits(&w, seekOffsets[i], 32);
+			putBits(&w, seekFrames[i], 16);
+		}
+		putBits(&w, UINT32_MAX, 32);
+		putBits(&w, UINT32_MAX, 32);
+		putBits(&w, 0, 32);
+		putBits(&w, 0, 32);
+		putBits(&w, 0, 16);
+	}
+
+	putMetadataHeader(&w, 1, true, PADDING_BYTES);
+	putBits(&w, 0, 32);
+	for (uint32_t i = 4; i < PADDING_BYTES; i++)
+	{
+		putBits(&w, 0, 8);
+	}
+
+	putBytes(&w, frames.data, frames.bits >> 3);
+
+	free(frames.data);
+	free(side);
+	free(mid);
+
+	*out = w.data;
+	return w.bits >> 3;
+}
+
+
+static void check(int ok, const flac_file_t * file, const flac_run_t * run, const char * what, long value)
+{
+	printf("%-5s %-13s cc %u seek %6d: %-24s %ld\n", ok ? "ok" : "FAIL", file->name,
+		   run ? run->centerCancel : 0, run ? run->seek : 0, what, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+static void play(const flac_file_t * file, const flac_run_t * run, const uint8_t * data, uint32_t size)
+{
+	short output[OUTPUT_SIZE];
+	uint32_t samples;
+	int rate;
+	uint32_t frame = 0;
+	uint32_t calls = 0;
+	long wrong = 0;
+
+	DecoderHost_SetFile(data, size);
+	FLACDecoder_Init();
+	flacCodec.setCenterCancel(run->centerCancel);
+
+	if (!FLACDecoder_LoadFile(DECODER_PLAYING_STREAM, "test.flac"))
+	{
+		check(0, file, run, "opened", 0);
+		return;
+	}
+
+	if (!run->centerCancel && !run->seek)
+	{
+		char * tag;
+		check(flacCodec.getTag(AUDIO_TAG_TITLE, &tag) && !strcmp(tag, TITLE), file, run, "title", 0);
+		check(flacCodec.getTag(AUDIO_TAG_YEAR, &tag) && !strcmp(tag, YEAR), file, run, "year", 0);
+
+		uint32_t expectedMs = (uint32_t)((uint64_t)file->samples * 1000 / RATE);
+		check(flacCodec.getRemainingMs() == expectedMs, file, run, "length, ms", flacCodec.getRemainingMs());
+	}
+
+	while (FLACDecoder_DecodeFrame(DECODER_PLAYING_STREAM, output, OUTPUT_SIZE, &samples, &rate) == DECODER_WORKED)
+	{
+		uint8_t channels;
+		flacCodec.getChannels(DECODER_PLAYING_STREAM, &channels);
+
+		for (uint32_t i = 0; i < samples / channels; i++, frame++)
+		{
+			for (uint8_t c = 0; c < channels; c++)
+			{
+				int32_t expected = 0;
+
+				if (frame < file->samples)
+				{
+					expected = reference[frame * file->channels + c];
+					if ((channels == 1) && (file->channels == 2))
+					{
+						expected = (reference[2 * frame] - reference[2 * frame + 1]) / 2;
+					}
+				}
+				if ((frame >= file->samples) || (output[i * channels + c] != expected))
+				{
+					wrong++;
+				}
+			}
+		}
+
+		calls++;
+		if (calls % READ_AHEAD_EVERY == 0)
+		{
+			FLACDecoder_ReadAhead();
+		}
+		if (run->seek && (calls % run->seekEvery == 0) && ((int64_t)frame + run->seek < file->samples))
+		{
+			int64_t target = (int64_t)frame + run->seek;
+			if (!flacCodec.seek(run->seek))
+			{
+				check(0, file, run, "seek", (long)target);
+				break;
+			}
+			frame = (target < 0) ? 0 : (uint32_t)target;
+		}
+	}
+
+	check(wrong == 0, file, run, "samples off", wrong);
+	check(frame == file->samples, file, run, "samples, to the end", frame);
+	check(DecoderHost_UnalignedReads() == 0, file, run, "reads through the window", DecoderHost_UnalignedReads());
+
+	FLACDecoder_Close(DECODER_PLAYING_STREAM);
+}
+
+
+/*
+ * Random bytes over some runs of the frames: the decoder must skip them and get to the end.
+ */
+static void playDamaged(const flac_file_t * file, uint8_t * data, uint32_t size)
+{
+	short output[OUTPUT_SIZE];
+	uint32_t samples;
+	int rate;
+	uint32_t frames = 0;
+	decoder_result_t result;
+
+	for (uint32_t run = 0; run < DAMAGED_RUNS; run++)
+	{
+		uint32_t at = 20000 + randomBelow(size - 20000 - DAMAGED_RUN_BYTES);
+		for (uint32_t i = 0; i < DAMAGED_RUN_BYTES; i++)
+		{
+			data[at + i] = nextRandom();
+		}
+	}
+
+	DecoderHost_SetFile(data, size);
+	FLACDecoder_Init();
+	if (!FLACDecoder_LoadFile(DECODER_PLAYING_STREAM, "test.flac"))
+	{
+		check(0, file, NULL, "damaged, opened", 0);
+		return;
+	}
+
+	while ((result = FLACDecoder_DecodeFrame(DECODER_PLAYING_STREAM, output, OUTPUT_SIZE, &samples, &rate)) == DECODER_WORKED)
+	{
+		uint8_t channels;
+		flacCodec.getChannels(DECODER_PLAYING_STREAM, &channels);
+		frames += samples / channels;
+	}
+
+	// At most the frame hit and the one after it lost per run
+	uint32_t lost = 2 * DAMAGED_RUNS * file->blockSize;
+	check(result == DECODER_END_OF_FILE, file, NULL, "damaged, ends", result);
+	check((frames + lost >= file->samples) && (frames <= file->samples), file, NULL, "damaged, samples out", frames);
+
+	FLACDecoder_Close(DECODER_PLAYING_STREAM);
+}
+
+
+int main(void)
+{
+	for (uint32_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+	{
+		const flac_file_t * file = &files[f];
+		uint8_t * data;
+
+		randomState = file->seed;
+		makeSignal(file);
+		uint32_t size = encode(file, &data);
+
+		for (uint32_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+		{
+			play(file, &runs[r], data, size);
+		}
+
+		if (f == 0)
+		{
+			playDamaged(file, data, size);
+		}
+
+		free(data);
+		free(left);
+		free(right);
+		free(reference);
+	}
+
+	return failures ? 1 : 0;
+}
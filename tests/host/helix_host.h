@@ -0,0 +1,43 @@
+/*******************************************************************************
+  @file     helix_host.h
+  @brief    Portable C versions of helix's assembly.h, to build the decoder on the PC
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * component/helix/real/assembly.h only has the ARM inline assembly. Force-include this header
+ * (gcc -include tests/host/helix_host.h) and that one is skipped, helix builds for the host.
+ */
+#ifndef HELIX_HOST_H
+#define HELIX_HOST_H
+
+#include "platform.h"
+
+/* assembly.h checks this, it is left out */
+#define _ASSEMBLY_H
+
+static inline int MULSHIFT32(int x, int y)
+{
+	return (int)(((Word64)x * y) >> 32);
+}
+
+static inline int FASTABS(int x)
+{
+	return (x < 0) ? -x : x;
+}
+
+static inline int CLZ(int x)
+{
+	return x ? __builtin_clz((unsigned int)x) : 32;
+}
+
+static inline Word64 MADD64(Word64 sum64, int x, int y)
+{
+	return sum64 + (Word64)x * y;
+}
+
+static inline Word64 SAR64(Word64 x, int n)
+{
+	return x >> n;
+}
+
+#endif
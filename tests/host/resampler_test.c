@@ -0,0 +1,186 @@
+/*******************************************************************************
+  @file     resampler_test.c
+  @brief    Host check of the resampler against a double-precision sine
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -I. -ICMSIS -Isource/equalizer tests/host/resampler_test.c source/equalizer/resampler.c -lm -o resampler_test
+ *   ./resampler_test
+ *
+ * Each rate is fed in blocks of odd sizes, the way the decoders hand them over, and resampled to 48 kHz:
+ * - SNR of an in-band sine against the exact one at the output rate.
+ * - Above 48 kHz, what is left of a sine over 24 kHz, which would fold back into the audio band.
+ * - The end of a song: with Resampler_Flush, every input sample reaches the output.
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "resampler.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define OUT_RATE		(48000)
+#define OUTPUTS			(100000)
+#define SETTLE			(2000)			// Outputs skipped before measuring, the filter starts from silence
+#define MAX_BLOCK		(1152)
+#define AMPLITUDE		(0.9 * (1 << 28))	// The headroom of the handler's Q31 path
+
+#define MIN_SNR_DB		(70.0)
+#define MAX_ALIAS_DB	(-70.0)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static q31_t buffer[RESAMPLER_HISTORY + MAX_BLOCK];
+static q31_t output[OUTPUTS + MAX_BLOCK];
+
+static const uint32_t blockSizes[] = {1152, 576, 1000, 4608 / 4, 333};
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+/*
+ * Resamples inputs samples of a sine (all of them if inputs is not 0, then Resampler_Flush),
+ * up to OUTPUTS samples. Returns the samples written.
+ */
+static uint32_t run(uint32_t inRate, double frequency, uint32_t inputs)
+{
+	resampler_t resampler;
+	q31_t * block = &buffer[RESAMPLER_HISTORY];
+	uint32_t length = 0;
+	uint32_t fed = 0;
+	uint32_t written = 0;
+	uint32_t blocks = 0;
+	int flushed = 0;
+
+	Resampler_Init(&resampler, block, OUT_RATE);
+	Resampler_SetInputRate(&resampler, inRate);
+
+	while (written < OUTPUTS)
+	{
+		uint32_t room = (OUTPUTS - written < MAX_BLOCK) ? OUTPUTS - written : MAX_BLOCK;
+		uint32_t got = Resampler_Process(&resampler, block, length, &output[written], room);
+		written += got;
+
+		if (got == room)
+		{
+			continue;
+		}
+		if (flushed)
+		{
+			break;
+		}
+
+		Resampler_NextBlock(&resampler, block, length);
+
+		if (inputs && (fed >= inputs))
+		{
+			length = Resampler_Flush(block);
+			flushed = 1;
+			continue;
+		}
+
+		length = blockSizes[blocks++ % (sizeof(blockSizes) / sizeof(blockSizes[0]))];
+		if (inputs && (fed + length > inputs))
+		{
+			length = inputs - fed;
+		}
+
+		for (uint32_t i = 0; i < length; i++)
+		{
+			block[i] = (q31_t)(AMPLITUDE * sin(2 * M_PI * frequency * (fed + i) / inRate));
+		}
+		fed += length;
+	}
+
+	return written;
+}
+
+
+/*
+ * Energy of the output against the exact sine at frequency (or against silence if frequency is 0), dB.
+ */
+static double errorDb(double frequency, uint32_t first, uint32_t last)
+{
+	double signal = 0;
+	double error = 0;
+
+	for (uint32_t n = first; n < last; n++)
+	{
+		double exact = AMPLITUDE * sin(2 * M_PI * frequency * n / OUT_RATE);
+		signal += AMPLITUDE * AMPLITUDE / 2;
+		error += (output[n] - exact) * (output[n] - exact);
+	}
+
+	return 10 * log10(error / signal);
+}
+
+
+static void check(int ok, const char * what, uint32_t inRate, double value)
+{
+	printf("%-5s %-28s %6u Hz: %7.1f\n", ok ? "ok" : "FAIL", what, inRate, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+int main(void)
+{
+	static const uint32_t upRates[] = {8000, 11025, 22050, 32000, 44100, 48000};
+	static const uint32_t downRates[] = {88200, 96000};
+
+	// In band, up to the output rate: flat to ~0.42 of the input rate
+	for (uint32_t i = 0; i < sizeof(upRates) / sizeof(upRates[0]); i++)
+	{
+		double frequency = 0.3 * upRates[i];
+		run(upRates[i], frequency, 0);
+
+		double snr = -errorDb(frequency, SETTLE, OUTPUTS);
+		check(snr >= MIN_SNR_DB, "SNR, dB", upRates[i], snr);
+	}
+
+	// Above it: in band, and a sine over half the output rate is gone
+	for (uint32_t i = 0; i < sizeof(downRates) / sizeof(downRates[0]); i++)
+	{
+		run(downRates[i], 1000, 0);
+		double snr = -errorDb(1000, SETTLE, OUTPUTS);
+		check(snr >= MIN_SNR_DB, "SNR, dB", downRates[i], snr);
+
+		run(downRates[i], 30000, 0);
+		double alias = errorDb(0, SETTLE, OUTPUTS);
+		check(alias <= MAX_ALIAS_DB, "alias of 30 kHz, dB", downRates[i], alias);
+	}
+
+	// The end of a song: the outputs up to its last sample, and those last ones right
+	static const uint32_t endRates[] = {22050, 44100, 48000, 96000};
+	for (uint32_t i = 0; i < sizeof(endRates) / sizeof(endRates[0]); i++)
+	{
+		uint32_t inputs = 20011;
+		uint32_t expected = (uint32_t)(((uint64_t)(inputs - 1) * OUT_RATE) / endRates[i]) + 1;
+		uint32_t written = run(endRates[i], 1000, inputs);
+
+		check(written >= expected, "outputs past the last input", endRates[i], (double)written - expected);
+
+		// The last millisecond before the end, the filter sees the silence after it from half its length on
+		uint32_t last = expected - RESAMPLER_TAPS;
+		double snr = -errorDb(1000, last - OUT_RATE / 1000, last);
+		check(snr >= MIN_SNR_DB, "SNR before the end, dB", endRates[i], snr);
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+/*******************************************************************************
+  @file     sdk_host.h
+  @brief    The parts of fsl_common.h the codecs use, to build them on the PC
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * fsl_common.h pulls in the MK64F12 device headers and the CMSIS core. Force-include this header
+ * (gcc -include tests/host/sdk_host.h, with -Isource/drivers/SDK) and that one is skipped.
+ */
+#ifndef SDK_HOST_H
+#define SDK_HOST_H
+
+#include <stdint.h>
+
+/* fsl_common.h checks this, it is left out */
+#define _FSL_COMMON_H_
+
+static inline uint8_t __CLZ(uint32_t value)
+{
+	return value ? (uint8_t)__builtin_clz(value) : 32;
+}
+
+#endif
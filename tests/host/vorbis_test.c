@@ -0,0 +1,1919 @@
+/*******************************************************************************
+  @file     vorbis_test.c
+  @brief    Host check of the Vorbis decoder against files encoded here and a double-precision decode
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -include tests/host/sdk_host.h -Icomponent/fatfs -Isource/drivers/HAL -Isource/drivers/SDK -Itests/host \
+ *       tests/host/vorbis_test.c tests/host/decoder_host.c source/drivers/HAL/vorbis_decoder.c -lm -o vorbis_test
+ *   ./vorbis_test
+ *
+ * Add -DVORBIS_READAHEAD_KB=1 to run it with packets longer than the read-ahead ring.
+ *
+ * The encoder here is no good for music, it is made to reach what a setup header can hold: ordered, sparse
+ * and plain codebooks, lookup types 1 and 2 (with sequence_p), a one-entry book, floor 1 with and without
+ * subclasses, residues 0, 1 and 2 with up to three passes, square polar coupling, two submaps, channels left
+ * out of a packet, 256 and 2048 sample blocks mixed at random and packets split across pages. What it wrote
+ * is decoded back here in double precision, the way the specification does it. The decoder must be within
+ * MAX_DIFFERENCE of that decode, at 16 bits:
+ * - Stereo and mono, long and short pages.
+ * - Center cancel, (L - R) / 2.
+ * - Forward and backward seeks, which land on the exact sample.
+ * - The tags of the comment header and the length of the song.
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "vorbis_decoder.h"
+#include "decoder_host.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define RATE			(44100U)
+#define OUTPUT_SIZE		(2304U)
+#define READ_AHEAD_EVERY	(2)
+#define MAX_DIFFERENCE	(3)				// 16 bit LSB: the rounding of the IMDCT, of the output and of the reference
+#define MAX_SEEKS		(60)			// Per run: short blocks give 128 samples a call, a seek back would never end
+
+#define SHORT_BLOCK		(256U)
+#define LONG_BLOCK		(2048U)
+#define MAX_HALF		(LONG_BLOCK / 2)
+#define LONG_PERCENT	(70)			// Chance of a long block
+
+#define BOOKS			(8)
+#define MAX_ENTRIES		(289)
+#define MAX_DIMENSIONS	(4)
+#define MAX_MULTIPLICANDS	(32)
+#define FLOOR_BOOK		(0)
+#define MASTER_BOOK		(1)
+#define CLASS_BOOK		(2)
+#define NOISE_BOOK		(6)				// Its entries are picked at random, not fitted
+#define FLOOR_MAX_VALUES	(28)
+#define FLOOR_MULTIPLIER	(2)
+#define FLOOR_RANGE		(128)
+#define RESIDUE_CLASSES	(4)
+#define RESIDUE_LIMIT	(68)			// The coarse book plus the fine one reach this far
+
+#define SERIAL_NUMBER	(0x1234ABCDU)
+
+#define TITLE			"Test Song"
+#define ARTIST			"Grupo 5"
+#define YEAR			"2020"
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	const char * name;
+	uint8_t channels;
+	uint32_t samples;				// Per channel
+	bool shortPages;				// 1 to 20 segments a page instead of 15 to 40
+	uint32_t unusedPercent;			// Chance of the last channel being left out of a packet
+	uint32_t seed;
+} vorbis_file_t;
+
+typedef struct
+{
+	bool centerCancel;
+	int32_t seek;					// Samples, every seekEvery calls. 0 to play straight through
+	uint32_t seekEvery;
+} vorbis_run_t;
+
+typedef struct
+{
+	uint8_t * data;
+	uint32_t capacity;
+	uint32_t bits;
+} bit_writer_t;
+
+typedef struct
+{
+	uint8_t dimensions;
+	uint16_t entries;
+	uint8_t lengths[MAX_ENTRIES];	// 0 for the entries left out of a sparse book
+	uint32_t codes[MAX_ENTRIES];
+	bool ordered;
+	bool sparse;
+	uint8_t lookup;					// 0, 1 or 2
+	double minimum;
+	double delta;
+	uint8_t valueBits;
+	bool sequence;
+	uint8_t multiplicands[MAX_MULTIPLICANDS];
+	uint8_t multiplicandCount;
+} book_t;
+
+typedef struct
+{
+	uint8_t dimensions;
+	uint8_t subclassBits;
+	uint8_t masterBook;
+	int8_t books[2];				// Per subclass, -1 for none
+} floor_class_t;
+
+typedef struct
+{
+	uint8_t rangeBits;
+	uint8_t partitions;
+	const uint8_t * partitionClasses;
+	uint8_t values;
+	uint16_t x[FLOOR_MAX_VALUES];
+	uint8_t order[FLOOR_MAX_VALUES];	// Values by x
+	uint8_t low[FLOOR_MAX_VALUES];
+	uint8_t high[FLOOR_MAX_VALUES];
+} floor_t;
+
+typedef struct
+{
+	uint8_t type;
+	uint32_t begin;
+	uint32_t end;
+	uint32_t partitionSize;
+} residue_t;
+
+typedef struct
+{
+	uint8_t submaps;
+	bool coupled;					// Channel 0 magnitude, channel 1 angle
+	uint8_t mux[2];
+	uint8_t floors[2];				// Per submap
+	uint8_t residues[2];
+} mapping_t;
+
+typedef struct
+{
+	uint8_t * data;
+	uint32_t length;
+} packet_t;
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static const vorbis_file_t files[] =
+{
+	{"stereo",        2, 4 * RATE, false,  0, 2},
+	{"mono",          1, 3 * RATE, true,   0, 3},
+	{"stereo, holes", 2, 3 * RATE, true,  10, 4},
+};
+
+static const vorbis_run_t runs[] =
+{
+	{false,     0,  1},
+	{true,      0,  1},
+	{false,  3000,  3},
+	{false, 20000,  4},
+	{false, -9000, 16},
+	{false,  1152,  1},
+};
+
+static const floor_class_t floorClasses[] =
+{
+	{2, 1, MASTER_BOOK, {-1, FLOOR_BOOK}},
+	{3, 0, 0,           {FLOOR_BOOK, -1}},
+};
+
+static const uint8_t shortFloorClasses[] = {0, 0, 1, 0};
+static const uint8_t longFloorClasses[] = {0, 1, 0, 0, 1, 0, 0, 1, 0, 1};
+
+// Books of each pass, per residue class: nothing, +-1, +-4, and coarse + fine + noise
+static const struct { uint8_t count; uint8_t pass[3]; uint8_t book[3]; } cascades[RESIDUE_CLASSES] =
+{
+	{0, {0}, {0}},
+	{1, {0}, {5}},
+	{1, {0}, {4}},
+	{3, {0, 1, 2}, {3, 4, 6}},
+};
+
+static const residue_t residues[] =
+{
+	{2, 0, SHORT_BLOCK, 16},		// Both channels of a short block, interleaved
+	{1, 0, 960, 32},				// The top of the band is left at 0
+	{0, 0, 1024, 32},
+};
+
+// Mode 0 is the short block, 1 and 2 long blocks with residue 1 or 2
+static const mapping_t stereoMappings[] =
+{
+	{1, true,  {0, 0}, {0, 0}, {0, 0}},
+	{1, true,  {0, 0}, {1, 0}, {1, 0}},
+	{2, false, {0, 1}, {1, 1}, {2, 1}},
+};
+
+static const mapping_t monoMappings[] =
+{
+	{1, false, {0, 0}, {0, 0}, {0, 0}},
+	{1, false, {0, 0}, {1, 0}, {1, 0}},
+	{1, false, {0, 0}, {1, 0}, {2, 0}},
+};
+
+static const char * const comments[] =
+{
+	"title=" TITLE, "ARTIST=" ARTIST,
+	"Album=AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA",
+	"COMMENT=nothing", "TrackNumber=7", "DATE=" YEAR
+};
+
+static uint32_t randomState;
+
+static book_t books[BOOKS];
+static floor_t floors[2];
+static const mapping_t * mappings;
+
+static double inverseDb[256];
+static double * cosines[2];			// Of the short and the long MDCT, [n][k]
+static uint32_t crcTable[256];
+
+static double * source[2];
+static int16_t * reference;			// What the decoder must give, the mix of the channels
+static int16_t * referenceCancel;	// And with center cancel
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+static uint32_t nextRandom(void)
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+
+static uint32_t randomBelow(uint32_t limit)
+{
+	return nextRandom() % limit;
+}
+
+
+// True with a chance of percent in 100
+static bool chance(uint32_t percent)
+{
+	return randomBelow(100) < percent;
+}
+
+
+// Vorbis packs its bits LSB first
+static void putBits(bit_writer_t * w, uint32_t value, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if ((w->bits >> 3) >= w->capacity)
+		{
+			uint32_t capacity = 2 * w->capacity + 1024;
+			w->data = realloc(w->data, capacity);
+			memset(&w->data[w->capacity], 0, capacity - w->capacity);
+			w->capacity = capacity;
+		}
+		if ((value >> i) & 1)
+		{
+			w->data[w->bits >> 3] |= 1 << (w->bits & 7);
+		}
+		w->bits++;
+	}
+}
+
+
+static void putString(bit_writer_t * w, const char * text)
+{
+	while (*text)
+	{
+		putBits(w, (uint8_t)*text++, 8);
+	}
+}
+
+
+static packet_t toPacket(bit_writer_t * w)
+{
+	packet_t packet = { w->data, (w->bits + 7) >> 3 };
+	return packet;
+}
+
+
+static uint8_t ilog(uint32_t value)
+{
+	uint8_t bits = 0;
+
+	for (; value; value >>= 1)
+	{
+		bits++;
+	}
+	return bits;
+}
+
+
+// The 32 bit floats of the codebooks, exact for the values used here
+static uint32_t packFloat(double value)
+{
+	uint32_t sign = (value < 0) ? 0x80000000U : 0;
+	int32_t exponent = 788;
+
+	value = fabs(value);
+	if (value == 0)
+	{
+		return 0;
+	}
+	while (value != floor(value))
+	{
+		value *= 2;
+		exponent--;
+	}
+
+	uint32_t mantissa = (uint32_t)value;
+	while (mantissa >= (1U << 21))
+	{
+		mantissa >>= 1;
+		exponent++;
+	}
+
+	return sign | ((uint32_t)exponent << 21) | mantissa;
+}
+
+
+/*
+ * Code lengths of a Huffman code for random weights between 1 and 100.
+ */
+static void randomLengths(uint8_t * lengths, uint16_t count)
+{
+	static uint32_t weight[2 * MAX_ENTRIES];
+	static int16_t parent[2 * MAX_ENTRIES];
+	static bool active[2 * MAX_ENTRIES];
+	uint16_t nodes = count;
+
+	for (uint16_t i = 0; i < count; i++)
+	{
+		weight[i] = 1 + randomBelow(100);
+		parent[i] = -1;
+		active[i] = true;
+	}
+
+	for (uint16_t merge = 1; merge < count; merge++)
+	{
+		int16_t a = -1;
+		int16_t b = -1;
+
+		for (uint16_t i = 0; i < nodes; i++)
+		{
+			if (!active[i])
+			{
+				continue;
+			}
+			if ((a < 0) || (weight[i] < weight[a]))
+			{
+				b = a;
+				a = i;
+			}
+			else if ((b < 0) || (weight[i] < weight[b]))
+			{
+				b = i;
+			}
+		}
+
+		weight[nodes] = weight[a] + weight[b];
+		parent[nodes] = -1;
+		active[nodes] = true;
+		parent[a] = parent[b] = nodes;
+		active[a] = active[b] = false;
+		nodes++;
+	}
+
+	for (uint16_t i = 0; i < count; i++)
+	{
+		uint8_t length = 0;
+		for (int16_t n = i; parent[n] >= 0; n = parent[n])
+		{
+			length++;
+		}
+		lengths[i] = length ? length : 1;
+	}
+}
+
+
+/*
+ * The codewords the decoder assigns to the lengths, in the order of the entries (the specification's marker
+ * algorithm).
+ */
+static void assignCodes(book_t * book)
+{
+	uint32_t marker[33] = {0};
+
+	for (uint16_t i = 0; i < book->entries; i++)
+	{
+		uint8_t length = book->lengths[i];
+		if (!length)
+		{
+			continue;
+		}
+
+		uint32_t entry = marker[length];
+		book->codes[i] = entry;
+
+		for (uint8_t j = length; j > 0; j--)
+		{
+			if (marker[j] & 1)
+			{
+				marker[j] = (j == 1) ? marker[1] + 1 : marker[j - 1] << 1;
+				break;
+			}
+			marker[j]++;
+		}
+		for (uint8_t j = length + 1; j < 33; j++)
+		{
+			if ((marker[j] >> 1) != entry)
+			{
+				break;
+			}
+			entry = marker[j];
+			marker[j] = marker[j - 1] << 1;
+		}
+	}
+}
+
+
+static void makeBook(book_t * book, uint8_t dimensions, uint16_t entries, uint8_t lookup, double minimum,
+					 double delta, uint8_t valueBits, uint8_t multiplicandCount)
+{
+	memset(book, 0, sizeof(*book));
+	book->dimensions = dimensions;
+	book->entries = entries;
+	book->lookup = lookup;
+	book->minimum = minimum;
+	book->delta = delta;
+	book->valueBits = valueBits;
+	book->multiplicandCount = multiplicandCount;
+
+	for (uint8_t i = 0; i < multiplicandCount; i++)
+	{
+		book->multiplicands[i] = i;
+	}
+	if (entries > 1)
+	{
+		randomLengths(book->lengths, entries);
+	}
+}
+
+
+static void makeBooks(void)
+{
+	// 0: the floor values, 0 to 255, ordered
+	makeBook(&books[0], 1, 256, 0, 0, 0, 0, 0);
+	memset(books[0].lengths, 8, 256);
+	books[0].ordered = true;
+
+	// 1: the floor's master book, sparse
+	makeBook(&books[1], 1, 5, 0, 0, 0, 0, 0);
+	memcpy(books[1].lengths, (const uint8_t[]){2, 2, 2, 2, 0}, 5);
+	books[1].sparse = true;
+
+	// 2: residue classes, two partitions a codeword
+	makeBook(&books[2], 2, RESIDUE_CLASSES * RESIDUE_CLASSES, 0, 0, 0, 0, 0);
+
+	// 3 to 5: coarse, fine and +-1 VQ, lookup 1
+	makeBook(&books[3], 2, 17 * 17, 1, -64, 8, 5, 17);
+	makeBook(&books[4], 2, 9 * 9, 1, -4, 1, 4, 9);
+	makeBook(&books[5], 4, 3 * 3 * 3 * 3, 1, -1, 1, 2, 3);
+
+	// 6: lookup 2 with sequence_p, each value adds to the one before
+	makeBook(&books[6], 2, 16, 2, -0.5, 0.5, 2, 32);
+	books[6].sequence = true;
+	books[6].multiplicands[0] = books[6].multiplicands[1] = 1;
+	for (uint8_t i = 2; i < 32; i++)
+	{
+		books[6].multiplicands[i] = randomBelow(3);
+	}
+
+	// 7: a single entry, never used by the audio
+	makeBook(&books[7], 1, 1, 0, 0, 0, 0, 0);
+	books[7].lengths[0] = 1;
+	books[7].ordered = true;
+
+	for (uint8_t b = 0; b < BOOKS; b++)
+	{
+		assignCodes(&books[b]);
+	}
+}
+
+
+static void putBook(bit_writer_t * w, const book_t * book)
+{
+	putBits(w, 0x564342, 24);
+	putBits(w, book->dimensions, 16);
+	putBits(w, book->entries, 24);
+
+	if (book->ordered)
+	{
+		uint8_t length = book->lengths[0];
+
+		putBits(w, 1, 1);
+		putBits(w, length - 1, 5);
+		for (uint16_t i = 0; i < book->entries; length++)
+		{
+			uint16_t run = 0;
+			while ((i + run < book->entries) && (book->lengths[i + run] == length))
+			{
+				run++;
+			}
+			putBits(w, run, ilog(book->entries - i));
+			i += run;
+		}
+	}
+	else
+	{
+		putBits(w, 0, 1);
+		putBits(w, book->sparse, 1);
+		for (uint16_t i = 0; i < book->entries; i++)
+		{
+			if (book->sparse)
+			{
+				putBits(w, book->lengths[i] != 0, 1);
+				if (!book->lengths[i])
+				{
+					continue;
+				}
+			}
+			putBits(w, book->lengths[i] - 1, 5);
+		}
+	}
+
+	putBits(w, book->lookup, 4);
+	if (book->lookup)
+	{
+		putBits(w, packFloat(book->minimum), 32);
+		putBits(w, packFloat(book->delta), 32);
+		putBits(w, book->valueBits - 1, 4);
+		putBits(w, book->sequence, 1);
+		for (uint8_t i = 0; i < book->multiplicandCount; i++)
+		{
+			putBits(w, book->multiplicands[i], book->valueBits);
+		}
+	}
+}
+
+
+// Codewords are read a bit at a time, their first bit is the top one
+static void putEntry(bit_writer_t * w, const book_t * book, uint32_t entry)
+{
+	for (uint8_t i = book->lengths[entry]; i--; )
+	{
+		putBits(w, (book->codes[entry] >> i) & 1, 1);
+	}
+}
+
+
+static void entryVector(const book_t * book, uint32_t entry, double * vector)
+{
+	double last = 0;
+	uint32_t divisor = 1;
+
+	for (uint8_t d = 0; d < book->dimensions; d++)
+	{
+		uint8_t multiplicand;
+
+		if (book->lookup == 1)
+		{
+			multiplicand = book->multiplicands[(entry / divisor) % book->multiplicandCount];
+			divisor *= book->multiplicandCount;
+		}
+		else
+		{
+			multiplicand = book->multiplicands[entry * book->dimensions + d];
+		}
+
+		vector[d] = multiplicand * book->delta + book->minimum + last;
+		if (book->sequence)
+		{
+			last = vector[d];
+		}
+	}
+}
+
+
+static uint32_t nearestEntry(const book_t * book, const double * target, double * vector)
+{
+	double best = INFINITY;
+	uint32_t bestEntry = 0;
+
+	for (uint32_t e = 0; e < book->entries; e++)
+	{
+		double v[MAX_DIMENSIONS];
+		double distance = 0;
+
+		if (!book->lengths[e])
+		{
+			continue;
+		}
+		entryVector(book, e, v);
+		for (uint8_t d = 0; d < book->dimensions; d++)
+		{
+			distance += (v[d] - target[d]) * (v[d] - target[d]);
+		}
+		if (distance < best)
+		{
+			best = distance;
+			bestEntry = e;
+		}
+	}
+
+	entryVector(book, bestEntry, vector);
+	return bestEntry;
+}
+
+
+static void makeFloor(floor_t * floor, uint8_t rangeBits, const uint8_t * partitionClasses, uint8_t partitions)
+{
+	uint16_t n = 1 << rangeBits;
+
+	floor->rangeBits = rangeBits;
+	floor->partitions = partitions;
+	floor->partitionClasses = partitionClasses;
+	floor->values = 2;
+	floor->x[0] = 0;
+	floor->x[1] = n;
+
+	// Distinct random positions, in the order of the partitions
+	for (uint8_t p = 0; p < partitions; p++)
+	{
+		for (uint8_t d = 0; d < floorClasses[partitionClasses[p]].dimensions; d++)
+		{
+			bool taken;
+			do
+			{
+				floor->x[floor->values] = 1 + randomBelow(n - 1);
+				taken = false;
+				for (uint8_t i = 0; i < floor->values; i++)
+				{
+					taken |= (floor->x[i] == floor->x[floor->values]);
+				}
+			} while (taken);
+			floor->values++;
+		}
+	}
+
+	for (uint8_t i = 0; i < floor->values; i++)
+	{
+		uint8_t j = i;
+		for (; (j > 0) && (floor->x[floor->order[j - 1]] > floor->x[i]); j--)
+		{
+			floor->order[j] = floor->order[j - 1];
+		}
+		floor->order[j] = i;
+	}
+
+	for (uint8_t i = 2; i < floor->values; i++)
+	{
+		uint8_t low = 0;
+		uint8_t high = 1;
+		for (uint8_t j = 0; j < i; j++)
+		{
+			if ((floor->x[j] < floor->x[i]) && (floor->x[j] > floor->x[low]))
+			{
+				low = j;
+			}
+			if ((floor->x[j] > floor->x[i]) && (floor->x[j] < floor->x[high]))
+			{
+				high = j;
+			}
+		}
+		floor->low[i] = low;
+		floor->high[i] = high;
+	}
+}
+
+
+static void putFloor(bit_writer_t * w, const floor_t * floor)
+{
+	uint8_t classes = 0;
+
+	putBits(w, 1, 16);
+	putBits(w, floor->partitions, 5);
+	for (uint8_t p = 0; p < floor->partitions; p++)
+	{
+		putBits(w, floor->partitionClasses[p], 4);
+		classes = (floor->partitionClasses[p] + 1 > classes) ? floor->partitionClasses[p] + 1 : classes;
+	}
+
+	for (uint8_t c = 0; c < classes; c++)
+	{
+		const floor_class_t * fc = &floorClasses[c];
+
+		putBits(w, fc->dimensions - 1, 3);
+		putBits(w, fc->subclassBits, 2);
+		if (fc->subclassBits)
+		{
+			putBits(w, fc->masterBook, 8);
+		}
+		for (uint8_t s = 0; s < (1 << fc->subclassBits); s++)
+		{
+			putBits(w, fc->books[s] + 1, 8);
+		}
+	}
+
+	putBits(w, FLOOR_MULTIPLIER - 1, 2);
+	putBits(w, floor->rangeBits, 4);
+	for (uint8_t i = 2; i < floor->values; i++)
+	{
+		putBits(w, floor->x[i], floor->rangeBits);
+	}
+}
+
+
+// The value a coded floor value gives, next to its prediction
+static int32_t unwrapValue(int32_t value, int32_t predicted)
+{
+	int32_t highRoom = FLOOR_RANGE - predicted;
+	int32_t lowRoom = predicted;
+	int32_t room = 2 * ((highRoom < lowRoom) ? highRoom : lowRoom);
+
+	if (value == 0)
+	{
+		return predicted;
+	}
+	if (value >= room)
+	{
+		return (highRoom > lowRoom) ? value - lowRoom + predicted : predicted - value + highRoom - 1;
+	}
+	return (value & 1) ? predicted - (value + 1) / 2 : predicted + value / 2;
+}
+
+
+static int32_t predictValue(const floor_t * floor, const int32_t * finalY, uint8_t i)
+{
+	uint8_t low = floor->low[i];
+	uint8_t high = floor->high[i];
+	int32_t dy = finalY[high] - finalY[low];
+	int32_t adx = floor->x[high] - floor->x[low];
+	int32_t offset = abs(dy) * (floor->x[i] - floor->x[low]) / adx;
+
+	return (dy < 0) ? finalY[low] - offset : finalY[low] + offset;
+}
+
+
+/*
+ * The coded values that come closest to target.
+ */
+static void fitFloor(const floor_t * floor, const int32_t * target, int32_t * y)
+{
+	int32_t finalY[FLOOR_MAX_VALUES];
+
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		y[i] = finalY[i] = (target[i] < 0) ? 0 : ((target[i] > FLOOR_RANGE - 1) ? FLOOR_RANGE - 1 : target[i]);
+	}
+
+	for (uint8_t i = 2; i < floor->values; i++)
+	{
+		int32_t predicted = predictValue(floor, finalY, i);
+		int32_t best = -1;
+
+		for (int32_t value = 0; value < 256; value++)
+		{
+			int32_t result = unwrapValue(value, predicted);
+			if ((result < 0) || (result >= FLOOR_RANGE))
+			{
+				continue;
+			}
+			if ((best < 0) || (abs(result - target[i]) < abs(finalY[i] - target[i])))
+			{
+				best = value;
+				finalY[i] = result;
+			}
+		}
+		y[i] = best;
+	}
+}
+
+
+static void putFloorValues(bit_writer_t * w, const floor_t * floor, const int32_t * y)
+{
+	uint8_t offset = 2;
+
+	putBits(w, 1, 1);
+	putBits(w, y[0], ilog(FLOOR_RANGE - 1));
+	putBits(w, y[1], ilog(FLOOR_RANGE - 1));
+
+	for (uint8_t p = 0; p < floor->partitions; p++)
+	{
+		const floor_class_t * fc = &floorClasses[floor->partitionClasses[p]];
+		uint32_t classValue = 0;
+
+		if (fc->subclassBits)
+		{
+			// Subclass 1 for the values that are not 0, 0 codes nothing
+			for (uint8_t d = 0; d < fc->dimensions; d++)
+			{
+				classValue |= (y[offset + d] != 0) << (d * fc->subclassBits);
+			}
+			putEntry(w, &books[fc->masterBook], classValue);
+		}
+		for (uint8_t d = 0; d < fc->dimensions; d++)
+		{
+			int8_t book = fc->books[(classValue >> (d * fc->subclassBits)) & ((1 << fc->subclassBits) - 1)];
+			if (book >= 0)
+			{
+				putEntry(w, &books[book], y[offset + d]);
+			}
+		}
+		offset += fc->dimensions;
+	}
+}
+
+
+static void renderLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t * curve, uint32_t half)
+{
+	int32_t dy = y1 - y0;
+	int32_t adx = x1 - x0;
+	int32_t base = dy / adx;
+	int32_t step = (dy < 0) ? base - 1 : base + 1;
+	int32_t ady = abs(dy) - abs(base) * adx;
+	int32_t y = y0;
+	int32_t error = 0;
+
+	for (int32_t x = x0; (x < x1) && (x < (int32_t)half); x++)
+	{
+		if (x > x0)
+		{
+			error += ady;
+			if (error >= adx)
+			{
+				error -= adx;
+				y += step;
+			}
+			else
+			{
+				y += base;
+			}
+		}
+		curve[x] = y;
+	}
+}
+
+
+/*
+ * The floor curve, as indices of inverseDb, the way the decoder builds it from the coded values.
+ */
+static void floorCurve(const floor_t * floor, const int32_t * y, int32_t * curve, uint32_t half)
+{
+	int32_t finalY[FLOOR_MAX_VALUES];
+	bool used[FLOOR_MAX_VALUES];
+
+	finalY[0] = y[0];
+	finalY[1] = y[1];
+	used[0] = used[1] = true;
+
+	for (uint8_t i = 2; i < floor->values; i++)
+	{
+		int32_t predicted = predictValue(floor, finalY, i);
+
+		used[i] = (y[i] != 0);
+		if (used[i])
+		{
+			used[floor->low[i]] = used[floor->high[i]] = true;
+		}
+		finalY[i] = unwrapValue(y[i], predicted);
+	}
+
+	int32_t lx = 0;
+	int32_t ly = finalY[0] * FLOOR_MULTIPLIER;
+	int32_t hx = 0;
+	int32_t hy = 0;
+
+	for (uint8_t j = 1; j < floor->values; j++)
+	{
+		uint8_t i = floor->order[j];
+		if (used[i])
+		{
+			hx = floor->x[i];
+			hy = finalY[i] * FLOOR_MULTIPLIER;
+			renderLine(lx, ly, hx, hy, curve, half);
+			lx = hx;
+			ly = hy;
+		}
+	}
+	if (hx < (int32_t)half)
+	{
+		renderLine(hx, hy, half, hy, curve, half);
+	}
+}
+
+
+static void putResidueHeader(bit_writer_t * w, const residue_t * residue)
+{
+	putBits(w, residue->type, 16);
+	putBits(w, residue->begin, 24);
+	putBits(w, residue->end, 24);
+	putBits(w, residue->partitionSize - 1, 24);
+	putBits(w, RESIDUE_CLASSES - 1, 6);
+	putBits(w, CLASS_BOOK, 8);
+
+	for (uint8_t c = 0; c < RESIDUE_CLASSES; c++)
+	{
+		uint8_t passes = 0;
+		for (uint8_t i = 0; i < cascades[c].count; i++)
+		{
+			passes |= 1 << cascades[c].pass[i];
+		}
+		putBits(w, passes & 7, 3);
+		putBits(w, (passes >> 3) != 0, 1);
+		if (passes >> 3)
+		{
+			putBits(w, passes >> 3, 5);
+		}
+	}
+
+	for (uint8_t c = 0; c < RESIDUE_CLASSES; c++)
+	{
+		for (uint8_t i = 0; i < cascades[c].count; i++)
+		{
+			putBits(w, cascades[c].book[i], 8);
+		}
+	}
+}
+
+
+static uint8_t partitionClass(const int32_t * values, uint32_t count)
+{
+	int32_t largest = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		largest = (abs(values[i]) > largest) ? abs(values[i]) : largest;
+	}
+
+	return (largest == 0) ? 0 : ((largest <= 1) ? 1 : ((largest <= 4) ? 2 : 3));
+}
+
+
+/*
+ * Codes one partition of vector with book, on top of what decoded already holds, and adds what it coded.
+ * Type 0 spreads each codeword's values a step apart, types 1 and 2 put them in a row.
+ */
+static void putPartition(bit_writer_t * w, const residue_t * residue, uint8_t b, const int32_t * vector,
+						 double * decoded, uint32_t offset)
+{
+	const book_t * book = &books[b];
+	uint32_t step = (residue->type == 0) ? residue->partitionSize / book->dimensions : 1;
+	uint32_t codewords = residue->partitionSize / book->dimensions;
+
+	for (uint32_t c = 0; c < codewords; c++)
+	{
+		uint32_t first = offset + ((residue->type == 0) ? c : c * book->dimensions);
+		double target[MAX_DIMENSIONS];
+		double v[MAX_DIMENSIONS];
+
+		for (uint8_t d = 0; d < book->dimensions; d++)
+		{
+			static const int8_t noise[] = {0, 0, 0, 1, -1};
+			uint32_t i = first + d * step;
+			target[d] = (b == NOISE_BOOK) ? noise[randomBelow(5)] : vector[i] - decoded[i];
+		}
+
+		putEntry(w, book, nearestEntry(book, target, v));
+		for (uint8_t d = 0; d < book->dimensions; d++)
+		{
+			decoded[first + d * step] += v[d];
+		}
+	}
+}
+
+
+/*
+ * Codes the residue of count channels. decoded gets what the decoder will read back from it.
+ */
+static void putResidue(bit_writer_t * w, const residue_t * residue, int32_t * const * vectors, double * const * decoded,
+					   uint8_t count, uint32_t half)
+{
+	static int32_t interleaved[LONG_BLOCK];
+	static double interleavedDecoded[LONG_BLOCK];
+	static uint8_t classes[2][LONG_BLOCK / 16];
+	const int32_t * coded[2];
+	double * codedDecoded[2];
+	uint32_t size = half;
+	uint8_t vectorCount = count;
+
+	if (residue->type == 2)
+	{
+		size = half * count;
+		for (uint8_t ch = 0; ch < count; ch++)
+		{
+			for (uint32_t k = 0; k < half; k++)
+			{
+				interleaved[k * count + ch] = vectors[ch][k];
+			}
+		}
+		memset(interleavedDecoded, 0, size * sizeof(double));
+		coded[0] = interleaved;
+		codedDecoded[0] = interleavedDecoded;
+		vectorCount = 1;
+	}
+	else
+	{
+		for (uint8_t ch = 0; ch < count; ch++)
+		{
+			coded[ch] = vectors[ch];
+			codedDecoded[ch] = decoded[ch];
+			memset(decoded[ch], 0, half * sizeof(double));
+		}
+	}
+
+	uint32_t begin = (residue->begin < size) ? residue->begin : size;
+	uint32_t end = (residue->end < size) ? residue->end : size;
+	uint32_t partitions = (end - begin) / residue->partitionSize;
+	uint8_t perCodeword = books[CLASS_BOOK].dimensions;
+
+	for (uint8_t v = 0; v < vectorCount; v++)
+	{
+		for (uint32_t p = 0; p < partitions; p++)
+		{
+			classes[v][p] = partitionClass(&coded[v][begin + p * residue->partitionSize], residue->partitionSize);
+		}
+	}
+
+	for (uint8_t pass = 0; pass < 8; pass++)
+	{
+		for (uint32_t p = 0; p < partitions; )
+		{
+			if (pass == 0)
+			{
+				for (uint8_t v = 0; v < vectorCount; v++)
+				{
+					uint32_t entry = 0;
+					for (uint8_t i = 0; i < perCodeword; i++)
+					{
+						entry = entry * RESIDUE_CLASSES + ((p + i < partitions) ? classes[v][p + i] : 0);
+					}
+					putEntry(w, &books[CLASS_BOOK], entry);
+				}
+			}
+
+			for (uint8_t i = 0; (i < perCodeword) && (p < partitions); i++, p++)
+			{
+				for (uint8_t v = 0; v < vectorCount; v++)
+				{
+					uint8_t c = classes[v][p];
+					for (uint8_t j = 0; j < cascades[c].count; j++)
+					{
+						if (cascades[c].pass[j] == pass)
+						{
+							putPartition(w, residue, cascades[c].book[j], coded[v], codedDecoded[v],
+										 begin + p * residue->partitionSize);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (residue->type == 2)
+	{
+		for (uint8_t ch = 0; ch < count; ch++)
+		{
+			for (uint32_t k = 0; k < half; k++)
+			{
+				decoded[ch][k] = interleavedDecoded[k * count + ch];
+			}
+		}
+	}
+}
+
+
+static packet_t identificationHeader(const vorbis_file_t * file)
+{
+	bit_writer_t w = {0};
+
+	putBits(&w, 1, 8);
+	putString(&w, "vorbis");
+	putBits(&w, 0, 32);
+	putBits(&w, file->channels, 8);
+	putBits(&w, RATE, 32);
+	putBits(&w, 0, 32);
+	putBits(&w, 128000, 32);
+	putBits(&w, 0, 32);
+	putBits(&w, ilog(SHORT_BLOCK) - 1, 4);
+	putBits(&w, ilog(LONG_BLOCK) - 1, 4);
+	putBits(&w, 1, 1);
+
+	return toPacket(&w);
+}
+
+
+static packet_t commentHeader(void)
+{
+	bit_writer_t w = {0};
+	char vendor[320];
+
+	// A long vendor string: the comments start further in than a small buffer holds
+	memset(vendor, 'x', sizeof(vendor) - 1);
+	vendor[sizeof(vendor) - 1] = '\0';
+	memcpy(vendor, "test encoder", 12);
+
+	putBits(&w, 3, 8);
+	putString(&w, "vorbis");
+	putBits(&w, strlen(vendor), 32);
+	putString(&w, vendor);
+	putBits(&w, sizeof(comments) / sizeof(comments[0]), 32);
+	for (uint32_t i = 0; i < sizeof(comments) / sizeof(comments[0]); i++)
+	{
+		putBits(&w, strlen(comments[i]), 32);
+		putString(&w, comments[i]);
+	}
+	putBits(&w, 1, 1);
+
+	return toPacket(&w);
+}
+
+
+static packet_t setupHeader(const vorbis_file_t * file)
+{
+	bit_writer_t w = {0};
+
+	putBits(&w, 5, 8);
+	putString(&w, "vorbis");
+
+	putBits(&w, BOOKS - 1, 8);
+	for (uint8_t b = 0; b < BOOKS; b++)
+	{
+		putBook(&w, &books[b]);
+	}
+
+	// One time-domain transform, a placeholder
+	putBits(&w, 0, 6);
+	putBits(&w, 0, 16);
+
+	putBits(&w, 2 - 1, 6);
+	for (uint8_t f = 0; f < 2; f++)
+	{
+		putFloor(&w, &floors[f]);
+	}
+
+	putBits(&w, sizeof(residues) / sizeof(residues[0]) - 1, 6);
+	for (uint8_t r = 0; r < sizeof(residues) / sizeof(residues[0]); r++)
+	{
+		putResidueHeader(&w, &residues[r]);
+	}
+
+	putBits(&w, 3 - 1, 6);
+	for (uint8_t m = 0; m < 3; m++)
+	{
+		const mapping_t * mapping = &mappings[m];
+
+		putBits(&w, 0, 16);
+		putBits(&w, mapping->submaps > 1, 1);
+		if (mapping->submaps > 1)
+		{
+			putBits(&w, mapping->submaps - 1, 4);
+		}
+		putBits(&w, mapping->coupled, 1);
+		if (mapping->coupled)
+		{
+			putBits(&w, 0, 8);
+			putBits(&w, 0, ilog(file->channels - 1));
+			putBits(&w, 1, ilog(file->channels - 1));
+		}
+		putBits(&w, 0, 2);
+		if (mapping->submaps > 1)
+		{
+			for (uint8_t ch = 0; ch < file->channels; ch++)
+			{
+				putBits(&w, mapping->mux[ch], 4);
+			}
+		}
+		for (uint8_t s = 0; s < mapping->submaps; s++)
+		{
+			putBits(&w, 0, 8);
+			putBits(&w, mapping->floors[s], 8);
+			putBits(&w, mapping->residues[s], 8);
+		}
+	}
+
+	// Modes: short, and long with either mapping
+	putBits(&w, 3 - 1, 6);
+	for (uint8_t m = 0; m < 3; m++)
+	{
+		putBits(&w, m != 0, 1);
+		putBits(&w, 0, 16);
+		putBits(&w, 0, 16);
+		putBits(&w, m, 8);
+	}
+	putBits(&w, 1, 1);
+
+	return toPacket(&w);
+}
+
+
+static double slope(uint32_t i, uint32_t length)
+{
+	double s = sin((i + 0.5) / length * M_PI / 2);
+	return sin(M_PI / 2 * s * s);
+}
+
+
+static void makeWindow(double * window, uint32_t n, bool previousLong, bool nextLong)
+{
+	uint32_t half = n / 2;
+	bool longBlock = (n == LONG_BLOCK);
+	uint32_t leftStart = 0, leftLength = half, rightStart = half, rightLength = half;
+
+	if (longBlock && !previousLong)
+	{
+		leftStart = n / 4 - SHORT_BLOCK / 4;
+		leftLength = SHORT_BLOCK / 2;
+	}
+	if (longBlock && !nextLong)
+	{
+		rightStart = 3 * n / 4 - SHORT_BLOCK / 4;
+		rightLength = SHORT_BLOCK / 2;
+	}
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (i < half)
+		{
+			window[i] = (i < leftStart) ? 0 : ((i < leftStart + leftLength) ? slope(i - leftStart, leftLength) : 1);
+		}
+		else
+		{
+			uint32_t rightEnd = rightStart + rightLength;
+			window[i] = (i >= rightEnd) ? 0 : ((i < rightStart) ? 1 : slope(rightEnd - 1 - i, rightLength));
+		}
+	}
+}
+
+
+static void makeCosines(void)
+{
+	for (uint8_t size = 0; size < 2; size++)
+	{
+		uint32_t half = (size ? LONG_BLOCK : SHORT_BLOCK) / 2;
+
+		cosines[size] = malloc(2 * half * half * sizeof(double));
+		for (uint32_t n = 0; n < 2 * half; n++)
+		{
+			for (uint32_t k = 0; k < half; k++)
+			{
+				cosines[size][n * half + k] = cos(M_PI / half * (n + 0.5 + half / 2.0) * (k + 0.5));
+			}
+		}
+	}
+}
+
+
+static void mdct(const double * in, double * out, uint32_t half)
+{
+	const double * c = cosines[half == MAX_HALF];
+
+	for (uint32_t k = 0; k < half; k++)
+	{
+		out[k] = 0;
+	}
+	for (uint32_t n = 0; n < 2 * half; n++)
+	{
+		for (uint32_t k = 0; k < half; k++)
+		{
+			out[k] += in[n] * c[n * half + k];
+		}
+	}
+}
+
+
+static void imdct(const double * in, double * out, uint32_t half)
+{
+	const double * c = cosines[half == MAX_HALF];
+
+	for (uint32_t n = 0; n < 2 * half; n++)
+	{
+		double sum = 0;
+		for (uint32_t k = 0; k < half; k++)
+		{
+			sum += in[k] * c[n * half + k];
+		}
+		out[n] = sum;
+	}
+}
+
+
+static int16_t toPcm(double value)
+{
+	double sample = floor(value * 32768 + 0.5);
+	return (sample < -32768) ? -32768 : ((sample > 32767) ? 32767 : (int16_t)sample);
+}
+
+
+static void makeSignal(const vorbis_file_t * file)
+{
+	for (uint8_t ch = 0; ch < file->channels; ch++)
+	{
+		source[ch] = malloc(file->samples * sizeof(double));
+
+		for (uint32_t t = 0; t < file->samples; t++)
+		{
+			double x = (double)t / RATE;
+			double v = 0.3 * sin(2 * M_PI * (440 + ch * 110) * x) + 0.15 * sin(2 * M_PI * 3000 * x + ch)
+					 + 0.05 * sin(2 * M_PI * 9000 * x * x);
+
+			// Quiet stretches, where the floor drops, and square waves, where the residue is busy
+			if ((t / 4000) % 5 == 3)
+			{
+				v *= 0.1 * (1 + sin(t / 30.0));
+			}
+			if ((t / 11025) % 7 == 6)
+			{
+				v += 0.3 * ((t % 200 < 100) ? 1 : -1) * (ch ? 0.5 : 1);
+			}
+			source[ch][t] = v;
+		}
+	}
+}
+
+
+static double sourceSample(const vorbis_file_t * file, uint8_t ch, int64_t t)
+{
+	return ((t >= 0) && (t < file->samples)) ? source[ch][t] : 0;
+}
+
+
+/*
+ * Codes one block centered on center. The spectra it codes, decoded the way the decoder does it and mixed
+ * the way it outputs them, are left in mix (L + R) and cancel ((L - R) / 2).
+ */
+static packet_t encodeBlock(const vorbis_file_t * file, int64_t center, bool longBlock, bool previousLong,
+							bool nextLong, double * mix, double * cancel)
+{
+	static double window[LONG_BLOCK];
+	static double windowed[LONG_BLOCK];
+	static double spectrum[2][MAX_HALF];
+	static int32_t curves[2][MAX_HALF];
+	static int32_t quantized[2][MAX_HALF];
+	static double decoded[2][MAX_HALF];
+	bit_writer_t w = {0};
+	uint32_t n = longBlock ? LONG_BLOCK : SHORT_BLOCK;
+	uint32_t half = n / 2;
+	uint8_t mode = longBlock ? 1 + randomBelow(2) : 0;
+	const mapping_t * mapping = &mappings[mode];
+	bool used[2];
+
+	makeWindow(window, n, previousLong, nextLong);
+	for (uint8_t ch = 0; ch < file->channels; ch++)
+	{
+		for (uint32_t i = 0; i < n; i++)
+		{
+			windowed[i] = window[i] * sourceSample(file, ch, center - half + i);
+		}
+		mdct(windowed, spectrum[ch], half);
+		for (uint32_t k = 0; k < half; k++)
+		{
+			spectrum[ch][k] *= 2.0 / half;
+		}
+	}
+
+	putBits(&w, 0, 1);
+	putBits(&w, mode, 2);
+	if (longBlock)
+	{
+		putBits(&w, previousLong, 1);
+		putBits(&w, nextLong, 1);
+	}
+
+	// Floors: each value follows the peak of the spectrum around it
+	for (uint8_t ch = 0; ch < file->channels; ch++)
+	{
+		const floor_t * floor = &floors[mapping->floors[mapping->mux[ch]]];
+		int32_t target[FLOOR_MAX_VALUES];
+		int32_t y[FLOOR_MAX_VALUES];
+
+		for (uint8_t j = 0; j < floor->values; j++)
+		{
+			uint8_t i = floor->order[j];
+			uint32_t low = floor->x[floor->order[(j > 0) ? j - 1 : 0]];
+			uint32_t high = floor->x[floor->order[(j + 1 < floor->values) ? j + 1 : j]] + 1;
+			double peak = 1e-7;
+
+			high = (high < half) ? high : half;
+			for (uint32_t k = low; k < high; k++)
+			{
+				peak = (fabs(spectrum[ch][k]) > peak) ? fabs(spectrum[ch][k]) : peak;
+			}
+
+			int32_t value = (int32_t)lround((255 + 256 / 7.0 * log10(peak / 40)) / FLOOR_MULTIPLIER);
+			target[i] = (value < 1) ? 1 : ((value > FLOOR_RANGE - 1) ? FLOOR_RANGE - 1 : value);
+		}
+
+		used[ch] = !((ch == file->channels - 1) && chance(file->unusedPercent));
+		if (used[ch])
+		{
+			fitFloor(floor, target, y);
+			putFloorValues(&w, floor, y);
+			floorCurve(floor, y, curves[ch], half);
+		}
+		else
+		{
+			putBits(&w, 0, 1);
+		}
+	}
+
+	// Residues, what is left over the floor, in integers
+	for (uint8_t ch = 0; ch < file->channels; ch++)
+	{
+		for (uint32_t k = 0; k < half; k++)
+		{
+			int32_t value = 0;
+			if (used[ch])
+			{
+				int32_t curve = (curves[ch][k] < 0) ? 0 : ((curves[ch][k] > 255) ? 255 : curves[ch][k]);
+				value = (int32_t)lround(spectrum[ch][k] / inverseDb[curve]);
+			}
+			quantized[ch][k] = (value < -RESIDUE_LIMIT) ? -RESIDUE_LIMIT : ((value > RESIDUE_LIMIT) ? RESIDUE_LIMIT : value);
+		}
+	}
+
+	bool skip[2] = { !used[0], !used[1] };
+	if (mapping->coupled)
+	{
+		for (uint32_t k = 0; k < half; k++)
+		{
+			int32_t l = quantized[0][k];
+			int32_t r = quantized[1][k];
+			int32_t magnitude, angle;
+
+			if ((l > 0) && (r < l))
+			{
+				magnitude = l;
+				angle = l - r;
+			}
+			else if ((r > 0) && (l <= r))
+			{
+				magnitude = r;
+				angle = l - r;
+			}
+			else if ((l <= 0) && (r > l))
+			{
+				magnitude = l;
+				angle = r - l;
+			}
+			else
+			{
+				magnitude = r;
+				angle = r - l;
+			}
+			quantized[0][k] = magnitude;
+			quantized[1][k] = angle;
+		}
+		skip[0] = skip[1] = skip[0] && skip[1];
+	}
+
+	for (uint8_t s = 0; s < mapping->submaps; s++)
+	{
+		const residue_t * residue = &residues[mapping->residues[s]];
+		int32_t * vectors[2];
+		double * out[2];
+		uint8_t count = 0;
+		bool any = false;
+
+		for (uint8_t ch = 0; ch < file->channels; ch++)
+		{
+			if (mapping->mux[ch] != s)
+			{
+				continue;
+			}
+			memset(decoded[ch], 0, half * sizeof(double));
+			any |= !skip[ch];
+
+			// Type 2 codes every channel of the submap if any is used, the others the used ones only
+			if ((residue->type == 2) || !skip[ch])
+			{
+				vectors[count] = quantized[ch];
+				out[count++] = decoded[ch];
+			}
+		}
+		if (any)
+		{
+			putResidue(&w, residue, vectors, out, count, half);
+		}
+	}
+
+	if (mapping->coupled)
+	{
+		for (uint32_t k = 0; k < half; k++)
+		{
+			double magnitude = decoded[0][k];
+			double angle = decoded[1][k];
+
+			if (magnitude > 0)
+			{
+				decoded[0][k] = (angle > 0) ? magnitude : magnitude + angle;
+				decoded[1][k] = (angle > 0) ? magnitude - angle : magnitude;
+			}
+			else
+			{
+				decoded[0][k] = (angle > 0) ? magnitude : magnitude - angle;
+				decoded[1][k] = (angle > 0) ? magnitude + angle : magnitude;
+			}
+		}
+	}
+
+	for (uint32_t k = 0; k < half; k++)
+	{
+		double f[2] = {0, 0};
+
+		for (uint8_t ch = 0; ch < file->channels; ch++)
+		{
+			if (used[ch])
+			{
+				int32_t curve = (curves[ch][k] < 0) ? 0 : ((curves[ch][k] > 255) ? 255 : curves[ch][k]);
+				f[ch] = decoded[ch][k] * inverseDb[curve];
+			}
+		}
+		mix[k] = (file->channels == 2) ? f[0] + f[1] : f[0];
+		cancel[k] = (file->channels == 2) ? (f[0] - f[1]) / 2 : f[0];
+	}
+
+	return toPacket(&w);
+}
+
+
+static void makeCrcTable(void)
+{
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t c = i << 24;
+		for (uint8_t b = 0; b < 8; b++)
+		{
+			c = (c & 0x80000000U) ? (c << 1) ^ 0x04C11DB7U : c << 1;
+		}
+		crcTable[i] = c;
+	}
+}
+
+
+static void setPageCrc(uint8_t * page, uint32_t length)
+{
+	uint32_t crc = 0;
+
+	memset(&page[22], 0, 4);
+	for (uint32_t i = 0; i < length; i++)
+	{
+		crc = (crc << 8) ^ crcTable[(crc >> 24) ^ page[i]];
+	}
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		page[22 + i] = crc >> (8 * i);
+	}
+}
+
+
+static void putPage(bit_writer_t * file, uint32_t * sequence, const uint8_t * segments, uint8_t segmentCount,
+					const uint8_t * body, uint32_t bodyLength, uint64_t granule, uint8_t flags)
+{
+	uint32_t start = file->bits >> 3;
+
+	putString(file, "OggS");
+	putBits(file, 0, 8);
+	putBits(file, flags, 8);
+	putBits(file, (uint32_t)granule, 32);
+	putBits(file, (uint32_t)(granule >> 32), 32);
+	putBits(file, SERIAL_NUMBER, 32);
+	putBits(file, (*sequence)++, 32);
+	putBits(file, 0, 32);
+	putBits(file, segmentCount, 8);
+	for (uint8_t i = 0; i < segmentCount; i++)
+	{
+		putBits(file, segments[i], 8);
+	}
+	for (uint32_t i = 0; i < bodyLength; i++)
+	{
+		putBits(file, body[i], 8);
+	}
+
+	setPageCrc(&file->data[start], (file->bits >> 3) - start);
+}
+
+
+/*
+ * Puts the packets in pages of a random number of segments (up to 255 if maxSegments is 0). A packet is split
+ * across pages wherever one fills, the granule position of a page is the one of the last packet that ends in it.
+ */
+static void putPackets(bit_writer_t * file, uint32_t * sequence, const packet_t * packets, const uint64_t * granules,
+					   uint32_t count, uint8_t minSegments, uint8_t maxSegments, uint8_t flags)
+{
+	static uint8_t body[255 * 255];
+	uint8_t segments[255];
+	uint8_t segmentCount = 0;
+	uint32_t bodyLength = 0;
+	uint64_t granule = UINT64_MAX;
+	bool continued = false;
+	uint8_t limit = maxSegments ? minSegments + randomBelow(maxSegments - minSegments + 1) : 255;
+
+	for (uint32_t p = 0; p < count; p++)
+	{
+		uint32_t offset = 0;
+		uint32_t laces = packets[p].length / 255 + 1;
+
+		for (uint32_t l = 0; l < laces; l++)
+		{
+			uint8_t lace = (l + 1 < laces) ? 255 : packets[p].length % 255;
+
+			segments[segmentCount++] = lace;
+			memcpy(&body[bodyLength], &packets[p].data[offset], lace);
+			bodyLength += lace;
+			offset += lace;
+			if (l + 1 == laces)
+			{
+				granule = granules[p];
+			}
+
+			if (segmentCount >= limit)
+			{
+				putPage(file, sequence, segments, segmentCount, body, bodyLength, granule, flags | continued);
+				continued = (l + 1 < laces);
+				flags = 0;
+				segmentCount = 0;
+				bodyLength = 0;
+				granule = UINT64_MAX;
+				limit = maxSegments ? minSegments + randomBelow(maxSegments - minSegments + 1) : 255;
+			}
+		}
+	}
+
+	if (segmentCount)
+	{
+		putPage(file, sequence, segments, segmentCount, body, bodyLength, granule, flags | continued);
+	}
+}
+
+
+/*
+ * Encodes the file and decodes it back in double precision into reference and referenceCancel.
+ * Returns its size, the bytes in out.
+ */
+static uint32_t encode(const vorbis_file_t * file, uint8_t ** out)
+{
+	static double mix[MAX_HALF];
+	static double cancel[MAX_HALF];
+	static double block[2][LONG_BLOCK];
+	static double window[LONG_BLOCK];
+	static double overlap[2][MAX_HALF];
+	uint32_t blockCount = 0;
+	uint32_t capacity = file->samples / (SHORT_BLOCK / 2) + 2;
+	bool * longBlocks = malloc(capacity * sizeof(bool));
+	packet_t * packets = malloc(capacity * sizeof(packet_t));
+	uint64_t * granules = malloc(capacity * sizeof(uint64_t));
+	bit_writer_t w = {0};
+	uint32_t sequence = 0;
+	uint32_t written = 0;
+	int64_t center = 0;
+
+	mappings = (file->channels == 2) ? stereoMappings : monoMappings;
+	makeBooks();
+	makeFloor(&floors[0], 7, shortFloorClasses, sizeof(shortFloorClasses));
+	makeFloor(&floors[1], 10, longFloorClasses, sizeof(longFloorClasses));
+
+	// Blocks until one is centered past the end
+	do
+	{
+		longBlocks[blockCount] = chance(LONG_PERCENT);
+		if (blockCount)
+		{
+			center += (longBlocks[blockCount - 1] ? LONG_BLOCK : SHORT_BLOCK) / 4 + (longBlocks[blockCount] ? LONG_BLOCK : SHORT_BLOCK) / 4;
+		}
+		blockCount++;
+	} while (center < file->samples);
+
+	reference = malloc((file->samples + LONG_BLOCK) * sizeof(int16_t));
+	referenceCancel = malloc((file->samples + LONG_BLOCK) * sizeof(int16_t));
+
+	center = 0;
+	for (uint32_t b = 0; b < blockCount; b++)
+	{
+		bool longBlock = longBlocks[b];
+		bool previousLong = b ? longBlocks[b - 1] : longBlock;
+		bool nextLong = (b + 1 < blockCount) ? longBlocks[b + 1] : longBlock;
+		uint32_t n = longBlock ? LONG_BLOCK : SHORT_BLOCK;
+		uint32_t half = n / 2;
+
+		if (b)
+		{
+			uint32_t previousHalf = (previousLong ? LONG_BLOCK : SHORT_BLOCK) / 2;
+			center += previousHalf / 2 + half / 2;
+		}
+		packets[b] = encodeBlock(file, center, longBlock, previousLong, nextLong, mix, cancel);
+
+		// The reference decode: windowed inverse MDCT, overlapped with the second half of the block before
+		makeWindow(window, n, previousLong, nextLong);
+		imdct(mix, block[0], half);
+		imdct(cancel, block[1], half);
+		for (uint32_t i = 0; i < n; i++)
+		{
+			block[0][i] *= window[i];
+			block[1][i] *= window[i];
+		}
+
+		if (b)
+		{
+			uint32_t previousHalf = (previousLong ? LONG_BLOCK : SHORT_BLOCK) / 2;
+			int32_t offset = (int32_t)half / 2 - (int32_t)previousHalf / 2;
+			uint32_t frames = previousHalf / 2 + half / 2;
+
+			for (uint32_t t = 0; t < frames; t++, written++)
+			{
+				double a[2] = {0, 0};
+				int32_t i = (int32_t)t + offset;
+
+				for (uint8_t o = 0; o < 2; o++)
+				{
+					a[o] = (t < previousHalf) ? overlap[o][t] : 0;
+					if ((i >= 0) && (i < (int32_t)half))
+					{
+						a[o] += block[o][i];
+					}
+				}
+				if (written < file->samples)
+				{
+					reference[written] = toPcm(a[0]);
+					referenceCancel[written] = toPcm(a[1]);
+				}
+			}
+		}
+		granules[b] = written;
+		memcpy(overlap[0], &block[0][half], half * sizeof(double));
+		memcpy(overlap[1], &block[1][half], half * sizeof(double));
+	}
+	granules[blockCount - 1] = file->samples;
+
+	packet_t headers[3] = { identificationHeader(file), commentHeader(), setupHeader(file) };
+	uint64_t headerGranules[3] = {0, 0, 0};
+
+	putPackets(&w, &sequence, &headers[0], headerGranules, 1, 0, 0, 0x02);
+	putPackets(&w, &sequence, &headers[1], headerGranules, 2, 0, 0, 0);
+
+	uint32_t lastPage;
+	uint32_t audioStart = w.bits >> 3;
+	if (file->shortPages)
+	{
+		putPackets(&w, &sequence, packets, granules, blockCount, 1, 20, 0);
+	}
+	else
+	{
+		putPackets(&w, &sequence, packets, granules, blockCount, 15, 40, 0);
+	}
+
+	// The last page gets the end of stream flag
+	for (lastPage = audioStart; ; )
+	{
+		uint32_t length = 27 + w.data[lastPage + 26];
+		for (uint8_t s = 0; s < w.data[lastPage + 26]; s++)
+		{
+			length += w.data[lastPage + 27 + s];
+		}
+		if (lastPage + length >= (w.bits >> 3))
+		{
+			break;
+		}
+		lastPage += length;
+	}
+	w.data[lastPage + 5] |= 0x04;
+	setPageCrc(&w.data[lastPage], (w.bits >> 3) - lastPage);
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		free(headers[i].data);
+	}
+	for (uint32_t b = 0; b < blockCount; b++)
+	{
+		free(packets[b].data);
+	}
+	free(packets);
+	free(granules);
+	free(longBlocks);
+
+	*out = w.data;
+	return w.bits >> 3;
+}
+
+
+static void check(int ok, const vorbis_file_t * file, const vorbis_run_t * run, const char * what, long value)
+{
+	printf("%-5s %-13s cc %u seek %6d: %-24s %ld\n", ok ? "ok" : "FAIL", file->name,
+		   run->centerCancel, run->seek, what, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+static void play(const vorbis_file_t * file, const vorbis_run_t * run, const uint8_t * data, uint32_t size)
+{
+	const int16_t * expected = run->centerCancel ? referenceCancel : reference;
+	short output[OUTPUT_SIZE];
+	uint32_t samples;
+	int rate;
+	uint32_t frame = 0;
+	uint32_t calls = 0;
+	uint32_t seeks = 0;
+	long largest = 0;
+
+	DecoderHost_SetFile(data, size);
+	VorbisDecoder_Init();
+	vorbisCodec.setCenterCancel(run->centerCancel);
+
+	if (!VorbisDecoder_LoadFile(DECODER_PLAYING_STREAM, "test.ogg"))
+	{
+		check(0, file, run, "opened", 0);
+		return;
+	}
+
+	if (!run->centerCancel && !run->seek)
+	{
+		char * tag;
+		check(vorbisCodec.getTag(AUDIO_TAG_TITLE, &tag) && !strcmp(tag, TITLE), file, run, "title", 0);
+		check(vorbisCodec.getTag(AUDIO_TAG_ARTIST, &tag) && !strcmp(tag, ARTIST), file, run, "artist", 0);
+		check(vorbisCodec.getTag(AUDIO_TAG_YEAR, &tag) && !strcmp(tag, YEAR), file, run, "year", 0);
+
+		uint32_t expectedMs = (uint32_t)((uint64_t)file->samples * 1000 / RATE);
+		check(vorbisCodec.getRemainingMs() == expectedMs, file, run, "length, ms", vorbisCodec.getRemainingMs());
+	}
+
+	while (VorbisDecoder_DecodeFrame(DECODER_PLAYING_STREAM, output, OUTPUT_SIZE, &samples, &rate) == DECODER_WORKED)
+	{
+		for (uint32_t i = 0; i < samples; i++, frame++)
+		{
+			long difference = (frame < file->samples) ? labs((long)output[i] - expected[frame]) : 0;
+			largest = (difference > largest) ? difference : largest;
+		}
+
+		calls++;
+		if (calls % READ_AHEAD_EVERY == 0)
+		{
+			VorbisDecoder_ReadAhead();
+		}
+		if (run->seek && (calls % run->seekEvery == 0) && ((int64_t)frame + run->seek < file->samples) &&
+			(seeks++ < MAX_SEEKS))
+		{
+			int64_t target = (int64_t)frame + run->seek;
+			if (!vorbisCodec.seek(run->seek))
+			{
+				check(0, file, run, "seek", (long)target);
+				break;
+			}
+			frame = (target < 0) ? 0 : (uint32_t)target;
+		}
+	}
+
+	check(largest <= MAX_DIFFERENCE, file, run, "largest difference, LSB", largest);
+	check(frame == file->samples, file, run, "samples, to the end", frame);
+	check(DecoderHost_UnalignedReads() == 0, file, run, "reads through the window", DecoderHost_UnalignedReads());
+
+	VorbisDecoder_Close(DECODER_PLAYING_STREAM);
+}
+
+
+int main(void)
+{
+	// The floor's dB steps, from -140 dB to 0
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		inverseDb[i] = pow(10, -(255.0 - i) * 7 / 256);
+	}
+	makeCosines();
+	makeCrcTable();
+
+	for (uint32_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+	{
+		const vorbis_file_t * file = &files[f];
+		uint8_t * data;
+
+		randomState = file->seed;
+		makeSignal(file);
+		uint32_t size = encode(file, &data);
+
+		for (uint32_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+		{
+			play(file, &runs[r], data, size);
+		}
+
+		free(data);
+		for (uint8_t ch = 0; ch < file->channels; ch++)
+		{
+			free(source[ch]);
+		}
+		free(reference);
+		free(referenceCancel);
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+/*******************************************************************************
+  @file     wav_test.c
+  @brief    Host check of the WAV decoder against files written here
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -Icomponent/fatfs -Isource/drivers/HAL -Itests/host tests/host/wav_test.c tests/host/decoder_host.c \
+ *       source/drivers/HAL/wav_decoder.c -lm -o wav_test
+ *   ./wav_test
+ *
+ * PCM files of every sample size, mono and stereo, some with a LIST chunk before fmt, are decoded the way
+ * the handler does it (read-ahead every few calls) and compared sample by sample with what was written:
+ * - 8-bit samples come out shifted to 16 bits, 24-bit ones lose their low byte.
+ * - With center cancel, stereo comes out as (L - R) / 2.
+ * - Forward and backward seeks land on the exact frame.
+ * - Every read of a sector or more goes straight to FatFs (whole sectors, aligned).
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wav_decoder.h"
+#include "decoder_host.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define RATE			(44100U)
+#define OUTPUT_SIZE		(2304U)
+#define READ_AHEAD_EVERY	(3)			// Decode calls between read-aheads
+#define SEEK_EVERY		(5)			// Decode calls between seeks, when the case seeks
+
+
+/*******************************************************************************
+ * ENUMERATIONS AND STRUCTURES AND TYPEDEFS
+ ******************************************************************************/
+
+typedef struct
+{
+	uint8_t bits;
+	uint8_t channels;
+	uint32_t frames;
+	uint32_t listBytes;				// A LIST chunk this long goes before fmt, 0 for none
+	bool centerCancel;
+	int32_t seek;					// Frames, every SEEK_EVERY calls. 0 to play straight through
+} wav_case_t;
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static const wav_case_t cases[] =
+{
+	{16, 2, 50000,  0, false,     0},
+	{24, 2, 50000, 10, false,     0},
+	{24, 1, 30001,  0, false,     0},
+	{ 8, 1, 30000, 10, false,     0},
+	{16, 2, 50000,  0, true,      0},
+	{16, 1, 40000,  0, false,  3000},
+	{24, 2, 40000,  0, false,  -500},
+};
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+static void write32(uint8_t * p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+
+/*
+ * The 16-bit value of a channel at a frame, a ramp that wraps.
+ */
+static int16_t sample(uint32_t frame, uint8_t channel)
+{
+	return (int16_t)(frame * 7 + channel * 1000);
+}
+
+
+/*
+ * What the decoder must give back for a channel at a frame: what was written, at 16 bits.
+ */
+static int16_t expected(const wav_case_t * test, uint32_t frame, uint8_t channel, uint8_t outChannels)
+{
+	int32_t value = sample(frame, channel);
+
+	if (test->bits == 8)
+	{
+		value = (value >> 8) * 256;
+	}
+
+	if ((outChannels == 1) && (test->channels == 2))
+	{
+		int32_t right = sample(frame, 1);
+		if (test->bits == 8)
+		{
+			right = (right >> 8) * 256;
+		}
+		value = (value - right) / 2;
+	}
+
+	return (int16_t)value;
+}
+
+
+/*
+ * RIFF/WAVE file of the case. Returns its length.
+ */
+static uint32_t build(const wav_case_t * test, uint8_t ** file)
+{
+	uint32_t sampleBytes = test->bits / 8;
+	uint32_t frameBytes = sampleBytes * test->channels;
+	uint32_t header = 12 + test->listBytes + 24 + 8;
+	uint32_t size = header + test->frames * frameBytes;
+	uint8_t * p = calloc(size, 1);
+
+	*file = p;
+
+	memcpy(p, "RIFF", 4);
+	write32(&p[4], size - 8);
+	memcpy(&p[8], "WAVE", 4);
+	p += 12;
+
+	if (test->listBytes)
+	{
+		memcpy(p, "LIST", 4);
+		write32(&p[4], test->listBytes - 8);
+		p += test->listBytes;
+	}
+
+	memcpy(p, "fmt ", 4);
+	write32(&p[4], 16);
+	p[8] = 1;
+	p[10] = test->channels;
+	write32(&p[12], RATE);
+	write32(&p[16], RATE * frameBytes);
+	p[20] = frameBytes;
+	p[22] = test->bits;
+	p += 24;
+
+	memcpy(p, "data", 4);
+	write32(&p[4], test->frames * frameBytes);
+	p += 8;
+
+	for (uint32_t frame = 0; frame < test->frames; frame++)
+	{
+		for (uint8_t channel = 0; channel < test->channels; channel++)
+		{
+			int16_t value = sample(frame, channel);
+
+			if (sampleBytes == 1)
+			{
+				*p++ = (uint8_t)((value >> 8) + 128);
+			}
+			else if (sampleBytes == 2)
+			{
+				*p++ = value;
+				*p++ = value >> 8;
+			}
+			else
+			{
+				*p++ = 0x55;		// Dropped
+				*p++ = value;
+				*p++ = value >> 8;
+			}
+		}
+	}
+
+	return size;
+}
+
+
+static void check(int ok, const wav_case_t * test, const char * what, long value)
+{
+	printf("%-5s %2u bit %u ch list %2u cc %u seek %5d: %-28s %ld\n", ok ? "ok" : "FAIL", test->bits, test->channels,
+		   test->listBytes, test->centerCancel, test->seek, what, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+static void run(const wav_case_t * test)
+{
+	uint8_t * file;
+	uint32_t size = build(test, &file);
+	short output[OUTPUT_SIZE];
+	uint32_t samples;
+	int rate;
+	uint32_t frame = 0;
+	uint32_t calls = 0;
+	long wrong = 0;
+
+	DecoderHost_SetFile(file, size);
+	WAVDecoder_Init();
+	wavCodec.setCenterCancel(test->centerCancel);
+
+	if (!WAVDecoder_LoadFile(DECODER_PLAYING_STREAM, "test.wav"))
+	{
+		check(0, test, "opened", 0);
+		free(file);
+		return;
+	}
+
+	while (WAVDecoder_DecodeFrame(DECODER_PLAYING_STREAM, output, OUTPUT_SIZE, &samples, &rate) == DECODER_WORKED)
+	{
+		uint8_t channels;
+		wavCodec.getChannels(DECODER_PLAYING_STREAM, &channels);
+
+		for (uint32_t i = 0; i < samples / channels; i++, frame++)
+		{
+			for (uint8_t channel = 0; channel < channels; channel++)
+			{
+				if ((frame >= test->frames) || (output[i * channels + channel] != expected(test, frame, channel, channels)))
+				{
+					wrong++;
+				}
+			}
+		}
+
+		calls++;
+		if (calls % READ_AHEAD_EVERY == 0)
+		{
+			WAVDecoder_ReadAhead();
+		}
+		// Not past the end, where the decoder stops at the last frame
+		if (test->seek && (calls % SEEK_EVERY == 0) && ((int64_t)frame + test->seek < test->frames))
+		{
+			wavCodec.seek(test->seek);
+			frame += test->seek;
+		}
+	}
+
+	check(wrong == 0, test, "samples off", wrong);
+	check(frame == test->frames, test, "frames, to the end", frame);
+	check(DecoderHost_UnalignedReads() == 0, test, "reads through the window", DecoderHost_UnalignedReads());
+
+	WAVDecoder_Close(DECODER_PLAYING_STREAM);
+	free(file);
+}
+
+
+int main(void)
+{
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		run(&cases[i]);
+	}
+
+	return failures ? 1 : 0;
+}
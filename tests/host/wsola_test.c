@@ -0,0 +1,208 @@
+/*******************************************************************************
+  @file     wsola_test.c
+  @brief    Host check of the tempo change: speed and pitch of a two-tone signal
+  @author   Grupo 5 - Labo de Micros
+ ******************************************************************************
+ *
+ * Runs on the PC, not on the board. From the repository root:
+ *
+ *   gcc -O2 -I. -ICMSIS -Isource/equalizer tests/host/wsola_test.c source/equalizer/wsola.c -lm -o wsola_test
+ *   ./wsola_test
+ *
+ * Four seconds of 220 + 330 Hz at 48 kHz go through WSOLA at the tempos of the player and some in between:
+ * - Input samples used per output sample, against the tempo.
+ * - How much of the output energy a fit of 220 and 330 Hz explains: if the pitch moved or the segments
+ *   do not line up, the rest goes elsewhere.
+ * Exits with 1 if any check fails.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "wsola.h"
+
+
+/*******************************************************************************
+ * CONSTANT AND MACRO DEFINITIONS USING #DEFINE
+ ******************************************************************************/
+
+#define RATE			(48000)
+#define INPUTS			(4 * RATE)
+#define SETTLE			(5000)			// Outputs left out at both ends
+#define SCALE			(1 << 28)		// The headroom of the handler's Q31 path
+#define FIT_BLOCK		(2400)			// 50 ms, 11 periods of the lower tone
+
+#define MAX_SPEED_ERROR	(0.01)
+#define MIN_TONAL		(0.999)
+
+
+/*******************************************************************************
+ * STATIC VARIABLES AND CONST VARIABLES WITH FILE LEVEL SCOPE
+ ******************************************************************************/
+
+static q31_t input[INPUTS];
+static q31_t output[2 * INPUTS + WSOLA_HOP];
+
+static const double tones[] = {220, 330};
+
+static int failures = 0;
+
+
+/*******************************************************************************
+ * FUNCTION DEFINITIONS
+ ******************************************************************************/
+
+/*
+ * Energy of the output between first and last that a least squares fit of the tones leaves out.
+ * Anything the pitch moved, or a segment that does not line up, is left out of it.
+ */
+static double residual(uint32_t first, uint32_t last)
+{
+	enum { BASES = 2 * sizeof(tones) / sizeof(tones[0]) };
+	double a[BASES][BASES + 1] = {{0}};
+
+	// Normal equations of the output against a sine and a cosine of each tone
+	for (uint32_t i = first; i < last; i++)
+	{
+		double x = (double)output[i] / SCALE;
+		double basis[BASES];
+
+		for (uint32_t k = 0; k < BASES / 2; k++)
+		{
+			basis[2 * k] = sin(2 * M_PI * tones[k] * i / RATE);
+			basis[2 * k + 1] = cos(2 * M_PI * tones[k] * i / RATE);
+		}
+		for (uint32_t r = 0; r < BASES; r++)
+		{
+			for (uint32_t c = 0; c < BASES; c++)
+			{
+				a[r][c] += basis[r] * basis[c];
+			}
+			a[r][BASES] += basis[r] * x;
+		}
+	}
+
+	// Gauss-Jordan, the matrix is close to diagonal
+	for (uint32_t r = 0; r < BASES; r++)
+	{
+		for (uint32_t o = 0; o < BASES; o++)
+		{
+			if (o != r)
+			{
+				double f = a[o][r] / a[r][r];
+				for (uint32_t c = r; c <= BASES; c++)
+				{
+					a[o][c] -= f * a[r][c];
+				}
+			}
+		}
+	}
+
+	double error = 0;
+	for (uint32_t i = first; i < last; i++)
+	{
+		double y = 0;
+		for (uint32_t k = 0; k < BASES / 2; k++)
+		{
+			y += a[2 * k][BASES] / a[2 * k][2 * k] * sin(2 * M_PI * tones[k] * i / RATE);
+			y += a[2 * k + 1][BASES] / a[2 * k + 1][2 * k + 1] * cos(2 * M_PI * tones[k] * i / RATE);
+		}
+		double e = (double)output[i] / SCALE - y;
+		error += e * e;
+	}
+
+	return error;
+}
+
+
+/*
+ * Fraction of the output energy between first and last that the tones explain, fitted a block at a time:
+ * the phase of the output drifts from the input's by a sample or two each segment, and that is fine.
+ */
+static double tonalFraction(uint32_t first, uint32_t last)
+{
+	double total = 0;
+	double error = 0;
+
+	// Whole blocks only
+	last = first + (last - first) / FIT_BLOCK * FIT_BLOCK;
+
+	for (uint32_t i = first; i < last; i++)
+	{
+		double x = (double)output[i] / SCALE;
+		total += x * x;
+	}
+
+	for (uint32_t block = first; block < last; block += FIT_BLOCK)
+	{
+		error += residual(block, block + FIT_BLOCK);
+	}
+
+	return 1 - error / total;
+}
+
+
+static void check(int ok, const char * what, uint8_t tempo, double value)
+{
+	printf("%-5s %-36s %3u%%: %.4f\n", ok ? "ok" : "FAIL", what, tempo, value);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+
+int main(void)
+{
+	static const uint8_t tempos[] = {50, 75, 100, 110, 120, 125, 130, 150, 175, 200};
+
+	for (uint32_t i = 0; i < INPUTS; i++)
+	{
+		input[i] = (q31_t)((0.5 * sin(2 * M_PI * tones[0] * i / RATE) +
+							0.3 * sin(2 * M_PI * tones[1] * i / RATE + 1)) * SCALE);
+	}
+
+	for (uint32_t t = 0; t < sizeof(tempos) / sizeof(tempos[0]); t++)
+	{
+		uint8_t tempo = tempos[t];
+		uint32_t used = 0;
+		uint32_t written = 0;
+		uint32_t usedHalf = 0;
+		uint32_t writtenHalf = 0;
+
+		Wsola_Start(tempo);
+
+		// Like the handler: input in buffers while WSOLA asks for it, a hop out at a time
+		while ((used < INPUTS) && (written + WSOLA_HOP <= sizeof(output) / sizeof(output[0])))
+		{
+			while (Wsola_Needed() && (used < INPUTS))
+			{
+				uint32_t length = (INPUTS - used < WSOLA_INPUT_CHUNK) ? INPUTS - used : WSOLA_INPUT_CHUNK;
+				memcpy(Wsola_AcquireInput(), &input[used], length * sizeof(q31_t));
+				Wsola_CommitInput(length);
+				used += length;
+			}
+
+			if ((usedHalf == 0) && (used >= INPUTS / 2))
+			{
+				usedHalf = used;
+				writtenHalf = written;
+			}
+
+			if (used < INPUTS)
+			{
+				Wsola_Hop(&output[written]);
+				written += WSOLA_HOP;
+			}
+		}
+
+		// From halfway on, what WSOLA holds inside is the same at both ends
+		double speed = (double)(used - usedHalf) / (written - writtenHalf) * 100 / tempo;
+		check(fabs(speed - 1) <= MAX_SPEED_ERROR, "input per output / tempo", tempo, speed);
+
+		double tonal = tonalFraction(SETTLE, written - SETTLE);
+		check(tonal >= MIN_TONAL, "energy of 220 and 330 Hz, fraction", tempo, tonal);
+	}
+
+	return failures ? 1 : 0;
+}